@@ -0,0 +1,395 @@
+#include "AssetArchive.h"
+#include "MeshOptimizer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(AssetArchiveHeader) == 32 && sizeof(AssetEntry) == 32, "Archive structs must not have padding");
+static_assert(sizeof(MeshAssetHeader) == 32 && sizeof(TextureAssetHeader) == 16, "Archive structs must not have padding");
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	bool EntryLess(const AssetEntry& entry, uint64_t hash)
+	{
+		return entry.NameHash < hash;
+	}
+
+	//The vertices and indices a mesh header points at must lie inside its asset, and
+	//each fit in a buffer. 32 bit counts and offsets cannot overflow in 64 bits.
+	bool IsMeshInside(const MeshAssetHeader& mesh, uint64_t assetSize)
+	{
+		if(mesh.IndexFormat != RD_FMT_INDEX16 && mesh.IndexFormat != RD_FMT_INDEX32)
+			return false;
+		uint64_t vertexBytes = (uint64_t)mesh.VertexCount * mesh.Stride;
+		if(vertexBytes > 0xFFFFFFFF || mesh.VertexOffset + vertexBytes > assetSize)
+			return false;
+		if(mesh.IndexCount == 0)
+			return true;
+
+		uint64_t indexBytes = (uint64_t)mesh.IndexCount * (mesh.IndexFormat == RD_FMT_INDEX32 ? 4 : 2);
+		if(indexBytes > 0xFFFFFFFF)
+			return false;
+		//Compressed indices run to the end of the asset, the decoder checks their length
+		if(mesh.Flags & MESH_ASSET_COMPRESSED_INDICES)
+			return mesh.IndexOffset <= assetSize;
+		return mesh.IndexOffset + indexBytes <= assetSize;
+	}
+}
+
+uint64_t AssetNameHash(const char* pName)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for(const unsigned char* p = (const unsigned char*)pName; *p; ++p)
+	{
+		hash ^= *p;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+//AssetArchive
+//-----------------------------------------------------------------------------
+
+AssetArchive::AssetArchive()
+{
+	m_pBase = NULL;
+	m_Size = 0;
+	m_Mapped = false;
+	m_pHeader = NULL;
+	m_pEntries = NULL;
+	m_pNames = NULL;
+#ifdef _WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#endif
+}
+
+AssetArchive::~AssetArchive()
+{
+	Close();
+}
+
+bool AssetArchive::Open(const char* pPath)
+{
+	Close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = (uint64_t)size.QuadPart;
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_hMapping)
+		m_pBase = (const uint8_t*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fd = open(pPath, O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	m_Size = (uint64_t)st.st_size;
+	void* pMapping = mmap(NULL, (size_t)m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+	//The mapping keeps the file referenced
+	close(fd);
+	if(pMapping != MAP_FAILED)
+		m_pBase = (const uint8_t*)pMapping;
+#endif
+
+	m_Mapped = m_pBase != NULL;
+	if(!m_Mapped)
+	{
+		//Mapping failed (e.g. 32 bit address space exhausted), keep a copy instead
+		FILE* f = fopen(pPath, "rb");
+		m_Copy.resize((size_t)m_Size);
+		bool read = f && fread(&m_Copy[0], 1, m_Copy.size(), f) == m_Copy.size();
+		if(f)
+			fclose(f);
+		if(!read)
+		{
+			Close();
+			return false;
+		}
+		m_pBase = &m_Copy[0];
+	}
+
+	if(!Validate())
+	{
+		Close();
+		return false;
+	}
+
+	m_pHeader = (const AssetArchiveHeader*)m_pBase;
+	m_pEntries = (const AssetEntry*)(m_pBase + m_pHeader->TableOffset);
+	m_pNames = (const char*)(m_pEntries + m_pHeader->EntryCount);
+	return true;
+}
+
+bool AssetArchive::Validate() const
+{
+	if(m_Size < sizeof(AssetArchiveHeader))
+		return false;
+
+	const AssetArchiveHeader* pHeader = (const AssetArchiveHeader*)m_pBase;
+	if(pHeader->Magic != ASSET_ARCHIVE_MAGIC || pHeader->Version < 1 || pHeader->Version > ASSET_ARCHIVE_VERSION || pHeader->FileSize != m_Size)
+		return false;
+	uint64_t tableEnd = pHeader->TableOffset + (uint64_t)pHeader->EntryCount * sizeof(AssetEntry);
+	if(pHeader->TableOffset % 8 != 0 || tableEnd > m_Size)
+		return false;
+
+	//Every asset must lie inside the file, before the table
+	const AssetEntry* pEntries = (const AssetEntry*)(m_pBase + pHeader->TableOffset);
+	for(uint32_t i = 0; i < pHeader->EntryCount; ++i)
+	{
+		const AssetEntry& entry = pEntries[i];
+		if(entry.Offset + entry.Size > pHeader->TableOffset || entry.NameOffset >= m_Size - tableEnd)
+			return false;
+		if(i > 0 && pEntries[i - 1].NameHash >= entry.NameHash)
+			return false;
+	}
+	return m_pBase[m_Size - 1] == 0;
+}
+
+void AssetArchive::Close()
+{
+	if(m_Mapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(m_pBase);
+#else
+		munmap((void*)m_pBase, (size_t)m_Size);
+#endif
+	}
+#ifdef _WIN32
+	if(m_hMapping)
+		CloseHandle(m_hMapping);
+	if(m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+	m_hMapping = NULL;
+	m_hFile = INVALID_HANDLE_VALUE;
+#endif
+
+	std::vector<uint8_t>().swap(m_Copy);
+	m_pBase = NULL;
+	m_Size = 0;
+	m_Mapped = false;
+	m_pHeader = NULL;
+	m_pEntries = NULL;
+	m_pNames = NULL;
+}
+
+int AssetArchive::Find(const char* pName) const
+{
+	if(!m_pHeader)
+		return -1;
+
+	uint64_t hash = AssetNameHash(pName);
+	const AssetEntry* pEnd = m_pEntries + m_pHeader->EntryCount;
+	const AssetEntry* pEntry = std::lower_bound(m_pEntries, pEnd, hash, EntryLess);
+	if(pEntry == pEnd || pEntry->NameHash != hash)
+		return -1;
+	return (int)(pEntry - m_pEntries);
+}
+
+const MeshAssetHeader* AssetArchive::GetMesh(unsigned index) const
+{
+	const AssetEntry& entry = m_pEntries[index];
+	if(entry.Type != ASSET_MESH || entry.Size < sizeof(MeshAssetHeader))
+		return NULL;
+	const MeshAssetHeader* pMesh = (const MeshAssetHeader*)GetData(index);
+	return IsMeshInside(*pMesh, entry.Size) ? pMesh : NULL;
+}
+
+const TextureAssetHeader* AssetArchive::GetTexture(unsigned index) const
+{
+	if(m_pEntries[index].Type != ASSET_TEXTURE)
+		return NULL;
+	return (const TextureAssetHeader*)GetData(index);
+}
+
+//-----------------------------------------------------------------------------
+//AssetArchiveWriter
+//-----------------------------------------------------------------------------
+
+AssetArchiveWriter::AssetArchiveWriter(uint32_t alignment)
+{
+	m_Alignment = std::max(alignment, 16u);
+}
+
+AssetArchiveWriter::PendingAsset* AssetArchiveWriter::Add(const char* pName, AssetType type, size_t size)
+{
+	uint64_t hash = AssetNameHash(pName);
+	for(size_t i = 0; i < m_Assets.size(); ++i)
+	{
+		if(m_Assets[i].NameHash == hash)
+			return NULL;
+	}
+
+	m_Assets.push_back(PendingAsset());
+	PendingAsset* pAsset = &m_Assets.back();
+	pAsset->Name = pName;
+	pAsset->NameHash = hash;
+	pAsset->Type = type;
+	pAsset->Data.resize(size);
+	return pAsset;
+}
+
+bool AssetArchiveWriter::AddAsset(const char* pName, AssetType type, const void* pData, size_t size)
+{
+	PendingAsset* pAsset = Add(pName, type, size);
+	if(!pAsset)
+		return false;
+	if(size)
+		memcpy(&pAsset->Data[0], pData, size);
+	return true;
+}
+
+bool AssetArchiveWriter::AddRaw(const char* pName, const void* pData, size_t size)
+{
+	return AddAsset(pName, ASSET_RAW, pData, size);
+}
+
+bool AssetArchiveWriter::AddMesh(const char* pName, const void* pVertices, unsigned vertexCount, unsigned stride, RDWORD fvf,
+	const void* pIndices, unsigned indexCount, RDIndexFormat indexFormat, bool compressIndices)
+{
+	//Vertices and indices 16 byte aligned inside the asset
+	unsigned indexSize = indexFormat == RD_FMT_INDEX32 ? 4 : 2;
+	MeshAssetHeader header;
+	header.VertexCount = vertexCount;
+	header.IndexCount = pIndices ? indexCount : 0;
+	header.Stride = stride;
+	header.FVF = fvf;
+	header.IndexFormat = indexFormat;
+	header.VertexOffset = sizeof(MeshAssetHeader);
+	header.IndexOffset = (uint32_t)AlignUp(header.VertexOffset + (uint64_t)vertexCount * stride, 16);
+	header.Flags = 0;
+
+	std::vector<uint8_t> compressed;
+	if(compressIndices && header.IndexCount)
+	{
+		std::vector<uint32_t> indices(header.IndexCount);
+		for(unsigned i = 0; i < header.IndexCount; ++i)
+			indices[i] = indexSize == 4 ? ((const uint32_t*)pIndices)[i] : ((const uint16_t*)pIndices)[i];
+		MeshEncodeIndices(&compressed, &indices[0], header.IndexCount);
+		header.Flags |= MESH_ASSET_COMPRESSED_INDICES;
+	}
+
+	size_t indexBytes = header.Flags & MESH_ASSET_COMPRESSED_INDICES ? compressed.size() : (size_t)header.IndexCount * indexSize;
+	PendingAsset* pAsset = Add(pName, ASSET_MESH, header.IndexOffset + indexBytes);
+	if(!pAsset)
+		return false;
+	memcpy(&pAsset->Data[0], &header, sizeof(header));
+	memcpy(&pAsset->Data[header.VertexOffset], pVertices, (size_t)vertexCount * stride);
+	if(indexBytes)
+		memcpy(&pAsset->Data[header.IndexOffset], compressed.empty() ? pIndices : &compressed[0], indexBytes);
+	return true;
+}
+
+bool AssetArchiveWriter::AddTexture(const char* pName, const void* pPixels, unsigned width, unsigned height)
+{
+	TextureAssetHeader header;
+	header.Width = width;
+	header.Height = height;
+	header.Pitch = width * 4;
+	header.DataOffset = 16;
+
+	PendingAsset* pAsset = Add(pName, ASSET_TEXTURE, header.DataOffset + (size_t)header.Pitch * height);
+	if(!pAsset)
+		return false;
+	memcpy(&pAsset->Data[0], &header, sizeof(header));
+	memcpy(&pAsset->Data[header.DataOffset], pPixels, (size_t)header.Pitch * height);
+	return true;
+}
+
+bool AssetArchiveWriter::Write(const char* pPath) const
+{
+	//Entries sorted by hash so the reader can binary search them
+	std::vector<std::pair<uint64_t, unsigned> > sorted(m_Assets.size());
+	for(size_t i = 0; i < sorted.size(); ++i)
+		sorted[i] = std::make_pair(m_Assets[i].NameHash, (unsigned)i);
+	std::sort(sorted.begin(), sorted.end());
+	std::vector<unsigned> order(sorted.size());
+	for(size_t i = 0; i < sorted.size(); ++i)
+		order[i] = sorted[i].second;
+
+	//Data in insertion order, each asset aligned
+	std::vector<AssetEntry> entries(m_Assets.size());
+	std::string names;
+	uint64_t offset = AlignUp(sizeof(AssetArchiveHeader), m_Alignment);
+	for(size_t i = 0; i < order.size(); ++i)
+	{
+		const PendingAsset& asset = m_Assets[order[i]];
+		entries[i].NameHash = asset.NameHash;
+		entries[i].Type = asset.Type;
+		entries[i].Size = asset.Data.size();
+		entries[i].NameOffset = (uint32_t)names.size();
+		names.append(asset.Name.c_str(), asset.Name.size() + 1);
+	}
+	std::vector<uint64_t> offsets(m_Assets.size());
+	for(size_t i = 0; i < m_Assets.size(); ++i)
+	{
+		offsets[i] = offset;
+		offset = AlignUp(offset + m_Assets[i].Data.size(), m_Alignment);
+	}
+	for(size_t i = 0; i < order.size(); ++i)
+		entries[i].Offset = offsets[order[i]];
+
+	AssetArchiveHeader header;
+	header.Magic = ASSET_ARCHIVE_MAGIC;
+	header.Version = ASSET_ARCHIVE_VERSION;
+	header.EntryCount = (uint32_t)entries.size();
+	header.Alignment = m_Alignment;
+	header.TableOffset = offset;
+	//The names always end with a zero, so an empty archive still has one
+	if(names.empty())
+		names.push_back('\0');
+	header.FileSize = offset + entries.size() * sizeof(AssetEntry) + names.size();
+
+	FILE* f = fopen(pPath, "wb");
+	if(!f)
+		return false;
+
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	uint64_t written = sizeof(header);
+	std::vector<uint8_t> padding(m_Alignment, 0);
+	for(size_t i = 0; i < m_Assets.size() && ok; ++i)
+	{
+		const std::vector<uint8_t>& data = m_Assets[i].Data;
+		ok = fwrite(&padding[0], 1, (size_t)(offsets[i] - written), f) == offsets[i] - written;
+		ok = ok && (data.empty() || fwrite(&data[0], 1, data.size(), f) == data.size());
+		written = offsets[i] + data.size();
+	}
+	ok = ok && fwrite(&padding[0], 1, (size_t)(offset - written), f) == offset - written;
+	ok = ok && (entries.empty() || fwrite(&entries[0], sizeof(AssetEntry), entries.size(), f) == entries.size());
+	ok = ok && fwrite(names.data(), 1, names.size(), f) == names.size();
+
+	return fclose(f) == 0 && ok;
+}
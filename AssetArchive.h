@@ -0,0 +1,160 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Packed asset archive. One file holds a header, the asset data
+				(every asset aligned, page aligned by default) and a table of
+				entries sorted by name hash. The reader memory maps the file, so
+				vertex and index data can be copied straight from the mapping into
+				device buffers. Little endian, same layout on Windows and Linux.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <string>
+#include <vector>
+
+enum AssetType
+{
+	ASSET_RAW,
+	ASSET_MESH,
+	ASSET_TEXTURE,
+	ASSET_SHADER,		//See ShaderCache.h
+	ASSET_PIPELINE
+};
+
+//File layout, every struct is a multiple of 8 bytes
+struct AssetArchiveHeader
+{
+	uint32_t	Magic;			//ASSET_ARCHIVE_MAGIC
+	uint32_t	Version;
+	uint32_t	EntryCount;
+	uint32_t	Alignment;		//Alignment of every asset in the file
+	uint64_t	TableOffset;	//AssetEntry[EntryCount], then the names
+	uint64_t	FileSize;
+};
+
+struct AssetEntry
+{
+	uint64_t	NameHash;		//AssetNameHash() of the name, the table is sorted by it
+	uint64_t	Offset;			//Asset data, from the start of the file
+	uint64_t	Size;
+	uint32_t	Type;			//AssetType
+	uint32_t	NameOffset;		//Name (zero terminated), from the end of the table
+};
+
+//At the start of an ASSET_MESH asset
+struct MeshAssetHeader
+{
+	uint32_t	VertexCount;
+	uint32_t	IndexCount;		//0 for non indexed meshes
+	uint32_t	Stride;
+	uint32_t	FVF;
+	uint32_t	IndexFormat;	//RD_FMT_INDEX16 or RD_FMT_INDEX32
+	uint32_t	VertexOffset;	//From the start of the asset
+	uint32_t	IndexOffset;
+	uint32_t	Flags;			//MeshAssetFlags
+};
+
+enum MeshAssetFlags
+{
+	//The indices are MeshEncodeIndices() output running to the end of the asset,
+	//MeshDecodeIndices() expands them to IndexFormat at load
+	MESH_ASSET_COMPRESSED_INDICES = 1
+};
+
+//At the start of an ASSET_TEXTURE asset
+struct TextureAssetHeader
+{
+	uint32_t	Width;
+	uint32_t	Height;
+	uint32_t	Pitch;			//Bytes per row
+	uint32_t	DataOffset;		//A8R8G8B8 pixels, from the start of the asset
+};
+
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4B505844;	//"DXPK"
+const uint32_t ASSET_ARCHIVE_VERSION = 2;	//Version 1 has no mesh flags, still readable
+
+//64 bit FNV-1a of an asset name
+uint64_t AssetNameHash(const char* pName);
+
+class AssetArchive
+{
+public:
+	AssetArchive();
+	~AssetArchive();
+
+	//Maps the file (reads it into memory if mapping fails). False if it is not a valid archive.
+	bool Open(const char* pPath);
+	void Close();
+
+	bool IsOpen() const { return m_pBase != NULL; }
+	bool IsMapped() const { return m_Mapped; }
+	unsigned GetEntryCount() const { return m_pHeader ? m_pHeader->EntryCount : 0; }
+	const AssetEntry& GetEntry(unsigned index) const { return m_pEntries[index]; }
+	const char* GetName(unsigned index) const { return m_pNames + m_pEntries[index].NameOffset; }
+	//Index of the named entry or -1
+	int Find(const char* pName) const;
+
+	//Asset data inside the mapping, valid until Close()
+	const uint8_t* GetData(unsigned index) const { return m_pBase + m_pEntries[index].Offset; }
+	//Typed views, NULL if the entry has a different type. GetMesh() also returns
+	//NULL for a mesh whose header points outside of its asset.
+	const MeshAssetHeader* GetMesh(unsigned index) const;
+	const TextureAssetHeader* GetTexture(unsigned index) const;
+
+	uint64_t GetFileSize() const { return m_Size; }
+
+private:
+	//Disallow copying
+	AssetArchive(const AssetArchive&);
+	AssetArchive& operator=(const AssetArchive&);
+
+	bool Validate() const;
+
+	const uint8_t*				m_pBase;
+	uint64_t					m_Size;
+	bool						m_Mapped;
+	const AssetArchiveHeader*	m_pHeader;
+	const AssetEntry*			m_pEntries;
+	const char*					m_pNames;
+	std::vector<uint8_t>		m_Copy;			//File contents when mapping is not possible
+#ifdef _WIN32
+	void*						m_hFile;
+	void*						m_hMapping;
+#endif
+};
+
+//Builds archives (asset packing tool, tests). Assets are kept in memory until Write().
+class AssetArchiveWriter
+{
+public:
+	explicit AssetArchiveWriter(uint32_t alignment = 4096);
+
+	//Every add returns false if the name is already taken
+	bool AddAsset(const char* pName, AssetType type, const void* pData, size_t size);
+	bool AddRaw(const char* pName, const void* pData, size_t size);
+	bool AddMesh(const char* pName, const void* pVertices, unsigned vertexCount, unsigned stride, RDWORD fvf,
+		const void* pIndices = NULL, unsigned indexCount = 0, RDIndexFormat indexFormat = RD_FMT_INDEX16,
+		bool compressIndices = false);
+	//A8R8G8B8 pixels, rows of width * 4 bytes
+	bool AddTexture(const char* pName, const void* pPixels, unsigned width, unsigned height);
+
+	bool Write(const char* pPath) const;
+
+	unsigned GetAssetCount() const { return (unsigned)m_Assets.size(); }
+
+private:
+	struct PendingAsset
+	{
+		std::string				Name;
+		uint64_t				NameHash;
+		AssetType				Type;
+		std::vector<uint8_t>	Data;
+	};
+
+	PendingAsset* Add(const char* pName, AssetType type, size_t size);
+
+	uint32_t					m_Alignment;
+	std::vector<PendingAsset>	m_Assets;
+};
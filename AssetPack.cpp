@@ -0,0 +1,336 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Command line tool that builds and lists asset archives. Runs on
+				Linux (and any other non Windows system), build with e.g.
+				g++ -std=c++11 -O2 AssetPack.cpp AssetArchive.cpp MeshOptimizer.cpp MeshLod.cpp -o assetpack
+				Usage:
+				assetpack <out.pak> <name>=<file> ...   .obj files become optimized meshes with
+				                                         compressed indices and a LOD chain (see
+				                                         MeshLod.h), .ppm (P6) files textures,
+				                                         anything else raw data
+				assetpack -grid <out.pak> <count> <size> count test meshes of size x size vertices
+				assetpack -list <file.pak>
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+//The Windows build runs the application instead (see winmain.cpp)
+#ifndef _WIN32
+
+#include "AssetArchive.h"
+#include "MeshOptimizer.h"
+#include "MeshLod.h"
+#include "VertexLayout.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	bool ReadFile(const char* pPath, std::vector<uint8_t>& data)
+	{
+		FILE* f = fopen(pPath, "rb");
+		if(!f)
+			return false;
+		fseek(f, 0, SEEK_END);
+		long size = ftell(f);
+		fseek(f, 0, SEEK_SET);
+		data.resize(size > 0 ? (size_t)size : 0);
+		bool ok = size >= 0 && (data.empty() || fread(&data[0], 1, data.size(), f) == data.size());
+		fclose(f);
+		return ok;
+	}
+
+	bool HasExtension(const char* pPath, const char* pExtension)
+	{
+		size_t length = strlen(pPath), extLength = strlen(pExtension);
+		return length >= extLength && strcasecmp(pPath + length - extLength, pExtension) == 0;
+	}
+
+	//Welds duplicate vertices, then orders triangles for the vertex cache and overdraw
+	//and vertices for fetching (see MeshOptimizer.h)
+	void OptimizeMesh(const char* pName, std::vector<PositionColorVertex>& vertices, std::vector<uint32_t>& indices)
+	{
+		const unsigned CACHE_SIZE = 16;
+		unsigned indexCount = (unsigned)indices.size();
+		MeshCacheStats before = MeshAnalyzeVertexCache(&indices[0], indexCount, (unsigned)vertices.size(), CACHE_SIZE);
+
+		std::vector<uint32_t> remap(vertices.size());
+		unsigned unique = MeshGenerateRemap(&remap[0], &indices[0], indexCount, &vertices[0], (unsigned)vertices.size(),
+			sizeof(PositionColorVertex));
+		std::vector<PositionColorVertex> welded(unique);
+		MeshRemapVertices(&welded[0], &vertices[0], (unsigned)vertices.size(), sizeof(PositionColorVertex), &remap[0]);
+		MeshRemapIndices(&indices[0], &indices[0], indexCount, &remap[0]);
+
+		std::vector<uint32_t> ordered(indexCount);
+		MeshOptimizeVertexCache(&ordered[0], &indices[0], indexCount, unique);
+		MeshOptimizeOverdraw(&indices[0], &ordered[0], indexCount, &welded[0], unique, sizeof(PositionColorVertex), 1.05f);
+		vertices.resize(MeshOptimizeVertexFetch(&vertices[0], &indices[0], indexCount, &welded[0], unique, sizeof(PositionColorVertex)));
+
+		MeshCacheStats after = MeshAnalyzeVertexCache(&indices[0], indexCount, (unsigned)vertices.size(), CACHE_SIZE);
+		printf("%s: %u -> %u vertices, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", pName, (unsigned)remap.size(),
+			(unsigned)vertices.size(), before.ACMR, after.ACMR, before.ATVR, after.ATVR);
+	}
+
+	//Replaces indices with a LOD chain, every level back to back, and adds the level
+	//table as <name>.lod. Meshes the simplifier can not reduce are left alone.
+	bool AddLods(AssetArchiveWriter& writer, const char* pName, const std::vector<PositionColorVertex>& vertices,
+		std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> chain;
+		std::vector<MeshLodLevel> levels;
+		if(MeshGenerateLods(&chain, &levels, &indices[0], (unsigned)indices.size(), &vertices[0], (unsigned)vertices.size(),
+			sizeof(PositionColorVertex)) < 2)
+			return true;
+
+		printf("%s: LOD triangles", pName);
+		for(size_t i = 0; i < levels.size(); ++i)
+			printf(" %u", levels[i].IndexCount / 3);
+		printf("\n");
+		indices.swap(chain);
+		return writer.AddRaw((std::string(pName) + MESH_LOD_SUFFIX).c_str(), &levels[0], levels.size() * sizeof(MeshLodLevel));
+	}
+
+	//Positions and faces of a Wavefront OBJ, faces triangulated as fans
+	bool AddObj(AssetArchiveWriter& writer, const char* pName, const char* pPath)
+	{
+		FILE* f = fopen(pPath, "r");
+		if(!f)
+			return false;
+
+		std::vector<PositionColorVertex> vertices;
+		std::vector<uint32_t> indices;
+		char line[1024];
+		while(fgets(line, sizeof(line), f))
+		{
+			if(line[0] == 'v' && line[1] == ' ')
+			{
+				PositionColorVertex v = { 0.0f, 0.0f, 0.0f, 0xFFFFFFFF };
+				sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z);
+				vertices.push_back(v);
+			}
+			else if(line[0] == 'f' && line[1] == ' ')
+			{
+				std::vector<uint32_t> face;
+				for(char* pToken = strtok(line + 2, " \t\r\n"); pToken; pToken = strtok(NULL, " \t\r\n"))
+				{
+					//"v", "v/vt", "v//vn" or "v/vt/vn", negative indices count from the end
+					long index = strtol(pToken, NULL, 10);
+					if(index < 0)
+						index += (long)vertices.size() + 1;
+					if(index < 1 || index > (long)vertices.size())
+					{
+						fclose(f);
+						return false;
+					}
+					face.push_back((uint32_t)(index - 1));
+				}
+				for(size_t i = 2; i < face.size(); ++i)
+				{
+					indices.push_back(face[0]);
+					indices.push_back(face[i - 1]);
+					indices.push_back(face[i]);
+				}
+			}
+		}
+		fclose(f);
+		if(vertices.empty())
+			return false;
+		if(!indices.empty())
+		{
+			OptimizeMesh(pName, vertices, indices);
+			if(!AddLods(writer, pName, vertices, indices))
+				return false;
+		}
+
+		bool compress = !indices.empty();
+		if(vertices.size() <= 0xFFFF)
+		{
+			std::vector<uint16_t> indices16(indices.begin(), indices.end());
+			return writer.AddMesh(pName, &vertices[0], (unsigned)vertices.size(), sizeof(PositionColorVertex), PositionColorLayout::FVF,
+				indices16.empty() ? NULL : &indices16[0], (unsigned)indices16.size(), RD_FMT_INDEX16, compress);
+		}
+		return writer.AddMesh(pName, &vertices[0], (unsigned)vertices.size(), sizeof(PositionColorVertex), PositionColorLayout::FVF,
+			indices.empty() ? NULL : &indices[0], (unsigned)indices.size(), RD_FMT_INDEX32, compress);
+	}
+
+	//Binary PPM (P6, 8 bits per channel) converted to A8R8G8B8
+	bool AddPpm(AssetArchiveWriter& writer, const char* pName, const char* pPath)
+	{
+		std::vector<uint8_t> file;
+		if(!ReadFile(pPath, file) || file.size() < 2 || file[0] != 'P' || file[1] != '6')
+			return false;
+
+		//Header: width, height and maximum value, each possibly preceded by comments
+		unsigned values[3];
+		size_t pos = 2;
+		for(int i = 0; i < 3; ++i)
+		{
+			while(pos < file.size() && (isspace(file[pos]) || file[pos] == '#'))
+			{
+				if(file[pos] == '#')
+				{
+					while(pos < file.size() && file[pos] != '\n')
+						++pos;
+				}
+				else
+					++pos;
+			}
+			values[i] = 0;
+			while(pos < file.size() && isdigit(file[pos]))
+				values[i] = values[i] * 10 + (file[pos++] - '0');
+		}
+		++pos;
+
+		unsigned width = values[0], height = values[1];
+		if(values[2] != 255 || width == 0 || height == 0 || pos + (size_t)width * height * 3 > file.size())
+			return false;
+
+		std::vector<uint32_t> pixels((size_t)width * height);
+		for(size_t i = 0; i < pixels.size(); ++i, pos += 3)
+			pixels[i] = RD_COLOR_ARGB(255, file[pos], file[pos + 1], file[pos + 2]);
+		return writer.AddTexture(pName, &pixels[0], width, height);
+	}
+
+	//Flat grid of size x size vertices with a color gradient
+	bool AddGrid(AssetArchiveWriter& writer, const char* pName, unsigned size)
+	{
+		std::vector<PositionColorVertex> vertices(size * size);
+		for(unsigned y = 0; y < size; ++y)
+		{
+			for(unsigned x = 0; x < size; ++x)
+			{
+				PositionColorVertex& v = vertices[y * size + x];
+				v.x = (float)x / (size - 1) - 0.5f;
+				v.y = 0.0f;
+				v.z = (float)y / (size - 1) - 0.5f;
+				v.Color = RD_COLOR_ARGB(255, x * 255 / (size - 1), y * 255 / (size - 1), 128);
+			}
+		}
+
+		std::vector<uint32_t> indices;
+		indices.reserve((size - 1) * (size - 1) * 6);
+		for(unsigned y = 0; y + 1 < size; ++y)
+		{
+			for(unsigned x = 0; x + 1 < size; ++x)
+			{
+				uint32_t i = y * size + x;
+				indices.push_back(i);
+				indices.push_back(i + size);
+				indices.push_back(i + 1);
+				indices.push_back(i + 1);
+				indices.push_back(i + size);
+				indices.push_back(i + size + 1);
+			}
+		}
+		return writer.AddMesh(pName, &vertices[0], (unsigned)vertices.size(), sizeof(PositionColorVertex), PositionColorLayout::FVF,
+			&indices[0], (unsigned)indices.size(), RD_FMT_INDEX32);
+	}
+
+	int List(const char* pPath)
+	{
+		int64_t start = TimerTicks();
+		AssetArchive archive;
+		if(!archive.Open(pPath))
+		{
+			fprintf(stderr, "%s: not a valid archive\n", pPath);
+			return 1;
+		}
+		double openMs = TicksToMs(TimerTicks() - start);
+
+		static const char* s_TypeNames[] = { "raw", "mesh", "texture", "shader", "pipeline" };
+		for(unsigned i = 0; i < archive.GetEntryCount(); ++i)
+		{
+			const AssetEntry& entry = archive.GetEntry(i);
+			printf("%-32s %-8s %12llu bytes at %llu", archive.GetName(i), entry.Type <= ASSET_PIPELINE ? s_TypeNames[entry.Type] : "?",
+				(unsigned long long)entry.Size, (unsigned long long)entry.Offset);
+			if(const MeshAssetHeader* pMesh = archive.GetMesh(i))
+				printf(", %u vertices, %u indices%s", pMesh->VertexCount, pMesh->IndexCount,
+					pMesh->Flags & MESH_ASSET_COMPRESSED_INDICES ? " (compressed)" : "");
+			if(const TextureAssetHeader* pTexture = archive.GetTexture(i))
+				printf(", %u x %u", pTexture->Width, pTexture->Height);
+			printf("\n");
+		}
+		printf("%u assets, %llu bytes, %s in %.3f ms\n", archive.GetEntryCount(), (unsigned long long)archive.GetFileSize(),
+			archive.IsMapped() ? "mapped" : "read", openMs);
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if(argc >= 3 && strcmp(argv[1], "-list") == 0)
+		return List(argv[2]);
+
+	AssetArchiveWriter writer;
+	const char* pOut = NULL;
+	if(argc >= 5 && strcmp(argv[1], "-grid") == 0)
+	{
+		pOut = argv[2];
+		unsigned count = (unsigned)atoi(argv[3]), size = (unsigned)atoi(argv[4]);
+		if(size < 2)
+		{
+			fprintf(stderr, "Grid size must be at least 2\n");
+			return 1;
+		}
+		for(unsigned i = 0; i < count; ++i)
+		{
+			char name[32];
+			sprintf(name, "grid%u", i);
+			AddGrid(writer, name, size);
+		}
+	}
+	else if(argc >= 3 && argv[1][0] != '-')
+	{
+		pOut = argv[1];
+		for(int arg = 2; arg < argc; ++arg)
+		{
+			std::string name(argv[arg]);
+			size_t split = name.find('=');
+			if(split == std::string::npos || split == 0)
+			{
+				fprintf(stderr, "Expected <name>=<file>: %s\n", argv[arg]);
+				return 1;
+			}
+			const char* pFile = argv[arg] + split + 1;
+			name.resize(split);
+
+			bool added;
+			if(HasExtension(pFile, ".obj"))
+				added = AddObj(writer, name.c_str(), pFile);
+			else if(HasExtension(pFile, ".ppm"))
+				added = AddPpm(writer, name.c_str(), pFile);
+			else
+			{
+				std::vector<uint8_t> data;
+				added = ReadFile(pFile, data) && writer.AddRaw(name.c_str(), data.empty() ? NULL : &data[0], data.size());
+			}
+			if(!added)
+			{
+				fprintf(stderr, "Failed to add %s (unreadable, invalid or duplicate name)\n", argv[arg]);
+				return 1;
+			}
+		}
+	}
+	else
+	{
+		fprintf(stderr, "Usage: assetpack <out.pak> <name>=<file> ...\n"
+			"       assetpack -grid <out.pak> <count> <size>\n"
+			"       assetpack -list <file.pak>\n");
+		return 1;
+	}
+
+	if(!writer.Write(pOut))
+	{
+		fprintf(stderr, "Failed to write %s\n", pOut);
+		return 1;
+	}
+	printf("Wrote %u assets to %s\n", writer.GetAssetCount(), pOut);
+	return 0;
+}
+
+#endif
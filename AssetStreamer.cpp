@@ -0,0 +1,308 @@
+#include "AssetStreamer.h"
+#include "Timer.h"
+#include "Profiler.h"
+#include "MeshOptimizer.h"
+
+#include <string.h>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const unsigned PAGE_SIZE = 4096;
+}
+
+AssetStreamer::AssetStreamer() : m_BytesRead(0), m_LastReadTicks(0)
+{
+	m_pArchive = NULL;
+	m_Sequence = 0;
+	m_Stop = false;
+	m_FirstRequestTicks = 0;
+	m_Requested = 0;
+	m_Resident = 0;
+	m_Failed = 0;
+	m_BytesUploaded = 0;
+	m_LastUploadMs = 0.0;
+	m_MaxUploadMs = 0.0;
+	m_Hitches = 0;
+	m_AllResidentMs = 0.0;
+	m_HitchMs = 2.0;
+}
+
+AssetStreamer::~AssetStreamer()
+{
+	Shutdown();
+}
+
+bool AssetStreamer::Init(const AssetArchive* pArchive, unsigned ioThreads)
+{
+	Shutdown();
+	if(!pArchive || !pArchive->IsOpen())
+		return false;
+
+	m_pArchive = pArchive;
+	unsigned count = pArchive->GetEntryCount();
+	std::vector<std::atomic<int> >(count).swap(m_States);
+	for(unsigned i = 0; i < count; ++i)
+		m_States[i].store(ASSET_UNLOADED, std::memory_order_relaxed);
+	StreamedMesh empty = { NULL, NULL, 0, 0, 0, 0 };
+	m_Meshes.assign(count, empty);
+
+	m_Stop = false;
+	for(unsigned i = 0; i < (ioThreads ? ioThreads : 1); ++i)
+		m_Threads.push_back(std::thread(&AssetStreamer::IOThreadMain, this));
+	return true;
+}
+
+void AssetStreamer::Shutdown()
+{
+	if(!m_Threads.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stop = true;
+		}
+		m_Wake.notify_all();
+		for(size_t i = 0; i < m_Threads.size(); ++i)
+			m_Threads[i].join();
+		m_Threads.clear();
+	}
+
+	for(size_t i = 0; i < m_Meshes.size(); ++i)
+	{
+		SAFE_RELEASE(m_Meshes[i].pVB);
+		SAFE_RELEASE(m_Meshes[i].pIB);
+	}
+	m_Meshes.clear();
+	std::vector<std::atomic<int> >().swap(m_States);
+	m_LoadQueue = std::priority_queue<QueueItem>();
+	m_UploadQueue = std::priority_queue<QueueItem>();
+	m_pArchive = NULL;
+	m_Requested = 0;
+	m_Resident = 0;
+	m_Failed = 0;
+}
+
+int AssetStreamer::Request(const char* pName, int priority)
+{
+	int index = m_pArchive ? m_pArchive->Find(pName) : -1;
+	if(index < 0 || !Request((unsigned)index, priority))
+		return -1;
+	return index;
+}
+
+bool AssetStreamer::Request(unsigned index, int priority)
+{
+	if(!IsRunning() || index >= m_States.size())
+		return false;
+
+	int expected = ASSET_UNLOADED;
+	if(!m_States[index].compare_exchange_strong(expected, ASSET_QUEUED))
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		if(m_Requested == 0)
+			m_FirstRequestTicks = TimerTicks();
+		++m_Requested;
+		QueueItem item = { priority, m_Sequence++, index };
+		m_LoadQueue.push(item);
+	}
+	m_Wake.notify_one();
+	return true;
+}
+
+void AssetStreamer::IOThreadMain()
+{
+	PROFILE_THREAD("Asset IO");
+	for(;;)
+	{
+		QueueItem item;
+		{
+			std::unique_lock<std::mutex> lock(m_Lock);
+			while(!m_Stop && m_LoadQueue.empty())
+				m_Wake.wait(lock);
+			if(m_Stop)
+				return;
+			item = m_LoadQueue.top();
+			m_LoadQueue.pop();
+		}
+
+		uint64_t bytes = 0;
+		{
+			PROFILE_ZONE("Load asset");
+			bytes = Load(item.Index);
+		}
+		m_BytesRead.fetch_add(bytes, std::memory_order_relaxed);
+		m_LastReadTicks.store(TimerTicks(), std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_States[item.Index].store(ASSET_LOADED, std::memory_order_release);
+		m_UploadQueue.push(item);
+	}
+}
+
+uint64_t AssetStreamer::Load(unsigned index)
+{
+	const AssetEntry& entry = m_pArchive->GetEntry(index);
+	if(!m_pArchive->IsMapped() || entry.Size == 0)
+		return entry.Size;
+
+	//Page the asset in here so the upload on the render thread never waits for the disk
+	const uint8_t* pData = m_pArchive->GetData(index);
+#ifndef _WIN32
+	uintptr_t first = (uintptr_t)pData & ~(uintptr_t)(PAGE_SIZE - 1);
+	madvise((void*)first, (size_t)((uintptr_t)pData + entry.Size - first), MADV_WILLNEED);
+#endif
+	volatile uint8_t sink = 0;
+	for(uint64_t offset = 0; offset < entry.Size; offset += PAGE_SIZE)
+		sink += pData[offset];
+	sink += pData[entry.Size - 1];
+	return entry.Size;
+}
+
+unsigned AssetStreamer::GetUploadSize(unsigned index) const
+{
+	const MeshAssetHeader* pMesh = m_pArchive->GetMesh(index);
+	if(!pMesh)
+		return 0;
+	unsigned indexSize = pMesh->IndexFormat == RD_FMT_INDEX32 ? 4 : 2;
+	return pMesh->VertexCount * pMesh->Stride + pMesh->IndexCount * indexSize;
+}
+
+unsigned AssetStreamer::Pump(IRenderDevice* pDevice, unsigned budgetBytes)
+{
+	if(!IsRunning())
+		return 0;
+
+	int64_t start = TimerTicks();
+	unsigned uploaded = 0;
+	unsigned count = 0;
+	for(;;)
+	{
+		QueueItem item;
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if(m_UploadQueue.empty())
+				break;
+			//The budget may be exceeded by the first upload only, so huge assets still arrive
+			item = m_UploadQueue.top();
+			unsigned size = GetUploadSize(item.Index);
+			if(count > 0 && uploaded + size > budgetBytes)
+				break;
+			m_UploadQueue.pop();
+			uploaded += size;
+			++count;
+		}
+
+		bool ok = Upload(pDevice, item.Index);
+		m_States[item.Index].store(ok ? ASSET_RESIDENT : ASSET_FAILED, std::memory_order_release);
+
+		std::lock_guard<std::mutex> lock(m_Lock);
+		if(ok)
+			++m_Resident;
+		else
+			++m_Failed;
+		if(m_Resident + m_Failed == m_Requested)
+			m_AllResidentMs = TicksToMs(TimerTicks() - m_FirstRequestTicks);
+	}
+
+	if(count > 0)
+	{
+		m_LastUploadMs = TicksToMs(TimerTicks() - start);
+		m_MaxUploadMs = std::max(m_MaxUploadMs, m_LastUploadMs);
+		m_BytesUploaded += uploaded;
+		if(m_LastUploadMs > m_HitchMs)
+			++m_Hitches;
+	}
+	else
+		m_LastUploadMs = 0.0;
+	return uploaded;
+}
+
+bool AssetStreamer::Upload(IRenderDevice* pDevice, unsigned index)
+{
+	//Other asset types have nothing to upload, a malformed mesh fails
+	const MeshAssetHeader* pMesh = m_pArchive->GetMesh(index);
+	if(!pMesh)
+		return m_pArchive->GetEntry(index).Type != ASSET_MESH;
+	if(!pDevice)
+		return false;
+
+	//Copied straight from the mapping into the locked buffers
+	const uint8_t* pData = m_pArchive->GetData(index);
+	StreamedMesh& mesh = m_Meshes[index];
+	unsigned vertexBytes = pMesh->VertexCount * pMesh->Stride;
+	void* pDest = NULL;
+	if(!pDevice->CreateVertexBuffer(vertexBytes, RD_USAGE_WRITEONLY, pMesh->FVF, RD_POOL_MANAGED, &mesh.pVB) ||
+		!mesh.pVB->Lock(0, vertexBytes, &pDest, 0))
+	{
+		SAFE_RELEASE(mesh.pVB);
+		return false;
+	}
+	memcpy(pDest, pData + pMesh->VertexOffset, vertexBytes);
+	mesh.pVB->Unlock();
+
+	if(pMesh->IndexCount > 0)
+	{
+		RDIndexFormat format = (RDIndexFormat)pMesh->IndexFormat;
+		unsigned indexBytes = pMesh->IndexCount * (format == RD_FMT_INDEX32 ? 4 : 2);
+		if(!pDevice->CreateIndexBuffer(indexBytes, RD_USAGE_WRITEONLY, format, RD_POOL_MANAGED, &mesh.pIB) ||
+			!mesh.pIB->Lock(0, indexBytes, &pDest, 0))
+		{
+			SAFE_RELEASE(mesh.pVB);
+			SAFE_RELEASE(mesh.pIB);
+			return false;
+		}
+		//Compressed indices decode straight into the locked buffer
+		bool decoded = true;
+		if(pMesh->Flags & MESH_ASSET_COMPRESSED_INDICES)
+			decoded = MeshDecodeIndices(pDest, pMesh->IndexCount, format, pData + pMesh->IndexOffset,
+				(size_t)(m_pArchive->GetEntry(index).Size - pMesh->IndexOffset));
+		else
+			memcpy(pDest, pData + pMesh->IndexOffset, indexBytes);
+		mesh.pIB->Unlock();
+		if(!decoded)
+		{
+			SAFE_RELEASE(mesh.pVB);
+			SAFE_RELEASE(mesh.pIB);
+			return false;
+		}
+	}
+
+	mesh.VertexCount = pMesh->VertexCount;
+	mesh.IndexCount = pMesh->IndexCount;
+	mesh.Stride = pMesh->Stride;
+	mesh.FVF = pMesh->FVF;
+	return true;
+}
+
+const StreamedMesh* AssetStreamer::GetMesh(unsigned index) const
+{
+	if(index >= m_States.size() || GetState(index) != ASSET_RESIDENT || !m_Meshes[index].pVB)
+		return NULL;
+	return &m_Meshes[index];
+}
+
+StreamStats AssetStreamer::GetStats() const
+{
+	StreamStats stats;
+	std::lock_guard<std::mutex> lock(m_Lock);
+	stats.Requested = m_Requested;
+	stats.Resident = m_Resident;
+	stats.Failed = m_Failed;
+	stats.Pending = m_Requested - m_Resident - m_Failed;
+	stats.BytesRead = m_BytesRead.load(std::memory_order_relaxed);
+	stats.BytesUploaded = m_BytesUploaded;
+	double readMs = m_Requested ? TicksToMs(m_LastReadTicks.load(std::memory_order_relaxed) - m_FirstRequestTicks) : 0.0;
+	stats.ReadMBps = readMs > 0.0 ? stats.BytesRead / (readMs * 1000.0) : 0.0;
+	stats.LastUploadMs = m_LastUploadMs;
+	stats.MaxUploadMs = m_MaxUploadMs;
+	stats.Hitches = m_Hitches;
+	stats.AllResidentMs = m_AllResidentMs;
+	return stats;
+}
@@ -0,0 +1,134 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Background asset streaming from an AssetArchive. I/O threads
+				page requested assets in from the mapped archive in priority
+				order; the render thread then uploads finished meshes into device
+				buffers straight from the mapping (compressed indices are decoded
+				into the locked index buffer), limited to a byte budget per frame
+				so large meshes do not cause frame hitches.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "AssetArchive.h"
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+enum AssetState
+{
+	ASSET_UNLOADED,
+	ASSET_QUEUED,		//Waiting for an I/O thread
+	ASSET_LOADED,		//In memory, waiting for the upload
+	ASSET_RESIDENT,		//Uploaded (meshes) or ready to use (other types)
+	ASSET_FAILED
+};
+
+struct StreamedMesh
+{
+	IVertexBuffer*	pVB;
+	IIndexBuffer*	pIB;			//NULL for non indexed meshes
+	unsigned		VertexCount;
+	unsigned		IndexCount;
+	unsigned		Stride;
+	RDWORD			FVF;
+};
+
+struct StreamStats
+{
+	unsigned	Requested;
+	unsigned	Resident;
+	unsigned	Failed;				//Uploads the device refused
+	unsigned	Pending;			//Queued or waiting for the upload
+	uint64_t	BytesRead;			//Paged in by the I/O threads
+	uint64_t	BytesUploaded;
+	double		ReadMBps;			//BytesRead over the time from the first request to the last read
+	double		LastUploadMs;		//Upload time of the last Pump()
+	double		MaxUploadMs;
+	unsigned	Hitches;			//Pumps whose uploads took longer than the hitch threshold
+	double		AllResidentMs;		//From the first request until nothing was pending (last time it happened)
+};
+
+class AssetStreamer
+{
+public:
+	AssetStreamer();
+	~AssetStreamer();
+
+	//Starts the I/O threads for an open archive, which must outlive the streamer
+	bool Init(const AssetArchive* pArchive, unsigned ioThreads = 2);
+	//Stops the threads and releases every device buffer
+	void Shutdown();
+	bool IsRunning() const { return !m_Threads.empty(); }
+
+	//Queues an asset, higher priorities load and upload first. Requests of
+	//assets already queued or loaded are ignored. Returns the entry index or -1.
+	int Request(const char* pName, int priority = 0);
+	bool Request(unsigned index, int priority = 0);
+
+	//Render thread, once per frame: uploads loaded assets until budgetBytes are
+	//used (always at least one). Returns the bytes uploaded.
+	unsigned Pump(IRenderDevice* pDevice, unsigned budgetBytes);
+
+	AssetState GetState(unsigned index) const { return (AssetState)m_States[index].load(std::memory_order_acquire); }
+	//NULL until the mesh is resident
+	const StreamedMesh* GetMesh(unsigned index) const;
+	const AssetArchive* GetArchive() const { return m_pArchive; }
+
+	//Pumps slower than this count as hitches
+	void SetHitchThreshold(double ms) { m_HitchMs = ms; }
+	StreamStats GetStats() const;
+
+private:
+	//Disallow copying
+	AssetStreamer(const AssetStreamer&);
+	AssetStreamer& operator=(const AssetStreamer&);
+
+	struct QueueItem
+	{
+		int			Priority;
+		uint32_t	Sequence;		//FIFO among equal priorities
+		uint32_t	Index;
+
+		bool operator<(const QueueItem& other) const
+		{
+			return Priority != other.Priority ? Priority < other.Priority : Sequence > other.Sequence;
+		}
+	};
+
+	void IOThreadMain();
+	//Pages the asset in, returns the bytes touched
+	uint64_t Load(unsigned index);
+	bool Upload(IRenderDevice* pDevice, unsigned index);
+	unsigned GetUploadSize(unsigned index) const;
+
+	const AssetArchive*				m_pArchive;
+	std::vector<std::atomic<int> >	m_States;		//AssetState of every entry
+	std::vector<StreamedMesh>		m_Meshes;		//Written by the render thread only
+	std::vector<std::thread>		m_Threads;
+
+	mutable std::mutex				m_Lock;
+	std::condition_variable			m_Wake;
+	std::priority_queue<QueueItem>	m_LoadQueue;
+	std::priority_queue<QueueItem>	m_UploadQueue;
+	uint32_t						m_Sequence;
+	bool							m_Stop;
+
+	//Statistics
+	std::atomic<uint64_t>			m_BytesRead;
+	std::atomic<int64_t>			m_LastReadTicks;
+	int64_t							m_FirstRequestTicks;
+	unsigned						m_Requested;
+	unsigned						m_Resident;
+	unsigned						m_Failed;
+	uint64_t						m_BytesUploaded;
+	double							m_LastUploadMs;
+	double							m_MaxUploadMs;
+	unsigned						m_Hitches;
+	double							m_AllResidentMs;
+	double							m_HitchMs;
+};
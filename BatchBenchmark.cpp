@@ -0,0 +1,218 @@
+#include "BatchBenchmark.h"
+#include "BatchRenderer.h"
+#include "NullRenderDevice.h"
+#include "VertexLayout.h"
+#include "SimdMath.h"
+#include "Timer.h"
+
+#include <vector>
+
+namespace
+{
+	//Ring check: rings of 64 vertices and 96 indices
+	const unsigned RING_VERTEX_BYTES = 64 * sizeof(PositionColorVertex);
+	const unsigned RING_INDICES = 96;
+
+	//Quads submitted in a row with one key, they merge into one batch
+	struct RingRun
+	{
+		unsigned	Frame;
+		unsigned	Quads;
+		uint32_t	Key;
+	};
+
+	const RingRun RING_RUNS[] =
+	{
+		{ 0, 4, 1 }, { 0, 2, 2 },
+		{ 1, 6, 1 }, { 1, 5, 3 }
+	};
+	const unsigned RING_FRAMES = 2;
+
+	struct RingFrame
+	{
+		unsigned	DrawCalls;
+		unsigned	NoOverwriteLocks;		//Vertex and index buffer
+		unsigned	DiscardLocks;
+	};
+
+	//Frame 0: two batches from the start of the rings. Frame 1: one batch behind
+	//them (768 of 1024 bytes, 72 of 96 indices), then one that fits in neither ring
+	//and wraps both.
+	const RingFrame RING_EXPECTED[RING_FRAMES] = { { 2, 4, 0 }, { 2, 2, 2 } };
+
+	//Throughput: quads moved to world space while batching, the key changes every KEY_RUN quads
+	const unsigned QUADS = 50000;
+	const unsigned KEY_RUN = 256;
+	const unsigned FRAMES = 30;
+
+	const uint16_t QUAD_INDICES[6] = { 0, 1, 2, 2, 1, 3 };
+
+	void MakeQuad(PositionColorVertex* pQuad, float size, RDCOLOR color)
+	{
+		for(unsigned i = 0; i < 4; ++i)
+		{
+			PositionColorVertex v = { (i & 1) ? size : 0.0f, (i & 2) ? 0.0f : size, 0.0f, color };
+			pQuad[i] = v;
+		}
+	}
+
+	bool SubmitQuads(BatchRenderer& batcher, const PositionColorVertex* pQuad, unsigned count, uint32_t key)
+	{
+		bool ok = true;
+		for(unsigned i = 0; i < count; ++i)
+			ok = batcher.SubmitQuad(pQuad, sizeof(PositionColorVertex), PositionColorLayout::FVF, key) && ok;
+		return ok;
+	}
+
+	//The fixed sequence must give the expected draws and locks frame by frame
+	bool CheckRing(FILE* pOut)
+	{
+		NullRenderDevice device(64, 64);
+		BatchRenderer batcher;
+		bool ok = batcher.Init(&device, RING_VERTEX_BYTES, RING_INDICES);
+		PositionColorVertex quad[4];
+		MakeQuad(quad, 1.0f, 0xFFFFFFFF);
+
+		unsigned quads = 0;
+		for(unsigned frame = 0; frame < RING_FRAMES && ok; ++frame)
+		{
+			device.ResetCounters();
+			batcher.BeginFrame();
+			for(unsigned i = 0; i < sizeof(RING_RUNS) / sizeof(RING_RUNS[0]); ++i)
+			{
+				if(RING_RUNS[i].Frame == frame)
+				{
+					ok = SubmitQuads(batcher, quad, RING_RUNS[i].Quads, RING_RUNS[i].Key) && ok;
+					quads += RING_RUNS[i].Quads;
+				}
+			}
+			batcher.EndFrame();
+
+			const NullDeviceCounters& counters = device.GetCounters();
+			const BatchStats& stats = batcher.GetStats();
+			const RingFrame& expected = RING_EXPECTED[frame];
+			bool match = counters.DrawIndexedPrimitive == expected.DrawCalls && stats.DrawCalls == expected.DrawCalls &&
+				counters.NoOverwriteLocks == expected.NoOverwriteLocks && counters.DiscardLocks == expected.DiscardLocks &&
+				stats.RingWraps == expected.DiscardLocks;
+			fprintf(pOut, "Ring frame %u: %u draws, %u NOOVERWRITE and %u DISCARD locks, expected %u, %u and %u%s\n",
+				frame, counters.DrawIndexedPrimitive, counters.NoOverwriteLocks, counters.DiscardLocks,
+				expected.DrawCalls, expected.NoOverwriteLocks, expected.DiscardLocks, match ? "" : "  MISMATCH");
+			ok = ok && match;
+		}
+		return ok && quads > 0;
+	}
+
+	//Between OnLostDevice() and OnResetDevice() nothing is drawn, and what was
+	//pending in the lost frame is not drawn after the reset either
+	bool CheckDeviceLoss(FILE* pOut)
+	{
+		NullRenderDevice device(64, 64);
+		BatchRenderer batcher;
+		bool ok = batcher.Init(&device, RING_VERTEX_BYTES, RING_INDICES);
+		PositionColorVertex quad[4];
+		MakeQuad(quad, 1.0f, 0xFFFFFFFF);
+
+		device.ResetCounters();
+		batcher.BeginFrame();
+		ok = SubmitQuads(batcher, quad, 2, 1) && ok;
+		device.SimulateDeviceLoss();
+		batcher.OnLostDevice();
+		bool rejected = !batcher.SubmitQuad(quad, sizeof(PositionColorVertex), PositionColorLayout::FVF, 1);
+		batcher.EndFrame();
+		unsigned lostDraws = device.GetCounters().DrawIndexedPrimitive + device.GetCounters().Locks;
+
+		RDPresentParams params = { 64, 64, true };
+		bool reset = device.Reset(params) && batcher.OnResetDevice();
+		device.ResetCounters();
+		batcher.BeginFrame();
+		ok = SubmitQuads(batcher, quad, 1, 1) && ok;
+		batcher.EndFrame();
+		const NullDeviceCounters& counters = device.GetCounters();
+		bool redrawn = counters.DrawIndexedPrimitive == 1 && counters.Primitives == 2;
+
+		fprintf(pOut, "Device loss: %u draws or locks while lost, submissions %s, reset %s, %u triangles after it%s\n",
+			lostDraws, rejected ? "rejected" : "ACCEPTED", reset ? "done" : "FAILED", counters.Primitives,
+			redrawn ? "" : " (expected 2)");
+		return ok && lostDraws == 0 && rejected && reset && redrawn;
+	}
+
+	//A mesh with an index past its vertices is rejected whole, the meshes around
+	//it still merge into one draw
+	bool CheckIndices(FILE* pOut)
+	{
+		NullRenderDevice device(64, 64);
+		BatchRenderer batcher;
+		bool ok = batcher.Init(&device, RING_VERTEX_BYTES, RING_INDICES);
+		PositionColorVertex quad[4];
+		MakeQuad(quad, 1.0f, 0xFFFFFFFF);
+		const uint16_t badIndices[6] = { 0, 1, 2, 2, 1, 4 };
+
+		device.ResetCounters();
+		batcher.BeginFrame();
+		ok = SubmitQuads(batcher, quad, 1, 1) && ok;
+		bool rejected = !batcher.SubmitMesh(quad, 4, sizeof(PositionColorVertex), PositionColorLayout::FVF, badIndices, 6, 1);
+		ok = SubmitQuads(batcher, quad, 1, 1) && ok;
+		batcher.EndFrame();
+		const NullDeviceCounters& counters = device.GetCounters();
+		const BatchStats& stats = batcher.GetStats();
+		bool drawn = counters.DrawIndexedPrimitive == 1 && counters.Primitives == 4 && stats.Submissions == 2 && stats.Vertices == 8;
+
+		fprintf(pOut, "Out of range index: mesh %s, %u draws of %u triangles from %u vertices%s\n",
+			rejected ? "rejected" : "ACCEPTED", counters.DrawIndexedPrimitive, counters.Primitives, stats.Vertices,
+			drawn ? "" : " (expected 1, 4 and 8)");
+		return ok && rejected && drawn;
+	}
+}
+
+bool RunBatchBenchmarks(FILE* pOut)
+{
+	fprintf(pOut, "Batch renderer (%u vertex, %u index ring for the checks)\n",
+		RING_VERTEX_BYTES / (unsigned)sizeof(PositionColorVertex), RING_INDICES);
+	bool ok = CheckRing(pOut);
+	ok = CheckDeviceLoss(pOut) && ok;
+	ok = CheckIndices(pOut) && ok;
+
+	//Throughput through the default rings
+	NullRenderDevice device(1280, 720);
+	BatchRenderer batcher;
+	ok = batcher.Init(&device) && ok;
+	PositionColorVertex quad[4];
+	MakeQuad(quad, 0.5f, 0xFF80C0FF);
+
+	std::vector<Mat4> world(QUADS);
+	uint32_t seed = 777;
+	for(unsigned i = 0; i < QUADS; ++i)
+		world[i] = Mat4Translation(RandomFloat(seed) * 100.0f, RandomFloat(seed) * 100.0f, RandomFloat(seed) * 100.0f);
+
+	bool consistent = true;
+	int64_t ticks = 0;
+	for(unsigned frame = 0; frame < FRAMES; ++frame)
+	{
+		device.ResetCounters();
+		int64_t start = TimerTicks();
+		batcher.BeginFrame();
+		for(unsigned i = 0; i < QUADS; ++i)
+		{
+			consistent = batcher.SubmitMesh(quad, 4, sizeof(PositionColorVertex), PositionColorLayout::FVF, QUAD_INDICES, 6,
+				i / KEY_RUN % 8, world[i]) && consistent;
+		}
+		batcher.EndFrame();
+		ticks += TimerTicks() - start;
+
+		//Every batch is one draw from one vertex and one index lock, wraps are the DISCARD ones
+		const NullDeviceCounters& counters = device.GetCounters();
+		const BatchStats& stats = batcher.GetStats();
+		consistent = consistent && stats.Submissions == QUADS && counters.Primitives == 2 * QUADS &&
+			counters.DrawIndexedPrimitive == stats.DrawCalls && counters.Locks == 2 * stats.DrawCalls &&
+			counters.DiscardLocks == stats.RingWraps && counters.NoOverwriteLocks + counters.DiscardLocks == counters.Locks;
+	}
+
+	const BatchStats& stats = batcher.GetStats();
+	fprintf(pOut, "%u quads in runs of %u: %.3f ms per frame, %u submissions, %u draws, %.1f MB uploaded, %u ring wraps%s\n",
+		QUADS, KEY_RUN, TicksToMs(ticks) / FRAMES, stats.Submissions, stats.DrawCalls, stats.BytesUploaded / (1024.0 * 1024.0),
+		stats.RingWraps, consistent ? "" : "  INCONSISTENT");
+	ok = ok && consistent;
+
+	fprintf(pOut, "%s\n", ok ? "Batch renderer works" : "Batch renderer FAILED");
+	return ok;
+}
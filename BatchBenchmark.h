@@ -0,0 +1,17 @@
+/* Title: DirectX 9.0c Framework
+/* Description: BatchRenderer benchmark on the null device: replays a fixed
+				sequence of quads through small ring buffers and checks the
+				draw calls and the NOOVERWRITE and DISCARD locks it must produce,
+				checks that a lost device neither draws nor touches the released
+				buffers and that meshes with out of range indices are rejected,
+				then streams 50k transformed quads per frame through the default
+				rings.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if the draws or locks are not the expected ones
+bool RunBatchBenchmarks(FILE* pOut);
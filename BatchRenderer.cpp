@@ -0,0 +1,258 @@
+#include "BatchRenderer.h"
+
+#include <string.h>
+
+namespace
+{
+	//16 bit indices limit a single batch to 65536 vertices
+	const unsigned MAX_BATCH_VERTICES = 65536;
+
+	const uint16_t QUAD_INDICES[6] = { 0, 1, 2, 2, 1, 3 };
+
+	//Copies vertices, transforming positions (and normals) by a row major world matrix
+	void TransformVertices(uint8_t* pDst, const uint8_t* pSrc, unsigned count, unsigned stride, RDWORD fvf, const float* m)
+	{
+		bool hasNormal = (fvf & RD_FVF_NORMAL) != 0;
+		for(unsigned i = 0; i < count; ++i, pDst += stride, pSrc += stride)
+		{
+			memcpy(pDst, pSrc, stride);
+
+			const float* p = (const float*)pSrc;
+			float* out = (float*)pDst;
+			out[0] = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+			out[1] = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+			out[2] = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
+
+			//Normals follow the position and ignore translation
+			if(hasNormal)
+			{
+				out[3] = p[3] * m[0] + p[4] * m[4] + p[5] * m[8];
+				out[4] = p[3] * m[1] + p[4] * m[5] + p[5] * m[9];
+				out[5] = p[3] * m[2] + p[4] * m[6] + p[5] * m[10];
+			}
+		}
+	}
+}
+
+BatchRenderer::BatchRenderer()
+{
+	m_pDevice = NULL;
+	m_pVB = NULL;
+	m_pIB = NULL;
+	m_VertexBytes = 0;
+	m_MaxIndices = 0;
+	m_VertexCursor = 0;
+	m_IndexCursor = 0;
+	m_PendingVertexBytes = 0;
+	m_PendingVertices = 0;
+	m_PendingIndices = 0;
+	m_PendingStride = 0;
+	m_PendingFVF = 0;
+	m_PendingKey = 0;
+	m_StateCallback = NULL;
+	m_pStateContext = NULL;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+BatchRenderer::~BatchRenderer()
+{
+	Shutdown();
+}
+
+bool BatchRenderer::Init(IRenderDevice* pDevice, unsigned vertexBytes, unsigned maxIndices)
+{
+	m_pDevice = pDevice;
+	m_VertexBytes = vertexBytes;
+	m_MaxIndices = maxIndices;
+
+	//Staging memory is allocated once, submissions never allocate
+	m_StagingVertices.resize(vertexBytes);
+	m_StagingIndices.resize(maxIndices);
+
+	return CreateBuffers();
+}
+
+void BatchRenderer::Shutdown()
+{
+	ReleaseBuffers();
+	m_pDevice = NULL;
+}
+
+bool BatchRenderer::CreateBuffers()
+{
+	if(!m_pDevice->CreateVertexBuffer(m_VertexBytes, RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, 0, RD_POOL_DEFAULT, &m_pVB))
+		return false;
+	if(!m_pDevice->CreateIndexBuffer(m_MaxIndices * sizeof(uint16_t), RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY,
+		RD_FMT_INDEX16, RD_POOL_DEFAULT, &m_pIB))
+		return false;
+
+	m_VertexCursor = 0;
+	m_IndexCursor = 0;
+	return true;
+}
+
+void BatchRenderer::ReleaseBuffers()
+{
+	SAFE_RELEASE(m_pVB);
+	SAFE_RELEASE(m_pIB);
+}
+
+void BatchRenderer::OnLostDevice()
+{
+	//Pending geometry stays in the staging memory
+	ReleaseBuffers();
+}
+
+bool BatchRenderer::OnResetDevice()
+{
+	return CreateBuffers();
+}
+
+void BatchRenderer::SetStateCallback(BatchStateCallback callback, void* pContext)
+{
+	m_StateCallback = callback;
+	m_pStateContext = pContext;
+}
+
+void BatchRenderer::BeginFrame()
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_PendingVertexBytes = 0;
+	m_PendingVertices = 0;
+	m_PendingIndices = 0;
+}
+
+void BatchRenderer::EndFrame()
+{
+	Flush();
+}
+
+bool BatchRenderer::SubmitQuad(const void* pVertices, unsigned stride, RDWORD fvf, uint32_t key)
+{
+	return SubmitMesh(pVertices, 4, stride, fvf, QUAD_INDICES, 6, key);
+}
+
+bool BatchRenderer::SubmitMesh(const void* pVertices, unsigned vertexCount, unsigned stride, RDWORD fvf,
+	const uint16_t* pIndices, unsigned indexCount, uint32_t key, const float* pWorld)
+{
+	if(vertexCount == 0 || indexCount == 0)
+		return true;
+
+	//Meshes that could never fit are rejected (the stride is kept as alignment slack)
+	unsigned bytes = vertexCount * stride;
+	if(!m_pVB || !m_pIB || vertexCount > MAX_BATCH_VERTICES || bytes + stride > m_VertexBytes || indexCount > m_MaxIndices)
+		return false;
+
+	//Start a new batch if the state differs or the batch is full
+	bool compatible = m_PendingIndices > 0 && stride == m_PendingStride && fvf == m_PendingFVF && key == m_PendingKey;
+	if(!compatible ||
+		m_PendingVertices + vertexCount > MAX_BATCH_VERTICES ||
+		m_PendingVertexBytes + bytes + stride > m_VertexBytes ||
+		m_PendingIndices + indexCount > m_MaxIndices)
+	{
+		Flush();
+	}
+	if(m_PendingIndices == 0)
+	{
+		m_PendingStride = stride;
+		m_PendingFVF = fvf;
+		m_PendingKey = key;
+	}
+
+	//Append vertices
+	uint8_t* pDst = &m_StagingVertices[m_PendingVertexBytes];
+	if(pWorld && (fvf & RD_FVF_POSITION_MASK) == RD_FVF_XYZ)
+		TransformVertices(pDst, (const uint8_t*)pVertices, vertexCount, stride, fvf, pWorld);
+	else
+		memcpy(pDst, pVertices, bytes);
+
+	//Append indices, rebased onto the batch. An index past the mesh would read
+	//another mesh's vertices (or past the batch), the whole mesh is rejected then.
+	//Nothing is pending until the counters below move, so the copies are dropped.
+	uint16_t* pDstIndices = &m_StagingIndices[m_PendingIndices];
+	uint16_t base = (uint16_t)m_PendingVertices;
+	for(unsigned i = 0; i < indexCount; ++i)
+	{
+		if(pIndices[i] >= vertexCount)
+			return false;
+		pDstIndices[i] = (uint16_t)(pIndices[i] + base);
+	}
+
+	m_PendingVertexBytes += bytes;
+	m_PendingVertices += vertexCount;
+	m_PendingIndices += indexCount;
+
+	++m_Stats.Submissions;
+	m_Stats.Vertices += vertexCount;
+	m_Stats.Indices += indexCount;
+	return true;
+}
+
+void BatchRenderer::Flush()
+{
+	//The ring buffers are gone between OnLostDevice() and OnResetDevice()
+	if(m_PendingIndices == 0 || !m_pVB || !m_pIB)
+		return;
+
+	unsigned stride = m_PendingStride;
+	unsigned vertexBytes = m_PendingVertexBytes;
+	unsigned indexBytes = m_PendingIndices * sizeof(uint16_t);
+
+	//Vertex ring: the batch must start on a whole vertex so it can be addressed
+	//with BaseVertexIndex. Append with NOOVERWRITE, wrap around with DISCARD.
+	unsigned vertexStart = (m_VertexCursor + stride - 1) / stride * stride;
+	RDWORD vertexLock = RD_LOCK_NOOVERWRITE;
+	if(vertexStart + vertexBytes > m_VertexBytes)
+	{
+		vertexStart = 0;
+		vertexLock = RD_LOCK_DISCARD;
+		++m_Stats.RingWraps;
+	}
+
+	//Index ring
+	unsigned indexStart = m_IndexCursor;
+	RDWORD indexLock = RD_LOCK_NOOVERWRITE;
+	if(indexStart + m_PendingIndices > m_MaxIndices)
+	{
+		indexStart = 0;
+		indexLock = RD_LOCK_DISCARD;
+		++m_Stats.RingWraps;
+	}
+
+	//Upload
+	void* pData = NULL;
+	bool uploaded = m_pVB->Lock(vertexStart, vertexBytes, &pData, vertexLock);
+	if(uploaded)
+	{
+		memcpy(pData, &m_StagingVertices[0], vertexBytes);
+		m_pVB->Unlock();
+
+		uploaded = m_pIB->Lock(indexStart * sizeof(uint16_t), indexBytes, &pData, indexLock);
+		if(uploaded)
+		{
+			memcpy(pData, &m_StagingIndices[0], indexBytes);
+			m_pIB->Unlock();
+		}
+	}
+
+	if(uploaded)
+	{
+		m_VertexCursor = vertexStart + vertexBytes;
+		m_IndexCursor = indexStart + m_PendingIndices;
+		m_Stats.BytesUploaded += vertexBytes + indexBytes;
+
+		if(m_StateCallback)
+			m_StateCallback(m_pStateContext, m_pDevice, m_PendingKey);
+
+		m_pDevice->SetStreamSource(0, m_pVB, 0, stride);
+		m_pDevice->SetIndices(m_pIB);
+		m_pDevice->SetFVF(m_PendingFVF);
+		m_pDevice->DrawIndexedPrimitive(RD_PT_TRIANGLELIST, vertexStart / stride, 0,
+			m_PendingVertices, indexStart, m_PendingIndices / 3);
+		++m_Stats.DrawCalls;
+	}
+
+	m_PendingVertexBytes = 0;
+	m_PendingVertices = 0;
+	m_PendingIndices = 0;
+}
@@ -0,0 +1,98 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Batching renderer for small dynamic meshes.
+				Submitted geometry is appended to CPU staging memory, then streamed
+				into one large dynamic vertex/index ring buffer (NOOVERWRITE while
+				there is room, DISCARD when wrapping). Consecutive submissions with
+				the same vertex format and batch key are merged into one draw call.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+
+//Called before a batch is drawn so the application can bind whatever the key stands for
+//(textures, render states, ...). Vertex/index buffers and the FVF are set by the renderer.
+typedef void (*BatchStateCallback)(void* pContext, IRenderDevice* pDevice, uint32_t key);
+
+//Per frame counters
+struct BatchStats
+{
+	unsigned Submissions;		//SubmitMesh/SubmitQuad calls
+	unsigned DrawCalls;			//DrawIndexedPrimitive calls issued
+	unsigned Vertices;
+	unsigned Indices;
+	unsigned BytesUploaded;		//Vertex + index bytes copied into the ring buffers
+	unsigned RingWraps;			//DISCARD locks (vertex and index buffer)
+};
+
+class BatchRenderer
+{
+public:
+	BatchRenderer();
+	~BatchRenderer();
+
+	//Creates the ring buffers. vertexBytes/maxIndices are the ring sizes.
+	bool Init(IRenderDevice* pDevice, unsigned vertexBytes = 4 * 1024 * 1024, unsigned maxIndices = 256 * 1024);
+	void Shutdown();
+
+	//The ring buffers live in the default pool and must follow device resets
+	void OnLostDevice();
+	bool OnResetDevice();
+
+	void SetStateCallback(BatchStateCallback callback, void* pContext);
+
+	//Starts a new frame and clears the statistics. Geometry still pending from a
+	//frame that could not be drawn (device lost) is dropped.
+	void BeginFrame();
+	//Draws whatever is still pending
+	void EndFrame();
+	//Draws the pending batch now (e.g. before changing device state by hand).
+	//While the device is lost the batch stays pending.
+	void Flush();
+
+	//Appends an indexed triangle list. If pWorld is given the positions (first three
+	//floats of every vertex, FVF must contain D3DFVF_XYZ) are transformed to world space
+	//while copying, which lets meshes with different transforms share a draw call.
+	//Returns false if the mesh does not fit into the ring buffers at all or an index
+	//is not below vertexCount; nothing of a rejected mesh is drawn.
+	bool SubmitMesh(const void* pVertices, unsigned vertexCount, unsigned stride, RDWORD fvf,
+		const uint16_t* pIndices, unsigned indexCount, uint32_t key, const float* pWorld = NULL);
+
+	//Appends a quad (4 vertices, two triangles 0-1-2 and 2-1-3)
+	bool SubmitQuad(const void* pVertices, unsigned stride, RDWORD fvf, uint32_t key);
+
+	const BatchStats& GetStats() const { return m_Stats; }
+
+private:
+	//Disallow copying
+	BatchRenderer(const BatchRenderer&);
+	BatchRenderer& operator=(const BatchRenderer&);
+
+	bool CreateBuffers();
+	void ReleaseBuffers();
+
+	IRenderDevice*			m_pDevice;
+	IVertexBuffer*			m_pVB;
+	IIndexBuffer*			m_pIB;
+	unsigned				m_VertexBytes;		//Vertex ring size in bytes
+	unsigned				m_MaxIndices;		//Index ring size in indices
+	unsigned				m_VertexCursor;		//Next free byte in the vertex ring
+	unsigned				m_IndexCursor;		//Next free index in the index ring
+
+	//Pending batch
+	std::vector<uint8_t>	m_StagingVertices;
+	std::vector<uint16_t>	m_StagingIndices;
+	unsigned				m_PendingVertexBytes;
+	unsigned				m_PendingVertices;
+	unsigned				m_PendingIndices;
+	unsigned				m_PendingStride;
+	RDWORD					m_PendingFVF;
+	uint32_t				m_PendingKey;
+
+	BatchStateCallback		m_StateCallback;
+	void*					m_pStateContext;
+	BatchStats				m_Stats;
+};
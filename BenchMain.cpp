@@ -0,0 +1,140 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Console runner for the portable micro-benchmarks, so they can run
+				on machines without Windows or Direct3D. Build on Linux with e.g.
+				g++ -std=c++11 -O2 -pthread BenchMain.cpp JobBenchmark.cpp JobSystem.cpp MathBenchmark.cpp
+				Scene.cpp SceneBenchmark.cpp Culling.cpp CullBenchmark.cpp OcclusionBuffer.cpp
+				BoundingVolumeHierarchy.cpp StreamBenchmark.cpp AssetStreamer.cpp AssetArchive.cpp
+				NullRenderDevice.cpp ResetBenchmark.cpp ResourceRegistry.cpp
+				PacingBenchmark.cpp FramePacer.cpp ProfilerBenchmark.cpp Profiler.cpp
+				ReadbackBenchmark.cpp FrameReadback.cpp FrameSink.cpp SoftwareRenderDevice.cpp
+				InstanceBenchmark.cpp InstanceRenderer.cpp StateCache.cpp ShaderBenchmark.cpp
+				ShaderCache.cpp SpriteBenchmark.cpp TextureAtlas.cpp SpriteBatch.cpp
+				InputBenchmark.cpp InputState.cpp VertexBenchmark.cpp VertexLayout.cpp
+				MeshBenchmark.cpp MeshOptimizer.cpp LodBenchmark.cpp MeshLod.cpp
+				LodSelector.cpp ParticleBenchmark.cpp ParticleSystem.cpp
+				TimestepBenchmark.cpp FixedTimestep.cpp BatchBenchmark.cpp
+				BatchRenderer.cpp CommandBenchmark.cpp CommandList.cpp
+				HeapStats.cpp -o bench
+				(add -mavx to benchmark the AVX paths)
+				Usage: bench [name...], no names runs everything. Exits with 1
+				if any check failed.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+//The Windows build runs the application instead (see winmain.cpp)
+#ifndef _WIN32
+
+#include "JobBenchmark.h"
+#include "MathBenchmark.h"
+#include "SceneBenchmark.h"
+#include "CullBenchmark.h"
+#include "StreamBenchmark.h"
+#include "ResetBenchmark.h"
+#include "PacingBenchmark.h"
+#include "ProfilerBenchmark.h"
+#include "ReadbackBenchmark.h"
+#include "InstanceBenchmark.h"
+#include "ShaderBenchmark.h"
+#include "SpriteBenchmark.h"
+#include "InputBenchmark.h"
+#include "VertexBenchmark.h"
+#include "MeshBenchmark.h"
+#include "LodBenchmark.h"
+#include "ParticleBenchmark.h"
+#include "TimestepBenchmark.h"
+#include "BatchBenchmark.h"
+#include "CommandBenchmark.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+	//The job benchmarks only measure, they have no checks
+	bool RunJobs(FILE* pOut) { RunJobBenchmarks(pOut); return true; }
+	bool RunMath(FILE* pOut) { return RunMathBenchmarks(pOut); }
+	bool RunScene(FILE* pOut) { return RunSceneBenchmarks(pOut); }
+	bool RunCull(FILE* pOut) { return RunCullBenchmarks(pOut); }
+	bool RunStream(FILE* pOut) { return RunStreamBenchmarks(pOut); }
+	bool RunReset(FILE* pOut) { return RunResetBenchmarks(pOut); }
+	bool RunPacing(FILE* pOut) { return RunPacingBenchmarks(pOut); }
+	bool RunProfiler(FILE* pOut) { return RunProfilerBenchmarks(pOut); }
+	bool RunReadback(FILE* pOut) { return RunReadbackBenchmarks(pOut); }
+	bool RunInstancing(FILE* pOut) { return RunInstanceBenchmarks(pOut); }
+	bool RunShaders(FILE* pOut) { return RunShaderBenchmarks(pOut); }
+	bool RunSprites(FILE* pOut) { return RunSpriteBenchmarks(pOut); }
+	bool RunInput(FILE* pOut) { return RunInputBenchmarks(pOut); }
+	bool RunVertices(FILE* pOut) { return RunVertexBenchmarks(pOut); }
+	bool RunMeshes(FILE* pOut) { return RunMeshBenchmarks(pOut); }
+	bool RunLod(FILE* pOut) { return RunLodBenchmarks(pOut); }
+	bool RunParticles(FILE* pOut) { return RunParticleBenchmarks(pOut); }
+	bool RunTimestep(FILE* pOut) { return RunTimestepBenchmarks(pOut); }
+	bool RunBatching(FILE* pOut) { return RunBatchBenchmarks(pOut); }
+	bool RunCommands(FILE* pOut) { return RunCommandBenchmarks(pOut); }
+
+	struct BenchEntry
+	{
+		const char* Name;
+		//Returns false if a check failed
+		bool (*Run)(FILE* pOut);
+	};
+
+	const BenchEntry g_Benchmarks[] =
+	{
+		{ "jobs", RunJobs },
+		{ "math", RunMath },
+		{ "scene", RunScene },
+		{ "cull", RunCull },
+		{ "stream", RunStream },
+		{ "reset", RunReset },
+		{ "pacing", RunPacing },
+		{ "profiler", RunProfiler },
+		{ "readback", RunReadback },
+		{ "instancing", RunInstancing },
+		{ "shaders", RunShaders },
+		{ "sprites", RunSprites },
+		{ "input", RunInput },
+		{ "vertices", RunVertices },
+		{ "meshes", RunMeshes },
+		{ "lod", RunLod },
+		{ "particles", RunParticles },
+		{ "timestep", RunTimestep },
+		{ "batching", RunBatching },
+		{ "commands", RunCommands },
+	};
+	const unsigned g_NumBenchmarks = sizeof(g_Benchmarks) / sizeof(g_Benchmarks[0]);
+}
+
+int main(int argc, char** argv)
+{
+	int ran = 0;
+	bool ok = true;
+	for(unsigned i = 0; i < g_NumBenchmarks; ++i)
+	{
+		bool selected = argc < 2;
+		for(int arg = 1; arg < argc; ++arg)
+			selected = selected || strcmp(argv[arg], g_Benchmarks[i].Name) == 0;
+		if(!selected)
+			continue;
+
+		if(!g_Benchmarks[i].Run(stdout))
+		{
+			fprintf(stderr, "%s: checks FAILED\n", g_Benchmarks[i].Name);
+			ok = false;
+		}
+		fprintf(stdout, "\n");
+		++ran;
+	}
+
+	if(ran == 0)
+	{
+		fprintf(stderr, "Unknown benchmark. Available:");
+		for(unsigned i = 0; i < g_NumBenchmarks; ++i)
+			fprintf(stderr, " %s", g_Benchmarks[i].Name);
+		fprintf(stderr, "\n");
+		return 1;
+	}
+	return ok ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,158 @@
+#include "BoundingVolumeHierarchy.h"
+
+#include <algorithm>
+#include <float.h>
+
+namespace
+{
+	const int SAH_BINS = 16;
+
+	AABB EmptyBox()
+	{
+		AABB box = { Vec3(FLT_MAX, FLT_MAX, FLT_MAX), Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+		return box;
+	}
+
+	void Grow(AABB& box, const AABB& other)
+	{
+		box.Min = Vec3(std::min(box.Min.x, other.Min.x), std::min(box.Min.y, other.Min.y), std::min(box.Min.z, other.Min.z));
+		box.Max = Vec3(std::max(box.Max.x, other.Max.x), std::max(box.Max.y, other.Max.y), std::max(box.Max.z, other.Max.z));
+	}
+
+	void Grow(AABB& box, const Vec3& p)
+	{
+		box.Min = Vec3(std::min(box.Min.x, p.x), std::min(box.Min.y, p.y), std::min(box.Min.z, p.z));
+		box.Max = Vec3(std::max(box.Max.x, p.x), std::max(box.Max.y, p.y), std::max(box.Max.z, p.z));
+	}
+
+	float HalfArea(const AABB& box)
+	{
+		Vec3 e = box.Max - box.Min;
+		return e.x * e.y + e.y * e.z + e.z * e.x;
+	}
+
+	float Axis(const Vec3& v, int axis)
+	{
+		return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+	}
+}
+
+void BoundingVolumeHierarchy::Clear()
+{
+	m_Nodes.clear();
+	m_Items.clear();
+	m_Bounds.clear();
+}
+
+void BoundingVolumeHierarchy::Build(const AABB* pBoxes, unsigned count)
+{
+	Clear();
+	if(count == 0)
+		return;
+
+	m_Items.resize(count);
+	m_Bounds.assign(pBoxes, pBoxes + count);
+	std::vector<Vec3> centers(count);
+	for(unsigned i = 0; i < count; ++i)
+	{
+		m_Items[i] = i;
+		centers[i] = (pBoxes[i].Min + pBoxes[i].Max) * 0.5f;
+	}
+
+	m_Nodes.reserve(2 * (count / MAX_LEAF_ITEMS + 1));
+	BuildNode(0, count, centers);
+
+	//Store the boxes in leaf order so leaves read them sequentially
+	for(unsigned i = 0; i < count; ++i)
+		m_Bounds[i] = pBoxes[m_Items[i]];
+}
+
+unsigned BoundingVolumeHierarchy::BuildNode(unsigned first, unsigned end, std::vector<Vec3>& centers)
+{
+	unsigned index = (unsigned)m_Nodes.size();
+	m_Nodes.push_back(BvhNode());
+
+	AABB bounds = EmptyBox(), centerBounds = EmptyBox();
+	for(unsigned i = first; i < end; ++i)
+	{
+		Grow(bounds, m_Bounds[m_Items[i]]);
+		Grow(centerBounds, centers[m_Items[i]]);
+	}
+	m_Nodes[index].Bounds = bounds;
+
+	unsigned count = end - first;
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	//Binned surface area heuristic over the centroid extent of every axis
+	if(count > MAX_LEAF_ITEMS)
+	{
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			float lo = Axis(centerBounds.Min, axis), extent = Axis(centerBounds.Max, axis) - lo;
+			if(extent <= 0.0f)
+				continue;
+			float scale = SAH_BINS / extent;
+
+			AABB binBounds[SAH_BINS];
+			unsigned binCounts[SAH_BINS] = {};
+			for(int b = 0; b < SAH_BINS; ++b)
+				binBounds[b] = EmptyBox();
+			for(unsigned i = first; i < end; ++i)
+			{
+				int b = std::min(SAH_BINS - 1, (int)((Axis(centers[m_Items[i]], axis) - lo) * scale));
+				++binCounts[b];
+				Grow(binBounds[b], m_Bounds[m_Items[i]]);
+			}
+
+			//Sweep from the right, then evaluate every split from the left
+			float rightCost[SAH_BINS];
+			AABB right = EmptyBox();
+			unsigned rightCount = 0;
+			for(int b = SAH_BINS - 1; b > 0; --b)
+			{
+				Grow(right, binBounds[b]);
+				rightCount += binCounts[b];
+				rightCost[b] = rightCount ? HalfArea(right) * rightCount : 0.0f;
+			}
+			AABB left = EmptyBox();
+			unsigned leftCount = 0;
+			for(int b = 0; b < SAH_BINS - 1; ++b)
+			{
+				Grow(left, binBounds[b]);
+				leftCount += binCounts[b];
+				float cost = (leftCount ? HalfArea(left) * leftCount : 0.0f) + rightCost[b + 1];
+				if(leftCount > 0 && leftCount < count && cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = b + 1;
+				}
+			}
+		}
+	}
+
+	if(bestAxis < 0)
+	{
+		//Few items, or all centers in one spot
+		m_Nodes[index].First = first;
+		m_Nodes[index].Count = count;
+		return index;
+	}
+
+	float lo = Axis(centerBounds.Min, bestAxis);
+	float scale = SAH_BINS / (Axis(centerBounds.Max, bestAxis) - lo);
+	unsigned mid = first;
+	for(unsigned i = first; i < end; ++i)
+	{
+		if(std::min(SAH_BINS - 1, (int)((Axis(centers[m_Items[i]], bestAxis) - lo) * scale)) < bestSplit)
+			std::swap(m_Items[i], m_Items[mid++]);
+	}
+
+	BuildNode(first, mid, centers);
+	unsigned rightChild = BuildNode(mid, end, centers);
+	m_Nodes[index].First = rightChild;
+	m_Nodes[index].Count = 0;
+	return index;
+}
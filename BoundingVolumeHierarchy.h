@@ -0,0 +1,49 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Bounding volume hierarchy over a static set of boxes, built once
+				with binned SAH splits and stored depth first in one node array
+				(left child follows its parent). Used by Culler to reject or
+				accept whole groups of objects with a single frustum test.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "SimdMath.h"
+
+#include <vector>
+
+struct BvhNode
+{
+	AABB		Bounds;
+	uint32_t	First;		//Leaf: first entry of GetItems(). Inner: index of the right child.
+	uint32_t	Count;		//Items in a leaf, 0 for inner nodes
+};
+
+class BoundingVolumeHierarchy
+{
+public:
+	enum { MAX_LEAF_ITEMS = 8 };
+
+	BoundingVolumeHierarchy() {}
+
+	//Builds the tree over count boxes. Items keep their index into pBoxes.
+	void Build(const AABB* pBoxes, unsigned count);
+	void Clear();
+
+	bool IsEmpty() const { return m_Nodes.empty(); }
+	const BvhNode* GetNodes() const { return m_Nodes.empty() ? NULL : &m_Nodes[0]; }
+	unsigned GetNodeCount() const { return (unsigned)m_Nodes.size(); }
+	//Item indices in leaf order
+	const uint32_t* GetItems() const { return m_Items.empty() ? NULL : &m_Items[0]; }
+	unsigned GetItemCount() const { return (unsigned)m_Items.size(); }
+	//Item boxes in leaf order
+	const AABB* GetItemBounds() const { return m_Bounds.empty() ? NULL : &m_Bounds[0]; }
+
+private:
+	//Builds the subtree over m_Items[first, end) and returns its node index
+	unsigned BuildNode(unsigned first, unsigned end, std::vector<Vec3>& centers);
+
+	std::vector<BvhNode>	m_Nodes;
+	std::vector<uint32_t>	m_Items;
+	std::vector<AABB>		m_Bounds;
+};
@@ -0,0 +1,326 @@
+#include "CommandBenchmark.h"
+#include "CommandList.h"
+#include "StateCache.h"
+#include "NullRenderDevice.h"
+#include "VertexLayout.h"
+#include "SimdMath.h"
+#include "Timer.h"
+#include "HeapStats.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned DRAWS = 20000;
+	const unsigned TEXTURES = 64;
+	const unsigned STATE_SETS = 8;
+	const unsigned VERTEX_BUFFERS = 16;
+	const unsigned FRAMES = 20;
+	const unsigned SORT_KEYS = 100000;
+	const unsigned SORT_REPEATS = 20;
+
+	const unsigned REPEATS = 10;
+
+	//Each call repeated REPEATS times, then one change: two calls of each kind reach the device
+	bool CheckRedundancy(FILE* pOut)
+	{
+		StateCacheDevice device(new NullRenderDevice(64, 64));
+		NullRenderDevice* pNull = static_cast<NullRenderDevice*>(device.GetInnerDevice());
+		ITexture* pTexture = NULL;
+		if(!device.CreateTexture(16, 16, &pTexture))
+		{
+			fprintf(pOut, "CreateTexture failed\n");
+			return false;
+		}
+
+		pNull->ResetCounters();
+		device.ResetCounters();
+		for(unsigned i = 0; i < REPEATS; ++i)
+		{
+			device.SetRenderState(RD_RS_ZENABLE, 1);
+			device.SetTexture(0, pTexture);
+		}
+		device.SetRenderState(RD_RS_ZENABLE, 0);
+		device.SetTexture(0, NULL);
+		pTexture->Release();
+
+		const StateCacheCounters& cache = device.GetCounters();
+		const NullDeviceCounters& inner = pNull->GetCounters();
+		bool ok = cache.RenderStateCalls == REPEATS + 1 && cache.RenderStateFiltered == REPEATS - 1 && inner.SetRenderState == 2 &&
+			cache.TextureCalls == REPEATS + 1 && cache.TextureFiltered == REPEATS - 1 && inner.SetTexture == 2;
+		fprintf(pOut, "Redundant calls: %u of %u SetRenderState and %u of %u SetTexture forwarded, expected 2 of %u each%s\n",
+			inner.SetRenderState, cache.RenderStateCalls, inner.SetTexture, cache.TextureCalls, REPEATS + 1,
+			ok ? "" : "  MISMATCH");
+		return ok;
+	}
+
+	//Every key must be at least the one before it
+	bool IsSorted(const CommandList& commands)
+	{
+		for(unsigned i = 1; i < commands.GetCommandCount(); ++i)
+		{
+			if(commands.GetCommand(i).Key < commands.GetCommand(i - 1).Key)
+				return false;
+		}
+		return true;
+	}
+
+	//A texture run is a row of draws with the same texture, each costs one SetTexture
+	unsigned CountTextureRuns(const CommandList& commands)
+	{
+		unsigned runs = 0;
+		for(unsigned i = 0; i < commands.GetCommandCount(); ++i)
+		{
+			if(i == 0 || commands.GetCommand(i).pTexture != commands.GetCommand(i - 1).pTexture)
+				++runs;
+		}
+		return runs;
+	}
+
+	//Three render states per set, every combination a different set
+	void AddStateSets(CommandList& commands, unsigned* pSets)
+	{
+		for(unsigned s = 0; s < STATE_SETS; ++s)
+		{
+			RenderStateValue states[3] =
+			{
+				{ RD_RS_ZENABLE, s & 1 }, { RD_RS_ALPHABLENDENABLE, (s >> 1) & 1 }, { RD_RS_CULLMODE, 1 + (s >> 2) }
+			};
+			pSets[s] = commands.AddStates(states, 3);
+		}
+	}
+
+	struct SubmitResult
+	{
+		double		Ms;
+		unsigned	Textures;		//SetTexture calls forwarded per frame
+		unsigned	RenderStates;
+		unsigned	StreamSources;
+		unsigned	Draws;
+	};
+
+	SubmitResult Submit(StateCacheDevice& device, const CommandList& commands)
+	{
+		NullRenderDevice* pNull = static_cast<NullRenderDevice*>(device.GetInnerDevice());
+		int64_t ticks = 0;
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			//Every frame starts from unknown state, like after a Present with other code in between
+			device.Invalidate();
+			pNull->ResetCounters();
+			int64_t start = TimerTicks();
+			commands.Submit(&device);
+			ticks += TimerTicks() - start;
+		}
+		const NullDeviceCounters& counters = pNull->GetCounters();
+		SubmitResult result = { TicksToMs(ticks) / FRAMES, counters.SetTexture, counters.SetRenderState,
+			counters.SetStreamSource, counters.DrawPrimitive };
+		return result;
+	}
+
+	void PrintSubmit(FILE* pOut, const char* pName, const SubmitResult& result)
+	{
+		fprintf(pOut, "%-8s %.3f ms per frame, forwarded %u SetTexture, %u SetRenderState, %u SetStreamSource for %u draws\n",
+			pName, result.Ms, result.Textures, result.RenderStates, result.StreamSources, result.Draws);
+	}
+
+	//Records the draws of source every frame, from the command pool and with one heap
+	//allocation per draw. After the first frame the pool must not allocate at all.
+	bool BenchmarkRecording(FILE* pOut, const CommandList& source)
+	{
+		std::vector<DrawCommand> draws;
+		draws.reserve(source.GetCommandCount());
+		for(unsigned i = 0; i < source.GetCommandCount(); ++i)
+			draws.push_back(source.GetCommand(i));
+
+		CommandList commands(DRAWS);
+		unsigned sets[STATE_SETS];
+		uint64_t pooledAllocations = 0;
+		int64_t pooledTicks = 0;
+		bool recorded = true;
+		for(unsigned frame = 0; frame <= FRAMES; ++frame)
+		{
+			uint64_t heapStart = GetHeapCounters().Allocations;
+			int64_t start = TimerTicks();
+			commands.Reset();
+			commands.AddTransform(Mat4Identity());
+			AddStateSets(commands, sets);
+			for(size_t i = 0; i < draws.size(); ++i)
+				recorded = commands.AddDraw(draws[i]) && recorded;
+			int64_t ticks = TimerTicks() - start;
+			//Sorting is not timed, the new/delete loop has no sort to compare with
+			commands.Sort();
+			//Frame 0 warms up, the rest is steady state
+			if(frame > 0)
+			{
+				pooledTicks += ticks;
+				pooledAllocations += GetHeapCounters().Allocations - heapStart;
+			}
+		}
+
+		std::vector<DrawCommand*> heapDraws;
+		heapDraws.reserve(draws.size());
+		uint64_t heapAllocations = 0;
+		int64_t heapTicks = 0;
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			uint64_t heapStart = GetHeapCounters().Allocations;
+			int64_t start = TimerTicks();
+			for(size_t i = 0; i < draws.size(); ++i)
+				heapDraws.push_back(new DrawCommand(draws[i]));
+			for(size_t i = 0; i < heapDraws.size(); ++i)
+				delete heapDraws[i];
+			heapDraws.clear();
+			heapTicks += TimerTicks() - start;
+			heapAllocations += GetHeapCounters().Allocations - heapStart;
+		}
+
+		const ObjectPool<DrawCommand>& pool = commands.GetCommandPool();
+		bool ok = recorded && commands.GetDroppedDraws() == 0 && pooledAllocations == 0 && pool.GetInUse() == draws.size();
+		fprintf(pOut, "Recording %u draws: pooled %.3f ms and %.1f heap allocations per frame (peak %u of %u slots), "
+			"new/delete %.3f ms and %.1f%s\n", (unsigned)draws.size(), TicksToMs(pooledTicks) / FRAMES,
+			(double)pooledAllocations / FRAMES, pool.GetPeak(), pool.GetCapacity(), TicksToMs(heapTicks) / FRAMES,
+			(double)heapAllocations / FRAMES, ok ? "" : "  POOL ALLOCATED");
+		return ok;
+	}
+
+	bool BenchmarkSubmit(FILE* pOut)
+	{
+		StateCacheDevice device(new NullRenderDevice(1280, 720));
+		bool ok = true;
+
+		std::vector<ITexture*> textures(TEXTURES, NULL);
+		for(unsigned i = 0; i < TEXTURES; ++i)
+			ok = device.CreateTexture(64, 64, &textures[i]) && ok;
+		std::vector<IVertexBuffer*> buffers(VERTEX_BUFFERS, NULL);
+		for(unsigned i = 0; i < VERTEX_BUFFERS; ++i)
+			ok = device.CreateVertexBuffer(300 * sizeof(PositionColorVertex), RD_USAGE_WRITEONLY, PositionColorLayout::FVF, RD_POOL_MANAGED, &buffers[i]) && ok;
+
+		if(ok)
+		{
+			CommandList commands(DRAWS);
+			uint32_t seed = 4242;
+			unsigned world = commands.AddTransform(Mat4Identity());
+			unsigned sets[STATE_SETS];
+			AddStateSets(commands, sets);
+
+			//The state set goes in the shader bits and the vertex buffer in the vertex format bits of the key
+			for(unsigned i = 0; i < DRAWS; ++i)
+			{
+				unsigned set = RandomBits(seed) % STATE_SETS;
+				unsigned texture = RandomBits(seed) % TEXTURES;
+				unsigned buffer = RandomBits(seed) % VERTEX_BUFFERS;
+				DrawCommand cmd;
+				cmd.Key = MakeDrawKey(0, set, texture, buffer, RandomBits(seed) & 0xFFFFFF);
+				cmd.pVB = buffers[buffer];
+				cmd.Stride = sizeof(PositionColorVertex);
+				cmd.FVF = PositionColorLayout::FVF;
+				cmd.pIB = NULL;
+				cmd.Type = RD_PT_TRIANGLELIST;
+				cmd.BaseVertex = 0;
+				cmd.MinIndex = 0;
+				cmd.NumVertices = 300;
+				cmd.StartIndex = 0;
+				cmd.PrimCount = 100;
+				cmd.Transform = world;
+				cmd.States = sets[set];
+				cmd.pTexture = textures[texture];
+				commands.AddDraw(cmd);
+			}
+
+			SubmitResult unsorted = Submit(device, commands);
+			unsigned unsortedRuns = CountTextureRuns(commands);
+
+			int64_t start = TimerTicks();
+			commands.Sort();
+			double sortMs = TicksToMs(TimerTicks() - start);
+			SubmitResult sorted = Submit(device, commands);
+			unsigned sortedRuns = CountTextureRuns(commands);
+			bool keysSorted = IsSorted(commands);
+
+			fprintf(pOut, "%u draws, %u textures, %u state sets, %u vertex buffers, sorted in %.3f ms\n",
+				DRAWS, TEXTURES, STATE_SETS, VERTEX_BUFFERS, sortMs);
+			PrintSubmit(pOut, "Unsorted", unsorted);
+			PrintSubmit(pOut, "Sorted", sorted);
+
+			bool match = unsorted.Textures == unsortedRuns && sorted.Textures == sortedRuns &&
+				unsorted.Draws == DRAWS && sorted.Draws == DRAWS;
+			fprintf(pOut, "Keys %s, SetTexture forwarded once per texture run (%u and %u runs)%s\n",
+				keysSorted ? "in order" : "OUT OF ORDER", unsortedRuns, sortedRuns, match ? "" : "  MISMATCH");
+			ok = keysSorted && match && sorted.Textures < unsorted.Textures;
+			ok = BenchmarkRecording(pOut, commands) && ok;
+		}
+
+		for(unsigned i = 0; i < TEXTURES; ++i)
+		{
+			if(textures[i])
+				textures[i]->Release();
+		}
+		for(unsigned i = 0; i < VERTEX_BUFFERS; ++i)
+		{
+			if(buffers[i])
+				buffers[i]->Release();
+		}
+		return ok;
+	}
+
+	struct KeyValue
+	{
+		uint64_t	Key;
+		uint32_t	Value;
+
+		bool operator<(const KeyValue& other) const { return Key < other.Key; }
+	};
+
+	//RadixSort must give the same order as a stable comparison sort, duplicates included
+	bool BenchmarkRadixSort(FILE* pOut)
+	{
+		std::vector<uint64_t> sourceKeys(SORT_KEYS);
+		uint32_t seed = 99;
+		for(unsigned i = 0; i < SORT_KEYS; ++i)
+			sourceKeys[i] = MakeDrawKey(RandomBits(seed) % 2, RandomBits(seed) % 16, RandomBits(seed) % 256, 0, RandomBits(seed) & 0xFFF);
+
+		std::vector<uint64_t> keys(SORT_KEYS), tmpKeys(SORT_KEYS);
+		std::vector<uint32_t> values(SORT_KEYS), tmpValues(SORT_KEYS);
+		std::vector<KeyValue> pairs(SORT_KEYS);
+		int64_t radixTicks = 0, stableTicks = 0;
+		for(unsigned r = 0; r < SORT_REPEATS; ++r)
+		{
+			for(unsigned i = 0; i < SORT_KEYS; ++i)
+			{
+				keys[i] = sourceKeys[i];
+				values[i] = i;
+				pairs[i].Key = sourceKeys[i];
+				pairs[i].Value = i;
+			}
+			int64_t start = TimerTicks();
+			RadixSort(&keys[0], &values[0], &tmpKeys[0], &tmpValues[0], SORT_KEYS);
+			radixTicks += TimerTicks() - start;
+
+			start = TimerTicks();
+			std::stable_sort(pairs.begin(), pairs.end());
+			stableTicks += TimerTicks() - start;
+		}
+
+		bool same = true;
+		for(unsigned i = 0; i < SORT_KEYS && same; ++i)
+			same = keys[i] == pairs[i].Key && values[i] == pairs[i].Value;
+
+		fprintf(pOut, "%u keys: RadixSort %.3f ms, std::stable_sort %.3f ms, %s\n",
+			SORT_KEYS, TicksToMs(radixTicks) / SORT_REPEATS, TicksToMs(stableTicks) / SORT_REPEATS,
+			same ? "same order" : "DIFFERENT ORDER");
+		return same;
+	}
+}
+
+bool RunCommandBenchmarks(FILE* pOut)
+{
+	fprintf(pOut, "Command list (null device behind a state cache)\n");
+	bool ok = CheckRedundancy(pOut);
+	ok = BenchmarkSubmit(pOut) && ok;
+	ok = BenchmarkRadixSort(pOut) && ok;
+
+	fprintf(pOut, "%s\n", ok ? "Command list works" : "Command list FAILED");
+	return ok;
+}
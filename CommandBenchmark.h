@@ -0,0 +1,19 @@
+/* Title: DirectX 9.0c Framework
+/* Description: CommandList benchmark on the null device behind a
+				StateCacheDevice: checks that repeated SetRenderState and
+				SetTexture calls are filtered before they reach the device, then
+				submits 20k draws with random textures, state sets and vertex
+				buffers unsorted and sorted and compares the calls forwarded and
+				the time taken, records them from the command pool and with
+				new/delete to check that pooled recording makes no heap
+				allocation, and checks RadixSort against std::stable_sort.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if redundant calls get through, recording
+//allocates or the sort is wrong
+bool RunCommandBenchmarks(FILE* pOut);
@@ -0,0 +1,167 @@
+#include "CommandList.h"
+
+#include <string.h>
+
+void RadixSort(uint64_t* keys, uint32_t* values, uint64_t* tmpKeys, uint32_t* tmpValues, size_t count)
+{
+	if(count < 2)
+		return;
+
+	//Histograms for all 8 passes in one sweep
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for(size_t i = 0; i < count; ++i)
+	{
+		uint64_t key = keys[i];
+		for(int pass = 0; pass < 8; ++pass)
+			++histograms[pass][(key >> (pass * 8)) & 0xFF];
+	}
+
+	uint64_t* srcKeys = keys;
+	uint32_t* srcValues = values;
+	uint64_t* dstKeys = tmpKeys;
+	uint32_t* dstValues = tmpValues;
+
+	for(int pass = 0; pass < 8; ++pass)
+	{
+		size_t* histogram = histograms[pass];
+		int shift = pass * 8;
+
+		//Every key has the same byte here, the pass would not change anything
+		if(histogram[(srcKeys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		//Prefix sum into bucket offsets
+		size_t offset = 0;
+		for(int b = 0; b < 256; ++b)
+		{
+			size_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			size_t dst = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+			dstKeys[dst] = srcKeys[i];
+			dstValues[dst] = srcValues[i];
+		}
+
+		//Swap buffers
+		uint64_t* k = srcKeys; srcKeys = dstKeys; dstKeys = k;
+		uint32_t* v = srcValues; srcValues = dstValues; dstValues = v;
+	}
+
+	//An odd number of passes leaves the result in the scratch buffers
+	if(srcKeys != keys)
+	{
+		memcpy(keys, srcKeys, count * sizeof(uint64_t));
+		memcpy(values, srcValues, count * sizeof(uint32_t));
+	}
+}
+
+CommandList::CommandList(unsigned maxCommands)
+{
+	m_CommandPool.Init(maxCommands);
+	m_Commands.reserve(maxCommands);
+	m_Transforms.reserve(maxCommands * 16);
+	//Sets are usually shared between draws and hold a few states each
+	m_StateSets.reserve(maxCommands);
+	m_StateValues.reserve(maxCommands * 4);
+	m_Keys.reserve(maxCommands);
+	m_TmpKeys.reserve(maxCommands);
+	m_Order.reserve(maxCommands);
+	m_TmpOrder.reserve(maxCommands);
+}
+
+CommandList::~CommandList()
+{
+	Reset();
+}
+
+void CommandList::Reset()
+{
+	//clear() keeps the capacity and the commands go back to the pool, so steady
+	//state recording does not allocate
+	for(size_t i = 0; i < m_Commands.size(); ++i)
+		m_CommandPool.Free(m_Commands[i]);
+	m_Commands.clear();
+	m_Transforms.clear();
+	m_StateValues.clear();
+	m_StateSets.clear();
+	m_Order.clear();
+}
+
+unsigned CommandList::AddTransform(const float* matrix)
+{
+	unsigned index = (unsigned)(m_Transforms.size() / 16);
+	m_Transforms.insert(m_Transforms.end(), matrix, matrix + 16);
+	return index;
+}
+
+unsigned CommandList::AddStates(const RenderStateValue* pStates, unsigned count)
+{
+	StateRange range;
+	range.First = (unsigned)m_StateValues.size();
+	range.Count = count;
+	m_StateValues.insert(m_StateValues.end(), pStates, pStates + count);
+	m_StateSets.push_back(range);
+	return (unsigned)m_StateSets.size() - 1;
+}
+
+bool CommandList::AddDraw(const DrawCommand& command)
+{
+	DrawCommand* pCommand = m_CommandPool.Alloc(command);
+	if(!pCommand)
+		return false;
+	m_Order.push_back((uint32_t)m_Commands.size());
+	m_Commands.push_back(pCommand);
+	return true;
+}
+
+void CommandList::Sort()
+{
+	size_t count = m_Commands.size();
+	m_Keys.resize(count);
+	m_TmpKeys.resize(count);
+	m_TmpOrder.resize(count);
+	for(size_t i = 0; i < count; ++i)
+	{
+		m_Keys[i] = m_Commands[i]->Key;
+		m_Order[i] = (uint32_t)i;
+	}
+
+	if(count > 1)
+		RadixSort(&m_Keys[0], &m_Order[0], &m_TmpKeys[0], &m_TmpOrder[0], count);
+}
+
+void CommandList::Submit(IRenderDevice* pDevice) const
+{
+	for(size_t i = 0; i < m_Order.size(); ++i)
+	{
+		const DrawCommand& cmd = *m_Commands[m_Order[i]];
+
+		if(cmd.States != NONE)
+		{
+			const StateRange& range = m_StateSets[cmd.States];
+			for(unsigned s = 0; s < range.Count; ++s)
+				pDevice->SetRenderState(m_StateValues[range.First + s].State, m_StateValues[range.First + s].Value);
+		}
+		if(cmd.Transform != NONE)
+			pDevice->SetTransform(RD_TS_WORLD, &m_Transforms[cmd.Transform * 16]);
+
+		pDevice->SetTexture(0, cmd.pTexture);
+		pDevice->SetFVF(cmd.FVF);
+		pDevice->SetStreamSource(0, cmd.pVB, 0, cmd.Stride);
+
+		if(cmd.pIB)
+		{
+			pDevice->SetIndices(cmd.pIB);
+			pDevice->DrawIndexedPrimitive(cmd.Type, cmd.BaseVertex, cmd.MinIndex, cmd.NumVertices, cmd.StartIndex, cmd.PrimCount);
+		}
+		else
+		{
+			pDevice->DrawPrimitive(cmd.Type, (unsigned)cmd.BaseVertex, cmd.PrimCount);
+		}
+	}
+}
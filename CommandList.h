@@ -0,0 +1,127 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Recorded render command list. Draws are recorded with a 64 bit
+				sort key, radix sorted so draws sharing state end up next to each
+				other, then submitted. Submit through a StateCacheDevice so the
+				state changes the sort made redundant never reach the driver.
+				Draws live in a fixed size ObjectPool that Reset() returns them
+				to, so recording a frame does not touch the heap.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "ObjectPool.h"
+
+#include <vector>
+
+//Draw key layout, most significant bits first:
+//	63..60 pass			(4 bits, e.g. opaque before translucent)
+//	59..48 shader		(12 bits)
+//	47..32 texture		(16 bits)
+//	31..24 vertex format	(8 bits)
+//	23..0  depth			(24 bits, see QuantizeDepth)
+inline uint64_t MakeDrawKey(unsigned pass, unsigned shader, unsigned texture, unsigned vertexFormat, unsigned depth)
+{
+	return ((uint64_t)(pass & 0xF) << 60) |
+		((uint64_t)(shader & 0xFFF) << 48) |
+		((uint64_t)(texture & 0xFFFF) << 32) |
+		((uint64_t)(vertexFormat & 0xFF) << 24) |
+		(uint64_t)(depth & 0xFFFFFF);
+}
+
+//Maps a view space depth to 24 bits. Opaque passes sort front to back,
+//translucent passes should pass backToFront = true.
+inline unsigned QuantizeDepth(float viewZ, float zNear, float zFar, bool backToFront)
+{
+	float t = (viewZ - zNear) / (zFar - zNear);
+	t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	unsigned depth = (unsigned)(t * 16777215.0f);
+	return backToFront ? 0xFFFFFF - depth : depth;
+}
+
+//Stable LSD radix sort of keys with a 32 bit payload, 8 bits per pass.
+//Passes where every key has the same byte are skipped. tmpKeys/tmpValues
+//must hold count elements; the result ends up in keys/values.
+void RadixSort(uint64_t* keys, uint32_t* values, uint64_t* tmpKeys, uint32_t* tmpValues, size_t count);
+
+//One render state assignment
+struct RenderStateValue
+{
+	RDRenderState State;
+	RDWORD Value;
+};
+
+struct DrawCommand
+{
+	uint64_t			Key;
+	IVertexBuffer*		pVB;
+	unsigned			Stride;
+	RDWORD				FVF;
+	IIndexBuffer*		pIB;			//NULL for DrawPrimitive
+	RDPrimitiveType		Type;
+	int					BaseVertex;		//StartVertex for DrawPrimitive, BaseVertexIndex otherwise
+	unsigned			MinIndex;
+	unsigned			NumVertices;
+	unsigned			StartIndex;
+	unsigned			PrimCount;
+	unsigned			Transform;		//Index from AddTransform() or CommandList::NONE
+	unsigned			States;			//Index from AddStates() or CommandList::NONE
+	ITexture*			pTexture;		//Bound to stage 0, NULL for none
+};
+
+class CommandList
+{
+public:
+	enum { NONE = 0xFFFFFFFF };
+
+	//Draws come from a pool of maxCommands, the other storage is reserved for as
+	//many, so recording does not allocate in the common case
+	explicit CommandList(unsigned maxCommands = 4096);
+	~CommandList();
+
+	//Clears all commands, transforms and state sets
+	void Reset();
+
+	//World matrix shared by any number of draws (16 floats, row major)
+	unsigned AddTransform(const float* matrix);
+	//Set of render states applied before a draw
+	unsigned AddStates(const RenderStateValue* pStates, unsigned count);
+	//False (and the draw is dropped) when maxCommands draws are recorded already
+	bool AddDraw(const DrawCommand& command);
+
+	//Sorts the recorded draws by key
+	void Sort();
+	//Issues the draws in sorted order (recording order if Sort() was not called).
+	//Every draw sets all of its state, the device is expected to filter repeats.
+	void Submit(IRenderDevice* pDevice) const;
+
+	unsigned GetCommandCount() const { return (unsigned)m_Commands.size(); }
+	const DrawCommand& GetCommand(unsigned sortedIndex) const { return *m_Commands[m_Order[sortedIndex]]; }
+	//Draws dropped by AddDraw() since the list was created
+	unsigned GetDroppedDraws() const { return m_CommandPool.GetFailedAllocs(); }
+	const ObjectPool<DrawCommand>& GetCommandPool() const { return m_CommandPool; }
+
+private:
+	//Disallow copying
+	CommandList(const CommandList&);
+	CommandList& operator=(const CommandList&);
+
+	struct StateRange
+	{
+		unsigned First;
+		unsigned Count;
+	};
+
+	ObjectPool<DrawCommand>			m_CommandPool;
+	std::vector<DrawCommand*>		m_Commands;		//Recording order
+	std::vector<float>				m_Transforms;
+	std::vector<RenderStateValue>	m_StateValues;
+	std::vector<StateRange>			m_StateSets;
+
+	//Sort scratch
+	std::vector<uint64_t>			m_Keys;
+	std::vector<uint64_t>			m_TmpKeys;
+	std::vector<uint32_t>			m_Order;
+	std::vector<uint32_t>			m_TmpOrder;
+};
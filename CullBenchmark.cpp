@@ -0,0 +1,158 @@
+#include "CullBenchmark.h"
+#include "Culling.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned OBJECT_COUNT = 250000;
+	const int RUNS = 10;
+
+	//Sorted copy of the visible list
+	std::vector<uint32_t> VisibleSet(const Culler& culler)
+	{
+		std::vector<uint32_t> visible(culler.GetVisible(), culler.GetVisible() + culler.GetVisibleCount());
+		std::sort(visible.begin(), visible.end());
+		return visible;
+	}
+
+	enum CullMode { CULL_SPHERES, CULL_BOXES, CULL_BVH };
+
+	struct BenchScene
+	{
+		std::vector<float>	X, Y, Z, Radius;
+		std::vector<AABB>	Boxes;
+		BoundingVolumeHierarchy Bvh;
+	};
+
+	//Best of RUNS, in milliseconds
+	double TimeCull(Culler& culler, const BenchScene& scene, CullMode mode, JobSystem* pJobs)
+	{
+		double best = 1e30;
+		for(int run = 0; run < RUNS; ++run)
+		{
+			if(mode == CULL_SPHERES)
+				culler.CullSpheres(&scene.X[0], &scene.Y[0], &scene.Z[0], &scene.Radius[0], OBJECT_COUNT, pJobs);
+			else if(mode == CULL_BOXES)
+				culler.CullAABBs(&scene.Boxes[0], OBJECT_COUNT, pJobs);
+			else
+				culler.CullBVH(scene.Bvh, pJobs);
+			best = std::min(best, culler.GetStats().CullMs);
+		}
+		return best;
+	}
+
+	void PrintStats(FILE* pOut, const char* pName, double singleMs, double jobsMs, const CullStats& s)
+	{
+		fprintf(pOut, "%-14s 1 thread %7.3f ms, all threads %7.3f ms: %u tested, %u frustum culled, %u occluded, %u visible",
+			pName, singleMs, jobsMs, s.Tested, s.FrustumCulled, s.OcclusionCulled, s.Visible);
+		if(s.NodesVisited)
+			fprintf(pOut, ", %u nodes", s.NodesVisited);
+		if(s.Occluders)
+			fprintf(pOut, ", %u occluders in %.3f ms", s.Occluders, s.OcclusionMs);
+		fprintf(pOut, "\n");
+	}
+}
+
+bool RunCullBenchmarks(FILE* pOut)
+{
+	JobSystem jobs;
+	jobs.Init();
+	fprintf(pOut, "Culling (%u threads)\n", jobs.GetThreadCount());
+
+	//Objects scattered over a 2 km square around the camera
+	BenchScene scene;
+	scene.X.resize(OBJECT_COUNT);
+	scene.Y.resize(OBJECT_COUNT);
+	scene.Z.resize(OBJECT_COUNT);
+	scene.Radius.resize(OBJECT_COUNT);
+	scene.Boxes.resize(OBJECT_COUNT);
+	uint32_t seed = 4242;
+	for(unsigned i = 0; i < OBJECT_COUNT; ++i)
+	{
+		scene.X[i] = RandomFloat(seed) * 2000.0f - 1000.0f;
+		scene.Y[i] = RandomFloat(seed) * 20.0f;
+		scene.Z[i] = RandomFloat(seed) * 2000.0f - 1000.0f;
+		scene.Radius[i] = 1.0f + RandomFloat(seed) * 2.0f;
+		float e = scene.Radius[i] * 0.577f;
+		Vec3 c(scene.X[i], scene.Y[i], scene.Z[i]);
+		scene.Boxes[i].Min = c - Vec3(e, e, e);
+		scene.Boxes[i].Max = c + Vec3(e, e, e);
+	}
+
+	int64_t buildStart = TimerTicks();
+	scene.Bvh.Build(&scene.Boxes[0], OBJECT_COUNT);
+	fprintf(pOut, "BVH build: %.3f ms, %u nodes\n", TicksToMs(TimerTicks() - buildStart), scene.Bvh.GetNodeCount());
+
+	Mat4 view = Mat4LookAtLH(Vec3(0.0f, 10.0f, 0.0f), Vec3(0.0f, 10.0f, 1.0f), Vec3(0.0f, 1.0f, 0.0f));
+	Mat4 proj = Mat4PerspectiveFovLH(MATH_PI / 3.0f, 16.0f / 9.0f, 1.0f, 1000.0f);
+	Culler culler;
+	culler.Init(OBJECT_COUNT);
+	culler.SetCamera(view, proj);
+
+	//Scalar reference
+	std::vector<uint32_t> reference;
+	int64_t scalarStart = TimerTicks();
+	for(unsigned i = 0; i < OBJECT_COUNT; ++i)
+	{
+		if(FrustumTestSphere(culler.GetFrustum(), Vec3(scene.X[i], scene.Y[i], scene.Z[i]), scene.Radius[i]))
+			reference.push_back(i);
+	}
+	fprintf(pOut, "%-14s 1 thread %7.3f ms, %u visible\n", "scalar spheres", TicksToMs(TimerTicks() - scalarStart),
+		(unsigned)reference.size());
+
+	double singleMs = TimeCull(culler, scene, CULL_SPHERES, NULL);
+	double jobsMs = TimeCull(culler, scene, CULL_SPHERES, &jobs);
+	PrintStats(pOut, "spheres", singleMs, jobsMs, culler.GetStats());
+	bool ok = VisibleSet(culler) == reference;
+
+	singleMs = TimeCull(culler, scene, CULL_BOXES, NULL);
+	jobsMs = TimeCull(culler, scene, CULL_BOXES, &jobs);
+	PrintStats(pOut, "boxes", singleMs, jobsMs, culler.GetStats());
+	std::vector<uint32_t> boxes = VisibleSet(culler);
+
+	singleMs = TimeCull(culler, scene, CULL_BVH, NULL);
+	jobsMs = TimeCull(culler, scene, CULL_BVH, &jobs);
+	PrintStats(pOut, "bvh", singleMs, jobsMs, culler.GetStats());
+	ok = ok && VisibleSet(culler) == boxes;
+
+	//A row of walls in front of the camera hides most of what is behind them
+	std::vector<AABB> walls;
+	for(int i = -4; i <= 4; ++i)
+	{
+		AABB wall = { Vec3(i * 20.0f - 9.0f, 0.0f, 30.0f), Vec3(i * 20.0f + 9.0f, 40.0f, 32.0f) };
+		walls.push_back(wall);
+	}
+	culler.SetOccluders(&walls[0], (unsigned)walls.size());
+
+	singleMs = TimeCull(culler, scene, CULL_BOXES, NULL);
+	jobsMs = TimeCull(culler, scene, CULL_BOXES, &jobs);
+	PrintStats(pOut, "boxes+occl", singleMs, jobsMs, culler.GetStats());
+	std::vector<uint32_t> occludedBoxes = VisibleSet(culler);
+	bool occlusionOk = culler.GetStats().OcclusionCulled > 0;
+
+	singleMs = TimeCull(culler, scene, CULL_BVH, NULL);
+	jobsMs = TimeCull(culler, scene, CULL_BVH, &jobs);
+	PrintStats(pOut, "bvh+occl", singleMs, jobsMs, culler.GetStats());
+	ok = ok && occlusionOk && VisibleSet(culler) == occludedBoxes;
+
+	//Nothing hidden by the walls may stick out above them or reach in front of them
+	std::vector<uint8_t> visible(OBJECT_COUNT, 0);
+	for(size_t i = 0; i < occludedBoxes.size(); ++i)
+		visible[occludedBoxes[i]] = 1;
+	unsigned wrong = 0;
+	for(size_t i = 0; i < boxes.size(); ++i)
+	{
+		const AABB& box = scene.Boxes[boxes[i]];
+		if(!visible[boxes[i]] && (box.Min.z < 30.0f || box.Max.y > 40.0f))
+			++wrong;
+	}
+	fprintf(pOut, "Occlusion check: %u wrongly hidden\n", wrong);
+	ok = ok && wrong == 0;
+
+	jobs.Shutdown();
+	return ok;
+}
@@ -0,0 +1,13 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Culling benchmark: 250k objects culled as spheres, boxes and
+				through a BVH, single threaded and on all cores, with and without
+				occluders, checked against a scalar reference.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if the culling paths disagree
+bool RunCullBenchmarks(FILE* pOut);
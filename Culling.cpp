@@ -0,0 +1,309 @@
+#include "Culling.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <string.h>
+
+namespace
+{
+	//BVH levels split off as separate jobs (up to 2^PARALLEL_DEPTH subtrees)
+	const unsigned PARALLEL_DEPTH = 6;
+
+	//Range of leaf ordered items under a node
+	void SubtreeItems(const BvhNode* pNodes, unsigned node, unsigned* pFirst, unsigned* pEnd)
+	{
+		unsigned left = node, right = node;
+		while(pNodes[left].Count == 0)
+			left = left + 1;
+		while(pNodes[right].Count == 0)
+			right = pNodes[right].First;
+		*pFirst = pNodes[left].First;
+		*pEnd = pNodes[right].First + pNodes[right].Count;
+	}
+}
+
+Culler::Culler() : m_FrustumCulled(0), m_OcclusionCulled(0), m_NodesVisited(0)
+{
+	m_ViewProj = Mat4Identity();
+	m_Frustum = FrustumFromMatrix(m_ViewProj);
+	m_OcclusionEnabled = true;
+	m_UseOcclusion = false;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void Culler::Init(unsigned maxObjects, unsigned occlusionWidth, unsigned occlusionHeight)
+{
+	m_Flags.resize(maxObjects);
+	m_Visible.resize(maxObjects);
+	m_Frontier.reserve(1 << PARALLEL_DEPTH);
+	if(occlusionWidth > 0 && occlusionHeight > 0)
+		m_Occlusion.Init(occlusionWidth, occlusionHeight);
+}
+
+void Culler::SetCamera(const Mat4& view, const Mat4& proj)
+{
+	m_ViewProj = Mat4Multiply(view, proj);
+	m_Frustum = FrustumFromMatrix(m_ViewProj);
+}
+
+void Culler::SetOccluders(const AABB* pBoxes, unsigned count)
+{
+	m_Occluders.assign(pBoxes, pBoxes + count);
+}
+
+void Culler::Begin(unsigned count)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_Stats.Tested = count;
+	m_FrustumCulled.store(0, std::memory_order_relaxed);
+	m_OcclusionCulled.store(0, std::memory_order_relaxed);
+	m_NodesVisited.store(0, std::memory_order_relaxed);
+
+	//Only grows when more objects than Init() announced show up
+	if(m_Flags.size() < count)
+	{
+		m_Flags.resize(count);
+		m_Visible.resize(count);
+	}
+
+	//Occluders are few and rasterized on this thread, tests are read only afterwards
+	m_UseOcclusion = IsOcclusionEnabled();
+	if(m_UseOcclusion)
+	{
+		int64_t start = TimerTicks();
+		m_Occlusion.Begin(m_ViewProj);
+		for(size_t i = 0; i < m_Occluders.size(); ++i)
+		{
+			if(FrustumTestAABB(m_Frustum, m_Occluders[i]))
+				m_Occlusion.RenderOccluder(m_Occluders[i]);
+		}
+		m_Occlusion.End();
+		m_Stats.Occluders = m_Occlusion.GetRenderedOccluders();
+		m_Stats.OcclusionMs = TicksToMs(TimerTicks() - start);
+	}
+}
+
+unsigned Culler::End(const uint32_t* pItems, unsigned count, int64_t startTicks)
+{
+	unsigned visible = 0;
+	const uint8_t* pFlags = count ? &m_Flags[0] : NULL;
+	uint32_t* pVisible = count ? &m_Visible[0] : NULL;
+	for(unsigned i = 0; i < count; ++i)
+	{
+		pVisible[visible] = pItems ? pItems[i] : i;
+		visible += pFlags[i];
+	}
+
+	m_Stats.FrustumCulled = m_FrustumCulled.load(std::memory_order_relaxed);
+	m_Stats.OcclusionCulled = m_OcclusionCulled.load(std::memory_order_relaxed);
+	m_Stats.NodesVisited = m_NodesVisited.load(std::memory_order_relaxed);
+	m_Stats.Visible = visible;
+	m_Stats.CullMs = TicksToMs(TimerTicks() - startTicks);
+	return visible;
+}
+
+void Culler::AddCounts(const CullCounts& counts)
+{
+	m_FrustumCulled.fetch_add(counts.FrustumCulled, std::memory_order_relaxed);
+	m_OcclusionCulled.fetch_add(counts.OcclusionCulled, std::memory_order_relaxed);
+	m_NodesVisited.fetch_add(counts.NodesVisited, std::memory_order_relaxed);
+}
+
+unsigned Culler::CullSpheres(const float* pX, const float* pY, const float* pZ, const float* pRadius, unsigned count,
+	JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+	Begin(count);
+
+	ChunkData data = { this, pX, pY, pZ, pRadius, NULL, NULL };
+	if(pJobs && pJobs->IsRunning() && count > CHUNK_SIZE)
+		pJobs->ParallelFor(count, CHUNK_SIZE, SphereChunkJob, &data);
+	else
+		CullSphereRange(data, 0, count);
+
+	return End(NULL, count, start);
+}
+
+unsigned Culler::CullAABBs(const AABB* pBoxes, unsigned count, JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+	Begin(count);
+
+	ChunkData data = { this, NULL, NULL, NULL, NULL, pBoxes, NULL };
+	if(pJobs && pJobs->IsRunning() && count > CHUNK_SIZE)
+		pJobs->ParallelFor(count, CHUNK_SIZE, BoxChunkJob, &data);
+	else
+		CullBoxRange(data, 0, count);
+
+	return End(NULL, count, start);
+}
+
+unsigned Culler::CullBVH(const BoundingVolumeHierarchy& bvh, JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+	unsigned count = bvh.GetItemCount();
+	Begin(count);
+	if(count == 0)
+		return End(NULL, 0, start);
+
+	//Culled subtrees are never visited, so every flag starts hidden
+	memset(&m_Flags[0], 0, count);
+
+	CullCounts counts = { 0, 0, 0 };
+	if(pJobs && pJobs->IsRunning() && count > CHUNK_SIZE)
+	{
+		//The top of the tree runs here, the subtrees below it as jobs
+		m_Frontier.clear();
+		CullNode(bvh, 0, 0, &m_Frontier, counts);
+		if(!m_Frontier.empty())
+		{
+			ChunkData data = { this, NULL, NULL, NULL, NULL, NULL, &bvh };
+			pJobs->ParallelFor((unsigned)m_Frontier.size(), 1, NodeJob, &data);
+		}
+	}
+	else
+		CullNode(bvh, 0, 0, NULL, counts);
+	AddCounts(counts);
+
+	return End(bvh.GetItems(), count, start);
+}
+
+void Culler::SphereChunkJob(void* pData, unsigned begin, unsigned end)
+{
+	ChunkData* pChunk = (ChunkData*)pData;
+	pChunk->pCuller->CullSphereRange(*pChunk, begin, end);
+}
+
+void Culler::BoxChunkJob(void* pData, unsigned begin, unsigned end)
+{
+	ChunkData* pChunk = (ChunkData*)pData;
+	pChunk->pCuller->CullBoxRange(*pChunk, begin, end);
+}
+
+void Culler::NodeJob(void* pData, unsigned begin, unsigned end)
+{
+	ChunkData* pChunk = (ChunkData*)pData;
+	Culler* pCuller = pChunk->pCuller;
+	CullCounts counts = { 0, 0, 0 };
+	for(unsigned i = begin; i < end; ++i)
+		pCuller->CullNode(*pChunk->pBvh, pCuller->m_Frontier[i], PARALLEL_DEPTH, NULL, counts);
+	pCuller->AddCounts(counts);
+}
+
+void Culler::CullSphereRange(const ChunkData& data, unsigned begin, unsigned end)
+{
+	uint8_t* pFlags = &m_Flags[0];
+	FrustumTestSpheres(m_Frustum, data.pX + begin, data.pY + begin, data.pZ + begin, data.pRadius + begin, end - begin,
+		pFlags + begin);
+
+	CullCounts counts = { 0, 0, 0 };
+	for(unsigned i = begin; i < end; ++i)
+	{
+		if(!pFlags[i])
+		{
+			++counts.FrustumCulled;
+			continue;
+		}
+		if(m_UseOcclusion)
+		{
+			float r = data.pRadius[i];
+			AABB box = { Vec3(data.pX[i] - r, data.pY[i] - r, data.pZ[i] - r), Vec3(data.pX[i] + r, data.pY[i] + r, data.pZ[i] + r) };
+			if(!m_Occlusion.TestAABB(box))
+			{
+				pFlags[i] = 0;
+				++counts.OcclusionCulled;
+			}
+		}
+	}
+	AddCounts(counts);
+}
+
+void Culler::CullBoxRange(const ChunkData& data, unsigned begin, unsigned end)
+{
+	uint8_t* pFlags = &m_Flags[0];
+	FrustumTestAABBs(m_Frustum, data.pBoxes + begin, end - begin, pFlags + begin);
+
+	CullCounts counts = { 0, 0, 0 };
+	for(unsigned i = begin; i < end; ++i)
+	{
+		if(!pFlags[i])
+			++counts.FrustumCulled;
+		else if(m_UseOcclusion && !m_Occlusion.TestAABB(data.pBoxes[i]))
+		{
+			pFlags[i] = 0;
+			++counts.OcclusionCulled;
+		}
+	}
+	AddCounts(counts);
+}
+
+void Culler::CullNode(const BoundingVolumeHierarchy& bvh, unsigned node, unsigned depth, std::vector<uint32_t>* pFrontier,
+	CullCounts& counts)
+{
+	const BvhNode* pNodes = bvh.GetNodes();
+	const BvhNode& n = pNodes[node];
+	if(pFrontier && depth == PARALLEL_DEPTH && n.Count == 0)
+	{
+		pFrontier->push_back(node);
+		return;
+	}
+	++counts.NodesVisited;
+
+	FrustumClass frustumClass = FrustumClassifyAABB(m_Frustum, n.Bounds);
+	if(frustumClass == FRUSTUM_OUTSIDE || (m_UseOcclusion && !m_Occlusion.TestAABB(n.Bounds)))
+	{
+		unsigned first, end;
+		SubtreeItems(pNodes, node, &first, &end);
+		if(frustumClass == FRUSTUM_OUTSIDE)
+			counts.FrustumCulled += end - first;
+		else
+			counts.OcclusionCulled += end - first;
+		return;
+	}
+
+	if(frustumClass == FRUSTUM_INSIDE)
+	{
+		unsigned first, end;
+		SubtreeItems(pNodes, node, &first, &end);
+		AcceptItems(bvh, first, end, counts);
+		return;
+	}
+
+	if(n.Count > 0)
+	{
+		const AABB* pBounds = bvh.GetItemBounds();
+		uint8_t* pFlags = &m_Flags[0];
+		for(unsigned i = n.First; i < n.First + n.Count; ++i)
+		{
+			if(!FrustumTestAABB(m_Frustum, pBounds[i]))
+				++counts.FrustumCulled;
+			else if(m_UseOcclusion && !m_Occlusion.TestAABB(pBounds[i]))
+				++counts.OcclusionCulled;
+			else
+				pFlags[i] = 1;
+		}
+		return;
+	}
+
+	CullNode(bvh, node + 1, depth + 1, pFrontier, counts);
+	CullNode(bvh, n.First, depth + 1, pFrontier, counts);
+}
+
+void Culler::AcceptItems(const BoundingVolumeHierarchy& bvh, unsigned first, unsigned end, CullCounts& counts)
+{
+	uint8_t* pFlags = &m_Flags[0];
+	if(!m_UseOcclusion)
+	{
+		memset(pFlags + first, 1, end - first);
+		return;
+	}
+
+	const AABB* pBounds = bvh.GetItemBounds();
+	for(unsigned i = first; i < end; ++i)
+	{
+		if(m_Occlusion.TestAABB(pBounds[i]))
+			pFlags[i] = 1;
+		else
+			++counts.OcclusionCulled;
+	}
+}
@@ -0,0 +1,125 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Visibility culling stage run between Update and Render. Tests
+				packed bounding spheres or boxes (or a BVH of static boxes) against
+				the view frustum with SIMD, optionally against a software depth
+				buffer of occluders, in parallel chunks on the job system, and
+				produces the list of visible object indices plus per call stats.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "SimdMath.h"
+#include "OcclusionBuffer.h"
+#include "BoundingVolumeHierarchy.h"
+
+#include <vector>
+#include <atomic>
+
+class JobSystem;
+
+struct CullStats
+{
+	unsigned	Tested;				//Objects considered
+	unsigned	FrustumCulled;		//Outside the frustum
+	unsigned	OcclusionCulled;	//Hidden by occluders (CullBVH counts hidden subtrees as a whole,
+									//including objects of them outside the frustum)
+	unsigned	Visible;
+	unsigned	Occluders;			//Occluders rasterized
+	unsigned	NodesVisited;		//BVH nodes tested (CullBVH only)
+	double		OcclusionMs;		//Occluder rasterization
+	double		CullMs;				//Whole call including rasterization
+};
+
+class Culler
+{
+public:
+	//Objects per parallel chunk
+	enum { CHUNK_SIZE = 4096 };
+
+	Culler();
+
+	//Sizes the result arrays for maxObjects so culling does not allocate, and
+	//the occlusion buffer (0 x 0 disables occlusion culling)
+	void Init(unsigned maxObjects, unsigned occlusionWidth = 256, unsigned occlusionHeight = 128);
+
+	void SetCamera(const Mat4& view, const Mat4& proj);
+	//Occluders for the following Cull calls (the boxes are copied). Occluders
+	//should be large, nearby objects; the occluders themselves are culled too.
+	void SetOccluders(const AABB* pBoxes, unsigned count);
+	void EnableOcclusion(bool enable) { m_OcclusionEnabled = enable; }
+	bool IsOcclusionEnabled() const { return m_OcclusionEnabled && !m_Occluders.empty() && m_Occlusion.GetWidth() > 0; }
+
+	//Each call replaces the visible list and stats. With pJobs the objects are
+	//tested in parallel chunks, otherwise on the calling thread.
+	unsigned CullSpheres(const float* pX, const float* pY, const float* pZ, const float* pRadius, unsigned count,
+		JobSystem* pJobs = NULL);
+	unsigned CullAABBs(const AABB* pBoxes, unsigned count, JobSystem* pJobs = NULL);
+	//Whole subtrees are rejected (or accepted) with one test per node
+	unsigned CullBVH(const BoundingVolumeHierarchy& bvh, JobSystem* pJobs = NULL);
+
+	//Visible object indices of the last call, ascending except for CullBVH (leaf order)
+	const uint32_t* GetVisible() const { return m_Visible.empty() ? NULL : &m_Visible[0]; }
+	unsigned GetVisibleCount() const { return m_Stats.Visible; }
+	const CullStats& GetStats() const { return m_Stats; }
+	const Frustum& GetFrustum() const { return m_Frustum; }
+	const OcclusionBuffer& GetOcclusionBuffer() const { return m_Occlusion; }
+
+private:
+	//Disallow copying
+	Culler(const Culler&);
+	Culler& operator=(const Culler&);
+
+	struct CullCounts
+	{
+		unsigned FrustumCulled;
+		unsigned OcclusionCulled;
+		unsigned NodesVisited;
+	};
+
+	struct ChunkData
+	{
+		Culler*		pCuller;
+		const float* pX;
+		const float* pY;
+		const float* pZ;
+		const float* pRadius;
+		const AABB*	pBoxes;
+		const BoundingVolumeHierarchy* pBvh;
+	};
+
+	//Starts a call: resets the stats and renders the occluders
+	void Begin(unsigned count);
+	//Builds the visible list from the flags, fills the stats
+	unsigned End(const uint32_t* pItems, unsigned count, int64_t startTicks);
+	void AddCounts(const CullCounts& counts);
+
+	void CullSphereRange(const ChunkData& data, unsigned begin, unsigned end);
+	void CullBoxRange(const ChunkData& data, unsigned begin, unsigned end);
+	//Tests BVH node and its subtree. With pFrontier, nodes at PARALLEL_DEPTH are
+	//collected there instead so they can run as separate jobs.
+	void CullNode(const BoundingVolumeHierarchy& bvh, unsigned node, unsigned depth, std::vector<uint32_t>* pFrontier,
+		CullCounts& counts);
+	//Flags BVH items [first, end) visible, minus the occluded ones
+	void AcceptItems(const BoundingVolumeHierarchy& bvh, unsigned first, unsigned end, CullCounts& counts);
+
+	static void SphereChunkJob(void* pData, unsigned begin, unsigned end);
+	static void BoxChunkJob(void* pData, unsigned begin, unsigned end);
+	static void NodeJob(void* pData, unsigned begin, unsigned end);
+
+	Frustum					m_Frustum;
+	Mat4					m_ViewProj;
+	OcclusionBuffer			m_Occlusion;
+	std::vector<AABB>		m_Occluders;
+	bool					m_OcclusionEnabled;
+	bool					m_UseOcclusion;		//Occlusion active for the current call
+
+	std::vector<uint8_t>	m_Flags;			//Visibility of every object of the current call
+	std::vector<uint32_t>	m_Visible;
+	std::vector<uint32_t>	m_Frontier;			//BVH subtrees handed to jobs
+
+	std::atomic<unsigned>	m_FrustumCulled;
+	std::atomic<unsigned>	m_OcclusionCulled;
+	std::atomic<unsigned>	m_NodesVisited;
+	CullStats				m_Stats;
+};
@@ -0,0 +1,554 @@
+#include "D3D9RenderDevice.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+
+namespace
+{
+	//Vertex buffer wrapper
+	class D3D9VertexBuffer : public IVertexBuffer
+	{
+	public:
+		D3D9VertexBuffer(IDirect3DVertexBuffer9* pVB, unsigned size, RDPool pool)
+			: m_pVB(pVB), m_Size(size), m_Pool(pool) {}
+		~D3D9VertexBuffer() { SAFE_RELEASE(m_pVB); }
+
+		bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags) override
+		{
+			return SUCCEEDED(m_pVB->Lock(offset, size, ppData, flags));
+		}
+		void Unlock() override { m_pVB->Unlock(); }
+		void Release() override { delete this; }
+		unsigned GetSize() const override { return m_Size; }
+		RDPool GetPool() const override { return m_Pool; }
+
+		IDirect3DVertexBuffer9* m_pVB;
+
+	private:
+		unsigned m_Size;
+		RDPool m_Pool;
+	};
+
+	//Index buffer wrapper
+	class D3D9IndexBuffer : public IIndexBuffer
+	{
+	public:
+		D3D9IndexBuffer(IDirect3DIndexBuffer9* pIB, unsigned size, RDIndexFormat format, RDPool pool)
+			: m_pIB(pIB), m_Size(size), m_Format(format), m_Pool(pool) {}
+		~D3D9IndexBuffer() { SAFE_RELEASE(m_pIB); }
+
+		bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags) override
+		{
+			return SUCCEEDED(m_pIB->Lock(offset, size, ppData, flags));
+		}
+		void Unlock() override { m_pIB->Unlock(); }
+		void Release() override { delete this; }
+		unsigned GetSize() const override { return m_Size; }
+		RDPool GetPool() const override { return m_Pool; }
+		RDIndexFormat GetFormat() const override { return m_Format; }
+
+		IDirect3DIndexBuffer9* m_pIB;
+
+	private:
+		unsigned m_Size;
+		RDIndexFormat m_Format;
+		RDPool m_Pool;
+	};
+
+	//Back buffer copy. StretchRect() into the render target is queued like a
+	//draw call, GetRenderTargetData() in Lock() waits for it and fetches the
+	//pixels, so lock a surface a few frames after copying into it.
+	class D3D9ReadbackSurface : public IReadbackSurface
+	{
+	public:
+		D3D9ReadbackSurface(IDirect3DDevice9* pDevice, IDirect3DSurface9* pTarget, IDirect3DSurface9* pSystem,
+			unsigned width, unsigned height)
+			: m_pTarget(pTarget), m_pDevice(pDevice), m_pSystem(pSystem), m_Width(width), m_Height(height) {}
+		~D3D9ReadbackSurface()
+		{
+			SAFE_RELEASE(m_pTarget);
+			SAFE_RELEASE(m_pSystem);
+		}
+
+		bool Lock(const RDCOLOR** ppPixels, unsigned* pPitch) override
+		{
+			if(FAILED(m_pDevice->GetRenderTargetData(m_pTarget, m_pSystem)))
+				return false;
+			D3DLOCKED_RECT rect;
+			if(FAILED(m_pSystem->LockRect(&rect, NULL, D3DLOCK_READONLY)))
+				return false;
+			*ppPixels = (const RDCOLOR*)rect.pBits;
+			*pPitch = rect.Pitch / sizeof(RDCOLOR);
+			return true;
+		}
+		void Unlock() override { m_pSystem->UnlockRect(); }
+		void Release() override { delete this; }
+		unsigned GetWidth() const override { return m_Width; }
+		unsigned GetHeight() const override { return m_Height; }
+
+		IDirect3DSurface9* m_pTarget;
+
+	private:
+		IDirect3DDevice9* m_pDevice;
+		IDirect3DSurface9* m_pSystem;
+		unsigned m_Width;
+		unsigned m_Height;
+	};
+
+	//Vertex declaration wrapper
+	class D3D9VertexDeclaration : public IVertexDeclaration
+	{
+	public:
+		D3D9VertexDeclaration(IDirect3DVertexDeclaration9* pDecl, bool instanced)
+			: m_pDecl(pDecl), m_Instanced(instanced) {}
+		~D3D9VertexDeclaration() { SAFE_RELEASE(m_pDecl); }
+
+		void Release() override { delete this; }
+
+		IDirect3DVertexDeclaration9* m_pDecl;
+		bool m_Instanced;	//Drawn with the instance shaders
+	};
+
+	//Owns one of the two shader objects, depending on the type
+	class D3D9Shader : public IShader
+	{
+	public:
+		explicit D3D9Shader(IDirect3DVertexShader9* pVS) : m_Type(RD_SHADER_VERTEX), m_pVS(pVS), m_pPS(NULL) {}
+		explicit D3D9Shader(IDirect3DPixelShader9* pPS) : m_Type(RD_SHADER_PIXEL), m_pVS(NULL), m_pPS(pPS) {}
+		~D3D9Shader()
+		{
+			SAFE_RELEASE(m_pVS);
+			SAFE_RELEASE(m_pPS);
+		}
+
+		RDShaderType GetShaderType() const override { return m_Type; }
+		void Release() override { delete this; }
+
+		RDShaderType m_Type;
+		IDirect3DVertexShader9* m_pVS;
+		IDirect3DPixelShader9* m_pPS;
+	};
+
+	class D3D9Texture : public ITexture
+	{
+	public:
+		D3D9Texture(IDirect3DTexture9* pTexture, unsigned width, unsigned height)
+			: m_pTexture(pTexture), m_Width(width), m_Height(height) {}
+		~D3D9Texture() { SAFE_RELEASE(m_pTexture); }
+
+		bool Update(unsigned x, unsigned y, unsigned width, unsigned height, const RDCOLOR* pPixels, unsigned pitch) override
+		{
+			if(!pPixels || width == 0 || height == 0 || x + width > m_Width || y + height > m_Height || pitch < width)
+				return false;
+
+			//Locking only the region keeps the rest of the managed copy clean
+			RECT rect = { (LONG)x, (LONG)y, (LONG)(x + width), (LONG)(y + height) };
+			D3DLOCKED_RECT locked;
+			if(FAILED(m_pTexture->LockRect(0, &locked, &rect, 0)))
+				return false;
+			for(unsigned row = 0; row < height; ++row)
+				memcpy((uint8_t*)locked.pBits + row * locked.Pitch, pPixels + (size_t)row * pitch, width * sizeof(RDCOLOR));
+			m_pTexture->UnlockRect(0);
+			return true;
+		}
+		void Release() override { delete this; }
+		unsigned GetWidth() const override { return m_Width; }
+		unsigned GetHeight() const override { return m_Height; }
+
+		IDirect3DTexture9* m_pTexture;
+
+	private:
+		unsigned m_Width;
+		unsigned m_Height;
+	};
+
+	//World position from the instance rows (v2 .. v5), clip position from the
+	//view * projection columns in c0 .. c3, vertex color times instance color
+	const char* INSTANCE_VS =
+		"vs_3_0\n"
+		"def c4, 1, 0, 0, 0\n"
+		"dcl_position v0\n"
+		"dcl_color v1\n"
+		"dcl_texcoord1 v2\n"
+		"dcl_texcoord2 v3\n"
+		"dcl_texcoord3 v4\n"
+		"dcl_texcoord4 v5\n"
+		"dcl_color1 v6\n"
+		"dcl_position o0\n"
+		"dcl_color o1\n"
+		"mul r0.xyz, v0.x, v2\n"
+		"mad r0.xyz, v0.y, v3, r0\n"
+		"mad r0.xyz, v0.z, v4, r0\n"
+		"add r0.xyz, r0, v5\n"
+		"mov r0.w, c4.x\n"
+		"dp4 o0.x, r0, c0\n"
+		"dp4 o0.y, r0, c1\n"
+		"dp4 o0.z, r0, c2\n"
+		"dp4 o0.w, r0, c3\n"
+		"mul o1, v1, v6\n";
+
+	const char* INSTANCE_PS =
+		"ps_3_0\n"
+		"dcl_color v0\n"
+		"mov oC0, v0\n";
+}
+
+D3D9RenderDevice::D3D9RenderDevice(IDirect3DDevice9* pDevice, const D3DPRESENT_PARAMETERS& params)
+{
+	m_pDevice = pDevice;
+	m_pDevice->AddRef();
+	m_d3dpp = params;
+	m_pVS = NULL;
+	m_pPS = NULL;
+
+	m_pInstanceVS = NULL;
+	m_pInstancePS = NULL;
+	m_ShadersBound = false;
+	D3DXMatrixIdentity(&m_View);
+	D3DXMatrixIdentity(&m_Proj);
+	m_ViewProjDirty = true;
+
+	D3DCAPS9 caps;
+	m_SupportsShaders = false;
+	m_MaxTextureSize = 0;
+	m_DeclTypeCaps = 0;
+	if(SUCCEEDED(m_pDevice->GetDeviceCaps(&caps)))
+	{
+		m_DeclTypeCaps = caps.DeclTypes;
+		m_MaxTextureSize = caps.MaxTextureWidth < caps.MaxTextureHeight ? caps.MaxTextureWidth : caps.MaxTextureHeight;
+		m_SupportsShaders = caps.VertexShaderVersion >= D3DVS_VERSION(2, 0) && caps.PixelShaderVersion >= D3DPS_VERSION(2, 0);
+		CreateInstanceShaders(caps);
+	}
+}
+
+D3D9RenderDevice::~D3D9RenderDevice()
+{
+	SAFE_RELEASE(m_pInstanceVS);
+	SAFE_RELEASE(m_pInstancePS);
+	SAFE_RELEASE(m_pDevice);
+}
+
+void D3D9RenderDevice::CreateInstanceShaders(const D3DCAPS9& caps)
+{
+	if(caps.VertexShaderVersion < D3DVS_VERSION(3, 0) || caps.PixelShaderVersion < D3DPS_VERSION(3, 0))
+		return;
+
+	ID3DXBuffer* pVSCode = NULL;
+	ID3DXBuffer* pPSCode = NULL;
+	if(SUCCEEDED(D3DXAssembleShader(INSTANCE_VS, (UINT)strlen(INSTANCE_VS), NULL, NULL, 0, &pVSCode, NULL)) &&
+		SUCCEEDED(D3DXAssembleShader(INSTANCE_PS, (UINT)strlen(INSTANCE_PS), NULL, NULL, 0, &pPSCode, NULL)) &&
+		SUCCEEDED(m_pDevice->CreateVertexShader((const DWORD*)pVSCode->GetBufferPointer(), &m_pInstanceVS)) &&
+		SUCCEEDED(m_pDevice->CreatePixelShader((const DWORD*)pPSCode->GetBufferPointer(), &m_pInstancePS)))
+	{
+		SAFE_RELEASE(pVSCode);
+		SAFE_RELEASE(pPSCode);
+		return;
+	}
+
+	//Without both shaders there is no instancing
+	SAFE_RELEASE(pVSCode);
+	SAFE_RELEASE(pPSCode);
+	SAFE_RELEASE(m_pInstanceVS);
+	SAFE_RELEASE(m_pInstancePS);
+}
+
+bool D3D9RenderDevice::CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB)
+{
+	IDirect3DVertexBuffer9* pVB = NULL;
+	if(FAILED(m_pDevice->CreateVertexBuffer(length, usage, fvf, (D3DPOOL)pool, &pVB, NULL)))
+		return false;
+
+	*ppVB = new D3D9VertexBuffer(pVB, length, pool);
+	return true;
+}
+
+bool D3D9RenderDevice::CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB)
+{
+	IDirect3DIndexBuffer9* pIB = NULL;
+	if(FAILED(m_pDevice->CreateIndexBuffer(length, usage, (D3DFORMAT)format, (D3DPOOL)pool, &pIB, NULL)))
+		return false;
+
+	*ppIB = new D3D9IndexBuffer(pIB, length, format, pool);
+	return true;
+}
+
+bool D3D9RenderDevice::CreateReadbackSurface(IReadbackSurface** ppSurface)
+{
+	//Both surfaces are X8R8G8B8, StretchRect() converts from the back buffer format
+	unsigned width = m_d3dpp.BackBufferWidth;
+	unsigned height = m_d3dpp.BackBufferHeight;
+	IDirect3DSurface9* pTarget = NULL;
+	IDirect3DSurface9* pSystem = NULL;
+	if(FAILED(m_pDevice->CreateRenderTarget(width, height, D3DFMT_X8R8G8B8, D3DMULTISAMPLE_NONE, 0, FALSE, &pTarget, NULL)))
+		return false;
+	if(FAILED(m_pDevice->CreateOffscreenPlainSurface(width, height, D3DFMT_X8R8G8B8, D3DPOOL_SYSTEMMEM, &pSystem, NULL)))
+	{
+		SAFE_RELEASE(pTarget);
+		return false;
+	}
+
+	*ppSurface = new D3D9ReadbackSurface(m_pDevice, pTarget, pSystem, width, height);
+	return true;
+}
+
+bool D3D9RenderDevice::CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl)
+{
+	if(!pElements || !ppDecl)
+		return false;
+
+	//A per instance world matrix needs the instance shaders. Packed element types
+	//are optional, creating the declaration succeeds without them but drawing fails.
+	bool instanced = false;
+	for(const RDVertexElement* pElement = pElements; pElement->Stream != 0xFF; ++pElement)
+	{
+		if(pElement->Usage == RD_DECLUSAGE_TEXCOORD && pElement->UsageIndex == RD_INSTANCE_WORLD_INDEX)
+			instanced = true;
+
+		DWORD required = 0;
+		switch(pElement->Type)
+		{
+		case RD_DECLTYPE_UBYTE4N: required = D3DDTCAPS_UBYTE4N; break;
+		case RD_DECLTYPE_SHORT2N: required = D3DDTCAPS_SHORT2N; break;
+		case RD_DECLTYPE_SHORT4N: required = D3DDTCAPS_SHORT4N; break;
+		case RD_DECLTYPE_FLOAT16_2: required = D3DDTCAPS_FLOAT16_2; break;
+		case RD_DECLTYPE_FLOAT16_4: required = D3DDTCAPS_FLOAT16_4; break;
+		default: break;
+		}
+		if((m_DeclTypeCaps & required) != required)
+			return false;
+	}
+	if(instanced && !m_pInstanceVS)
+		return false;
+
+	//RDVertexElement has the same layout as D3DVERTEXELEMENT9
+	IDirect3DVertexDeclaration9* pDecl = NULL;
+	if(FAILED(m_pDevice->CreateVertexDeclaration(reinterpret_cast<const D3DVERTEXELEMENT9*>(pElements), &pDecl)))
+		return false;
+
+	*ppDecl = new D3D9VertexDeclaration(pDecl, instanced);
+	return true;
+}
+
+bool D3D9RenderDevice::CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader)
+{
+	//The bytecode ends with its own end token, size only rules out empty blobs
+	if(!m_SupportsShaders || !pBytecode || size < sizeof(DWORD) || !ppShader)
+		return false;
+
+	if(type == RD_SHADER_VERTEX)
+	{
+		IDirect3DVertexShader9* pVS = NULL;
+		if(FAILED(m_pDevice->CreateVertexShader((const DWORD*)pBytecode, &pVS)))
+			return false;
+		*ppShader = new D3D9Shader(pVS);
+	}
+	else
+	{
+		IDirect3DPixelShader9* pPS = NULL;
+		if(FAILED(m_pDevice->CreatePixelShader((const DWORD*)pBytecode, &pPS)))
+			return false;
+		*ppShader = new D3D9Shader(pPS);
+	}
+	return true;
+}
+
+bool D3D9RenderDevice::CreateTexture(unsigned width, unsigned height, ITexture** ppTexture)
+{
+	if(width == 0 || height == 0 || width > m_MaxTextureSize || height > m_MaxTextureSize || !ppTexture)
+		return false;
+
+	IDirect3DTexture9* pTexture = NULL;
+	if(FAILED(m_pDevice->CreateTexture(width, height, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &pTexture, NULL)))
+		return false;
+	*ppTexture = new D3D9Texture(pTexture, width, height);
+	return true;
+}
+
+void D3D9RenderDevice::SetViewport(const RDViewport& viewport)
+{
+	//RDViewport has the same layout as D3DVIEWPORT9
+	m_pDevice->SetViewport(reinterpret_cast<const D3DVIEWPORT9*>(&viewport));
+}
+
+void D3D9RenderDevice::SetTransform(RDTransformType type, const float* matrix)
+{
+	m_pDevice->SetTransform((D3DTRANSFORMSTATETYPE)type, reinterpret_cast<const D3DMATRIX*>(matrix));
+
+	//Shaders do not see the fixed function transforms
+	if(type == RD_TS_VIEW || type == RD_TS_PROJECTION)
+	{
+		memcpy(type == RD_TS_VIEW ? &m_View : &m_Proj, matrix, sizeof(D3DXMATRIX));
+		m_ViewProjDirty = true;
+	}
+}
+
+void D3D9RenderDevice::SetRenderState(RDRenderState state, RDWORD value)
+{
+	m_pDevice->SetRenderState((D3DRENDERSTATETYPE)state, value);
+}
+
+void D3D9RenderDevice::SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride)
+{
+	IDirect3DVertexBuffer9* pD3DVB = pVB ? static_cast<D3D9VertexBuffer*>(pVB)->m_pVB : NULL;
+	m_pDevice->SetStreamSource(stream, pD3DVB, offset, stride);
+}
+
+void D3D9RenderDevice::SetIndices(IIndexBuffer* pIB)
+{
+	IDirect3DIndexBuffer9* pD3DIB = pIB ? static_cast<D3D9IndexBuffer*>(pIB)->m_pIB : NULL;
+	m_pDevice->SetIndices(pD3DIB);
+}
+
+void D3D9RenderDevice::SetFVF(RDWORD fvf)
+{
+	BindInstanceShaders(false);
+	m_pDevice->SetFVF(fvf);
+}
+
+void D3D9RenderDevice::SetVertexDeclaration(IVertexDeclaration* pDecl)
+{
+	D3D9VertexDeclaration* pD3DDecl = static_cast<D3D9VertexDeclaration*>(pDecl);
+	BindInstanceShaders(pD3DDecl && pD3DDecl->m_Instanced);
+	m_pDevice->SetVertexDeclaration(pD3DDecl ? pD3DDecl->m_pDecl : NULL);
+}
+
+void D3D9RenderDevice::SetStreamSourceFreq(unsigned stream, RDWORD setting)
+{
+	m_pDevice->SetStreamSourceFreq(stream, setting);
+}
+
+void D3D9RenderDevice::SetShader(RDShaderType type, IShader* pShader)
+{
+	D3D9Shader* pD3DShader = static_cast<D3D9Shader*>(pShader);
+	if(type == RD_SHADER_VERTEX)
+		m_pVS = pD3DShader ? pD3DShader->m_pVS : NULL;
+	else
+		m_pPS = pD3DShader ? pD3DShader->m_pPS : NULL;
+
+	//Instanced declarations keep their own shaders until the next FVF or declaration
+	if(m_ShadersBound)
+		return;
+	if(type == RD_SHADER_VERTEX)
+		m_pDevice->SetVertexShader(m_pVS);
+	else
+		m_pDevice->SetPixelShader(m_pPS);
+}
+
+void D3D9RenderDevice::SetTexture(unsigned stage, ITexture* pTexture)
+{
+	m_pDevice->SetTexture(stage, pTexture ? static_cast<D3D9Texture*>(pTexture)->m_pTexture : NULL);
+}
+
+void D3D9RenderDevice::SetShaderConstantF(RDShaderType type, unsigned start, const float* pData, unsigned count)
+{
+	if(type == RD_SHADER_PIXEL)
+	{
+		m_pDevice->SetPixelShaderConstantF(start, pData, count);
+		return;
+	}
+
+	m_pDevice->SetVertexShaderConstantF(start, pData, count);
+	//The instance shaders read the same registers
+	if(start < 4)
+		m_ViewProjDirty = true;
+}
+
+void D3D9RenderDevice::BindInstanceShaders(bool bind)
+{
+	if(bind == m_ShadersBound)
+		return;
+	m_pDevice->SetVertexShader(bind ? m_pInstanceVS : m_pVS);
+	m_pDevice->SetPixelShader(bind ? m_pInstancePS : m_pPS);
+	m_ShadersBound = bind;
+}
+
+void D3D9RenderDevice::UpdateShaderConstants()
+{
+	if(!m_ShadersBound || !m_ViewProjDirty)
+		return;
+
+	//dp4 with the rows of the transpose gives row vector * matrix
+	D3DXMATRIX viewProj, columns;
+	D3DXMatrixMultiply(&viewProj, &m_View, &m_Proj);
+	D3DXMatrixTranspose(&columns, &viewProj);
+	m_pDevice->SetVertexShaderConstantF(0, columns, 4);
+	m_ViewProjDirty = false;
+}
+
+void D3D9RenderDevice::Clear(RDWORD flags, RDCOLOR color, float z, RDWORD stencil)
+{
+	m_pDevice->Clear(0, 0, flags, color, z, stencil);
+}
+
+void D3D9RenderDevice::BeginScene()
+{
+	m_pDevice->BeginScene();
+}
+
+void D3D9RenderDevice::EndScene()
+{
+	m_pDevice->EndScene();
+}
+
+void D3D9RenderDevice::DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount)
+{
+	UpdateShaderConstants();
+	m_pDevice->DrawPrimitive((D3DPRIMITIVETYPE)type, startVertex, primCount);
+}
+
+void D3D9RenderDevice::DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+	unsigned numVertices, unsigned startIndex, unsigned primCount)
+{
+	UpdateShaderConstants();
+	m_pDevice->DrawIndexedPrimitive((D3DPRIMITIVETYPE)type, baseVertexIndex, minIndex, numVertices, startIndex, primCount);
+}
+
+void D3D9RenderDevice::Present()
+{
+	m_pDevice->Present(0, 0, 0, 0);
+}
+
+bool D3D9RenderDevice::CopyBackBuffer(IReadbackSurface* pSurface)
+{
+	IDirect3DSurface9* pBackBuffer = NULL;
+	if(FAILED(m_pDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
+		return false;
+
+	//Also resolves a multisampled back buffer
+	HRESULT result = m_pDevice->StretchRect(pBackBuffer, NULL, static_cast<D3D9ReadbackSurface*>(pSurface)->m_pTarget, NULL, D3DTEXF_NONE);
+	SAFE_RELEASE(pBackBuffer);
+	return SUCCEEDED(result);
+}
+
+RDDeviceState D3D9RenderDevice::TestCooperativeLevel()
+{
+	HRESULT hr = m_pDevice->TestCooperativeLevel();
+	if(hr == D3DERR_DEVICELOST)
+		return RD_DEVICE_LOST;
+	else if(hr == D3DERR_DRIVERINTERNALERROR)
+		return RD_DEVICE_DRIVERERROR;
+	else if(hr == D3DERR_DEVICENOTRESET)
+		return RD_DEVICE_NOTRESET;
+	else
+		return RD_DEVICE_OK;
+}
+
+bool D3D9RenderDevice::Reset(const RDPresentParams& params)
+{
+	m_d3dpp.BackBufferWidth = params.BackBufferWidth;
+	m_d3dpp.BackBufferHeight = params.BackBufferHeight;
+	//Fullscreen needs an explicit format, windowed mode uses the desktop format
+	m_d3dpp.BackBufferFormat = params.Windowed ? D3DFMT_UNKNOWN : D3DFMT_X8R8G8B8;
+	m_d3dpp.Windowed = params.Windowed;
+
+	//Shaders and their constants go back to the defaults, the next declaration binds them again
+	m_ShadersBound = false;
+	m_ViewProjDirty = true;
+
+	HRESULT result = S_OK;
+	HR(result = m_pDevice->Reset(&m_d3dpp));
+	return SUCCEEDED(result);
+}
+
+#endif
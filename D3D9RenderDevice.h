@@ -0,0 +1,98 @@
+/* Title: DirectX 9.0c Framework
+/* Description: IRenderDevice backend that forwards to an IDirect3DDevice9 (Windows only).
+				Instanced declarations are drawn with a built-in vs_3_0/ps_3_0
+				shader pair (world matrix and color per instance, no lighting),
+				everything else with the application's shaders or the fixed
+				function pipeline. Instanced draws overwrite vertex shader
+				constants c0 .. c3.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#ifdef _WIN32
+
+#include "d3dUtil.h"
+#include "RenderDevice.h"
+
+//Hardware (Direct3D 9) rendering device
+class D3D9RenderDevice : public IRenderDevice
+{
+public:
+	//Takes a reference on the device. params are the present parameters
+	//the device was created with, a copy is kept and updated on Reset().
+	D3D9RenderDevice(IDirect3DDevice9* pDevice, const D3DPRESENT_PARAMETERS& params);
+	~D3D9RenderDevice();
+
+	RDDeviceType GetType() const override { return RD_DEVICE_DIRECT3D9; }
+	IDirect3DDevice9* GetDevice() const { return m_pDevice; }
+
+	bool CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB) override;
+	bool CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB) override;
+	//A default pool render target the copy lands in, and the system memory
+	//surface it is fetched into when locked
+	bool CreateReadbackSurface(IReadbackSurface** ppSurface) override;
+	bool CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl) override;
+	bool CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader) override;
+	//D3DFMT_A8R8G8B8 in the managed pool
+	bool CreateTexture(unsigned width, unsigned height, ITexture** ppTexture) override;
+
+	void SetViewport(const RDViewport& viewport) override;
+	void SetTransform(RDTransformType type, const float* matrix) override;
+	void SetRenderState(RDRenderState state, RDWORD value) override;
+	void SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride) override;
+	void SetIndices(IIndexBuffer* pIB) override;
+	void SetFVF(RDWORD fvf) override;
+	void SetVertexDeclaration(IVertexDeclaration* pDecl) override;
+	void SetStreamSourceFreq(unsigned stream, RDWORD setting) override;
+	void SetShader(RDShaderType type, IShader* pShader) override;
+	void SetShaderConstantF(RDShaderType type, unsigned start, const float* pData, unsigned count) override;
+	void SetTexture(unsigned stage, ITexture* pTexture) override;
+
+	void Clear(RDWORD flags, RDCOLOR color, float z, RDWORD stencil) override;
+	void BeginScene() override;
+	void EndScene() override;
+	void DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount) override;
+	void DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+		unsigned numVertices, unsigned startIndex, unsigned primCount) override;
+	void Present() override;
+	bool CopyBackBuffer(IReadbackSurface* pSurface) override;
+
+	//Shader model 3.0 hardware
+	bool SupportsInstancing() const override { return m_pInstanceVS != NULL; }
+	//Shader model 2.0 hardware
+	bool SupportsShaders() const override { return m_SupportsShaders; }
+	unsigned GetMaxTextureSize() const override { return m_MaxTextureSize; }
+
+	RDDeviceState TestCooperativeLevel() override;
+	bool Reset(const RDPresentParams& params) override;
+
+private:
+	//Disallow copying
+	D3D9RenderDevice(const D3D9RenderDevice&);
+	D3D9RenderDevice& operator=(const D3D9RenderDevice&);
+
+	void CreateInstanceShaders(const D3DCAPS9& caps);
+	//Binds the instance shaders, or the application's shaders again
+	void BindInstanceShaders(bool bind);
+	//Uploads the transposed view * projection matrix the instance shader reads
+	void UpdateShaderConstants();
+
+	IDirect3DDevice9*		m_pDevice;		//Wrapped device
+	D3DPRESENT_PARAMETERS	m_d3dpp;		//Present parameters used for Reset()
+	bool					m_SupportsShaders;
+	unsigned				m_MaxTextureSize;
+	DWORD					m_DeclTypeCaps;		//D3DDTCAPS_* of the packed vertex element types
+	IDirect3DVertexShader9*	m_pVS;			//Set by the application, NULL for fixed function
+	IDirect3DPixelShader9*	m_pPS;
+
+	//Instanced drawing
+	IDirect3DVertexShader9*	m_pInstanceVS;
+	IDirect3DPixelShader9*	m_pInstancePS;
+	bool					m_ShadersBound;
+	D3DXMATRIX				m_View;
+	D3DXMATRIX				m_Proj;
+	bool					m_ViewProjDirty;
+};
+
+#endif
@@ -1,129 +1,555 @@
 #include "DXApp.h"
+#ifdef _WIN32
+#include "D3D9RenderDevice.h"
+#endif
+#include "SoftwareRenderDevice.h"
+#include "NullRenderDevice.h"
+#include "StateCache.h"
+#include "ResourceRegistry.h"
+#include "Timer.h"
+#include "HeapStats.h"
+
+#include <math.h>
 
 namespace
 {
-	//Create global pointer to a DXApp object
-	//This will be used to forward messages from a global space to
-	//our user define message procedure. This is necessary due to the fact that
-	//we cant create a method defined as WNDPROC.
-	DXApp* g_pApp = NULL;
-}
-
-//GLOBAL MESSAGE PROCEDURE
-//This is used to forward messages to our used defined procedure function
-LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
-{
-	//Forward messages
-	if(g_pApp)
-		return (g_pApp->MsgProc(hwnd, msg, wParam, lParam));
-	else
-		return DefWindowProc(hwnd, msg, wParam, lParam);
+	//Copies the software device back buffer into the application window
+	void PresentSoftwareBackBuffer(void* pContext, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+	{
+		IPlatformWindow* pWindow = (IPlatformWindow*)pContext;
+		pWindow->PresentPixels(pPixels, width, height, pitch);
+	}
 }
 
 DXApp::DXApp(HINSTANCE hInstance)
 {
 	//Initialize members
 	m_hAppInstance = hInstance;
-	m_hAppWindow = NULL;
+	m_pWindow = NULL;
 	m_AppTitle = "DIRECTX APPLICATION";
 	m_ClientWidth = 800;
 	m_ClientHeight = 600;
 	m_EnableFullscreen = false; //not used yet anyway
 	m_Paused = false; //application starts unpaused
 	m_FPS = 0;
-	m_WindowStyle = WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MINIMIZEBOX; //Standard non-resizeable window
-	g_pApp = this; //Set our global pointer
+	m_Quit = false;
+	m_ExitCode = 0;
+	m_Headless = false;
+	m_HeadlessDevice = RD_DEVICE_SOFTWARE;
 
+#ifdef _WIN32
 	m_pDirect3D = 0;
 	m_pDevice3D = 0;
 	m_DevType = D3DDEVTYPE_HAL;
+	ZeroMemory(&m_d3dpp, sizeof(D3DPRESENT_PARAMETERS));
+#endif
+	m_pRenderDevice = 0;
+	m_pStateCache = 0;
+	m_pResources = 0;
+	m_pNullDevice = 0;
+	m_DeviceLossInterval = 0;
+	m_TargetFps = -1.0;
+	m_PacingMode = PACING_LATENCY;
+	m_Pacer.SetSmoothing(4);
+	m_FramesInFlight = 0;
+	m_UpdateSnapshot = 0;
+	m_RenderSnapshot = 0;
+	for(int i = 0; i < FramePipeline::MAX_SLOTS; ++i)
+	{
+		m_SnapshotArenaBytes[i] = 0;
+		m_SnapshotCullTicks[i] = 0;
+		m_Interpolation[i] = 1.0f;
+	}
+	m_FrameArenaSize = 4 * 1024 * 1024;
+	m_UploadBudget = 4 * 1024 * 1024;
+	m_StartTicks = TimerTicks();
+	m_StartupMs = 0.0;
+	m_TraceSpikeMs = 0.0;
+	m_LastTraceTicks = 0;
+	m_Offscreen = false;
+	m_pFrameSink = NULL;
+	m_ReadbackRing = 3;
+	m_ShaderCachePath = "shaders.cache";
+	memset(m_InputSnapshots, 0, sizeof(m_InputSnapshots));
+	m_InputEventCount = 0;
+	m_StopInput = false;
+	m_InputRate = 0;
+	m_PresentParams.BackBufferWidth = m_ClientWidth;
+	m_PresentParams.BackBufferHeight = m_ClientHeight;
+	m_PresentParams.Windowed = true;
 }
 
 DXApp::~DXApp(void)
 {
 	//Release objects from memory
+	if(m_InputThread.joinable())
+	{
+		m_StopInput = true;
+		m_InputThread.join();
+	}
+	m_Pipeline.Stop();
+	m_Jobs.Shutdown();
+	//Streamed buffers and readback surfaces belong to the device
+	m_Streamer.Shutdown();
+	m_Readback.Shutdown();
+	m_Shaders.Save();
+	m_Shaders.Shutdown();
+	SAFE_DELETE(m_pRenderDevice);
+#ifdef _WIN32
 	SAFE_RELEASE(m_pDevice3D);
 	SAFE_RELEASE(m_pDirect3D);
-	SAFE_DELETE(g_pApp);
+#endif
+	//The window outlives the device rendering into it
+	SAFE_DELETE(m_pWindow);
 }
 
 int DXApp::Run()
 {
 	//Main message loop (MAIN APPLICATION LOOP)
-	//For every application that remains persistent on a system there needs to be a loop of some kind
-	//As I explained further down, windows applications use a message based system. While your application
-	//is still receiving message that don't equal WM_QUIT it will be running on the system.
-	//Here is how your create such a loop:
-
-	//To create a high performance timer you must use two methods
-	//QueryPerformanceFrequency() and QueryPerformanceCounter()
-	
-	//QueryPerformanceFrequency():
-	//This method stores the (COUNTS PER SECOND) that your system timer is running at
-	//Using this we can cache a conversion to seconds per count
-	__int64 countsPerSec = 0;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
-	float secPerCount = 1.0f / countsPerSec; //Conversion to seconds per count
-
-	//QueryPerformanceCounter():
-	//This method stores and image of the current count of the system timer
-	//Using this we can find the count before and after we update to determine
-	//the CHANGE IN ELAPSED TIME (Otherwise known as deltaTime)
-	__int64 prevTime = 0;
-	QueryPerformanceCounter((LARGE_INTEGER*)&prevTime);
-
-	//Create MSG struct
-	MSG msg = {0}; //sets all members to null. (empty set)
-	while(WM_QUIT != msg.message) //While our message doesn't equal WM_QUIT
+	//For every application that remains persistent on a system there needs to be a loop of some kind.
+	//Every iteration the window turns the messages the OS sent it into events on our
+	//event ring, we handle them in one go and then update and render a frame.
+
+	//Frame pacing: instead of spinning through thousands of frames per second,
+	//every frame starts on a fixed schedule and the CPU sleeps in between.
+	//The pacer also measures the time between frames (deltaTime) with the
+	//high resolution timer (QueryPerformanceCounter on Windows) and smooths it.
+	double fps = m_TargetFps;
+	if(fps < 0.0 && m_Offscreen) //Nothing to display, export frames as fast as possible
+		fps = 0.0;
+	else if(fps < 0.0) //Follow the display
+		fps = m_pWindow->GetRefreshRate() > 0 ? m_pWindow->GetRefreshRate() : 60.0;
+	m_Pacer.SetTarget(fps, m_PacingMode);
+	m_Pacer.Start();
+	m_Timestep.Start();
+
+	StartPipeline();
+
+	while(!m_Quit) //While nobody asked us to quit
 	{
-		//Peek at a message on the stack,
-		//store it in msg,
-		//and remove it from the stack
-		if(PeekMessage(&msg, NULL, NULL, NULL, PM_REMOVE))
+		//One iteration of the main loop, the parent of the zones below
+		PROFILE_ZONE("Run");
+
+		//Wait for the frame's turn first, so the frame sees the input that
+		//arrived while we slept instead of input a whole wait old
+		float dt = 0.0f;
+		bool frameDue = !m_Paused && !IsDeviceLost();
+		if(frameDue)
 		{
-			TranslateMessage(&msg); //Translate message
-			DispatchMessage(&msg); //Dispatch message
+			PROFILE_ZONE("Pacing");
+			dt = (float)m_Pacer.WaitForFrame();
 		}
-		//Here is where things such as rendering, updating, etc. would go
-		else
+
+		//Move pending messages onto the event ring and handle them
+		{
+			PROFILE_ZONE("Events");
+			m_pWindow->PumpEvents();
+			ProcessEvents();
+		}
+		if(m_Quit)
+			break;
+
+		//Here is where things such as rendering, updating, etc. go
+		if(!m_Paused) //If application is not paused
 		{
-			if(!m_Paused) //If application is not paused
+			if(frameDue)
 			{
-				if(!IsDeviceLost())
+				//Calculate FPS, Update and Render
+				int64_t frameStart = TimerTicks();
+				FrameSample sample;
 				{
-					//Cache current time in counts
-					__int64 curTime = 0;
-					QueryPerformanceCounter((LARGE_INTEGER*)&curTime);
-					float dt = (curTime - prevTime) * secPerCount; //Calculate delta time
-					//Calculate FPS
-					CalculateFPS(dt);
-					//Update
-					Update(dt); //pass in 0 for now until later tutorial
-					//Render
-					Render();
-
-					prevTime = curTime;
+					PROFILE_ZONE("Frame");
+					RunFrame(dt, NextUpdate(dt), sample);
 				}
+				CheckSpike(TimerTicks() - frameStart);
 			}
-			else
-			{
-				Sleep(100); //Free up cpu for 1/10 of a second
-			}
+		}
+		else
+		{
+			//Free up the cpu until an event (e.g. reactivation) arrives
+			WaitForEvents(100);
+			m_Pacer.Resync();
+			m_Timestep.Resync();
 		}
 	}
 
+	m_Pipeline.Stop();
+	if(!FinishReadback())
+		PlatformShowError("Failed to export rendered frames");
+
 	//Now when the application finally finishes, we need to return
-	//the error code given from our application
-	return static_cast<int>(msg.wParam); //The error code is stored in the wParam member of our msg struct
+	//the error code given to Quit()
+	return m_ExitCode;
+}
+
+int DXApp::RunBenchmark(unsigned frames, float fixedDt, const std::string& outputPath)
+{
+	//Every frame runs Update/Render with the same dt so runs are repeatable.
+	//The ring buffer is allocated up front so recording does not disturb the timings.
+	m_Benchmark.Init(frames, fixedDt);
+	//Unpaced unless a frame rate was set explicitly, pacing waits are not part of the frame time
+	m_Pacer.SetTarget(m_TargetFps > 0.0 ? m_TargetFps : 0.0, m_PacingMode);
+	m_Pacer.Start();
+	m_Timestep.Start();
+	m_pStateCache->ResetCounters();
+	StartPipeline();
+	//A fixed timestep advances by fixedDt of simulated time per frame, not by real time
+	int64_t frameTicks = (int64_t)(fixedDt * (double)TimerFrequency() + 0.5);
+
+	unsigned frame = 0;
+	unsigned nextLoss = m_DeviceLossInterval;
+	while(frame < frames && !m_Quit)
+	{
+		//Same zones as Run(), so benchmark traces have the same hierarchy
+		PROFILE_ZONE("Run");
+		{
+			PROFILE_ZONE("Pacing");
+			m_Pacer.WaitForFrame();
+		}
+		int64_t frameStart = TimerTicks();
+		PROFILE_ZONE("Frame");
+
+		if(m_pNullDevice && nextLoss > 0 && frame == nextLoss)
+		{
+			m_pNullDevice->SimulateDeviceLoss();
+			nextLoss += m_DeviceLossInterval;
+		}
+
+		//Keep the window responsive while benchmarking
+		m_pWindow->PumpEvents();
+		ProcessEvents();
+		if(m_Quit || IsDeviceLost())
+			continue;
+
+		//Nothing is rendered while the pipeline fills, those iterations are not frames
+		FrameSample sample;
+		FrameUpdate update = { fixedDt, 1, 1.0f };
+		if(m_Timestep.IsEnabled())
+		{
+			update.Dt = (float)m_Timestep.GetStepTime();
+			update.Steps = m_Timestep.AdvanceBy(frameTicks);
+			update.Alpha = m_Timestep.GetAlpha();
+		}
+		if(!RunFrame(fixedDt, update, sample))
+			continue;
+		sample.FrameTicks = TimerTicks() - frameStart;
+		m_Benchmark.Record(sample);
+		++frame;
+		CheckSpike(sample.FrameTicks);
+	}
+	m_Pipeline.Stop();
+	//Export rate includes writing the last frames
+	bool exported = FinishReadback();
+
+	//Write the results
+	StreamStats streamStats = m_Streamer.GetStats();
+	m_Benchmark.SetStartupMs(m_StartupMs);
+	m_Benchmark.SetStreamed(streamStats.BytesRead, streamStats.ReadMBps);
+	const ResourceStats& resourceStats = m_pResources->GetStats();
+	m_Benchmark.SetDeviceResets(resourceStats.Recoveries, resourceStats.MaxRecoveryMs);
+	m_Benchmark.SetPacing(m_Pacer.GetStats());
+	m_Benchmark.SetTimestep(m_Timestep.GetStats());
+	ReadbackStats readbackStats = m_Readback.GetStats();
+	m_Benchmark.SetReadback(readbackStats.Exported, readbackStats.ExportFps);
+	ShaderCacheStats shaderStats = m_Shaders.GetStats();
+	m_Benchmark.SetShaders(shaderStats.Hits, shaderStats.Compiled, shaderStats.AllReadyMs);
+	m_Benchmark.SetInput(m_InputEventCount, m_Events.GetDropped() + m_SimulatedEvents.GetDropped() + m_InputEvents.GetDropped());
+	const StateCacheCounters& stateCounters = m_pStateCache->GetCounters();
+	m_Benchmark.SetStateCalls(stateCounters.TotalCalls(), stateCounters.TotalFiltered());
+	bool written = m_Benchmark.WriteJSON(outputPath + ".json");
+	written = m_Benchmark.WriteCSV(outputPath + ".csv") && written;
+	//The zones of the last frames, unless a spike trace is what was asked for
+	if(!m_TracePath.empty() && m_TraceSpikeMs <= 0.0)
+		written = WriteTrace() && written;
+	if(!written || !exported)
+		return 1;
+
+	return 0;
+}
+
+void DXApp::StartPipeline()
+{
+	if(m_FramesInFlight > 0 && !m_Pipeline.IsRunning())
+		m_Pipeline.Start(m_FramesInFlight, PipelineUpdate, this);
+}
+
+FrameUpdate DXApp::NextUpdate(float dt)
+{
+	FrameUpdate update = { dt, 1, 1.0f };
+	if(m_Timestep.IsEnabled())
+	{
+		//Steps for the real time since the last frame, not the smoothed dt
+		update.Dt = (float)m_Timestep.GetStepTime();
+		update.Steps = m_Timestep.Advance();
+		update.Alpha = m_Timestep.GetAlpha();
+	}
+	return update;
+}
+
+bool DXApp::RunFrame(float dt, const FrameUpdate& update, FrameSample& sample)
+{
+	uint64_t heapStart = GetHeapCounters().Allocations;
+	sample.UpdateTicks = 0;
+	sample.CullTicks = 0;
+	sample.UploadTicks = 0;
+	sample.RenderTicks = 0;
+	sample.ReadbackTicks = 0;
+	sample.FrameTicks = 0;
+	sample.InputLatencyTicks = 0;
+	sample.ArenaBytes = 0;
+
+	CalculateFPS(dt);
+
+	if(m_Pipeline.IsRunning())
+	{
+		//Queue the update of this frame, then render the oldest finished snapshot.
+		//With one frame in flight the worker updates frame N while we render N - 1.
+		m_Pipeline.Kick(update);
+
+		unsigned slot = 0;
+		bool acquired = false;
+		{
+			PROFILE_ZONE("Wait for update");
+			acquired = m_Pipeline.Acquire(&slot, &sample.UpdateTicks);
+		}
+		if(!acquired)
+		{
+			sample.HeapAllocations = (unsigned)(GetHeapCounters().Allocations - heapStart);
+			return false;
+		}
+
+		int64_t uploadStart = TimerTicks();
+		{
+			PROFILE_ZONE("Upload");
+			m_Streamer.Pump(m_pRenderDevice, m_UploadBudget);
+			m_Shaders.Update();
+		}
+		int64_t renderStart = TimerTicks();
+		m_RenderSnapshot = slot;
+		{
+			PROFILE_ZONE("Render");
+			Render();
+		}
+		sample.UploadTicks = renderStart - uploadStart;
+		sample.RenderTicks = TimerTicks() - renderStart;
+		//Input sampled when the worker started this snapshot, a frame or two ago
+		sample.InputLatencyTicks = MeasureInputLatency(slot);
+		sample.ArenaBytes = m_SnapshotArenaBytes[slot];
+		//The worker's update time includes its cull
+		sample.CullTicks = m_SnapshotCullTicks[slot];
+		sample.UpdateTicks -= sample.CullTicks;
+
+		m_Pipeline.Release();
+	}
+	else
+	{
+		//Recycle the per frame memory of two frames ago
+		m_FrameArena.BeginFrame();
+
+		int64_t updateStart = TimerTicks();
+		//Update, with the input that arrived up to now
+		{
+			PROFILE_ZONE("Update");
+			RunUpdates(0, update);
+		}
+		int64_t cullStart = TimerTicks();
+		//Cull
+		{
+			PROFILE_ZONE("Cull");
+			Cull();
+		}
+		int64_t uploadStart = TimerTicks();
+		//Upload streamed assets within the frame budget
+		{
+			PROFILE_ZONE("Upload");
+			m_Streamer.Pump(m_pRenderDevice, m_UploadBudget);
+			m_Shaders.Update();
+		}
+		int64_t renderStart = TimerTicks();
+		//Render
+		{
+			PROFILE_ZONE("Render");
+			Render();
+		}
+		sample.UpdateTicks = cullStart - updateStart;
+		sample.CullTicks = uploadStart - cullStart;
+		sample.UploadTicks = renderStart - uploadStart;
+		sample.RenderTicks = TimerTicks() - renderStart;
+		sample.InputLatencyTicks = MeasureInputLatency(0);
+		sample.ArenaBytes = (unsigned)m_FrameArena.GetUsed();
+	}
+
+	//Copy the frame for export, and export an earlier one whose copy is done
+	if(m_Readback.IsActive())
+	{
+		PROFILE_ZONE("Readback");
+		int64_t readbackStart = TimerTicks();
+		m_Readback.Capture();
+		sample.ReadbackTicks = TimerTicks() - readbackStart;
+	}
+
+	if(m_StartupMs == 0.0)
+		m_StartupMs = TicksToMs(TimerTicks() - m_StartTicks);
+
+	//Heap allocations from every thread, including the update worker and jobs
+	sample.HeapAllocations = (unsigned)(GetHeapCounters().Allocations - heapStart);
+	return true;
+}
+
+void DXApp::PipelineUpdate(void* pContext, unsigned slot, const FrameUpdate& update)
+{
+	DXApp* pApp = (DXApp*)pContext;
+
+	//One arena buffer per snapshot, so this never recycles memory Render still reads
+	pApp->m_FrameArena.BeginFrame(slot);
+	pApp->m_UpdateSnapshot = slot;
+	{
+		PROFILE_ZONE("Update");
+		pApp->RunUpdates(slot, update);
+	}
+	int64_t cullStart = TimerTicks();
+	{
+		PROFILE_ZONE("Cull");
+		pApp->Cull();
+	}
+	pApp->m_SnapshotCullTicks[slot] = TimerTicks() - cullStart;
+	pApp->m_SnapshotArenaBytes[slot] = (unsigned)pApp->m_FrameArena.GetUsed();
+}
+
+void DXApp::RunUpdates(unsigned slot, const FrameUpdate& update)
+{
+	//Every step sees the input that arrived before it, so presses are seen once.
+	//Latency is measured from the oldest event of the frame.
+	int64_t oldestEvent = 0;
+	for(unsigned step = 0; step < update.Steps; ++step)
+	{
+		SampleInput(slot);
+		if(oldestEvent == 0)
+			oldestEvent = m_InputSnapshots[slot].OldestEventTicks;
+		Update(update.Dt);
+	}
+	//A frame without steps still gets current held keys and cursor position, the
+	//edges stay pending for the next step. No Update sees its events, so it
+	//reports no latency.
+	if(update.Steps == 0)
+	{
+		m_Input.Drain(&m_InputEvents);
+		m_Input.PeekSnapshot(TimerTicks(), &m_InputSnapshots[slot]);
+	}
+	m_InputSnapshots[slot].OldestEventTicks = oldestEvent;
+	m_Interpolation[slot] = update.Alpha;
+}
+
+void DXApp::SampleInput(unsigned slot)
+{
+	//The events ProcessEvents forwarded up to this moment, so a pipelined Update
+	//on the worker also sees the ones pumped after its frame was queued
+	m_Input.Drain(&m_InputEvents);
+	m_Input.TakeSnapshot(TimerTicks(), &m_InputSnapshots[slot]);
+}
+
+int64_t DXApp::MeasureInputLatency(unsigned slot) const
+{
+	int64_t oldest = m_InputSnapshots[slot].OldestEventTicks;
+	return oldest != 0 ? TimerTicks() - oldest : 0;
+}
+
+void DXApp::SimulateInput()
+{
+	PROFILE_THREAD("Input");
+
+	//The cursor circles the client area, one move every period, like a
+	//thread reading a high rate mouse
+	int64_t period = TimerFrequency() / m_InputRate;
+	int64_t next = TimerTicks();
+	unsigned step = 0;
+	while(!m_StopInput)
+	{
+		int64_t now = TimerTicks();
+		if(now < next)
+		{
+			PlatformSleep(1);
+			continue;
+		}
+		float angle = (float)(step++ % 360) * 0.0174533f;
+		int x = (int)(m_ClientWidth * (0.5f + 0.25f * cosf(angle)));
+		int y = (int)(m_ClientHeight * (0.5f + 0.25f * sinf(angle)));
+		PushPlatformEvent(&m_SimulatedEvents, PE_MOUSE_MOVE, 0, x, y);
+		//Catch up after oversleeping, without a burst of stale moves
+		next = next + period > now ? next + period : now + period;
+	}
+}
+
+bool DXApp::OpenArchive(const char* pPath, unsigned ioThreads)
+{
+	m_Streamer.Shutdown();
+	return m_Archive.Open(pPath) && m_Streamer.Init(&m_Archive, ioThreads);
 }
 
 bool DXApp::Init()
 {
+	PROFILE_THREAD_NAME("Main");
+	PROFILE_ZONE("Init");
+
+	//One job thread per core, the calling (main) thread is thread 0
+	m_Jobs.Init();
+
+	//Double buffered per frame memory, or one buffer per snapshot when pipelined
+	unsigned arenaFrames = m_FramesInFlight > 0 ? m_FramesInFlight + 1 : 2;
+	if(!m_FrameArena.Init(m_FrameArenaSize, arenaFrames))
+	{
+		PlatformShowError("Failed to allocate frame memory");
+		return false;
+	}
+
+#ifndef _WIN32
+	//Without Direct3D offscreen frames come from the headless software (or null) device
+	if(m_Offscreen)
+		m_Headless = true;
+#endif
+
 	//Initialize main window
 	if(!InitMainWindow())
 		return false;
-	if(!InitDirect3D())
+	if(m_InputRate > 0)
+		m_InputThread = std::thread(&DXApp::SimulateInput, this);
+
+	//Headless applications have no window and render in software (or not at all)
+	if(m_Headless)
+	{
+		if(!InitHeadlessDevice())
+			return false;
+	}
+	else
+	{
+#ifdef _WIN32
+		if(!InitDirect3D())
+			return false;
+#else
+		//No Direct3D, the software device renders into the window
+		if(!InitSoftwareDevice())
+			return false;
+#endif
+	}
+
+	//Every buffer goes through the registry so a reset can restore it
+	m_pResources = new ResourceRegistryDevice(m_pRenderDevice, &m_Jobs);
+	m_pRenderDevice = m_pResources;
+
+	//Drop redundant state changes before they reach the backend
+	m_pStateCache = new StateCacheDevice(m_pRenderDevice);
+	m_pRenderDevice = m_pStateCache;
+
+	//Shaders compile in the background, a missing or stale cache file only costs time
+	m_Shaders.Init(m_pRenderDevice, m_ShaderCachePath.empty() ? NULL : m_ShaderCachePath.c_str(),
+		GetPlatformShaderCompiler(), NULL, GetPlatformShaderCompilerVersion());
+
+	//Ring of readback surfaces for exporting frames
+	if(m_pFrameSink && !m_Readback.Init(m_pRenderDevice, m_pFrameSink, m_ReadbackRing))
+	{
+		PlatformShowError("Failed to create readback surfaces");
 		return false;
+	}
 
 	//If all succeeds return true
 	return true;
@@ -131,63 +557,21 @@ bool DXApp::Init()
 
 bool DXApp::InitMainWindow()
 {
-	//First step:
-	//Create a window class structure to define our window
-	WNDCLASSEX wcex;
-	ZeroMemory(&wcex, sizeof(WNDCLASSEX)); //ZERO it out
-	wcex.cbClsExtra = 0; //no extra bytes
-	wcex.cbWndExtra = 0; //no extra bytes
-	wcex.cbSize = sizeof(WNDCLASSEX); //set size in bytes
-	wcex.style = CS_HREDRAW | CS_VREDRAW; //Basically states that window should be redraw both HORIZ. and VERT.
-	wcex.hInstance = m_hAppInstance; //Set handle to application instance;
-	wcex.lpfnWndProc = MainWndProc; //Set message procedure to our globally defined one
-	wcex.hIcon = LoadIcon(NULL, IDI_APPLICATION); //Set window icon (standard application icon)
-	wcex.hCursor = LoadCursor(NULL, IDC_ARROW); //Set window arrow (standard windows arrow)
-	wcex.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH); //Set clear background
-	wcex.lpszClassName = "WIN32WINDOWCLASS"; //Name it w.e you like. 
-	wcex.lpszMenuName = NULL; //We are not using a menu at this time.
-	wcex.hIconSm = LoadIcon(NULL, IDI_APPLICATION); //Set small window icon (standard application icon)
-
-	//Now we must register the window class
-	//Here is an example of some simple error checking
-	//This can be quite useful for larger projects to debug errors
-	if(!RegisterClassEx(&wcex))
-	{
-		MessageBox(NULL, "Failed to register window class", NULL, NULL);
-		return false;
-	}
-
-	//Second step:
-	//Cache the correct window dimensions
-	RECT r = { 0, 0, m_ClientWidth, m_ClientHeight };
-	AdjustWindowRect(&r, m_WindowStyle, false); //Use our window style
-	int width = r.right - r.left;  //correct width based on requested client size
-	int height = r.bottom - r.top;  //correct height based on requested client size
-	int x = GetSystemMetrics(SM_CXSCREEN)/2 - width/2; //Centers window on desktop
-	int y = GetSystemMetrics(SM_CYSCREEN)/2 - height/2; //Centers window on desktop
-
-	//Third step:
-	//Create our window
-	//lpClassName: MUST BE SAME AS ABOVE FROM WINDOW CLASS
-	//lpWindowTitle: SHOULD BE m_AppTitle.c_str()
-	m_hAppWindow = CreateWindow("WIN32WINDOWCLASS", m_AppTitle.c_str(), m_WindowStyle, x, y,
-		width, height, NULL, NULL, m_hAppInstance, NULL);
-	//Check window creation
-	if(!m_hAppWindow)
+	//The window (Win32 or X11, or a stand-in without a surface when headless)
+	//pushes its events to m_Events from now on
+	m_pWindow = CreatePlatformWindow(m_Headless);
+	if(!m_pWindow)
 	{
-		MessageBox(NULL, "Failed to create window", NULL, NULL);
+		PlatformShowError("No window system in this build, run with -headless");
 		return false;
 	}
 
-	//Fourth step:
-	//Show window
-	//SW_SHOW: Stand window display code, take the place of nCmdShow from entry point.
-	ShowWindow(m_hAppWindow, SW_SHOW); 
-
-	//If all succeeded return true
-	return true;
+	//The window reports its own errors. Offscreen windows stay hidden, they
+	//only host the device.
+	return m_pWindow->Create(m_AppTitle.c_str(), m_ClientWidth, m_ClientHeight, &m_Events, !m_Offscreen);
 }
 
+#ifdef _WIN32
 bool DXApp::InitDirect3D()
 {
 	//There are a few steps to successfully intializing a Direct3D device object
@@ -197,7 +581,7 @@ bool DXApp::InitDirect3D()
 	m_pDirect3D = Direct3DCreate9(D3D_SDK_VERSION);
 	if(!m_pDirect3D)
 	{
-		MessageBox(NULL, "Failed to create Direct3D interface object", NULL, NULL);
+		PlatformShowError("Failed to create Direct3D interface object");
 		return false;
 	}
 
@@ -217,8 +601,8 @@ bool DXApp::InitDirect3D()
 	//Step 3:
 	//We must check to see if our graphics device supports hardware accelerated
 	//vertex processing. Another term for this is HARDWARE TRANSFORM AND LIGHTING.
-	//I'm going to assume virtually everyone following these tutorials has a device capable
-	//of HWTRANSLIGHT
+	//Devices without HWTRANSLIGHT fall back to our own software rasterizer, which is
+	//much faster than D3DCREATE_SOFTWARE_VERTEXPROCESSING.
 	int vp = 0;
 	D3DCAPS9 devCaps;
 	//Cache device caps
@@ -227,7 +611,7 @@ bool DXApp::InitDirect3D()
 		//Our device supports transformations in hardware
 		vp = D3DCREATE_HARDWARE_VERTEXPROCESSING;
 	else
-		vp = D3DCREATE_SOFTWARE_VERTEXPROCESSING;
+		return InitSoftwareDevice();
 
 	//Step 4:
 	//We must initialize our present parameters structure
@@ -241,8 +625,9 @@ bool DXApp::InitDirect3D()
 	m_d3dpp.BackBufferCount = 1; //Double buffered. 
 	m_d3dpp.MultiSampleType = D3DMULTISAMPLE_NONE; //No multisampling (way too intensive)
 	m_d3dpp.MultiSampleQuality = 0;
-	m_d3dpp.SwapEffect = D3DSWAPEFFECT_DISCARD;
-	m_d3dpp.hDeviceWindow = m_hAppWindow;
+	//Frames are read back after Render() presented them, so keep the back buffer when exporting
+	m_d3dpp.SwapEffect = m_pFrameSink ? D3DSWAPEFFECT_COPY : D3DSWAPEFFECT_DISCARD;
+	m_d3dpp.hDeviceWindow = (HWND)m_pWindow->GetNativeHandle();
 	m_d3dpp.Flags = 0;
 	m_d3dpp.EnableAutoDepthStencil =  true;
 	m_d3dpp.AutoDepthStencilFormat = D3DFMT_D24S8;
@@ -252,10 +637,18 @@ bool DXApp::InitDirect3D()
 	//Step 5:
 	//Create our device
 	HR(m_pDirect3D->CreateDevice(D3DADAPTER_DEFAULT,
-		m_DevType, m_hAppWindow, vp, &m_d3dpp, &m_pDevice3D));
+		m_DevType, m_d3dpp.hDeviceWindow, vp, &m_d3dpp, &m_pDevice3D));
+	if(!m_pDevice3D)
+	{
+		PlatformShowError("Failed to create Direct3D device");
+		return false;
+	}
+
+	//Wrap the device so the application renders through IRenderDevice
+	m_pRenderDevice = new D3D9RenderDevice(m_pDevice3D, m_d3dpp);
 
-	D3DVIEWPORT9 viewport;
-	ZeroMemory(&viewport, sizeof(D3DVIEWPORT9));
+	RDViewport viewport;
+	ZeroMemory(&viewport, sizeof(RDViewport));
 	viewport.X = 0;
 	viewport.Y = 0;
 	viewport.Width = m_ClientWidth;
@@ -263,42 +656,64 @@ bool DXApp::InitDirect3D()
 	viewport.MinZ = 0;
 	viewport.MaxZ = 1;
 
-	m_pDevice3D->SetViewport(&viewport);
+	m_pRenderDevice->SetViewport(viewport);
 
 	//If this all succeeds return true
 	return true;
 }
+#endif
+
+bool DXApp::InitSoftwareDevice()
+{
+	//The software device renders into system memory. Present() copies the back
+	//buffer into the window, the headless window drops it.
+	SoftwareRenderDevice* pDevice = new SoftwareRenderDevice(m_ClientWidth, m_ClientHeight);
+	pDevice->SetPresentCallback(PresentSoftwareBackBuffer, m_pWindow);
+	m_pRenderDevice = pDevice;
+
+	return true;
+}
+
+bool DXApp::InitHeadlessDevice()
+{
+	//The null device skips rasterization entirely, which isolates the CPU cost
+	//of the application from the cost of the software rasterizer
+	if(m_HeadlessDevice == RD_DEVICE_NULL)
+	{
+		m_pNullDevice = new NullRenderDevice(m_ClientWidth, m_ClientHeight);
+		m_pRenderDevice = m_pNullDevice;
+		return true;
+	}
+
+	return InitSoftwareDevice();
+}
 
 bool DXApp::IsDeviceLost()
 {
+	PROFILE_ZONE("IsDeviceLost");
+
 	//Cache the state of the device
-	HRESULT hr = m_pDevice3D->TestCooperativeLevel();
-	if(hr == D3DERR_DEVICELOST) //If it is lost
+	RDDeviceState state = m_pRenderDevice->TestCooperativeLevel();
+	if(state == RD_DEVICE_LOST) //If it is lost
 	{
-		//Sleep cpu for 1/10 of a second
-		Sleep(100);
+		//Free up the cpu for up to 1/10 of a second, the device comes back
+		//when the application is activated again
+		WaitForEvents(100);
+		m_Pacer.Resync();
+		m_Timestep.Resync();
 		return true;
 	}
-	else if(hr == D3DERR_DRIVERINTERNALERROR) //Fatal error occured
+	else if(state == RD_DEVICE_DRIVERERROR) //Fatal error occured
 	{
 		//Display message box
-		MessageBox(NULL, "FATAL INTERNAL ERROR DETECTED.\n APPLICATION QUITTING", NULL, NULL);
-		PostQuitMessage(0); //Quit application
+		PlatformShowError("FATAL INTERNAL ERROR DETECTED.\n APPLICATION QUITTING");
+		Quit(); //Quit application
 		return true;
 	}
-	else if(hr == D3DERR_DEVICENOTRESET) //Device available for reset
+	else if(state == RD_DEVICE_NOTRESET) //Device available for reset
 	{
-		//Destroy graphics
-		OnLostDevice();
-
-		//Reset the device
-		HR(m_pDevice3D->Reset(&m_d3dpp));
-
-		//Reset graphics
-		OnResetDevice();
-
-		//Device no longer lost
-		return false;
+		//Device no longer lost, unless the reset failed (try again next frame)
+		return !ResetDevice();
 	}
 	else
 		return false;
@@ -319,9 +734,14 @@ void DXApp::CalculateFPS(float dt)
 	{
 		m_FPS = (float)frameCnt;
 
-		std::stringstream ss;
-		ss << m_AppTitle.c_str() << "  FPS: " << m_FPS;
-		SetWindowText(m_hAppWindow, ss.str().c_str());
+		//Format on the stack, this runs inside the frame loop and must not allocate
+		char title[256];
+#ifdef _WIN32
+		sprintf_s(title, "%s  FPS: %g", m_AppTitle.c_str(), m_FPS);
+#else
+		snprintf(title, sizeof(title), "%s  FPS: %g", m_AppTitle.c_str(), m_FPS);
+#endif
+		m_pWindow->SetTitle(title);
 
 		//Reset counters
 		frameCnt = 0;
@@ -330,98 +750,122 @@ void DXApp::CalculateFPS(float dt)
 }
 
 //Enables fullscreen mode
-//This entails resetting the window style, window position,
-//and redefining the present parameters back buffer.
+//This entails resizing the window to cover the screen (the platform
+//window does that) and redefining the present parameters back buffer.
 void DXApp::EnableFullscreen(bool enable)
 {
-	if(enable)
-	{
-		//Cache desktop width and height
-		int width = GetSystemMetrics(SM_CXSCREEN);
-		int height = GetSystemMetrics(SM_CYSCREEN);
-
-		m_d3dpp.BackBufferWidth = width;
-		m_d3dpp.BackBufferHeight = height;
-		m_d3dpp.BackBufferFormat = D3DFMT_X8R8G8B8;
-		m_d3dpp.Windowed = false;
-		
-		//Set window style to fullscreen friendly
-		SetWindowLongPtr(m_hAppWindow, GWL_STYLE, WS_POPUP);
-
-		//Need to set new position for window
-		SetWindowPos(m_hAppWindow, HWND_TOP, 0, 0, width, height, SWP_NOZORDER | SWP_SHOWWINDOW);
-	}
-	else
-	{
-		//Set window back to windowed mode
-		RECT r = { 0, 0, m_ClientWidth, m_ClientHeight };
-		AdjustWindowRect(&r, m_WindowStyle, false);
-		int w = r.right - r.left;
-		int h = r.bottom - r.top;
-		m_d3dpp.BackBufferFormat = D3DFMT_UNKNOWN;
-		m_d3dpp.BackBufferWidth = m_ClientWidth;
-		m_d3dpp.BackBufferHeight = m_ClientHeight;
-		m_d3dpp.Windowed = true;
-
-		//Change window style back to windowed friendly
-		SetWindowLongPtr(m_hAppWindow, GWL_STYLE, m_WindowStyle);
-
-		//Set window position
-		SetWindowPos(m_hAppWindow, HWND_TOP,
-			GetSystemMetrics(SM_CXSCREEN)/2 - w/2,
-			GetSystemMetrics(SM_CYSCREEN)/2 - h/2,
-			w, h, SWP_NOZORDER | SWP_SHOWWINDOW);
-	}
+	unsigned width = 0;
+	unsigned height = 0;
+	if(!m_pWindow->SetFullscreen(enable, &width, &height))
+		return;
+
+	m_PresentParams.BackBufferWidth = width;
+	m_PresentParams.BackBufferHeight = height;
+	m_PresentParams.Windowed = !enable;
 
 	//Reset our device to reflect the changes
+	ResetDevice();
+}
+
+bool DXApp::WriteTrace()
+{
+	m_LastTraceTicks = TimerTicks();
+	return ProfilerWriteTrace(m_TracePath.c_str());
+}
+
+bool DXApp::FinishReadback()
+{
+	PROFILE_ZONE("Finish readback");
+	return m_Readback.Finish();
+}
+
+void DXApp::CheckSpike(int64_t frameTicks)
+{
+	if(m_TraceSpikeMs <= 0.0 || TicksToMs(frameTicks) < m_TraceSpikeMs)
+		return;
+
+	//The rings still hold the spike and the frames before it. Writing takes a
+	//while, so spikes within a few seconds of the last trace are not traced.
+	if(m_LastTraceTicks == 0 || TicksToMs(TimerTicks() - m_LastTraceTicks) > SPIKE_TRACE_INTERVAL_MS)
+		WriteTrace();
+}
+
+bool DXApp::ResetDevice()
+{
+	PROFILE_ZONE("ResetDevice");
+
+	//Snapshots may reference resources that are about to be destroyed,
+	//so let the update worker finish and drop what was not rendered
+	m_Pipeline.Flush();
+
+	//Destroy graphics the registry does not restore by itself (dynamic buffers
+	//and the readback ring, whose frames in flight are exported first)
+	m_Readback.OnLostDevice();
 	OnLostDevice();
-	HR(m_pDevice3D->Reset(&m_d3dpp));
+
+	//Reset the device, the registry re-creates default pool buffers and states
+	if(!m_pRenderDevice->Reset(m_PresentParams))
+		return false;
+
+	//Reset graphics
 	OnResetDevice();
+	if(!m_Readback.OnResetDevice())
+		PlatformShowError("Failed to create readback surfaces, frames are no longer exported");
+	return true;
 }
 
-//Message procedure function.
-//Windows OS runs of a message based system where all application
-//that run on the OS send and receive messages that tell it what to do. To receive
-//these messages our application needs what is called a message procedure function.
-//Using this function we can "catch" these messages and tell out application what to do.
-LRESULT DXApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+//Event handling.
+//Operating systems deliver input and window changes as messages. The platform
+//window translates the ones we care about into PlatformEvents on m_Events;
+//here we "catch" the ones the framework handles itself and hand all of
+//them to the application in one batch.
+void DXApp::ProcessEvents()
 {
-	//Switch statement on the message passed to us
-	switch(msg)
+	//Window events first, then simulated input. Input also goes on to the thread
+	//running Update. What does not fit into m_FrameEvents waits for the next frame.
+	unsigned count = 0;
+	PlatformEvent e;
+	while(count < EventQueue::CAPACITY && (m_Events.Pop(&e) || m_SimulatedEvents.Pop(&e)))
 	{
-		//CASE: WM_DESTROY, our application is told to destroy itself
-	case WM_DESTROY:
-		PostQuitMessage(0); //Tell the application to quit
-		return 0;
-
-		//CASE: WM_ACTIVATE, our application is the active window
-	case WM_ACTIVATE:
-		//CHECK IF LOW ORDER BIT = INACTIVE
-		if(LOWORD(wParam) == WA_INACTIVE)
+		m_FrameEvents[count++] = e;
+		if(InputTracker::IsInputEvent(e.Type) && m_InputEvents.Push(e))
+			++m_InputEventCount;
+
+		//Switch statement on the event type
+		switch(e.Type)
+		{
+			//CASE: PE_QUIT, our application is told to destroy itself
+		case PE_QUIT:
+			Quit();
+			break;
+
+			//CASE: the application is (no longer) the active window
+		case PE_ACTIVATE:
+			m_Paused = false;
+			break;
+		case PE_DEACTIVATE:
 			//Application should pause itself
 			m_Paused = true;
-		else //Otherwise, the application is not paused
-			m_Paused = false;
-		return 0;
+			break;
 
-		//CASE: WM_KEYDOWN, user pressed a key on keyboard
-	case WM_KEYDOWN:
-		//Switch on the WPARAM, (which stores the keycode)
-		switch(wParam)
-		{
-			//CASE: VK_ESCAPE, user pressed the escape key
-		case VK_ESCAPE:
-			PostQuitMessage(0);
-			return 0;
-
-		case VK_F1:
-			m_EnableFullscreen = !m_EnableFullscreen;
-			EnableFullscreen(m_EnableFullscreen);
-			return 0;
+			//CASE: PE_KEY_DOWN, user pressed a key on keyboard
+		case PE_KEY_DOWN:
+			if(e.Key == KEY_ESCAPE)
+				Quit();
+			else if(e.Key == KEY_F1 && !m_Headless && !m_Offscreen) //Fullscreen needs a visible window
+			{
+				m_EnableFullscreen = !m_EnableFullscreen;
+				EnableFullscreen(m_EnableFullscreen);
+			}
+			else if(e.Key == KEY_F2 && !m_TracePath.empty()) //Capture the last frames
+				WriteTrace();
+			break;
+
+		default:
+			break;
 		}
-		return 0;
 	}
 
-	//Always return the default window procedure if we don't catch anything
-	return DefWindowProc(hwnd, msg, wParam, lParam);
+	if(count > 0)
+		OnEvents(m_FrameEvents, count);
 }
@@ -8,6 +8,25 @@
 #pragma once //TAKES PLACE OF (#ifndef guards)
 
 #include "d3dUtil.h"
+#include "RenderDevice.h"
+#include "FrameBenchmark.h"
+#include "FramePipeline.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "AssetStreamer.h"
+#include "FramePacer.h"
+#include "FixedTimestep.h"
+#include "FrameReadback.h"
+#include "ShaderCache.h"
+#include "InputState.h"
+#include "Platform.h"
+
+#include <atomic>
+#include <thread>
+
+class StateCacheDevice;
+class ResourceRegistryDevice;
+class NullRenderDevice;
 
 //Abstract application class
 class DXApp
@@ -20,48 +39,253 @@ public:
 
 	//Main application loop
 	int Run();
+	//Benchmark loop: runs a fixed number of frames with a fixed dt and writes
+	//frame time statistics to outputPath.json and outputPath.csv
+	int RunBenchmark(unsigned frames, float fixedDt, const std::string& outputPath);
 
 	//Framework methods
 	virtual bool Init();
 	virtual void Update(float dt) = 0; //pure virtual, aka MUST be overridden by inheriting class
+	//Visibility stage after Update on the same thread and snapshot (see Culler). With a
+	//fixed timestep Update runs zero or more times per frame and Cull once after them,
+	//so Cull builds everything Render needs, interpolated by GetInterpolation().
+	virtual void Cull() {}
 	virtual void Render() = 0; //pure virtual, aka MUST be overridden by inheriting class
-	virtual LRESULT MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam); //message procedure function
+	//Window and input events received since the last frame, after the framework
+	//handled its own (pause, quit on escape, fullscreen on F1). Called once per frame
+	//on the main thread; Update reads input through GetInput() instead.
+	virtual void OnEvents(const PlatformEvent* /*pEvents*/, unsigned /*count*/) {}
 
 	virtual void OnLostDevice() = 0;  //Handle lost graphics
 	virtual void OnResetDevice() = 0; //Handle reset graphics
 
+	//Leaves Run() (or RunBenchmark()) after the current frame, Run() returns exitCode
+	void Quit(int exitCode = 0)
+	{
+		m_Quit = true;
+		m_ExitCode = exitCode;
+	}
+
+	//Runs without a window on the software or null rendering device (must be called before Init)
+	void SetHeadless(bool headless, RDDeviceType deviceType = RD_DEVICE_SOFTWARE)
+	{
+		m_Headless = headless;
+		m_HeadlessDevice = deviceType;
+	}
+
+	//Pipelined frames (must be called before Init). With framesInFlight 1 or 2, Update
+	//runs on a worker thread and writes snapshot GetUpdateSnapshot() while Render
+	//submits snapshot GetRenderSnapshot() of an earlier frame. Update must not touch
+	//the rendering device or anything Render reads outside its snapshot. 0 disables.
+	void SetPipelined(unsigned framesInFlight) { m_FramesInFlight = framesInFlight; }
+
+	//Size of each per frame arena buffer (must be called before Init)
+	void SetFrameArenaSize(size_t bytes) { m_FrameArenaSize = bytes; }
+
+	//Maps an asset archive and starts streaming threads for it. Requested
+	//assets are uploaded before Render, at most SetUploadBudget() bytes per frame.
+	bool OpenArchive(const char* pPath, unsigned ioThreads = 2);
+	void SetUploadBudget(unsigned bytes) { m_UploadBudget = bytes; }
+
+	//Frame rate of Run() (must be called before Run). 0 runs unpaced, a negative
+	//rate follows the display refresh rate (default, unpaced when offscreen).
+	//RunBenchmark() is only paced with an explicit rate.
+	void SetFrameRate(double fps, PacingMode mode = PACING_LATENCY)
+	{
+		m_TargetFps = fps;
+		m_PacingMode = mode;
+	}
+
+	//Fixed simulation rate (must be called before Run). Update then always gets
+	//dt = 1 / rate and runs as often as real time requires, at most maxStepsPerFrame
+	//times per frame; RunBenchmark() advances by its fixed dt instead of real time,
+	//so runs are repeatable. 0 (default) runs one Update per frame with the frame's dt.
+	void SetFixedTimestep(unsigned rate, unsigned maxStepsPerFrame = 4) { m_Timestep.SetRate(rate, maxStepsPerFrame); }
+
+	//Chrome trace of the profiler zones (see Profiler.h). F2 writes it, and so does the
+	//end of RunBenchmark(). With spikeMs, frames slower than that write it instead,
+	//so the trace shows the spike and the frames before it.
+	void SetTraceOutput(const std::string& path, double spikeMs = 0.0)
+	{
+		m_TracePath = path;
+		m_TraceSpikeMs = spikeMs;
+	}
+
+	//Renders into a back buffer of any size without a visible window (must be
+	//called before Init). Windows uses Direct3D with a hidden window, other
+	//platforms render headless. Frames are exported through SetFrameSink().
+	void SetOffscreen(unsigned width, unsigned height)
+	{
+		m_Offscreen = true;
+		m_ClientWidth = width;
+		m_ClientHeight = height;
+		m_PresentParams.BackBufferWidth = width;
+		m_PresentParams.BackBufferHeight = height;
+	}
+
+	//Reads every rendered frame back and hands it to pSink (must be called before
+	//Init, the sink must outlive the application). Frames are locked ringSize - 1
+	//frames after they were rendered, see FrameReadback.
+	void SetFrameSink(IFrameSink* pSink, unsigned ringSize = 3)
+	{
+		m_pFrameSink = pSink;
+		m_ReadbackRing = ringSize;
+	}
+
+	//Benchmark runs on the null device lose the device every frames frames, to
+	//measure the recovery under load (see ResourceRegistryDevice). 0 disables.
+	void SetDeviceLossInterval(unsigned frames) { m_DeviceLossInterval = frames; }
+
+	//File of the shader cache (must be called before Init). Empty keeps the cache
+	//in memory only. Shaders compiled during the run are saved on exit.
+	void SetShaderCache(const std::string& path) { m_ShaderCachePath = path; }
+
+	//Pushes synthetic mouse moves at hz from a thread of their own (must be called
+	//before Init), so headless runs and benchmarks measure input latency. 0 disables.
+	void SetInputSimulation(unsigned hz) { m_InputRate = hz; }
+
 protected:
 	//Members
 
-	HWND			m_hAppWindow;				//HANDLE to application window
+	IPlatformWindow*	m_pWindow;			//Application window (Win32, X11 or headless)
+	EventQueue	m_Events;				//Events pushed by m_pWindow, drained every frame
+	PlatformEvent	m_FrameEvents[EventQueue::CAPACITY]; //Events handed to OnEvents()
+	EventQueue	m_InputEvents;			//Input events forwarded by ProcessEvents, popped by the thread running Update
+	InputTracker	m_Input;				//Folds m_InputEvents into snapshots, used by the thread running Update
+	InputState	m_InputSnapshots[FramePipeline::MAX_SLOTS];	//Input of each frame snapshot
+	unsigned		m_InputEventCount;		//Input events forwarded in total
+	EventQueue	m_SimulatedEvents;		//Pushed by m_InputThread
+	std::thread	m_InputThread;			//See SetInputSimulation
+	std::atomic<bool>	m_StopInput;
+	unsigned		m_InputRate;			//Simulated events per second, 0 for none
 	HINSTANCE	m_hAppInstance;			//HANDLE to application instance
 	UINT			m_ClientWidth;			//Requested client width
 	UINT			m_ClientHeight;			//Requested client height
 	std::string	m_AppTitle;				//Application title (window title bar)
-	DWORD		m_WindowStyle;			//Window style (e.g. WS_OVERLAPPEDWINDOW)
+	bool			m_Quit;					//Set by Quit() or a quit event
+	int				m_ExitCode;				//Returned by Run()
 	bool			m_Paused;				//True if application pause, false otherwise
 	bool			m_EnableFullscreen;		//True to enable fullscreen, false otherwise
 	float		m_FPS;					//Frames per second of our application
+	bool			m_Headless;				//True to run without a window
+	RDDeviceType	m_HeadlessDevice;		//Device used when headless (software or null)
+	FrameBenchmark	m_Benchmark;			//Frame time recorder for RunBenchmark()
+	FramePipeline	m_Pipeline;				//Update worker used when pipelined
+	unsigned		m_FramesInFlight;		//Updates allowed ahead of Render (0 = not pipelined)
+	unsigned		m_UpdateSnapshot;		//Snapshot slot written by the current Update
+	unsigned		m_RenderSnapshot;		//Snapshot slot read by the current Render
+	JobSystem		m_Jobs;					//Worker threads for Update/Render work (ParallelFor etc.)
+	FrameArena		m_FrameArena;			//Per frame scratch memory for Update, recycled every frame
+	size_t			m_FrameArenaSize;		//Bytes per arena buffer
+	unsigned		m_SnapshotArenaBytes[FramePipeline::MAX_SLOTS]; //Arena use of each pipelined snapshot
+	int64_t			m_SnapshotCullTicks[FramePipeline::MAX_SLOTS];	//Cull time of each pipelined snapshot
+	AssetArchive	m_Archive;				//Mapped asset archive (see OpenArchive)
+	AssetStreamer	m_Streamer;				//Streams assets of m_Archive
+	unsigned		m_UploadBudget;			//Asset upload bytes per frame
+	int64_t			m_StartTicks;			//Construction time
+	double			m_StartupMs;			//Construction to first rendered frame, 0 before that
+	FramePacer		m_Pacer;				//Frame scheduling and dt smoothing
+	FixedTimestep	m_Timestep;				//See SetFixedTimestep
+	float			m_Interpolation[FramePipeline::MAX_SLOTS];	//Alpha of each frame snapshot
+	double			m_TargetFps;			//See SetFrameRate
+	PacingMode		m_PacingMode;
+	std::string		m_TracePath;			//See SetTraceOutput, empty for none
+	double			m_TraceSpikeMs;			//Frame time that triggers a trace, 0 for none
+	int64_t			m_LastTraceTicks;		//When the last trace was written
+	bool			m_Offscreen;			//See SetOffscreen
+	IFrameSink*		m_pFrameSink;			//See SetFrameSink, NULL for none
+	unsigned		m_ReadbackRing;			//Readback surfaces in the ring
+	FrameReadback	m_Readback;				//Copies rendered frames to m_pFrameSink
+	ShaderCache		m_Shaders;				//Shaders and pipelines, compiled once and kept on disk
+	std::string		m_ShaderCachePath;		//See SetShaderCache
+
+	RDPresentParams	m_PresentParams;		//Back buffer size and mode for device resets
 
+#ifdef _WIN32
 	//DirectX members
 	IDirect3D9*				m_pDirect3D;			//Direct3D interface
 	IDirect3DDevice9*			m_pDevice3D;			//Direct3D device interface
 	D3DPRESENT_PARAMETERS		m_d3dpp;				//Direct3D present parameters struct
 	D3DDISPLAYMODE			m_Mode;				//Direct3D display mode struct
 	D3DDEVTYPE				m_DevType;			//Device Type (SHOULD BE DEVTYPE_HAL)
+#endif
+
+	//Rendering device, either wrapping m_pDevice3D or the software rasterizer.
+	//Applications should render through this instead of m_pDevice3D.
+	IRenderDevice*			m_pRenderDevice;
+	//State cache at the front of m_pRenderDevice (owns the backend), for its counters
+	StateCacheDevice*		m_pStateCache;
+	//Tracks the buffers behind the state cache and restores them on reset
+	ResourceRegistryDevice*	m_pResources;
+	//Backend when running on the null device, for simulated device loss
+	NullRenderDevice*		m_pNullDevice;
+	unsigned				m_DeviceLossInterval;	//Frames between simulated losses
 
 	
 protected:
 	//Methods
 
-	//Initializes main application window
+	//Initializes main application window (a headless one when headless)
 	bool InitMainWindow();
+#ifdef _WIN32
 	//Initialize direct3D
 	bool InitDirect3D();
+#endif
+	//Initialize the software rendering device
+	bool InitSoftwareDevice();
+	//Initialize the device used when running headless
+	bool InitHeadlessDevice();
 	//Handles lost device
 	bool IsDeviceLost();
+	//Releases and restores graphics around a device Reset()
+	bool ResetDevice();
+	//Handles the queued events and passes them on to OnEvents()
+	void ProcessEvents();
+	//Sleeps up to ms milliseconds, waking up early for window events
+	void WaitForEvents(unsigned ms) { m_pWindow->WaitForEvents(ms); }
+	//Writes the profiler trace to m_TracePath
+	bool WriteTrace();
+	//Writes a trace if a frame took longer than m_TraceSpikeMs
+	void CheckSpike(int64_t frameTicks);
+	//Exports the frames still read back at the end of a run, false if frames were lost
+	bool FinishReadback();
 	//Calculates FPS
 	void CalculateFPS(float dt);
 	//Enables fullscreen
 	void EnableFullscreen(bool enable);
+
+	//Snapshot slots, always 0 when not pipelined
+	unsigned GetSnapshotCount() const { return m_Pipeline.IsRunning() ? m_Pipeline.GetSlotCount() : 1; }
+	unsigned GetUpdateSnapshot() const { return m_UpdateSnapshot; }
+	unsigned GetRenderSnapshot() const { return m_RenderSnapshot; }
+
+	//Input of the running Update, sampled right before it started. Render may read
+	//m_InputSnapshots[GetRenderSnapshot()], the input its snapshot was built from.
+	const InputState& GetInput() const { return m_InputSnapshots[m_UpdateSnapshot]; }
+	//Share of the next fixed step that passed when the snapshot was built, for Cull to
+	//interpolate between the last two Update states (always 1 without a fixed timestep).
+	//Render may read m_Interpolation[GetRenderSnapshot()].
+	float GetInterpolation() const { return m_Interpolation[m_UpdateSnapshot]; }
+
+private:
+	enum { SPIKE_TRACE_INTERVAL_MS = 5000 };
+
+	//Starts the update worker if pipelining was requested
+	void StartPipeline();
+	//Simulation of the frame starting now: one step of the frame's dt, or the
+	//steps the fixed timestep has due
+	FrameUpdate NextUpdate(float dt);
+	//Runs Update/Render (or queues the next update and renders the oldest finished
+	//snapshot when pipelined) and fills sample. False if nothing was rendered.
+	bool RunFrame(float dt, const FrameUpdate& update, FrameSample& sample);
+	//Samples input and runs the Update steps of update for snapshot slot
+	void RunUpdates(unsigned slot, const FrameUpdate& update);
+	//Worker thread entry for a pipelined Update
+	static void PipelineUpdate(void* pContext, unsigned slot, const FrameUpdate& update);
+	//Takes the input snapshot of slot, on the thread about to run its Update
+	void SampleInput(unsigned slot);
+	//Oldest input event of slot to now (Present has returned), 0 if it had no input
+	int64_t MeasureInputLatency(unsigned slot) const;
+	//Entry of m_InputThread
+	void SimulateInput();
 };
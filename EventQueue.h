@@ -0,0 +1,127 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Platform events and the ring buffer that carries them from the
+				window system to the application. Windows push events while
+				their messages are pumped, the application pops them once per
+				frame. The ring has a fixed capacity and never allocates; when
+				it is full new events are dropped and counted. It is a lock free
+				single producer, single consumer queue: one thread may push
+				while another pops (DXApp forwards input this way to the thread
+				running Update).
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+enum PlatformEventType
+{
+	PE_QUIT,			//Window closed or quit requested
+	PE_ACTIVATE,		//Window gained focus
+	PE_DEACTIVATE,		//Window lost focus (the application pauses)
+	PE_RESIZE,			//Client area resized to Width x Height
+	PE_KEY_DOWN,		//Key pressed (Key), repeats while held
+	PE_KEY_UP,
+	PE_MOUSE_MOVE,		//Cursor moved to X, Y (client coordinates)
+	PE_MOUSE_DOWN,		//Button Key pressed at X, Y
+	PE_MOUSE_UP,
+	PE_MOUSE_RAW		//Relative mouse motion X, Y in device units (raw input, Windows only)
+};
+
+//Key codes are numerically identical to Win32 virtual keys, letters and
+//digits are their upper case ASCII characters ('A', '0')
+enum PlatformKey
+{
+	KEY_UNKNOWN = 0,
+	KEY_BACKSPACE = 0x08,
+	KEY_TAB = 0x09,
+	KEY_RETURN = 0x0D,
+	KEY_SHIFT = 0x10,
+	KEY_CONTROL = 0x11,
+	KEY_ALT = 0x12,
+	KEY_ESCAPE = 0x1B,
+	KEY_SPACE = 0x20,
+	KEY_LEFT = 0x25,
+	KEY_UP = 0x26,
+	KEY_RIGHT = 0x27,
+	KEY_DOWN = 0x28,
+	KEY_F1 = 0x70,		//F3 to F11 follow F2
+	KEY_F2 = 0x71,
+	KEY_F12 = 0x7B
+};
+
+enum PlatformMouseButton
+{
+	MOUSE_LEFT,
+	MOUSE_RIGHT,
+	MOUSE_MIDDLE
+};
+
+struct PlatformEvent
+{
+	PlatformEventType	Type;
+	unsigned			Key;		//PlatformKey or PlatformMouseButton
+	int					X;			//Cursor position, or the new size for PE_RESIZE
+	int					Y;
+	int64_t				Ticks;		//TimerTicks() when the event was received
+};
+
+class EventQueue
+{
+public:
+	enum { CAPACITY = 256 }; //Power of two
+
+	EventQueue() : m_Head(0), m_Tail(0), m_Dropped(0) {}
+
+	//Producer. False (and the event is dropped) if the queue is full.
+	bool Push(const PlatformEvent& e)
+	{
+		unsigned tail = m_Tail.load(std::memory_order_relaxed);
+		if(tail - m_Head.load(std::memory_order_acquire) == CAPACITY)
+		{
+			m_Dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		m_Events[tail & (CAPACITY - 1)] = e;
+		//Publishes the event to the consumer
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer. Oldest event, false if there is none.
+	bool Pop(PlatformEvent* pEvent)
+	{
+		unsigned head = m_Head.load(std::memory_order_relaxed);
+		if(head == m_Tail.load(std::memory_order_acquire))
+			return false;
+		*pEvent = m_Events[head & (CAPACITY - 1)];
+		//Hands the slot back to the producer
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Either thread, may be out of date by the time it returns. The head is read
+	//first: it never passes the tail, so the difference cannot wrap, and pops
+	//between the two loads can only overstate it, up to the clamp.
+	unsigned GetCount() const
+	{
+		unsigned head = m_Head.load(std::memory_order_acquire);
+		unsigned count = m_Tail.load(std::memory_order_acquire) - head;
+		return count < CAPACITY ? count : (unsigned)CAPACITY;
+	}
+	unsigned GetDropped() const { return m_Dropped.load(std::memory_order_relaxed); }
+	//Consumer. Discards the queued events.
+	void Clear() { m_Head.store(m_Tail.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+	//Disallow copying
+	EventQueue(const EventQueue&);
+	EventQueue& operator=(const EventQueue&);
+
+	PlatformEvent	m_Events[CAPACITY];
+	std::atomic<unsigned>	m_Head;		//Next event to pop (wraps around, masked on access)
+	char					m_Pad[64];	//Keep the consumer's and the producer's index on different cache lines
+	std::atomic<unsigned>	m_Tail;		//Next free slot
+	std::atomic<unsigned>	m_Dropped;
+};
@@ -0,0 +1,78 @@
+#include "FixedTimestep.h"
+#include "Timer.h"
+
+#include <string.h>
+
+FixedTimestep::FixedTimestep()
+{
+	m_Frequency = TimerFrequency();
+	m_Rate = 0;
+	m_MaxSteps = 4;
+	Start();
+}
+
+void FixedTimestep::SetRate(unsigned rate, unsigned maxSteps)
+{
+	m_Rate = rate;
+	m_MaxSteps = maxSteps < 1 ? 1 : maxSteps;
+	Start();
+}
+
+void FixedTimestep::Start()
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_Stats.Rate = m_Rate;
+	Resync();
+}
+
+void FixedTimestep::Resync()
+{
+	m_Accumulator = 0;
+	m_LastTicks = TimerTicks();
+}
+
+unsigned FixedTimestep::Advance()
+{
+	int64_t now = TimerTicks();
+	int64_t elapsed = now - m_LastTicks;
+	m_LastTicks = now;
+	return AdvanceBy(elapsed);
+}
+
+unsigned FixedTimestep::AdvanceBy(int64_t elapsedTicks)
+{
+	if(m_Rate == 0)
+		return 0;
+	++m_Stats.Frames;
+
+	//Anything beyond one frame's worth of steps is dropped anyway, clamping first
+	//also keeps elapsedTicks * m_Rate far from overflowing after a long stall
+	int64_t limit = (int64_t)(m_MaxSteps + 1) * m_Frequency / m_Rate + 1;
+	uint64_t dropped = 0;
+	if(elapsedTicks > limit)
+	{
+		dropped = (uint64_t)((elapsedTicks - limit) * (double)m_Rate / m_Frequency);
+		elapsedTicks = limit;
+	}
+	else if(elapsedTicks < 0)
+		elapsedTicks = 0;
+
+	m_Accumulator += elapsedTicks * m_Rate;
+	int64_t steps = m_Accumulator / m_Frequency;
+	m_Accumulator -= steps * m_Frequency;
+	if(steps > (int64_t)m_MaxSteps)
+	{
+		//Spiral of death: catching up would make this frame slow enough to need even
+		//more steps next frame. Drop the backlog, keep the fraction for the alpha.
+		dropped += steps - m_MaxSteps;
+		steps = m_MaxSteps;
+	}
+
+	m_Stats.Steps += steps;
+	m_Stats.DroppedSteps += dropped;
+	if(steps > m_Stats.MaxStepsPerFrame)
+		m_Stats.MaxStepsPerFrame = (unsigned)steps;
+	if(steps == 0)
+		++m_Stats.IdleFrames;
+	return (unsigned)steps;
+}
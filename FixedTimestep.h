@@ -0,0 +1,62 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Fixed timestep clock for the main loop. Real time is
+				accumulated in timer ticks scaled by the step rate, so steps
+				are exact integers and never drift, however long the
+				application runs. Every frame Advance() returns how many
+				simulation steps are due (at most maxSteps, the rest is dropped
+				so a slow frame can not cause ever slower catch-up frames) and
+				the interpolation alpha, the share of the next step that has
+				already passed.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+struct TimestepStats
+{
+	unsigned	Rate;				//Steps per second, 0 when disabled
+	unsigned	Frames;				//Advance() calls since Start()
+	uint64_t	Steps;				//Steps simulated
+	uint64_t	DroppedSteps;		//Steps skipped by the catch-up limit
+	unsigned	MaxStepsPerFrame;	//Most steps a single frame ran
+	unsigned	IdleFrames;			//Frames without a step (rendering faster than the rate)
+};
+
+class FixedTimestep
+{
+public:
+	FixedTimestep();
+
+	//rate steps per second, 0 disables. maxSteps (at least 1) limits the steps of a frame.
+	void SetRate(unsigned rate, unsigned maxSteps = 4);
+	bool IsEnabled() const { return m_Rate > 0; }
+	unsigned GetRate() const { return m_Rate; }
+	//Seconds per step, the dt handed to Update
+	double GetStepTime() const { return m_Rate > 0 ? 1.0 / m_Rate : 0.0; }
+
+	//Restarts the clock at the current time, the statistics included
+	void Start();
+	//Restarts the clock after a pause without simulating the pause; statistics are kept
+	void Resync();
+
+	//Steps due for the time that passed since the last call
+	unsigned Advance();
+	//Steps due after elapsedTicks (timer ticks) of time, e.g. simulated time of a replay
+	unsigned AdvanceBy(int64_t elapsedTicks);
+	//Share (0 .. 1) of the next step that already passed, for rendering between the last two states
+	float GetAlpha() const { return (float)((double)m_Accumulator / m_Frequency); }
+	//Time simulated since Start(), in seconds
+	double GetSimulatedTime() const { return m_Rate > 0 ? (double)m_Stats.Steps / m_Rate : 0.0; }
+
+	const TimestepStats& GetStats() const { return m_Stats; }
+
+private:
+	int64_t			m_Frequency;	//Timer ticks per second, one step in m_Accumulator units
+	unsigned		m_Rate;
+	unsigned		m_MaxSteps;
+	int64_t			m_Accumulator;	//Time not simulated yet, in timer ticks times m_Rate
+	int64_t			m_LastTicks;	//Time of the previous Advance()
+	TimestepStats	m_Stats;
+};
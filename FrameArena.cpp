@@ -0,0 +1,109 @@
+#include "FrameArena.h"
+
+#include <stdlib.h>
+
+namespace
+{
+	//Buffers start on a cache line so frames do not share lines
+	const size_t CACHE_LINE = 64;
+
+	size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+FrameArena::FrameArena()
+{
+	m_pMemory = NULL;
+	for(int i = 0; i < MAX_FRAMES; ++i)
+		m_pFrames[i] = NULL;
+	m_Capacity = 0;
+	m_FrameCount = 0;
+	m_Current = 0;
+	m_Offset = 0;
+	m_Peak = 0;
+	m_FailedAllocs = 0;
+}
+
+FrameArena::~FrameArena()
+{
+	Shutdown();
+}
+
+bool FrameArena::Init(size_t bytesPerFrame, unsigned frameCount)
+{
+	if(m_pMemory || bytesPerFrame == 0 || frameCount < 1 || frameCount > MAX_FRAMES)
+		return false;
+
+	size_t frameSize = AlignUp(bytesPerFrame, CACHE_LINE);
+	m_pMemory = (uint8_t*)malloc(frameSize * frameCount + CACHE_LINE);
+	if(!m_pMemory)
+		return false;
+
+	uint8_t* pAligned = (uint8_t*)AlignUp((size_t)m_pMemory, CACHE_LINE);
+	for(unsigned i = 0; i < frameCount; ++i)
+		m_pFrames[i] = pAligned + i * frameSize;
+
+	m_Capacity = bytesPerFrame;
+	m_FrameCount = frameCount;
+	m_Current = 0;
+	m_Offset = 0;
+	m_Peak = 0;
+	m_FailedAllocs = 0;
+	return true;
+}
+
+void FrameArena::Shutdown()
+{
+	free(m_pMemory);
+	m_pMemory = NULL;
+	for(int i = 0; i < MAX_FRAMES; ++i)
+		m_pFrames[i] = NULL;
+	m_Capacity = 0;
+	m_FrameCount = 0;
+	m_Offset = 0;
+}
+
+void FrameArena::BeginFrame()
+{
+	BeginFrame(m_Current + 1);
+}
+
+void FrameArena::BeginFrame(unsigned buffer)
+{
+	if(!m_pMemory)
+		return;
+
+	size_t used = m_Offset.load(std::memory_order_relaxed);
+	if(used > m_Peak)
+		m_Peak = used;
+
+	m_Current = buffer % m_FrameCount;
+	m_Offset.store(0, std::memory_order_relaxed);
+}
+
+void* FrameArena::Alloc(size_t size, size_t alignment)
+{
+	//Offsets are relative to a cache line aligned base, so aligning the offset aligns the pointer
+	size_t offset = m_Offset.load(std::memory_order_relaxed);
+	size_t begin;
+	do
+	{
+		begin = AlignUp(offset, alignment);
+		if(!m_pMemory || begin + size > m_Capacity)
+		{
+			m_FailedAllocs.fetch_add(1, std::memory_order_relaxed);
+			return NULL;
+		}
+	}
+	while(!m_Offset.compare_exchange_weak(offset, begin + size, std::memory_order_relaxed));
+
+	return m_pFrames[m_Current] + begin;
+}
+
+size_t FrameArena::GetPeak() const
+{
+	size_t used = m_Offset.load(std::memory_order_relaxed);
+	return used > m_Peak ? used : m_Peak;
+}
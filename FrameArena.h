@@ -0,0 +1,73 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Per frame bump allocator. Memory is handed out by bumping an
+				offset and released all at once when the frame is recycled, so
+				per frame work (draw lists, temporary arrays) never touches the heap.
+				Frames rotate through several buffers so data of the previous
+				frame stays valid while the next one is built.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <atomic>
+
+class FrameArena
+{
+public:
+	enum { MAX_FRAMES = 4 };
+
+	FrameArena();
+	~FrameArena();
+
+	//Allocates frameCount buffers of bytesPerFrame each (2 = double buffered)
+	bool Init(size_t bytesPerFrame, unsigned frameCount = 2);
+	void Shutdown();
+
+	//Switches to the next buffer and empties it. Everything allocated
+	//frameCount frames ago becomes invalid.
+	void BeginFrame();
+	//Switches to a specific buffer (e.g. a pipeline snapshot slot) and empties it
+	void BeginFrame(unsigned buffer);
+
+	//Thread safe. alignment must be a power of two up to 64.
+	//Returns NULL (and counts a failure) when the frame is full.
+	void* Alloc(size_t size, size_t alignment = 16);
+
+	//Uninitialized storage for count objects of T (no constructors run)
+	template<typename T>
+	T* AllocArray(size_t count) { return (T*)Alloc(count * sizeof(T), __alignof(T) > 16 ? __alignof(T) : 16); }
+
+	//Constructs a T in frame memory. Destructors are never run, use for plain data.
+	template<typename T>
+	T* New()
+	{
+		void* p = Alloc(sizeof(T), __alignof(T) > 16 ? __alignof(T) : 16);
+		return p ? new(p) T() : NULL;
+	}
+
+	size_t GetCapacity() const { return m_Capacity; }
+	unsigned GetFrameCount() const { return m_FrameCount; }
+	//Bytes used by the current frame
+	size_t GetUsed() const { return m_Offset.load(std::memory_order_relaxed); }
+	//Largest amount any frame used since Init
+	size_t GetPeak() const;
+	//Allocations that did not fit since Init
+	unsigned GetFailedAllocs() const { return m_FailedAllocs.load(std::memory_order_relaxed); }
+
+private:
+	//Disallow copying
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+
+	uint8_t*				m_pMemory;
+	uint8_t*				m_pFrames[MAX_FRAMES];
+	size_t					m_Capacity;
+	unsigned				m_FrameCount;
+	unsigned				m_Current;
+	std::atomic<size_t>		m_Offset;
+	size_t					m_Peak;
+	std::atomic<unsigned>	m_FailedAllocs;
+};
@@ -0,0 +1,231 @@
+#include "FrameBenchmark.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	//Nearest rank percentile of a sorted array
+	double Percentile(const std::vector<double>& sorted, double p)
+	{
+		if(sorted.empty())
+			return 0.0;
+		size_t rank = (size_t)(p * (sorted.size() - 1) + 0.5);
+		return sorted[std::min(rank, sorted.size() - 1)];
+	}
+
+	void WritePhase(FILE* f, const char* name, const PhaseStats& s, bool last)
+	{
+		fprintf(f, "    \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+			name, s.Mean, s.P50, s.P95, s.P99, s.Max, last ? "" : ",");
+	}
+}
+
+FrameBenchmark::FrameBenchmark()
+{
+	m_Next = 0;
+	m_TotalFrames = 0;
+	m_FixedDt = 0.0;
+	m_BudgetMs = 1000.0 / 60.0;
+	m_StartupMs = 0.0;
+	m_StreamedBytes = 0;
+	m_StreamedMBps = 0.0;
+	m_DeviceResets = 0;
+	m_MaxResetMs = 0.0;
+	m_ExportedFrames = 0;
+	m_ExportFps = 0.0;
+	m_ShaderHits = 0;
+	m_ShadersCompiled = 0;
+	m_ShadersReadyMs = 0.0;
+	m_InputEvents = 0;
+	m_DroppedEvents = 0;
+	m_StateCalls = 0;
+	m_StateCallsFiltered = 0;
+	memset(&m_Pacing, 0, sizeof(m_Pacing));
+	memset(&m_Timestep, 0, sizeof(m_Timestep));
+}
+
+void FrameBenchmark::Init(unsigned capacity, double fixedDt, double budgetMs)
+{
+	m_Samples.assign(std::max(1u, capacity), FrameSample());
+	m_FixedDt = fixedDt;
+	m_BudgetMs = budgetMs;
+	Reset();
+}
+
+void FrameBenchmark::Reset()
+{
+	m_Next = 0;
+	m_TotalFrames = 0;
+}
+
+void FrameBenchmark::Record(const FrameSample& sample)
+{
+	if(m_Samples.empty())
+		return;
+
+	m_Samples[m_Next] = sample;
+	m_Next = (m_Next + 1) % (unsigned)m_Samples.size();
+	++m_TotalFrames;
+}
+
+PhaseStats FrameBenchmark::ComputeStats(int64_t FrameSample::*phase, std::vector<double>& scratch, bool skipZero) const
+{
+	unsigned frames = std::min(m_TotalFrames, (unsigned)m_Samples.size());
+	scratch.resize(frames);
+
+	unsigned count = 0;
+	double sum = 0.0;
+	for(unsigned i = 0; i < frames; ++i)
+	{
+		if(skipZero && m_Samples[i].*phase == 0)
+			continue;
+		scratch[count] = TicksToMs(m_Samples[i].*phase);
+		sum += scratch[count++];
+	}
+	scratch.resize(count);
+	std::sort(scratch.begin(), scratch.end());
+
+	PhaseStats stats;
+	stats.Mean = count ? sum / count : 0.0;
+	stats.P50 = Percentile(scratch, 0.50);
+	stats.P95 = Percentile(scratch, 0.95);
+	stats.P99 = Percentile(scratch, 0.99);
+	stats.Max = scratch.empty() ? 0.0 : scratch.back();
+	return stats;
+}
+
+FrameReport FrameBenchmark::Report() const
+{
+	FrameReport report;
+	report.Frames = std::min(m_TotalFrames, (unsigned)m_Samples.size());
+	report.TotalFrames = m_TotalFrames;
+	report.FixedDt = m_FixedDt;
+	report.BudgetMs = m_BudgetMs;
+
+	std::vector<double> scratch;
+	report.Update = ComputeStats(&FrameSample::UpdateTicks, scratch);
+	report.Cull = ComputeStats(&FrameSample::CullTicks, scratch);
+	report.Upload = ComputeStats(&FrameSample::UploadTicks, scratch);
+	report.Render = ComputeStats(&FrameSample::RenderTicks, scratch);
+	report.Readback = ComputeStats(&FrameSample::ReadbackTicks, scratch);
+	report.Frame = ComputeStats(&FrameSample::FrameTicks, scratch);
+	report.InputLatency = ComputeStats(&FrameSample::InputLatencyTicks, scratch, true);
+	report.InputFrames = (unsigned)scratch.size();
+
+	//Stalls are frames over budget, spikes are frames far off the typical frame
+	report.Stalls = 0;
+	report.Spikes = 0;
+	report.HeapAllocations = 0;
+	report.MaxHeapAllocations = 0;
+	report.PeakArenaBytes = 0;
+	report.UploadHitches = 0;
+	report.StartupMs = m_StartupMs;
+	report.StreamedBytes = m_StreamedBytes;
+	report.StreamedMBps = m_StreamedMBps;
+	report.DeviceResets = m_DeviceResets;
+	report.MaxResetMs = m_MaxResetMs;
+	report.ExportedFrames = m_ExportedFrames;
+	report.ExportFps = m_ExportFps;
+	report.ShaderHits = m_ShaderHits;
+	report.ShadersCompiled = m_ShadersCompiled;
+	report.ShadersReadyMs = m_ShadersReadyMs;
+	report.InputEvents = m_InputEvents;
+	report.DroppedEvents = m_DroppedEvents;
+	report.StateCalls = m_StateCalls;
+	report.StateCallsFiltered = m_StateCallsFiltered;
+	report.Pacing = m_Pacing;
+	report.Timestep = m_Timestep;
+	for(unsigned i = 0; i < report.Frames; ++i)
+	{
+		report.HeapAllocations += m_Samples[i].HeapAllocations;
+		report.MaxHeapAllocations = std::max(report.MaxHeapAllocations, m_Samples[i].HeapAllocations);
+		report.PeakArenaBytes = std::max(report.PeakArenaBytes, m_Samples[i].ArenaBytes);
+
+		double ms = TicksToMs(m_Samples[i].FrameTicks);
+		if(ms > m_BudgetMs)
+		{
+			++report.Stalls;
+			if(ms - TicksToMs(m_Samples[i].UploadTicks) <= m_BudgetMs)
+				++report.UploadHitches;
+		}
+		if(ms > 2.0 * report.Frame.P50)
+			++report.Spikes;
+	}
+	return report;
+}
+
+bool FrameBenchmark::WriteJSON(const std::string& path) const
+{
+	FILE* f = fopen(path.c_str(), "w");
+	if(!f)
+		return false;
+
+	FrameReport r = Report();
+	fprintf(f, "{\n");
+	fprintf(f, "  \"frames\": %u,\n", r.Frames);
+	fprintf(f, "  \"totalFrames\": %u,\n", r.TotalFrames);
+	fprintf(f, "  \"fixedDt\": %.6f,\n", r.FixedDt);
+	fprintf(f, "  \"budgetMs\": %.4f,\n", r.BudgetMs);
+	fprintf(f, "  \"stalls\": %u,\n", r.Stalls);
+	fprintf(f, "  \"spikes\": %u,\n", r.Spikes);
+	fprintf(f, "  \"heapAllocations\": %llu,\n", (unsigned long long)r.HeapAllocations);
+	fprintf(f, "  \"maxHeapAllocationsPerFrame\": %u,\n", r.MaxHeapAllocations);
+	fprintf(f, "  \"peakArenaBytes\": %u,\n", r.PeakArenaBytes);
+	fprintf(f, "  \"uploadHitches\": %u,\n", r.UploadHitches);
+	fprintf(f, "  \"startupMs\": %.4f,\n", r.StartupMs);
+	fprintf(f, "  \"streamedBytes\": %llu,\n", (unsigned long long)r.StreamedBytes);
+	fprintf(f, "  \"streamedMBps\": %.2f,\n", r.StreamedMBps);
+	fprintf(f, "  \"deviceResets\": %u,\n", r.DeviceResets);
+	fprintf(f, "  \"maxResetMs\": %.4f,\n", r.MaxResetMs);
+	fprintf(f, "  \"readback\": { \"exportedFrames\": %u, \"exportFps\": %.2f },\n", r.ExportedFrames, r.ExportFps);
+	fprintf(f, "  \"shaders\": { \"hits\": %u, \"compiled\": %u, \"readyMs\": %.4f },\n", r.ShaderHits, r.ShadersCompiled, r.ShadersReadyMs);
+	const PhaseStats& l = r.InputLatency;
+	fprintf(f, "  \"input\": { \"events\": %u, \"dropped\": %u, \"frames\": %u, "
+		"\"latencyMs\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f } },\n",
+		r.InputEvents, r.DroppedEvents, r.InputFrames, l.Mean, l.P50, l.P95, l.P99, l.Max);
+	fprintf(f, "  \"stateCache\": { \"calls\": %u, \"filtered\": %u },\n", r.StateCalls, r.StateCallsFiltered);
+	const PacingStats& p = r.Pacing;
+	fprintf(f, "  \"pacing\": { \"targetMs\": %.4f, \"meanIntervalMs\": %.4f, \"jitterMs\": %.4f, "
+		"\"meanLatenessMs\": %.4f, \"maxLatenessMs\": %.4f, \"missed\": %u, \"sleepMs\": %.2f, \"spinMs\": %.2f },\n",
+		p.TargetMs, p.MeanIntervalMs, p.JitterMs, p.MeanLatenessMs, p.MaxLatenessMs, p.Missed, p.SleepMs, p.SpinMs);
+	const TimestepStats& t = r.Timestep;
+	fprintf(f, "  \"timestep\": { \"rate\": %u, \"steps\": %llu, \"dropped\": %llu, \"maxStepsPerFrame\": %u, \"idleFrames\": %u },\n",
+		t.Rate, (unsigned long long)t.Steps, (unsigned long long)t.DroppedSteps, t.MaxStepsPerFrame, t.IdleFrames);
+	fprintf(f, "  \"phasesMs\": {\n");
+	WritePhase(f, "update", r.Update, false);
+	WritePhase(f, "cull", r.Cull, false);
+	WritePhase(f, "upload", r.Upload, false);
+	WritePhase(f, "render", r.Render, false);
+	WritePhase(f, "readback", r.Readback, false);
+	WritePhase(f, "frame", r.Frame, true);
+	fprintf(f, "  }\n");
+	fprintf(f, "}\n");
+
+	return fclose(f) == 0;
+}
+
+bool FrameBenchmark::WriteCSV(const std::string& path) const
+{
+	FILE* f = fopen(path.c_str(), "w");
+	if(!f)
+		return false;
+
+	//Samples in recording order (oldest first)
+	unsigned count = std::min(m_TotalFrames, (unsigned)m_Samples.size());
+	unsigned first = m_TotalFrames > m_Samples.size() ? m_Next : 0;
+	unsigned firstFrame = m_TotalFrames - count;
+	fprintf(f, "frame,update_ms,cull_ms,upload_ms,render_ms,readback_ms,frame_ms,input_latency_ms,heap_allocs,arena_bytes\n");
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const FrameSample& s = m_Samples[(first + i) % m_Samples.size()];
+		fprintf(f, "%u,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%u,%u\n", firstFrame + i,
+			TicksToMs(s.UpdateTicks), TicksToMs(s.CullTicks), TicksToMs(s.UploadTicks), TicksToMs(s.RenderTicks),
+			TicksToMs(s.ReadbackTicks), TicksToMs(s.FrameTicks), TicksToMs(s.InputLatencyTicks),
+			s.HeapAllocations, s.ArenaBytes);
+	}
+
+	return fclose(f) == 0;
+}
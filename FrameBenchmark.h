@@ -0,0 +1,134 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Frame time recorder used by DXApp's benchmark mode.
+				Stores per phase CPU times in a preallocated ring buffer and
+				reports percentiles and stalls as JSON or CSV.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "FramePacer.h"
+#include "FixedTimestep.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//CPU time of one frame, in timer ticks
+struct FrameSample
+{
+	int64_t UpdateTicks;
+	int64_t CullTicks;
+	int64_t UploadTicks;		//Streamed asset uploads before Render
+	int64_t RenderTicks;
+	int64_t ReadbackTicks;		//Back buffer copy and export of an earlier frame (offscreen capture)
+	int64_t FrameTicks;		//Whole iteration including message pumping
+	int64_t InputLatencyTicks;	//Oldest input event of the presented frame to its Present, 0 without input
+	unsigned HeapAllocations;	//operator new calls during the frame (all threads)
+	unsigned ArenaBytes;		//Frame arena bytes used by the frame's update
+};
+
+//Statistics of one phase, in milliseconds
+struct PhaseStats
+{
+	double Mean;
+	double P50;
+	double P95;
+	double P99;
+	double Max;
+};
+
+struct FrameReport
+{
+	unsigned	Frames;			//Frames in the report (at most the ring capacity)
+	unsigned	TotalFrames;	//Frames recorded in total
+	double		FixedDt;		//Simulation step used (seconds)
+	double		BudgetMs;		//Frame budget used to count stalls
+	unsigned	Stalls;			//Frames over budget
+	unsigned	Spikes;			//Frames over twice the median
+	uint64_t	HeapAllocations;	//Heap allocations over all frames
+	unsigned	MaxHeapAllocations;	//Most heap allocations in a single frame
+	unsigned	PeakArenaBytes;		//Most frame arena bytes used by a single frame
+	unsigned	UploadHitches;		//Frames over budget that would have made it without their uploads
+	double		StartupMs;			//From application start to the first rendered frame
+	uint64_t	StreamedBytes;		//Asset bytes read by the streaming threads
+	double		StreamedMBps;
+	unsigned	DeviceResets;		//Device losses recovered from
+	double		MaxResetMs;			//Slowest recovery
+	unsigned	ExportedFrames;		//Frames read back and handed to the frame sink
+	double		ExportFps;			//Exported frames per second of wall time
+	unsigned	ShaderHits;			//Shaders loaded from the shader cache
+	unsigned	ShadersCompiled;	//Shaders the cache had to compile
+	double		ShadersReadyMs;		//From startup until no shader was pending
+	unsigned	InputEvents;		//Input events handed to Update
+	unsigned	DroppedEvents;		//Events lost to full event rings
+	unsigned	InputFrames;		//Frames with input, the only ones in InputLatency
+	unsigned	StateCalls;			//State changes the application made through the state cache
+	unsigned	StateCallsFiltered;	//Of those, redundant ones that never reached the backend
+	PhaseStats	InputLatency;
+	PacingStats	Pacing;				//Frame scheduling, when paced
+	TimestepStats	Timestep;		//Simulation steps, when the timestep is fixed
+	PhaseStats	Update;
+	PhaseStats	Cull;
+	PhaseStats	Upload;
+	PhaseStats	Render;
+	PhaseStats	Readback;
+	PhaseStats	Frame;
+};
+
+class FrameBenchmark
+{
+public:
+	FrameBenchmark();
+
+	//Allocates the ring buffer. Everything after this is allocation free until Report().
+	void Init(unsigned capacity, double fixedDt, double budgetMs = 1000.0 / 60.0);
+	void Record(const FrameSample& sample);
+	void Reset();
+
+	//Values reported as they are, measured by the application
+	void SetStartupMs(double ms) { m_StartupMs = ms; }
+	void SetStreamed(uint64_t bytes, double mbps) { m_StreamedBytes = bytes; m_StreamedMBps = mbps; }
+	void SetDeviceResets(unsigned resets, double maxMs) { m_DeviceResets = resets; m_MaxResetMs = maxMs; }
+	void SetPacing(const PacingStats& pacing) { m_Pacing = pacing; }
+	void SetTimestep(const TimestepStats& timestep) { m_Timestep = timestep; }
+	void SetReadback(unsigned exported, double fps) { m_ExportedFrames = exported; m_ExportFps = fps; }
+	void SetShaders(unsigned hits, unsigned compiled, double readyMs) { m_ShaderHits = hits; m_ShadersCompiled = compiled; m_ShadersReadyMs = readyMs; }
+	void SetInput(unsigned events, unsigned dropped) { m_InputEvents = events; m_DroppedEvents = dropped; }
+	void SetStateCalls(unsigned calls, unsigned filtered) { m_StateCalls = calls; m_StateCallsFiltered = filtered; }
+
+	unsigned GetTotalFrames() const { return m_TotalFrames; }
+
+	//Builds the report from the samples currently in the ring
+	FrameReport Report() const;
+
+	//Write the report (plus per frame samples for CSV); return false on IO errors
+	bool WriteJSON(const std::string& path) const;
+	bool WriteCSV(const std::string& path) const;
+
+private:
+	//Statistics of one field over the frames in the ring, without the zeros if skipZero
+	PhaseStats ComputeStats(int64_t FrameSample::*phase, std::vector<double>& scratch, bool skipZero = false) const;
+
+	std::vector<FrameSample>	m_Samples;		//Ring buffer
+	unsigned					m_Next;			//Next slot to write
+	unsigned					m_TotalFrames;
+	double						m_FixedDt;
+	double						m_BudgetMs;
+	double						m_StartupMs;
+	uint64_t					m_StreamedBytes;
+	double						m_StreamedMBps;
+	unsigned					m_DeviceResets;
+	double						m_MaxResetMs;
+	unsigned					m_ExportedFrames;
+	double						m_ExportFps;
+	unsigned					m_ShaderHits;
+	unsigned					m_ShadersCompiled;
+	double						m_ShadersReadyMs;
+	unsigned					m_InputEvents;
+	unsigned					m_DroppedEvents;
+	unsigned					m_StateCalls;
+	unsigned					m_StateCallsFiltered;
+	PacingStats					m_Pacing;
+	TimestepStats				m_Timestep;
+};
@@ -0,0 +1,210 @@
+#include "FramePacer.h"
+#include "Timer.h"
+
+#include <math.h>
+#include <emmintrin.h>
+
+#ifdef _WIN32
+//Windows 10 1803 and later, missing from older SDKs
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+namespace
+{
+	//Weight of a new sample in the sleep estimate
+	const double SLEEP_ESTIMATE_RATE = 0.05;
+}
+
+FramePacer::FramePacer()
+{
+	m_Mode = PACING_OFF;
+	m_Frequency = TimerFrequency();
+	m_PeriodTicks = 0;
+	m_hTimer = NULL;
+#ifdef _WIN32
+	//High resolution timers wake within about half a millisecond,
+	//older systems fall back to the normal timer (timer tick granularity)
+	m_hTimer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if(!m_hTimer)
+		m_hTimer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+#endif
+
+	//Pessimistic until the first sleeps were measured, so early frames spin a little longer
+	m_SleepMean = 2.0;
+	m_SleepVariance = 0.0;
+
+	m_Smoothing = 1;
+	m_MaxDt = 0.25;
+	Start();
+}
+
+FramePacer::~FramePacer()
+{
+#ifdef _WIN32
+	if(m_hTimer)
+		CloseHandle(m_hTimer);
+#endif
+}
+
+void FramePacer::SetTarget(double fps, PacingMode mode)
+{
+	m_Mode = fps > 0.0 ? mode : PACING_OFF;
+	m_PeriodTicks = m_Mode != PACING_OFF ? (int64_t)(m_Frequency / fps) : 0;
+	Resync();
+}
+
+void FramePacer::SetSmoothing(unsigned frames, double maxDt)
+{
+	m_Smoothing = frames < 1 ? 1 : (frames > MAX_SMOOTHING ? (unsigned)MAX_SMOOTHING : frames);
+	m_MaxDt = maxDt;
+	m_NextFrameTime = 0;
+	m_FrameTimeCount = 0;
+}
+
+void FramePacer::Start()
+{
+	m_NextFrameTime = 0;
+	m_FrameTimeCount = 0;
+
+	m_Frames = 0;
+	m_Intervals = 0;
+	m_IntervalSum = 0.0;
+	m_IntervalSquares = 0.0;
+	m_LatenessSum = 0.0;
+	m_MaxLateness = 0.0;
+	m_Missed = 0;
+	m_SleepTicks = 0;
+	m_SpinTicks = 0;
+	Resync();
+}
+
+void FramePacer::Resync()
+{
+	m_LastFrame = TimerTicks();
+	m_Deadline = m_LastFrame + m_PeriodTicks;
+	m_Started = false;
+}
+
+void FramePacer::SleepFor(double ms)
+{
+	int64_t start = TimerTicks();
+#ifdef _WIN32
+	//Relative due time in 100 ns units
+	LARGE_INTEGER due;
+	due.QuadPart = -(LONGLONG)(ms * 10000.0);
+	if(m_hTimer && SetWaitableTimer(m_hTimer, &due, 0, NULL, NULL, FALSE))
+		WaitForSingleObject(m_hTimer, INFINITE);
+	else
+		::Sleep((DWORD)ms);
+#else
+	timespec duration;
+	duration.tv_sec = (time_t)(ms / 1000.0);
+	duration.tv_nsec = (long)((ms - duration.tv_sec * 1000.0) * 1000000.0);
+	nanosleep(&duration, NULL);
+#endif
+	m_SleepTicks += TimerTicks() - start;
+}
+
+void FramePacer::WaitUntil(int64_t deadline)
+{
+	if(m_Mode == PACING_POWER)
+	{
+		//A single sleep, waking up late is accepted
+		double remaining = TicksToMs(deadline - TimerTicks());
+		if(remaining > 0.0)
+			SleepFor(remaining);
+		return;
+	}
+
+	//Sleep in 1 ms steps while a step (as long as they usually take, plus
+	//one standard deviation) still ends before the deadline
+	for(;;)
+	{
+		int64_t now = TimerTicks();
+		if(TicksToMs(deadline - now) <= m_SleepMean + sqrt(m_SleepVariance))
+			break;
+
+		SleepFor(1.0);
+		double delta = TicksToMs(TimerTicks() - now) - m_SleepMean;
+		m_SleepMean += SLEEP_ESTIMATE_RATE * delta;
+		m_SleepVariance = (1.0 - SLEEP_ESTIMATE_RATE) * (m_SleepVariance + SLEEP_ESTIMATE_RATE * delta * delta);
+	}
+
+	//Spin the rest
+	int64_t spinStart = TimerTicks();
+	while(TimerTicks() < deadline)
+		_mm_pause();
+	m_SpinTicks += TimerTicks() - spinStart;
+}
+
+double FramePacer::WaitForFrame()
+{
+	//The first frame after Start() or Resync() starts right away
+	if(m_PeriodTicks > 0 && m_Started)
+	{
+		WaitUntil(m_Deadline);
+
+		int64_t late = TimerTicks() - m_Deadline;
+		double lateMs = TicksToMs(late > 0 ? late : 0);
+		m_LatenessSum += lateMs;
+		if(lateMs > m_MaxLateness)
+			m_MaxLateness = lateMs;
+
+		//Too far behind to catch up without a burst of frames, start over from now
+		if(late > m_PeriodTicks)
+		{
+			++m_Missed;
+			m_Deadline = TimerTicks();
+		}
+	}
+	int64_t now = TimerTicks();
+	if(!m_Started)
+		m_Deadline = now;
+	m_Deadline += m_PeriodTicks;
+
+	//Raw frame time, from the start of the previous frame
+	double frameTime = (double)(now - m_LastFrame) / m_Frequency;
+	if(m_Started)
+	{
+		double ms = frameTime * 1000.0;
+		m_IntervalSum += ms;
+		m_IntervalSquares += ms * ms;
+		++m_Intervals;
+	}
+	m_LastFrame = now;
+	m_Started = true;
+	++m_Frames;
+
+	//Smoothed dt
+	if(frameTime > m_MaxDt)
+		frameTime = m_MaxDt;
+	m_FrameTimes[m_NextFrameTime] = frameTime;
+	m_NextFrameTime = (m_NextFrameTime + 1) % m_Smoothing;
+	if(m_FrameTimeCount < m_Smoothing)
+		++m_FrameTimeCount;
+
+	double sum = 0.0;
+	for(unsigned i = 0; i < m_FrameTimeCount; ++i)
+		sum += m_FrameTimes[i];
+	return sum / m_FrameTimeCount;
+}
+
+PacingStats FramePacer::GetStats() const
+{
+	PacingStats stats;
+	stats.Frames = m_Frames;
+	stats.TargetMs = TicksToMs(m_PeriodTicks);
+	stats.MeanIntervalMs = m_Intervals ? m_IntervalSum / m_Intervals : 0.0;
+	double variance = m_Intervals ? m_IntervalSquares / m_Intervals - stats.MeanIntervalMs * stats.MeanIntervalMs : 0.0;
+	stats.JitterMs = variance > 0.0 ? sqrt(variance) : 0.0;
+	unsigned paced = m_PeriodTicks > 0 && m_Frames > 0 ? m_Frames - 1 : 0;
+	stats.MeanLatenessMs = paced ? m_LatenessSum / paced : 0.0;
+	stats.MaxLatenessMs = m_MaxLateness;
+	stats.Missed = m_Missed;
+	stats.SleepMs = TicksToMs(m_SleepTicks);
+	stats.SpinMs = TicksToMs(m_SpinTicks);
+	stats.SleepEstimateMs = m_SleepMean + sqrt(m_SleepVariance);
+	return stats;
+}
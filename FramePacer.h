@@ -0,0 +1,103 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Frame pacing for the main loop. Frames start on fixed deadlines
+				(so late frames do not shift every following one); the time until
+				a deadline is slept on a high resolution waitable timer and, in
+				latency mode, the last part is spun so the frame starts on time.
+				The spin tail adapts to how much the OS oversleeps. Also smooths
+				the dt handed to Update and measures the achieved pacing.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+enum PacingMode
+{
+	PACING_OFF,			//Frames start as soon as the previous one finished
+	PACING_LATENCY,		//Sleep, then spin the last part for accurate frame starts
+	PACING_POWER		//Sleep only, frames may start up to a timer tick late
+};
+
+struct PacingStats
+{
+	unsigned	Frames;				//Frames since Start()
+	double		TargetMs;			//Frame period, 0 when not pacing
+	double		MeanIntervalMs;		//Achieved time between frame starts
+	double		JitterMs;			//Standard deviation of that interval
+	double		MeanLatenessMs;		//Frame start after its deadline, on average
+	double		MaxLatenessMs;
+	unsigned	Missed;				//Frames more than a period late (schedule restarted)
+	double		SleepMs;			//Time spent sleeping
+	double		SpinMs;				//Time spent spinning
+	double		SleepEstimateMs;	//Expected length of a 1 ms sleep, including oversleeping
+};
+
+class FramePacer
+{
+public:
+	FramePacer();
+	~FramePacer();
+
+	//fps 0 (or PACING_OFF) lets frames run back to back
+	void SetTarget(double fps, PacingMode mode = PACING_LATENCY);
+	double GetTargetFps() const { return m_PeriodTicks > 0 ? (double)m_Frequency / m_PeriodTicks : 0.0; }
+	PacingMode GetMode() const { return m_Mode; }
+
+	//dt is the mean of the last frames frame times (1 disables smoothing).
+	//Single frame times are clamped to maxDt first, so a hitch (window drag,
+	//breakpoint) does not turn into one huge simulation step.
+	void SetSmoothing(unsigned frames, double maxDt = 0.25);
+
+	//Restarts the schedule, the smoothing and the statistics
+	void Start();
+	//Restarts the schedule after a pause, so the pause is neither caught up
+	//nor seen as one long frame. Statistics are kept.
+	void Resync();
+	//Waits until the next frame is due, then returns the smoothed dt (seconds)
+	//of the frame starting now
+	double WaitForFrame();
+
+	PacingStats GetStats() const;
+
+private:
+	//Disallow copying
+	FramePacer(const FramePacer&);
+	FramePacer& operator=(const FramePacer&);
+
+	enum { MAX_SMOOTHING = 16 };
+
+	//Sleeps about ms milliseconds on the best timer available
+	void SleepFor(double ms);
+	void WaitUntil(int64_t deadline);
+
+	PacingMode	m_Mode;
+	int64_t		m_Frequency;
+	int64_t		m_PeriodTicks;			//0 when not pacing
+	int64_t		m_Deadline;				//Start of the next frame
+	int64_t		m_LastFrame;			//Start of the previous frame
+	bool		m_Started;				//False until the first frame after Start() or Resync()
+	void*		m_hTimer;				//Waitable timer (Windows)
+
+	//Estimate (mean and variance) of a 1 ms sleep, for the spin tail
+	double		m_SleepMean;
+	double		m_SleepVariance;
+
+	//dt smoothing
+	double		m_FrameTimes[MAX_SMOOTHING];
+	unsigned	m_Smoothing;
+	unsigned	m_NextFrameTime;
+	unsigned	m_FrameTimeCount;
+	double		m_MaxDt;
+
+	//Statistics
+	unsigned	m_Frames;
+	unsigned	m_Intervals;
+	double		m_IntervalSum;
+	double		m_IntervalSquares;
+	double		m_LatenessSum;
+	double		m_MaxLateness;
+	unsigned	m_Missed;
+	int64_t		m_SleepTicks;
+	int64_t		m_SpinTicks;
+};
@@ -0,0 +1,140 @@
+#include "FramePipeline.h"
+#include "Timer.h"
+#include "Profiler.h"
+
+FramePipeline::FramePipeline()
+{
+	m_Callback = NULL;
+	m_pContext = NULL;
+	m_FramesInFlight = 1;
+	m_Quit = false;
+	m_Requested = m_Produced = m_Acquired = m_Released = 0;
+	m_WaitTicks = 0;
+}
+
+FramePipeline::~FramePipeline()
+{
+	Stop();
+}
+
+bool FramePipeline::Start(unsigned framesInFlight, FrameProduceCallback callback, void* pContext)
+{
+	if(IsRunning() || !callback || framesInFlight < 1 || framesInFlight > MAX_FRAMES_IN_FLIGHT)
+		return false;
+
+	m_Callback = callback;
+	m_pContext = pContext;
+	m_FramesInFlight = framesInFlight;
+	m_Quit = false;
+	m_Requested = m_Produced = m_Acquired = m_Released = 0;
+	m_WaitTicks = 0;
+	m_Worker = std::thread(&FramePipeline::WorkerMain, this);
+	return true;
+}
+
+void FramePipeline::Stop()
+{
+	if(!IsRunning())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Quit = true;
+	}
+	m_WorkReady.notify_one();
+	m_Worker.join();
+}
+
+void FramePipeline::Kick(const FrameUpdate& update)
+{
+	int64_t waitStart = TimerTicks();
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	//Every slot is either queued, being produced, waiting to render or rendering
+	while(m_Requested - m_Released >= GetSlotCount())
+		m_FrameDone.wait(lock);
+	m_WaitTicks += TimerTicks() - waitStart;
+
+	m_SlotUpdates[m_Requested % GetSlotCount()] = update;
+	++m_Requested;
+	lock.unlock();
+	m_WorkReady.notify_one();
+}
+
+bool FramePipeline::Acquire(unsigned* pSlot, int64_t* pUpdateTicks)
+{
+	int64_t waitStart = TimerTicks();
+	std::unique_lock<std::mutex> lock(m_Mutex);
+
+	//Keep framesInFlight updates ahead of the frame being rendered
+	if(m_Requested - m_Acquired <= m_FramesInFlight)
+		return false;
+
+	while(m_Produced == m_Acquired)
+		m_FrameDone.wait(lock);
+	m_WaitTicks += TimerTicks() - waitStart;
+
+	unsigned slot = (unsigned)(m_Acquired % GetSlotCount());
+	++m_Acquired;
+
+	*pSlot = slot;
+	if(pUpdateTicks)
+		*pUpdateTicks = m_SlotUpdateTicks[slot];
+	return true;
+}
+
+void FramePipeline::Release()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		++m_Released;
+	}
+	m_FrameDone.notify_all();
+}
+
+void FramePipeline::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	while(m_Produced != m_Requested)
+		m_FrameDone.wait(lock);
+
+	//The worker is idle now, drop everything that was not rendered
+	m_Acquired = m_Released = m_Produced;
+}
+
+int64_t FramePipeline::ConsumeWaitTicks()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	int64_t ticks = m_WaitTicks;
+	m_WaitTicks = 0;
+	return ticks;
+}
+
+void FramePipeline::WorkerMain()
+{
+	PROFILE_THREAD("Update worker");
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for(;;)
+	{
+		//Finish queued updates before quitting so Stop() leaves consistent state
+		while(!m_Quit && m_Produced == m_Requested)
+			m_WorkReady.wait(lock);
+		if(m_Produced == m_Requested)
+			break;
+
+		unsigned slot = (unsigned)(m_Produced % GetSlotCount());
+		FrameUpdate update = m_SlotUpdates[slot];
+
+		//Kick() never hands out a slot that is still being rendered, so the
+		//update can run without holding the lock
+		lock.unlock();
+		int64_t start = TimerTicks();
+		m_Callback(m_pContext, slot, update);
+		int64_t ticks = TimerTicks() - start;
+		lock.lock();
+
+		m_SlotUpdateTicks[slot] = ticks;
+		++m_Produced;
+		m_FrameDone.notify_all();
+	}
+}
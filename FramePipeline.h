@@ -0,0 +1,87 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Two stage frame pipeline. A worker thread runs the update for
+				frame N into a snapshot slot while the main thread renders the
+				snapshot of frame N - framesInFlight, so a frame costs
+				max(update, render) instead of update + render.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//Simulation of one frame: Steps updates of Dt seconds each, then the snapshot is
+//built at Alpha between the last two steps (1 when every frame is one step)
+struct FrameUpdate
+{
+	float		Dt;
+	unsigned	Steps;
+	float		Alpha;
+};
+
+//Produces the snapshot for one frame into slot (called on the worker thread)
+typedef void (*FrameProduceCallback)(void* pContext, unsigned slot, const FrameUpdate& update);
+
+class FramePipeline
+{
+public:
+	enum { MAX_FRAMES_IN_FLIGHT = 2, MAX_SLOTS = MAX_FRAMES_IN_FLIGHT + 1 };
+
+	FramePipeline();
+	~FramePipeline();
+
+	//Starts the worker thread. framesInFlight (1 or 2) is how many updates may
+	//run ahead of the frame being rendered; one extra slot is used for rendering.
+	bool Start(unsigned framesInFlight, FrameProduceCallback callback, void* pContext);
+	//Waits for queued updates and stops the worker thread
+	void Stop();
+
+	bool IsRunning() const { return m_Worker.joinable(); }
+	unsigned GetFramesInFlight() const { return m_FramesInFlight; }
+	unsigned GetSlotCount() const { return m_FramesInFlight + 1; }
+
+	//Main thread. Queues the update of the next frame, waiting while every slot is in use.
+	void Kick(const FrameUpdate& update);
+	//Main thread. Once framesInFlight updates are queued, waits for the oldest
+	//snapshot and returns its slot and update time (ticks). Returns false while
+	//the pipeline is still filling.
+	bool Acquire(unsigned* pSlot, int64_t* pUpdateTicks);
+	//Main thread. Hands the acquired slot back to the worker.
+	void Release();
+	//Main thread. Waits for queued updates and discards snapshots that were not
+	//rendered, e.g. before device resources they reference are destroyed.
+	void Flush();
+
+	//Ticks the main thread spent waiting on the worker since the last call
+	int64_t ConsumeWaitTicks();
+
+private:
+	//Disallow copying
+	FramePipeline(const FramePipeline&);
+	FramePipeline& operator=(const FramePipeline&);
+
+	void WorkerMain();
+
+	std::thread				m_Worker;
+	std::mutex				m_Mutex;
+	std::condition_variable	m_WorkReady;	//Signaled when an update is queued (or on quit)
+	std::condition_variable	m_FrameDone;	//Signaled when a snapshot is produced
+
+	FrameProduceCallback	m_Callback;
+	void*					m_pContext;
+	unsigned				m_FramesInFlight;
+	bool					m_Quit;
+
+	//Monotonic frame counters, slot = counter % GetSlotCount()
+	uint64_t				m_Requested;
+	uint64_t				m_Produced;
+	uint64_t				m_Acquired;
+	uint64_t				m_Released;
+
+	FrameUpdate				m_SlotUpdates[MAX_SLOTS];
+	int64_t					m_SlotUpdateTicks[MAX_SLOTS];
+	int64_t					m_WaitTicks;
+};
@@ -0,0 +1,200 @@
+#include "FrameReadback.h"
+#include "Timer.h"
+#include "Profiler.h"
+
+FrameReadback::FrameReadback()
+{
+	m_pDevice = NULL;
+	m_pSink = NULL;
+	for(int i = 0; i < MAX_RING; ++i)
+	{
+		m_pSurfaces[i] = NULL;
+		m_Frames[i] = 0;
+	}
+	m_RingSize = 0;
+	m_Oldest = 0;
+	m_InFlight = 0;
+	m_NextFrame = 0;
+	m_Captured = 0;
+	m_Exported = 0;
+	m_Failed = 0;
+	m_Bytes = 0;
+	m_LockTicks = 0;
+	m_SinkTicks = 0;
+	m_FirstTicks = 0;
+	m_LastTicks = 0;
+}
+
+FrameReadback::~FrameReadback()
+{
+	Shutdown();
+}
+
+bool FrameReadback::Init(IRenderDevice* pDevice, IFrameSink* pSink, unsigned ringSize)
+{
+	Shutdown();
+	if(!pDevice || !pSink || ringSize == 0 || ringSize > MAX_RING)
+		return false;
+
+	m_pDevice = pDevice;
+	m_pSink = pSink;
+	m_RingSize = ringSize;
+	if(!CreateSurfaces())
+	{
+		ReleaseSurfaces();
+		m_pDevice = NULL;
+		return false;
+	}
+	return true;
+}
+
+void FrameReadback::Shutdown()
+{
+	if(!m_pDevice)
+		return;
+
+	Finish();
+	ReleaseSurfaces();
+	m_pDevice = NULL;
+	m_pSink = NULL;
+}
+
+bool FrameReadback::Capture()
+{
+	if(!m_pDevice || !m_pSurfaces[0])
+		return false;
+
+	if(m_Captured == 0)
+		m_FirstTicks = TimerTicks();
+
+	unsigned slot = (m_Oldest + m_InFlight) % m_RingSize;
+	if(!m_pDevice->CopyBackBuffer(m_pSurfaces[slot]))
+	{
+		++m_Failed;
+		return false;
+	}
+	m_Frames[slot] = m_NextFrame++;
+	++m_InFlight;
+	++m_Captured;
+
+	//Keep ringSize - 1 frames in flight, the oldest has had that many frames to finish
+	while(m_InFlight > m_RingSize - 1)
+		ExportOldest();
+	return true;
+}
+
+void FrameReadback::Flush()
+{
+	while(m_InFlight > 0)
+		ExportOldest();
+}
+
+bool FrameReadback::Finish()
+{
+	if(!m_pDevice)
+		return true;
+
+	Flush();
+	bool written = m_pSink->Finish();
+	if(m_Exported > 0)
+		m_LastTicks = TimerTicks();
+	return written && m_Failed == 0;
+}
+
+void FrameReadback::OnLostDevice()
+{
+	if(!m_pDevice)
+		return;
+
+	Flush();
+	ReleaseSurfaces();
+}
+
+bool FrameReadback::OnResetDevice()
+{
+	if(!m_pDevice)
+		return true;
+
+	if(!CreateSurfaces())
+	{
+		ReleaseSurfaces();
+		return false;
+	}
+	return true;
+}
+
+void FrameReadback::ExportOldest()
+{
+	IReadbackSurface* pSurface = m_pSurfaces[m_Oldest];
+	unsigned frame = m_Frames[m_Oldest];
+	m_Oldest = (m_Oldest + 1) % m_RingSize;
+	--m_InFlight;
+
+	//Waits for the copy if the GPU has not finished it yet
+	const RDCOLOR* pPixels = NULL;
+	unsigned pitch = 0;
+	int64_t lockStart = TimerTicks();
+	bool locked = false;
+	{
+		PROFILE_ZONE("Lock readback");
+		locked = pSurface->Lock(&pPixels, &pitch);
+	}
+	int64_t sinkStart = TimerTicks();
+	m_LockTicks += sinkStart - lockStart;
+	if(!locked)
+	{
+		++m_Failed;
+		return;
+	}
+
+	bool written = false;
+	{
+		PROFILE_ZONE("Write frame");
+		written = m_pSink->WriteFrame(frame, pPixels, pSurface->GetWidth(), pSurface->GetHeight(), pitch);
+	}
+	pSurface->Unlock();
+	m_LastTicks = TimerTicks();
+	m_SinkTicks += m_LastTicks - sinkStart;
+
+	if(written)
+	{
+		++m_Exported;
+		m_Bytes += (uint64_t)pSurface->GetWidth() * pSurface->GetHeight() * sizeof(RDCOLOR);
+	}
+	else
+		++m_Failed;
+}
+
+bool FrameReadback::CreateSurfaces()
+{
+	for(unsigned i = 0; i < m_RingSize; ++i)
+	{
+		if(!m_pDevice->CreateReadbackSurface(&m_pSurfaces[i]))
+			return false;
+	}
+	m_Oldest = 0;
+	m_InFlight = 0;
+	return true;
+}
+
+void FrameReadback::ReleaseSurfaces()
+{
+	for(int i = 0; i < MAX_RING; ++i)
+		SAFE_RELEASE(m_pSurfaces[i]);
+	m_Oldest = 0;
+	m_InFlight = 0;
+}
+
+ReadbackStats FrameReadback::GetStats() const
+{
+	ReadbackStats stats;
+	stats.Captured = m_Captured;
+	stats.Exported = m_Exported;
+	stats.Failed = m_Failed;
+	stats.Bytes = m_Bytes;
+	stats.LockMs = TicksToMs(m_LockTicks);
+	stats.SinkMs = TicksToMs(m_SinkTicks);
+	double seconds = TicksToMs(m_LastTicks - m_FirstTicks) / 1000.0;
+	stats.ExportFps = m_Exported > 0 && seconds > 0.0 ? m_Exported / seconds : 0.0;
+	return stats;
+}
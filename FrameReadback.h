@@ -0,0 +1,89 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Asynchronous back buffer readback for offscreen rendering.
+				Every captured frame is copied into the next surface of a ring
+				(the copy is queued on the GPU like a draw call) and locked
+				ringSize - 1 frames later, when the GPU is long done with it,
+				so reading frame N overlaps rendering frames N + 1 and N + 2
+				instead of stalling the pipeline. Locked frames go to an
+				IFrameSink (see FrameSink.h).
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "FrameSink.h"
+
+#include <stdint.h>
+
+struct ReadbackStats
+{
+	unsigned	Captured;		//Back buffer copies queued
+	unsigned	Exported;		//Frames the sink accepted
+	unsigned	Failed;			//Copies or locks the device refused, frames the sink rejected
+	uint64_t	Bytes;			//Pixel bytes handed to the sink
+	double		LockMs;			//Time spent in Lock(), waiting for copies
+	double		SinkMs;			//Time spent in WriteFrame()
+	double		ExportFps;		//Exported frames over the time from the first capture until they were written
+};
+
+class FrameReadback
+{
+public:
+	enum { MAX_RING = 8 };
+
+	FrameReadback();
+	~FrameReadback();
+
+	//Creates ringSize surfaces the size of the back buffer. With ringSize 1
+	//every frame is read back right away (a pipeline stall per frame).
+	bool Init(IRenderDevice* pDevice, IFrameSink* pSink, unsigned ringSize = 3);
+	//Finishes the frames in flight and releases the surfaces
+	void Shutdown();
+	bool IsActive() const { return m_pDevice != NULL; }
+
+	//After the frame is rendered: queues the copy of the back buffer, and
+	//exports the oldest frame once ringSize - 1 newer ones are in flight
+	bool Capture();
+	//Exports every frame in flight
+	void Flush();
+	//Exports every frame in flight and waits for the sink to write them (end
+	//of a run), false if any frame was lost
+	bool Finish();
+
+	//Surfaces are not restored by a device reset: flush and release them
+	//before it, then create them again (the back buffer size may differ)
+	void OnLostDevice();
+	bool OnResetDevice();
+
+	ReadbackStats GetStats() const;
+
+private:
+	//Disallow copying
+	FrameReadback(const FrameReadback&);
+	FrameReadback& operator=(const FrameReadback&);
+
+	//Locks the oldest frame in flight and hands it to the sink
+	void ExportOldest();
+	bool CreateSurfaces();
+	void ReleaseSurfaces();
+
+	IRenderDevice*		m_pDevice;
+	IFrameSink*			m_pSink;
+	IReadbackSurface*	m_pSurfaces[MAX_RING];
+	unsigned			m_Frames[MAX_RING];		//Frame number copied into each surface
+	unsigned			m_RingSize;
+	unsigned			m_Oldest;				//Surface of the oldest frame in flight
+	unsigned			m_InFlight;				//Frames copied, not exported yet
+	unsigned			m_NextFrame;			//Number of the next captured frame
+
+	//Statistics
+	unsigned			m_Captured;
+	unsigned			m_Exported;
+	unsigned			m_Failed;
+	uint64_t			m_Bytes;
+	int64_t				m_LockTicks;
+	int64_t				m_SinkTicks;
+	int64_t				m_FirstTicks;			//First capture
+	int64_t				m_LastTicks;			//Last export, or when the sink finished writing it
+};
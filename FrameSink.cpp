@@ -0,0 +1,577 @@
+#include "FrameSink.h"
+#include "Profiler.h"
+
+#include <string.h>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+namespace
+{
+	//Writes the rows of a frame as BGRA bytes (the memory layout of RDCOLOR)
+	bool WriteRawFrame(FILE* f, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+	{
+		if(pitch == width)
+			return fwrite(pPixels, (size_t)width * height * sizeof(RDCOLOR), 1, f) == 1;
+
+		for(unsigned y = 0; y < height; ++y)
+		{
+			if(fwrite(pPixels + (size_t)y * pitch, width * sizeof(RDCOLOR), 1, f) != 1)
+				return false;
+		}
+		return true;
+	}
+
+	//PNG chunk checksums
+	struct Crc32Table
+	{
+		Crc32Table()
+		{
+			for(uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t c = i;
+				for(int k = 0; k < 8; ++k)
+					c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				Table[i] = c;
+			}
+		}
+
+		uint32_t Compute(const uint8_t* pData, size_t size) const
+		{
+			uint32_t c = 0xFFFFFFFFu;
+			for(size_t i = 0; i < size; ++i)
+				c = Table[(c ^ pData[i]) & 0xFF] ^ (c >> 8);
+			return c ^ 0xFFFFFFFFu;
+		}
+
+		uint32_t Table[256];
+	};
+
+	//Deflate fixed Huffman codes, bit reversed for the LSB first bit stream
+	struct FixedHuffman
+	{
+		FixedHuffman()
+		{
+			for(unsigned v = 0; v < 288; ++v)
+			{
+				unsigned code, length;
+				if(v < 144) { code = 0x30 + v; length = 8; }
+				else if(v < 256) { code = 0x190 + v - 144; length = 9; }
+				else if(v < 280) { code = v - 256; length = 7; }
+				else { code = 0xC0 + v - 280; length = 8; }
+				LiteralCode[v] = (uint16_t)Reverse(code, length);
+				LiteralLength[v] = (uint8_t)length;
+			}
+			for(unsigned v = 0; v < 30; ++v)
+				DistanceCode[v] = (uint8_t)Reverse(v, 5);
+
+			//Length 3 to 258 to its symbol (257 + index)
+			unsigned symbol = 0;
+			for(unsigned length = 3; length <= 258; ++length)
+			{
+				while(symbol < 28 && length >= LENGTH_BASE[symbol + 1])
+					++symbol;
+				LengthSymbol[length] = (uint8_t)symbol;
+			}
+		}
+
+		static unsigned Reverse(unsigned code, unsigned length)
+		{
+			unsigned reversed = 0;
+			for(unsigned i = 0; i < length; ++i)
+				reversed |= ((code >> i) & 1) << (length - 1 - i);
+			return reversed;
+		}
+
+		static const uint16_t LENGTH_BASE[29];
+		static const uint8_t LENGTH_EXTRA[29];
+		static const uint16_t DISTANCE_BASE[30];
+		static const uint8_t DISTANCE_EXTRA[30];
+
+		uint16_t	LiteralCode[288];
+		uint8_t		LiteralLength[288];
+		uint8_t		DistanceCode[30];
+		uint8_t		LengthSymbol[259];
+	};
+
+	const uint16_t FixedHuffman::LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8_t FixedHuffman::LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const uint16_t FixedHuffman::DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8_t FixedHuffman::DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	//Built before main(), so encoder threads never race to initialize them
+	const Crc32Table g_Crc;
+	const FixedHuffman g_Huffman;
+
+	//Deflate bit stream (least significant bit first)
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t>& out) : m_Out(out), m_Bits(0), m_Count(0) {}
+
+		void Put(uint32_t value, unsigned count)
+		{
+			m_Bits |= value << m_Count;
+			m_Count += count;
+			while(m_Count >= 8)
+			{
+				m_Out.push_back((uint8_t)m_Bits);
+				m_Bits >>= 8;
+				m_Count -= 8;
+			}
+		}
+
+		void Literal(unsigned value) { Put(g_Huffman.LiteralCode[value], g_Huffman.LiteralLength[value]); }
+
+		void Match(unsigned length, unsigned distance)
+		{
+			unsigned symbol = g_Huffman.LengthSymbol[length];
+			Literal(257 + symbol);
+			Put(length - FixedHuffman::LENGTH_BASE[symbol], FixedHuffman::LENGTH_EXTRA[symbol]);
+
+			unsigned code = 0;
+			while(code < 29 && distance >= FixedHuffman::DISTANCE_BASE[code + 1])
+				++code;
+			Put(g_Huffman.DistanceCode[code], 5);
+			Put(distance - FixedHuffman::DISTANCE_BASE[code], FixedHuffman::DISTANCE_EXTRA[code]);
+		}
+
+		void Flush()
+		{
+			if(m_Count > 0)
+				m_Out.push_back((uint8_t)m_Bits);
+			m_Bits = 0;
+			m_Count = 0;
+		}
+
+	private:
+		BitWriter& operator=(const BitWriter&);
+
+		std::vector<uint8_t>&	m_Out;
+		uint32_t				m_Bits;
+		unsigned				m_Count;
+	};
+
+	uint32_t Adler32(const uint8_t* pData, size_t size)
+	{
+		uint32_t a = 1, b = 0;
+		while(size > 0)
+		{
+			//Largest block whose sums cannot overflow before the modulo
+			size_t block = std::min(size, (size_t)5552);
+			for(size_t i = 0; i < block; ++i)
+			{
+				a += pData[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			pData += block;
+			size -= block;
+		}
+		return (b << 16) | a;
+	}
+
+	void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back((uint8_t)(value >> 24));
+		out.push_back((uint8_t)(value >> 16));
+		out.push_back((uint8_t)(value >> 8));
+		out.push_back((uint8_t)value);
+	}
+
+	//zlib stream of one fixed Huffman block. Greedy LZ77 matching against the
+	//last position of every 3 byte hash, which finds the long runs of rendered
+	//frames (flat areas become zeros after the Sub filter) at a low cost.
+	void Deflate(const uint8_t* pData, size_t size, std::vector<uint8_t>& out, std::vector<int>& hash)
+	{
+		const unsigned HASH_BITS = 15;
+		const size_t WINDOW = 32768;
+		const size_t MAX_MATCH = 258;
+		hash.assign((size_t)1 << HASH_BITS, -1);
+
+		out.push_back(0x78); //Deflate, 32K window
+		out.push_back(0x01); //Fastest compression, header checksum
+		BitWriter bits(out);
+		bits.Put(1, 1); //Final block
+		bits.Put(1, 2); //Fixed Huffman codes
+
+		size_t i = 0;
+		while(i < size)
+		{
+			size_t length = 0;
+			size_t distance = 0;
+			if(i + 3 <= size)
+			{
+				unsigned h = ((pData[i] << 10) ^ (pData[i + 1] << 5) ^ pData[i + 2]) & ((1u << HASH_BITS) - 1);
+				int candidate = hash[h];
+				hash[h] = (int)i;
+				if(candidate >= 0 && i - candidate <= WINDOW && memcmp(pData + candidate, pData + i, 3) == 0)
+				{
+					size_t maxLength = std::min(MAX_MATCH, size - i);
+					length = 3;
+					while(length < maxLength && pData[candidate + length] == pData[i + length])
+						++length;
+					distance = i - candidate;
+				}
+			}
+
+			if(length == 0)
+			{
+				bits.Literal(pData[i]);
+				++i;
+				continue;
+			}
+
+			bits.Match((unsigned)length, (unsigned)distance);
+			//Positions inside the match become candidates too
+			size_t end = i + length;
+			for(++i; i < end && i + 3 <= size; ++i)
+				hash[((pData[i] << 10) ^ (pData[i + 1] << 5) ^ pData[i + 2]) & ((1u << HASH_BITS) - 1)] = (int)i;
+			i = end;
+		}
+		bits.Literal(256); //End of block
+		bits.Flush();
+
+		PutBigEndian(out, Adler32(pData, size));
+	}
+
+	//Appends a chunk whose data is out[start + 8, end), filling in length and checksum
+	void FinishChunk(std::vector<uint8_t>& out, size_t start)
+	{
+		uint32_t length = (uint32_t)(out.size() - start - 8);
+		out[start + 0] = (uint8_t)(length >> 24);
+		out[start + 1] = (uint8_t)(length >> 16);
+		out[start + 2] = (uint8_t)(length >> 8);
+		out[start + 3] = (uint8_t)length;
+		PutBigEndian(out, g_Crc.Compute(&out[start + 4], length + 4));
+	}
+
+	void BeginChunk(std::vector<uint8_t>& out, const char* pType)
+	{
+		PutBigEndian(out, 0);
+		out.insert(out.end(), pType, pType + 4);
+	}
+
+	void EncodePNG(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch,
+		std::vector<uint8_t>& out, ImageEncoderScratch& scratch)
+	{
+		//Scanlines with the Sub filter: every byte minus the same byte of the pixel to its left
+		size_t rowBytes = 1 + (size_t)width * 3;
+		scratch.Filtered.resize(rowBytes * height);
+		for(unsigned y = 0; y < height; ++y)
+		{
+			const RDCOLOR* pRow = pPixels + (size_t)y * pitch;
+			uint8_t* pOut = &scratch.Filtered[y * rowBytes];
+			*pOut++ = 1;
+			RDCOLOR left = 0;
+			for(unsigned x = 0; x < width; ++x)
+			{
+				RDCOLOR c = pRow[x];
+				*pOut++ = (uint8_t)((c >> 16) - (left >> 16));
+				*pOut++ = (uint8_t)((c >> 8) - (left >> 8));
+				*pOut++ = (uint8_t)(c - left);
+				left = c;
+			}
+		}
+
+		static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		out.insert(out.end(), SIGNATURE, SIGNATURE + 8);
+
+		size_t start = out.size();
+		BeginChunk(out, "IHDR");
+		PutBigEndian(out, width);
+		PutBigEndian(out, height);
+		out.push_back(8); //Bits per channel
+		out.push_back(2); //RGB
+		out.push_back(0); //Deflate
+		out.push_back(0); //Adaptive filtering
+		out.push_back(0); //Not interlaced
+		FinishChunk(out, start);
+
+		start = out.size();
+		BeginChunk(out, "IDAT");
+		Deflate(&scratch.Filtered[0], scratch.Filtered.size(), out, scratch.Hash);
+		FinishChunk(out, start);
+
+		start = out.size();
+		BeginChunk(out, "IEND");
+		FinishChunk(out, start);
+	}
+
+	void EncodePPM(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch, std::vector<uint8_t>& out)
+	{
+		char header[64];
+		int length = sprintf(header, "P6\n%u %u\n255\n", width, height);
+		out.insert(out.end(), header, header + length);
+
+		size_t start = out.size();
+		out.resize(start + (size_t)width * height * 3);
+		uint8_t* pOut = &out[start];
+		for(unsigned y = 0; y < height; ++y)
+		{
+			const RDCOLOR* pRow = pPixels + (size_t)y * pitch;
+			for(unsigned x = 0; x < width; ++x)
+			{
+				*pOut++ = (uint8_t)(pRow[x] >> 16);
+				*pOut++ = (uint8_t)(pRow[x] >> 8);
+				*pOut++ = (uint8_t)pRow[x];
+			}
+		}
+	}
+
+	bool WriteFile(const char* pPath, const std::vector<uint8_t>& data)
+	{
+		FILE* f = fopen(pPath, "wb");
+		if(!f)
+			return false;
+		bool written = data.empty() || fwrite(&data[0], data.size(), 1, f) == 1;
+		return fclose(f) == 0 && written;
+	}
+}
+
+void EncodeImage(ImageFormat format, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch,
+	std::vector<uint8_t>& out, ImageEncoderScratch& scratch)
+{
+	out.clear();
+	if(format == IMAGE_PNG)
+		EncodePNG(pPixels, width, height, pitch, out, scratch);
+	else
+		EncodePPM(pPixels, width, height, pitch, out);
+}
+
+bool WriteImageFile(const char* pPath, ImageFormat format, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+{
+	std::vector<uint8_t> data;
+	ImageEncoderScratch scratch;
+	EncodeImage(format, pPixels, width, height, pitch, data, scratch);
+	return WriteFile(pPath, data);
+}
+
+RawFileSink::RawFileSink()
+{
+	m_pFile = NULL;
+	m_Failed = false;
+}
+
+RawFileSink::~RawFileSink()
+{
+	if(m_pFile)
+		fclose(m_pFile);
+}
+
+bool RawFileSink::Open(const char* pPath)
+{
+	m_pFile = fopen(pPath, "wb");
+	m_Failed = false;
+	return m_pFile != NULL;
+}
+
+bool RawFileSink::WriteFrame(unsigned, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+{
+	if(!m_pFile || !WriteRawFrame(m_pFile, pPixels, width, height, pitch))
+		m_Failed = true;
+	return !m_Failed;
+}
+
+bool RawFileSink::Finish()
+{
+	if(m_pFile && fflush(m_pFile) != 0)
+		m_Failed = true;
+	return m_pFile && !m_Failed;
+}
+
+PipeSink::PipeSink()
+{
+	m_pPipe = NULL;
+	m_Failed = false;
+}
+
+PipeSink::~PipeSink()
+{
+	Finish();
+}
+
+bool PipeSink::Open(const char* pCommand)
+{
+	m_Failed = false;
+#ifdef _WIN32
+	m_pPipe = _popen(pCommand, "wb");
+#else
+	//A command that exits early makes writes fail instead of killing the process
+	signal(SIGPIPE, SIG_IGN);
+	m_pPipe = popen(pCommand, "w");
+#endif
+	return m_pPipe != NULL;
+}
+
+bool PipeSink::WriteFrame(unsigned, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+{
+	if(!m_pPipe || !WriteRawFrame(m_pPipe, pPixels, width, height, pitch))
+		m_Failed = true;
+	return !m_Failed;
+}
+
+bool PipeSink::Finish()
+{
+	if(!m_pPipe)
+		return false;
+
+#ifdef _WIN32
+	int status = _pclose(m_pPipe);
+#else
+	int status = pclose(m_pPipe);
+#endif
+	m_pPipe = NULL;
+	if(status != 0)
+		m_Failed = true;
+	return !m_Failed;
+}
+
+ImageFileSink::ImageFileSink() : m_Failed(false)
+{
+	m_Format = IMAGE_PNG;
+	m_Busy = 0;
+	m_Stop = false;
+	m_Stalls = 0;
+}
+
+ImageFileSink::~ImageFileSink()
+{
+	Shutdown();
+}
+
+bool ImageFileSink::Init(const char* pPrefix, ImageFormat format, unsigned threads, unsigned queuedFrames)
+{
+	Shutdown();
+	if(threads == 0 || queuedFrames == 0)
+		return false;
+
+	m_Prefix = pPrefix;
+	m_Format = format;
+	m_Stop = false;
+	m_Failed = false;
+	m_Stalls = 0;
+
+	//The pool never grows, so the pointers to its frames stay valid
+	m_Frames.resize(queuedFrames);
+	for(size_t i = 0; i < m_Frames.size(); ++i)
+		m_Free.push_back(&m_Frames[i]);
+
+	for(unsigned i = 0; i < threads; ++i)
+		m_Threads.push_back(std::thread(&ImageFileSink::EncoderThreadMain, this));
+	return true;
+}
+
+void ImageFileSink::Shutdown()
+{
+	if(m_Threads.empty())
+		return;
+
+	//The encoders finish the queued frames before they exit
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Stop = true;
+	}
+	m_Wake.notify_all();
+	for(size_t i = 0; i < m_Threads.size(); ++i)
+		m_Threads[i].join();
+	m_Threads.clear();
+
+	m_Free.clear();
+	m_Frames.clear();
+}
+
+bool ImageFileSink::WriteFrame(unsigned frame, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+{
+	if(m_Threads.empty())
+		return false;
+
+	Frame* pFrame = NULL;
+	{
+		std::unique_lock<std::mutex> lock(m_Lock);
+		if(m_Free.empty())
+		{
+			//The encoders fell behind, wait for one of them
+			PROFILE_ZONE("Wait for encoder");
+			++m_Stalls;
+			while(m_Free.empty())
+				m_Done.wait(lock);
+		}
+		pFrame = m_Free.back();
+		m_Free.pop_back();
+	}
+
+	//Pool buffers keep their memory, only the first frames (or a new size) allocate
+	pFrame->Pixels.resize((size_t)width * height);
+	for(unsigned y = 0; y < height; ++y)
+		memcpy(&pFrame->Pixels[(size_t)y * width], pPixels + (size_t)y * pitch, width * sizeof(RDCOLOR));
+	pFrame->Number = frame;
+	pFrame->Width = width;
+	pFrame->Height = height;
+
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Queue.push_back(pFrame);
+	}
+	m_Wake.notify_one();
+	return !m_Failed.load(std::memory_order_relaxed);
+}
+
+bool ImageFileSink::Finish()
+{
+	std::unique_lock<std::mutex> lock(m_Lock);
+	while(!m_Queue.empty() || m_Busy > 0)
+		m_Done.wait(lock);
+	return !m_Failed.load(std::memory_order_relaxed);
+}
+
+void ImageFileSink::EncoderThreadMain()
+{
+	PROFILE_THREAD("Image encoder");
+
+	//Work buffers live as long as the thread
+	ImageEncoderScratch scratch;
+	std::vector<uint8_t> data;
+	std::string path;
+	char number[16];
+	for(;;)
+	{
+		Frame* pFrame = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_Lock);
+			while(!m_Stop && m_Queue.empty())
+				m_Wake.wait(lock);
+			if(m_Queue.empty())
+				return;
+			pFrame = m_Queue.front();
+			m_Queue.pop_front();
+			++m_Busy;
+		}
+
+		{
+			PROFILE_ZONE("Encode frame");
+			sprintf(number, "%06u", pFrame->Number);
+			path = m_Prefix;
+			path += number;
+			path += m_Format == IMAGE_PNG ? ".png" : ".ppm";
+
+			EncodeImage(m_Format, &pFrame->Pixels[0], pFrame->Width, pFrame->Height, pFrame->Width, data, scratch);
+			if(!WriteFile(path.c_str(), data))
+				m_Failed.store(true, std::memory_order_relaxed);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			--m_Busy;
+			m_Free.push_back(pFrame);
+		}
+		m_Done.notify_all();
+	}
+}
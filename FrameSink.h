@@ -0,0 +1,152 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Destinations for frames read back from the rendering device
+				(see FrameReadback): raw video to a file or the standard input
+				of an encoder process, or one PPM/PNG image per frame. Image
+				files are encoded on their own worker threads; when they fall
+				behind, WriteFrame() blocks until a buffer is free, so memory
+				use is bounded and the export rate is what the encoders sustain.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class IFrameSink
+{
+public:
+	virtual ~IFrameSink() {}
+
+	//Called on the render thread for every exported frame, in order. Pixels are
+	//32 bit XRGB with the pitch in pixels, valid only during the call.
+	virtual bool WriteFrame(unsigned frame, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) = 0;
+	//Waits until every frame is written, false if any of them failed
+	virtual bool Finish() = 0;
+};
+
+//Drops every frame (measures the readback alone)
+class NullFrameSink : public IFrameSink
+{
+public:
+	bool WriteFrame(unsigned, const RDCOLOR*, unsigned, unsigned, unsigned) override { return true; }
+	bool Finish() override { return true; }
+};
+
+//Appends frames to one file as raw BGRA rows, for example for
+//ffmpeg -f rawvideo -pix_fmt bgra -s 1280x720 -r 60 -i frames.raw out.mp4
+class RawFileSink : public IFrameSink
+{
+public:
+	RawFileSink();
+	~RawFileSink();
+
+	bool Open(const char* pPath);
+
+	bool WriteFrame(unsigned frame, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) override;
+	bool Finish() override;
+
+private:
+	//Disallow copying
+	RawFileSink(const RawFileSink&);
+	RawFileSink& operator=(const RawFileSink&);
+
+	FILE*	m_pFile;
+	bool	m_Failed;
+};
+
+//Writes raw BGRA frames to the standard input of a command, for example
+//ffmpeg -y -f rawvideo -pix_fmt bgra -s 1280x720 -r 60 -i - out.mp4
+class PipeSink : public IFrameSink
+{
+public:
+	PipeSink();
+	~PipeSink();
+
+	bool Open(const char* pCommand);
+
+	bool WriteFrame(unsigned frame, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) override;
+	//Closes the pipe and waits for the command to exit, false if it failed
+	bool Finish() override;
+
+private:
+	//Disallow copying
+	PipeSink(const PipeSink&);
+	PipeSink& operator=(const PipeSink&);
+
+	FILE*	m_pPipe;
+	bool	m_Failed;
+};
+
+enum ImageFormat
+{
+	IMAGE_PPM,		//Binary PPM (P6), no compression
+	IMAGE_PNG		//24 bit PNG, Sub filtered and deflated with fixed Huffman codes
+};
+
+//Encodes an image in memory. scratch keeps the encoder's work buffers between calls.
+struct ImageEncoderScratch
+{
+	std::vector<uint8_t>	Filtered;		//Filtered scanlines (PNG)
+	std::vector<int>		Hash;			//Last position of every 3 byte hash (PNG)
+};
+void EncodeImage(ImageFormat format, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch,
+	std::vector<uint8_t>& out, ImageEncoderScratch& scratch);
+//Encodes and writes one image file
+bool WriteImageFile(const char* pPath, ImageFormat format, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch);
+
+//Writes every frame to <prefix><frame number, 6 digits>.ppm or .png
+class ImageFileSink : public IFrameSink
+{
+public:
+	ImageFileSink();
+	~ImageFileSink();
+
+	//Starts the encoder threads. queuedFrames frames can wait for them before WriteFrame() blocks.
+	bool Init(const char* pPrefix, ImageFormat format, unsigned threads = 2, unsigned queuedFrames = 4);
+	void Shutdown();
+
+	bool WriteFrame(unsigned frame, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) override;
+	bool Finish() override;
+
+	//WriteFrame() calls that had to wait for an encoder
+	unsigned GetStalls() const { return m_Stalls; }
+
+private:
+	//Disallow copying
+	ImageFileSink(const ImageFileSink&);
+	ImageFileSink& operator=(const ImageFileSink&);
+
+	struct Frame
+	{
+		std::vector<RDCOLOR>	Pixels;		//Tightly packed copy
+		unsigned				Number;
+		unsigned				Width;
+		unsigned				Height;
+	};
+
+	void EncoderThreadMain();
+
+	std::string					m_Prefix;
+	ImageFormat					m_Format;
+	std::vector<Frame>			m_Frames;		//Buffer pool
+	std::vector<Frame*>			m_Free;
+	std::deque<Frame*>			m_Queue;		//Waiting for an encoder
+	unsigned					m_Busy;			//Frames being encoded
+	std::vector<std::thread>	m_Threads;
+	std::mutex					m_Lock;
+	std::condition_variable		m_Wake;			//Frames queued, or stopping
+	std::condition_variable		m_Done;			//A buffer was freed
+	bool						m_Stop;
+	std::atomic<bool>			m_Failed;
+	unsigned					m_Stalls;
+};
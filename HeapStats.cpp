@@ -0,0 +1,89 @@
+#include "HeapStats.h"
+
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+
+namespace
+{
+	std::atomic<uint64_t> g_Allocations(0);
+	std::atomic<uint64_t> g_Frees(0);
+	std::atomic<uint64_t> g_Bytes(0);
+}
+
+HeapCounters GetHeapCounters()
+{
+	HeapCounters counters;
+	counters.Allocations = g_Allocations.load(std::memory_order_relaxed);
+	counters.Frees = g_Frees.load(std::memory_order_relaxed);
+	counters.Bytes = g_Bytes.load(std::memory_order_relaxed);
+	return counters;
+}
+
+#ifndef HEAPSTATS_DISABLED
+
+namespace
+{
+	void* CountedAlloc(size_t size)
+	{
+		g_Allocations.fetch_add(1, std::memory_order_relaxed);
+		g_Bytes.fetch_add(size, std::memory_order_relaxed);
+		return malloc(size ? size : 1);
+	}
+
+	void CountedFree(void* p)
+	{
+		if(!p)
+			return;
+		g_Frees.fetch_add(1, std::memory_order_relaxed);
+		free(p);
+	}
+}
+
+void* operator new(size_t size)
+{
+	void* p = CountedAlloc(size);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = CountedAlloc(size);
+	if(!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+	return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+	return CountedAlloc(size);
+}
+
+void operator delete(void* p) throw()
+{
+	CountedFree(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	CountedFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+	CountedFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+	CountedFree(p);
+}
+
+#endif
@@ -0,0 +1,21 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Heap allocation counters. HeapStats.cpp replaces the global
+				operator new/delete to count allocations from every thread, so
+				the frame loop can report how many heap allocations it made.
+				Define HEAPSTATS_DISABLED to keep the default operators.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+struct HeapCounters
+{
+	uint64_t Allocations;	//Calls to operator new since startup
+	uint64_t Frees;			//Calls to operator delete (non NULL) since startup
+	uint64_t Bytes;			//Bytes requested since startup
+};
+
+//Snapshot of the counters (all zero when HEAPSTATS_DISABLED is defined)
+HeapCounters GetHeapCounters();
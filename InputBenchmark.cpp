@@ -0,0 +1,289 @@
+#include "InputBenchmark.h"
+#include "InputState.h"
+#include "FramePacer.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const unsigned RING_EVENTS = 4000000;
+
+	//Latency runs
+	const unsigned INPUT_HZ = 1000;
+	const double TARGET_FPS = 120.0;
+	const double WORK_MS = 2.0;			//Stand in for Update and Render
+	const unsigned FRAMES = 120;
+
+	//The ring before it was lock free, for comparison
+	class LockedQueue
+	{
+	public:
+		LockedQueue() : m_Head(0), m_Tail(0) {}
+
+		bool Push(const PlatformEvent& e)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if(m_Tail - m_Head == EventQueue::CAPACITY)
+				return false;
+			m_Events[m_Tail++ & (EventQueue::CAPACITY - 1)] = e;
+			return true;
+		}
+
+		bool Pop(PlatformEvent* pEvent)
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if(m_Head == m_Tail)
+				return false;
+			*pEvent = m_Events[m_Head++ & (EventQueue::CAPACITY - 1)];
+			return true;
+		}
+
+	private:
+		std::mutex		m_Mutex;
+		PlatformEvent	m_Events[EventQueue::CAPACITY];
+		unsigned		m_Head;
+		unsigned		m_Tail;
+	};
+
+	struct RingResult
+	{
+		double		Ms;
+		uint64_t	FullRetries;	//Pushes that found the ring full
+		bool		InOrder;
+	};
+
+	template<class Queue>
+	void Produce(Queue* pQueue, uint64_t* pRetries)
+	{
+		PlatformEvent e;
+		memset(&e, 0, sizeof(e));
+		e.Type = PE_MOUSE_MOVE;
+		uint64_t retries = 0;
+		for(unsigned i = 0; i < RING_EVENTS; ++i)
+		{
+			e.X = (int)i;
+			while(!pQueue->Push(e))
+			{
+				++retries;
+				std::this_thread::yield();
+			}
+		}
+		*pRetries = retries;
+	}
+
+	//Producer thread against the consumer on this thread
+	template<class Queue>
+	RingResult RunRing(Queue* pQueue)
+	{
+		RingResult result;
+		result.InOrder = true;
+		int64_t start = TimerTicks();
+		std::thread producer(Produce<Queue>, pQueue, &result.FullRetries);
+		PlatformEvent e;
+		for(unsigned next = 0; next < RING_EVENTS; )
+		{
+			if(!pQueue->Pop(&e))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			result.InOrder = result.InOrder && e.X == (int)next;
+			++next;
+		}
+		producer.join();
+		result.Ms = TicksToMs(TimerTicks() - start);
+		return result;
+	}
+
+	PlatformEvent MakeEvent(PlatformEventType type, unsigned key, int x = 0, int y = 0)
+	{
+		PlatformEvent e;
+		e.Type = type;
+		e.Key = key;
+		e.X = x;
+		e.Y = y;
+		e.Ticks = TimerTicks();
+		return e;
+	}
+
+	//Scripted frames against the snapshots they must produce
+	bool CheckSnapshots()
+	{
+		InputTracker tracker;
+		InputState s;
+		bool ok = true;
+
+		//Tap within one frame, a held key with repeats, a click with movement
+		tracker.Apply(MakeEvent(PE_KEY_DOWN, KEY_SPACE));
+		tracker.Apply(MakeEvent(PE_KEY_UP, KEY_SPACE));
+		tracker.Apply(MakeEvent(PE_KEY_DOWN, 'W'));
+		tracker.Apply(MakeEvent(PE_MOUSE_MOVE, 0, 10, 10));
+		tracker.Apply(MakeEvent(PE_MOUSE_DOWN, MOUSE_LEFT, 14, 7));
+		tracker.Apply(MakeEvent(PE_RESIZE, 0, 640, 480));
+		tracker.TakeSnapshot(TimerTicks(), &s);
+		ok = ok && s.WasPressed(KEY_SPACE) && s.WasReleased(KEY_SPACE) && !s.IsDown(KEY_SPACE);
+		ok = ok && s.IsDown('W') && s.WasPressed('W') && s.IsButtonDown(MOUSE_LEFT) && s.WasButtonPressed(MOUSE_LEFT);
+		ok = ok && s.MouseX == 14 && s.MouseY == 7 && s.MouseDX == 4 && s.MouseDY == -3 && s.Events == 5 && s.OldestEventTicks != 0;
+
+		tracker.Apply(MakeEvent(PE_KEY_DOWN, 'W'));
+		tracker.Apply(MakeEvent(PE_MOUSE_RAW, 0, 3, -2));
+		tracker.Apply(MakeEvent(PE_MOUSE_RAW, 0, 2, -1));
+		tracker.TakeSnapshot(TimerTicks(), &s);
+		ok = ok && s.IsDown('W') && !s.WasPressed('W') && !s.WasPressed(KEY_SPACE) && s.MouseDX == 0;
+		ok = ok && s.RawDX == 5 && s.RawDY == -3 && s.IsButtonDown(MOUSE_LEFT) && !s.WasButtonPressed(MOUSE_LEFT);
+
+		//A peek shows the press, and the next snapshot still has it
+		tracker.Apply(MakeEvent(PE_KEY_DOWN, KEY_SPACE));
+		tracker.PeekSnapshot(TimerTicks(), &s);
+		ok = ok && s.IsDown(KEY_SPACE) && s.WasPressed(KEY_SPACE);
+		tracker.TakeSnapshot(TimerTicks(), &s);
+		ok = ok && s.IsDown(KEY_SPACE) && s.WasPressed(KEY_SPACE) && s.Events == 1;
+		tracker.Apply(MakeEvent(PE_KEY_UP, KEY_SPACE));
+
+		//Losing the focus releases everything held
+		tracker.Apply(MakeEvent(PE_DEACTIVATE, 0));
+		tracker.TakeSnapshot(TimerTicks(), &s);
+		ok = ok && !s.IsDown('W') && s.WasReleased('W') && !s.IsButtonDown(MOUSE_LEFT);
+
+		tracker.TakeSnapshot(TimerTicks(), &s);
+		ok = ok && s.Events == 0 && s.OldestEventTicks == 0 && !s.WasReleased('W');
+		return ok;
+	}
+
+	//Mouse moves at INPUT_HZ, stamped when they are generated
+	void ProduceInput(EventQueue* pQueue, std::atomic<bool>* pStop)
+	{
+		int64_t period = TimerFrequency() / INPUT_HZ;
+		int64_t next = TimerTicks();
+		int step = 0;
+		while(!*pStop)
+		{
+			if(TimerTicks() < next)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				continue;
+			}
+			PlatformEvent e = MakeEvent(PE_MOUSE_MOVE, 0, step, step);
+			++step;
+			pQueue->Push(e);
+			next += period;
+		}
+	}
+
+	enum SampleMode
+	{
+		SAMPLE_BEFORE_WAIT,		//Input read, then the pacing wait
+		SAMPLE_AFTER_WAIT,		//Pacing wait, then input read (DXApp::Run)
+		SAMPLE_PIPELINED		//After the wait, presented one frame later
+	};
+
+	struct LatencyResult
+	{
+		double	MeanMs;
+		double	P95Ms;
+		double	MaxMs;
+		double	EventsPerFrame;
+	};
+
+	LatencyResult RunLatency(SampleMode mode)
+	{
+		EventQueue queue;
+		std::atomic<bool> stop(false);
+		std::thread producer(ProduceInput, &queue, &stop);
+
+		FramePacer pacer;
+		pacer.SetTarget(TARGET_FPS, PACING_LATENCY);
+		pacer.Start();
+		InputTracker tracker;
+		InputState snapshots[2];
+		memset(snapshots, 0, sizeof(snapshots));
+		std::vector<double> latencies;
+		latencies.reserve(FRAMES);
+		unsigned events = 0;
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			InputState& current = snapshots[frame & 1];
+			if(mode == SAMPLE_BEFORE_WAIT)
+			{
+				tracker.Drain(&queue);
+				tracker.TakeSnapshot(TimerTicks(), &current);
+				pacer.WaitForFrame();
+			}
+			else
+			{
+				pacer.WaitForFrame();
+				tracker.Drain(&queue);
+				tracker.TakeSnapshot(TimerTicks(), &current);
+			}
+			events += current.Events;
+
+			int64_t start = TimerTicks();
+			while(TicksToMs(TimerTicks() - start) < WORK_MS) {}
+
+			//Present
+			const InputState& shown = mode == SAMPLE_PIPELINED ? snapshots[(frame + 1) & 1] : current;
+			if(frame > 0 && shown.OldestEventTicks != 0)
+				latencies.push_back(TicksToMs(TimerTicks() - shown.OldestEventTicks));
+		}
+		stop = true;
+		producer.join();
+
+		LatencyResult result;
+		memset(&result, 0, sizeof(result));
+		std::sort(latencies.begin(), latencies.end());
+		for(size_t i = 0; i < latencies.size(); ++i)
+			result.MeanMs += latencies[i];
+		if(!latencies.empty())
+		{
+			result.MeanMs /= latencies.size();
+			result.P95Ms = latencies[(latencies.size() - 1) * 95 / 100];
+			result.MaxMs = latencies.back();
+		}
+		result.EventsPerFrame = (double)events / FRAMES;
+		return result;
+	}
+}
+
+bool RunInputBenchmarks(FILE* pOut)
+{
+	bool ok = true;
+
+	fprintf(pOut, "Event ring, %u events from a producer thread\n", RING_EVENTS);
+	EventQueue lockFree;
+	RingResult lockFreeResult = RunRing(&lockFree);
+	fprintf(pOut, "Lock free      %8.2f ms, %6.1f M events/s, %llu full retries%s\n", lockFreeResult.Ms,
+		RING_EVENTS / lockFreeResult.Ms / 1000.0, (unsigned long long)lockFreeResult.FullRetries,
+		lockFreeResult.InOrder ? "" : "  OUT OF ORDER");
+	LockedQueue locked;
+	RingResult mutex = RunRing(&locked);
+	fprintf(pOut, "Mutex          %8.2f ms, %6.1f M events/s, %llu full retries%s\n", mutex.Ms, RING_EVENTS / mutex.Ms / 1000.0,
+		(unsigned long long)mutex.FullRetries, mutex.InOrder ? "" : "  OUT OF ORDER");
+	ok = ok && lockFreeResult.InOrder && mutex.InOrder;
+
+	bool snapshots = CheckSnapshots();
+	fprintf(pOut, "Snapshots %s\n", snapshots ? "match the scripted input" : "DIFFER FROM THE SCRIPTED INPUT");
+	ok = ok && snapshots;
+
+	fprintf(pOut, "Oldest event to Present, %u Hz input, %.0f fps, %.1f ms of work per frame\n", INPUT_HZ, TARGET_FPS, WORK_MS);
+	const char* names[] = { "Before wait", "After wait", "Pipelined" };
+	LatencyResult results[3];
+	for(unsigned m = 0; m < 3; ++m)
+	{
+		results[m] = RunLatency((SampleMode)m);
+		fprintf(pOut, "%-14s %7.3f ms mean, %7.3f ms p95, %7.3f ms max, %.1f events per frame\n", names[m],
+			results[m].MeanMs, results[m].P95Ms, results[m].MaxMs, results[m].EventsPerFrame);
+	}
+	//Sampling after the wait saves about the wait, pipelining costs about a frame
+	ok = ok && results[SAMPLE_AFTER_WAIT].MeanMs < results[SAMPLE_BEFORE_WAIT].MeanMs &&
+		results[SAMPLE_AFTER_WAIT].MeanMs < results[SAMPLE_PIPELINED].MeanMs;
+
+	fprintf(pOut, "Input %s\n", ok ? "works" : "FAILED");
+	return ok;
+}
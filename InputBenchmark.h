@@ -0,0 +1,16 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Input benchmark: throughput of the lock free event ring between
+				two threads against a mutex protected ring, a check of the input
+				snapshots (presses, repeats, focus loss), and the latency from a
+				1000 Hz input thread's events to a simulated Present when input
+				is sampled before the pacing wait, after it, and one pipelined
+				frame ahead.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunInputBenchmarks(FILE* pOut);
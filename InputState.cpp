@@ -0,0 +1,132 @@
+#include "InputState.h"
+
+#include <string.h>
+
+InputTracker::InputTracker()
+{
+	Reset();
+}
+
+void InputTracker::Reset()
+{
+	memset(&m_State, 0, sizeof(m_State));
+	m_HasMouse = false;
+}
+
+bool InputTracker::IsInputEvent(PlatformEventType type)
+{
+	switch(type)
+	{
+	case PE_KEY_DOWN:
+	case PE_KEY_UP:
+	case PE_MOUSE_MOVE:
+	case PE_MOUSE_DOWN:
+	case PE_MOUSE_UP:
+	case PE_MOUSE_RAW:
+	case PE_DEACTIVATE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void InputTracker::Apply(const PlatformEvent& e)
+{
+	if(!IsInputEvent(e.Type))
+		return;
+
+	if(m_State.Events++ == 0)
+		m_State.OldestEventTicks = e.Ticks;
+
+	uint32_t bit = 1u << (e.Key & 31);
+	unsigned word = (e.Key >> 5) & (InputState::KEY_WORDS - 1);
+	switch(e.Type)
+	{
+	case PE_KEY_DOWN:
+		//Auto repeat sends more downs while held, only the first one presses the key
+		if(e.Key < 256 && !(m_State.Keys[word] & bit))
+		{
+			m_State.Keys[word] |= bit;
+			m_State.Pressed[word] |= bit;
+		}
+		break;
+	case PE_KEY_UP:
+		if(e.Key < 256 && (m_State.Keys[word] & bit))
+		{
+			m_State.Keys[word] &= ~bit;
+			m_State.Released[word] |= bit;
+		}
+		break;
+
+	case PE_MOUSE_MOVE:
+	case PE_MOUSE_DOWN:
+	case PE_MOUSE_UP:
+		if(m_HasMouse)
+		{
+			m_State.MouseDX += e.X - m_State.MouseX;
+			m_State.MouseDY += e.Y - m_State.MouseY;
+		}
+		m_State.MouseX = e.X;
+		m_State.MouseY = e.Y;
+		m_HasMouse = true;
+		if(e.Type == PE_MOUSE_DOWN && !(m_State.Buttons & bit))
+		{
+			m_State.Buttons |= bit;
+			m_State.ButtonsPressed |= bit;
+		}
+		else if(e.Type == PE_MOUSE_UP && (m_State.Buttons & bit))
+		{
+			m_State.Buttons &= ~bit;
+			m_State.ButtonsReleased |= bit;
+		}
+		break;
+	case PE_MOUSE_RAW:
+		m_State.RawDX += e.X;
+		m_State.RawDY += e.Y;
+		break;
+
+	case PE_DEACTIVATE:
+		//The ups go to another window, release everything so nothing sticks
+		for(unsigned i = 0; i < InputState::KEY_WORDS; ++i)
+		{
+			m_State.Released[i] |= m_State.Keys[i];
+			m_State.Keys[i] = 0;
+		}
+		m_State.ButtonsReleased |= m_State.Buttons;
+		m_State.Buttons = 0;
+		break;
+
+	default:
+		break;
+	}
+}
+
+void InputTracker::Drain(EventQueue* pEvents)
+{
+	PlatformEvent e;
+	while(pEvents->Pop(&e))
+		Apply(e);
+}
+
+void InputTracker::TakeSnapshot(int64_t ticks, InputState* pState)
+{
+	m_State.SampleTicks = ticks;
+	*pState = m_State;
+
+	memset(m_State.Pressed, 0, sizeof(m_State.Pressed));
+	memset(m_State.Released, 0, sizeof(m_State.Released));
+	m_State.ButtonsPressed = 0;
+	m_State.ButtonsReleased = 0;
+	m_State.MouseDX = 0;
+	m_State.MouseDY = 0;
+	m_State.RawDX = 0;
+	m_State.RawDY = 0;
+	m_State.Events = 0;
+	m_State.OldestEventTicks = 0;
+}
+
+void InputTracker::PeekSnapshot(int64_t ticks, InputState* pState) const
+{
+	*pState = m_State;
+	pState->SampleTicks = ticks;
+}
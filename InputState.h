@@ -0,0 +1,68 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Per frame input snapshots. An InputTracker owned by the thread
+				running Update folds the input events it pops off its event ring
+				into the state of keys, buttons and the mouse, and takes one
+				InputState snapshot per Update: what is held, what went down or
+				up since the previous snapshot and how far the mouse moved, so
+				game code polls a consistent state instead of handling events.
+				Each snapshot keeps the time of its oldest event; once the frame
+				built from it is presented, the difference is the input latency.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "EventQueue.h"
+
+#include <stdint.h>
+
+struct InputState
+{
+	enum { KEY_WORDS = 256 / 32 };
+
+	uint32_t	Keys[KEY_WORDS];		//Held keys, one bit per PlatformKey
+	uint32_t	Pressed[KEY_WORDS];		//Went down since the previous snapshot (repeats excluded)
+	uint32_t	Released[KEY_WORDS];	//Went up since the previous snapshot
+	unsigned	Buttons;				//Held mouse buttons, bit per PlatformMouseButton
+	unsigned	ButtonsPressed;
+	unsigned	ButtonsReleased;
+	int			MouseX;					//Cursor position (client coordinates)
+	int			MouseY;
+	int			MouseDX;				//Cursor movement since the previous snapshot
+	int			MouseDY;
+	int			RawDX;					//Raw mouse motion since the previous snapshot (PE_MOUSE_RAW)
+	int			RawDY;
+	unsigned	Events;					//Input events folded into this snapshot
+	int64_t		OldestEventTicks;		//Ticks of the first of them, 0 if there were none
+	int64_t		SampleTicks;			//When the snapshot was taken
+
+	bool IsDown(unsigned key) const { return key < 256 && (Keys[key >> 5] >> (key & 31) & 1) != 0; }
+	bool WasPressed(unsigned key) const { return key < 256 && (Pressed[key >> 5] >> (key & 31) & 1) != 0; }
+	bool WasReleased(unsigned key) const { return key < 256 && (Released[key >> 5] >> (key & 31) & 1) != 0; }
+	bool IsButtonDown(unsigned button) const { return (Buttons >> button & 1) != 0; }
+	bool WasButtonPressed(unsigned button) const { return (ButtonsPressed >> button & 1) != 0; }
+};
+
+class InputTracker
+{
+public:
+	InputTracker();
+
+	//Forgets everything, nothing is held afterwards
+	void Reset();
+	//True for the event types the tracker folds in (keys, mouse, focus loss)
+	static bool IsInputEvent(PlatformEventType type);
+	//Folds one event into the state of the next snapshot
+	void Apply(const PlatformEvent& e);
+	//Pops and applies every event of pEvents (the consumer side of the ring)
+	void Drain(EventQueue* pEvents);
+	//Snapshot of everything applied so far; edges, motion and the event count start over
+	void TakeSnapshot(int64_t ticks, InputState* pState);
+	//Same snapshot without starting anything over, for a frame that runs no Update:
+	//the next TakeSnapshot still reports the edges and motion
+	void PeekSnapshot(int64_t ticks, InputState* pState) const;
+
+private:
+	InputState	m_State;		//Next snapshot
+	bool		m_HasMouse;		//A cursor position was seen, MouseDX/DY are meaningful
+};
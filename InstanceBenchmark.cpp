@@ -0,0 +1,216 @@
+#include "InstanceBenchmark.h"
+#include "InstanceRenderer.h"
+#include "NullRenderDevice.h"
+#include "SoftwareRenderDevice.h"
+#include "StateCache.h"
+#include "Timer.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	const unsigned COUNTS[] = { 10000, 100000, 1000000 };
+	const unsigned NUM_COUNTS = sizeof(COUNTS) / sizeof(COUNTS[0]);
+	const unsigned WIDTH = 640;
+	const unsigned HEIGHT = 360;
+	const unsigned IMAGE_INSTANCES = 1024;
+	//Pixels whose channels differ by more than this count as different
+	const int COLOR_TOLERANCE = 2;
+	//Edges may round differently between the paths, a few pixels are allowed
+	const double MAX_DIFFERENT_PIXELS = 0.002;
+
+	const char* PATH_NAMES[] = { "Per object", "Instanced", "CPU batched" };
+
+	const PositionColorVertex CUBE_VERTICES[8] =
+	{
+		{ -0.5f, -0.5f, -0.5f, RD_COLOR_ARGB(255, 255, 0, 0) },
+		{ 0.5f, -0.5f, -0.5f, RD_COLOR_ARGB(255, 0, 255, 0) },
+		{ 0.5f, 0.5f, -0.5f, RD_COLOR_ARGB(255, 0, 0, 255) },
+		{ -0.5f, 0.5f, -0.5f, RD_COLOR_ARGB(255, 255, 255, 0) },
+		{ -0.5f, -0.5f, 0.5f, RD_COLOR_ARGB(255, 255, 0, 255) },
+		{ 0.5f, -0.5f, 0.5f, RD_COLOR_ARGB(255, 0, 255, 255) },
+		{ 0.5f, 0.5f, 0.5f, RD_COLOR_ARGB(255, 255, 255, 255) },
+		{ -0.5f, 0.5f, 0.5f, RD_COLOR_ARGB(255, 128, 128, 128) }
+	};
+
+	const uint16_t CUBE_INDICES[36] =
+	{
+		0, 2, 1, 0, 3, 2,	//Front
+		4, 5, 6, 4, 6, 7,	//Back
+		0, 1, 5, 0, 5, 4,	//Bottom
+		3, 6, 2, 3, 7, 6,	//Top
+		0, 4, 7, 0, 7, 3,	//Left
+		1, 2, 6, 1, 6, 5	//Right
+	};
+
+	//Cubes on a square grid in the z = 0 plane, each rotated, scaled and colored
+	//differently. Returns the grid width in world units.
+	float MakeInstances(unsigned count, std::vector<Mat4>& world, std::vector<uint32_t>& colors)
+	{
+		unsigned side = (unsigned)ceil(sqrt((double)count));
+		const float spacing = 2.0f;
+		float offset = (side - 1) * spacing * 0.5f;
+
+		world.resize(count);
+		colors.resize(count);
+		for(unsigned i = 0; i < count; ++i)
+		{
+			unsigned seed = i * 2654435761u;
+			float scale = 0.6f + (float)((seed >> 8) & 255) / 640.0f;
+			Mat4 rotation = Mat4Multiply(Mat4RotationY(i * 0.37f), Mat4RotationX(i * 0.11f));
+			Mat4 translation = Mat4Translation((i % side) * spacing - offset, (i / side) * spacing - offset, 0.0f);
+			world[i] = Mat4Multiply(Mat4Multiply(Mat4Scaling(scale, scale, scale), rotation), translation);
+			colors[i] = RD_COLOR_ARGB(255, 128 + (seed >> 25), 128 + ((seed >> 17) & 127), 128 + ((seed >> 9) & 127));
+		}
+		return side * spacing;
+	}
+
+	//Camera looking at the whole grid
+	void SetCamera(IRenderDevice* pDevice, float gridSize)
+	{
+		float fov = MATH_PI / 3.0f;
+		float distance = gridSize * 0.5f / tanf(fov * 0.5f) * 1.1f;
+		Mat4 view = Mat4LookAtLH(Vec3(0.0f, 0.0f, -distance), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+		Mat4 proj = Mat4PerspectiveFovLH(fov, (float)WIDTH / HEIGHT, distance * 0.5f, distance * 2.0f);
+		pDevice->SetTransform(RD_TS_VIEW, view);
+		pDevice->SetTransform(RD_TS_PROJECTION, proj);
+		pDevice->SetRenderState(RD_RS_CULLMODE, RD_CULL_NONE);
+		pDevice->SetRenderState(RD_RS_LIGHTING, 0);
+	}
+
+	//Submission cost of one path on the null device
+	bool BenchmarkPath(FILE* pOut, StateCacheDevice* pDevice, InstanceRenderer& renderer, InstancePath path,
+		const std::vector<Mat4>& world, const std::vector<uint32_t>& colors)
+	{
+		if(!renderer.SetPath(path))
+		{
+			fprintf(pOut, "%8s %-12s not supported by the device\n", "", PATH_NAMES[path]);
+			return true;
+		}
+
+		unsigned count = (unsigned)world.size();
+		unsigned frames = std::max(3u, 1000000 / count);
+		NullRenderDevice* pNull = static_cast<NullRenderDevice*>(pDevice->GetInnerDevice());
+
+		//One frame to warm up the caches and buffers
+		renderer.Draw(&world[0], &colors[0], NULL, count);
+		pNull->ResetCounters();
+
+		int64_t start = TimerTicks();
+		for(unsigned frame = 0; frame < frames; ++frame)
+		{
+			renderer.BeginFrame();
+			renderer.Draw(&world[0], &colors[0], NULL, count);
+			pDevice->Present();
+		}
+		double ms = TicksToMs(TimerTicks() - start) / frames;
+
+		//Every path must hand every instance to the device
+		const NullDeviceCounters& counters = pNull->GetCounters();
+		const InstanceStats& stats = renderer.GetStats();
+		bool valid = stats.Instances == count && counters.Primitives == frames * count * 12;
+		fprintf(pOut, "%8s %-12s %9.3f ms per frame, %7.1f M instances/s, %7u draw calls, %7.2f MB uploaded%s\n",
+			"", PATH_NAMES[path], ms, count / ms / 1000.0, stats.DrawCalls, stats.BytesUploaded / 1e6,
+			valid ? "" : ", INSTANCES LOST");
+		return valid;
+	}
+
+	//Renders the instances with one path and returns the back buffer
+	double RenderImage(SoftwareRenderDevice* pDevice, InstanceRenderer& renderer, InstancePath path,
+		const std::vector<Mat4>& world, const uint32_t* pColors, std::vector<RDCOLOR>& image)
+	{
+		renderer.SetPath(path);
+		int64_t start = TimerTicks();
+		pDevice->Clear(RD_CLEAR_TARGET | RD_CLEAR_ZBUFFER, RD_COLOR_ARGB(255, 0, 0, 0), 1.0f, 0);
+		pDevice->BeginScene();
+		renderer.Draw(&world[0], pColors, NULL, (unsigned)world.size());
+		pDevice->EndScene();
+		double ms = TicksToMs(TimerTicks() - start);
+
+		image.resize(WIDTH * HEIGHT);
+		for(unsigned y = 0; y < HEIGHT; ++y)
+		{
+			const RDCOLOR* pRow = pDevice->GetBackBuffer() + y * pDevice->GetPitch();
+			std::copy(pRow, pRow + WIDTH, &image[y * WIDTH]);
+		}
+		return ms;
+	}
+
+	unsigned CountDifferentPixels(const std::vector<RDCOLOR>& a, const std::vector<RDCOLOR>& b)
+	{
+		unsigned different = 0;
+		for(size_t i = 0; i < a.size(); ++i)
+		{
+			for(int shift = 0; shift < 24; shift += 8)
+			{
+				if(abs((int)((a[i] >> shift) & 0xff) - (int)((b[i] >> shift) & 0xff)) > COLOR_TOLERANCE)
+				{
+					++different;
+					break;
+				}
+			}
+		}
+		return different;
+	}
+}
+
+bool RunInstanceBenchmarks(FILE* pOut)
+{
+	bool ok = true;
+	std::vector<Mat4> world;
+	std::vector<uint32_t> colors;
+
+	fprintf(pOut, "Instanced drawing (cube of 12 triangles, CPU cost on the null device)\n");
+	for(unsigned c = 0; c < NUM_COUNTS; ++c)
+	{
+		StateCacheDevice device(new NullRenderDevice(WIDTH, HEIGHT));
+		InstanceRenderer renderer;
+		if(!renderer.Init(&device, CUBE_VERTICES, 8, CUBE_INDICES, 36))
+		{
+			fprintf(pOut, "InstanceRenderer::Init failed\n");
+			return false;
+		}
+
+		float gridSize = MakeInstances(COUNTS[c], world, colors);
+		SetCamera(&device, gridSize);
+		fprintf(pOut, "%u instances\n", COUNTS[c]);
+		for(int path = INSTANCE_PATH_PER_OBJECT; path <= INSTANCE_PATH_BATCHED; ++path)
+			ok = BenchmarkPath(pOut, &device, renderer, (InstancePath)path, world, colors) && ok;
+	}
+
+	//Same pixels from every path: instance colors are compared between instancing
+	//and batching, per object draws (which ignore them) against white instances
+	SoftwareRenderDevice device(WIDTH, HEIGHT);
+	InstanceRenderer renderer;
+	if(!renderer.Init(&device, CUBE_VERTICES, 8, CUBE_INDICES, 36))
+	{
+		fprintf(pOut, "InstanceRenderer::Init failed on the software device\n");
+		return false;
+	}
+	float gridSize = MakeInstances(IMAGE_INSTANCES, world, colors);
+	SetCamera(&device, gridSize);
+
+	std::vector<RDCOLOR> perObject, instanced, batched, instancedWhite;
+	double perObjectMs = RenderImage(&device, renderer, INSTANCE_PATH_PER_OBJECT, world, NULL, perObject);
+	double instancedMs = RenderImage(&device, renderer, INSTANCE_PATH_INSTANCED, world, &colors[0], instanced);
+	double batchedMs = RenderImage(&device, renderer, INSTANCE_PATH_BATCHED, world, &colors[0], batched);
+	RenderImage(&device, renderer, INSTANCE_PATH_INSTANCED, world, NULL, instancedWhite);
+
+	unsigned maxDifferent = (unsigned)(WIDTH * HEIGHT * MAX_DIFFERENT_PIXELS);
+	unsigned colorDiff = CountDifferentPixels(instanced, batched);
+	unsigned whiteDiff = CountDifferentPixels(perObject, instancedWhite);
+	unsigned covered = 0;
+	for(size_t i = 0; i < instanced.size(); ++i)
+		covered += (instanced[i] & 0xFFFFFF) != 0;
+	bool imagesMatch = colorDiff <= maxDifferent && whiteDiff <= maxDifferent && covered > WIDTH * HEIGHT / 10;
+
+	fprintf(pOut, "Software device %ux%u, %u instances: per object %.2f ms, instanced %.2f ms, CPU batched %.2f ms\n",
+		WIDTH, HEIGHT, IMAGE_INSTANCES, perObjectMs, instancedMs, batchedMs);
+	fprintf(pOut, "%u pixels covered, %u differ between instanced and batched, %u between per object and instanced\n",
+		covered, colorDiff, whiteDiff);
+	fprintf(pOut, "Instancing paths %s\n", imagesMatch && ok ? "draw the same image" : "DIFFER");
+	return ok && imagesMatch;
+}
@@ -0,0 +1,16 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Instanced drawing benchmark: submits 10k to 1M cubes per frame
+				through each InstanceRenderer path (per object draws, instancing,
+				CPU batching) on the null device to measure the CPU cost, then
+				renders all three on the software device and compares the images.
+				The null device has no driver behind it: per object draws only pay
+				the framework's share here, Direct3D 9 adds driver time to each.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if the paths draw different images
+bool RunInstanceBenchmarks(FILE* pOut);
@@ -0,0 +1,324 @@
+#include "InstanceRenderer.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	//16 bit indices limit a batch to 65536 vertices
+	const unsigned MAX_BATCH_VERTICES = 65536;
+	//Draws that fit into a dynamic buffer before it wraps around
+	const unsigned RING_DRAWS = 4;
+
+	const RDWORD MESH_FVF = PositionColorLayout::FVF;
+	//Batched copies are already in world space
+	const Mat4 IDENTITY = Mat4Identity();
+
+	//Mesh in stream 0, InstanceVertex in stream 1
+	const RDVertexElement INSTANCE_ELEMENTS[] =
+	{
+		{ 0, 0, RD_DECLTYPE_FLOAT3, 0, RD_DECLUSAGE_POSITION, 0 },
+		{ 0, 12, RD_DECLTYPE_D3DCOLOR, 0, RD_DECLUSAGE_COLOR, 0 },
+		{ 1, 0, RD_DECLTYPE_FLOAT3, 0, RD_DECLUSAGE_TEXCOORD, RD_INSTANCE_WORLD_INDEX },
+		{ 1, 12, RD_DECLTYPE_FLOAT3, 0, RD_DECLUSAGE_TEXCOORD, RD_INSTANCE_WORLD_INDEX + 1 },
+		{ 1, 24, RD_DECLTYPE_FLOAT3, 0, RD_DECLUSAGE_TEXCOORD, RD_INSTANCE_WORLD_INDEX + 2 },
+		{ 1, 36, RD_DECLTYPE_FLOAT3, 0, RD_DECLUSAGE_TEXCOORD, RD_INSTANCE_WORLD_INDEX + 3 },
+		{ 1, 48, RD_DECLTYPE_D3DCOLOR, 0, RD_DECLUSAGE_COLOR, RD_INSTANCE_COLOR_INDEX },
+		RD_DECL_END()
+	};
+
+#ifdef SIMDMATH_SSE
+	//Four colors times the color in color16 (its channels as 16 bit, twice), rounded like RDModulateColor
+	__m128i ModulateColors4(__m128i colors, __m128i color16)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i half = _mm_set1_epi16(128);
+		__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(colors, zero), color16), half);
+		__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(colors, zero), color16), half);
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+		return _mm_packus_epi16(lo, hi);
+	}
+#endif
+
+	bool CreateStaticBuffer(IRenderDevice* pDevice, const void* pData, unsigned size, IVertexBuffer** ppVB)
+	{
+		void* pDst = NULL;
+		if(!pDevice->CreateVertexBuffer(size, RD_USAGE_WRITEONLY, MESH_FVF, RD_POOL_MANAGED, ppVB) ||
+			!(*ppVB)->Lock(0, size, &pDst, 0))
+			return false;
+		memcpy(pDst, pData, size);
+		(*ppVB)->Unlock();
+		return true;
+	}
+
+	bool CreateStaticBuffer(IRenderDevice* pDevice, const uint16_t* pIndices, unsigned count, IIndexBuffer** ppIB)
+	{
+		void* pDst = NULL;
+		unsigned size = count * sizeof(uint16_t);
+		if(!pDevice->CreateIndexBuffer(size, RD_USAGE_WRITEONLY, RD_FMT_INDEX16, RD_POOL_MANAGED, ppIB) ||
+			!(*ppIB)->Lock(0, size, &pDst, 0))
+			return false;
+		memcpy(pDst, pIndices, size);
+		(*ppIB)->Unlock();
+		return true;
+	}
+}
+
+void BuildInstances(InstanceVertex* pOut, const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		unsigned index = pIndices ? pIndices[i] : i;
+		const Mat4& world = pWorld[index];
+		InstanceVertex& instance = pOut[i];
+		for(int row = 0; row < 4; ++row)
+		{
+			instance.World[row][0] = world.m[row][0];
+			instance.World[row][1] = world.m[row][1];
+			instance.World[row][2] = world.m[row][2];
+		}
+		instance.Color = pColors ? pColors[index] : 0xFFFFFFFF;
+	}
+}
+
+InstanceRenderer::InstanceRenderer()
+{
+	m_pDevice = NULL;
+	m_Path = INSTANCE_PATH_BATCHED;
+	m_IndexCount = 0;
+	m_pMeshVB = NULL;
+	m_pMeshIB = NULL;
+	m_pDecl = NULL;
+	m_pInstanceVB = NULL;
+	m_InstancesPerDraw = 0;
+	m_InstanceCursor = 0;
+	m_pBatchIB = NULL;
+	m_pBatchVB = NULL;
+	m_CopiesPerBatch = 0;
+	m_BatchCursor = 0;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+InstanceRenderer::~InstanceRenderer()
+{
+	Shutdown();
+}
+
+bool InstanceRenderer::Init(IRenderDevice* pDevice, const PositionColorVertex* pVertices, unsigned vertexCount,
+	const uint16_t* pIndices, unsigned indexCount, unsigned instancesPerDraw)
+{
+	Shutdown();
+	if(!pDevice || vertexCount == 0 || vertexCount > MAX_BATCH_VERTICES || indexCount == 0 || indexCount % 3 != 0 ||
+		instancesPerDraw == 0)
+		return false;
+
+	m_pDevice = pDevice;
+	m_Vertices.assign(pVertices, pVertices + vertexCount);
+	m_Colors.assign((vertexCount + 3) & ~3u, 0);
+	for(unsigned i = 0; i < vertexCount; ++i)
+		m_Colors[i] = pVertices[i].Color;
+	m_IndexCount = indexCount;
+	m_InstancesPerDraw = instancesPerDraw;
+	m_CopiesPerBatch = std::min(MAX_BATCH_VERTICES / vertexCount, instancesPerDraw);
+
+	//Batch indices: copy c uses vertices c * vertexCount and up
+	std::vector<uint16_t> batchIndices((size_t)m_CopiesPerBatch * indexCount);
+	for(unsigned c = 0; c < m_CopiesPerBatch; ++c)
+	{
+		for(unsigned i = 0; i < indexCount; ++i)
+			batchIndices[(size_t)c * indexCount + i] = (uint16_t)(pIndices[i] + c * vertexCount);
+	}
+
+	bool created = CreateStaticBuffer(pDevice, pVertices, vertexCount * sizeof(PositionColorVertex), &m_pMeshVB) &&
+		CreateStaticBuffer(pDevice, pIndices, indexCount, &m_pMeshIB) &&
+		CreateStaticBuffer(pDevice, &batchIndices[0], (unsigned)batchIndices.size(), &m_pBatchIB) &&
+		pDevice->CreateVertexBuffer(RING_DRAWS * m_CopiesPerBatch * vertexCount * sizeof(PositionColorVertex),
+			RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, MESH_FVF, RD_POOL_DEFAULT, &m_pBatchVB);
+	if(!created)
+	{
+		Shutdown();
+		return false;
+	}
+
+	//Without instancing only the other two paths are available
+	if(pDevice->SupportsInstancing() &&
+		(!pDevice->CreateVertexDeclaration(INSTANCE_ELEMENTS, &m_pDecl) ||
+		!pDevice->CreateVertexBuffer(RING_DRAWS * instancesPerDraw * sizeof(InstanceVertex),
+			RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, 0, RD_POOL_DEFAULT, &m_pInstanceVB)))
+	{
+		SAFE_RELEASE(m_pDecl);
+		SAFE_RELEASE(m_pInstanceVB);
+	}
+
+	m_Path = m_pDecl ? INSTANCE_PATH_INSTANCED : INSTANCE_PATH_BATCHED;
+	m_InstanceCursor = 0;
+	m_BatchCursor = 0;
+	return true;
+}
+
+void InstanceRenderer::Shutdown()
+{
+	SAFE_RELEASE(m_pMeshVB);
+	SAFE_RELEASE(m_pMeshIB);
+	SAFE_RELEASE(m_pDecl);
+	SAFE_RELEASE(m_pInstanceVB);
+	SAFE_RELEASE(m_pBatchIB);
+	SAFE_RELEASE(m_pBatchVB);
+	m_Vertices.clear();
+	m_Colors.clear();
+	m_pDevice = NULL;
+}
+
+bool InstanceRenderer::SetPath(InstancePath path)
+{
+	if(path == INSTANCE_PATH_INSTANCED && !m_pDecl)
+		return false;
+	m_Path = path;
+	return true;
+}
+
+void InstanceRenderer::BeginFrame()
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void InstanceRenderer::Draw(const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count)
+{
+	if(!m_pDevice || count == 0)
+		return;
+
+	switch(m_Path)
+	{
+	case INSTANCE_PATH_PER_OBJECT: DrawPerObject(pWorld, pIndices, count); break;
+	case INSTANCE_PATH_INSTANCED: DrawInstanced(pWorld, pColors, pIndices, count); break;
+	default: DrawBatched(pWorld, pColors, pIndices, count); break;
+	}
+}
+
+void InstanceRenderer::DrawPerObject(const Mat4* pWorld, const uint32_t* pIndices, unsigned count)
+{
+	m_pDevice->SetFVF(MESH_FVF);
+	m_pDevice->SetStreamSource(0, m_pMeshVB, 0, sizeof(PositionColorVertex));
+	m_pDevice->SetIndices(m_pMeshIB);
+
+	unsigned vertexCount = (unsigned)m_Vertices.size();
+	for(unsigned i = 0; i < count; ++i)
+	{
+		m_pDevice->SetTransform(RD_TS_WORLD, pWorld[pIndices ? pIndices[i] : i]);
+		m_pDevice->DrawIndexedPrimitive(RD_PT_TRIANGLELIST, 0, 0, vertexCount, 0, m_IndexCount / 3);
+	}
+	m_Stats.Instances += count;
+	m_Stats.DrawCalls += count;
+}
+
+void InstanceRenderer::DrawInstanced(const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count)
+{
+	m_pDevice->SetVertexDeclaration(m_pDecl);
+	m_pDevice->SetStreamSource(0, m_pMeshVB, 0, sizeof(PositionColorVertex));
+	m_pDevice->SetIndices(m_pMeshIB);
+	m_pDevice->SetStreamSourceFreq(1, RD_STREAMSOURCE_INSTANCEDATA | 1);
+
+	unsigned bufferSize = RING_DRAWS * m_InstancesPerDraw * sizeof(InstanceVertex);
+	for(unsigned first = 0; first < count; first += m_InstancesPerDraw)
+	{
+		unsigned chunk = std::min(count - first, m_InstancesPerDraw);
+		unsigned bytes = chunk * sizeof(InstanceVertex);
+		unsigned offset = 0;
+		InstanceVertex* pInstances = (InstanceVertex*)LockRing(m_pInstanceVB, bufferSize, &m_InstanceCursor, bytes, &offset);
+		if(!pInstances)
+			break;
+		if(pIndices)
+			BuildInstances(pInstances, pWorld, pColors, pIndices + first, chunk);
+		else
+			BuildInstances(pInstances, pWorld + first, pColors ? pColors + first : NULL, NULL, chunk);
+		m_pInstanceVB->Unlock();
+
+		//There is no base instance in Direct3D 9, the stream offset selects the chunk
+		m_pDevice->SetStreamSource(1, m_pInstanceVB, offset, sizeof(InstanceVertex));
+		m_pDevice->SetStreamSourceFreq(0, RD_STREAMSOURCE_INDEXEDDATA | chunk);
+		m_pDevice->DrawIndexedPrimitive(RD_PT_TRIANGLELIST, 0, 0, (unsigned)m_Vertices.size(), 0, m_IndexCount / 3);
+		m_Stats.BytesUploaded += bytes;
+		++m_Stats.DrawCalls;
+	}
+	m_Stats.Instances += count;
+
+	//Plain drawing again for whoever draws next
+	m_pDevice->SetStreamSourceFreq(0, 1);
+	m_pDevice->SetStreamSourceFreq(1, 1);
+	m_pDevice->SetStreamSource(1, NULL, 0, 0);
+}
+
+void InstanceRenderer::DrawBatched(const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count)
+{
+	m_pDevice->SetFVF(MESH_FVF);
+	m_pDevice->SetTransform(RD_TS_WORLD, IDENTITY);
+	m_pDevice->SetIndices(m_pBatchIB);
+
+	unsigned vertexCount = (unsigned)m_Vertices.size();
+	unsigned copyBytes = vertexCount * sizeof(PositionColorVertex);
+	unsigned bufferSize = RING_DRAWS * m_CopiesPerBatch * copyBytes;
+	for(unsigned first = 0; first < count; first += m_CopiesPerBatch)
+	{
+		unsigned copies = std::min(count - first, m_CopiesPerBatch);
+		unsigned offset = 0;
+		PositionColorVertex* pDst = (PositionColorVertex*)LockRing(m_pBatchVB, bufferSize, &m_BatchCursor, copies * copyBytes, &offset);
+		if(!pDst)
+			break;
+
+		for(unsigned c = 0; c < copies; ++c, pDst += vertexCount)
+		{
+			unsigned index = pIndices ? pIndices[first + c] : first + c;
+			RDCOLOR color = pColors ? pColors[index] : 0xFFFFFFFF;
+
+			//Positions only, the colors are written next to them
+			TransformPositions(pWorld[index], &m_Vertices[0], sizeof(PositionColorVertex), pDst, sizeof(PositionColorVertex), vertexCount);
+			if(color == 0xFFFFFFFF)
+			{
+				for(unsigned v = 0; v < vertexCount; ++v)
+					pDst[v].Color = m_Colors[v];
+				continue;
+			}
+#ifdef SIMDMATH_SSE
+			__m128i color16 = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), _mm_setzero_si128());
+			for(unsigned v = 0; v < vertexCount; v += 4)
+			{
+				RDCOLOR modulated[4];
+				_mm_storeu_si128((__m128i*)modulated, ModulateColors4(_mm_loadu_si128((const __m128i*)&m_Colors[v]), color16));
+				for(unsigned i = 0; i < 4 && v + i < vertexCount; ++i)
+					pDst[v + i].Color = modulated[i];
+			}
+#else
+			for(unsigned v = 0; v < vertexCount; ++v)
+				pDst[v].Color = RDModulateColor(m_Colors[v], color);
+#endif
+		}
+		m_pBatchVB->Unlock();
+
+		//Batches start on a whole copy, BaseVertexIndex addresses them like the BatchRenderer does
+		m_pDevice->SetStreamSource(0, m_pBatchVB, 0, sizeof(PositionColorVertex));
+		m_pDevice->DrawIndexedPrimitive(RD_PT_TRIANGLELIST, offset / sizeof(PositionColorVertex), 0,
+			copies * vertexCount, 0, copies * m_IndexCount / 3);
+		m_Stats.BytesUploaded += copies * copyBytes;
+		++m_Stats.DrawCalls;
+	}
+	m_Stats.Instances += count;
+}
+
+void* InstanceRenderer::LockRing(IVertexBuffer* pVB, unsigned bufferSize, unsigned* pCursor, unsigned bytes, unsigned* pOffset)
+{
+	RDWORD lock = RD_LOCK_NOOVERWRITE;
+	if(*pCursor + bytes > bufferSize)
+	{
+		*pCursor = 0;
+		lock = RD_LOCK_DISCARD;
+		++m_Stats.RingWraps;
+	}
+
+	void* pData = NULL;
+	if(!pVB->Lock(*pCursor, bytes, &pData, lock))
+		return NULL;
+	*pOffset = *pCursor;
+	*pCursor += bytes;
+	return pData;
+}
@@ -0,0 +1,116 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Draws many copies of one PositionColorVertex mesh, each with its
+				own world matrix and color read straight from packed arrays (e.g.
+				Scene::GetWorldMatrices(), Scene::GetColors() and the visible list
+				of a Culler). Three paths:
+				per object - SetTransform() and one draw call per copy,
+				instanced - stream 0 holds the mesh, stream 1 an InstanceVertex per
+				copy, one draw call per chunk of copies (stream frequencies),
+				batched - copies are transformed on the CPU into a dynamic vertex
+				buffer drawn with one shared, pre-built index buffer; the fallback
+				for devices without instancing.
+				Buffers are created through the device, so a ResourceRegistryDevice
+				keeps them across resets (the dynamic ones are refilled every Draw()).
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "SimdMath.h"
+#include "VertexLayout.h"
+
+#include <vector>
+
+//Per instance vertex of the instanced path, see RDInstanceLayout
+struct InstanceVertex
+{
+	float	World[4][3];	//Rows of the world matrix, the fourth column is 0, 0, 0, 1
+	RDCOLOR	Color;			//Multiplied with the vertex colors
+};
+
+static_assert(sizeof(InstanceVertex) == 52, "Instance vertices must match their declaration");
+
+//Packs count instances. pIndices selects the elements of the packed arrays
+//(NULL takes the first count), without pColors every instance is white.
+void BuildInstances(InstanceVertex* pOut, const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count);
+
+enum InstancePath
+{
+	INSTANCE_PATH_PER_OBJECT,		//Instance colors are not applied (no per draw color in the fixed function pipeline)
+	INSTANCE_PATH_INSTANCED,
+	INSTANCE_PATH_BATCHED
+};
+
+//Per frame counters
+struct InstanceStats
+{
+	unsigned	Instances;
+	unsigned	DrawCalls;
+	uint64_t	BytesUploaded;		//Instance or batch vertices written
+	unsigned	RingWraps;			//DISCARD locks
+};
+
+class InstanceRenderer
+{
+public:
+	InstanceRenderer();
+	~InstanceRenderer();
+
+	//Copies the mesh (16 bit triangle list) into static buffers. instancesPerDraw
+	//is the chunk size of the instanced path; batches hold as many copies as 16
+	//bit indices allow, at most that many.
+	bool Init(IRenderDevice* pDevice, const PositionColorVertex* pVertices, unsigned vertexCount,
+		const uint16_t* pIndices, unsigned indexCount, unsigned instancesPerDraw = 16384);
+	void Shutdown();
+
+	//Starts with the instanced path if the device supports it, batched otherwise.
+	//False if the path is not available.
+	bool SetPath(InstancePath path);
+	InstancePath GetPath() const { return m_Path; }
+	bool CanInstance() const { return m_pDecl != NULL; }
+
+	//Starts a new frame and clears the statistics
+	void BeginFrame();
+	//Draws count copies, arguments as in BuildInstances(). Sets the FVF or the
+	//vertex declaration, streams, indices, stream frequencies (back to 1) and
+	//RD_TS_WORLD (last object, or identity when batched).
+	void Draw(const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count);
+
+	const InstanceStats& GetStats() const { return m_Stats; }
+
+private:
+	//Disallow copying
+	InstanceRenderer(const InstanceRenderer&);
+	InstanceRenderer& operator=(const InstanceRenderer&);
+
+	void DrawPerObject(const Mat4* pWorld, const uint32_t* pIndices, unsigned count);
+	void DrawInstanced(const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count);
+	void DrawBatched(const Mat4* pWorld, const uint32_t* pColors, const uint32_t* pIndices, unsigned count);
+	//Appends bytes to a dynamic ring buffer: NOOVERWRITE while there is room, DISCARD when wrapping
+	void* LockRing(IVertexBuffer* pVB, unsigned bufferSize, unsigned* pCursor, unsigned bytes, unsigned* pOffset);
+
+	IRenderDevice*				m_pDevice;
+	InstancePath				m_Path;
+
+	//Mesh
+	std::vector<PositionColorVertex>	m_Vertices;		//System memory copy the batched path transforms
+	std::vector<RDCOLOR>		m_Colors;				//Vertex colors, padded to a multiple of 4
+	unsigned					m_IndexCount;
+	IVertexBuffer*				m_pMeshVB;
+	IIndexBuffer*				m_pMeshIB;
+
+	//Instanced path
+	IVertexDeclaration*			m_pDecl;
+	IVertexBuffer*				m_pInstanceVB;
+	unsigned					m_InstancesPerDraw;
+	unsigned					m_InstanceCursor;		//Next free byte
+
+	//Batched path
+	IIndexBuffer*				m_pBatchIB;				//Mesh indices repeated for every copy of a batch
+	IVertexBuffer*				m_pBatchVB;
+	unsigned					m_CopiesPerBatch;
+	unsigned					m_BatchCursor;
+
+	InstanceStats				m_Stats;
+};
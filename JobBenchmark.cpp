@@ -0,0 +1,128 @@
+#include "JobBenchmark.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned EMPTY_JOBS = 200000;
+	const unsigned FAN_ITERATIONS = 2000;
+	const unsigned FAN_WIDTH = 64;
+	const unsigned OUTER_COUNT = 64;
+	const unsigned INNER_COUNT = 16384;
+
+	void EmptyJob(void* /*pData*/, unsigned /*begin*/, unsigned /*end*/)
+	{
+	}
+
+	//A few hundred nanoseconds of arithmetic the optimizer cannot drop
+	void SmallJob(void* pData, unsigned begin, unsigned /*end*/)
+	{
+		float* pOut = (float*)pData;
+		float x = (float)begin;
+		for(int i = 0; i < 64; ++i)
+			x = x * 0.999f + 0.5f;
+		pOut[begin] = x;
+	}
+
+	struct NestedData
+	{
+		JobSystem* pJobs;
+		std::vector<float>* pValues;
+	};
+
+	void InnerLoop(void* pData, unsigned begin, unsigned end)
+	{
+		float* pValues = (float*)pData;
+		for(unsigned i = begin; i < end; ++i)
+			pValues[i] = sqrtf(pValues[i] * pValues[i] + 1.0f) * 0.5f;
+	}
+
+	void OuterLoop(void* pData, unsigned begin, unsigned end)
+	{
+		NestedData* pNested = (NestedData*)pData;
+		for(unsigned i = begin; i < end; ++i)
+		{
+			float* pValues = &(*pNested->pValues)[i * INNER_COUNT];
+			pNested->pJobs->ParallelFor(INNER_COUNT, 1024, InnerLoop, pValues);
+		}
+	}
+
+	//Nanoseconds per queued and executed empty job
+	double BenchEmptyJobs(JobSystem& jobs)
+	{
+		JobCounter counter;
+		int64_t start = TimerTicks();
+		for(unsigned i = 0; i < EMPTY_JOBS; ++i)
+		{
+			jobs.Run(EmptyJob, NULL, &counter);
+			//Stay below the deque capacity so every job really goes through a deque
+			if((i & 1023) == 1023)
+				jobs.Wait(&counter);
+		}
+		jobs.Wait(&counter);
+		return TicksToMs(TimerTicks() - start) * 1e6 / EMPTY_JOBS;
+	}
+
+	//Microseconds to spread FAN_WIDTH small jobs and wait for all of them
+	double BenchFanOutIn(JobSystem& jobs)
+	{
+		std::vector<float> out(FAN_WIDTH);
+		int64_t start = TimerTicks();
+		for(unsigned i = 0; i < FAN_ITERATIONS; ++i)
+		{
+			JobCounter counter;
+			for(unsigned j = 0; j < FAN_WIDTH; ++j)
+				jobs.Run(SmallJob, &out[0], &counter, j, j + 1);
+			jobs.Wait(&counter);
+		}
+		return TicksToMs(TimerTicks() - start) * 1000.0 / FAN_ITERATIONS;
+	}
+
+	//Milliseconds for an outer ParallelFor whose iterations run inner ParallelFors
+	double BenchNested(JobSystem& jobs, std::vector<float>& values)
+	{
+		NestedData nested = { &jobs, &values };
+		int64_t start = TimerTicks();
+		jobs.ParallelFor(OUTER_COUNT, 1, OuterLoop, &nested);
+		return TicksToMs(TimerTicks() - start);
+	}
+}
+
+void RunJobBenchmarks(FILE* pOut, unsigned maxThreads)
+{
+	if(maxThreads == 0)
+		maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<float> values(OUTER_COUNT * INNER_COUNT, 1.0f);
+
+	fprintf(pOut, "Job system (%u hardware threads)\n", std::thread::hardware_concurrency());
+	fprintf(pOut, "%8s %16s %16s %16s %10s\n", "threads", "empty job ns", "fan-out/in us", "nested ms", "speedup");
+
+	double nestedBase = 0.0;
+	for(unsigned threads = 1; ; threads = std::min(threads * 2, maxThreads))
+	{
+		JobSystem jobs;
+		jobs.Init(threads);
+
+		//Warm up (thread start, page faults)
+		BenchNested(jobs, values);
+
+		double empty = BenchEmptyJobs(jobs);
+		double fan = BenchFanOutIn(jobs);
+		double nested = 1e30;
+		for(int run = 0; run < 5; ++run)
+			nested = std::min(nested, BenchNested(jobs, values));
+		if(threads == 1)
+			nestedBase = nested;
+
+		fprintf(pOut, "%8u %16.1f %16.2f %16.3f %9.2fx\n", threads, empty, fan, nested, nestedBase / nested);
+		jobs.Shutdown();
+
+		if(threads >= maxThreads)
+			break;
+	}
+}
@@ -0,0 +1,12 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Job system micro-benchmarks: empty job overhead, fan-out/fan-in
+				latency and nested ParallelFor scaling from 1 thread to all cores.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut. maxThreads = 0 scales up to one thread per core.
+void RunJobBenchmarks(FILE* pOut, unsigned maxThreads = 0);
@@ -0,0 +1,376 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+//Thread local storage without C++11 thread_local (not available in VS2013)
+#if defined(_MSC_VER)
+#define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#define JOB_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	//System the calling thread belongs to and its deque index
+	JOB_THREAD_LOCAL JobSystem* t_pJobSystem = NULL;
+	JOB_THREAD_LOCAL unsigned t_JobThreadIndex = 0;
+
+	//Failed searches before an idle worker goes to sleep
+	const unsigned IDLE_SPINS = 64;
+}
+
+//-----------------------------------------------------------------------------
+//JobDeque
+//-----------------------------------------------------------------------------
+
+bool JobDeque::Push(const Job& job)
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	if(bottom - top >= CAPACITY)
+		return false;
+
+	m_Jobs[bottom & (CAPACITY - 1)] = job;
+	std::atomic_thread_fence(std::memory_order_release);
+	m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobDeque::Pop(Job* pJob)
+{
+	int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if(top > bottom)
+	{
+		//Empty
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	*pJob = m_Jobs[bottom & (CAPACITY - 1)];
+	if(top == bottom)
+	{
+		//Last job, race the thieves for it
+		bool won = m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+bool JobDeque::Steal(Job* pJob)
+{
+	int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+	if(top >= bottom)
+		return false;
+
+	//The copy is only used if the CAS proves nobody took the slot meanwhile.
+	//Push never overwrites slot top while it is still in the deque.
+	Job job = m_Jobs[top & (CAPACITY - 1)];
+	if(!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return false;
+
+	*pJob = job;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//JobSystem
+//-----------------------------------------------------------------------------
+
+JobSystem::JobSystem()
+{
+	m_ExternalCount = 0;
+	m_Generation = 0;
+	m_Sleeping = 0;
+	m_Quit = false;
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+bool JobSystem::Init(unsigned numThreads)
+{
+	if(IsRunning())
+		return false;
+
+	if(numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	m_Quit = false;
+	for(unsigned i = 0; i < numThreads; ++i)
+		m_Deques.push_back(new JobDeque());
+
+	//The calling thread is thread 0
+	t_pJobSystem = this;
+	t_JobThreadIndex = 0;
+
+	for(unsigned i = 1; i < numThreads; ++i)
+		m_Workers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+	return true;
+}
+
+void JobSystem::Shutdown()
+{
+	if(!IsRunning())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_SleepLock);
+		m_Quit = true;
+	}
+	m_WakeUp.notify_all();
+	for(size_t i = 0; i < m_Workers.size(); ++i)
+		m_Workers[i].join();
+	m_Workers.clear();
+
+	for(size_t i = 0; i < m_Deques.size(); ++i)
+		delete m_Deques[i];
+	m_Deques.clear();
+	m_External.clear();
+	m_ExternalCount = 0;
+
+	if(t_pJobSystem == this)
+		t_pJobSystem = NULL;
+}
+
+unsigned JobSystem::GetThreadIndex() const
+{
+	return t_pJobSystem == this ? t_JobThreadIndex : GetThreadCount();
+}
+
+void JobSystem::Run(JobFunction function, void* pData, JobCounter* pCounter, unsigned begin, unsigned end)
+{
+	Job job;
+	job.Function = function;
+	job.pData = pData;
+	job.Begin = begin;
+	job.End = end;
+	job.pCounter = pCounter;
+
+	if(pCounter)
+		pCounter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+	Push(job);
+}
+
+void JobSystem::RunAfter(JobCounter* pDependency, JobFunction function, void* pData, JobCounter* pCounter)
+{
+	Job job;
+	job.Function = function;
+	job.pData = pData;
+	job.Begin = 0;
+	job.End = 1;
+	job.pCounter = pCounter;
+
+	if(pCounter)
+		pCounter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(pDependency->m_ContinuationLock);
+		int pending = pDependency->m_Pending.fetch_or(JobCounter::HAS_CONTINUATIONS, std::memory_order_acq_rel);
+		if(pending & JobCounter::COUNT_MASK)
+		{
+			//The last job of pDependency queues it
+			pDependency->m_Continuations.push_back(job);
+			return;
+		}
+
+		//Already done. Clear the flag unless a finishing job set it and clears it itself.
+		if(!(pending & JobCounter::HAS_CONTINUATIONS))
+			pDependency->m_Pending.fetch_and(~JobCounter::HAS_CONTINUATIONS, std::memory_order_release);
+	}
+	Push(job);
+}
+
+void JobSystem::Wait(JobCounter* pCounter)
+{
+	unsigned threadIndex = GetThreadIndex();
+	while(!pCounter->IsDone())
+	{
+		//Help instead of blocking
+		Job job;
+		if(FindJob(threadIndex, &job))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::ParallelFor(unsigned count, unsigned grainSize, ParallelForFunction function, void* pData)
+{
+	if(count == 0)
+		return;
+	if(grainSize == 0)
+		grainSize = 1;
+
+	//Not worth splitting
+	if(!IsRunning() || GetThreadCount() == 1 || count <= grainSize)
+	{
+		function(pData, 0, count);
+		return;
+	}
+
+	ParallelForData data;
+	data.pSystem = this;
+	data.Function = function;
+	data.pData = pData;
+	data.GrainSize = grainSize;
+
+	//The calling thread takes the first slice, then helps with the rest
+	ParallelForJob(&data, 0, count);
+	Wait(&data.Counter);
+}
+
+void JobSystem::ParallelForJob(void* pData, unsigned begin, unsigned end)
+{
+	ParallelForData* pFor = (ParallelForData*)pData;
+
+	//Queue the upper halves, largest first, so thieves take big pieces
+	while(end - begin > pFor->GrainSize)
+	{
+		unsigned mid = begin + (end - begin) / 2;
+		pFor->pSystem->Run(ParallelForJob, pFor, &pFor->Counter, mid, end);
+		end = mid;
+	}
+	pFor->Function(pFor->pData, begin, end);
+}
+
+void JobSystem::Push(const Job& job)
+{
+	if(!IsRunning())
+	{
+		Execute(job);
+		return;
+	}
+
+	unsigned threadIndex = GetThreadIndex();
+	if(threadIndex < GetThreadCount())
+	{
+		//A full deque means plenty of queued work already, just run it here
+		if(!m_Deques[threadIndex]->Push(job))
+		{
+			Execute(job);
+			return;
+		}
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock(m_ExternalLock);
+		m_External.push_back(job);
+		m_ExternalCount.fetch_add(1, std::memory_order_release);
+	}
+
+	//Wake a sleeping worker. Sleepers compare the generation under m_SleepLock,
+	//so either they see the new generation or we see them sleeping.
+	m_Generation.fetch_add(1, std::memory_order_seq_cst);
+	if(m_Sleeping.load(std::memory_order_seq_cst) != 0)
+	{
+		std::lock_guard<std::mutex> lock(m_SleepLock);
+		m_WakeUp.notify_one();
+	}
+}
+
+bool JobSystem::FindJob(unsigned threadIndex, Job* pJob)
+{
+	unsigned numThreads = GetThreadCount();
+
+	//Own deque first (most recent job, warm in cache)
+	if(threadIndex < numThreads && m_Deques[threadIndex]->Pop(pJob))
+		return true;
+
+	//Jobs from outside threads
+	if(m_ExternalCount.load(std::memory_order_acquire) != 0)
+	{
+		std::lock_guard<std::mutex> lock(m_ExternalLock);
+		if(!m_External.empty())
+		{
+			*pJob = m_External.back();
+			m_External.pop_back();
+			m_ExternalCount.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	//Steal the oldest job of another thread, starting with the next one
+	for(unsigned i = 1; i <= numThreads; ++i)
+	{
+		unsigned victim = (threadIndex + i) % numThreads;
+		if(victim != threadIndex && m_Deques[victim]->Steal(pJob))
+			return true;
+	}
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	PROFILE_ZONE("Job");
+	job.Function(job.pData, job.Begin, job.End);
+	if(job.pCounter)
+		Finish(job.pCounter);
+}
+
+void JobSystem::Finish(JobCounter* pCounter)
+{
+	int pending = pCounter->m_Pending.fetch_sub(1, std::memory_order_acq_rel);
+	if(pending != (JobCounter::HAS_CONTINUATIONS | 1))
+		return;
+
+	//Last job with continuations queued. The flag keeps waiters from returning
+	//(and destroying the counter) until we are done with it.
+	std::vector<Job> continuations;
+	{
+		std::lock_guard<std::mutex> lock(pCounter->m_ContinuationLock);
+		continuations.swap(pCounter->m_Continuations);
+	}
+	pCounter->m_Pending.fetch_and(~JobCounter::HAS_CONTINUATIONS, std::memory_order_release);
+
+	for(size_t i = 0; i < continuations.size(); ++i)
+		Push(continuations[i]);
+}
+
+void JobSystem::WorkerMain(unsigned threadIndex)
+{
+	t_pJobSystem = this;
+	t_JobThreadIndex = threadIndex;
+	PROFILE_THREAD("Job worker");
+
+	unsigned idle = 0;
+	for(;;)
+	{
+		unsigned generation = m_Generation.load(std::memory_order_seq_cst);
+
+		Job job;
+		if(FindJob(threadIndex, &job))
+		{
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+
+		//Spin a little before sleeping, new jobs usually arrive in bursts
+		if(++idle < IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_SleepLock);
+		if(m_Quit)
+			break;
+		m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+		while(!m_Quit && m_Generation.load(std::memory_order_seq_cst) == generation)
+			m_WakeUp.wait(lock);
+		m_Sleeping.fetch_sub(1, std::memory_order_seq_cst);
+		if(m_Quit)
+			break;
+		idle = 0;
+	}
+}
@@ -0,0 +1,145 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Work stealing job system. Every worker owns a lock-free deque;
+				it pushes and pops at the bottom while idle workers steal from
+				the top. Jobs are tracked with counters that can be waited on
+				(the waiting thread runs jobs meanwhile) or used as dependencies.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//Every job processes a range; single jobs are run with the range [0, 1)
+typedef void (*JobFunction)(void* pData, unsigned begin, unsigned end);
+
+struct Job
+{
+	JobFunction		Function;
+	void*			pData;
+	unsigned		Begin;
+	unsigned		End;
+	class JobCounter* pCounter;	//Decremented when the job finished, may be NULL
+};
+
+//Number of unfinished jobs. Jobs queued with RunAfter() start once it drops to zero.
+//A counter must not be reused while jobs are still queued after it.
+class JobCounter
+{
+public:
+	JobCounter() : m_Pending(0) {}
+
+	//Also false while the last job hands over its continuations
+	bool IsDone() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	//Disallow copying
+	JobCounter(const JobCounter&);
+	JobCounter& operator=(const JobCounter&);
+
+	//Set in m_Pending while continuations are queued, so the counter does not
+	//read as done until the last job stopped touching it
+	enum { HAS_CONTINUATIONS = 0x40000000, COUNT_MASK = HAS_CONTINUATIONS - 1 };
+
+	std::atomic<int>	m_Pending;
+	std::mutex			m_ContinuationLock;
+	std::vector<Job>	m_Continuations;
+};
+
+//Fixed size Chase-Lev deque. Only the owner thread calls Push/Pop, any thread may Steal.
+class JobDeque
+{
+public:
+	enum { CAPACITY = 4096 };
+
+	JobDeque() : m_Top(0), m_Bottom(0) {}
+
+	//Returns false when full
+	bool Push(const Job& job);
+	bool Pop(Job* pJob);
+	bool Steal(Job* pJob);
+
+	bool IsEmpty() const { return m_Bottom.load(std::memory_order_relaxed) <= m_Top.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<int64_t>	m_Top;
+	char					m_Pad[64];	//Keep thieves and the owner on different cache lines
+	std::atomic<int64_t>	m_Bottom;
+	Job						m_Jobs[CAPACITY];
+};
+
+typedef void (*ParallelForFunction)(void* pData, unsigned begin, unsigned end);
+
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	//Starts the workers. The calling thread becomes thread 0 and runs jobs while
+	//it waits. numThreads = 0 uses one thread per hardware core.
+	bool Init(unsigned numThreads = 0);
+	void Shutdown();
+
+	bool IsRunning() const { return !m_Deques.empty(); }
+	//Worker threads plus the thread that called Init
+	unsigned GetThreadCount() const { return (unsigned)m_Deques.size(); }
+	//Index of the calling thread, or GetThreadCount() for threads outside the system
+	unsigned GetThreadIndex() const;
+
+	//Queues a job; pCounter (may be NULL) is incremented now and decremented when it finished
+	void Run(JobFunction function, void* pData, JobCounter* pCounter, unsigned begin = 0, unsigned end = 1);
+	//Queues a job that starts once pDependency reached zero
+	void RunAfter(JobCounter* pDependency, JobFunction function, void* pData, JobCounter* pCounter);
+	//Runs jobs until pCounter reached zero
+	void Wait(JobCounter* pCounter);
+
+	//Calls function on subranges of [0, count) no larger than grainSize and
+	//returns when all of them finished. Ranges are split recursively, so idle
+	//workers steal large halves first. Safe to nest inside jobs.
+	void ParallelFor(unsigned count, unsigned grainSize, ParallelForFunction function, void* pData);
+
+private:
+	//Disallow copying
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	struct ParallelForData
+	{
+		JobSystem*			pSystem;
+		ParallelForFunction	Function;
+		void*				pData;
+		unsigned			GrainSize;
+		JobCounter			Counter;
+	};
+
+	void Push(const Job& job);
+	bool FindJob(unsigned threadIndex, Job* pJob);
+	void Execute(const Job& job);
+	void Finish(JobCounter* pCounter);
+	void WorkerMain(unsigned threadIndex);
+
+	static void ParallelForJob(void* pData, unsigned begin, unsigned end);
+
+	std::vector<JobDeque*>		m_Deques;		//One per thread, index 0 is the Init thread
+	std::vector<std::thread>	m_Workers;
+
+	//Jobs pushed from threads outside the system
+	std::mutex					m_ExternalLock;
+	std::vector<Job>			m_External;
+	std::atomic<unsigned>		m_ExternalCount;
+
+	//Idle workers sleep until the generation changes
+	std::mutex					m_SleepLock;
+	std::condition_variable		m_WakeUp;
+	std::atomic<unsigned>		m_Generation;
+	std::atomic<unsigned>		m_Sleeping;
+	bool						m_Quit;
+};
@@ -0,0 +1,248 @@
+#include "LodBenchmark.h"
+#include "LodSelector.h"
+#include "Culling.h"
+#include "VertexLayout.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned OBJECT_COUNT = 200000;
+	const unsigned FRAMES = 200;
+	const unsigned VIEWPORT_HEIGHT = 1080;
+	const float PIXEL_ERROR = 1.0f;
+	const float HYSTERESIS = 0.25f;
+
+	struct LodMesh
+	{
+		const char*							pName;
+		std::vector<PositionColorVertex>	Vertices;
+		std::vector<uint32_t>				Indices;
+		std::vector<MeshLodLevel>			Levels;
+		float								Radius;
+	};
+
+	//Latitude and longitude sphere with one vertex per pole and no seam, the
+	//radius scaled by bumps(theta, phi)
+	void MakeSphere(LodMesh& mesh, unsigned rings, unsigned segments, float bumps)
+	{
+		mesh.Vertices.clear();
+		mesh.Radius = 0.0f;
+		for(unsigned ring = 0; ring <= rings; ++ring)
+		{
+			float theta = MATH_PI * ring / rings;
+			unsigned count = ring == 0 || ring == rings ? 1 : segments;
+			for(unsigned segment = 0; segment < count; ++segment)
+			{
+				float phi = 2.0f * MATH_PI * segment / segments;
+				float radius = 1.0f + bumps * (sinf(5.0f * theta) * sinf(7.0f * phi) + 0.5f * sinf(13.0f * theta + 3.0f * phi));
+				PositionColorVertex v = { radius * sinf(theta) * cosf(phi), radius * cosf(theta), radius * sinf(theta) * sinf(phi),
+					0xFF000000 | ring * 255 / rings << 8 };
+				mesh.Vertices.push_back(v);
+				mesh.Radius = std::max(mesh.Radius, radius);
+			}
+		}
+
+		//Ring r (0 < r < rings) starts at 1 + (r - 1) * segments
+		std::vector<uint32_t> indices;
+		uint32_t south = (uint32_t)mesh.Vertices.size() - 1;
+		for(unsigned segment = 0; segment < segments; ++segment)
+		{
+			uint32_t next = (segment + 1) % segments;
+			indices.push_back(0);
+			indices.push_back(1 + next);
+			indices.push_back(1 + segment);
+			for(unsigned ring = 1; ring + 1 < rings; ++ring)
+			{
+				uint32_t a = 1 + (ring - 1) * segments + segment, b = 1 + (ring - 1) * segments + next;
+				uint32_t c = a + segments, d = b + segments;
+				indices.push_back(a);
+				indices.push_back(b);
+				indices.push_back(c);
+				indices.push_back(c);
+				indices.push_back(b);
+				indices.push_back(d);
+			}
+			uint32_t last = 1 + (rings - 2) * segments;
+			indices.push_back(last + segment);
+			indices.push_back(last + next);
+			indices.push_back(south);
+		}
+
+		mesh.Indices.clear();
+		mesh.Levels.clear();
+		MeshGenerateLods(&mesh.Indices, &mesh.Levels, &indices[0], (unsigned)indices.size(), &mesh.Vertices[0],
+			(unsigned)mesh.Vertices.size(), sizeof(PositionColorVertex));
+	}
+
+	//Every edge used by exactly two triangles, none degenerate
+	bool IsClosed(const uint32_t* pIndices, unsigned indexCount)
+	{
+		std::vector<uint64_t> edges;
+		for(unsigned i = 0; i < indexCount; i += 3)
+		{
+			for(int corner = 0; corner < 3; ++corner)
+			{
+				uint32_t a = pIndices[i + corner], b = pIndices[i + (corner + 1) % 3];
+				if(a == b)
+					return false;
+				edges.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for(size_t i = 0; i < edges.size(); i += 2)
+		{
+			if(i + 1 >= edges.size() || edges[i] != edges[i + 1] || (i + 2 < edges.size() && edges[i + 2] == edges[i]))
+				return false;
+		}
+		return true;
+	}
+
+	struct LodScene
+	{
+		std::vector<float>		X, Y, Z, Radius;
+		std::vector<uint32_t>	Models;
+	};
+
+	struct FlightResult
+	{
+		double		Visible;			//Per frame
+		double		FullTriangles;
+		double		Triangles;
+		double		Switches;
+		double		SelectMs;
+		unsigned	Violations;			//Selected levels over the pixel error
+	};
+
+	//Flies the camera forward, or back and forth around one spot when oscillate is set,
+	//and selects levels of the visible objects every frame
+	FlightResult Fly(const LodScene& scene, const LodMesh* pMeshes, unsigned meshCount, float hysteresis, bool oscillate,
+		JobSystem* pJobs)
+	{
+		Mat4 proj = Mat4PerspectiveFovLH(MATH_PI / 4, 16.0f / 9.0f, 1.0f, 1000.0f);
+		Culler culler;
+		culler.Init(OBJECT_COUNT, 0, 0);
+		LodSelector lod;
+		lod.Init(OBJECT_COUNT);
+		lod.SetThreshold(PIXEL_ERROR, hysteresis);
+		for(unsigned i = 0; i < meshCount; ++i)
+			lod.AddModel(&pMeshes[i].Levels[0], (unsigned)pMeshes[i].Levels.size(), pMeshes[i].Radius);
+
+		FlightResult result = { 0.0, 0.0, 0.0, 0.0, 0.0, 0 };
+		const unsigned WARMUP = 20;
+		for(unsigned frame = 0; frame < WARMUP + FRAMES; ++frame)
+		{
+			float z = oscillate ? sinf(frame * 0.9f) * 1.0f : -500.0f + frame * 4.0f;
+			Vec3 eye(0.0f, 10.0f, z);
+			culler.SetCamera(Mat4LookAtLH(eye, Vec3(0.0f, 10.0f, z + 1.0f), Vec3(0.0f, 1.0f, 0.0f)), proj);
+			unsigned visible = culler.CullSpheres(&scene.X[0], &scene.Y[0], &scene.Z[0], &scene.Radius[0], OBJECT_COUNT, pJobs);
+			lod.SetCamera(eye, proj, VIEWPORT_HEIGHT);
+			lod.Select(&scene.X[0], &scene.Y[0], &scene.Z[0], &scene.Radius[0], &scene.Models[0], culler.GetVisible(), visible,
+				pJobs);
+			if(frame < WARMUP)
+				continue;
+
+			const LodStats& stats = lod.GetStats();
+			result.Visible += visible;
+			result.FullTriangles += (double)stats.FullTriangles;
+			result.Triangles += (double)stats.Triangles;
+			result.Switches += stats.Switches;
+			result.SelectMs += stats.SelectMs;
+
+			for(unsigned i = 0; i < visible; ++i)
+			{
+				unsigned object = culler.GetVisible()[i];
+				const LodMesh& mesh = pMeshes[scene.Models[object]];
+				float error = mesh.Levels[lod.GetLevel(object)].Error * scene.Radius[object] / mesh.Radius;
+				Vec3 center(scene.X[object], scene.Y[object], scene.Z[object]);
+				if(lod.ProjectError(error, center, scene.Radius[object]) > PIXEL_ERROR * 1.001f)
+					++result.Violations;
+			}
+		}
+		result.Visible /= FRAMES;
+		result.FullTriangles /= FRAMES;
+		result.Triangles /= FRAMES;
+		result.Switches /= FRAMES;
+		result.SelectMs /= FRAMES;
+		return result;
+	}
+}
+
+bool RunLodBenchmarks(FILE* pOut)
+{
+	JobSystem jobs;
+	jobs.Init();
+	fprintf(pOut, "Level of detail (%u threads)\n", jobs.GetThreadCount());
+	bool ok = true;
+
+	LodMesh meshes[2];
+	meshes[0].pName = "sphere";
+	meshes[1].pName = "rock";
+	for(int m = 0; m < 2; ++m)
+	{
+		LodMesh& mesh = meshes[m];
+		int64_t start = TimerTicks();
+		if(m == 0)
+			MakeSphere(mesh, 64, 128, 0.0f);
+		else
+			MakeSphere(mesh, 96, 192, 0.06f);
+		fprintf(pOut, "%-8s %u vertices, %u levels in %.1f ms:", mesh.pName, (unsigned)mesh.Vertices.size(),
+			(unsigned)mesh.Levels.size(), TicksToMs(TimerTicks() - start));
+
+		bool meshOk = mesh.Levels.size() >= 4;
+		for(size_t i = 0; i < mesh.Levels.size(); ++i)
+		{
+			const MeshLodLevel& level = mesh.Levels[i];
+			fprintf(pOut, " %u (%.4f)", level.IndexCount / 3, level.Error / mesh.Radius);
+			meshOk = meshOk && IsClosed(&mesh.Indices[level.IndexOffset], level.IndexCount);
+			if(i > 0)
+				meshOk = meshOk && level.IndexCount < mesh.Levels[i - 1].IndexCount && level.Error >= mesh.Levels[i - 1].Error;
+		}
+		fprintf(pOut, " triangles (error per radius)%s\n", meshOk ? "" : ", FAILED");
+		ok = ok && meshOk;
+	}
+
+	//Objects scattered over a 2 km square, every other one a rock
+	LodScene scene;
+	scene.X.resize(OBJECT_COUNT);
+	scene.Y.resize(OBJECT_COUNT);
+	scene.Z.resize(OBJECT_COUNT);
+	scene.Radius.resize(OBJECT_COUNT);
+	scene.Models.resize(OBJECT_COUNT);
+	uint32_t seed = 2323;
+	for(unsigned i = 0; i < OBJECT_COUNT; ++i)
+	{
+		scene.X[i] = RandomFloat(seed) * 2000.0f - 1000.0f;
+		scene.Y[i] = RandomFloat(seed) * 20.0f;
+		scene.Z[i] = RandomFloat(seed) * 2000.0f - 1000.0f;
+		scene.Radius[i] = 1.0f + RandomFloat(seed) * 2.0f;
+		scene.Models[i] = i % 2;
+	}
+
+	fprintf(pOut, "%u objects, %u px viewport, %.1f px error, %u frames\n", OBJECT_COUNT, VIEWPORT_HEIGHT, PIXEL_ERROR, FRAMES);
+	FlightResult plain = Fly(scene, meshes, 2, 0.0f, false, &jobs);
+	FlightResult damped = Fly(scene, meshes, 2, HYSTERESIS, false, &jobs);
+	FlightResult singleThread = Fly(scene, meshes, 2, HYSTERESIS, false, NULL);
+	fprintf(pOut, "Triangles per frame: LOD off %.0f, LOD on %.0f (%.1f%%), %.0f visible objects\n", damped.FullTriangles,
+		damped.Triangles, 100.0 * damped.Triangles / damped.FullTriangles, damped.Visible);
+	fprintf(pOut, "Selection: %.3f ms per frame, %.3f ms on 1 thread\n", damped.SelectMs, singleThread.SelectMs);
+
+	FlightResult plainStill = Fly(scene, meshes, 2, 0.0f, true, &jobs);
+	FlightResult dampedStill = Fly(scene, meshes, 2, HYSTERESIS, true, &jobs);
+	fprintf(pOut, "Level switches per frame, flying: %.1f without hysteresis, %.1f with %.0f%%\n", plain.Switches,
+		damped.Switches, HYSTERESIS * 100.0f);
+	fprintf(pOut, "Level switches per frame, swaying 1 m: %.1f without hysteresis, %.1f with %.0f%%\n", plainStill.Switches,
+		dampedStill.Switches, HYSTERESIS * 100.0f);
+
+	unsigned violations = plain.Violations + damped.Violations + plainStill.Violations + dampedStill.Violations;
+	fprintf(pOut, "Error check: %u selections over %.1f px\n", violations, PIXEL_ERROR);
+	ok = ok && violations == 0 && damped.Triangles < damped.FullTriangles * 0.5 && dampedStill.Switches < plainStill.Switches;
+	fprintf(pOut, "Level of detail %s\n", ok ? "works" : "FAILED");
+
+	jobs.Shutdown();
+	return ok;
+}
@@ -0,0 +1,16 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Level of detail benchmark: simplifies a sphere and a bumpy rock
+				into chains of levels, then flies a camera through 200k of them
+				and reports triangles submitted per frame with LOD off and on,
+				selection time, and how often objects switch levels with and
+				without hysteresis. Checks that every level stays a closed
+				surface and that no selected level exceeds the pixel error.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunLodBenchmarks(FILE* pOut);
@@ -0,0 +1,173 @@
+#include "LodSelector.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	//Distance used for objects the camera is inside of
+	const float LOD_MIN_DISTANCE = 1e-3f;
+}
+
+LodSelector::LodSelector() : m_Eye(0.0f, 0.0f, 0.0f), m_Switches(0), m_Triangles(0), m_FullTriangles(0)
+{
+	for(unsigned i = 0; i < LOD_MAX_LEVELS; ++i)
+		m_LevelCounts[i].store(0, std::memory_order_relaxed);
+	m_PixelsPerError = 1.0f;
+	SetThreshold(1.0f, 0.25f);
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+void LodSelector::Init(unsigned maxObjects)
+{
+	m_Levels.assign(maxObjects, 0);
+}
+
+void LodSelector::SetThreshold(float pixelError, float hysteresis)
+{
+	m_PixelError = pixelError;
+	m_CoarsenScale = 1.0f / (1.0f + std::max(hysteresis, 0.0f));
+	m_ErrorPerDistance = m_PixelError / m_PixelsPerError;
+}
+
+void LodSelector::SetCamera(const Vec3& eye, const Mat4& proj, unsigned viewportHeight)
+{
+	//_22 of a perspective projection is cot(fovY / 2): at distance 1 the viewport spans 2 / _22 units
+	m_Eye = eye;
+	m_PixelsPerError = proj.m[1][1] * viewportHeight * 0.5f;
+	m_ErrorPerDistance = m_PixelError / m_PixelsPerError;
+}
+
+unsigned LodSelector::AddModel(const MeshLodLevel* pLevels, unsigned levelCount, float radius)
+{
+	levelCount = std::max(std::min(levelCount, LOD_MAX_LEVELS), 1u);
+	m_ModelFirst.push_back((uint32_t)m_ModelLevels.size());
+	m_ModelLevelCount.push_back(levelCount);
+	m_ModelRadius.push_back(radius > 0.0f ? radius : 1.0f);
+
+	//Errors must not shrink towards coarser levels, or selection would skip levels
+	float error = 0.0f;
+	for(unsigned i = 0; i < levelCount; ++i)
+	{
+		MeshLodLevel level = pLevels[i];
+		error = level.Error = std::max(level.Error, error);
+		m_ModelLevels.push_back(level);
+	}
+	return (unsigned)m_ModelFirst.size() - 1;
+}
+
+float LodSelector::ProjectError(float error, const Vec3& center, float radius) const
+{
+	float distance = std::max(Vec3Length(center - m_Eye) - radius, LOD_MIN_DISTANCE);
+	return error * m_PixelsPerError / distance;
+}
+
+void LodSelector::Select(const float* pX, const float* pY, const float* pZ, const float* pRadius, const uint32_t* pModels,
+	const uint32_t* pObjects, unsigned count, JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+	m_Switches.store(0, std::memory_order_relaxed);
+	m_Triangles.store(0, std::memory_order_relaxed);
+	m_FullTriangles.store(0, std::memory_order_relaxed);
+	for(unsigned i = 0; i < LOD_MAX_LEVELS; ++i)
+		m_LevelCounts[i].store(0, std::memory_order_relaxed);
+
+	//Only grows when more objects than Init() announced show up
+	if(!pObjects && m_Levels.size() < count)
+		m_Levels.resize(count, 0);
+
+	SelectData data = { this, pX, pY, pZ, pRadius, pModels, pObjects };
+	if(pJobs && pJobs->IsRunning() && count > CHUNK_SIZE)
+		pJobs->ParallelFor(count, CHUNK_SIZE, SelectChunkJob, &data);
+	else
+		SelectRange(data, 0, count);
+
+	m_Stats.Objects = count;
+	m_Stats.Switches = m_Switches.load(std::memory_order_relaxed);
+	m_Stats.Triangles = m_Triangles.load(std::memory_order_relaxed);
+	m_Stats.FullTriangles = m_FullTriangles.load(std::memory_order_relaxed);
+	for(unsigned i = 0; i < LOD_MAX_LEVELS; ++i)
+		m_Stats.Levels[i] = m_LevelCounts[i].load(std::memory_order_relaxed);
+	m_Stats.SelectMs = TicksToMs(TimerTicks() - start);
+}
+
+void LodSelector::SelectChunkJob(void* pData, unsigned begin, unsigned end)
+{
+	SelectData* pChunk = (SelectData*)pData;
+	pChunk->pSelector->SelectRange(*pChunk, begin, end);
+}
+
+void LodSelector::SelectObject(const SelectData& data, unsigned object, float allowed, SelectCounts& counts)
+{
+	uint32_t model = data.pModels ? data.pModels[object] : 0;
+	const MeshLodLevel* pLevels = &m_ModelLevels[m_ModelFirst[model]];
+	unsigned levelCount = m_ModelLevelCount[model];
+	if(data.pRadius[object] > 0.0f)
+		allowed *= m_ModelRadius[model] / data.pRadius[object];
+
+	//Coarsest level within the allowed error
+	unsigned current = std::min((unsigned)m_Levels[object], levelCount - 1);
+	unsigned level = 0;
+	while(level + 1 < levelCount && pLevels[level + 1].Error <= allowed)
+		++level;
+	//Finer levels are taken at once, coarser ones only well within the error
+	if(level > current)
+	{
+		float strict = allowed * m_CoarsenScale;
+		level = current;
+		while(level + 1 < levelCount && pLevels[level + 1].Error <= strict)
+			++level;
+	}
+
+	counts.Switches += level != m_Levels[object];
+	counts.Triangles += pLevels[level].IndexCount / 3;
+	counts.FullTriangles += pLevels[0].IndexCount / 3;
+	++counts.Levels[level];
+	m_Levels[object] = (uint8_t)level;
+}
+
+void LodSelector::SelectRange(const SelectData& data, unsigned begin, unsigned end)
+{
+	SelectCounts counts;
+	memset(&counts, 0, sizeof(counts));
+
+	//Distances to the nearest point of four spheres at once when they are contiguous
+	unsigned i = begin;
+#if defined(SIMDMATH_SSE)
+	if(!data.pObjects)
+	{
+		__m128 eyeX = _mm_set1_ps(m_Eye.x), eyeY = _mm_set1_ps(m_Eye.y), eyeZ = _mm_set1_ps(m_Eye.z);
+		__m128 minDistance = _mm_set1_ps(LOD_MIN_DISTANCE), scale = _mm_set1_ps(m_ErrorPerDistance);
+		for(; i + 4 <= end; i += 4)
+		{
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(data.pX + i), eyeX);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(data.pY + i), eyeY);
+			__m128 dz = _mm_sub_ps(_mm_loadu_ps(data.pZ + i), eyeZ);
+			__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			distance = _mm_max_ps(_mm_sub_ps(distance, _mm_loadu_ps(data.pRadius + i)), minDistance);
+			float allowed[4];
+			_mm_storeu_ps(allowed, _mm_mul_ps(distance, scale));
+			for(unsigned lane = 0; lane < 4; ++lane)
+				SelectObject(data, i + lane, allowed[lane], counts);
+		}
+	}
+#endif
+	for(; i < end; ++i)
+	{
+		unsigned object = data.pObjects ? data.pObjects[i] : i;
+		Vec3 center(data.pX[object], data.pY[object], data.pZ[object]);
+		float distance = std::max(Vec3Length(center - m_Eye) - data.pRadius[object], LOD_MIN_DISTANCE);
+		SelectObject(data, object, distance * m_ErrorPerDistance, counts);
+	}
+
+	m_Switches.fetch_add(counts.Switches, std::memory_order_relaxed);
+	m_Triangles.fetch_add(counts.Triangles, std::memory_order_relaxed);
+	m_FullTriangles.fetch_add(counts.FullTriangles, std::memory_order_relaxed);
+	for(unsigned level = 0; level < LOD_MAX_LEVELS; ++level)
+	{
+		if(counts.Levels[level])
+			m_LevelCounts[level].fetch_add(counts.Levels[level], std::memory_order_relaxed);
+	}
+}
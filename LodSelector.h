@@ -0,0 +1,115 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Level of detail selection run after culling. Picks a level of
+				its chain (see MeshLod.h) for every object from the error the
+				level would show on screen at the object's distance, four objects
+				per SIMD batch and in parallel chunks on the job system. Finer
+				levels are taken at once; coarser ones only when they are well
+				within the allowed error, so objects near a threshold do not pop
+				back and forth.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "MeshLod.h"
+#include "SimdMath.h"
+
+#include <vector>
+#include <atomic>
+
+class JobSystem;
+
+struct LodStats
+{
+	unsigned	Objects;					//Selected by the last call
+	unsigned	Switches;					//Objects whose level changed
+	uint64_t	Triangles;					//At the selected levels
+	uint64_t	FullTriangles;				//Had every object been drawn at level 0
+	unsigned	Levels[LOD_MAX_LEVELS];		//Objects per level
+	double		SelectMs;
+};
+
+class LodSelector
+{
+public:
+	//Objects per parallel chunk
+	enum { CHUNK_SIZE = 4096 };
+
+	LodSelector();
+
+	//Sizes the per object levels for maxObjects, every object starts at level 0.
+	//Object indices passed to Select() in pObjects must be below maxObjects.
+	void Init(unsigned maxObjects);
+	//A level may show up to pixelError pixels of error. Switching to a coarser level
+	//needs its error to be hysteresis (0.25 is 25%) below that.
+	void SetThreshold(float pixelError, float hysteresis);
+	void SetCamera(const Vec3& eye, const Mat4& proj, unsigned viewportHeight);
+
+	//Registers a chain, levels fine to coarse. radius is the bounding radius of the
+	//mesh, objects of a different radius scale its errors. Returns the model index.
+	unsigned AddModel(const MeshLodLevel* pLevels, unsigned levelCount, float radius);
+	unsigned GetModelCount() const { return (unsigned)m_ModelFirst.size(); }
+	const MeshLodLevel& GetModelLevel(unsigned model, unsigned level) const { return m_ModelLevels[m_ModelFirst[model] + level]; }
+
+	//Selects levels of the objects in pObjects (e.g. a Culler's visible list), or of
+	//objects 0 .. count - 1 when NULL. Bounding spheres and model indices are per
+	//object, every other object keeps its level. With pJobs in parallel chunks.
+	void Select(const float* pX, const float* pY, const float* pZ, const float* pRadius, const uint32_t* pModels,
+		const uint32_t* pObjects, unsigned count, JobSystem* pJobs = NULL);
+
+	unsigned GetLevel(unsigned object) const { return m_Levels[object]; }
+	const uint8_t* GetLevels() const { return m_Levels.empty() ? NULL : &m_Levels[0]; }
+	const LodStats& GetStats() const { return m_Stats; }
+
+	//Pixels a geometric error (in world units) covers at the nearest point of a sphere
+	float ProjectError(float error, const Vec3& center, float radius) const;
+
+private:
+	//Disallow copying
+	LodSelector(const LodSelector&);
+	LodSelector& operator=(const LodSelector&);
+
+	struct SelectData
+	{
+		LodSelector*	pSelector;
+		const float*	pX;
+		const float*	pY;
+		const float*	pZ;
+		const float*	pRadius;
+		const uint32_t*	pModels;
+		const uint32_t*	pObjects;
+	};
+
+	struct SelectCounts
+	{
+		unsigned	Switches;
+		uint64_t	Triangles;
+		uint64_t	FullTriangles;
+		unsigned	Levels[LOD_MAX_LEVELS];
+	};
+
+	//allowed is the error in world units the object may show
+	void SelectObject(const SelectData& data, unsigned object, float allowed, SelectCounts& counts);
+	void SelectRange(const SelectData& data, unsigned begin, unsigned end);
+
+	static void SelectChunkJob(void* pData, unsigned begin, unsigned end);
+
+	Vec3						m_Eye;
+	float						m_ErrorPerDistance;		//World units of error per unit of distance that make pixelError
+	float						m_PixelsPerError;		//At distance 1
+	float						m_PixelError;
+	float						m_CoarsenScale;			//1 / (1 + hysteresis)
+
+	std::vector<uint32_t>		m_ModelFirst;			//First level of each model
+	std::vector<uint32_t>		m_ModelLevelCount;
+	std::vector<float>			m_ModelRadius;
+	std::vector<MeshLodLevel>	m_ModelLevels;
+
+	std::vector<uint8_t>		m_Levels;				//Current level of every object
+
+	std::atomic<unsigned>		m_Switches;
+	std::atomic<uint64_t>		m_Triangles;
+	std::atomic<uint64_t>		m_FullTriangles;
+	std::atomic<unsigned>		m_LevelCounts[LOD_MAX_LEVELS];
+	LodStats					m_Stats;
+};
@@ -0,0 +1,131 @@
+#include "MathBenchmark.h"
+#include "SimdMath.h"
+#include "VertexLayout.h"
+#include "Timer.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned VERTEX_COUNT = 1000000;
+	const int RUNS = 10;
+
+	typedef void (*TransformFunction)(const Mat4&, const void*, size_t, void*, size_t, size_t);
+
+	//Best of RUNS, in milliseconds
+	double TimeTransform(TransformFunction function, const Mat4& m, const std::vector<PositionColorVertex>& in, std::vector<PositionColorVertex>& out)
+	{
+		double best = 1e30;
+		for(int run = 0; run < RUNS; ++run)
+		{
+			int64_t start = TimerTicks();
+			function(m, &in[0], sizeof(PositionColorVertex), &out[0], sizeof(PositionColorVertex), in.size());
+			best = std::min(best, TicksToMs(TimerTicks() - start));
+		}
+		return best;
+	}
+
+	void ScalarAABBs(const Frustum& f, const AABB* pBoxes, size_t count, uint8_t* pVisible)
+	{
+		for(size_t i = 0; i < count; ++i)
+		{
+			const AABB& box = pBoxes[i];
+			bool visible = true;
+			for(int p = 0; p < Frustum::PLANE_COUNT && visible; ++p)
+			{
+				const Plane& pl = f.Planes[p];
+				//Corner furthest along the plane normal
+				float x = pl.a >= 0.0f ? box.Max.x : box.Min.x;
+				float y = pl.b >= 0.0f ? box.Max.y : box.Min.y;
+				float z = pl.c >= 0.0f ? box.Max.z : box.Min.z;
+				visible = pl.a * x + pl.b * y + pl.c * z + pl.d >= 0.0f;
+			}
+			pVisible[i] = visible ? 1 : 0;
+		}
+	}
+}
+
+bool RunMathBenchmarks(FILE* pOut)
+{
+#if defined(SIMDMATH_AVX)
+	const char* pPath = "AVX";
+#elif defined(SIMDMATH_SSE)
+	const char* pPath = "SSE";
+#else
+	const char* pPath = "scalar";
+#endif
+	fprintf(pOut, "SimdMath (%s path)\n", pPath);
+
+	//Pseudo random positions in a 200 unit cube
+	std::vector<PositionColorVertex> in(VERTEX_COUNT);
+	uint32_t seed = 12345;
+	for(unsigned i = 0; i < VERTEX_COUNT; ++i)
+	{
+		float* p = &in[i].x;
+		for(int c = 0; c < 3; ++c)
+			p[c] = RandomFloat(seed) * 200.0f - 100.0f;
+		in[i].Color = i;
+	}
+	std::vector<PositionColorVertex> outScalar(in), outSimd(in);
+
+	Mat4 view = Mat4LookAtLH(Vec3(10.0f, 20.0f, -150.0f), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+	Mat4 proj = Mat4PerspectiveFovLH(MATH_PI / 4.0f, 16.0f / 9.0f, 1.0f, 1000.0f);
+	Mat4 world = Mat4Multiply(Mat4RotationY(0.7f), Mat4Translation(1.0f, 2.0f, 3.0f));
+	Mat4 m = Mat4Multiply(world, view);
+
+	double scalarMs = TimeTransform(TransformPositionsScalar, m, in, outScalar);
+	double simdMs = TimeTransform(TransformPositions, m, in, outSimd);
+
+	//Both paths compute the same sums in a different order, allow rounding differences
+	float maxError = 0.0f;
+	bool colorsKept = true;
+	for(unsigned i = 0; i < VERTEX_COUNT; ++i)
+	{
+		maxError = std::max(maxError, fabsf(outScalar[i].x - outSimd[i].x));
+		maxError = std::max(maxError, fabsf(outScalar[i].y - outSimd[i].y));
+		maxError = std::max(maxError, fabsf(outScalar[i].z - outSimd[i].z));
+		colorsKept = colorsKept && outSimd[i].Color == i;
+	}
+	bool transformOk = maxError < 1e-3f;
+
+	//The transform must leave everything after the position alone
+	fprintf(pOut, "Transform %u positions: scalar %.3f ms (%.0f Mvert/s), simd %.3f ms (%.0f Mvert/s), %.2fx, max error %g%s\n",
+		VERTEX_COUNT, scalarMs, VERTEX_COUNT / (scalarMs * 1000.0), simdMs, VERTEX_COUNT / (simdMs * 1000.0),
+		scalarMs / simdMs, maxError, colorsKept ? "" : ", COLORS OVERWRITTEN");
+
+	//Boxes around the same positions
+	std::vector<AABB> boxes(VERTEX_COUNT);
+	for(unsigned i = 0; i < VERTEX_COUNT; ++i)
+	{
+		Vec3 c(in[i].x, in[i].y, in[i].z);
+		float r = 0.5f + (i % 7) * 0.25f;
+		boxes[i].Min = c - Vec3(r, r, r);
+		boxes[i].Max = c + Vec3(r, r, r);
+	}
+	Frustum f = FrustumFromMatrix(Mat4Multiply(view, proj));
+	std::vector<uint8_t> visibleScalar(VERTEX_COUNT), visibleSimd(VERTEX_COUNT);
+
+	double scalarCullMs = 1e30, simdCullMs = 1e30;
+	for(int run = 0; run < RUNS; ++run)
+	{
+		int64_t start = TimerTicks();
+		ScalarAABBs(f, &boxes[0], boxes.size(), &visibleScalar[0]);
+		int64_t mid = TimerTicks();
+		FrustumTestAABBs(f, &boxes[0], boxes.size(), &visibleSimd[0]);
+		int64_t end = TimerTicks();
+		scalarCullMs = std::min(scalarCullMs, TicksToMs(mid - start));
+		simdCullMs = std::min(simdCullMs, TicksToMs(end - mid));
+	}
+
+	unsigned visible = 0, mismatches = 0;
+	for(unsigned i = 0; i < VERTEX_COUNT; ++i)
+	{
+		visible += visibleSimd[i];
+		mismatches += visibleSimd[i] != visibleScalar[i];
+	}
+	fprintf(pOut, "Frustum test %u boxes: scalar %.3f ms, simd %.3f ms, %.2fx, %u visible, %u mismatches\n",
+		VERTEX_COUNT, scalarCullMs, simdCullMs, scalarCullMs / simdCullMs, visible, mismatches);
+
+	return transformOk && colorsKept && mismatches == 0;
+}
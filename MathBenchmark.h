@@ -0,0 +1,12 @@
+/* Title: DirectX 9.0c Framework
+/* Description: SimdMath benchmark: batch transform of 1M vertex positions and
+				frustum tests of 1M boxes, SIMD against the scalar reference.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if SIMD and scalar results differ
+bool RunMathBenchmarks(FILE* pOut);
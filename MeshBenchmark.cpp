@@ -0,0 +1,283 @@
+#include "MeshBenchmark.h"
+#include "MeshOptimizer.h"
+#include "VertexLayout.h"
+#include "SimdMath.h"
+#include "Timer.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	const unsigned CACHE_SIZE = 16;
+	const float OVERDRAW_THRESHOLD = 1.05f;
+	const unsigned DECODE_ROUNDS = 50;
+
+	struct Mesh
+	{
+		std::vector<PositionColorVertex>	Vertices;
+		std::vector<uint32_t>				Indices;	//Empty for a triangle soup
+	};
+
+	PositionColorVertex MakeVertex(float x, float y, float z)
+	{
+		PositionColorVertex v = { x, y, z, 0xFF000000u | ((uint32_t)(x * 37.0f) & 0xFF) << 16 | ((uint32_t)(z * 37.0f) & 0xFF) };
+		return v;
+	}
+
+	//Quads of a (columns x rows) parametric surface, wrapping in both directions when closed.
+	//Triangles are wound so their normal (p1 - p0) x (p2 - p0) points outwards.
+	void AddSurface(Mesh* pMesh, unsigned columns, unsigned rows, bool closed, const float* pCenter, float radius, float tube)
+	{
+		unsigned first = (unsigned)pMesh->Vertices.size();
+		unsigned ringColumns = closed ? columns : columns + 1, ringRows = closed ? rows : rows + 1;
+		for(unsigned r = 0; r < ringRows; ++r)
+		{
+			for(unsigned c = 0; c < ringColumns; ++c)
+			{
+				float u = (float)c / columns, v = (float)r / rows;
+				float x, y, z;
+				if(tube > 0.0f)
+				{
+					//Torus around the y axis
+					float a = u * 6.2831853f, b = v * 6.2831853f;
+					x = (radius + tube * cosf(b)) * cosf(a);
+					y = tube * sinf(b);
+					z = (radius + tube * cosf(b)) * sinf(a);
+				}
+				else if(radius > 0.0f)
+				{
+					//Sphere, poles included
+					float a = u * 6.2831853f, b = (v - 0.5f) * 3.1415926f;
+					x = radius * cosf(b) * cosf(a);
+					y = radius * sinf(b);
+					z = radius * cosf(b) * sinf(a);
+				}
+				else
+				{
+					//Flat grid facing up
+					x = u - 0.5f;
+					y = 0.0f;
+					z = v - 0.5f;
+				}
+				pMesh->Vertices.push_back(MakeVertex(x + pCenter[0], y + pCenter[1], z + pCenter[2]));
+			}
+		}
+		for(unsigned r = 0; r < rows; ++r)
+		{
+			for(unsigned c = 0; c < columns; ++c)
+			{
+				uint32_t i00 = first + r * ringColumns + c, i01 = first + r * ringColumns + (c + 1) % ringColumns;
+				uint32_t i10 = first + (r + 1) % ringRows * ringColumns + c, i11 = first + (r + 1) % ringRows * ringColumns + (c + 1) % ringColumns;
+				uint32_t quad[6] = { i00, i10, i01, i01, i10, i11 };
+				for(int k = 0; k < 6; ++k)
+					pMesh->Indices.push_back(quad[k]);
+			}
+		}
+	}
+
+	//Expands the mesh into a soup with its triangles in random order, like a careless exporter
+	void MakeSoup(Mesh* pMesh, uint32_t seed)
+	{
+		unsigned triangles = (unsigned)pMesh->Indices.size() / 3;
+		std::vector<unsigned> order(triangles);
+		for(unsigned t = 0; t < triangles; ++t)
+			order[t] = t;
+		for(unsigned t = triangles; t > 1; --t)
+			std::swap(order[t - 1], order[RandomBits(seed) % t]);
+
+		std::vector<PositionColorVertex> soup;
+		soup.reserve(triangles * 3);
+		for(unsigned t = 0; t < triangles; ++t)
+		{
+			for(int k = 0; k < 3; ++k)
+				soup.push_back(pMesh->Vertices[pMesh->Indices[order[t] * 3 + k]]);
+		}
+		pMesh->Vertices.swap(soup);
+		pMesh->Indices.clear();
+	}
+
+	//Triangles with their smallest index first (winding kept), sorted
+	std::vector<uint64_t> CanonicalTriangles(const std::vector<uint32_t>& indices)
+	{
+		std::vector<uint64_t> triangles;
+		for(size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			uint32_t a = indices[t], b = indices[t + 1], c = indices[t + 2];
+			while(a > b || a > c)
+			{
+				uint32_t first = a;
+				a = b;
+				b = c;
+				c = first;
+			}
+			triangles.push_back((uint64_t)a << 42 | (uint64_t)b << 21 | c);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	struct Stage
+	{
+		const char*			Name;
+		double				Ms;
+		MeshCacheStats		Cache;
+		MeshOverdrawStats	Overdraw;
+		MeshFetchStats		Fetch;
+	};
+
+	Stage Analyze(const char* pName, double ms, const Mesh& mesh)
+	{
+		Stage stage;
+		stage.Name = pName;
+		stage.Ms = ms;
+		unsigned count = (unsigned)mesh.Vertices.size();
+		stage.Cache = MeshAnalyzeVertexCache(&mesh.Indices[0], (unsigned)mesh.Indices.size(), count, CACHE_SIZE);
+		stage.Overdraw = MeshAnalyzeOverdraw(&mesh.Indices[0], (unsigned)mesh.Indices.size(), &mesh.Vertices[0], count, sizeof(PositionColorVertex));
+		stage.Fetch = MeshAnalyzeVertexFetch(&mesh.Indices[0], (unsigned)mesh.Indices.size(), count, sizeof(PositionColorVertex), CACHE_SIZE);
+		return stage;
+	}
+
+	void PrintStage(FILE* pOut, const Stage& stage)
+	{
+		fprintf(pOut, "  %-14s %8.3f ms  ACMR %5.3f  ATVR %5.3f  overdraw %5.3f  overfetch %5.3f\n", stage.Name, stage.Ms,
+			stage.Cache.ACMR, stage.Cache.ATVR, stage.Overdraw.Overdraw, stage.Fetch.Overfetch);
+	}
+
+	//Runs the whole pipeline on one mesh, returns false if a check failed
+	bool OptimizeMesh(FILE* pOut, const char* pName, Mesh mesh, bool overdrawShouldDrop)
+	{
+		bool ok = true;
+		unsigned inputVertices = (unsigned)mesh.Vertices.size();
+		fprintf(pOut, "%s: %u triangles\n", pName, (unsigned)(mesh.Indices.empty() ? inputVertices : mesh.Indices.size()) / 3);
+
+		//Weld: a soup becomes an indexed mesh
+		int64_t start = TimerTicks();
+		bool soup = mesh.Indices.empty();
+		std::vector<uint32_t> remap(inputVertices);
+		unsigned indexCount = soup ? inputVertices : (unsigned)mesh.Indices.size();
+		unsigned unique = MeshGenerateRemap(&remap[0], soup ? NULL : &mesh.Indices[0], indexCount, &mesh.Vertices[0], inputVertices, sizeof(PositionColorVertex));
+		std::vector<PositionColorVertex> welded(unique);
+		MeshRemapVertices(&welded[0], &mesh.Vertices[0], inputVertices, sizeof(PositionColorVertex), &remap[0]);
+		std::vector<uint32_t> indices(indexCount);
+		MeshRemapIndices(&indices[0], soup ? NULL : &mesh.Indices[0], indexCount, &remap[0]);
+		double weldMs = TicksToMs(TimerTicks() - start);
+		mesh.Vertices.swap(welded);
+		mesh.Indices.swap(indices);
+		fprintf(pOut, "  weld           %8.3f ms  %u vertices to %u\n", weldMs, inputVertices, unique);
+		std::vector<uint64_t> reference = CanonicalTriangles(mesh.Indices);
+
+		Stage input = Analyze("input order", 0.0, mesh);
+		PrintStage(pOut, input);
+
+		std::vector<uint32_t> reordered(indexCount);
+		start = TimerTicks();
+		MeshOptimizeVertexCache(&reordered[0], &mesh.Indices[0], indexCount, unique);
+		double cacheMs = TicksToMs(TimerTicks() - start);
+		mesh.Indices.swap(reordered);
+		Stage cache = Analyze("vertex cache", cacheMs, mesh);
+		PrintStage(pOut, cache);
+		bool cacheKept = CanonicalTriangles(mesh.Indices) == reference;
+
+		start = TimerTicks();
+		MeshOptimizeOverdraw(&reordered[0], &mesh.Indices[0], indexCount, &mesh.Vertices[0], unique, sizeof(PositionColorVertex), OVERDRAW_THRESHOLD);
+		double overdrawMs = TicksToMs(TimerTicks() - start);
+		mesh.Indices.swap(reordered);
+		Stage overdraw = Analyze("overdraw", overdrawMs, mesh);
+		PrintStage(pOut, overdraw);
+		bool overdrawKept = CanonicalTriangles(mesh.Indices) == reference;
+
+		//Same triangles, same vertex contents, new vertex numbers
+		std::vector<PositionColorVertex> fetched(unique);
+		std::vector<uint32_t> before(mesh.Indices);
+		start = TimerTicks();
+		unsigned kept = MeshOptimizeVertexFetch(&fetched[0], &mesh.Indices[0], indexCount, &mesh.Vertices[0], unique, sizeof(PositionColorVertex));
+		double fetchMs = TicksToMs(TimerTicks() - start);
+		bool fetchKept = kept == unique;
+		for(unsigned i = 0; i < indexCount && fetchKept; ++i)
+			fetchKept = memcmp(&fetched[mesh.Indices[i]], &mesh.Vertices[before[i]], sizeof(PositionColorVertex)) == 0;
+		mesh.Vertices.swap(fetched);
+		Stage fetch = Analyze("vertex fetch", fetchMs, mesh);
+		PrintStage(pOut, fetch);
+
+		bool better = cache.Cache.ACMR < input.Cache.ACMR && overdraw.Cache.ACMR <= cache.Cache.ACMR * OVERDRAW_THRESHOLD * 1.01f &&
+			fetch.Fetch.Overfetch <= overdraw.Fetch.Overfetch && (!overdrawShouldDrop || overdraw.Overdraw.Overdraw < cache.Overdraw.Overdraw);
+		ok = ok && cacheKept && overdrawKept && fetchKept && better;
+		if(!cacheKept || !overdrawKept || !fetchKept)
+			fprintf(pOut, "  TRIANGLES LOST OR FLIPPED\n");
+		if(!better)
+			fprintf(pOut, "  NO IMPROVEMENT\n");
+
+		//Index compression, decoded to both index sizes
+		std::vector<uint8_t> compressed;
+		start = TimerTicks();
+		MeshEncodeIndices(&compressed, &mesh.Indices[0], indexCount);
+		double encodeMs = TicksToMs(TimerTicks() - start);
+		bool narrow = unique <= 0x10000;
+		unsigned rawBytes = indexCount * (narrow ? 2 : 4);
+		fprintf(pOut, "  indices        %8.3f ms  %u bytes as %u bit, %u compressed (%.2f bits per index, %.1f%%)\n", encodeMs,
+			rawBytes, narrow ? 16 : 32, (unsigned)compressed.size(), compressed.size() * 8.0 / indexCount, 100.0 * compressed.size() / rawBytes);
+
+		std::vector<uint32_t> decoded32(indexCount);
+		std::vector<uint16_t> decoded16(indexCount), raw16(mesh.Indices.begin(), mesh.Indices.end());
+		bool exact = MeshDecodeIndices(&decoded32[0], indexCount, RD_FMT_INDEX32, &compressed[0], compressed.size()) &&
+			decoded32 == mesh.Indices;
+		if(narrow)
+			exact = exact && MeshDecodeIndices(&decoded16[0], indexCount, RD_FMT_INDEX16, &compressed[0], compressed.size()) && decoded16 == raw16;
+		//Truncated data must be refused
+		exact = exact && !MeshDecodeIndices(&decoded32[0], indexCount, RD_FMT_INDEX32, &compressed[0], compressed.size() - 1);
+
+		start = TimerTicks();
+		for(unsigned round = 0; round < DECODE_ROUNDS; ++round)
+		{
+			if(narrow)
+				MeshDecodeIndices(&decoded16[0], indexCount, RD_FMT_INDEX16, &compressed[0], compressed.size());
+			else
+				MeshDecodeIndices(&decoded32[0], indexCount, RD_FMT_INDEX32, &compressed[0], compressed.size());
+		}
+		double decodeMs = TicksToMs(TimerTicks() - start) / DECODE_ROUNDS;
+		start = TimerTicks();
+		for(unsigned round = 0; round < DECODE_ROUNDS; ++round)
+		{
+			if(narrow)
+				memcpy(&decoded16[0], &raw16[0], rawBytes);
+			else
+				memcpy(&decoded32[0], &mesh.Indices[0], rawBytes);
+		}
+		double copyMs = TicksToMs(TimerTicks() - start) / DECODE_ROUNDS;
+		fprintf(pOut, "  decode         %8.3f ms  %7.1f M indices/s (%5.2f GB/s written), copy %.3f ms%s\n", decodeMs,
+			indexCount / decodeMs / 1000.0, rawBytes / decodeMs / 1e6, copyMs, exact ? "" : "  MISMATCH");
+		return ok && exact;
+	}
+}
+
+bool RunMeshBenchmarks(FILE* pOut)
+{
+	bool ok = true;
+	const float origin[3] = { 0.0f, 0.0f, 0.0f };
+
+	//Row order is already decent for the cache, nothing overlaps
+	Mesh grid;
+	AddSurface(&grid, 255, 255, false, origin, 0.0f, 0.0f);
+	ok = OptimizeMesh(pOut, "Grid 256 x 256, row order", grid, false) && ok;
+
+	Mesh torus;
+	AddSurface(&torus, 256, 96, true, origin, 1.0f, 0.35f);
+	MakeSoup(&torus, 5);
+	ok = OptimizeMesh(pOut, "Torus, shuffled soup", torus, true) && ok;
+
+	//Spheres hiding each other from every axis
+	Mesh spheres;
+	for(int i = 0; i < 27; ++i)
+	{
+		float center[3] = { (float)(i % 3) * 2.5f, (float)(i / 3 % 3) * 2.5f, (float)(i / 9) * 2.5f };
+		AddSurface(&spheres, 64, 32, false, center, 1.0f, 0.0f);
+	}
+	MakeSoup(&spheres, 9);
+	ok = OptimizeMesh(pOut, "27 spheres, shuffled soup", spheres, true) && ok;
+
+	fprintf(pOut, "Mesh optimization %s\n", ok ? "works" : "FAILED");
+	return ok;
+}
@@ -0,0 +1,17 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Mesh optimization benchmark on generated meshes: a grid in row
+				order, a torus and a cluster of spheres exported as shuffled
+				triangle soups. Welds the soups into indexed meshes, then reports
+				the post transform cache miss ratios (ACMR, ATVR), overdraw and
+				vertex overfetch before and after each optimization, the size of
+				the compressed indices, and how fast they decode against a plain
+				copy. Checks that no optimization loses or flips a triangle.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunMeshBenchmarks(FILE* pOut);
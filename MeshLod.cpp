@@ -0,0 +1,410 @@
+#include "MeshLod.h"
+#include "MeshOptimizer.h"
+#include "SimdMath.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <queue>
+
+namespace
+{
+	//A chain ends when a level keeps more than this share of the previous level's triangles
+	const float LOD_MIN_PROGRESS = 0.9f;
+
+	//Squared distances to the planes of the triangles around a vertex, weighted by their area
+	struct Quadric
+	{
+		double A2, AB, AC, AD, B2, BC, BD, C2, CD, D2;
+		double Weight;
+	};
+
+	void QuadricAddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+	{
+		q.A2 += weight * a * a;
+		q.AB += weight * a * b;
+		q.AC += weight * a * c;
+		q.AD += weight * a * d;
+		q.B2 += weight * b * b;
+		q.BC += weight * b * c;
+		q.BD += weight * b * d;
+		q.C2 += weight * c * c;
+		q.CD += weight * c * d;
+		q.D2 += weight * d * d;
+		q.Weight += weight;
+	}
+
+	void QuadricAdd(Quadric& q, const Quadric& r)
+	{
+		q.A2 += r.A2;
+		q.AB += r.AB;
+		q.AC += r.AC;
+		q.AD += r.AD;
+		q.B2 += r.B2;
+		q.BC += r.BC;
+		q.BD += r.BD;
+		q.C2 += r.C2;
+		q.CD += r.CD;
+		q.D2 += r.D2;
+		q.Weight += r.Weight;
+	}
+
+	//Root mean square distance of p to the planes
+	float QuadricError(const Quadric& q, const Vec3& p)
+	{
+		if(q.Weight <= 0.0)
+			return 0.0f;
+		double x = p.x, y = p.y, z = p.z;
+		double error = q.A2 * x * x + q.B2 * y * y + q.C2 * z * z + q.D2 +
+			2.0 * (q.AB * x * y + q.AC * x * z + q.BC * y * z + q.AD * x + q.BD * y + q.CD * z);
+		return (float)sqrt(std::max(error, 0.0) / q.Weight);
+	}
+
+	bool PositionLess(const Vec3& a, const Vec3& b)
+	{
+		if(a.x != b.x)
+			return a.x < b.x;
+		if(a.y != b.y)
+			return a.y < b.y;
+		return a.z < b.z;
+	}
+
+	//Edge collapses in order of quadric error. Collapsing continues where the last
+	//Run() stopped, so a whole chain of levels comes from one pass.
+	class Simplifier
+	{
+	public:
+		Simplifier(const uint32_t* pIndices, unsigned indexCount, const void* pVertices, unsigned vertexCount, unsigned stride);
+
+		//Collapses edges until at most targetTriangles remain, no collapse is left or
+		//the cheapest one would exceed maxError
+		void Run(unsigned targetTriangles, float maxError);
+
+		unsigned GetTriangleCount() const { return m_TriangleCount; }
+		float GetError() const { return m_Error; }
+		//Writes the remaining triangles in their original order, returns the index count
+		unsigned Write(uint32_t* pDst) const;
+
+	private:
+		struct Collapse
+		{
+			float		Error;
+			uint32_t	From;
+			uint32_t	To;
+			uint32_t	FromVersion;
+			uint32_t	ToVersion;
+
+			//Cheapest on top of the priority queue
+			bool operator<(const Collapse& c) const { return Error > c.Error; }
+		};
+
+		bool Contains(uint32_t triangle, uint32_t v) const
+		{
+			const uint32_t* pTriangle = &m_Triangles[triangle * 3];
+			return pTriangle[0] == v || pTriangle[1] == v || pTriangle[2] == v;
+		}
+
+		void PushCollapse(uint32_t from, uint32_t to);
+		//Sorted vertices sharing a triangle with v, drops removed triangles from its list
+		void GatherNeighbors(uint32_t v, std::vector<uint32_t>& neighbors);
+		bool TryCollapse(uint32_t from, uint32_t to, float error);
+
+		std::vector<Vec3>					m_Positions;
+		std::vector<uint32_t>				m_Triangles;		//Three vertices each
+		std::vector<uint8_t>				m_Alive;
+		std::vector<std::vector<uint32_t> >	m_VertexTriangles;
+		std::vector<Quadric>				m_Quadrics;
+		std::vector<uint32_t>				m_Versions;			//Changed by every collapse of or onto the vertex
+		std::vector<uint8_t>				m_Locked;
+		std::priority_queue<Collapse>		m_Queue;
+		unsigned							m_TriangleCount;
+		float								m_Error;
+		std::vector<uint32_t>				m_FromNeighbors;
+		std::vector<uint32_t>				m_ToNeighbors;
+	};
+
+	Simplifier::Simplifier(const uint32_t* pIndices, unsigned indexCount, const void* pVertices, unsigned vertexCount,
+		unsigned stride)
+		: m_Positions(vertexCount), m_VertexTriangles(vertexCount), m_Quadrics(vertexCount), m_Versions(vertexCount, 0),
+		m_Locked(vertexCount, 0), m_TriangleCount(0), m_Error(0.0f)
+	{
+		const uint8_t* pBase = (const uint8_t*)pVertices;
+		for(unsigned v = 0; v < vertexCount; ++v)
+			memcpy(&m_Positions[v], pBase + (size_t)v * stride, sizeof(Vec3));
+
+		//Degenerate triangles are dropped, the others add their plane to their vertices
+		std::vector<uint64_t> edges;
+		edges.reserve(indexCount);
+		for(unsigned i = 0; i + 3 <= indexCount; i += 3)
+		{
+			uint32_t a = pIndices[i], b = pIndices[i + 1], c = pIndices[i + 2];
+			if(a == b || b == c || a == c)
+				continue;
+			uint32_t triangle = (uint32_t)m_Alive.size();
+			m_Triangles.push_back(a);
+			m_Triangles.push_back(b);
+			m_Triangles.push_back(c);
+			m_Alive.push_back(1);
+			m_VertexTriangles[a].push_back(triangle);
+			m_VertexTriangles[b].push_back(triangle);
+			m_VertexTriangles[c].push_back(triangle);
+
+			Vec3 normal = Vec3Cross(m_Positions[b] - m_Positions[a], m_Positions[c] - m_Positions[a]);
+			float length = Vec3Length(normal);
+			if(length > 0.0f)
+			{
+				normal = normal * (1.0f / length);
+				double d = -Vec3Dot(normal, m_Positions[a]);
+				for(int corner = 0; corner < 3; ++corner)
+					QuadricAddPlane(m_Quadrics[pIndices[i + corner]], normal.x, normal.y, normal.z, d, length * 0.5);
+			}
+
+			for(int corner = 0; corner < 3; ++corner)
+			{
+				uint32_t v0 = pIndices[i + corner], v1 = pIndices[i + (corner + 1) % 3];
+				edges.push_back((uint64_t)std::min(v0, v1) << 32 | std::max(v0, v1));
+			}
+		}
+		m_TriangleCount = (unsigned)m_Alive.size();
+
+		//Vertices of edges without exactly two triangles are on a border (or non manifold)
+		std::sort(edges.begin(), edges.end());
+		for(size_t first = 0, end; first < edges.size(); first = end)
+		{
+			for(end = first + 1; end < edges.size() && edges[end] == edges[first]; ++end)
+				;
+			if(end - first != 2)
+			{
+				m_Locked[(uint32_t)(edges[first] >> 32)] = 1;
+				m_Locked[(uint32_t)edges[first]] = 1;
+			}
+		}
+
+		//Vertices split along a seam (same position, other attributes) have to stay together
+		std::vector<uint32_t> used;
+		for(unsigned v = 0; v < vertexCount; ++v)
+		{
+			if(!m_VertexTriangles[v].empty())
+				used.push_back(v);
+		}
+		struct ByPosition
+		{
+			const Vec3* pPositions;
+			bool operator()(uint32_t a, uint32_t b) const { return PositionLess(pPositions[a], pPositions[b]); }
+		};
+		ByPosition byPosition = { m_Positions.empty() ? NULL : &m_Positions[0] };
+		std::sort(used.begin(), used.end(), byPosition);
+		for(size_t i = 1; i < used.size(); ++i)
+		{
+			if(!byPosition(used[i - 1], used[i]))
+				m_Locked[used[i - 1]] = m_Locked[used[i]] = 1;
+		}
+
+		//Every edge in both directions, once for consistently wound meshes
+		for(unsigned t = 0; t < m_TriangleCount; ++t)
+		{
+			for(int corner = 0; corner < 3; ++corner)
+			{
+				uint32_t v0 = m_Triangles[t * 3 + corner], v1 = m_Triangles[t * 3 + (corner + 1) % 3];
+				if(v0 < v1)
+				{
+					PushCollapse(v0, v1);
+					PushCollapse(v1, v0);
+				}
+			}
+		}
+	}
+
+	void Simplifier::PushCollapse(uint32_t from, uint32_t to)
+	{
+		if(m_Locked[from])
+			return;
+		Quadric q = m_Quadrics[from];
+		QuadricAdd(q, m_Quadrics[to]);
+		Collapse collapse = { QuadricError(q, m_Positions[to]), from, to, m_Versions[from], m_Versions[to] };
+		m_Queue.push(collapse);
+	}
+
+	void Simplifier::GatherNeighbors(uint32_t v, std::vector<uint32_t>& neighbors)
+	{
+		neighbors.clear();
+		std::vector<uint32_t>& triangles = m_VertexTriangles[v];
+		size_t kept = 0;
+		for(size_t i = 0; i < triangles.size(); ++i)
+		{
+			uint32_t t = triangles[i];
+			if(!m_Alive[t])
+				continue;
+			triangles[kept++] = t;
+			for(int corner = 0; corner < 3; ++corner)
+			{
+				if(m_Triangles[t * 3 + corner] != v)
+					neighbors.push_back(m_Triangles[t * 3 + corner]);
+			}
+		}
+		triangles.resize(kept);
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	}
+
+	bool Simplifier::TryCollapse(uint32_t from, uint32_t to, float error)
+	{
+		GatherNeighbors(from, m_FromNeighbors);
+		GatherNeighbors(to, m_ToNeighbors);
+
+		//The triangles on the edge disappear, no other triangle may flip or become degenerate
+		const std::vector<uint32_t>& triangles = m_VertexTriangles[from];
+		unsigned shared = 0;
+		for(size_t i = 0; i < triangles.size(); ++i)
+		{
+			uint32_t t = triangles[i];
+			if(Contains(t, to))
+			{
+				++shared;
+				continue;
+			}
+			Vec3 before[3], after[3];
+			for(int corner = 0; corner < 3; ++corner)
+			{
+				uint32_t v = m_Triangles[t * 3 + corner];
+				before[corner] = m_Positions[v];
+				after[corner] = m_Positions[v == from ? to : v];
+			}
+			Vec3 normalBefore = Vec3Cross(before[1] - before[0], before[2] - before[0]);
+			Vec3 normalAfter = Vec3Cross(after[1] - after[0], after[2] - after[0]);
+			if(Vec3Dot(normalBefore, normalAfter) <= 0.0f)
+				return false;
+		}
+		if(shared == 0)
+			return false;
+
+		//Link condition: ends sharing a neighbor outside the edge's own triangles would
+		//fold the surface onto itself
+		unsigned common = 0;
+		for(size_t a = 0, b = 0; a < m_FromNeighbors.size() && b < m_ToNeighbors.size(); )
+		{
+			if(m_FromNeighbors[a] < m_ToNeighbors[b])
+				++a;
+			else if(m_ToNeighbors[b] < m_FromNeighbors[a])
+				++b;
+			else
+			{
+				++common;
+				++a;
+				++b;
+			}
+		}
+		if(common != shared)
+			return false;
+
+		for(size_t i = 0; i < triangles.size(); ++i)
+		{
+			uint32_t t = triangles[i];
+			if(Contains(t, to))
+			{
+				m_Alive[t] = 0;
+				--m_TriangleCount;
+				continue;
+			}
+			for(int corner = 0; corner < 3; ++corner)
+			{
+				if(m_Triangles[t * 3 + corner] == from)
+					m_Triangles[t * 3 + corner] = to;
+			}
+			m_VertexTriangles[to].push_back(t);
+		}
+		m_VertexTriangles[from].clear();
+		QuadricAdd(m_Quadrics[to], m_Quadrics[from]);
+		++m_Versions[from];
+		++m_Versions[to];
+		m_Error = std::max(m_Error, error);
+
+		//Every edge around the merged vertex has a new cost
+		GatherNeighbors(to, m_ToNeighbors);
+		for(size_t i = 0; i < m_ToNeighbors.size(); ++i)
+		{
+			PushCollapse(to, m_ToNeighbors[i]);
+			PushCollapse(m_ToNeighbors[i], to);
+		}
+		return true;
+	}
+
+	void Simplifier::Run(unsigned targetTriangles, float maxError)
+	{
+		while(m_TriangleCount > targetTriangles && !m_Queue.empty())
+		{
+			Collapse collapse = m_Queue.top();
+			//Costs of vertices changed since the push are stale, a newer entry exists
+			if(m_Versions[collapse.From] != collapse.FromVersion || m_Versions[collapse.To] != collapse.ToVersion)
+			{
+				m_Queue.pop();
+				continue;
+			}
+			if(collapse.Error > maxError)
+				break;
+			m_Queue.pop();
+			TryCollapse(collapse.From, collapse.To, collapse.Error);
+		}
+	}
+
+	unsigned Simplifier::Write(uint32_t* pDst) const
+	{
+		unsigned count = 0;
+		for(size_t t = 0; t < m_Alive.size(); ++t)
+		{
+			if(!m_Alive[t])
+				continue;
+			pDst[count++] = m_Triangles[t * 3];
+			pDst[count++] = m_Triangles[t * 3 + 1];
+			pDst[count++] = m_Triangles[t * 3 + 2];
+		}
+		return count;
+	}
+}
+
+unsigned MeshSimplify(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride, unsigned targetIndexCount, float maxError, float* pError)
+{
+	Simplifier simplifier(pIndices, indexCount, pVertices, vertexCount, stride);
+	simplifier.Run(targetIndexCount / 3, maxError);
+	if(pError)
+		*pError = simplifier.GetError();
+	return simplifier.Write(pDst);
+}
+
+unsigned MeshGenerateLods(std::vector<uint32_t>* pIndices, std::vector<MeshLodLevel>* pLevels, const uint32_t* pSource,
+	unsigned indexCount, const void* pVertices, unsigned vertexCount, unsigned stride, unsigned maxLevels,
+	float reduction, float maxError)
+{
+	maxLevels = std::min(maxLevels, LOD_MAX_LEVELS);
+	indexCount = indexCount / 3 * 3;
+	if(maxLevels == 0 || indexCount == 0)
+		return 0;
+
+	MeshLodLevel level = { (uint32_t)pIndices->size(), indexCount, 0.0f };
+	pIndices->insert(pIndices->end(), pSource, pSource + indexCount);
+	pLevels->push_back(level);
+
+	Simplifier simplifier(pSource, indexCount, pVertices, vertexCount, stride);
+	std::vector<uint32_t> simplified(indexCount);
+	unsigned triangles = simplifier.GetTriangleCount();
+	unsigned levels = 1;
+	while(levels < maxLevels)
+	{
+		simplifier.Run((unsigned)(triangles * reduction), maxError);
+		unsigned remaining = simplifier.GetTriangleCount();
+		if(remaining == 0 || remaining > triangles * LOD_MIN_PROGRESS)
+			break;
+
+		unsigned count = simplifier.Write(&simplified[0]);
+		level.IndexOffset = (uint32_t)pIndices->size();
+		level.IndexCount = count;
+		level.Error = simplifier.GetError();
+		pIndices->resize(level.IndexOffset + count);
+		MeshOptimizeVertexCache(&(*pIndices)[level.IndexOffset], &simplified[0], count, vertexCount);
+		pLevels->push_back(level);
+		triangles = remaining;
+		++levels;
+	}
+	return levels;
+}
@@ -0,0 +1,46 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Level of detail meshes. MeshSimplify() collapses edges of an
+				indexed mesh in order of their quadric error (Garland and
+				Heckbert), each onto one of its own vertices, so every level of
+				detail draws from the vertex buffer of the full mesh.
+				MeshGenerateLods() builds a chain of levels in one pass, for
+				assetpack at bake time or at load; LodSelector.h picks the levels
+				to draw. Baked chains (see AssetPack.cpp): the mesh's index buffer holds
+				every level back to back, a raw asset named after the mesh plus
+				MESH_LOD_SUFFIX holds its MeshLodLevel entries.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+const unsigned LOD_MAX_LEVELS = 8;
+const char* const MESH_LOD_SUFFIX = ".lod";
+
+//One level of a chain, same layout in archives
+struct MeshLodLevel
+{
+	uint32_t	IndexOffset;	//First index of the level in the chain's indices
+	uint32_t	IndexCount;
+	float		Error;			//Largest quadric error (RMS distance to the original planes) of the
+								//collapses that made the level, in mesh units; 0 for the full mesh
+};
+
+//Simplifies to at most targetIndexCount indices, or fewer collapses if the next one
+//would move the surface further than maxError. Border vertices (of edges with one
+//triangle) and vertices sharing their position with another stay in place.
+//Positions are three floats at the start of each vertex. Returns the index count,
+//*pError (optional) gets the error reached. pDst may be pIndices.
+unsigned MeshSimplify(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride, unsigned targetIndexCount, float maxError, float* pError = NULL);
+
+//Appends a chain to pIndices and pLevels: level 0 is the mesh as given, every other
+//level has about reduction times the triangles of the one before, vertex cache
+//optimized. Stops after maxLevels (at most LOD_MAX_LEVELS) or when the simplifier
+//gets stuck or exceeds maxError. Returns the number of levels.
+unsigned MeshGenerateLods(std::vector<uint32_t>* pIndices, std::vector<MeshLodLevel>* pLevels, const uint32_t* pSource,
+	unsigned indexCount, const void* pVertices, unsigned vertexCount, unsigned stride, unsigned maxLevels = LOD_MAX_LEVELS,
+	float reduction = 0.5f, float maxError = 1e30f);
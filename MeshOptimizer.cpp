@@ -0,0 +1,673 @@
+#include "MeshOptimizer.h"
+#include "SimdMath.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	const uint32_t NONE = ~0u;
+
+	//Forsyth's scoring, an LRU cache a little larger than the hardware's FIFO
+	const unsigned SCORE_CACHE_SIZE = 32;
+	const unsigned SCORE_VALENCE_MAX = 32;
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	//Overdraw clusters are found with the usual hardware cache size
+	const unsigned OVERDRAW_CACHE_SIZE = 16;
+
+	//Overdraw analysis resolution
+	const int OVERDRAW_RESOLUTION = 256;
+
+	//Vertex fetch analysis: direct mapped cache of 64 byte lines
+	const unsigned FETCH_LINE = 64;
+	const unsigned FETCH_LINES = 64;
+
+	//Index compression: blocks of 128, four interleaved lanes of 32
+	const unsigned INDEX_BLOCK = 128;
+	const unsigned INDEX_LANES = 4;
+
+	uint32_t HashVertex(const uint8_t* pVertex, unsigned stride)
+	{
+		//FNV-1a
+		uint32_t hash = 2166136261u;
+		for(unsigned i = 0; i < stride; ++i)
+			hash = (hash ^ pVertex[i]) * 16777619u;
+		return hash;
+	}
+
+	//FIFO cache simulated with timestamps: a vertex is cached while fewer than
+	//cacheSize misses happened since its own
+	class FifoCache
+	{
+	public:
+		FifoCache(unsigned vertexCount, unsigned cacheSize) : m_CachedAt(vertexCount, 0), m_Time(cacheSize + 1), m_Size(cacheSize) {}
+
+		//True on a miss, the vertex is cached afterwards
+		bool Vertex(uint32_t v)
+		{
+			if(m_Time - m_CachedAt[v] <= m_Size)
+				return false;
+			m_CachedAt[v] = m_Time++;
+			return true;
+		}
+
+		//Returns the misses of one triangle
+		unsigned Triangle(const uint32_t* pTriangle)
+		{
+			return Vertex(pTriangle[0]) + Vertex(pTriangle[1]) + Vertex(pTriangle[2]);
+		}
+
+		//Empties the cache
+		void Flush() { m_Time += m_Size + 1; }
+
+	private:
+		std::vector<unsigned>	m_CachedAt;
+		unsigned				m_Time;
+		unsigned				m_Size;
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 Position(const uint8_t* pVertices, unsigned stride, uint32_t v)
+	{
+		Float3 p;
+		memcpy(&p, pVertices + (size_t)v * stride, sizeof(p));
+		return p;
+	}
+
+	Float3 Subtract(const Float3& a, const Float3& b)
+	{
+		Float3 r = { a.x - b.x, a.y - b.y, a.z - b.z };
+		return r;
+	}
+
+	Float3 Cross(const Float3& a, const Float3& b)
+	{
+		Float3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		return r;
+	}
+
+	//Unpacks one full block, four indices per step. Lane l holds indices l, l + 4, ...,
+	//each lane a bit stream of 32 values of bits bits in bits 32 bit words.
+	void UnpackBlock(const uint8_t* pPayload, unsigned bits, uint32_t base, uint32_t* pOut)
+	{
+		const uint32_t* pWords = (const uint32_t*)pPayload;
+		uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+		for(unsigned j = 0; j < INDEX_BLOCK; ++j)
+		{
+			unsigned lane = j & (INDEX_LANES - 1), bit = (j / INDEX_LANES) * bits;
+			unsigned word = bit >> 5, shift = bit & 31;
+			uint32_t value = bits ? pWords[word * INDEX_LANES + lane] >> shift : 0;
+			if(shift + bits > 32)
+				value |= pWords[(word + 1) * INDEX_LANES + lane] << (32 - shift);
+			pOut[j] = base + (value & mask);
+		}
+	}
+
+#ifdef SIMDMATH_SSE
+	//Same as UnpackBlock with the four lanes in one register, uniform shifts suffice.
+	//Writes 32 or 16 bit indices.
+	template<bool Wide>
+	void UnpackBlockSSE(const uint8_t* pPayload, unsigned bits, uint32_t base, void* pOut)
+	{
+		const __m128i* pIn = (const __m128i*)pPayload;
+		__m128i mask = _mm_set1_epi32(bits == 32 ? -1 : (int)((1u << bits) - 1));
+		__m128i base4 = _mm_set1_epi32((int)base);
+		__m128i word = bits ? _mm_loadu_si128(pIn++) : _mm_setzero_si128();
+		unsigned shift = 0;
+		for(unsigned k = 0; k < INDEX_BLOCK / INDEX_LANES; ++k)
+		{
+			__m128i value = _mm_srl_epi32(word, _mm_cvtsi32_si128((int)shift));
+			shift += bits;
+			if(shift >= 32)
+			{
+				shift -= 32;
+				//The last value ends exactly at the end of the last word
+				if(k + 1 < INDEX_BLOCK / INDEX_LANES)
+					word = _mm_loadu_si128(pIn++);
+				if(shift > 0)
+					value = _mm_or_si128(value, _mm_sll_epi32(word, _mm_cvtsi32_si128((int)(bits - shift))));
+			}
+			value = _mm_add_epi32(_mm_and_si128(value, mask), base4);
+			if(Wide)
+				_mm_storeu_si128((__m128i*)((uint32_t*)pOut + k * INDEX_LANES), value);
+			else
+			{
+				//Sign extend the low halves so the saturating pack keeps them
+				value = _mm_srai_epi32(_mm_slli_epi32(value, 16), 16);
+				_mm_storel_epi64((__m128i*)((uint16_t*)pOut + k * INDEX_LANES), _mm_packs_epi32(value, value));
+			}
+		}
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//Welding
+//-----------------------------------------------------------------------------
+
+unsigned MeshGenerateRemap(uint32_t* pRemap, const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride)
+{
+	const uint8_t* pBytes = (const uint8_t*)pVertices;
+	unsigned tableSize = 16;
+	while(tableSize < vertexCount * 2)
+		tableSize *= 2;
+	std::vector<uint32_t> table(tableSize, NONE);
+
+	for(unsigned v = 0; v < vertexCount; ++v)
+		pRemap[v] = NONE;
+
+	unsigned unique = 0;
+	unsigned count = pIndices ? indexCount : vertexCount;
+	for(unsigned i = 0; i < count; ++i)
+	{
+		uint32_t v = pIndices ? pIndices[i] : i;
+		if(v >= vertexCount || pRemap[v] != NONE)
+			continue;
+
+		//Open addressing, linear probing, entries are the first vertex of each kind
+		const uint8_t* pVertex = pBytes + (size_t)v * stride;
+		unsigned slot = HashVertex(pVertex, stride) & (tableSize - 1);
+		while(table[slot] != NONE && memcmp(pBytes + (size_t)table[slot] * stride, pVertex, stride) != 0)
+			slot = (slot + 1) & (tableSize - 1);
+
+		if(table[slot] == NONE)
+		{
+			table[slot] = v;
+			pRemap[v] = unique++;
+		}
+		else
+			pRemap[v] = pRemap[table[slot]];
+	}
+	return unique;
+}
+
+void MeshRemapVertices(void* pDst, const void* pSrc, unsigned vertexCount, unsigned stride, const uint32_t* pRemap)
+{
+	for(unsigned v = 0; v < vertexCount; ++v)
+	{
+		if(pRemap[v] != NONE)
+			memcpy((uint8_t*)pDst + (size_t)pRemap[v] * stride, (const uint8_t*)pSrc + (size_t)v * stride, stride);
+	}
+}
+
+void MeshRemapIndices(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, const uint32_t* pRemap)
+{
+	for(unsigned i = 0; i < indexCount; ++i)
+		pDst[i] = pRemap[pIndices ? pIndices[i] : i];
+}
+
+//-----------------------------------------------------------------------------
+//Triangle and vertex orders
+//-----------------------------------------------------------------------------
+
+void MeshOptimizeVertexCache(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, unsigned vertexCount)
+{
+	unsigned triangleCount = indexCount / 3;
+	if(triangleCount == 0)
+		return;
+
+	//Score of a vertex by cache position (-1 for not cached, slot 0 for it) and live triangles
+	float cacheScores[SCORE_CACHE_SIZE + 1];
+	float valenceScores[SCORE_VALENCE_MAX + 1];
+	cacheScores[0] = 0.0f;
+	for(unsigned i = 0; i < SCORE_CACHE_SIZE; ++i)
+	{
+		//The last triangle's vertices get a fixed score so its neighbours do not win by default
+		cacheScores[i + 1] = i < 3 ? LAST_TRIANGLE_SCORE :
+			powf(1.0f - (float)(i - 3) / (SCORE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+	}
+	valenceScores[0] = 0.0f;
+	for(unsigned i = 1; i <= SCORE_VALENCE_MAX; ++i)
+		valenceScores[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+
+	//Triangles of every vertex, live ones first
+	std::vector<unsigned> liveCount(vertexCount, 0);
+	for(unsigned i = 0; i < triangleCount * 3; ++i)
+		++liveCount[pIndices[i]];
+	std::vector<unsigned> firstTriangle(vertexCount + 1, 0);
+	for(unsigned v = 0; v < vertexCount; ++v)
+		firstTriangle[v + 1] = firstTriangle[v] + liveCount[v];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<unsigned> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for(unsigned t = 0; t < triangleCount; ++t)
+	{
+		for(int k = 0; k < 3; ++k)
+			adjacency[filled[pIndices[t * 3 + k]]++] = t;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(unsigned v = 0; v < vertexCount; ++v)
+		vertexScore[v] = valenceScores[std::min(liveCount[v], SCORE_VALENCE_MAX)];
+	std::vector<float> triangleScore(triangleCount);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	unsigned best = 0;
+	for(unsigned t = 0; t < triangleCount; ++t)
+	{
+		const uint32_t* pTriangle = pIndices + t * 3;
+		triangleScore[t] = vertexScore[pTriangle[0]] + vertexScore[pTriangle[1]] + vertexScore[pTriangle[2]];
+		if(triangleScore[t] > triangleScore[best])
+			best = t;
+	}
+
+	//Most recently used first, three extra slots for vertices pushed out
+	uint32_t cache[SCORE_CACHE_SIZE + 3];
+	unsigned cacheCount = 0;
+	unsigned nextUnemitted = 0;
+	for(unsigned output = 0; output < triangleCount; ++output)
+	{
+		//Dead end: nothing in the cache has triangles left, continue in input order
+		if(best == NONE)
+		{
+			while(emitted[nextUnemitted])
+				++nextUnemitted;
+			best = nextUnemitted;
+		}
+
+		const uint32_t* pTriangle = pIndices + best * 3;
+		memcpy(pDst + output * 3, pTriangle, 3 * sizeof(uint32_t));
+		emitted[best] = 1;
+
+		//The triangle is no longer live for its vertices
+		for(int k = 0; k < 3; ++k)
+		{
+			uint32_t v = pTriangle[k];
+			uint32_t* pBegin = &adjacency[firstTriangle[v]];
+			uint32_t* pEnd = pBegin + liveCount[v];
+			uint32_t* pFound = std::find(pBegin, pEnd, best);
+			*pFound = *(pEnd - 1);
+			--liveCount[v];
+		}
+
+		//Its vertices move to the front
+		uint32_t newCache[SCORE_CACHE_SIZE + 3];
+		unsigned newCount = 0;
+		for(int k = 0; k < 3; ++k)
+			newCache[newCount++] = pTriangle[k];
+		for(unsigned i = 0; i < cacheCount; ++i)
+		{
+			uint32_t v = cache[i];
+			if(v != pTriangle[0] && v != pTriangle[1] && v != pTriangle[2])
+				newCache[newCount++] = v;
+		}
+
+		//Rescore every vertex that moved (including the ones pushed out) and their live triangles
+		best = NONE;
+		float bestScore = -1.0f;
+		for(unsigned i = 0; i < newCount; ++i)
+		{
+			uint32_t v = newCache[i];
+			cachePosition[v] = i < SCORE_CACHE_SIZE ? (int)i : -1;
+			float score = liveCount[v] ? cacheScores[cachePosition[v] + 1] + valenceScores[std::min(liveCount[v], SCORE_VALENCE_MAX)] : 0.0f;
+			float delta = score - vertexScore[v];
+			vertexScore[v] = score;
+			for(unsigned a = 0; a < liveCount[v]; ++a)
+			{
+				uint32_t t = adjacency[firstTriangle[v] + a];
+				triangleScore[t] += delta;
+				if(triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = t;
+				}
+			}
+		}
+		cacheCount = std::min(newCount, SCORE_CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+	}
+}
+
+void MeshOptimizeOverdraw(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride, float threshold)
+{
+	unsigned triangleCount = indexCount / 3;
+	if(triangleCount == 0)
+		return;
+	const uint8_t* pBytes = (const uint8_t*)pVertices;
+
+	//Hard boundaries: triangles that miss on all three vertices start over anyway
+	std::vector<unsigned> hard;
+	{
+		FifoCache cache(vertexCount, OVERDRAW_CACHE_SIZE);
+		for(unsigned t = 0; t < triangleCount; ++t)
+		{
+			if(cache.Triangle(pIndices + t * 3) == 3 || t == 0)
+				hard.push_back(t);
+		}
+		hard.push_back(triangleCount);
+	}
+
+	//Soft boundaries: split a hard cluster where the part so far, drawn from a cold
+	//cache, is no worse than threshold times the whole cluster
+	std::vector<unsigned> clusters;
+	FifoCache cache(vertexCount, OVERDRAW_CACHE_SIZE);
+	for(size_t h = 0; h + 1 < hard.size(); ++h)
+	{
+		unsigned begin = hard[h], end = hard[h + 1];
+		cache.Flush();
+		unsigned clusterMisses = 0;
+		for(unsigned t = begin; t < end; ++t)
+			clusterMisses += cache.Triangle(pIndices + t * 3);
+		float limit = threshold * clusterMisses / (end - begin);
+
+		cache.Flush();
+		clusters.push_back(begin);
+		unsigned start = begin, misses = 0;
+		for(unsigned t = begin; t < end; ++t)
+		{
+			misses += cache.Triangle(pIndices + t * 3);
+			if(t + 1 < end && (float)misses / (t + 1 - start) <= limit)
+			{
+				clusters.push_back(t + 1);
+				start = t + 1;
+				misses = 0;
+				cache.Flush();
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+	unsigned clusterCount = (unsigned)clusters.size() - 1;
+
+	//Area weighted centroid and normal of each cluster and of the mesh
+	std::vector<Float3> centroids(clusterCount), normals(clusterCount);
+	Float3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+	for(unsigned c = 0; c < clusterCount; ++c)
+	{
+		Float3 centroid = { 0.0f, 0.0f, 0.0f }, normal = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+		for(unsigned t = clusters[c]; t < clusters[c + 1]; ++t)
+		{
+			Float3 p0 = Position(pBytes, stride, pIndices[t * 3]);
+			Float3 p1 = Position(pBytes, stride, pIndices[t * 3 + 1]);
+			Float3 p2 = Position(pBytes, stride, pIndices[t * 3 + 2]);
+			Float3 n = Cross(Subtract(p1, p0), Subtract(p2, p0));
+			float a = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+			centroid.x += (p0.x + p1.x + p2.x) * a;
+			centroid.y += (p0.y + p1.y + p2.y) * a;
+			centroid.z += (p0.z + p1.z + p2.z) * a;
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+			area += a;
+		}
+		meshCentroid.x += centroid.x;
+		meshCentroid.y += centroid.y;
+		meshCentroid.z += centroid.z;
+		meshArea += area;
+		float scale = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+		Float3 weighted = { centroid.x * scale, centroid.y * scale, centroid.z * scale };
+		centroids[c] = weighted;
+		normals[c] = normal;
+	}
+	float meshScale = meshArea > 0.0f ? 1.0f / (3.0f * meshArea) : 0.0f;
+	meshCentroid.x *= meshScale;
+	meshCentroid.y *= meshScale;
+	meshCentroid.z *= meshScale;
+
+	//Clusters far out along their own normal occlude the rest from most views, draw them first
+	std::vector<float> keys(clusterCount);
+	std::vector<unsigned> order(clusterCount);
+	for(unsigned c = 0; c < clusterCount; ++c)
+	{
+		Float3 offset = Subtract(centroids[c], meshCentroid);
+		const Float3& n = normals[c];
+		float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+		keys[c] = length > 0.0f ? (offset.x * n.x + offset.y * n.y + offset.z * n.z) / length : 0.0f;
+		order[c] = c;
+	}
+	struct KeyGreater
+	{
+		const float* pKeys;
+		bool operator()(unsigned a, unsigned b) const { return pKeys[a] > pKeys[b]; }
+	};
+	KeyGreater greater = { &keys[0] };
+	std::stable_sort(order.begin(), order.end(), greater);
+
+	uint32_t* pOut = pDst;
+	for(unsigned c = 0; c < clusterCount; ++c)
+	{
+		unsigned begin = clusters[order[c]], end = clusters[order[c] + 1];
+		memcpy(pOut, pIndices + begin * 3, (end - begin) * 3 * sizeof(uint32_t));
+		pOut += (end - begin) * 3;
+	}
+}
+
+unsigned MeshOptimizeVertexFetch(void* pDst, uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride)
+{
+	std::vector<uint32_t> remap(vertexCount, NONE);
+	unsigned next = 0;
+	for(unsigned i = 0; i < indexCount; ++i)
+	{
+		uint32_t v = pIndices[i];
+		if(remap[v] == NONE)
+		{
+			memcpy((uint8_t*)pDst + (size_t)next * stride, (const uint8_t*)pVertices + (size_t)v * stride, stride);
+			remap[v] = next++;
+		}
+		pIndices[i] = remap[v];
+	}
+	return next;
+}
+
+//-----------------------------------------------------------------------------
+//Analysis
+//-----------------------------------------------------------------------------
+
+MeshCacheStats MeshAnalyzeVertexCache(const uint32_t* pIndices, unsigned indexCount, unsigned vertexCount, unsigned cacheSize)
+{
+	MeshCacheStats stats;
+	FifoCache cache(vertexCount, cacheSize);
+	stats.VerticesTransformed = 0;
+	for(unsigned t = 0; t < indexCount / 3; ++t)
+		stats.VerticesTransformed += cache.Triangle(pIndices + t * 3);
+	stats.ACMR = indexCount >= 3 ? (float)stats.VerticesTransformed / (indexCount / 3) : 0.0f;
+	stats.ATVR = vertexCount ? (float)stats.VerticesTransformed / vertexCount : 0.0f;
+	return stats;
+}
+
+MeshOverdrawStats MeshAnalyzeOverdraw(const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride)
+{
+	MeshOverdrawStats stats;
+	memset(&stats, 0, sizeof(stats));
+	if(vertexCount == 0 || indexCount < 3)
+		return stats;
+	const uint8_t* pBytes = (const uint8_t*)pVertices;
+
+	//Positions scaled into the unit cube
+	Float3 low = Position(pBytes, stride, 0), high = low;
+	for(unsigned v = 1; v < vertexCount; ++v)
+	{
+		Float3 p = Position(pBytes, stride, v);
+		low.x = std::min(low.x, p.x); low.y = std::min(low.y, p.y); low.z = std::min(low.z, p.z);
+		high.x = std::max(high.x, p.x); high.y = std::max(high.y, p.y); high.z = std::max(high.z, p.z);
+	}
+	float extent = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1e-20f));
+
+	const int size = OVERDRAW_RESOLUTION;
+	std::vector<float> depth((size_t)size * size);
+	for(int view = 0; view < 6; ++view)
+	{
+		//Looking down an axis, the mirrored view from the other side flips x, depth and the winding
+		int axis = view % 3;
+		bool flip = view >= 3;
+		std::fill(depth.begin(), depth.end(), 2.0f);
+		for(unsigned t = 0; t < indexCount / 3; ++t)
+		{
+			float sx[3], sy[3], sz[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				Float3 p = Position(pBytes, stride, pIndices[t * 3 + k]);
+				float c[3] = { (p.x - low.x) / extent, (p.y - low.y) / extent, (p.z - low.z) / extent };
+				float u = c[(axis + 1) % 3], v = c[(axis + 2) % 3], z = c[axis];
+				sx[k] = (flip ? 1.0f - u : u) * size;
+				sy[k] = v * size;
+				sz[k] = flip ? 1.0f - z : z;
+			}
+
+			//Clockwise triangles face the viewer (Direct3D's default culling)
+			float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+			if(area >= 0.0f)
+				continue;
+
+			int minX = std::max(0, (int)floorf(std::min(sx[0], std::min(sx[1], sx[2])))), maxX = std::min(size - 1, (int)ceilf(std::max(sx[0], std::max(sx[1], sx[2]))));
+			int minY = std::max(0, (int)floorf(std::min(sy[0], std::min(sy[1], sy[2])))), maxY = std::min(size - 1, (int)ceilf(std::max(sy[0], std::max(sy[1], sy[2]))));
+			float invArea = 1.0f / area;
+			for(int y = minY; y <= maxY; ++y)
+			{
+				for(int x = minX; x <= maxX; ++x)
+				{
+					//Barycentric weights of the pixel center, all of one sign inside
+					float px = x + 0.5f, py = y + 0.5f;
+					float w0 = ((sx[1] - px) * (sy[2] - py) - (sx[2] - px) * (sy[1] - py)) * invArea;
+					float w1 = ((sx[2] - px) * (sy[0] - py) - (sx[0] - px) * (sy[2] - py)) * invArea;
+					float w2 = 1.0f - w0 - w1;
+					if(w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+						continue;
+					float z = w0 * sz[0] + w1 * sz[1] + w2 * sz[2];
+					float& stored = depth[(size_t)y * size + x];
+					if(z < stored)
+					{
+						stats.PixelsCovered += stored > 1.5f;
+						++stats.PixelsShaded;
+						stored = z;
+					}
+				}
+			}
+		}
+	}
+	stats.Overdraw = stats.PixelsCovered ? (float)stats.PixelsShaded / stats.PixelsCovered : 0.0f;
+	return stats;
+}
+
+MeshFetchStats MeshAnalyzeVertexFetch(const uint32_t* pIndices, unsigned indexCount, unsigned vertexCount, unsigned stride,
+	unsigned cacheSize)
+{
+	MeshFetchStats stats;
+	FifoCache cache(vertexCount, cacheSize);
+	uint64_t lines[FETCH_LINES];
+	for(unsigned i = 0; i < FETCH_LINES; ++i)
+		lines[i] = ~0ull;
+
+	stats.BytesFetched = 0;
+	for(unsigned i = 0; i < indexCount / 3 * 3; ++i)
+	{
+		if(!cache.Vertex(pIndices[i]))
+			continue;
+		uint64_t first = (uint64_t)pIndices[i] * stride / FETCH_LINE, last = ((uint64_t)pIndices[i] * stride + stride - 1) / FETCH_LINE;
+		for(uint64_t line = first; line <= last; ++line)
+		{
+			if(lines[line % FETCH_LINES] != line)
+			{
+				lines[line % FETCH_LINES] = line;
+				stats.BytesFetched += FETCH_LINE;
+			}
+		}
+	}
+	uint64_t vertexBytes = (uint64_t)vertexCount * stride;
+	stats.Overfetch = vertexBytes ? (float)((double)stats.BytesFetched / vertexBytes) : 0.0f;
+	return stats;
+}
+
+//-----------------------------------------------------------------------------
+//Index compression
+//-----------------------------------------------------------------------------
+
+size_t MeshEncodeIndices(std::vector<uint8_t>* pOut, const uint32_t* pIndices, unsigned indexCount)
+{
+	size_t start = pOut->size();
+	for(unsigned first = 0; first < indexCount; first += INDEX_BLOCK)
+	{
+		//Offsets from the smallest index, the tail of the last block padded with it
+		unsigned count = std::min(indexCount - first, INDEX_BLOCK);
+		uint32_t base = *std::min_element(pIndices + first, pIndices + first + count);
+		uint32_t range = *std::max_element(pIndices + first, pIndices + first + count) - base;
+		uint32_t bits = 0;
+		while(bits < 32 && (range >> bits) != 0)
+			++bits;
+
+		//Header: base and bit count, then bits words per lane, lanes interleaved
+		uint32_t words[32 * INDEX_LANES];
+		memset(words, 0, sizeof(words));
+		for(unsigned j = 0; j < INDEX_BLOCK && bits > 0; ++j)
+		{
+			uint32_t value = j < count ? pIndices[first + j] - base : 0;
+			unsigned lane = j & (INDEX_LANES - 1), bit = (j / INDEX_LANES) * bits;
+			unsigned word = bit >> 5, shift = bit & 31;
+			words[word * INDEX_LANES + lane] |= value << shift;
+			if(shift + bits > 32)
+				words[(word + 1) * INDEX_LANES + lane] |= value >> (32 - shift);
+		}
+		size_t offset = pOut->size();
+		pOut->resize(offset + 8 + bits * INDEX_LANES * 4);
+		memcpy(&(*pOut)[offset], &base, 4);
+		memcpy(&(*pOut)[offset + 4], &bits, 4);
+		if(bits)
+			memcpy(&(*pOut)[offset + 8], words, bits * INDEX_LANES * 4);
+	}
+	return pOut->size() - start;
+}
+
+bool MeshDecodeIndices(void* pDst, unsigned indexCount, RDIndexFormat format, const uint8_t* pData, size_t size)
+{
+	bool wide = format == RD_FMT_INDEX32;
+	uint32_t tail[INDEX_BLOCK];
+	size_t position = 0;
+	for(unsigned first = 0; first < indexCount; first += INDEX_BLOCK)
+	{
+		uint32_t base, bits;
+		if(position + 8 > size)
+			return false;
+		memcpy(&base, pData + position, 4);
+		memcpy(&bits, pData + position + 4, 4);
+		size_t payload = (size_t)bits * INDEX_LANES * 4;
+		if(bits > 32 || position + 8 + payload > size)
+			return false;
+		const uint8_t* pPayload = pData + position + 8;
+		position += 8 + payload;
+
+		unsigned count = std::min(indexCount - first, INDEX_BLOCK);
+		if(count < INDEX_BLOCK)
+		{
+			//The padded tail goes through a full block
+			UnpackBlock(pPayload, bits, base, tail);
+			for(unsigned j = 0; j < count; ++j)
+			{
+				if(wide)
+					((uint32_t*)pDst)[first + j] = tail[j];
+				else
+					((uint16_t*)pDst)[first + j] = (uint16_t)tail[j];
+			}
+			continue;
+		}
+
+#ifdef SIMDMATH_SSE
+		if(wide)
+			UnpackBlockSSE<true>(pPayload, bits, base, (uint32_t*)pDst + first);
+		else
+			UnpackBlockSSE<false>(pPayload, bits, base, (uint16_t*)pDst + first);
+#else
+		if(wide)
+			UnpackBlock(pPayload, bits, base, (uint32_t*)pDst + first);
+		else
+		{
+			UnpackBlock(pPayload, bits, base, tail);
+			for(unsigned j = 0; j < INDEX_BLOCK; ++j)
+				((uint16_t*)pDst)[first + j] = (uint16_t)tail[j];
+		}
+#endif
+	}
+	return true;
+}
@@ -0,0 +1,86 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Mesh optimization for indexed triangle lists, run when assets
+				are packed (see AssetPack.cpp) or at load. In order:
+				MeshGenerateRemap() welds identical vertices of a triangle soup
+				or an indexed mesh into an index buffer;
+				MeshOptimizeVertexCache() reorders triangles so the post transform
+				vertex cache hits more often (Forsyth's scoring);
+				MeshOptimizeOverdraw() splits that order into clusters where the
+				cache allows it and draws outward facing clusters first, so early
+				depth rejection skips more pixels;
+				MeshOptimizeVertexFetch() renumbers vertices in order of first
+				use so vertex reads walk memory forwards.
+				The Analyze functions measure each on the CPU: average cache miss
+				ratio per triangle (ACMR) and per vertex (ATVR) of a FIFO cache,
+				overdraw from six axis aligned views, and vertex bytes fetched.
+				MeshEncodeIndices() compresses indices in blocks of 128 by bit
+				packing their offset from the block's smallest index, laid out so
+				MeshDecodeIndices() unpacks four indices per SSE2 instruction.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//pRemap[vertexCount] gets the new index of every vertex, identical vertices (same
+//bytes) share one. Vertices are numbered in order of first use by pIndices, or of
+//appearance when pIndices is NULL (a triangle soup); unused ones get ~0u. Returns
+//the number of unique vertices.
+unsigned MeshGenerateRemap(uint32_t* pRemap, const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride);
+//pDst must hold as many vertices as MeshGenerateRemap() returned
+void MeshRemapVertices(void* pDst, const void* pSrc, unsigned vertexCount, unsigned stride, const uint32_t* pRemap);
+//pIndices NULL for a triangle soup (index i is vertex i); pDst may be pIndices
+void MeshRemapIndices(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, const uint32_t* pRemap);
+
+//Triangle orders. pDst may not be pIndices.
+void MeshOptimizeVertexCache(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, unsigned vertexCount);
+//pIndices should already be cache optimized. threshold is how much worse (1.05 is
+//5%) the ACMR may get to make room for the new cluster order. Positions are three
+//floats at the start of each vertex.
+void MeshOptimizeOverdraw(uint32_t* pDst, const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride, float threshold);
+//Reorders the vertices by first use and rewrites pIndices to match. Unused vertices
+//are dropped, returns the number kept. pDst may not be pVertices.
+unsigned MeshOptimizeVertexFetch(void* pDst, uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride);
+
+struct MeshCacheStats
+{
+	unsigned	VerticesTransformed;	//Cache misses
+	float		ACMR;					//Per triangle, 0.5 is ideal for large grids, 3 the worst
+	float		ATVR;					//Per vertex, 1 is ideal
+};
+
+struct MeshOverdrawStats
+{
+	uint64_t	PixelsCovered;
+	uint64_t	PixelsShaded;			//Passed the depth test when drawn in order
+	float		Overdraw;				//Shaded per covered, 1 is ideal
+};
+
+struct MeshFetchStats
+{
+	uint64_t	BytesFetched;			//Cache lines read for the vertices the vertex cache missed
+	float		Overfetch;				//Per byte of vertex data, 1 is ideal
+};
+
+//FIFO post transform cache of cacheSize entries (16 for most Direct3D 9 hardware)
+MeshCacheStats MeshAnalyzeVertexCache(const uint32_t* pIndices, unsigned indexCount, unsigned vertexCount, unsigned cacheSize);
+//Backface culled, depth tested rendering at a fixed resolution from the six axis directions
+MeshOverdrawStats MeshAnalyzeOverdraw(const uint32_t* pIndices, unsigned indexCount, const void* pVertices,
+	unsigned vertexCount, unsigned stride);
+//Vertex cache of cacheSize entries in front of a small cache of 64 byte lines
+MeshFetchStats MeshAnalyzeVertexFetch(const uint32_t* pIndices, unsigned indexCount, unsigned vertexCount, unsigned stride,
+	unsigned cacheSize);
+
+//Appends the compressed indices to pOut, returns the bytes added
+size_t MeshEncodeIndices(std::vector<uint8_t>* pOut, const uint32_t* pIndices, unsigned indexCount);
+//Writes indexCount indices in format (16 bit indices must fit). False if pData is
+//too short or malformed.
+bool MeshDecodeIndices(void* pDst, unsigned indexCount, RDIndexFormat format, const uint8_t* pData, size_t size);
@@ -0,0 +1,258 @@
+#include "NullRenderDevice.h"
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	//Buffer backed by system memory so applications can still lock and fill it
+	template<typename Base>
+	class NullBuffer : public Base
+	{
+	public:
+		NullBuffer(unsigned size, RDPool pool, NullDeviceCounters* pCounters, unsigned* pDefaultPoolBuffers)
+			: m_Data(size), m_Pool(pool), m_pCounters(pCounters), m_pDefaultPoolBuffers(pDefaultPoolBuffers)
+		{
+			if(m_Pool == RD_POOL_DEFAULT)
+				++*m_pDefaultPoolBuffers;
+		}
+		~NullBuffer()
+		{
+			if(m_Pool == RD_POOL_DEFAULT)
+				--*m_pDefaultPoolBuffers;
+		}
+
+		bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags) override
+		{
+			if(offset + size > m_Data.size() || m_Data.empty())
+				return false;
+			*ppData = &m_Data[offset];
+
+			++m_pCounters->Locks;
+			if(flags & RD_LOCK_DISCARD)
+				++m_pCounters->DiscardLocks;
+			if(flags & RD_LOCK_NOOVERWRITE)
+				++m_pCounters->NoOverwriteLocks;
+			return true;
+		}
+		void Unlock() override {}
+		void Release() override { delete this; }
+		unsigned GetSize() const override { return (unsigned)m_Data.size(); }
+		RDPool GetPool() const override { return m_Pool; }
+
+	protected:
+		std::vector<uint8_t> m_Data;
+		RDPool m_Pool;
+		NullDeviceCounters* m_pCounters;
+		unsigned* m_pDefaultPoolBuffers;
+	};
+
+	class NullIndexBuffer : public NullBuffer<IIndexBuffer>
+	{
+	public:
+		NullIndexBuffer(unsigned size, RDIndexFormat format, RDPool pool, NullDeviceCounters* pCounters, unsigned* pDefaultPoolBuffers)
+			: NullBuffer<IIndexBuffer>(size, pool, pCounters, pDefaultPoolBuffers), m_Format(format) {}
+
+		RDIndexFormat GetFormat() const override { return m_Format; }
+
+	private:
+		RDIndexFormat m_Format;
+	};
+
+	class NullReadbackSurface : public IReadbackSurface
+	{
+	public:
+		NullReadbackSurface(unsigned width, unsigned height, unsigned* pDefaultPoolBuffers)
+			: m_Pixels((size_t)width * height), m_Width(width), m_Height(height), m_pDefaultPoolBuffers(pDefaultPoolBuffers)
+		{
+			++*m_pDefaultPoolBuffers;
+		}
+		~NullReadbackSurface() { --*m_pDefaultPoolBuffers; }
+
+		bool Lock(const RDCOLOR** ppPixels, unsigned* pPitch) override
+		{
+			*ppPixels = &m_Pixels[0];
+			*pPitch = m_Width;
+			return true;
+		}
+		void Unlock() override {}
+		void Release() override { delete this; }
+		unsigned GetWidth() const override { return m_Width; }
+		unsigned GetHeight() const override { return m_Height; }
+
+	private:
+		std::vector<RDCOLOR> m_Pixels;
+		unsigned m_Width;
+		unsigned m_Height;
+		unsigned* m_pDefaultPoolBuffers;
+	};
+
+	class NullVertexDeclaration : public IVertexDeclaration
+	{
+	public:
+		void Release() override { delete this; }
+	};
+
+	class NullShader : public IShader
+	{
+	public:
+		explicit NullShader(RDShaderType type) : m_Type(type) {}
+
+		RDShaderType GetShaderType() const override { return m_Type; }
+		void Release() override { delete this; }
+
+	private:
+		RDShaderType m_Type;
+	};
+
+	class NullTexture : public ITexture
+	{
+	public:
+		NullTexture(unsigned width, unsigned height, NullDeviceCounters* pCounters)
+			: m_Width(width), m_Height(height), m_pCounters(pCounters) {}
+
+		bool Update(unsigned x, unsigned y, unsigned width, unsigned height, const RDCOLOR* pPixels, unsigned pitch) override
+		{
+			if(!pPixels || x + width > m_Width || y + height > m_Height || pitch < width)
+				return false;
+			++m_pCounters->TextureUpdates;
+			m_pCounters->TextureBytes += (uint64_t)width * height * sizeof(RDCOLOR);
+			return true;
+		}
+		void Release() override { delete this; }
+		unsigned GetWidth() const override { return m_Width; }
+		unsigned GetHeight() const override { return m_Height; }
+
+	private:
+		unsigned m_Width;
+		unsigned m_Height;
+		NullDeviceCounters* m_pCounters;
+	};
+}
+
+NullRenderDevice::NullRenderDevice(unsigned width, unsigned height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_DefaultPoolBuffers = 0;
+	m_InstanceFreq = 1;
+	m_Lost = false;
+	m_LostPolls = 0;
+	ResetCounters();
+}
+
+bool NullRenderDevice::CreateVertexBuffer(unsigned length, RDWORD /*usage*/, RDWORD /*fvf*/, RDPool pool, IVertexBuffer** ppVB)
+{
+	if(length == 0 || !ppVB)
+		return false;
+	*ppVB = new NullBuffer<IVertexBuffer>(length, pool, &m_Counters, &m_DefaultPoolBuffers);
+	return true;
+}
+
+bool NullRenderDevice::CreateIndexBuffer(unsigned length, RDWORD /*usage*/, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB)
+{
+	if(length == 0 || !ppIB)
+		return false;
+	*ppIB = new NullIndexBuffer(length, format, pool, &m_Counters, &m_DefaultPoolBuffers);
+	return true;
+}
+
+bool NullRenderDevice::CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl)
+{
+	if(!pElements || !ppDecl)
+		return false;
+	*ppDecl = new NullVertexDeclaration();
+	return true;
+}
+
+bool NullRenderDevice::CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader)
+{
+	if(!pBytecode || size == 0 || !ppShader)
+		return false;
+	++m_Counters.CreateShader;
+	*ppShader = new NullShader(type);
+	return true;
+}
+
+bool NullRenderDevice::CreateTexture(unsigned width, unsigned height, ITexture** ppTexture)
+{
+	if(width == 0 || height == 0 || width > GetMaxTextureSize() || height > GetMaxTextureSize() || !ppTexture)
+		return false;
+	++m_Counters.CreateTexture;
+	*ppTexture = new NullTexture(width, height, &m_Counters);
+	return true;
+}
+
+void NullRenderDevice::SetStreamSourceFreq(unsigned stream, RDWORD setting)
+{
+	++m_Counters.SetStreamSourceFreq;
+	if(stream == 0)
+		m_InstanceFreq = setting;
+}
+
+void NullRenderDevice::DrawPrimitive(RDPrimitiveType /*type*/, unsigned /*startVertex*/, unsigned primCount)
+{
+	++m_Counters.DrawPrimitive;
+	m_Counters.Primitives += primCount;
+}
+
+void NullRenderDevice::DrawIndexedPrimitive(RDPrimitiveType /*type*/, int /*baseVertexIndex*/, unsigned /*minIndex*/,
+	unsigned /*numVertices*/, unsigned /*startIndex*/, unsigned primCount)
+{
+	unsigned instances = (m_InstanceFreq & RD_STREAMSOURCE_INDEXEDDATA) ? std::max(m_InstanceFreq & RD_STREAMSOURCE_COUNT_MASK, 1u) : 1;
+	++m_Counters.DrawIndexedPrimitive;
+	m_Counters.Primitives += primCount * instances;
+	m_Counters.Instances += instances;
+}
+
+RDDeviceState NullRenderDevice::TestCooperativeLevel()
+{
+	if(!m_Lost)
+		return RD_DEVICE_OK;
+	if(m_LostPolls > 0)
+	{
+		--m_LostPolls;
+		return RD_DEVICE_LOST;
+	}
+	return RD_DEVICE_NOTRESET;
+}
+
+void NullRenderDevice::SimulateDeviceLoss(unsigned lostPolls)
+{
+	m_Lost = true;
+	m_LostPolls = lostPolls;
+}
+
+bool NullRenderDevice::CreateReadbackSurface(IReadbackSurface** ppSurface)
+{
+	if(!ppSurface || m_Width == 0 || m_Height == 0)
+		return false;
+	*ppSurface = new NullReadbackSurface(m_Width, m_Height, &m_DefaultPoolBuffers);
+	return true;
+}
+
+bool NullRenderDevice::CopyBackBuffer(IReadbackSurface* pSurface)
+{
+	++m_Counters.Readbacks;
+	return pSurface && pSurface->GetWidth() == m_Width && pSurface->GetHeight() == m_Height;
+}
+
+bool NullRenderDevice::Reset(const RDPresentParams& params)
+{
+	//Same rules as Direct3D 9: not while the device can not be reset yet,
+	//and only once every default pool resource was released
+	if((m_Lost && m_LostPolls > 0) || m_DefaultPoolBuffers > 0)
+		return false;
+	m_Lost = false;
+
+	m_InstanceFreq = 1;
+	m_Width = params.BackBufferWidth;
+	m_Height = params.BackBufferHeight;
+	return true;
+}
+
+void NullRenderDevice::ResetCounters()
+{
+	memset(&m_Counters, 0, sizeof(m_Counters));
+}
@@ -0,0 +1,107 @@
+/* Title: DirectX 9.0c Framework
+/* Description: IRenderDevice that keeps buffers in system memory and draws nothing.
+				Used to benchmark the CPU side of the frame loop without any
+				rasterization cost, and as a mock device for tests.
+				Buffers report their locks to the device, so they must not outlive it.
+				SimulateDeviceLoss() mimics a lost Direct3D 9 device, including Reset()
+				failing while default pool buffers are alive.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+//Number of calls received by the null device, per entry point
+struct NullDeviceCounters
+{
+	unsigned SetTransform;
+	unsigned SetRenderState;
+	unsigned SetStreamSource;
+	unsigned SetIndices;
+	unsigned SetFVF;
+	unsigned SetVertexDeclaration;
+	unsigned SetStreamSourceFreq;
+	unsigned CreateShader;
+	unsigned SetShader;
+	unsigned SetShaderConstantF;
+	unsigned CreateTexture;
+	unsigned SetTexture;
+	unsigned TextureUpdates;
+	uint64_t TextureBytes;		//Pixel bytes passed to ITexture::Update()
+	unsigned Clear;
+	unsigned DrawPrimitive;
+	unsigned DrawIndexedPrimitive;
+	unsigned Primitives;
+	unsigned Instances;			//Instances drawn by DrawIndexedPrimitive(), 1 per plain draw
+	unsigned Present;
+	unsigned Readbacks;			//CopyBackBuffer() calls
+	unsigned Locks;
+	unsigned DiscardLocks;		//Locks with RD_LOCK_DISCARD
+	unsigned NoOverwriteLocks;	//Locks with RD_LOCK_NOOVERWRITE
+};
+
+class NullRenderDevice : public IRenderDevice
+{
+public:
+	NullRenderDevice(unsigned width, unsigned height);
+
+	RDDeviceType GetType() const override { return RD_DEVICE_NULL; }
+
+	bool CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB) override;
+	bool CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB) override;
+	//Black surfaces, counted as default pool resources like their Direct3D 9 render targets
+	bool CreateReadbackSurface(IReadbackSurface** ppSurface) override;
+	bool CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl) override;
+	//Accepts any non empty bytecode
+	bool CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader) override;
+	//Textures count their updates but keep no pixels
+	bool CreateTexture(unsigned width, unsigned height, ITexture** ppTexture) override;
+
+	void SetViewport(const RDViewport& /*viewport*/) override {}
+	void SetTransform(RDTransformType /*type*/, const float* /*matrix*/) override { ++m_Counters.SetTransform; }
+	void SetRenderState(RDRenderState /*state*/, RDWORD /*value*/) override { ++m_Counters.SetRenderState; }
+	void SetStreamSource(unsigned /*stream*/, IVertexBuffer* /*pVB*/, unsigned /*offset*/, unsigned /*stride*/) override { ++m_Counters.SetStreamSource; }
+	void SetIndices(IIndexBuffer* /*pIB*/) override { ++m_Counters.SetIndices; }
+	void SetFVF(RDWORD /*fvf*/) override { ++m_Counters.SetFVF; }
+	void SetVertexDeclaration(IVertexDeclaration* /*pDecl*/) override { ++m_Counters.SetVertexDeclaration; }
+	void SetStreamSourceFreq(unsigned stream, RDWORD setting) override;
+	void SetShader(RDShaderType /*type*/, IShader* /*pShader*/) override { ++m_Counters.SetShader; }
+	void SetShaderConstantF(RDShaderType /*type*/, unsigned /*start*/, const float* /*pData*/, unsigned /*count*/) override { ++m_Counters.SetShaderConstantF; }
+	void SetTexture(unsigned /*stage*/, ITexture* /*pTexture*/) override { ++m_Counters.SetTexture; }
+
+	void Clear(RDWORD /*flags*/, RDCOLOR /*color*/, float /*z*/, RDWORD /*stencil*/) override { ++m_Counters.Clear; }
+	void BeginScene() override {}
+	void EndScene() override {}
+	void DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount) override;
+	void DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+		unsigned numVertices, unsigned startIndex, unsigned primCount) override;
+	void Present() override { ++m_Counters.Present; }
+	bool CopyBackBuffer(IReadbackSurface* pSurface) override;
+
+	bool SupportsInstancing() const override { return true; }
+	bool SupportsShaders() const override { return true; }
+	unsigned GetMaxTextureSize() const override { return 4096; }
+
+	RDDeviceState TestCooperativeLevel() override;
+	bool Reset(const RDPresentParams& params) override;
+
+	//TestCooperativeLevel() reports RD_DEVICE_LOST for lostPolls calls, then
+	//RD_DEVICE_NOTRESET until Reset() succeeds
+	void SimulateDeviceLoss(unsigned lostPolls = 0);
+	bool IsLost() const { return m_Lost; }
+	//Default pool buffers (and readback surfaces) currently alive
+	unsigned GetDefaultPoolBuffers() const { return m_DefaultPoolBuffers; }
+
+	const NullDeviceCounters& GetCounters() const { return m_Counters; }
+	void ResetCounters();
+
+private:
+	unsigned			m_Width;
+	unsigned			m_Height;
+	NullDeviceCounters	m_Counters;
+	unsigned			m_DefaultPoolBuffers;
+	RDWORD				m_InstanceFreq;		//Stream 0 frequency
+	bool				m_Lost;
+	unsigned			m_LostPolls;		//TestCooperativeLevel() calls left reporting RD_DEVICE_LOST
+};
@@ -0,0 +1,124 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Fixed size object pool. All storage is allocated up front and
+				free slots are kept in an intrusive free list, so creating and
+				destroying render commands or resource wrappers during a frame
+				does not touch the heap or fragment it. Not thread safe.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+
+template<typename T>
+class ObjectPool
+{
+public:
+	ObjectPool() : m_pSlots(NULL), m_pFree(NULL), m_Capacity(0), m_InUse(0), m_Peak(0), m_Failed(0) {}
+	~ObjectPool() { Shutdown(); }
+
+	//Allocates room for capacity objects
+	bool Init(unsigned capacity)
+	{
+		if(m_pSlots || capacity == 0)
+			return false;
+
+		m_pSlots = (Slot*)malloc(sizeof(Slot) * capacity);
+		if(!m_pSlots)
+			return false;
+
+		//Thread every slot onto the free list, lowest address first
+		for(unsigned i = 0; i < capacity; ++i)
+			m_pSlots[i].pNext = i + 1 < capacity ? &m_pSlots[i + 1] : NULL;
+		m_pFree = m_pSlots;
+		m_Capacity = capacity;
+		m_InUse = 0;
+		m_Peak = 0;
+		m_Failed = 0;
+		return true;
+	}
+
+	//Objects still alive are not destroyed, Free them first
+	void Shutdown()
+	{
+		free(m_pSlots);
+		m_pSlots = NULL;
+		m_pFree = NULL;
+		m_Capacity = 0;
+		m_InUse = 0;
+	}
+
+	//Default constructs an object, NULL when the pool is exhausted
+	T* Alloc()
+	{
+		void* p = AllocSlot();
+		return p ? new(p) T() : NULL;
+	}
+
+	//Copy constructs an object, NULL when the pool is exhausted
+	T* Alloc(const T& value)
+	{
+		void* p = AllocSlot();
+		return p ? new(p) T(value) : NULL;
+	}
+
+	void Free(T* pObject)
+	{
+		if(!pObject)
+			return;
+
+		pObject->~T();
+		Slot* pSlot = (Slot*)pObject;
+		pSlot->pNext = m_pFree;
+		m_pFree = pSlot;
+		--m_InUse;
+	}
+
+	bool Owns(const T* pObject) const
+	{
+		return (const Slot*)pObject >= m_pSlots && (const Slot*)pObject < m_pSlots + m_Capacity;
+	}
+
+	unsigned GetCapacity() const { return m_Capacity; }
+	unsigned GetInUse() const { return m_InUse; }
+	unsigned GetPeak() const { return m_Peak; }
+	//Allocations refused because the pool was empty
+	unsigned GetFailedAllocs() const { return m_Failed; }
+
+private:
+	//Disallow copying
+	ObjectPool(const ObjectPool&);
+	ObjectPool& operator=(const ObjectPool&);
+
+	//Storage for one object, reused as a free list link while unused
+	union Slot
+	{
+		Slot* pNext;
+		double Align;
+		char Storage[sizeof(T)];
+	};
+
+	void* AllocSlot()
+	{
+		if(!m_pFree)
+		{
+			++m_Failed;
+			return NULL;
+		}
+
+		Slot* pSlot = m_pFree;
+		m_pFree = pSlot->pNext;
+		if(++m_InUse > m_Peak)
+			m_Peak = m_InUse;
+		return pSlot;
+	}
+
+	Slot*		m_pSlots;
+	Slot*		m_pFree;
+	unsigned	m_Capacity;
+	unsigned	m_InUse;
+	unsigned	m_Peak;
+	unsigned	m_Failed;
+};
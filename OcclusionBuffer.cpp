@@ -0,0 +1,194 @@
+#include "OcclusionBuffer.h"
+
+#include <algorithm>
+
+namespace
+{
+	//Corner i of a box has bit 0 = max x, bit 1 = max y, bit 2 = max z
+	const unsigned char BOX_TRIANGLES[12][3] =
+	{
+		{ 0, 2, 3 }, { 0, 3, 1 },	//-z
+		{ 4, 5, 7 }, { 4, 7, 6 },	//+z
+		{ 0, 4, 6 }, { 0, 6, 2 },	//-x
+		{ 1, 3, 7 }, { 1, 7, 5 },	//+x
+		{ 0, 1, 5 }, { 0, 5, 4 },	//-y
+		{ 2, 6, 7 }, { 2, 7, 3 }	//+y
+	};
+
+	//Clip space w below this counts as behind the camera (z < 0 is in front of the near plane)
+	const float MIN_W = 1e-4f;
+}
+
+OcclusionBuffer::OcclusionBuffer()
+{
+	m_Width = 0;
+	m_Height = 0;
+	m_TilesX = 0;
+	m_TilesY = 0;
+	m_ViewProj = Mat4Identity();
+	m_RenderedOccluders = 0;
+}
+
+void OcclusionBuffer::Init(unsigned width, unsigned height)
+{
+	m_TilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_TilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	m_Width = m_TilesX * TILE_SIZE;
+	m_Height = m_TilesY * TILE_SIZE;
+	m_Depth.assign(m_Width * m_Height, 1.0f);
+	m_TileMax.assign(m_TilesX * m_TilesY, 1.0f);
+}
+
+void OcclusionBuffer::Begin(const Mat4& viewProj)
+{
+	m_ViewProj = viewProj;
+	std::fill(m_Depth.begin(), m_Depth.end(), 1.0f);
+	std::fill(m_TileMax.begin(), m_TileMax.end(), 1.0f);
+	m_RenderedOccluders = 0;
+}
+
+bool OcclusionBuffer::Project(const AABB& box, ScreenVertex* pCorners) const
+{
+	//Clip position of the min corner plus the clip space edge vectors, so each
+	//corner is a few additions instead of a full transform
+	const float (*m)[4] = m_ViewProj.m;
+	Vec3 size = box.Max - box.Min;
+	float base[4], edge[3][4];
+	for(int c = 0; c < 4; ++c)
+	{
+		base[c] = box.Min.x * m[0][c] + box.Min.y * m[1][c] + box.Min.z * m[2][c] + m[3][c];
+		edge[0][c] = size.x * m[0][c];
+		edge[1][c] = size.y * m[1][c];
+		edge[2][c] = size.z * m[2][c];
+	}
+
+	for(int i = 0; i < 8; ++i)
+	{
+		float clip[4];
+		for(int c = 0; c < 4; ++c)
+			clip[c] = base[c] + (i & 1 ? edge[0][c] : 0.0f) + (i & 2 ? edge[1][c] : 0.0f) + (i & 4 ? edge[2][c] : 0.0f);
+		if(clip[3] < MIN_W || clip[2] < 0.0f)
+			return false;
+
+		float invW = 1.0f / clip[3];
+		pCorners[i].x = (clip[0] * invW * 0.5f + 0.5f) * m_Width;
+		pCorners[i].y = (0.5f - clip[1] * invW * 0.5f) * m_Height;
+		pCorners[i].z = clip[2] * invW;
+	}
+	return true;
+}
+
+void OcclusionBuffer::RenderOccluder(const AABB& box)
+{
+	ScreenVertex corners[8];
+	if(m_Depth.empty() || !Project(box, corners))
+		return;
+
+	//Both faces of a closed box cover the same pixels, keeping the nearest depth
+	//leaves the front faces, so no winding is needed
+	for(int i = 0; i < 12; ++i)
+		RasterizeTriangle(corners[BOX_TRIANGLES[i][0]], corners[BOX_TRIANGLES[i][1]], corners[BOX_TRIANGLES[i][2]]);
+	++m_RenderedOccluders;
+}
+
+void OcclusionBuffer::RasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2)
+{
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if(fabsf(area) < 1e-6f)
+		return;
+	float invArea = 1.0f / area;
+
+	int minX = std::max(0, (int)floorf(std::min(v0.x, std::min(v1.x, v2.x))));
+	int maxX = std::min((int)m_Width - 1, (int)ceilf(std::max(v0.x, std::max(v1.x, v2.x))));
+	int minY = std::max(0, (int)floorf(std::min(v0.y, std::min(v1.y, v2.y))));
+	int maxY = std::min((int)m_Height - 1, (int)ceilf(std::max(v0.y, std::max(v1.y, v2.y))));
+
+	//Edge functions at pixel centers, normalized so inside pixels are positive.
+	//Pixels exactly on an edge are left out so occluders never grow.
+	for(int y = minY; y <= maxY; ++y)
+	{
+		float py = y + 0.5f;
+		float* pRow = &m_Depth[y * m_Width];
+		for(int x = minX; x <= maxX; ++x)
+		{
+			float px = x + 0.5f;
+			float w0 = ((v2.x - v1.x) * (py - v1.y) - (v2.y - v1.y) * (px - v1.x)) * invArea;
+			float w1 = ((v0.x - v2.x) * (py - v2.y) - (v0.y - v2.y) * (px - v2.x)) * invArea;
+			float w2 = 1.0f - w0 - w1;
+			if(w0 <= 0.0f || w1 <= 0.0f || w2 <= 0.0f)
+				continue;
+
+			float z = w0 * v0.z + w1 * v1.z + w2 * v2.z;
+			if(z < pRow[x])
+				pRow[x] = z;
+		}
+	}
+}
+
+void OcclusionBuffer::End()
+{
+	for(unsigned ty = 0; ty < m_TilesY; ++ty)
+	{
+		for(unsigned tx = 0; tx < m_TilesX; ++tx)
+		{
+			float farthest = 0.0f;
+			for(unsigned y = 0; y < TILE_SIZE; ++y)
+			{
+				const float* pRow = &m_Depth[(ty * TILE_SIZE + y) * m_Width + tx * TILE_SIZE];
+				for(unsigned x = 0; x < TILE_SIZE; ++x)
+					farthest = std::max(farthest, pRow[x]);
+			}
+			m_TileMax[ty * m_TilesX + tx] = farthest;
+		}
+	}
+}
+
+bool OcclusionBuffer::TestAABB(const AABB& box) const
+{
+	ScreenVertex corners[8];
+	if(m_RenderedOccluders == 0 || !Project(box, corners))
+		return true;
+
+	float minX = corners[0].x, maxX = corners[0].x;
+	float minY = corners[0].y, maxY = corners[0].y;
+	float nearest = corners[0].z;
+	for(int i = 1; i < 8; ++i)
+	{
+		minX = std::min(minX, corners[i].x);
+		maxX = std::max(maxX, corners[i].x);
+		minY = std::min(minY, corners[i].y);
+		maxY = std::max(maxY, corners[i].y);
+		nearest = std::min(nearest, corners[i].z);
+	}
+
+	//Every pixel the box may touch
+	int x0 = std::max(0, (int)floorf(minX));
+	int x1 = std::min((int)m_Width - 1, (int)ceilf(maxX));
+	int y0 = std::max(0, (int)floorf(minY));
+	int y1 = std::min((int)m_Height - 1, (int)ceilf(maxY));
+	if(x0 > x1 || y0 > y1)
+		return true;
+
+	for(int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty)
+	{
+		for(int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx)
+		{
+			//The whole tile is in front of the box
+			if(m_TileMax[ty * m_TilesX + tx] < nearest)
+				continue;
+
+			int px0 = std::max(x0, tx * TILE_SIZE), px1 = std::min(x1, tx * TILE_SIZE + TILE_SIZE - 1);
+			int py0 = std::max(y0, ty * TILE_SIZE), py1 = std::min(y1, ty * TILE_SIZE + TILE_SIZE - 1);
+			for(int y = py0; y <= py1; ++y)
+			{
+				const float* pRow = &m_Depth[y * m_Width];
+				for(int x = px0; x <= px1; ++x)
+				{
+					if(pRow[x] >= nearest)
+						return true;
+				}
+			}
+		}
+	}
+	return false;
+}
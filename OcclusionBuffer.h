@@ -0,0 +1,58 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Small CPU depth buffer for occlusion culling. Occluder boxes are
+				rasterized with their nearest depth, then occludee boxes are tested
+				against it: a box is hidden when its nearest depth lies behind
+				every pixel of its screen rectangle. A max depth per 8x8 tile lets
+				most tests finish without touching single pixels.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "SimdMath.h"
+
+#include <vector>
+
+class OcclusionBuffer
+{
+public:
+	enum { TILE_SIZE = 8 };
+
+	OcclusionBuffer();
+
+	//Resolution is rounded up to whole tiles
+	void Init(unsigned width, unsigned height);
+	//Clears to the far plane and sets the matrix used by the following calls
+	void Begin(const Mat4& viewProj);
+	//Rasterizes the front faces of a box. Boxes crossing the near plane are skipped.
+	void RenderOccluder(const AABB& box);
+	//Updates the tile depths, call after the last occluder
+	void End();
+
+	//False if the box is certainly hidden. Thread safe between End() and Begin().
+	bool TestAABB(const AABB& box) const;
+
+	unsigned GetWidth() const { return m_Width; }
+	unsigned GetHeight() const { return m_Height; }
+	const float* GetDepth() const { return m_Depth.empty() ? NULL : &m_Depth[0]; }
+	unsigned GetRenderedOccluders() const { return m_RenderedOccluders; }
+
+private:
+	struct ScreenVertex
+	{
+		float x, y, z;
+	};
+
+	//Projects the 8 corners, false if any is in front of the near plane
+	bool Project(const AABB& box, ScreenVertex* pCorners) const;
+	void RasterizeTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2);
+
+	unsigned			m_Width;
+	unsigned			m_Height;
+	unsigned			m_TilesX;
+	unsigned			m_TilesY;
+	Mat4				m_ViewProj;
+	std::vector<float>	m_Depth;		//Nearest occluder depth per pixel (0 = near, 1 = far)
+	std::vector<float>	m_TileMax;		//Farthest depth of each tile
+	unsigned			m_RenderedOccluders;
+};
@@ -0,0 +1,67 @@
+#include "PacingBenchmark.h"
+#include "FramePacer.h"
+#include "Timer.h"
+
+#include <time.h>
+
+namespace
+{
+	const double TARGET_FPS = 120.0;
+	const double WORK_MS = 2.0;			//Stand in for Update and Render
+	const unsigned FRAMES = 240;
+
+	struct PacingRun
+	{
+		const char*	Name;
+		double		Fps;
+		PacingMode	Mode;
+	};
+
+	void Work()
+	{
+		int64_t start = TimerTicks();
+		while(TicksToMs(TimerTicks() - start) < WORK_MS) {}
+	}
+}
+
+bool RunPacingBenchmarks(FILE* pOut)
+{
+	fprintf(pOut, "Frame pacing (%u frames, %.1f ms of work per frame, target %.0f fps)\n", FRAMES, WORK_MS, TARGET_FPS);
+
+	const PacingRun runs[] =
+	{
+		{ "Unpaced", 0.0, PACING_OFF },
+		{ "Latency", TARGET_FPS, PACING_LATENCY },
+		{ "Power", TARGET_FPS, PACING_POWER },
+	};
+
+	bool ok = true;
+	for(unsigned r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r)
+	{
+		FramePacer pacer;
+		pacer.SetTarget(runs[r].Fps, runs[r].Mode);
+		pacer.Start();
+
+		//Process CPU time over wall time, 100% is one core kept busy
+		clock_t cpuStart = clock();
+		int64_t start = TimerTicks();
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			pacer.WaitForFrame();
+			Work();
+		}
+		double wallMs = TicksToMs(TimerTicks() - start);
+		double cpuMs = (clock() - cpuStart) * 1000.0 / CLOCKS_PER_SEC;
+
+		PacingStats stats = pacer.GetStats();
+		fprintf(pOut, "%-8s %7.3f ms interval, %.3f ms jitter, %.3f ms mean / %.3f ms max late, %u missed, "
+			"%.0f%% cpu (%.0f ms slept, %.0f ms spun)\n",
+			runs[r].Name, stats.MeanIntervalMs, stats.JitterMs, stats.MeanLatenessMs, stats.MaxLatenessMs, stats.Missed,
+			100.0 * cpuMs / wallMs, stats.SleepMs, stats.SpinMs);
+
+		//Paced loops must hold their rate on average
+		if(runs[r].Fps > 0.0 && stats.MeanIntervalMs > 1000.0 / runs[r].Fps * 1.05)
+			ok = false;
+	}
+	return ok;
+}
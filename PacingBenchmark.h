@@ -0,0 +1,13 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Frame pacing benchmark: runs a loop with a fixed amount of work
+				per frame unpaced and with both pacing modes, and reports the
+				achieved frame interval, jitter, lateness and CPU use.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a paced loop missed its rate
+bool RunPacingBenchmarks(FILE* pOut);
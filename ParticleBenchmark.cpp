@@ -0,0 +1,215 @@
+#include "ParticleBenchmark.h"
+#include "ParticleSystem.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned EMITTERS = 4;
+	const unsigned EMITTER_CAPACITY = 262144;
+	const unsigned WARMUP_FRAMES = 200;
+	const unsigned FRAMES = 100;
+	const float DT = 1.0f / 60.0f;
+
+	ParticleEmitterDesc MakeDesc(float x, float rate, float lifetimeMin, float lifetimeMax)
+	{
+		ParticleEmitterDesc desc;
+		desc.Position = Vec3(x, 0.0f, 0.0f);
+		desc.PositionSpread = 0.5f;
+		desc.Velocity = Vec3(0.0f, 8.0f, 0.0f);
+		desc.VelocitySpread = 3.0f;
+		desc.Rate = rate;
+		desc.LifetimeMin = lifetimeMin;
+		desc.LifetimeMax = lifetimeMax;
+		desc.Gravity = Vec3(0.0f, -9.81f, 0.0f);
+		desc.Drag = 0.3f;
+		desc.StartColor = 0xFFFFC040;
+		desc.EndColor = 0x00FF2000;
+		desc.StartSize = 0.05f;
+		desc.EndSize = 0.2f;
+		return desc;
+	}
+
+	bool Near(float a, float b)
+	{
+		return fabsf(a - b) <= 1e-4f * (1.0f + fabsf(b));
+	}
+
+	//One step of an odd sized pool (SIMD and scalar tails) against the scalar formula
+	bool CheckIntegration()
+	{
+		ParticleSystem system;
+		ParticleEmitterDesc desc = MakeDesc(0.0f, 0.0f, 10.0f, 20.0f);
+		system.AddEmitter(desc, 1003);
+		system.Burst(0, 1003);
+		ParticleArrays before = system.GetParticles(0);
+		std::vector<float> old[7];
+		const float* pArrays[7] = { before.PosX, before.PosY, before.PosZ, before.VelX, before.VelY, before.VelZ, before.Life };
+		for(int a = 0; a < 7; ++a)
+			old[a].assign(pArrays[a], pArrays[a] + before.Count);
+
+		system.Update(DT);
+		ParticleArrays after = system.GetParticles(0);
+		if(after.Count != before.Count)
+			return false;
+		float damp = 1.0f - desc.Drag * DT;
+		for(unsigned i = 0; i < after.Count; ++i)
+		{
+			float vx = old[3][i] * damp + desc.Gravity.x * DT;
+			float vy = old[4][i] * damp + desc.Gravity.y * DT;
+			float vz = old[5][i] * damp + desc.Gravity.z * DT;
+			if(!Near(after.VelX[i], vx) || !Near(after.VelY[i], vy) || !Near(after.VelZ[i], vz) ||
+				!Near(after.PosX[i], old[0][i] + vx * DT) || !Near(after.PosY[i], old[1][i] + vy * DT) ||
+				!Near(after.PosZ[i], old[2][i] + vz * DT) || !Near(after.Life[i], old[6][i] - DT))
+				return false;
+		}
+
+		//A pool without capacity drops every particle but still updates
+		ParticleSystem empty;
+		empty.AddEmitter(desc, 0);
+		empty.Burst(0, 10);
+		empty.Update(DT);
+		return empty.GetParticles(0).Count == 0 && empty.GetStats().Dropped == 10;
+	}
+
+	//Short lived particles with bursts into a full pool: spawned - died = alive, no dead ones kept
+	bool CheckLifecycle(JobSystem* pJobs)
+	{
+		ParticleSystem system;
+		system.AddEmitter(MakeDesc(0.0f, 30000.0f, 0.01f, 0.5f), 10007);
+		system.AddEmitter(MakeDesc(5.0f, 0.0f, 0.1f, 0.2f), 40000);
+		uint64_t spawned = 0, died = 0;
+		for(unsigned frame = 0; frame < 120; ++frame)
+		{
+			if(frame % 20 == 0)
+				system.Burst(1, 50000);
+			system.Update(DT, pJobs);
+			const ParticleStats& stats = system.GetStats();
+			spawned += stats.Spawned;
+			died += stats.Died;
+			if(spawned - died != stats.Alive || stats.Alive != system.GetParticleCount())
+				return false;
+			for(unsigned e = 0; e < system.GetEmitterCount(); ++e)
+			{
+				ParticleArrays arrays = system.GetParticles(e);
+				for(unsigned i = 0; i < arrays.Count; ++i)
+				{
+					if(!(arrays.Life[i] > 0.0f))
+						return false;
+				}
+			}
+		}
+		return died > 0;
+	}
+
+	//Every quad is centered on its particle, starts at StartColor and is square
+	bool CheckQuads(JobSystem* pJobs)
+	{
+		ParticleSystem system;
+		ParticleEmitterDesc desc = MakeDesc(0.0f, 0.0f, 1.0f, 2.0f);
+		system.AddEmitter(desc, 50001);
+		system.Burst(0, 50001);
+		Mat4 view = Mat4LookAtLH(Vec3(3.0f, 4.0f, -10.0f), Vec3(0.0f, 2.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+		std::vector<PositionColorVertex> quads(50001 * 4);
+		if(system.WriteQuads(&quads[0], 50001, view, pJobs) != 50001 || system.WriteQuads(&quads[0], 1000, view, pJobs) != 1000)
+			return false;
+		system.WriteQuads(&quads[0], 50001, view, pJobs);
+
+		//Size at t = 1 is StartSize: the diagonal from corner 0 to 3 is 2 * StartSize * |R - U|
+		float diagonal = 2.0f * desc.StartSize * sqrtf(2.0f);
+		ParticleArrays arrays = system.GetParticles(0);
+		for(unsigned i = 0; i < arrays.Count; ++i)
+		{
+			const PositionColorVertex* pQuad = &quads[i * 4];
+			float cx = (pQuad[0].x + pQuad[1].x + pQuad[2].x + pQuad[3].x) * 0.25f;
+			float cy = (pQuad[0].y + pQuad[1].y + pQuad[2].y + pQuad[3].y) * 0.25f;
+			float cz = (pQuad[0].z + pQuad[1].z + pQuad[2].z + pQuad[3].z) * 0.25f;
+			float dx = pQuad[3].x - pQuad[0].x, dy = pQuad[3].y - pQuad[0].y, dz = pQuad[3].z - pQuad[0].z;
+			if(!Near(cx, arrays.PosX[i]) || !Near(cy, arrays.PosY[i]) || !Near(cz, arrays.PosZ[i]) ||
+				fabsf(sqrtf(dx * dx + dy * dy + dz * dz) - diagonal) > 1e-4f)
+				return false;
+			for(int k = 0; k < 4; ++k)
+			{
+				if(pQuad[k].Color != desc.StartColor)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	struct FrameResult
+	{
+		double		Particles;		//Alive per frame
+		double		UpdateMs;
+		double		WriteMs;
+		bool		Stable;			//Pools never moved
+	};
+
+	FrameResult RunFrames(ParticleSystem& system, std::vector<PositionColorVertex>& quads, JobSystem* pJobs)
+	{
+		Mat4 view = Mat4LookAtLH(Vec3(0.0f, 5.0f, -30.0f), Vec3(0.0f, 5.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+		const float* pPool = system.GetParticles(0).PosX;
+		FrameResult result = { 0.0, 0.0, 0.0, true };
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			system.Update(DT, pJobs);
+			system.WriteQuads(&quads[0], (unsigned)quads.size() / 4, view, pJobs);
+			result.Particles += system.GetStats().Alive;
+			result.UpdateMs += system.GetStats().UpdateMs;
+			result.WriteMs += system.GetStats().WriteMs;
+			result.Stable = result.Stable && system.GetParticles(0).PosX == pPool;
+		}
+		result.Particles /= FRAMES;
+		result.UpdateMs /= FRAMES;
+		result.WriteMs /= FRAMES;
+		return result;
+	}
+}
+
+bool RunParticleBenchmarks(FILE* pOut)
+{
+	JobSystem jobs;
+	jobs.Init();
+#if defined(SIMDMATH_AVX)
+	const char* pPath = "AVX";
+#elif defined(SIMDMATH_SSE)
+	const char* pPath = "SSE2";
+#else
+	const char* pPath = "scalar";
+#endif
+	fprintf(pOut, "Particles (%u threads, %s integration)\n", jobs.GetThreadCount(), pPath);
+
+	bool integration = CheckIntegration();
+	bool lifecycle = CheckLifecycle(&jobs) && CheckLifecycle(NULL);
+	bool quadsOk = CheckQuads(&jobs) && CheckQuads(NULL);
+	fprintf(pOut, "Checks: integration %s, spawn and death %s, quads %s\n", integration ? "ok" : "FAILED",
+		lifecycle ? "ok" : "FAILED", quadsOk ? "ok" : "FAILED");
+
+	//Lifetimes of 1 .. 3 s at a rate filling 95% of the pools
+	ParticleSystem system;
+	for(unsigned e = 0; e < EMITTERS; ++e)
+		system.AddEmitter(MakeDesc(e * 10.0f - 15.0f, EMITTER_CAPACITY * 0.95f / 2.0f, 1.0f, 3.0f), EMITTER_CAPACITY);
+	std::vector<PositionColorVertex> quads((size_t)EMITTERS * EMITTER_CAPACITY * 4);
+	int64_t start = TimerTicks();
+	for(unsigned frame = 0; frame < WARMUP_FRAMES; ++frame)
+		system.Update(DT, &jobs);
+	fprintf(pOut, "Warm up: %u frames in %.0f ms, %u particles alive, %u MB of quads\n", WARMUP_FRAMES,
+		TicksToMs(TimerTicks() - start), system.GetParticleCount(), (unsigned)(quads.size() * sizeof(PositionColorVertex) >> 20));
+
+	FrameResult single = RunFrames(system, quads, NULL);
+	FrameResult parallel = RunFrames(system, quads, &jobs);
+	fprintf(pOut, "1 thread:  %.0f particles, update %.2f ms, write %.2f ms, %.1f ns per particle\n", single.Particles,
+		single.UpdateMs, single.WriteMs, (single.UpdateMs + single.WriteMs) * 1e6 / single.Particles);
+	fprintf(pOut, "%u threads: %.0f particles, update %.2f ms, write %.2f ms, %.1f ns per particle\n", jobs.GetThreadCount(),
+		parallel.Particles, parallel.UpdateMs, parallel.WriteMs, (parallel.UpdateMs + parallel.WriteMs) * 1e6 / parallel.Particles);
+
+	bool ok = integration && lifecycle && quadsOk && single.Stable && parallel.Stable && parallel.Particles > 900000.0;
+	fprintf(pOut, "Particle system %s\n", ok ? "works" : "FAILED");
+
+	jobs.Shutdown();
+	return ok;
+}
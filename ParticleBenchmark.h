@@ -0,0 +1,20 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Particle benchmark: four emitters keep about a million particles
+				alive, and every frame they are updated and expanded into
+				camera facing quads in a 64 MB buffer, as a renderer would
+				write them into a locked vertex buffer. Reports both per frame
+				on one thread and on the job system. Checks the SIMD
+				integration against a scalar reference, that the quads are
+				centered on their particles, that spawned minus died matches
+				the live count with no dead particle left, that the pools
+				are never reallocated, and that a pool without capacity
+				still updates.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunParticleBenchmarks(FILE* pOut);
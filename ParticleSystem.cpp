@@ -0,0 +1,523 @@
+#include "ParticleSystem.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <algorithm>
+
+namespace
+{
+	//16 bit indices address 65536 vertices, 4 per quad
+	const unsigned QUADS_PER_DRAW = 65536 / 4;
+	const unsigned QUAD_BYTES = 4 * sizeof(PositionColorVertex);
+
+	//-1 .. 1
+	float RandomSigned(uint32_t& seed)
+	{
+		return RandomFloat(seed) * 2.0f - 1.0f;
+	}
+
+	//Per channel start - end and end of a color fade, A R G B
+	struct ColorFade
+	{
+		float	Delta[4];
+		float	End[4];
+	};
+
+	ColorFade MakeColorFade(RDCOLOR start, RDCOLOR end)
+	{
+		ColorFade fade;
+		for(int c = 0; c < 4; ++c)
+		{
+			float s = (float)((start >> (24 - c * 8)) & 0xFF), e = (float)((end >> (24 - c * 8)) & 0xFF);
+			fade.Delta[c] = s - e;
+			fade.End[c] = e;
+		}
+		return fade;
+	}
+
+	//t = 1 at birth, 0 at death
+	RDCOLOR FadeColor(const ColorFade& fade, float t)
+	{
+		RDCOLOR color = 0;
+		for(int c = 0; c < 4; ++c)
+			color |= (RDCOLOR)(int)(fade.End[c] + fade.Delta[c] * t + 0.5f) << (24 - c * 8);
+		return color;
+	}
+}
+
+ParticleSystem::ParticleSystem()
+{
+	m_Spawned = 0;
+	m_Dropped = 0;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+unsigned ParticleSystem::AddEmitter(const ParticleEmitterDesc& desc, unsigned capacity)
+{
+	m_Pools.push_back(Pool());
+	Pool& pool = m_Pools.back();
+	pool.Desc = desc;
+	pool.PosX.resize(capacity);
+	pool.PosY.resize(capacity);
+	pool.PosZ.resize(capacity);
+	pool.VelX.resize(capacity);
+	pool.VelY.resize(capacity);
+	pool.VelZ.resize(capacity);
+	pool.Life.resize(capacity);
+	pool.InvLifetime.resize(capacity);
+	pool.Count = 0;
+	pool.Capacity = capacity;
+	pool.SpawnDebt = 0.0f;
+	pool.Died = 0;
+	pool.Seed = 0x9E3779B9u * (uint32_t)m_Pools.size();
+	return (unsigned)m_Pools.size() - 1;
+}
+
+ParticleArrays ParticleSystem::GetParticles(unsigned emitter) const
+{
+	const Pool& pool = m_Pools[emitter];
+	ParticleArrays arrays = { pool.PosX.data(), pool.PosY.data(), pool.PosZ.data(), pool.VelX.data(), pool.VelY.data(), pool.VelZ.data(),
+		pool.Life.data(), pool.InvLifetime.data(), pool.Count };
+	return arrays;
+}
+
+void ParticleSystem::Burst(unsigned emitter, unsigned count)
+{
+	Spawn(m_Pools[emitter], count);
+}
+
+void ParticleSystem::Clear()
+{
+	for(size_t i = 0; i < m_Pools.size(); ++i)
+	{
+		m_Pools[i].Count = 0;
+		m_Pools[i].SpawnDebt = 0.0f;
+	}
+}
+
+unsigned ParticleSystem::GetParticleCount() const
+{
+	unsigned count = 0;
+	for(size_t i = 0; i < m_Pools.size(); ++i)
+		count += m_Pools[i].Count;
+	return count;
+}
+
+void ParticleSystem::Spawn(Pool& pool, unsigned count)
+{
+	unsigned room = pool.Capacity - pool.Count;
+	if(count > room)
+	{
+		m_Dropped += count - room;
+		count = room;
+	}
+	m_Spawned += count;
+
+	const ParticleEmitterDesc& desc = pool.Desc;
+	uint32_t seed = pool.Seed;
+	for(unsigned i = pool.Count; i < pool.Count + count; ++i)
+	{
+		pool.PosX[i] = desc.Position.x + RandomSigned(seed) * desc.PositionSpread;
+		pool.PosY[i] = desc.Position.y + RandomSigned(seed) * desc.PositionSpread;
+		pool.PosZ[i] = desc.Position.z + RandomSigned(seed) * desc.PositionSpread;
+		pool.VelX[i] = desc.Velocity.x + RandomSigned(seed) * desc.VelocitySpread;
+		pool.VelY[i] = desc.Velocity.y + RandomSigned(seed) * desc.VelocitySpread;
+		pool.VelZ[i] = desc.Velocity.z + RandomSigned(seed) * desc.VelocitySpread;
+		float lifetime = std::max(desc.LifetimeMin + RandomFloat(seed) * (desc.LifetimeMax - desc.LifetimeMin), 1e-4f);
+		pool.Life[i] = lifetime;
+		pool.InvLifetime[i] = 1.0f / lifetime;
+	}
+	pool.Seed = seed;
+	pool.Count += count;
+}
+
+void ParticleSystem::BuildRanges(unsigned maxParticles)
+{
+	m_Ranges.clear();
+	unsigned output = 0;
+	for(unsigned p = 0; p < (unsigned)m_Pools.size() && output < maxParticles; ++p)
+	{
+		unsigned count = std::min(m_Pools[p].Count, maxParticles - output);
+		for(unsigned begin = 0; begin < count; begin += CHUNK_SIZE)
+		{
+			Range range = { p, begin, std::min(begin + CHUNK_SIZE, count), output };
+			m_Ranges.push_back(range);
+			output += range.End - range.Begin;
+		}
+	}
+}
+
+void ParticleSystem::Update(float dt, JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+	JobData data = { this, dt, NULL, Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 0.0f, 0.0f) };
+	bool parallel = pJobs && pJobs->IsRunning();
+
+	//Integrate, then remove the particles that ran out of life, then spawn, so new
+	//particles are drawn where their emitter is
+	BuildRanges(0xFFFFFFFF);
+	if(parallel && m_Ranges.size() > 1)
+		pJobs->ParallelFor((unsigned)m_Ranges.size(), 1, IntegrateJob, &data);
+	else
+		IntegrateJob(&data, 0, (unsigned)m_Ranges.size());
+
+	if(parallel && m_Pools.size() > 1)
+		pJobs->ParallelFor((unsigned)m_Pools.size(), 1, CompactJob, &data);
+	else
+		CompactJob(&data, 0, (unsigned)m_Pools.size());
+
+	m_Stats.Died = 0;
+	for(size_t p = 0; p < m_Pools.size(); ++p)
+	{
+		Pool& pool = m_Pools[p];
+		m_Stats.Died += pool.Died;
+		float spawn = pool.Desc.Rate * dt + pool.SpawnDebt;
+		unsigned count = spawn > 0.0f ? (unsigned)spawn : 0;
+		pool.SpawnDebt = spawn - count;
+		Spawn(pool, count);
+	}
+
+	m_Stats.Spawned = m_Spawned;
+	m_Stats.Dropped = m_Dropped;
+	m_Spawned = 0;
+	m_Dropped = 0;
+	m_Stats.Alive = GetParticleCount();
+	m_Stats.UpdateMs = TicksToMs(TimerTicks() - start);
+}
+
+void ParticleSystem::IntegrateRange(const Range& range, float dt)
+{
+	Pool& pool = m_Pools[range.Pool];
+	float* pPosX = pool.PosX.data();
+	float* pPosY = pool.PosY.data();
+	float* pPosZ = pool.PosZ.data();
+	float* pVelX = pool.VelX.data();
+	float* pVelY = pool.VelY.data();
+	float* pVelZ = pool.VelZ.data();
+	float* pLife = pool.Life.data();
+
+	//v = v * damp + g * dt, p += v * dt, life -= dt
+	float damp = std::max(1.0f - pool.Desc.Drag * dt, 0.0f);
+	float gx = pool.Desc.Gravity.x * dt, gy = pool.Desc.Gravity.y * dt, gz = pool.Desc.Gravity.z * dt;
+	unsigned i = range.Begin;
+
+#if defined(SIMDMATH_AVX)
+	__m256 damp8 = _mm256_set1_ps(damp), dt8 = _mm256_set1_ps(dt);
+	__m256 gx8 = _mm256_set1_ps(gx), gy8 = _mm256_set1_ps(gy), gz8 = _mm256_set1_ps(gz);
+	for(; i + 8 <= range.End; i += 8)
+	{
+		__m256 vx = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pVelX + i), damp8), gx8);
+		__m256 vy = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pVelY + i), damp8), gy8);
+		__m256 vz = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(pVelZ + i), damp8), gz8);
+		_mm256_storeu_ps(pVelX + i, vx);
+		_mm256_storeu_ps(pVelY + i, vy);
+		_mm256_storeu_ps(pVelZ + i, vz);
+		_mm256_storeu_ps(pPosX + i, _mm256_add_ps(_mm256_loadu_ps(pPosX + i), _mm256_mul_ps(vx, dt8)));
+		_mm256_storeu_ps(pPosY + i, _mm256_add_ps(_mm256_loadu_ps(pPosY + i), _mm256_mul_ps(vy, dt8)));
+		_mm256_storeu_ps(pPosZ + i, _mm256_add_ps(_mm256_loadu_ps(pPosZ + i), _mm256_mul_ps(vz, dt8)));
+		_mm256_storeu_ps(pLife + i, _mm256_sub_ps(_mm256_loadu_ps(pLife + i), dt8));
+	}
+#endif
+#if defined(SIMDMATH_SSE)
+	__m128 damp4 = _mm_set1_ps(damp), dt4 = _mm_set1_ps(dt);
+	__m128 gx4 = _mm_set1_ps(gx), gy4 = _mm_set1_ps(gy), gz4 = _mm_set1_ps(gz);
+	for(; i + 4 <= range.End; i += 4)
+	{
+		__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pVelX + i), damp4), gx4);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pVelY + i), damp4), gy4);
+		__m128 vz = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pVelZ + i), damp4), gz4);
+		_mm_storeu_ps(pVelX + i, vx);
+		_mm_storeu_ps(pVelY + i, vy);
+		_mm_storeu_ps(pVelZ + i, vz);
+		_mm_storeu_ps(pPosX + i, _mm_add_ps(_mm_loadu_ps(pPosX + i), _mm_mul_ps(vx, dt4)));
+		_mm_storeu_ps(pPosY + i, _mm_add_ps(_mm_loadu_ps(pPosY + i), _mm_mul_ps(vy, dt4)));
+		_mm_storeu_ps(pPosZ + i, _mm_add_ps(_mm_loadu_ps(pPosZ + i), _mm_mul_ps(vz, dt4)));
+		_mm_storeu_ps(pLife + i, _mm_sub_ps(_mm_loadu_ps(pLife + i), dt4));
+	}
+#endif
+	for(; i < range.End; ++i)
+	{
+		float vx = pVelX[i] * damp + gx, vy = pVelY[i] * damp + gy, vz = pVelZ[i] * damp + gz;
+		pVelX[i] = vx;
+		pVelY[i] = vy;
+		pVelZ[i] = vz;
+		pPosX[i] += vx * dt;
+		pPosY[i] += vy * dt;
+		pPosZ[i] += vz * dt;
+		pLife[i] -= dt;
+	}
+}
+
+void ParticleSystem::Compact(Pool& pool)
+{
+	const float* pLife = pool.Life.data();
+	unsigned count = pool.Count;
+	unsigned i = 0;
+	while(i < count)
+	{
+		//Skip live runs four at a time, most particles survive a frame
+#if defined(SIMDMATH_SSE)
+		while(i + 4 <= count && _mm_movemask_ps(_mm_cmpngt_ps(_mm_loadu_ps(pLife + i), _mm_setzero_ps())) == 0)
+			i += 4;
+		if(i >= count)
+			break;
+#endif
+		if(pLife[i] > 0.0f)
+		{
+			++i;
+			continue;
+		}
+
+		//Move the last live particle into the slot (NaN life counts as dead)
+		do
+			--count;
+		while(count > i && !(pLife[count] > 0.0f));
+		if(count > i)
+		{
+			pool.PosX[i] = pool.PosX[count];
+			pool.PosY[i] = pool.PosY[count];
+			pool.PosZ[i] = pool.PosZ[count];
+			pool.VelX[i] = pool.VelX[count];
+			pool.VelY[i] = pool.VelY[count];
+			pool.VelZ[i] = pool.VelZ[count];
+			pool.Life[i] = pool.Life[count];
+			pool.InvLifetime[i] = pool.InvLifetime[count];
+			++i;
+		}
+	}
+	pool.Died = pool.Count - count;
+	pool.Count = count;
+}
+
+unsigned ParticleSystem::WriteQuads(PositionColorVertex* pDst, unsigned maxQuads, const Mat4& view, JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+
+	//The view matrix' columns are the camera axes in world space
+	JobData data = { this, 0.0f, pDst, Vec3(view.m[0][0], view.m[1][0], view.m[2][0]), Vec3(view.m[0][1], view.m[1][1], view.m[2][1]) };
+	BuildRanges(maxQuads);
+	if(pJobs && pJobs->IsRunning() && m_Ranges.size() > 1)
+		pJobs->ParallelFor((unsigned)m_Ranges.size(), 1, WriteJob, &data);
+	else
+		WriteJob(&data, 0, (unsigned)m_Ranges.size());
+
+	unsigned quads = m_Ranges.empty() ? 0 : m_Ranges.back().Output + m_Ranges.back().End - m_Ranges.back().Begin;
+	m_Stats.WriteMs = TicksToMs(TimerTicks() - start);
+	return quads;
+}
+
+void ParticleSystem::WriteRange(const Range& range, PositionColorVertex* pDst, const Vec3& right, const Vec3& up)
+{
+	const Pool& pool = m_Pools[range.Pool];
+	const ParticleEmitterDesc& desc = pool.Desc;
+	const float* pPosX = pool.PosX.data();
+	const float* pPosY = pool.PosY.data();
+	const float* pPosZ = pool.PosZ.data();
+	const float* pLife = pool.Life.data();
+	const float* pInvLifetime = pool.InvLifetime.data();
+	ColorFade fade = MakeColorFade(desc.StartColor, desc.EndColor);
+	float sizeDelta = desc.StartSize - desc.EndSize;
+
+	//Corners p - B, p + A, p - A, p + B scaled by the size: top left, top right,
+	//bottom left, bottom right
+	Vec3 a = right + up, b = right - up;
+	PositionColorVertex* pVertex = pDst + (size_t)range.Output * 4;
+	unsigned i = range.Begin;
+
+#if defined(SIMDMATH_SSE)
+	//Every vertex is one 16 byte register: transpose x, y, z and color of four
+	//particles per corner and stream whole quads, the target is usually write
+	//combined memory
+	bool aligned = ((size_t)pVertex & 15) == 0;
+	__m128 deltaA = _mm_set1_ps(fade.Delta[0]), deltaR = _mm_set1_ps(fade.Delta[1]);
+	__m128 deltaG = _mm_set1_ps(fade.Delta[2]), deltaB = _mm_set1_ps(fade.Delta[3]);
+	__m128 endA = _mm_set1_ps(fade.End[0]), endR = _mm_set1_ps(fade.End[1]);
+	__m128 endG = _mm_set1_ps(fade.End[2]), endB = _mm_set1_ps(fade.End[3]);
+	__m128 sizeDelta4 = _mm_set1_ps(sizeDelta), endSize = _mm_set1_ps(desc.EndSize);
+	for(; i + 4 <= range.End; i += 4, pVertex += 16)
+	{
+		__m128 t = _mm_mul_ps(_mm_loadu_ps(pLife + i), _mm_loadu_ps(pInvLifetime + i));
+		__m128 size = _mm_add_ps(endSize, _mm_mul_ps(sizeDelta4, t));
+		__m128i color = _mm_slli_epi32(_mm_cvtps_epi32(_mm_add_ps(endA, _mm_mul_ps(deltaA, t))), 24);
+		color = _mm_or_si128(color, _mm_slli_epi32(_mm_cvtps_epi32(_mm_add_ps(endR, _mm_mul_ps(deltaR, t))), 16));
+		color = _mm_or_si128(color, _mm_slli_epi32(_mm_cvtps_epi32(_mm_add_ps(endG, _mm_mul_ps(deltaG, t))), 8));
+		color = _mm_or_si128(color, _mm_cvtps_epi32(_mm_add_ps(endB, _mm_mul_ps(deltaB, t))));
+
+		__m128 px = _mm_loadu_ps(pPosX + i), py = _mm_loadu_ps(pPosY + i), pz = _mm_loadu_ps(pPosZ + i);
+		__m128 ax = _mm_mul_ps(size, _mm_set1_ps(a.x)), ay = _mm_mul_ps(size, _mm_set1_ps(a.y)), az = _mm_mul_ps(size, _mm_set1_ps(a.z));
+		__m128 bx = _mm_mul_ps(size, _mm_set1_ps(b.x)), by = _mm_mul_ps(size, _mm_set1_ps(b.y)), bz = _mm_mul_ps(size, _mm_set1_ps(b.z));
+
+		//corners[k][j] is corner k of particle j
+		__m128 corners[4][4];
+		__m128 x0 = _mm_sub_ps(px, bx), y0 = _mm_sub_ps(py, by), z0 = _mm_sub_ps(pz, bz), c0 = _mm_castsi128_ps(color);
+		__m128 x1 = _mm_add_ps(px, ax), y1 = _mm_add_ps(py, ay), z1 = _mm_add_ps(pz, az), c1 = c0;
+		__m128 x2 = _mm_sub_ps(px, ax), y2 = _mm_sub_ps(py, ay), z2 = _mm_sub_ps(pz, az), c2 = c0;
+		__m128 x3 = _mm_add_ps(px, bx), y3 = _mm_add_ps(py, by), z3 = _mm_add_ps(pz, bz), c3 = c0;
+		_MM_TRANSPOSE4_PS(x0, y0, z0, c0);
+		_MM_TRANSPOSE4_PS(x1, y1, z1, c1);
+		_MM_TRANSPOSE4_PS(x2, y2, z2, c2);
+		_MM_TRANSPOSE4_PS(x3, y3, z3, c3);
+		corners[0][0] = x0; corners[0][1] = y0; corners[0][2] = z0; corners[0][3] = c0;
+		corners[1][0] = x1; corners[1][1] = y1; corners[1][2] = z1; corners[1][3] = c1;
+		corners[2][0] = x2; corners[2][1] = y2; corners[2][2] = z2; corners[2][3] = c2;
+		corners[3][0] = x3; corners[3][1] = y3; corners[3][2] = z3; corners[3][3] = c3;
+
+		float* pOut = &pVertex->x;
+		if(aligned)
+		{
+			for(int j = 0; j < 4; ++j)
+				for(int k = 0; k < 4; ++k)
+					_mm_stream_ps(pOut + (j * 4 + k) * 4, corners[k][j]);
+		}
+		else
+		{
+			for(int j = 0; j < 4; ++j)
+				for(int k = 0; k < 4; ++k)
+					_mm_storeu_ps(pOut + (j * 4 + k) * 4, corners[k][j]);
+		}
+	}
+	if(aligned)
+		_mm_sfence();
+#endif
+	for(; i < range.End; ++i, pVertex += 4)
+	{
+		float t = pLife[i] * pInvLifetime[i];
+		float size = desc.EndSize + sizeDelta * t;
+		Vec3 p(pPosX[i], pPosY[i], pPosZ[i]), sa = a * size, sb = b * size;
+		Vec3 corners[4] = { p - sb, p + sa, p - sa, p + sb };
+		RDCOLOR color = FadeColor(fade, t);
+		for(int k = 0; k < 4; ++k)
+		{
+			PositionColorVertex v = { corners[k].x, corners[k].y, corners[k].z, color };
+			pVertex[k] = v;
+		}
+	}
+}
+
+void ParticleSystem::IntegrateJob(void* pData, unsigned begin, unsigned end)
+{
+	JobData& data = *(JobData*)pData;
+	for(unsigned r = begin; r < end; ++r)
+		data.pSystem->IntegrateRange(data.pSystem->m_Ranges[r], data.Dt);
+}
+
+void ParticleSystem::CompactJob(void* pData, unsigned begin, unsigned end)
+{
+	JobData& data = *(JobData*)pData;
+	for(unsigned p = begin; p < end; ++p)
+		Compact(data.pSystem->m_Pools[p]);
+}
+
+void ParticleSystem::WriteJob(void* pData, unsigned begin, unsigned end)
+{
+	JobData& data = *(JobData*)pData;
+	for(unsigned r = begin; r < end; ++r)
+		data.pSystem->WriteRange(data.pSystem->m_Ranges[r], data.pDst, data.Right, data.Up);
+}
+
+//-----------------------------------------------------------------------------
+//ParticleRenderer
+//-----------------------------------------------------------------------------
+
+ParticleRenderer::ParticleRenderer()
+{
+	m_pDevice = NULL;
+	m_pVB = NULL;
+	m_pIB = NULL;
+	m_MaxQuads = 0;
+	m_DrawCalls = 0;
+}
+
+ParticleRenderer::~ParticleRenderer()
+{
+	Shutdown();
+}
+
+bool ParticleRenderer::Init(IRenderDevice* pDevice, unsigned maxQuads)
+{
+	Shutdown();
+	if(!pDevice || maxQuads == 0)
+		return false;
+
+	//Quad q uses vertices 4q .. 4q + 3, triangles 0-1-2 and 2-1-3 like SpriteBatch
+	unsigned indexCount = std::min(maxQuads, QUADS_PER_DRAW) * 6;
+	void* pIndices = NULL;
+	bool created = pDevice->CreateIndexBuffer(indexCount * sizeof(uint16_t), RD_USAGE_WRITEONLY, RD_FMT_INDEX16, RD_POOL_MANAGED, &m_pIB) &&
+		m_pIB->Lock(0, indexCount * sizeof(uint16_t), &pIndices, 0);
+	if(created)
+	{
+		uint16_t* pDst = (uint16_t*)pIndices;
+		for(unsigned i = 0; i < indexCount / 6; ++i, pDst += 6)
+		{
+			uint16_t base = (uint16_t)(i * 4);
+			pDst[0] = base;
+			pDst[1] = (uint16_t)(base + 1);
+			pDst[2] = (uint16_t)(base + 2);
+			pDst[3] = (uint16_t)(base + 2);
+			pDst[4] = (uint16_t)(base + 1);
+			pDst[5] = (uint16_t)(base + 3);
+		}
+		m_pIB->Unlock();
+		created = pDevice->CreateVertexBuffer(maxQuads * QUAD_BYTES, RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, PositionColorLayout::FVF,
+			RD_POOL_DEFAULT, &m_pVB);
+	}
+	if(!created)
+	{
+		Shutdown();
+		return false;
+	}
+
+	m_pDevice = pDevice;
+	m_MaxQuads = maxQuads;
+	return true;
+}
+
+void ParticleRenderer::Shutdown()
+{
+	SAFE_RELEASE(m_pVB);
+	SAFE_RELEASE(m_pIB);
+	m_pDevice = NULL;
+	m_MaxQuads = 0;
+}
+
+unsigned ParticleRenderer::Draw(ParticleSystem& system, const Mat4& view, JobSystem* pJobs)
+{
+	m_DrawCalls = 0;
+	unsigned count = std::min(system.GetParticleCount(), m_MaxQuads);
+	void* pData = NULL;
+	if(!m_pVB || count == 0 || !m_pVB->Lock(0, count * QUAD_BYTES, &pData, RD_LOCK_DISCARD))
+		return 0;
+	count = system.WriteQuads((PositionColorVertex*)pData, count, view, pJobs);
+	m_pVB->Unlock();
+
+	Submit(count);
+	return count;
+}
+
+unsigned ParticleRenderer::Draw(const PositionColorVertex* pQuads, unsigned quadCount)
+{
+	m_DrawCalls = 0;
+	unsigned count = std::min(quadCount, m_MaxQuads);
+	void* pData = NULL;
+	if(!m_pVB || count == 0 || !m_pVB->Lock(0, count * QUAD_BYTES, &pData, RD_LOCK_DISCARD))
+		return 0;
+	memcpy(pData, pQuads, count * QUAD_BYTES);
+	m_pVB->Unlock();
+
+	Submit(count);
+	return count;
+}
+
+void ParticleRenderer::Submit(unsigned quadCount)
+{
+	m_pDevice->SetFVF(PositionColorLayout::FVF);
+	m_pDevice->SetIndices(m_pIB);
+	m_pDevice->SetStreamSource(0, m_pVB, 0, sizeof(PositionColorVertex));
+	for(unsigned first = 0; first < quadCount; first += QUADS_PER_DRAW)
+	{
+		unsigned chunk = std::min(quadCount - first, QUADS_PER_DRAW);
+		m_pDevice->DrawIndexedPrimitive(RD_PT_TRIANGLELIST, first * 4, 0, chunk * 4, 0, chunk * 2);
+		++m_DrawCalls;
+	}
+}
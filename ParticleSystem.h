@@ -0,0 +1,186 @@
+/* Title: DirectX 9.0c Framework
+/* Description: SIMD particle system. Every emitter owns a fixed pool stored as
+				structure of arrays. Update() spawns new particles, integrates
+				velocity, gravity, drag and lifetime eight particles per AVX
+				instruction (four with SSE2) in parallel chunks on the job system,
+				then removes dead particles by moving the last live one into their
+				slot, so nothing is allocated per particle. WriteQuads() expands
+				every particle into a camera facing quad, size and color faded over
+				its life, written as whole vertices (streaming stores, SSE2 is
+				enough for this memory bound part) straight into a locked vertex
+				buffer. ParticleRenderer owns that dynamic buffer and a shared quad
+				index buffer, and is created through the device so a
+				ResourceRegistryDevice keeps it across resets.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "SimdMath.h"
+#include "VertexLayout.h"
+
+#include <vector>
+
+class JobSystem;
+
+struct ParticleEmitterDesc
+{
+	Vec3		Position;
+	float		PositionSpread;		//Half size of the box new particles start in
+	Vec3		Velocity;
+	float		VelocitySpread;		//Random velocity added per axis, up to this speed
+	float		Rate;				//Particles per second, 0 for bursts only
+	float		LifetimeMin;		//Seconds
+	float		LifetimeMax;
+	Vec3		Gravity;
+	float		Drag;				//Share of the velocity lost per second
+	RDCOLOR		StartColor;			//Faded to EndColor over each particle's life
+	RDCOLOR		EndColor;
+	float		StartSize;			//Half width of the quad
+	float		EndSize;
+};
+
+//Read only view of an emitter's pool, valid until the next Update() or Burst()
+struct ParticleArrays
+{
+	const float*	PosX;
+	const float*	PosY;
+	const float*	PosZ;
+	const float*	VelX;
+	const float*	VelY;
+	const float*	VelZ;
+	const float*	Life;			//Seconds left
+	const float*	InvLifetime;	//1 / total seconds
+	unsigned		Count;
+};
+
+struct ParticleStats
+{
+	unsigned	Alive;
+	unsigned	Spawned;			//By the last Update() and the bursts before it
+	unsigned	Died;
+	unsigned	Dropped;			//Not spawned because the pool was full
+	double		UpdateMs;
+	double		WriteMs;			//Last WriteQuads()
+};
+
+class ParticleSystem
+{
+public:
+	//Particles per parallel chunk
+	enum { CHUNK_SIZE = 16384 };
+
+	ParticleSystem();
+
+	//The pool of capacity particles is allocated here, once. Returns the emitter index.
+	unsigned AddEmitter(const ParticleEmitterDesc& desc, unsigned capacity);
+	unsigned GetEmitterCount() const { return (unsigned)m_Pools.size(); }
+	//Changes apply from the next Update(), e.g. to move the emitter
+	ParticleEmitterDesc& GetEmitter(unsigned emitter) { return m_Pools[emitter].Desc; }
+	ParticleArrays GetParticles(unsigned emitter) const;
+	//Spawns count particles right away (as many as fit)
+	void Burst(unsigned emitter, unsigned count);
+	//Removes every particle
+	void Clear();
+
+	//Spawns by rate, integrates and removes dead particles. With pJobs in parallel chunks.
+	void Update(float dt, JobSystem* pJobs = NULL);
+
+	//Writes up to maxQuads quads (4 vertices each, in the order of the shared quad
+	//indices: top left, top right, bottom left, bottom right) facing the camera of
+	//view, in world space. Returns the quads written.
+	unsigned WriteQuads(PositionColorVertex* pDst, unsigned maxQuads, const Mat4& view, JobSystem* pJobs = NULL);
+
+	unsigned GetParticleCount() const;
+	const ParticleStats& GetStats() const { return m_Stats; }
+
+private:
+	//Disallow copying
+	ParticleSystem(const ParticleSystem&);
+	ParticleSystem& operator=(const ParticleSystem&);
+
+	struct Pool
+	{
+		ParticleEmitterDesc		Desc;
+		std::vector<float>		PosX, PosY, PosZ;
+		std::vector<float>		VelX, VelY, VelZ;
+		std::vector<float>		Life;
+		std::vector<float>		InvLifetime;
+		unsigned				Count;
+		unsigned				Capacity;
+		float					SpawnDebt;		//Fraction of a particle carried to the next Update
+		unsigned				Died;			//By the last Compact
+		uint32_t				Seed;
+	};
+
+	//Part of one pool handed to a job; Output is the first quad for WriteQuads
+	struct Range
+	{
+		unsigned	Pool;
+		unsigned	Begin;
+		unsigned	End;
+		unsigned	Output;
+	};
+
+	struct JobData
+	{
+		ParticleSystem*		pSystem;
+		float				Dt;
+		PositionColorVertex*	pDst;
+		Vec3				Right;
+		Vec3				Up;
+	};
+
+	void Spawn(Pool& pool, unsigned count);
+	//Splits the pools into chunks of at most CHUNK_SIZE, up to maxParticles in total
+	void BuildRanges(unsigned maxParticles);
+	//Swap removes the dead particles of a pool into its Died
+	static void Compact(Pool& pool);
+
+	void IntegrateRange(const Range& range, float dt);
+	void WriteRange(const Range& range, PositionColorVertex* pDst, const Vec3& right, const Vec3& up);
+
+	static void IntegrateJob(void* pData, unsigned begin, unsigned end);
+	static void CompactJob(void* pData, unsigned begin, unsigned end);
+	static void WriteJob(void* pData, unsigned begin, unsigned end);
+
+	std::vector<Pool>		m_Pools;
+	std::vector<Range>		m_Ranges;		//Reused every call
+	unsigned				m_Spawned;	//Since the last Update
+	unsigned				m_Dropped;
+	ParticleStats			m_Stats;
+};
+
+class ParticleRenderer
+{
+public:
+	ParticleRenderer();
+	~ParticleRenderer();
+
+	//Dynamic vertex buffer for maxQuads particles
+	bool Init(IRenderDevice* pDevice, unsigned maxQuads);
+	void Shutdown();
+
+	//Expands the particles straight into the vertex buffer and draws them.
+	//Returns the quads drawn. Both Draw calls set the FVF, stream 0 and the
+	//indices, and expect an identity world transform.
+	unsigned Draw(ParticleSystem& system, const Mat4& view, JobSystem* pJobs = NULL);
+	//Draws quads written earlier, e.g. by WriteQuads() into frame memory while pipelined
+	unsigned Draw(const PositionColorVertex* pQuads, unsigned quadCount);
+
+	unsigned GetMaxQuads() const { return m_MaxQuads; }
+	unsigned GetDrawCalls() const { return m_DrawCalls; }
+
+private:
+	//Disallow copying
+	ParticleRenderer(const ParticleRenderer&);
+	ParticleRenderer& operator=(const ParticleRenderer&);
+
+	void Submit(unsigned quadCount);
+
+	IRenderDevice*	m_pDevice;
+	IVertexBuffer*	m_pVB;
+	IIndexBuffer*	m_pIB;			//Quad indices, shared by every draw
+	unsigned		m_MaxQuads;
+	unsigned		m_DrawCalls;	//Of the last Draw
+};
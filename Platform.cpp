@@ -0,0 +1,102 @@
+#include "Platform.h"
+#include "Timer.h"
+#include "Win32Window.h"
+#include "X11Window.h"
+
+#include <stdio.h>
+#include <signal.h>
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+namespace
+{
+	//Set by Ctrl+C, turned into a quit event by the headless window
+	volatile sig_atomic_t g_Interrupted = 0;
+
+	void OnInterrupt(int)
+	{
+		g_Interrupted = 1;
+	}
+
+	//Window stand-in for headless runs: no surface, no input, only quit on Ctrl+C
+	class HeadlessWindow : public IPlatformWindow
+	{
+	public:
+		HeadlessWindow() : m_pEvents(NULL) {}
+
+		PlatformWindowType GetType() const override { return PLATFORM_WINDOW_HEADLESS; }
+
+		bool Create(const char*, unsigned, unsigned, EventQueue* pEvents, bool) override
+		{
+			m_pEvents = pEvents;
+			g_Interrupted = 0;
+			signal(SIGINT, OnInterrupt);
+			return true;
+		}
+
+		void PumpEvents() override
+		{
+			if(g_Interrupted)
+			{
+				g_Interrupted = 0;
+				PushPlatformEvent(m_pEvents, PE_QUIT);
+			}
+		}
+
+		void WaitForEvents(unsigned ms) override { PlatformSleep(ms); }
+		void SetTitle(const char*) override {}
+		void PresentPixels(const RDCOLOR*, unsigned, unsigned, unsigned) override {}
+		bool SetFullscreen(bool, unsigned*, unsigned*) override { return false; }
+		unsigned GetRefreshRate() const override { return 0; }
+		void* GetNativeHandle() const override { return NULL; }
+
+	private:
+		EventQueue*	m_pEvents;
+	};
+}
+
+IPlatformWindow* CreatePlatformWindow(bool headless)
+{
+	if(headless)
+		return new HeadlessWindow();
+#if defined(_WIN32)
+	return new Win32Window();
+#elif defined(PLATFORM_X11)
+	return new X11Window();
+#else
+	return NULL;
+#endif
+}
+
+void PushPlatformEvent(EventQueue* pEvents, PlatformEventType type, unsigned key, int x, int y)
+{
+	PlatformEvent e;
+	e.Type = type;
+	e.Key = key;
+	e.X = x;
+	e.Y = y;
+	e.Ticks = TimerTicks();
+	pEvents->Push(e);
+}
+
+void PlatformSleep(unsigned ms)
+{
+#ifdef _WIN32
+	Sleep(ms);
+#else
+	timespec duration;
+	duration.tv_sec = ms / 1000;
+	duration.tv_nsec = (long)(ms % 1000) * 1000000;
+	nanosleep(&duration, NULL);
+#endif
+}
+
+void PlatformShowError(const char* pMessage)
+{
+#ifdef _WIN32
+	MessageBox(NULL, pMessage, NULL, NULL);
+#else
+	fprintf(stderr, "%s\n", pMessage);
+#endif
+}
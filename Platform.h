@@ -0,0 +1,74 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Platform layer used by DXApp: the application window (or a
+				headless stand-in), its event ring, sleeping and error reports.
+				Win32 windows are used on Windows, X11 windows on Linux when
+				built with PLATFORM_X11 (link -lX11). The clock is Timer.h.
+				Windows translate OS messages into PlatformEvents pushed to an
+				EventQueue, so the application drains one ring per frame
+				instead of receiving a virtual call per message.
+				Linux build of the test application (add -DPLATFORM_X11 -lX11
+				for a window, without it only -headless and -nulldevice run):
+				g++ -std=c++11 -O2 -pthread winmain.cpp DXApp.cpp Platform.cpp
+				X11Window.cpp SoftwareRenderDevice.cpp NullRenderDevice.cpp
+				StateCache.cpp ResourceRegistry.cpp FrameBenchmark.cpp
+				FramePipeline.cpp JobSystem.cpp FrameArena.cpp AssetStreamer.cpp
+				AssetArchive.cpp FramePacer.cpp HeapStats.cpp Culling.cpp
+				OcclusionBuffer.cpp Profiler.cpp FrameReadback.cpp FrameSink.cpp
+				ShaderCache.cpp InputState.cpp MeshOptimizer.cpp LodSelector.cpp
+				ParticleSystem.cpp FixedTimestep.cpp CommandList.cpp -o testapp
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "EventQueue.h"
+
+enum PlatformWindowType
+{
+	PLATFORM_WINDOW_HEADLESS,	//No window, frames stay in memory
+	PLATFORM_WINDOW_WIN32,
+	PLATFORM_WINDOW_X11
+};
+
+class IPlatformWindow
+{
+public:
+	virtual ~IPlatformWindow() {}
+
+	virtual PlatformWindowType GetType() const = 0;
+
+	//Creates a window with the given client size, shown unless visible is false
+	//(offscreen rendering on a device that needs a window). Events are pushed
+	//to pEvents from then on, whenever the window receives them.
+	virtual bool Create(const char* pTitle, unsigned clientWidth, unsigned clientHeight, EventQueue* pEvents, bool visible) = 0;
+	//Handles pending OS messages without blocking
+	virtual void PumpEvents() = 0;
+	//Blocks until OS messages arrive, at most ms milliseconds
+	virtual void WaitForEvents(unsigned ms) = 0;
+
+	virtual void SetTitle(const char* pTitle) = 0;
+	//Copies 32 bit XRGB pixels (pitch in pixels) into the client area
+	virtual void PresentPixels(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) = 0;
+	//Switches between a borderless window covering the screen and the
+	//original window. Returns the new client size, false if not supported.
+	virtual bool SetFullscreen(bool enable, unsigned* pWidth, unsigned* pHeight) = 0;
+
+	//Display refresh rate in Hz, 0 if unknown
+	virtual unsigned GetRefreshRate() const = 0;
+	//HWND on Windows, the X11 Window id, NULL when headless
+	virtual void* GetNativeHandle() const = 0;
+};
+
+//The window system of this platform, or a headless window. NULL if this
+//build has no window system.
+IPlatformWindow* CreatePlatformWindow(bool headless);
+
+//Stamps an event with the current time and pushes it (used by the windows)
+void PushPlatformEvent(EventQueue* pEvents, PlatformEventType type, unsigned key = 0, int x = 0, int y = 0);
+
+//Sleeps about ms milliseconds (timer granularity, see FramePacer for precise waits)
+void PlatformSleep(unsigned ms);
+
+//Reports a fatal error to the user: a message box, or stderr without a window system
+void PlatformShowError(const char* pMessage);
@@ -0,0 +1,217 @@
+#include "Profiler.h"
+#include "Timer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+PROFILER_THREAD_LOCAL ProfilerThread* t_pProfilerThread = NULL;
+
+namespace
+{
+	//Threads that can record zones at the same time. Released rings go to
+	//the next thread that registers, threads beyond that record nothing.
+	const unsigned MAX_THREADS = 64;
+
+	ProfilerThread g_Threads[MAX_THREADS];
+	std::atomic<bool> g_Ready[MAX_THREADS];		//Ring initialized, safe to read
+	std::atomic<unsigned> g_RingCount(0);		//Rings allocated so far
+	std::atomic<unsigned> g_DroppedThreads(0);	//Registrations that found no ring
+
+	//Guards the free list and ring allocation, taken once per thread
+	std::mutex g_RingLock;
+	unsigned g_FreeRings[MAX_THREADS];
+	unsigned g_FreeCount = 0;
+	unsigned g_NextId = 0;
+
+	//Set once registration failed, so later zones of the thread skip it
+	PROFILER_THREAD_LOCAL bool t_ProfilerFull = false;
+
+	//Both clocks at startup, to convert zone ticks to microseconds
+	struct ProfilerEpoch
+	{
+		ProfilerEpoch() : Ticks(ProfilerTicks()), Timer(TimerTicks()) {}
+
+		uint64_t	Ticks;
+		int64_t		Timer;
+	};
+	ProfilerEpoch g_Epoch;
+
+	//Zone ticks per microsecond, measured against TimerTicks() since startup
+	double MeasureTicksPerUs()
+	{
+#ifdef PROFILER_RDTSC
+		//Give the measurement at least 10 ms right after startup
+		while(TicksToMs(TimerTicks() - g_Epoch.Timer) < 10.0) {}
+		uint64_t ticks = ProfilerTicks();
+		double us = TicksToMs(TimerTicks() - g_Epoch.Timer) * 1000.0;
+		return (double)(ticks - g_Epoch.Ticks) / us;
+#else
+		return TimerFrequency() / 1000000.0;
+#endif
+	}
+
+	//Copies the zones of a ring that survive the copy
+	void CopyRecords(const ProfilerThread& thread, std::vector<ProfileRecord>& records)
+	{
+		records.clear();
+		uint64_t end = thread.Written.load(std::memory_order_acquire);
+		uint64_t begin = end > ProfilerThread::CAPACITY ? end - ProfilerThread::CAPACITY : 0;
+		//Zones of the threads that released the ring before are not exported
+		uint64_t first = thread.FirstRecord.load(std::memory_order_acquire);
+		if(first > begin)
+			begin = first < end ? first : end;
+		for(uint64_t i = begin; i < end; ++i)
+			records.push_back(thread.pRecords[i & (ProfilerThread::CAPACITY - 1)]);
+
+		//The owner kept writing: records it may have overwritten meanwhile
+		//(up to and including the one being written now) are dropped
+		uint64_t written = thread.Written.load(std::memory_order_acquire);
+		uint64_t firstValid = written + 1 > ProfilerThread::CAPACITY ? written + 1 - ProfilerThread::CAPACITY : 0;
+		if(firstValid > begin)
+		{
+			size_t drop = (size_t)(firstValid - begin < records.size() ? firstValid - begin : records.size());
+			records.erase(records.begin(), records.begin() + drop);
+		}
+	}
+
+	//Writes s as a JSON string body
+	void WriteEscaped(FILE* f, const char* s)
+	{
+		for(; *s; ++s)
+		{
+			if(*s == '"' || *s == '\\')
+				fputc('\\', f);
+			fputc(*s, f);
+		}
+	}
+}
+
+ProfilerThread* ProfilerRegisterThread()
+{
+	if(t_pProfilerThread || t_ProfilerFull)
+		return t_pProfilerThread;
+
+	std::lock_guard<std::mutex> lock(g_RingLock);
+
+	unsigned index;
+	if(g_FreeCount > 0)
+	{
+		//Reuse the ring of a thread that exited, its zones are no longer
+		//exported from here on
+		index = g_FreeRings[--g_FreeCount];
+	}
+	else
+	{
+		index = g_RingCount.load(std::memory_order_relaxed);
+		ProfileRecord* pRecords = index < MAX_THREADS ? (ProfileRecord*)malloc(sizeof(ProfileRecord) * ProfilerThread::CAPACITY) : NULL;
+		if(!pRecords)
+		{
+			t_ProfilerFull = true;
+			g_DroppedThreads.fetch_add(1, std::memory_order_relaxed);
+			return NULL;
+		}
+		g_Threads[index].pRecords = pRecords;
+		g_Threads[index].Written.store(0, std::memory_order_relaxed);
+	}
+
+	ProfilerThread& thread = g_Threads[index];
+	thread.FirstRecord.store(thread.Written.load(std::memory_order_relaxed), std::memory_order_release);
+	thread.Id = ++g_NextId;
+	sprintf(thread.Name, "Thread %u", thread.Id);
+	g_Ready[index].store(true, std::memory_order_release);
+	if(index == g_RingCount.load(std::memory_order_relaxed))
+		g_RingCount.store(index + 1, std::memory_order_release);
+
+	t_pProfilerThread = &thread;
+	return t_pProfilerThread;
+}
+
+void ProfilerSetThreadName(const char* pName)
+{
+	ProfilerThread* pThread = ProfilerRegisterThread();
+	if(!pThread)
+		return;
+	strncpy(pThread->Name, pName, sizeof(pThread->Name) - 1);
+	pThread->Name[sizeof(pThread->Name) - 1] = '\0';
+}
+
+void ProfilerReleaseThread()
+{
+	ProfilerThread* pThread = t_pProfilerThread;
+	if(!pThread)
+		return;
+
+	std::lock_guard<std::mutex> lock(g_RingLock);
+	g_FreeRings[g_FreeCount++] = (unsigned)(pThread - g_Threads);
+	t_pProfilerThread = NULL;
+}
+
+bool ProfilerWriteTrace(const char* pPath)
+{
+	FILE* f = fopen(pPath, "w");
+	if(!f)
+		return false;
+
+	double usPerTick = 1.0 / MeasureTicksPerUs();
+	unsigned threads = g_RingCount.load(std::memory_order_acquire);
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"DXApp\"}}");
+	//Shown under the process name, so a trace missing threads says so
+	unsigned dropped = g_DroppedThreads.load(std::memory_order_relaxed);
+	if(dropped > 0)
+		fprintf(f, ",\n{\"name\":\"process_labels\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"labels\":\"%u threads not recorded, all %u rings taken\"}}", dropped, MAX_THREADS);
+
+	std::vector<ProfileRecord> records;
+	records.reserve(ProfilerThread::CAPACITY);
+	for(unsigned t = 0; t < threads; ++t)
+	{
+		if(!g_Ready[t].load(std::memory_order_acquire))
+			continue;
+		const ProfilerThread& thread = g_Threads[t];
+
+		fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", thread.Id);
+		WriteEscaped(f, thread.Name);
+		fprintf(f, "\"}}");
+		//Keeps threads in registration order (main thread first)
+		fprintf(f, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"sort_index\":%u}}", thread.Id, thread.Id);
+
+		CopyRecords(thread, records);
+		for(size_t i = 0; i < records.size(); ++i)
+		{
+			const ProfileRecord& r = records[i];
+			fprintf(f, ",\n{\"name\":\"");
+			WriteEscaped(f, r.pName);
+			fprintf(f, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", thread.Id,
+				(double)(int64_t)(r.Start - g_Epoch.Ticks) * usPerTick, (double)(r.End - r.Start) * usPerTick);
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	return fclose(f) == 0;
+}
+
+ProfilerStats ProfilerGetStats()
+{
+	ProfilerStats stats;
+	memset(&stats, 0, sizeof(ProfilerStats));
+	stats.TicksPerUs = MeasureTicksPerUs();
+
+	stats.DroppedThreads = g_DroppedThreads.load(std::memory_order_relaxed);
+
+	unsigned threads = g_RingCount.load(std::memory_order_acquire);
+	for(unsigned t = 0; t < threads; ++t)
+	{
+		if(!g_Ready[t].load(std::memory_order_acquire))
+			continue;
+		uint64_t written = g_Threads[t].Written.load(std::memory_order_acquire);
+		++stats.Threads;
+		stats.Zones += written;
+		if(written > ProfilerThread::CAPACITY)
+			stats.Overwritten += written - ProfilerThread::CAPACITY;
+	}
+	return stats;
+}
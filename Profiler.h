@@ -0,0 +1,156 @@
+/* Title: DirectX 9.0c Framework
+/* Description: CPU zone profiler. PROFILE_ZONE("Name") times the enclosing
+				scope and records it in a ring buffer owned by the calling
+				thread, so recording takes no locks and the last zones of every
+				thread are always available (a flight recorder for spikes).
+				ProfilerWriteTrace() exports them as Chrome trace JSON, which
+				chrome://tracing and ui.perfetto.dev open. Zones are timed with
+				the time stamp counter where available. Names must be string
+				literals (only the pointer is stored). Threads that exit put
+				PROFILE_THREAD("Name") at the top of their main function so
+				their ring is reused by a later thread. Define PROFILER_DISABLED
+				to compile every zone out.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PROFILER_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include "Timer.h"
+#endif
+
+//Thread local storage without C++11 thread_local (not available in VS2013)
+#if defined(_MSC_VER)
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+struct ProfileRecord
+{
+	const char*	pName;
+	uint64_t	Start;		//ProfilerTicks()
+	uint64_t	End;
+};
+
+//Zones of one thread. Only the owning thread writes, readers copy and drop
+//whatever was overwritten while they copied.
+struct ProfilerThread
+{
+	enum { CAPACITY = 16384 }; //Records kept per thread, power of two
+
+	ProfileRecord*			pRecords;
+	std::atomic<uint64_t>	Written;		//Records written since the ring was created
+	std::atomic<uint64_t>	FirstRecord;	//Written when the current thread took the ring over
+	unsigned				Id;				//Trace thread id, in registration order
+	char					Name[32];
+};
+
+struct ProfilerStats
+{
+	unsigned	Threads;		//Rings in use or kept for reuse
+	unsigned	DroppedThreads;	//Threads that recorded nothing because every ring was taken
+	uint64_t	Zones;			//Zones recorded since startup
+	uint64_t	Overwritten;	//Zones lost because a ring wrapped
+	double		TicksPerUs;		//Zone clock rate
+};
+
+//Cheap timestamp for zones (time stamp counter, or TimerTicks())
+inline uint64_t ProfilerTicks()
+{
+#ifdef PROFILER_RDTSC
+	return __rdtsc();
+#else
+	return (uint64_t)TimerTicks();
+#endif
+}
+
+//Ring of the calling thread, NULL until its first zone
+extern PROFILER_THREAD_LOCAL ProfilerThread* t_pProfilerThread;
+
+//Registers the calling thread (once), NULL if there are too many threads
+ProfilerThread* ProfilerRegisterThread();
+
+//Names the calling thread in traces (registers it if needed)
+void ProfilerSetThreadName(const char* pName);
+
+//Hands the ring of the calling thread to the next thread that registers. Its
+//zones are exported until then. Call it right before the thread exits.
+void ProfilerReleaseThread();
+
+//Appends a zone to the ring of the calling thread
+inline void ProfilerRecord(const char* pName, uint64_t start, uint64_t end)
+{
+	ProfilerThread* pThread = t_pProfilerThread;
+	if(!pThread)
+	{
+		pThread = ProfilerRegisterThread();
+		if(!pThread)
+			return;
+	}
+
+	uint64_t index = pThread->Written.load(std::memory_order_relaxed);
+	ProfileRecord& record = pThread->pRecords[index & (ProfilerThread::CAPACITY - 1)];
+	record.pName = pName;
+	record.Start = start;
+	record.End = end;
+	pThread->Written.store(index + 1, std::memory_order_release);
+}
+
+//Writes the zones still in the rings of all threads as Chrome trace JSON.
+//Can be called at any time from any thread, recording continues meanwhile.
+bool ProfilerWriteTrace(const char* pPath);
+
+ProfilerStats ProfilerGetStats();
+
+//Times the scope it lives in
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* pName) : m_pName(pName), m_Start(ProfilerTicks()) {}
+	~ProfileZone() { ProfilerRecord(m_pName, m_Start, ProfilerTicks()); }
+
+private:
+	//Disallow copying
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	const char*	m_pName;
+	uint64_t	m_Start;
+};
+
+//Names the thread it is created on and releases its ring at the end of the scope
+class ProfileThreadScope
+{
+public:
+	explicit ProfileThreadScope(const char* pName) { ProfilerSetThreadName(pName); }
+	~ProfileThreadScope() { ProfilerReleaseThread(); }
+
+private:
+	//Disallow copying
+	ProfileThreadScope(const ProfileThreadScope&);
+	ProfileThreadScope& operator=(const ProfileThreadScope&);
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef PROFILER_DISABLED
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) ProfilerSetThreadName(name)
+#define PROFILE_THREAD(name) ProfileThreadScope PROFILE_CONCAT(profileThread, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD_NAME(name)
+#define PROFILE_THREAD(name)
+#endif
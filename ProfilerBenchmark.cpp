@@ -0,0 +1,104 @@
+#include "ProfilerBenchmark.h"
+#include "Profiler.h"
+#include "Timer.h"
+
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	const unsigned ZONES = 4000000;
+	const unsigned THREADS = 4;
+	//Short-lived threads started one after the other, more than there are rings
+	const unsigned SHORT_THREADS = 256;
+	//Zones cost about 50 ns here and vary with the machine and its load, the check
+	//only catches a zone that started to lock, allocate or call into the OS
+	const double MAX_ZONE_NS = 200.0;
+
+	//Same zone, timed with the high resolution timer instead of the TSC
+	class TimerZone
+	{
+	public:
+		explicit TimerZone(const char* pName) : m_pName(pName), m_Start(TimerTicks()) {}
+		~TimerZone() { ProfilerRecord(m_pName, (uint64_t)m_Start, (uint64_t)TimerTicks()); }
+
+	private:
+		const char*	m_pName;
+		int64_t		m_Start;
+	};
+
+	void RecordZones(unsigned count)
+	{
+		for(unsigned i = 0; i < count; ++i)
+		{
+			ProfileZone zone("Benchmark zone");
+		}
+	}
+
+	//Thread main of the recording threads, hands the ring back when it returns
+	void RecordWorkerZones(unsigned count)
+	{
+		PROFILE_THREAD("Benchmark worker");
+		RecordZones(count);
+	}
+
+	void RecordTimerZones(unsigned count)
+	{
+		for(unsigned i = 0; i < count; ++i)
+		{
+			TimerZone zone("Benchmark timer zone");
+		}
+	}
+
+	double NsPerZone(int64_t ticks, unsigned zones)
+	{
+		return TicksToMs(ticks) * 1000000.0 / zones;
+	}
+}
+
+bool RunProfilerBenchmarks(FILE* pOut)
+{
+	fprintf(pOut, "Profiler (%u zones, %u record ring per thread)\n", ZONES, (unsigned)ProfilerThread::CAPACITY);
+
+	//Registers this thread outside the measurement
+	RecordZones(1);
+
+	int64_t start = TimerTicks();
+	RecordZones(ZONES);
+	double zoneNs = NsPerZone(TimerTicks() - start, ZONES);
+
+	start = TimerTicks();
+	RecordTimerZones(ZONES);
+	double timerZoneNs = NsPerZone(TimerTicks() - start, ZONES);
+
+	fprintf(pOut, "TSC zone          %6.1f ns%s\n", zoneNs, zoneNs <= MAX_ZONE_NS ? "" : "  OVER THE LIMIT");
+	fprintf(pOut, "TimerTicks zone   %6.1f ns\n", timerZoneNs);
+
+	//Rings are per thread, so threads recording at once do not share cache lines
+	std::vector<std::thread> threads;
+	start = TimerTicks();
+	for(unsigned t = 0; t < THREADS; ++t)
+		threads.push_back(std::thread(RecordWorkerZones, ZONES / THREADS));
+	for(unsigned t = 0; t < THREADS; ++t)
+		threads[t].join();
+	fprintf(pOut, "%u threads         %6.1f ns per zone (wall time over all zones, %u cores)\n", THREADS,
+		NsPerZone(TimerTicks() - start, ZONES), std::thread::hardware_concurrency());
+
+	//Threads that exited gave their ring back, so none of these goes unrecorded
+	for(unsigned t = 0; t < SHORT_THREADS; ++t)
+		std::thread(RecordWorkerZones, 1u).join();
+
+	//Export everything the rings hold
+	ProfilerStats stats = ProfilerGetStats();
+	const char* pPath = "profiler_benchmark.trace.json";
+	start = TimerTicks();
+	bool written = ProfilerWriteTrace(pPath);
+	double exportMs = TicksToMs(TimerTicks() - start);
+	fprintf(pOut, "Export            %6.1f ms for %u threads (%llu zones recorded, %llu overwritten, %.0f ticks/us)\n",
+		exportMs, stats.Threads, (unsigned long long)stats.Zones, (unsigned long long)stats.Overwritten, stats.TicksPerUs);
+	fprintf(pOut, "Thread churn      %u threads, %u rings in use, %u not recorded\n", SHORT_THREADS, stats.Threads, stats.DroppedThreads);
+	remove(pPath);
+
+	return written && zoneNs <= MAX_ZONE_NS && stats.DroppedThreads == 0;
+}
@@ -0,0 +1,15 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Profiler benchmark: cost of a zone on one and several threads
+				(against zones timed with TimerTicks()), ring reuse across
+				short-lived threads, and the cost of a trace export.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if the export fails, a thread went
+//unrecorded or a zone costs more than 200 ns (several times the usual cost, so
+//timing noise does not fail it)
+bool RunProfilerBenchmarks(FILE* pOut);
@@ -0,0 +1,211 @@
+#include "ReadbackBenchmark.h"
+#include "FrameReadback.h"
+#include "SoftwareRenderDevice.h"
+#include "VertexLayout.h"
+#include "Timer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const unsigned WIDTH = 1280;
+	const unsigned HEIGHT = 720;
+	const unsigned FRAMES = 120;
+	const unsigned TRIANGLES = 256;
+	const char* RAW_PATH = "readback_bench.raw";
+	const char* IMAGE_PREFIX = "readback_bench_";
+
+	//Clear color of a frame, so the sink can tell which frame it received
+	RDCOLOR FrameColor(unsigned frame)
+	{
+		return RD_COLOR_ARGB(255, frame * 7, frame * 13, frame * 29);
+	}
+
+	//Forwards to another sink after checking order and contents
+	class CheckingSink : public IFrameSink
+	{
+	public:
+		explicit CheckingSink(IFrameSink* pSink) : m_pSink(pSink), m_Next(0), m_Errors(0) {}
+
+		bool WriteFrame(unsigned frame, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) override
+		{
+			//The top left corner is never covered by a triangle
+			if(frame != m_Next || width != WIDTH || height != HEIGHT || pPixels[0] != FrameColor(frame))
+				++m_Errors;
+			m_Next = frame + 1;
+			return m_pSink->WriteFrame(frame, pPixels, width, height, pitch);
+		}
+		bool Finish() override { return m_pSink->Finish(); }
+
+		bool IsValid(unsigned frames) const { return m_Errors == 0 && m_Next == frames; }
+
+	private:
+		IFrameSink*	m_pSink;
+		unsigned	m_Next;
+		unsigned	m_Errors;
+	};
+
+	class Scene
+	{
+	public:
+		explicit Scene(IRenderDevice* pDevice) : m_pDevice(pDevice), m_pVB(NULL)
+		{
+			float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			m_pDevice->SetTransform(RD_TS_WORLD, identity);
+			m_pDevice->SetTransform(RD_TS_VIEW, identity);
+			m_pDevice->SetTransform(RD_TS_PROJECTION, identity);
+			m_pDevice->SetRenderState(RD_RS_CULLMODE, RD_CULL_NONE);
+			m_pDevice->SetRenderState(RD_RS_LIGHTING, 0);
+			m_pDevice->CreateVertexBuffer(TRIANGLES * 3 * sizeof(PositionColorVertex), RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY,
+				PositionColorLayout::FVF, RD_POOL_DEFAULT, &m_pVB);
+		}
+		~Scene() { SAFE_RELEASE(m_pVB); }
+
+		//Triangles drift across the frame, staying clear of the corners
+		void Render(unsigned frame)
+		{
+			PositionColorVertex* pVerts = NULL;
+			if(m_pVB->Lock(0, 0, (void**)&pVerts, RD_LOCK_DISCARD))
+			{
+				for(unsigned i = 0; i < TRIANGLES * 3; ++i)
+				{
+					unsigned seed = (i / 3) * 2654435761u;
+					float t = (float)((frame + (seed >> 8)) % 200) / 200.0f;
+					pVerts[i].x = -0.8f + 1.4f * t + 0.2f * (float)(i % 3 == 1);
+					pVerts[i].y = -0.8f + 1.4f * (float)((seed >> 16) & 255) / 255.0f + 0.2f * (float)(i % 3 == 2);
+					pVerts[i].z = 0.5f;
+					pVerts[i].Color = RD_COLOR_ARGB(255, seed >> 4, seed >> 12, seed >> 20);
+				}
+				m_pVB->Unlock();
+			}
+
+			m_pDevice->Clear(RD_CLEAR_TARGET | RD_CLEAR_ZBUFFER, FrameColor(frame), 1.0f, 0);
+			m_pDevice->BeginScene();
+			m_pDevice->SetStreamSource(0, m_pVB, 0, sizeof(PositionColorVertex));
+			m_pDevice->SetFVF(PositionColorLayout::FVF);
+			m_pDevice->DrawPrimitive(RD_PT_TRIANGLELIST, 0, TRIANGLES);
+			m_pDevice->EndScene();
+			m_pDevice->Present();
+		}
+
+	private:
+		IRenderDevice*	m_pDevice;
+		IVertexBuffer*	m_pVB;
+	};
+
+	struct RunResult
+	{
+		double			Fps;
+		ReadbackStats	Stats;
+		bool			Valid;
+	};
+
+	//Renders FRAMES frames, exporting them to pSink unless it is NULL
+	RunResult Run(SoftwareRenderDevice* pDevice, IFrameSink* pSink, unsigned ringSize)
+	{
+		Scene scene(pDevice);
+		FrameReadback readback;
+		CheckingSink checker(pSink);
+		RunResult result;
+		memset(&result, 0, sizeof(result));
+
+		bool ok = !pSink || readback.Init(pDevice, &checker, ringSize);
+		int64_t start = TimerTicks();
+		for(unsigned frame = 0; frame < FRAMES && ok; ++frame)
+		{
+			scene.Render(frame);
+			if(pSink)
+				ok = readback.Capture();
+		}
+		if(pSink)
+			ok = readback.Finish() && ok;
+		else
+			pDevice->Flush();
+		double ms = TicksToMs(TimerTicks() - start);
+
+		result.Fps = FRAMES * 1000.0 / ms;
+		result.Stats = readback.GetStats();
+		result.Valid = ok && (!pSink || (checker.IsValid(FRAMES) && result.Stats.Exported == FRAMES));
+		readback.Shutdown();
+		return result;
+	}
+
+	void Print(FILE* pOut, const char* pName, const RunResult& r, double baseFps)
+	{
+		fprintf(pOut, "%-22s %7.1f fps exported (%5.1f%% of rendering), lock %.2f ms, sink %.2f ms per frame%s\n",
+			pName, r.Fps, 100.0 * r.Fps / baseFps, r.Stats.LockMs / FRAMES, r.Stats.SinkMs / FRAMES,
+			r.Valid ? "" : ", FRAMES LOST OR WRONG");
+	}
+
+	//Bytes written and removes the files
+	uint64_t RemoveImages(const char* pExtension)
+	{
+		uint64_t bytes = 0;
+		char path[64];
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			sprintf(path, "%s%06u.%s", IMAGE_PREFIX, frame, pExtension);
+			if(FILE* f = fopen(path, "rb"))
+			{
+				fseek(f, 0, SEEK_END);
+				bytes += ftell(f);
+				fclose(f);
+			}
+			remove(path);
+		}
+		return bytes;
+	}
+}
+
+bool RunReadbackBenchmarks(FILE* pOut)
+{
+	SoftwareRenderDevice device(WIDTH, HEIGHT);
+	fprintf(pOut, "Offscreen readback (%ux%u, %u frames of %u triangles, software device on %u threads)\n",
+		WIDTH, HEIGHT, FRAMES, TRIANGLES, device.GetThreadCount());
+	bool ok = true;
+
+	//The first run pays for page faults of the device's buffers
+	Run(&device, NULL, 0);
+	RunResult base = Run(&device, NULL, 0);
+	fprintf(pOut, "%-22s %7.1f fps\n", "Rendering only", base.Fps);
+
+	//The software device copies in CopyBackBuffer(), so the ring only hides
+	//latency on GPUs; here it shows that deferred locking costs nothing
+	NullFrameSink nullSink;
+	for(unsigned ring = 1; ring <= 3; ring += 2)
+	{
+		RunResult r = Run(&device, &nullSink, ring);
+		char name[32];
+		sprintf(name, "Null sink, ring %u", ring);
+		Print(pOut, name, r, base.Fps);
+		ok = ok && r.Valid;
+	}
+
+	{
+		RawFileSink raw;
+		RunResult r = raw.Open(RAW_PATH) ? Run(&device, &raw, 3) : RunResult();
+		Print(pOut, "Raw file", r, base.Fps);
+		ok = ok && r.Valid;
+		remove(RAW_PATH);
+	}
+
+	unsigned threads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+	for(int png = 0; png < 2; ++png)
+	{
+		ImageFileSink images;
+		images.Init(IMAGE_PREFIX, png ? IMAGE_PNG : IMAGE_PPM, threads, threads + 2);
+		RunResult r = Run(&device, &images, 3);
+		images.Shutdown();
+		char name[32];
+		sprintf(name, "%s, %u encoders", png ? "PNG" : "PPM", threads);
+		Print(pOut, name, r, base.Fps);
+		fprintf(pOut, "%-22s %u waits for an encoder, %.2f MB per frame\n", "",
+			images.GetStalls(), RemoveImages(png ? "png" : "ppm") / 1e6 / FRAMES);
+		ok = ok && r.Valid;
+	}
+
+	fprintf(pOut, "Exported frames %s\n", ok ? "complete and in order" : "LOST OR WRONG");
+	return ok;
+}
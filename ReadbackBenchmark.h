@@ -0,0 +1,14 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Offscreen export benchmark: renders frames on the software
+				device and reads them back through FrameReadback into each
+				frame sink, reporting the exported frames per second. Also
+				checks that every frame arrives once, in order, with its pixels.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if frames were lost, reordered or wrong
+bool RunReadbackBenchmarks(FILE* pOut);
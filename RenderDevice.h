@@ -0,0 +1,418 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Rendering device abstraction owned by DXApp.
+				The interface mirrors the subset of IDirect3DDevice9 the framework uses,
+				so the Direct3D 9 backend is a thin forwarder and other backends (software,
+				null) can run the same frame loop without a GPU.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Portable scalar types (match the Win32 typedefs in size)
+typedef uint32_t RDWORD;
+typedef uint32_t RDCOLOR; //ARGB, identical layout to D3DCOLOR
+
+//Same helpers as d3dUtil.h, for code that does not include Windows headers
+#ifndef SAFE_RELEASE
+#define SAFE_RELEASE(x) { if(x) x->Release(); x=NULL; }
+#endif
+#ifndef SAFE_DELETE
+#define SAFE_DELETE(x) { if(x) delete x; x = NULL; }
+#endif
+
+//Builds an ARGB color, same as D3DCOLOR_ARGB
+#define RD_COLOR_ARGB(a, r, g, b) \
+	((RDCOLOR)((((a) & 0xff) << 24) | (((r) & 0xff) << 16) | (((g) & 0xff) << 8) | ((b) & 0xff)))
+
+//NOTE: every enum value below is numerically identical to its Direct3D 9 counterpart.
+//This lets the Direct3D backend pass them straight through and lets existing
+//code keep using D3D constants (e.g. VertexPositionColor::FVF) with any backend.
+
+//Flexible vertex format bits (D3DFVF_*)
+enum RDFVF
+{
+	RD_FVF_XYZ = 0x002,
+	RD_FVF_XYZRHW = 0x004,
+	RD_FVF_NORMAL = 0x010,
+	RD_FVF_DIFFUSE = 0x040,
+	RD_FVF_SPECULAR = 0x080,
+	RD_FVF_TEX1 = 0x100,
+	RD_FVF_POSITION_MASK = 0x400E,
+	RD_FVF_TEXCOUNT_MASK = 0xf00,
+	RD_FVF_TEXCOUNT_SHIFT = 8
+};
+
+//Transform state types (D3DTS_*)
+enum RDTransformType
+{
+	RD_TS_VIEW = 2,
+	RD_TS_PROJECTION = 3,
+	RD_TS_WORLD = 256
+};
+
+//Render states supported by the framework (D3DRS_*)
+enum RDRenderState
+{
+	RD_RS_ZENABLE = 7,
+	RD_RS_SHADEMODE = 9,
+	RD_RS_ZWRITEENABLE = 14,
+	RD_RS_SRCBLEND = 19,
+	RD_RS_DESTBLEND = 20,
+	RD_RS_CULLMODE = 22,
+	RD_RS_ZFUNC = 23,
+	RD_RS_ALPHABLENDENABLE = 27,
+	RD_RS_LIGHTING = 137,
+	RD_RS_MAX = 210 //Size of a render state table
+};
+
+//Shade modes (D3DSHADE_*)
+enum RDShadeMode
+{
+	RD_SHADE_FLAT = 1,
+	RD_SHADE_GOURAUD = 2
+};
+
+//Cull modes (D3DCULL_*)
+enum RDCullMode
+{
+	RD_CULL_NONE = 1,
+	RD_CULL_CW = 2,
+	RD_CULL_CCW = 3
+};
+
+//Blend factors (D3DBLEND_*)
+enum RDBlend
+{
+	RD_BLEND_ZERO = 1,
+	RD_BLEND_ONE = 2,
+	RD_BLEND_SRCALPHA = 5,
+	RD_BLEND_INVSRCALPHA = 6
+};
+
+//Compare functions (D3DCMP_*)
+enum RDCompareFunc
+{
+	RD_CMP_NEVER = 1,
+	RD_CMP_LESS = 2,
+	RD_CMP_EQUAL = 3,
+	RD_CMP_LESSEQUAL = 4,
+	RD_CMP_GREATER = 5,
+	RD_CMP_NOTEQUAL = 6,
+	RD_CMP_GREATEREQUAL = 7,
+	RD_CMP_ALWAYS = 8
+};
+
+//Primitive types (D3DPT_*)
+enum RDPrimitiveType
+{
+	RD_PT_POINTLIST = 1,
+	RD_PT_LINELIST = 2,
+	RD_PT_LINESTRIP = 3,
+	RD_PT_TRIANGLELIST = 4,
+	RD_PT_TRIANGLESTRIP = 5,
+	RD_PT_TRIANGLEFAN = 6
+};
+
+//Clear flags (D3DCLEAR_*)
+enum RDClearFlags
+{
+	RD_CLEAR_TARGET = 0x1,
+	RD_CLEAR_ZBUFFER = 0x2,
+	RD_CLEAR_STENCIL = 0x4
+};
+
+//Memory pools (D3DPOOL_*)
+enum RDPool
+{
+	RD_POOL_DEFAULT = 0,
+	RD_POOL_MANAGED = 1,
+	RD_POOL_SYSTEMMEM = 2
+};
+
+//Buffer usage flags (D3DUSAGE_*)
+enum RDUsage
+{
+	RD_USAGE_WRITEONLY = 0x8,
+	RD_USAGE_DYNAMIC = 0x200
+};
+
+//Lock flags (D3DLOCK_*)
+enum RDLockFlags
+{
+	RD_LOCK_READONLY = 0x10,
+	RD_LOCK_NOOVERWRITE = 0x1000,
+	RD_LOCK_DISCARD = 0x2000
+};
+
+//Index formats (D3DFMT_INDEX*)
+enum RDIndexFormat
+{
+	RD_FMT_INDEX16 = 101,
+	RD_FMT_INDEX32 = 102
+};
+
+//Vertex element types (D3DDECLTYPE_*)
+enum RDDeclType
+{
+	RD_DECLTYPE_FLOAT1 = 0,
+	RD_DECLTYPE_FLOAT2 = 1,
+	RD_DECLTYPE_FLOAT3 = 2,
+	RD_DECLTYPE_FLOAT4 = 3,
+	RD_DECLTYPE_D3DCOLOR = 4,
+	RD_DECLTYPE_UBYTE4N = 8,		//4 bytes mapped to 0..1
+	RD_DECLTYPE_SHORT2N = 9,		//2 shorts mapped to -1..1
+	RD_DECLTYPE_SHORT4N = 10,
+	RD_DECLTYPE_FLOAT16_2 = 15,		//2 half floats
+	RD_DECLTYPE_FLOAT16_4 = 16,
+	RD_DECLTYPE_UNUSED = 17
+};
+
+//Vertex element usages (D3DDECLUSAGE_*)
+enum RDDeclUsage
+{
+	RD_DECLUSAGE_POSITION = 0,
+	RD_DECLUSAGE_NORMAL = 3,
+	RD_DECLUSAGE_TEXCOORD = 5,
+	RD_DECLUSAGE_POSITIONT = 9,
+	RD_DECLUSAGE_COLOR = 10
+};
+
+//Stream frequency flags for SetStreamSourceFreq (D3DSTREAMSOURCE_*). Stream 0
+//of an instanced draw is set to RD_STREAMSOURCE_INDEXEDDATA | instance count,
+//the per instance streams to RD_STREAMSOURCE_INSTANCEDATA | 1.
+#define RD_STREAMSOURCE_INDEXEDDATA (1u << 30)
+#define RD_STREAMSOURCE_INSTANCEDATA (2u << 30)
+#define RD_STREAMSOURCE_COUNT_MASK 0x3FFFFFFFu
+
+//Result of TestCooperativeLevel, backend independent
+enum RDDeviceState
+{
+	RD_DEVICE_OK,
+	RD_DEVICE_LOST,			//Lost and can not be reset yet
+	RD_DEVICE_NOTRESET,		//Lost but ready to be reset
+	RD_DEVICE_DRIVERERROR	//Fatal error
+};
+
+//Backend identification
+enum RDDeviceType
+{
+	RD_DEVICE_DIRECT3D9,
+	RD_DEVICE_SOFTWARE,
+	RD_DEVICE_NULL
+};
+
+//Parameters used to (re)create the device back buffer
+struct RDPresentParams
+{
+	unsigned	BackBufferWidth;
+	unsigned	BackBufferHeight;
+	bool		Windowed;
+};
+
+//Viewport (same layout as D3DVIEWPORT9)
+struct RDViewport
+{
+	RDWORD	X;
+	RDWORD	Y;
+	RDWORD	Width;
+	RDWORD	Height;
+	float	MinZ;
+	float	MaxZ;
+};
+
+//One vertex attribute (same layout as D3DVERTEXELEMENT9)
+struct RDVertexElement
+{
+	uint16_t	Stream;
+	uint16_t	Offset;
+	uint8_t		Type;			//RDDeclType
+	uint8_t		Method;			//Always 0 (D3DDECLMETHOD_DEFAULT)
+	uint8_t		Usage;			//RDDeclUsage
+	uint8_t		UsageIndex;
+};
+
+//Terminates an element array, same as D3DDECL_END()
+#define RD_DECL_END() { 0xFF, 0, RD_DECLTYPE_UNUSED, 0, 0, 0 }
+
+//Instanced geometry: every vertex is transformed by a world matrix read from a
+//per instance stream instead of the RD_TS_WORLD transform. The rows of the
+//matrix are FLOAT3 TEXCOORD elements with these usage indices (the fourth
+//column is 0, 0, 0, 1) and a D3DCOLOR COLOR element with usage index
+//RD_INSTANCE_COLOR_INDEX is multiplied with the vertex color. Any device
+//that reports SupportsInstancing() draws declarations following this layout.
+enum RDInstanceLayout
+{
+	RD_INSTANCE_WORLD_INDEX = 1,	//TEXCOORD1 .. TEXCOORD4 hold rows 0 .. 3
+	RD_INSTANCE_COLOR_INDEX = 1		//COLOR1
+};
+
+//Per channel product of two colors, the way the instance color applies to vertex colors
+inline RDCOLOR RDModulateColor(RDCOLOR a, RDCOLOR b)
+{
+	RDCOLOR result = 0;
+	for(int shift = 0; shift < 32; shift += 8)
+	{
+		//Rounded product / 255, without dividing
+		RDCOLOR product = ((a >> shift) & 0xff) * ((b >> shift) & 0xff) + 128;
+		result |= ((product + (product >> 8)) >> 8) << shift;
+	}
+	return result;
+}
+
+//Base class for any GPU buffer. Release() deletes the object so the
+//SAFE_RELEASE macro works exactly like it does for COM objects.
+class IRenderBuffer
+{
+public:
+	virtual ~IRenderBuffer() {}
+
+	virtual bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags) = 0;
+	virtual void Unlock() = 0;
+	virtual void Release() = 0;
+
+	virtual unsigned GetSize() const = 0;
+	virtual RDPool GetPool() const = 0;
+};
+
+class IVertexBuffer : public IRenderBuffer
+{
+};
+
+class IIndexBuffer : public IRenderBuffer
+{
+public:
+	virtual RDIndexFormat GetFormat() const = 0;
+};
+
+//System memory copy of the back buffer, filled by IRenderDevice::CopyBackBuffer().
+//The copy may still be in flight on the GPU, Lock() waits for it. Release()
+//deletes the object like it does for buffers.
+class IReadbackSurface
+{
+public:
+	virtual ~IReadbackSurface() {}
+
+	//32 bit ARGB pixels, pitch in pixels
+	virtual bool Lock(const RDCOLOR** ppPixels, unsigned* pPitch) = 0;
+	virtual void Unlock() = 0;
+	virtual void Release() = 0;
+
+	virtual unsigned GetWidth() const = 0;
+	virtual unsigned GetHeight() const = 0;
+};
+
+//Texture stages of the fixed function pipeline
+enum { RD_MAX_TEXTURE_STAGES = 8 };
+
+//32 bit ARGB texture with a single mip level, created by IRenderDevice::CreateTexture().
+//Lives in the managed pool and survives Reset(). Release() deletes the object
+//like it does for buffers.
+class ITexture
+{
+public:
+	virtual ~ITexture() {}
+
+	//Copies width x height pixels (pitch in pixels) to x, y
+	virtual bool Update(unsigned x, unsigned y, unsigned width, unsigned height, const RDCOLOR* pPixels, unsigned pitch) = 0;
+	virtual void Release() = 0;
+
+	virtual unsigned GetWidth() const = 0;
+	virtual unsigned GetHeight() const = 0;
+};
+
+//Vertex layout created by IRenderDevice::CreateVertexDeclaration(). Survives
+//Reset(). Release() deletes the object like it does for buffers.
+class IVertexDeclaration
+{
+public:
+	virtual ~IVertexDeclaration() {}
+
+	virtual void Release() = 0;
+};
+
+//Programmable pipeline stages
+enum RDShaderType
+{
+	RD_SHADER_VERTEX,
+	RD_SHADER_PIXEL
+};
+
+//Compiled shader created by IRenderDevice::CreateShader(). Survives Reset().
+//Release() deletes the object like it does for buffers.
+class IShader
+{
+public:
+	virtual ~IShader() {}
+
+	virtual RDShaderType GetShaderType() const = 0;
+	virtual void Release() = 0;
+};
+
+//Abstract rendering device
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	virtual RDDeviceType GetType() const = 0;
+
+	//Resources
+	virtual bool CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB) = 0;
+	virtual bool CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB) = 0;
+	//Readback target the size of the back buffer. Not restored by Reset(), release it before.
+	virtual bool CreateReadbackSurface(IReadbackSurface** ppSurface) = 0;
+	//pElements ends with RD_DECL_END(). Fails for layouts the device can not draw.
+	virtual bool CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl) = 0;
+	//Direct3D 9 shader bytecode (D3DXCompileShader output). Fails on devices without shaders.
+	virtual bool CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader) = 0;
+	//Up to GetMaxTextureSize() pixels on a side, contents undefined until updated
+	virtual bool CreateTexture(unsigned width, unsigned height, ITexture** ppTexture) = 0;
+
+	//States
+	virtual void SetViewport(const RDViewport& viewport) = 0;
+	virtual void SetTransform(RDTransformType type, const float* matrix) = 0; //16 floats, row major (D3DMATRIX layout)
+	virtual void SetRenderState(RDRenderState state, RDWORD value) = 0;
+	virtual void SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride) = 0;
+	virtual void SetIndices(IIndexBuffer* pIB) = 0;
+	virtual void SetFVF(RDWORD fvf) = 0;
+	//Replaces the FVF until the next SetFVF() call, like in Direct3D 9. Like a
+	//buffer, a declaration must stay alive while it is set.
+	virtual void SetVertexDeclaration(IVertexDeclaration* pDecl) = 0;
+	//Instance count of stream 0 or instance data flag of the others, 1 for plain drawing
+	virtual void SetStreamSourceFreq(unsigned stream, RDWORD setting) = 0;
+	//Replaces the fixed function stage of the shader's type, NULL goes back to it.
+	//Like a buffer, a shader must stay alive while it is set.
+	virtual void SetShader(RDShaderType type, IShader* pShader) = 0;
+	//count float4 registers from register start. Reset() clears them.
+	virtual void SetShaderConstantF(RDShaderType type, unsigned start, const float* pData, unsigned count) = 0;
+	//Stage 0 modulates the texture with the vertex color (the Direct3D 9 defaults).
+	//Like a buffer, a texture must stay alive while it is set.
+	virtual void SetTexture(unsigned stage, ITexture* pTexture) = 0;
+
+	//Frame
+	virtual void Clear(RDWORD flags, RDCOLOR color, float z, RDWORD stencil) = 0;
+	virtual void BeginScene() = 0;
+	virtual void EndScene() = 0;
+	virtual void DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount) = 0;
+	virtual void DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+		unsigned numVertices, unsigned startIndex, unsigned primCount) = 0;
+	virtual void Present() = 0;
+	//Queues a copy of the back buffer into pSurface. Call it before Present(),
+	//unless the swap chain keeps the back buffer (D3DSWAPEFFECT_COPY).
+	virtual bool CopyBackBuffer(IReadbackSurface* pSurface) = 0;
+
+	//Caps
+	//True if DrawIndexedPrimitive() draws instances (see RDInstanceLayout)
+	virtual bool SupportsInstancing() const = 0;
+	//True if CreateShader() takes shader model 2.0 (and any lower) bytecode
+	virtual bool SupportsShaders() const = 0;
+	//Largest width and height CreateTexture() accepts
+	virtual unsigned GetMaxTextureSize() const = 0;
+
+	//Device loss
+	virtual RDDeviceState TestCooperativeLevel() = 0;
+	virtual bool Reset(const RDPresentParams& params) = 0;
+};
@@ -0,0 +1,238 @@
+#include "ResetBenchmark.h"
+#include "AssetArchive.h"
+#include "ResourceRegistry.h"
+#include "NullRenderDevice.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned STATIC_BUFFERS = 256;			//Default pool, restored from their copies
+	const unsigned STATIC_SIZE = 256 * 1024;
+	const unsigned DYNAMIC_BUFFERS = 32;			//Default pool, refilled by the application
+	const unsigned DYNAMIC_SIZE = 64 * 1024;
+	const unsigned MANAGED_BUFFERS = 64;			//Survive a reset
+	const unsigned MANAGED_SIZE = 256 * 1024;
+	const unsigned RUNS = 5;
+	const char* ARCHIVE_PATH = "reset_benchmark.pak";	//One asset per static and managed buffer
+
+	struct BufferSet
+	{
+		std::vector<IVertexBuffer*> Static;
+		std::vector<IVertexBuffer*> Dynamic;
+		std::vector<IVertexBuffer*> Managed;
+		IIndexBuffer* pIndices;
+	};
+
+	//Contents of buffer i (static buffers first, then managed ones)
+	void Generate(unsigned buffer, std::vector<uint8_t>& data)
+	{
+		data.resize(std::max(STATIC_SIZE, MANAGED_SIZE));
+		for(size_t i = 0; i < data.size(); ++i)
+			data[i] = (uint8_t)(i * 31 + 7 + buffer);
+	}
+
+	bool WriteArchive()
+	{
+		AssetArchiveWriter writer;
+		std::vector<uint8_t> data;
+		for(unsigned i = 0; i < STATIC_BUFFERS + MANAGED_BUFFERS; ++i)
+		{
+			char name[32];
+			sprintf(name, "buffer%u", i);
+			Generate(i, data);
+			writer.AddRaw(name, &data[0], data.size());
+		}
+		return writer.Write(ARCHIVE_PATH);
+	}
+
+	//Data of every buffer in the archive, false if one is missing
+	bool FindContents(const AssetArchive& archive, std::vector<const uint8_t*>& contents)
+	{
+		contents.assign(STATIC_BUFFERS + MANAGED_BUFFERS, NULL);
+		for(unsigned i = 0; i < contents.size(); ++i)
+		{
+			char name[32];
+			sprintf(name, "buffer%u", i);
+			int index = archive.Find(name);
+			if(index < 0 || archive.GetEntry((unsigned)index).Size < std::max(STATIC_SIZE, MANAGED_SIZE))
+				return false;
+			contents[i] = archive.GetData((unsigned)index);
+		}
+		return true;
+	}
+
+	void Fill(IVertexBuffer* pVB, const uint8_t* pContents, unsigned size)
+	{
+		void* pData = NULL;
+		if(pVB->Lock(0, size, &pData, 0))
+		{
+			memcpy(pData, pContents, size);
+			pVB->Unlock();
+		}
+	}
+
+	//contents holds the data of every static and managed buffer
+	bool Create(IRenderDevice* pDevice, const std::vector<const uint8_t*>& contents, BufferSet& set)
+	{
+		bool ok = true;
+		set.Static.assign(STATIC_BUFFERS, NULL);
+		set.Dynamic.assign(DYNAMIC_BUFFERS, NULL);
+		set.Managed.assign(MANAGED_BUFFERS, NULL);
+		for(unsigned i = 0; i < STATIC_BUFFERS && ok; ++i)
+		{
+			ok = pDevice->CreateVertexBuffer(STATIC_SIZE, RD_USAGE_WRITEONLY, RD_FVF_XYZ, RD_POOL_DEFAULT, &set.Static[i]);
+			if(ok)
+				Fill(set.Static[i], contents[i], STATIC_SIZE);
+		}
+		for(unsigned i = 0; i < DYNAMIC_BUFFERS && ok; ++i)
+			ok = pDevice->CreateVertexBuffer(DYNAMIC_SIZE, RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, RD_FVF_XYZ, RD_POOL_DEFAULT, &set.Dynamic[i]);
+		for(unsigned i = 0; i < MANAGED_BUFFERS && ok; ++i)
+		{
+			ok = pDevice->CreateVertexBuffer(MANAGED_SIZE, 0, RD_FVF_XYZ, RD_POOL_MANAGED, &set.Managed[i]);
+			if(ok)
+				Fill(set.Managed[i], contents[STATIC_BUFFERS + i], MANAGED_SIZE);
+		}
+		set.pIndices = NULL;
+		return ok && pDevice->CreateIndexBuffer(STATIC_SIZE, RD_USAGE_WRITEONLY, RD_FMT_INDEX16, RD_POOL_DEFAULT, &set.pIndices);
+	}
+
+	void Release(BufferSet& set)
+	{
+		for(size_t i = 0; i < set.Static.size(); ++i)
+			SAFE_RELEASE(set.Static[i]);
+		for(size_t i = 0; i < set.Dynamic.size(); ++i)
+			SAFE_RELEASE(set.Dynamic[i]);
+		for(size_t i = 0; i < set.Managed.size(); ++i)
+			SAFE_RELEASE(set.Managed[i]);
+		SAFE_RELEASE(set.pIndices);
+	}
+
+	bool Matches(IRenderBuffer* pBuffer, const std::vector<uint8_t>& data)
+	{
+		void* pData = NULL;
+		if(!pBuffer || !pBuffer->Lock(0, (unsigned)data.size(), &pData, RD_LOCK_READONLY))
+			return false;
+		bool same = memcmp(pData, &data[0], data.size()) == 0;
+		pBuffer->Unlock();
+		return same;
+	}
+
+	double Median(std::vector<double> values)
+	{
+		std::sort(values.begin(), values.end());
+		return values.empty() ? 0.0 : values[values.size() / 2];
+	}
+
+	//Recovery through the registry, returns false if anything was not restored
+	bool RunRegistry(JobSystem* pJobs, const std::vector<uint8_t>& data, std::vector<double>& recoveryMs, ResourceStats& lastStats)
+	{
+		NullRenderDevice* pNull = new NullRenderDevice(64, 64);
+		ResourceRegistryDevice registry(pNull, pJobs);
+		BufferSet set;
+		bool ok = Create(&registry, std::vector<const uint8_t*>(STATIC_BUFFERS + MANAGED_BUFFERS, &data[0]), set);
+		registry.SetRenderState(RD_RS_LIGHTING, 0);
+		registry.SetStreamSource(0, set.Static[0], 0, 16);
+
+		RDPresentParams params = { 64, 64, true };
+		for(unsigned run = 0; run < RUNS && ok; ++run)
+		{
+			IVertexBuffer* pManaged = registry.GetBackendBuffer(set.Managed[0]);
+			pNull->SimulateDeviceLoss(1);
+			while(registry.TestCooperativeLevel() == RD_DEVICE_LOST) {}
+			unsigned renderStates = pNull->GetCounters().SetRenderState;
+			unsigned streams = pNull->GetCounters().SetStreamSource;
+
+			ok = registry.Reset(params);
+			recoveryMs.push_back(registry.GetStats().RecoveryMs);
+
+			//Static contents back in new storage, managed storage untouched, states applied again
+			for(unsigned i = 0; i < STATIC_BUFFERS && ok; ++i)
+				ok = Matches(registry.GetBackendBuffer(set.Static[i]), data);
+			for(unsigned i = 0; i < DYNAMIC_BUFFERS && ok; ++i)
+				ok = registry.GetBackendBuffer(set.Dynamic[i]) != NULL;
+			ok = ok && registry.GetBackendBuffer(set.Managed[0]) == pManaged && registry.GetBackendBuffer(set.pIndices) != NULL;
+			ok = ok && pNull->GetCounters().SetRenderState > renderStates && pNull->GetCounters().SetStreamSource > streams;
+		}
+		lastStats = registry.GetStats();
+		Release(set);
+		return ok && registry.GetStats().Buffers == 0;
+	}
+}
+
+bool RunResetBenchmarks(FILE* pOut)
+{
+	unsigned defaultMB = (STATIC_BUFFERS * STATIC_SIZE + DYNAMIC_BUFFERS * DYNAMIC_SIZE + STATIC_SIZE) >> 20;
+	fprintf(pOut, "Device reset (%u MB default pool in %u buffers, %u MB managed)\n",
+		defaultMB, STATIC_BUFFERS + DYNAMIC_BUFFERS + 1, (MANAGED_BUFFERS * MANAGED_SIZE) >> 20);
+
+	std::vector<uint8_t> data;
+	Generate(0, data);
+	bool ok = true;
+
+	//The mock must refuse a reset while default pool buffers are alive, like Direct3D
+	{
+		NullRenderDevice device(64, 64);
+		IVertexBuffer* pVB = NULL;
+		device.CreateVertexBuffer(1024, 0, RD_FVF_XYZ, RD_POOL_DEFAULT, &pVB);
+		device.SimulateDeviceLoss();
+		RDPresentParams params = { 64, 64, true };
+		bool refused = !device.Reset(params);
+		SAFE_RELEASE(pVB);
+		bool accepted = device.Reset(params) && device.TestCooperativeLevel() == RD_DEVICE_OK;
+		ok = refused && accepted;
+		fprintf(pOut, "Mock device: reset with default pool buffers alive %s, after releasing them %s\n",
+			refused ? "refused" : "ACCEPTED", accepted ? "accepted" : "REFUSED");
+	}
+
+	//Without a registry the application releases every buffer and loads it again
+	//from its asset archive, each buffer from its own asset
+	{
+		NullRenderDevice device(64, 64);
+		BufferSet set;
+		set.pIndices = NULL;
+		std::vector<const uint8_t*> contents;
+		std::vector<double> reloadMs;
+		RDPresentParams params = { 64, 64, true };
+		ok = WriteArchive() && ok;
+		for(unsigned run = 0; run <= RUNS && ok; ++run)
+		{
+			device.SimulateDeviceLoss();
+			int64_t start = TimerTicks();
+			Release(set);
+			AssetArchive archive;
+			ok = device.Reset(params) && archive.Open(ARCHIVE_PATH) && FindContents(archive, contents) && Create(&device, contents, set);
+			//The first load only brings the archive into the page cache
+			if(run > 0)
+				reloadMs.push_back(TicksToMs(TimerTicks() - start));
+		}
+		std::vector<uint8_t> expected;
+		Generate(STATIC_BUFFERS - 1, expected);
+		ok = ok && Matches(set.Static[STATIC_BUFFERS - 1], expected);
+		Release(set);
+		remove(ARCHIVE_PATH);
+		fprintf(pOut, "Reload everything from the archive: %.2f ms median\n", Median(reloadMs));
+	}
+
+	//Registry: only default pool buffers, copies serial or on the jobs
+	JobSystem jobs;
+	jobs.Init();
+	for(int parallel = 0; parallel < 2 && ok; ++parallel)
+	{
+		std::vector<double> recoveryMs;
+		ResourceStats stats;
+		ok = RunRegistry(parallel ? &jobs : NULL, data, recoveryMs, stats);
+		fprintf(pOut, "Registry (%u threads): %.2f ms median, %.2f ms max (release %.2f, reset %.2f, restore %.2f), "
+			"%u buffers re-created, %.1f MB uploaded, %.1f MB of copies\n",
+			parallel ? jobs.GetThreadCount() : 1, Median(recoveryMs), stats.MaxRecoveryMs, stats.ReleaseMs, stats.ResetMs,
+			stats.RestoreMs, stats.Recreated, stats.RestoredBytes / 1e6, stats.ShadowBytes / 1e6);
+	}
+	jobs.Shutdown();
+
+	fprintf(pOut, "Restored buffers and states %s\n", ok ? "match" : "DIFFER");
+	return ok;
+}
@@ -0,0 +1,14 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Device reset benchmark: loses the null device with a mix of
+				default, dynamic and managed buffers alive and compares reloading
+				every buffer by hand from an asset archive with the recovery of
+				ResourceRegistryDevice, serial and on the job system.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if restored buffers or states are wrong
+bool RunResetBenchmarks(FILE* pOut);
@@ -0,0 +1,529 @@
+#include "ResourceRegistry.h"
+#include "JobSystem.h"
+#include "Timer.h"
+#include "Profiler.h"
+
+#include <string.h>
+
+//Creation parameters and storage of a registered buffer, shared by both proxy types
+struct TrackedResource
+{
+	TrackedResource(ResourceRegistryDevice* pOwner, bool indexBuffer, unsigned length, RDWORD usage,
+		RDWORD fvf, RDIndexFormat format, RDPool pool)
+		: pOwner(pOwner), pStorage(NULL), IndexBuffer(indexBuffer), Length(length), Usage(usage),
+		FVF(fvf), Format(format), Pool(pool), Slot(0), LockOffset(0), LockSize(0), LockFlags(0), pUploadTarget(NULL) {}
+
+	bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags);
+	void Unlock();
+	//Unregisters and releases the storage, the proxy deletes itself afterwards
+	void Destroy();
+
+	ResourceRegistryDevice*	pOwner;			//NULL once detached from a destroyed registry
+	IRenderBuffer*			pStorage;		//Backend buffer, NULL while released for a reset
+	bool					IndexBuffer;
+	unsigned				Length;
+	RDWORD					Usage;
+	RDWORD					FVF;
+	RDIndexFormat			Format;
+	RDPool					Pool;
+	std::vector<uint8_t>	Shadow;			//Copy of the contents, static default pool buffers only
+	unsigned				Slot;			//Index in the registry
+
+	//Current lock of a shadowed buffer
+	unsigned				LockOffset;
+	unsigned				LockSize;
+	RDWORD					LockFlags;
+	//Backend memory locked while a reset uploads the shadow
+	void*					pUploadTarget;
+};
+
+namespace
+{
+	//Proxy handed to the application, stays valid while the storage comes and goes
+	template<typename Base>
+	class TrackedBuffer : public Base, public TrackedResource
+	{
+	public:
+		TrackedBuffer(ResourceRegistryDevice* pOwner, bool indexBuffer, unsigned length, RDWORD usage,
+			RDWORD fvf, RDIndexFormat format, RDPool pool)
+			: TrackedResource(pOwner, indexBuffer, length, usage, fvf, format, pool) {}
+
+		bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags) override
+		{
+			return TrackedResource::Lock(offset, size, ppData, flags);
+		}
+		void Unlock() override { TrackedResource::Unlock(); }
+		void Release() override
+		{
+			Destroy();
+			delete this;
+		}
+		unsigned GetSize() const override { return Length; }
+		RDPool GetPool() const override { return Pool; }
+	};
+
+	typedef TrackedBuffer<IVertexBuffer> TrackedVertexBuffer;
+
+	class TrackedIndexBuffer : public TrackedBuffer<IIndexBuffer>
+	{
+	public:
+		TrackedIndexBuffer(ResourceRegistryDevice* pOwner, unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool)
+			: TrackedBuffer<IIndexBuffer>(pOwner, true, length, usage, 0, format, pool) {}
+
+		RDIndexFormat GetFormat() const override { return Format; }
+	};
+
+	TrackedResource* ToTracked(IVertexBuffer* pVB)
+	{
+		return pVB ? static_cast<TrackedVertexBuffer*>(pVB) : NULL;
+	}
+
+	TrackedResource* ToTracked(IIndexBuffer* pIB)
+	{
+		return pIB ? static_cast<TrackedIndexBuffer*>(pIB) : NULL;
+	}
+
+	IVertexBuffer* GetVertexStorage(TrackedResource* pBuffer)
+	{
+		return pBuffer ? static_cast<IVertexBuffer*>(pBuffer->pStorage) : NULL;
+	}
+
+	IIndexBuffer* GetIndexStorage(TrackedResource* pBuffer)
+	{
+		return pBuffer ? static_cast<IIndexBuffer*>(pBuffer->pStorage) : NULL;
+	}
+}
+
+bool TrackedResource::Lock(unsigned offset, unsigned size, void** ppData, RDWORD flags)
+{
+	//Size 0 locks the rest of the buffer, like Direct3D
+	if(!pOwner || offset > Length)
+		return false;
+	if(size == 0)
+		size = Length - offset;
+	if(size > Length - offset)
+		return false;
+
+	if(Shadow.empty())
+		return pStorage && pStorage->Lock(offset, size, ppData, flags);
+
+	//Writes go to the copy and reach the backend on Unlock, so the
+	//write only backend memory is never read back
+	*ppData = &Shadow[offset];
+	LockOffset = offset;
+	LockSize = size;
+	LockFlags = flags;
+	return true;
+}
+
+void TrackedResource::Unlock()
+{
+	if(Shadow.empty())
+	{
+		if(pStorage)
+			pStorage->Unlock();
+		return;
+	}
+
+	//While the storage is released the copy is uploaded by the next reset
+	void* pData = NULL;
+	if(pStorage && LockSize > 0 && !(LockFlags & RD_LOCK_READONLY) &&
+		pStorage->Lock(LockOffset, LockSize, &pData, LockFlags))
+	{
+		memcpy(pData, &Shadow[LockOffset], LockSize);
+		pStorage->Unlock();
+	}
+	LockSize = 0;
+}
+
+void TrackedResource::Destroy()
+{
+	if(pOwner)
+		pOwner->Unregister(this);
+	SAFE_RELEASE(pStorage);
+}
+
+ResourceRegistryDevice::ResourceRegistryDevice(IRenderDevice* pDevice, JobSystem* pJobs)
+{
+	m_pDevice = pDevice;
+	m_pJobs = pJobs;
+	memset(m_RenderStates, 0, sizeof(m_RenderStates));
+	memset(m_RenderStateValid, 0, sizeof(m_RenderStateValid));
+	memset(m_Transforms, 0, sizeof(m_Transforms));
+	memset(m_TransformValid, 0, sizeof(m_TransformValid));
+	memset(m_Streams, 0, sizeof(m_Streams));
+	m_pIndices = NULL;
+	m_FVF = 0;
+	m_pDecl = NULL;
+	memset(m_pShaders, 0, sizeof(m_pShaders));
+	memset(m_pTextures, 0, sizeof(m_pTextures));
+	m_BudgetMs = 100.0;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+ResourceRegistryDevice::~ResourceRegistryDevice()
+{
+	//Buffers the application did not release must not reach the backend anymore
+	for(size_t i = 0; i < m_Resources.size(); ++i)
+	{
+		SAFE_RELEASE(m_Resources[i]->pStorage);
+		m_Resources[i]->pOwner = NULL;
+	}
+	m_Resources.clear();
+	SAFE_DELETE(m_pDevice);
+}
+
+IVertexBuffer* ResourceRegistryDevice::GetBackendBuffer(IVertexBuffer* pVB) const
+{
+	return GetVertexStorage(ToTracked(pVB));
+}
+
+IIndexBuffer* ResourceRegistryDevice::GetBackendBuffer(IIndexBuffer* pIB) const
+{
+	return GetIndexStorage(ToTracked(pIB));
+}
+
+bool ResourceRegistryDevice::CreateStorage(TrackedResource* pResource)
+{
+	if(pResource->IndexBuffer)
+	{
+		IIndexBuffer* pIB = NULL;
+		if(!m_pDevice->CreateIndexBuffer(pResource->Length, pResource->Usage, pResource->Format, pResource->Pool, &pIB))
+			return false;
+		pResource->pStorage = pIB;
+	}
+	else
+	{
+		IVertexBuffer* pVB = NULL;
+		if(!m_pDevice->CreateVertexBuffer(pResource->Length, pResource->Usage, pResource->FVF, pResource->Pool, &pVB))
+			return false;
+		pResource->pStorage = pVB;
+	}
+	return true;
+}
+
+bool ResourceRegistryDevice::CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB)
+{
+	if(!ppVB)
+		return false;
+
+	TrackedVertexBuffer* pBuffer = new TrackedVertexBuffer(this, false, length, usage, fvf, RD_FMT_INDEX16, pool);
+	if(!Register(pBuffer))
+	{
+		delete pBuffer;
+		return false;
+	}
+
+	*ppVB = pBuffer;
+	return true;
+}
+
+bool ResourceRegistryDevice::CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB)
+{
+	if(!ppIB)
+		return false;
+
+	TrackedIndexBuffer* pBuffer = new TrackedIndexBuffer(this, length, usage, format, pool);
+	if(!Register(pBuffer))
+	{
+		delete pBuffer;
+		return false;
+	}
+
+	*ppIB = pBuffer;
+	return true;
+}
+
+bool ResourceRegistryDevice::Register(TrackedResource* pResource)
+{
+	if(!CreateStorage(pResource))
+		return false;
+
+	//Only static default pool contents are lost on reset and not rewritten
+	//by the application anyway, so only those need a copy
+	if(pResource->Pool == RD_POOL_DEFAULT && !(pResource->Usage & RD_USAGE_DYNAMIC))
+		pResource->Shadow.resize(pResource->Length);
+
+	pResource->Slot = (unsigned)m_Resources.size();
+	m_Resources.push_back(pResource);
+	++m_Stats.Buffers;
+	m_Stats.DefaultBuffers += pResource->Pool == RD_POOL_DEFAULT ? 1 : 0;
+	m_Stats.ShadowBytes += pResource->Shadow.size();
+	return true;
+}
+
+void ResourceRegistryDevice::Unregister(TrackedResource* pResource)
+{
+	//Swap with the last entry
+	TrackedResource* pLast = m_Resources.back();
+	m_Resources[pResource->Slot] = pLast;
+	pLast->Slot = pResource->Slot;
+	m_Resources.pop_back();
+
+	--m_Stats.Buffers;
+	m_Stats.DefaultBuffers -= pResource->Pool == RD_POOL_DEFAULT ? 1 : 0;
+	m_Stats.ShadowBytes -= pResource->Shadow.size();
+
+	//Do not restore bindings of a buffer that is gone
+	for(int i = 0; i < MAX_STREAMS; ++i)
+	{
+		if(m_Streams[i].pBuffer == pResource)
+			m_Streams[i].pBuffer = NULL;
+	}
+	if(m_pIndices == pResource)
+		m_pIndices = NULL;
+}
+
+int ResourceRegistryDevice::GetTransformIndex(RDTransformType type) const
+{
+	switch(type)
+	{
+	case RD_TS_WORLD:		return 0;
+	case RD_TS_VIEW:		return 1;
+	case RD_TS_PROJECTION:	return 2;
+	default:				return -1;
+	}
+}
+
+void ResourceRegistryDevice::SetTransform(RDTransformType type, const float* matrix)
+{
+	int index = GetTransformIndex(type);
+	if(index >= 0)
+	{
+		memcpy(m_Transforms[index], matrix, sizeof(m_Transforms[index]));
+		m_TransformValid[index] = true;
+	}
+	m_pDevice->SetTransform(type, matrix);
+}
+
+void ResourceRegistryDevice::SetRenderState(RDRenderState state, RDWORD value)
+{
+	if(state >= 0 && state < RD_RS_MAX)
+	{
+		m_RenderStates[state] = value;
+		m_RenderStateValid[state] = true;
+	}
+	m_pDevice->SetRenderState(state, value);
+}
+
+void ResourceRegistryDevice::SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride)
+{
+	TrackedResource* pBuffer = ToTracked(pVB);
+	if(stream < MAX_STREAMS)
+	{
+		m_Streams[stream].pBuffer = pBuffer;
+		m_Streams[stream].Offset = offset;
+		m_Streams[stream].Stride = stride;
+	}
+	m_pDevice->SetStreamSource(stream, GetVertexStorage(pBuffer), offset, stride);
+}
+
+void ResourceRegistryDevice::SetIndices(IIndexBuffer* pIB)
+{
+	m_pIndices = ToTracked(pIB);
+	m_pDevice->SetIndices(GetIndexStorage(m_pIndices));
+}
+
+void ResourceRegistryDevice::SetFVF(RDWORD fvf)
+{
+	m_FVF = fvf;
+	m_pDecl = NULL;
+	m_pDevice->SetFVF(fvf);
+}
+
+void ResourceRegistryDevice::SetVertexDeclaration(IVertexDeclaration* pDecl)
+{
+	m_pDecl = pDecl;
+	m_pDevice->SetVertexDeclaration(pDecl);
+}
+
+void ResourceRegistryDevice::SetStreamSourceFreq(unsigned stream, RDWORD setting)
+{
+	if(stream < MAX_STREAMS)
+		m_Streams[stream].Freq = setting;
+	m_pDevice->SetStreamSourceFreq(stream, setting);
+}
+
+void ResourceRegistryDevice::SetShader(RDShaderType type, IShader* pShader)
+{
+	m_pShaders[type] = pShader;
+	m_pDevice->SetShader(type, pShader);
+}
+
+void ResourceRegistryDevice::SetTexture(unsigned stage, ITexture* pTexture)
+{
+	if(stage < RD_MAX_TEXTURE_STAGES)
+		m_pTextures[stage] = pTexture;
+	m_pDevice->SetTexture(stage, pTexture);
+}
+
+bool ResourceRegistryDevice::Reset(const RDPresentParams& params)
+{
+	int64_t start = TimerTicks();
+
+	//Direct3D refuses to reset while default pool resources exist
+	{
+		PROFILE_ZONE("Release storage");
+		ReleaseStorage();
+	}
+	int64_t resetStart = TimerTicks();
+
+	bool reset = false;
+	{
+		PROFILE_ZONE("Backend reset");
+		reset = m_pDevice->Reset(params);
+	}
+	int64_t restoreStart = TimerTicks();
+
+	if(reset)
+	{
+		PROFILE_ZONE("Restore storage");
+		reset = RestoreStorage();
+		RestoreState();
+	}
+	int64_t end = TimerTicks();
+
+	m_Stats.ReleaseMs = TicksToMs(resetStart - start);
+	m_Stats.ResetMs = TicksToMs(restoreStart - resetStart);
+	m_Stats.RestoreMs = TicksToMs(end - restoreStart);
+	m_Stats.RecoveryMs = TicksToMs(end - start);
+	if(!reset)
+	{
+		++m_Stats.FailedResets;
+		return false;
+	}
+
+	++m_Stats.Recoveries;
+	if(m_Stats.RecoveryMs > m_Stats.MaxRecoveryMs)
+		m_Stats.MaxRecoveryMs = m_Stats.RecoveryMs;
+	if(m_Stats.RecoveryMs > m_BudgetMs)
+		++m_Stats.OverBudget;
+	return true;
+}
+
+void ResourceRegistryDevice::ReleaseStorage()
+{
+	//Unbind first, the backend may still reference the buffers
+	for(int i = 0; i < MAX_STREAMS; ++i)
+	{
+		if(m_Streams[i].pBuffer && m_Streams[i].pBuffer->Pool == RD_POOL_DEFAULT)
+			m_pDevice->SetStreamSource(i, NULL, 0, 0);
+	}
+	if(m_pIndices && m_pIndices->Pool == RD_POOL_DEFAULT)
+		m_pDevice->SetIndices(NULL);
+
+	for(size_t i = 0; i < m_Resources.size(); ++i)
+	{
+		if(m_Resources[i]->Pool == RD_POOL_DEFAULT)
+			SAFE_RELEASE(m_Resources[i]->pStorage);
+	}
+}
+
+bool ResourceRegistryDevice::RestoreStorage()
+{
+	//Creating and locking are device calls and stay on this thread,
+	//only the copies are spread over the job system
+	bool restored = true;
+	m_Stats.Recreated = 0;
+	m_Stats.RestoredBytes = 0;
+	m_Uploads.clear();
+	for(size_t i = 0; i < m_Resources.size(); ++i)
+	{
+		TrackedResource* pBuffer = m_Resources[i];
+		if(pBuffer->Pool != RD_POOL_DEFAULT || pBuffer->pStorage)
+			continue;
+		if(!CreateStorage(pBuffer))
+		{
+			restored = false;
+			continue;
+		}
+		++m_Stats.Recreated;
+
+		//Dynamic buffers are refilled by the application
+		if(pBuffer->Shadow.empty())
+			continue;
+		if(!pBuffer->pStorage->Lock(0, pBuffer->Length, &pBuffer->pUploadTarget, 0))
+		{
+			restored = false;
+			continue;
+		}
+
+		//Large buffers are split so one of them does not serialize the upload
+		for(unsigned offset = 0; offset < pBuffer->Length; offset += UPLOAD_CHUNK_SIZE)
+		{
+			UploadChunk chunk = { pBuffer, offset, pBuffer->Length - offset };
+			if(chunk.Size > UPLOAD_CHUNK_SIZE)
+				chunk.Size = UPLOAD_CHUNK_SIZE;
+			m_Uploads.push_back(chunk);
+		}
+	}
+
+	unsigned chunks = (unsigned)m_Uploads.size();
+	if(m_pJobs && m_pJobs->IsRunning() && chunks > 1)
+		m_pJobs->ParallelFor(chunks, 1, UploadJob, this);
+	else
+		UploadJob(this, 0, chunks);
+
+	//Every chunk of a buffer is done, unlock each buffer once (at its first chunk)
+	for(unsigned i = 0; i < chunks; ++i)
+	{
+		if(m_Uploads[i].Offset != 0)
+			continue;
+		TrackedResource* pBuffer = m_Uploads[i].pBuffer;
+		pBuffer->pStorage->Unlock();
+		pBuffer->pUploadTarget = NULL;
+		m_Stats.RestoredBytes += pBuffer->Length;
+	}
+	return restored;
+}
+
+void ResourceRegistryDevice::UploadJob(void* pData, unsigned begin, unsigned end)
+{
+	ResourceRegistryDevice* pRegistry = static_cast<ResourceRegistryDevice*>(pData);
+	for(unsigned i = begin; i < end; ++i)
+	{
+		const UploadChunk& chunk = pRegistry->m_Uploads[i];
+		memcpy((uint8_t*)chunk.pBuffer->pUploadTarget + chunk.Offset, &chunk.pBuffer->Shadow[chunk.Offset], chunk.Size);
+	}
+}
+
+void ResourceRegistryDevice::RestoreState()
+{
+	//A reset puts the backend back to its default state
+	for(int i = 0; i < RD_RS_MAX; ++i)
+	{
+		if(m_RenderStateValid[i])
+			m_pDevice->SetRenderState((RDRenderState)i, m_RenderStates[i]);
+	}
+
+	static const RDTransformType transforms[MAX_TRANSFORMS] = { RD_TS_WORLD, RD_TS_VIEW, RD_TS_PROJECTION };
+	for(int i = 0; i < MAX_TRANSFORMS; ++i)
+	{
+		if(m_TransformValid[i])
+			m_pDevice->SetTransform(transforms[i], m_Transforms[i]);
+	}
+
+	if(m_pDecl)
+		m_pDevice->SetVertexDeclaration(m_pDecl);
+	else if(m_FVF)
+		m_pDevice->SetFVF(m_FVF);
+	if(m_pShaders[RD_SHADER_VERTEX])
+		m_pDevice->SetShader(RD_SHADER_VERTEX, m_pShaders[RD_SHADER_VERTEX]);
+	if(m_pShaders[RD_SHADER_PIXEL])
+		m_pDevice->SetShader(RD_SHADER_PIXEL, m_pShaders[RD_SHADER_PIXEL]);
+	for(int i = 0; i < RD_MAX_TEXTURE_STAGES; ++i)
+	{
+		if(m_pTextures[i])
+			m_pDevice->SetTexture(i, m_pTextures[i]);
+	}
+
+	for(int i = 0; i < MAX_STREAMS; ++i)
+	{
+		if(m_Streams[i].pBuffer)
+			m_pDevice->SetStreamSource(i, GetVertexStorage(m_Streams[i].pBuffer), m_Streams[i].Offset, m_Streams[i].Stride);
+		if(m_Streams[i].Freq > 1)
+			m_pDevice->SetStreamSourceFreq(i, m_Streams[i].Freq);
+	}
+	if(m_pIndices)
+		m_pDevice->SetIndices(GetIndexStorage(m_pIndices));
+}
@@ -0,0 +1,177 @@
+/* Title: DirectX 9.0c Framework
+/* Description: IRenderDevice decorator that tracks every buffer created through
+				it, so a device reset only has to re-create what the reset destroys.
+				Applications get proxy buffers that stay valid across resets.
+				Default pool buffers lose their storage on reset: static ones keep a
+				system memory copy which is uploaded again (copies spread over the
+				job system), dynamic ones come back empty for the application to
+				refill. Managed and system memory buffers are left alone. The last
+				render states, transforms, bindings, shaders and textures are restored as
+				well (shader constants are not, set them again before drawing).
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+
+class JobSystem;
+struct TrackedResource;
+
+struct ResourceStats
+{
+	unsigned	Buffers;			//Live buffers
+	unsigned	DefaultBuffers;		//Of those, in the default pool (re-created on reset)
+	uint64_t	ShadowBytes;		//System memory copies kept for re-uploads
+	unsigned	Recoveries;			//Successful resets
+	unsigned	FailedResets;
+	unsigned	OverBudget;			//Resets slower than the recovery budget
+	unsigned	Recreated;			//Buffers re-created by the last reset
+	uint64_t	RestoredBytes;		//Bytes uploaded again by the last reset
+	double		ReleaseMs;			//Last reset: releasing default pool storage
+	double		ResetMs;			//Last reset: the backend Reset() itself
+	double		RestoreMs;			//Last reset: re-creating and uploading
+	double		RecoveryMs;			//Last reset in total
+	double		MaxRecoveryMs;
+};
+
+class ResourceRegistryDevice : public IRenderDevice
+{
+public:
+	//Takes ownership of pDevice. With pJobs, uploads after a reset run in parallel.
+	explicit ResourceRegistryDevice(IRenderDevice* pDevice, JobSystem* pJobs = NULL);
+	//Buffers still alive are detached: their storage is released, Lock() fails
+	~ResourceRegistryDevice();
+
+	IRenderDevice* GetInnerDevice() const { return m_pDevice; }
+	void SetJobSystem(JobSystem* pJobs) { m_pJobs = pJobs; }
+
+	//Resets slower than this count as over budget
+	void SetRecoveryBudget(double ms) { m_BudgetMs = ms; }
+	const ResourceStats& GetStats() const { return m_Stats; }
+
+	//Backend buffer behind a proxy, NULL while its storage is released (tests and tools)
+	IVertexBuffer* GetBackendBuffer(IVertexBuffer* pVB) const;
+	IIndexBuffer* GetBackendBuffer(IIndexBuffer* pIB) const;
+
+	RDDeviceType GetType() const override { return m_pDevice->GetType(); }
+
+	bool CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB) override;
+	bool CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB) override;
+	//Not tracked, the owner releases and re-creates readback surfaces around a reset
+	bool CreateReadbackSurface(IReadbackSurface** ppSurface) override { return m_pDevice->CreateReadbackSurface(ppSurface); }
+	//Not tracked either, declarations survive a reset
+	bool CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl) override
+	{
+		return m_pDevice->CreateVertexDeclaration(pElements, ppDecl);
+	}
+	//Shaders survive a reset too
+	bool CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader) override
+	{
+		return m_pDevice->CreateShader(type, pBytecode, size, ppShader);
+	}
+	//And so do textures, they live in the managed pool
+	bool CreateTexture(unsigned width, unsigned height, ITexture** ppTexture) override
+	{
+		return m_pDevice->CreateTexture(width, height, ppTexture);
+	}
+
+	void SetViewport(const RDViewport& viewport) override { m_pDevice->SetViewport(viewport); }
+	void SetTransform(RDTransformType type, const float* matrix) override;
+	void SetRenderState(RDRenderState state, RDWORD value) override;
+	void SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride) override;
+	void SetIndices(IIndexBuffer* pIB) override;
+	void SetFVF(RDWORD fvf) override;
+	void SetVertexDeclaration(IVertexDeclaration* pDecl) override;
+	void SetStreamSourceFreq(unsigned stream, RDWORD setting) override;
+	void SetShader(RDShaderType type, IShader* pShader) override;
+	void SetShaderConstantF(RDShaderType type, unsigned start, const float* pData, unsigned count) override
+	{
+		m_pDevice->SetShaderConstantF(type, start, pData, count);
+	}
+	void SetTexture(unsigned stage, ITexture* pTexture) override;
+
+	void Clear(RDWORD flags, RDCOLOR color, float z, RDWORD stencil) override { m_pDevice->Clear(flags, color, z, stencil); }
+	void BeginScene() override { m_pDevice->BeginScene(); }
+	void EndScene() override { m_pDevice->EndScene(); }
+	void DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount) override
+	{
+		m_pDevice->DrawPrimitive(type, startVertex, primCount);
+	}
+	void DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+		unsigned numVertices, unsigned startIndex, unsigned primCount) override
+	{
+		m_pDevice->DrawIndexedPrimitive(type, baseVertexIndex, minIndex, numVertices, startIndex, primCount);
+	}
+	void Present() override { m_pDevice->Present(); }
+	bool CopyBackBuffer(IReadbackSurface* pSurface) override { return m_pDevice->CopyBackBuffer(pSurface); }
+
+	bool SupportsInstancing() const override { return m_pDevice->SupportsInstancing(); }
+	bool SupportsShaders() const override { return m_pDevice->SupportsShaders(); }
+	unsigned GetMaxTextureSize() const override { return m_pDevice->GetMaxTextureSize(); }
+
+	RDDeviceState TestCooperativeLevel() override { return m_pDevice->TestCooperativeLevel(); }
+	//Releases default pool storage, resets the backend, then re-creates and restores
+	bool Reset(const RDPresentParams& params) override;
+
+private:
+	//Disallow copying
+	ResourceRegistryDevice(const ResourceRegistryDevice&);
+	ResourceRegistryDevice& operator=(const ResourceRegistryDevice&);
+
+	friend struct TrackedResource;
+
+	enum { MAX_STREAMS = 4, MAX_TRANSFORMS = 3, UPLOAD_CHUNK_SIZE = 256 * 1024 };
+
+	//Part of a buffer copied by one upload job
+	struct UploadChunk
+	{
+		TrackedResource*	pBuffer;
+		unsigned			Offset;
+		unsigned			Size;
+	};
+
+	struct StreamBinding
+	{
+		TrackedResource*	pBuffer;
+		unsigned			Offset;
+		unsigned			Stride;
+		RDWORD				Freq;		//0 if never set
+	};
+
+	//Creates the storage of a new proxy and adds it
+	bool Register(TrackedResource* pResource);
+	bool CreateStorage(TrackedResource* pResource);
+	//Called by a proxy being released
+	void Unregister(TrackedResource* pResource);
+
+	void ReleaseStorage();
+	bool RestoreStorage();
+	void RestoreState();
+	int GetTransformIndex(RDTransformType type) const;
+
+	static void UploadJob(void* pData, unsigned begin, unsigned end);
+
+	IRenderDevice*					m_pDevice;
+	JobSystem*						m_pJobs;
+	std::vector<TrackedResource*>	m_Resources;
+	std::vector<UploadChunk>		m_Uploads;		//Copies of the current Reset()
+
+	//Last state set through the registry, applied again after a reset. The
+	//viewport is not, a reset sets it to the (possibly resized) back buffer.
+	RDWORD							m_RenderStates[RD_RS_MAX];
+	bool							m_RenderStateValid[RD_RS_MAX];
+	float							m_Transforms[MAX_TRANSFORMS][16];
+	bool							m_TransformValid[MAX_TRANSFORMS];
+	StreamBinding					m_Streams[MAX_STREAMS];
+	TrackedResource*				m_pIndices;
+	RDWORD							m_FVF;
+	IVertexDeclaration*				m_pDecl;		//Set after the FVF, NULL if the FVF is current
+	IShader*						m_pShaders[2];	//Per RDShaderType, NULL for fixed function
+	ITexture*						m_pTextures[RD_MAX_TEXTURE_STAGES];
+
+	double							m_BudgetMs;
+	ResourceStats					m_Stats;
+};
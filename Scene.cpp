@@ -0,0 +1,631 @@
+#include "Scene.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <string.h>
+
+namespace
+{
+	//Objects per ParallelFor range, a multiple of the SIMD batch
+	const unsigned UPDATE_GRAIN = 4096;
+
+	struct UpdateData
+	{
+		Scene*		pScene;
+		unsigned	First;
+	};
+
+	struct LocalInput
+	{
+		const float* PosX;
+		const float* PosY;
+		const float* PosZ;
+		const float* RotX;
+		const float* RotY;
+		const float* RotZ;
+		const float* RotW;
+		const float* ScaleX;
+		const float* ScaleY;
+		const float* ScaleZ;
+	};
+
+	//Scale * rotation * translation of object i
+	void BuildLocal(const LocalInput& in, unsigned i, Mat4& out)
+	{
+		float x = in.RotX[i], y = in.RotY[i], z = in.RotZ[i], w = in.RotW[i];
+		float xx = x * x, yy = y * y, zz = z * z;
+		float xy = x * y, xz = x * z, yz = y * z;
+		float wx = w * x, wy = w * y, wz = w * z;
+		float sx = in.ScaleX[i], sy = in.ScaleY[i], sz = in.ScaleZ[i];
+
+		out.m[0][0] = sx * (1.0f - 2.0f * (yy + zz));
+		out.m[0][1] = sx * (2.0f * (xy + wz));
+		out.m[0][2] = sx * (2.0f * (xz - wy));
+		out.m[0][3] = 0.0f;
+		out.m[1][0] = sy * (2.0f * (xy - wz));
+		out.m[1][1] = sy * (1.0f - 2.0f * (xx + zz));
+		out.m[1][2] = sy * (2.0f * (yz + wx));
+		out.m[1][3] = 0.0f;
+		out.m[2][0] = sz * (2.0f * (xz + wy));
+		out.m[2][1] = sz * (2.0f * (yz - wx));
+		out.m[2][2] = sz * (1.0f - 2.0f * (xx + yy));
+		out.m[2][3] = 0.0f;
+		out.m[3][0] = in.PosX[i];
+		out.m[3][1] = in.PosY[i];
+		out.m[3][2] = in.PosZ[i];
+		out.m[3][3] = 1.0f;
+	}
+
+#ifdef SIMDMATH_SSE
+	//Same as BuildLocal for objects i .. i + 3, computed as SoA and transposed
+	//into one matrix per object
+	void BuildLocal4(const LocalInput& in, unsigned i, Mat4 out[4])
+	{
+		__m128 x = _mm_loadu_ps(in.RotX + i), y = _mm_loadu_ps(in.RotY + i);
+		__m128 z = _mm_loadu_ps(in.RotZ + i), w = _mm_loadu_ps(in.RotW + i);
+		__m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		__m128 sx = _mm_loadu_ps(in.ScaleX + i), sy = _mm_loadu_ps(in.ScaleY + i), sz = _mm_loadu_ps(in.ScaleZ + i);
+
+		__m128 r0 = _mm_mul_ps(sx, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))));
+		__m128 r1 = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_add_ps(xy, wz)));
+		__m128 r2 = _mm_mul_ps(sx, _mm_mul_ps(two, _mm_sub_ps(xz, wy)));
+		__m128 r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out[0].m[0], r0);
+		_mm_storeu_ps(out[1].m[0], r1);
+		_mm_storeu_ps(out[2].m[0], r2);
+		_mm_storeu_ps(out[3].m[0], r3);
+
+		r0 = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_sub_ps(xy, wz)));
+		r1 = _mm_mul_ps(sy, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))));
+		r2 = _mm_mul_ps(sy, _mm_mul_ps(two, _mm_add_ps(yz, wx)));
+		r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out[0].m[1], r0);
+		_mm_storeu_ps(out[1].m[1], r1);
+		_mm_storeu_ps(out[2].m[1], r2);
+		_mm_storeu_ps(out[3].m[1], r3);
+
+		r0 = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_add_ps(xz, wy)));
+		r1 = _mm_mul_ps(sz, _mm_mul_ps(two, _mm_sub_ps(yz, wx)));
+		r2 = _mm_mul_ps(sz, _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))));
+		r3 = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out[0].m[2], r0);
+		_mm_storeu_ps(out[1].m[2], r1);
+		_mm_storeu_ps(out[2].m[2], r2);
+		_mm_storeu_ps(out[3].m[2], r3);
+
+		r0 = _mm_loadu_ps(in.PosX + i);
+		r1 = _mm_loadu_ps(in.PosY + i);
+		r2 = _mm_loadu_ps(in.PosZ + i);
+		r3 = one;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out[0].m[3], r0);
+		_mm_storeu_ps(out[1].m[3], r1);
+		_mm_storeu_ps(out[2].m[3], r2);
+		_mm_storeu_ps(out[3].m[3], r3);
+	}
+#endif
+
+	//Reorders v so that v[i] = old v[order[i]]
+	template<typename T>
+	void Gather(std::vector<T>& v, const std::vector<uint32_t>& order)
+	{
+		std::vector<T> sorted(v.size());
+		for(size_t i = 0; i < order.size(); ++i)
+			sorted[i] = v[order[i]];
+		v.swap(sorted);
+	}
+}
+
+Scene::Scene() : m_OrderDirty(false), m_UpdatedCount(0)
+{
+	m_Stats.Objects = 0;
+	m_Stats.Levels = 0;
+	m_Stats.Updated = 0;
+	m_Stats.Reorders = 0;
+	m_Stats.UpdateMs = 0.0;
+}
+
+void Scene::Reserve(unsigned capacity)
+{
+	m_PosX.reserve(capacity);
+	m_PosY.reserve(capacity);
+	m_PosZ.reserve(capacity);
+	m_RotX.reserve(capacity);
+	m_RotY.reserve(capacity);
+	m_RotZ.reserve(capacity);
+	m_RotW.reserve(capacity);
+	m_ScaleX.reserve(capacity);
+	m_ScaleY.reserve(capacity);
+	m_ScaleZ.reserve(capacity);
+	m_Colors.reserve(capacity);
+	m_World.reserve(capacity);
+	m_Dirty.reserve(capacity);
+	m_Changed.reserve(capacity);
+	m_ParentSlot.reserve(capacity);
+	m_ParentDense.reserve(capacity);
+	m_ChildCount.reserve(capacity);
+	m_DenseToSlot.reserve(capacity);
+	m_SlotToDense.reserve(capacity);
+	m_SlotGeneration.reserve(capacity);
+}
+
+void Scene::Clear()
+{
+	//Keep the generations so old handles stay invalid
+	for(size_t i = 0; i < m_DenseToSlot.size(); ++i)
+	{
+		uint32_t slot = m_DenseToSlot[i];
+		++m_SlotGeneration[slot];
+		m_FreeSlots.push_back(slot);
+	}
+
+	m_PosX.clear(); m_PosY.clear(); m_PosZ.clear();
+	m_RotX.clear(); m_RotY.clear(); m_RotZ.clear(); m_RotW.clear();
+	m_ScaleX.clear(); m_ScaleY.clear(); m_ScaleZ.clear();
+	m_Colors.clear();
+	m_World.clear();
+	m_Dirty.clear();
+	m_Changed.clear();
+	m_ParentSlot.clear();
+	m_ParentDense.clear();
+	m_ChildCount.clear();
+	m_DenseToSlot.clear();
+	m_Levels.clear();
+	m_OrderDirty = false;
+	m_Stats.Objects = 0;
+	m_Stats.Levels = 0;
+}
+
+SceneHandle Scene::Create(const Vec3& position, SceneHandle parent)
+{
+	uint32_t parentDense = NO_PARENT;
+	if(IsValid(parent))
+		parentDense = m_SlotToDense[parent.Index];
+
+	uint32_t slot;
+	if(!m_FreeSlots.empty())
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t)m_SlotToDense.size();
+		m_SlotToDense.push_back(0);
+		m_SlotGeneration.push_back(1);
+	}
+
+	unsigned dense = GetCount();
+	m_SlotToDense[slot] = dense;
+	m_DenseToSlot.push_back(slot);
+
+	m_PosX.push_back(position.x);
+	m_PosY.push_back(position.y);
+	m_PosZ.push_back(position.z);
+	m_RotX.push_back(0.0f);
+	m_RotY.push_back(0.0f);
+	m_RotZ.push_back(0.0f);
+	m_RotW.push_back(1.0f);
+	m_ScaleX.push_back(1.0f);
+	m_ScaleY.push_back(1.0f);
+	m_ScaleZ.push_back(1.0f);
+	m_Colors.push_back(0xFFFFFFFF);
+	m_World.push_back(Mat4Identity());
+	m_Dirty.push_back(1);
+	m_Changed.push_back(0);
+	m_ParentSlot.push_back(parentDense == NO_PARENT ? NO_PARENT : parent.Index);
+	m_ParentDense.push_back(parentDense);
+	m_ChildCount.push_back(0);
+	if(parentDense != NO_PARENT)
+		++m_ChildCount[parentDense];
+
+	//Appending keeps the level order when the object belongs to the last level
+	//or starts a new one, which is the case when building a tree breadth first
+	if(!m_OrderDirty)
+	{
+		unsigned parentLevel = NO_PARENT;
+		for(size_t level = 0; level < m_Levels.size() && parentDense != NO_PARENT; ++level)
+		{
+			if(parentDense >= m_Levels[level].First && parentDense < m_Levels[level].End)
+				parentLevel = (unsigned)level;
+		}
+		unsigned level = parentDense == NO_PARENT ? 0 : parentLevel + 1;
+
+		if(level + 1 == m_Levels.size())
+			m_Levels.back().End = dense + 1;
+		else if(level == m_Levels.size())
+		{
+			LevelRange range = { dense, dense + 1 };
+			m_Levels.push_back(range);
+		}
+		else
+			m_OrderDirty = true;
+	}
+
+	SceneHandle handle = { slot, m_SlotGeneration[slot] };
+	return handle;
+}
+
+void Scene::Destroy(SceneHandle handle)
+{
+	if(!IsValid(handle))
+		return;
+
+	unsigned dense = m_SlotToDense[handle.Index];
+
+	if(m_ChildCount[dense] > 0)
+	{
+		for(size_t i = 0; i < m_ParentSlot.size(); ++i)
+		{
+			if(m_ParentSlot[i] == handle.Index)
+			{
+				m_ParentSlot[i] = NO_PARENT;
+				m_ParentDense[i] = NO_PARENT;
+				m_Dirty[i] = 1;
+			}
+		}
+		m_OrderDirty = true;
+	}
+	if(m_ParentSlot[dense] != NO_PARENT)
+		--m_ChildCount[m_SlotToDense[m_ParentSlot[dense]]];
+
+	//Swap remove keeps the level order only inside the last level
+	unsigned last = GetCount() - 1;
+	if(!m_OrderDirty && !m_Levels.empty() && dense >= m_Levels.back().First)
+	{
+		if(--m_Levels.back().End == m_Levels.back().First)
+			m_Levels.pop_back();
+	}
+	else
+		m_OrderDirty = true;
+
+	if(dense != last)
+		MoveDense(last, dense);
+	PopDense();
+
+	++m_SlotGeneration[handle.Index];
+	m_FreeSlots.push_back(handle.Index);
+}
+
+bool Scene::IsValid(SceneHandle handle) const
+{
+	return handle.Index < m_SlotGeneration.size() && m_SlotGeneration[handle.Index] == handle.Generation;
+}
+
+bool Scene::SetParent(SceneHandle child, SceneHandle parent)
+{
+	if(!IsValid(child))
+		return false;
+
+	uint32_t parentSlot = NO_PARENT;
+	if(IsValid(parent))
+	{
+		//Parenting to itself or a descendant would create a cycle
+		for(uint32_t slot = parent.Index; slot != NO_PARENT; slot = m_ParentSlot[m_SlotToDense[slot]])
+		{
+			if(slot == child.Index)
+				return false;
+		}
+		parentSlot = parent.Index;
+	}
+
+	unsigned dense = m_SlotToDense[child.Index];
+	if(m_ParentSlot[dense] == parentSlot)
+		return true;
+
+	if(m_ParentSlot[dense] != NO_PARENT)
+		--m_ChildCount[m_SlotToDense[m_ParentSlot[dense]]];
+	if(parentSlot != NO_PARENT)
+		++m_ChildCount[m_SlotToDense[parentSlot]];
+
+	m_ParentSlot[dense] = parentSlot;
+	m_Dirty[dense] = 1;
+	m_OrderDirty = true;
+	return true;
+}
+
+SceneHandle Scene::GetParent(SceneHandle handle) const
+{
+	if(!IsValid(handle))
+		return INVALID_SCENE_HANDLE;
+
+	uint32_t parentSlot = m_ParentSlot[m_SlotToDense[handle.Index]];
+	if(parentSlot == NO_PARENT)
+		return INVALID_SCENE_HANDLE;
+
+	SceneHandle parent = { parentSlot, m_SlotGeneration[parentSlot] };
+	return parent;
+}
+
+void Scene::SetPosition(SceneHandle handle, const Vec3& position)
+{
+	unsigned i = m_SlotToDense[handle.Index];
+	m_PosX[i] = position.x;
+	m_PosY[i] = position.y;
+	m_PosZ[i] = position.z;
+	m_Dirty[i] = 1;
+}
+
+void Scene::SetRotation(SceneHandle handle, const Vec4& rotation)
+{
+	unsigned i = m_SlotToDense[handle.Index];
+	m_RotX[i] = rotation.x;
+	m_RotY[i] = rotation.y;
+	m_RotZ[i] = rotation.z;
+	m_RotW[i] = rotation.w;
+	m_Dirty[i] = 1;
+}
+
+void Scene::SetScale(SceneHandle handle, const Vec3& scale)
+{
+	unsigned i = m_SlotToDense[handle.Index];
+	m_ScaleX[i] = scale.x;
+	m_ScaleY[i] = scale.y;
+	m_ScaleZ[i] = scale.z;
+	m_Dirty[i] = 1;
+}
+
+void Scene::SetColor(SceneHandle handle, uint32_t color)
+{
+	m_Colors[m_SlotToDense[handle.Index]] = color;
+}
+
+Vec3 Scene::GetPosition(SceneHandle handle) const
+{
+	unsigned i = m_SlotToDense[handle.Index];
+	return Vec3(m_PosX[i], m_PosY[i], m_PosZ[i]);
+}
+
+Vec4 Scene::GetRotation(SceneHandle handle) const
+{
+	unsigned i = m_SlotToDense[handle.Index];
+	return Vec4(m_RotX[i], m_RotY[i], m_RotZ[i], m_RotW[i]);
+}
+
+Vec3 Scene::GetScale(SceneHandle handle) const
+{
+	unsigned i = m_SlotToDense[handle.Index];
+	return Vec3(m_ScaleX[i], m_ScaleY[i], m_ScaleZ[i]);
+}
+
+uint32_t Scene::GetColor(SceneHandle handle) const
+{
+	return m_Colors[m_SlotToDense[handle.Index]];
+}
+
+const Mat4& Scene::GetWorld(SceneHandle handle) const
+{
+	return m_World[m_SlotToDense[handle.Index]];
+}
+
+SceneHandle Scene::GetHandle(unsigned denseIndex) const
+{
+	uint32_t slot = m_DenseToSlot[denseIndex];
+	SceneHandle handle = { slot, m_SlotGeneration[slot] };
+	return handle;
+}
+
+SceneArrays Scene::GetArrays()
+{
+	SceneArrays arrays;
+	bool empty = m_DenseToSlot.empty();
+	arrays.PosX = empty ? NULL : &m_PosX[0];
+	arrays.PosY = empty ? NULL : &m_PosY[0];
+	arrays.PosZ = empty ? NULL : &m_PosZ[0];
+	arrays.RotX = empty ? NULL : &m_RotX[0];
+	arrays.RotY = empty ? NULL : &m_RotY[0];
+	arrays.RotZ = empty ? NULL : &m_RotZ[0];
+	arrays.RotW = empty ? NULL : &m_RotW[0];
+	arrays.ScaleX = empty ? NULL : &m_ScaleX[0];
+	arrays.ScaleY = empty ? NULL : &m_ScaleY[0];
+	arrays.ScaleZ = empty ? NULL : &m_ScaleZ[0];
+	arrays.Colors = empty ? NULL : &m_Colors[0];
+	arrays.Dirty = empty ? NULL : &m_Dirty[0];
+	return arrays;
+}
+
+void Scene::UpdateTransforms(JobSystem* pJobs)
+{
+	int64_t start = TimerTicks();
+
+	if(m_OrderDirty)
+		Reorder();
+
+	m_UpdatedCount.store(0, std::memory_order_relaxed);
+
+	//Levels run one after another so parents are final before their children
+	for(size_t level = 0; level < m_Levels.size(); ++level)
+	{
+		const LevelRange& range = m_Levels[level];
+		unsigned count = range.End - range.First;
+		if(pJobs && pJobs->IsRunning() && count > UPDATE_GRAIN)
+		{
+			UpdateData data = { this, range.First };
+			pJobs->ParallelFor(count, UPDATE_GRAIN, UpdateRangeJob, &data);
+		}
+		else
+			UpdateRange(range.First, range.End);
+	}
+
+	m_Stats.Objects = GetCount();
+	m_Stats.Levels = (unsigned)m_Levels.size();
+	m_Stats.Updated = m_UpdatedCount.load(std::memory_order_relaxed);
+	m_Stats.UpdateMs = TicksToMs(TimerTicks() - start);
+}
+
+void Scene::UpdateRangeJob(void* pData, unsigned begin, unsigned end)
+{
+	UpdateData* pUpdate = (UpdateData*)pData;
+	pUpdate->pScene->UpdateRange(pUpdate->First + begin, pUpdate->First + end);
+}
+
+void Scene::UpdateRange(unsigned begin, unsigned end)
+{
+	LocalInput in = { &m_PosX[0], &m_PosY[0], &m_PosZ[0], &m_RotX[0], &m_RotY[0], &m_RotZ[0], &m_RotW[0],
+		&m_ScaleX[0], &m_ScaleY[0], &m_ScaleZ[0] };
+	uint8_t* pDirty = &m_Dirty[0];
+	uint8_t* pChanged = &m_Changed[0];
+	const uint32_t* pParent = &m_ParentDense[0];
+	Mat4* pWorld = &m_World[0];
+	unsigned updated = 0;
+
+	unsigned i = begin;
+#ifdef SIMDMATH_SSE
+	for(; i + 4 <= end; i += 4)
+	{
+		//Objects are rebuilt when they or their parent changed
+		uint8_t update[4];
+		bool any = false;
+		for(unsigned lane = 0; lane < 4; ++lane)
+		{
+			uint32_t parent = pParent[i + lane];
+			update[lane] = pDirty[i + lane] | (parent != NO_PARENT ? pChanged[parent] : 0);
+			any = any || update[lane];
+		}
+		if(!any)
+		{
+			memset(pChanged + i, 0, 4);
+			continue;
+		}
+
+		Mat4 local[4];
+		BuildLocal4(in, i, local);
+		for(unsigned lane = 0; lane < 4; ++lane)
+		{
+			unsigned index = i + lane;
+			pChanged[index] = update[lane];
+			if(!update[lane])
+				continue;
+
+			uint32_t parent = pParent[index];
+			pWorld[index] = parent == NO_PARENT ? local[lane] : Mat4Multiply(local[lane], pWorld[parent]);
+			pDirty[index] = 0;
+			++updated;
+		}
+	}
+#endif
+	for(; i < end; ++i)
+	{
+		uint32_t parent = pParent[i];
+		uint8_t update = pDirty[i] | (parent != NO_PARENT ? pChanged[parent] : 0);
+		pChanged[i] = update;
+		if(!update)
+			continue;
+
+		Mat4 local;
+		BuildLocal(in, i, local);
+		pWorld[i] = parent == NO_PARENT ? local : Mat4Multiply(local, pWorld[parent]);
+		pDirty[i] = 0;
+		++updated;
+	}
+
+	m_UpdatedCount.fetch_add(updated, std::memory_order_relaxed);
+}
+
+void Scene::MoveDense(unsigned from, unsigned to)
+{
+	m_PosX[to] = m_PosX[from];
+	m_PosY[to] = m_PosY[from];
+	m_PosZ[to] = m_PosZ[from];
+	m_RotX[to] = m_RotX[from];
+	m_RotY[to] = m_RotY[from];
+	m_RotZ[to] = m_RotZ[from];
+	m_RotW[to] = m_RotW[from];
+	m_ScaleX[to] = m_ScaleX[from];
+	m_ScaleY[to] = m_ScaleY[from];
+	m_ScaleZ[to] = m_ScaleZ[from];
+	m_Colors[to] = m_Colors[from];
+	m_World[to] = m_World[from];
+	m_Dirty[to] = m_Dirty[from];
+	m_Changed[to] = m_Changed[from];
+	m_ParentSlot[to] = m_ParentSlot[from];
+	m_ParentDense[to] = m_ParentDense[from];
+	m_ChildCount[to] = m_ChildCount[from];
+	m_DenseToSlot[to] = m_DenseToSlot[from];
+	m_SlotToDense[m_DenseToSlot[to]] = to;
+}
+
+void Scene::PopDense()
+{
+	m_PosX.pop_back(); m_PosY.pop_back(); m_PosZ.pop_back();
+	m_RotX.pop_back(); m_RotY.pop_back(); m_RotZ.pop_back(); m_RotW.pop_back();
+	m_ScaleX.pop_back(); m_ScaleY.pop_back(); m_ScaleZ.pop_back();
+	m_Colors.pop_back();
+	m_World.pop_back();
+	m_Dirty.pop_back();
+	m_Changed.pop_back();
+	m_ParentSlot.pop_back();
+	m_ParentDense.pop_back();
+	m_ChildCount.pop_back();
+	m_DenseToSlot.pop_back();
+}
+
+void Scene::Reorder()
+{
+	unsigned count = GetCount();
+	const uint32_t UNKNOWN = 0xFFFFFFFF;
+
+	//Depth of every object, each chain is walked once to the first known ancestor
+	m_Depth.assign(count, UNKNOWN);
+	unsigned levels = 0;
+	for(unsigned i = 0; i < count; ++i)
+	{
+		unsigned steps = 0;
+		unsigned top = i;
+		while(m_Depth[top] == UNKNOWN && m_ParentSlot[top] != NO_PARENT)
+		{
+			top = m_SlotToDense[m_ParentSlot[top]];
+			++steps;
+		}
+		unsigned depth = (m_Depth[top] == UNKNOWN ? 0 : m_Depth[top]) + steps;
+		m_Depth[top] = depth - steps;
+
+		for(unsigned node = i; m_Depth[node] == UNKNOWN; node = m_SlotToDense[m_ParentSlot[node]])
+			m_Depth[node] = depth--;
+		if(m_Depth[i] + 1 > levels)
+			levels = m_Depth[i] + 1;
+	}
+
+	//Stable counting sort by depth, so objects keep their relative order
+	m_Levels.resize(levels);
+	for(unsigned level = 0; level < levels; ++level)
+		m_Levels[level].First = m_Levels[level].End = 0;
+	for(unsigned i = 0; i < count; ++i)
+		++m_Levels[m_Depth[i]].End;
+	unsigned offset = 0;
+	for(unsigned level = 0; level < levels; ++level)
+	{
+		m_Levels[level].First = offset;
+		offset += m_Levels[level].End;
+		m_Levels[level].End = m_Levels[level].First;
+	}
+	m_Order.resize(count);
+	for(unsigned i = 0; i < count; ++i)
+		m_Order[m_Levels[m_Depth[i]].End++] = i;
+
+	Gather(m_PosX, m_Order); Gather(m_PosY, m_Order); Gather(m_PosZ, m_Order);
+	Gather(m_RotX, m_Order); Gather(m_RotY, m_Order); Gather(m_RotZ, m_Order); Gather(m_RotW, m_Order);
+	Gather(m_ScaleX, m_Order); Gather(m_ScaleY, m_Order); Gather(m_ScaleZ, m_Order);
+	Gather(m_Colors, m_Order);
+	Gather(m_World, m_Order);
+	Gather(m_Dirty, m_Order);
+	Gather(m_Changed, m_Order);
+	Gather(m_ParentSlot, m_Order);
+	Gather(m_ChildCount, m_Order);
+	Gather(m_DenseToSlot, m_Order);
+
+	for(unsigned i = 0; i < count; ++i)
+		m_SlotToDense[m_DenseToSlot[i]] = i;
+	for(unsigned i = 0; i < count; ++i)
+		m_ParentDense[i] = m_ParentSlot[i] == NO_PARENT ? NO_PARENT : m_SlotToDense[m_ParentSlot[i]];
+
+	m_OrderDirty = false;
+	++m_Stats.Reorders;
+}
@@ -0,0 +1,153 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Scene transforms stored as structure of arrays. Objects live in
+				dense packed arrays addressed through generational handles, sorted
+				so parents come before their children (one level of the hierarchy
+				after another). UpdateTransforms() rebuilds world matrices of dirty
+				objects and their descendants, four objects per SIMD batch, with
+				every level split across the job system.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "SimdMath.h"
+
+#include <vector>
+#include <atomic>
+
+class JobSystem;
+
+//Index of a slot plus the generation it had when the handle was made, so
+//handles of destroyed objects are detected even after the slot is reused
+struct SceneHandle
+{
+	uint32_t Index;
+	uint32_t Generation;
+
+	bool operator==(const SceneHandle& h) const { return Index == h.Index && Generation == h.Generation; }
+	bool operator!=(const SceneHandle& h) const { return !(*this == h); }
+};
+
+const SceneHandle INVALID_SCENE_HANDLE = { 0xFFFFFFFF, 0 };
+
+//Direct access to the packed arrays (dense index order) for systems that
+//touch many objects. Set Dirty[i] after writing. Pointers and dense indices
+//are invalidated by Create, Destroy, SetParent and UpdateTransforms.
+struct SceneArrays
+{
+	float*		PosX;
+	float*		PosY;
+	float*		PosZ;
+	float*		RotX;			//Rotation quaternion
+	float*		RotY;
+	float*		RotZ;
+	float*		RotW;
+	float*		ScaleX;
+	float*		ScaleY;
+	float*		ScaleZ;
+	uint32_t*	Colors;
+	uint8_t*	Dirty;
+};
+
+struct SceneStats
+{
+	unsigned	Objects;			//Live objects
+	unsigned	Levels;				//Hierarchy depth
+	unsigned	Updated;			//World matrices rebuilt by the last update
+	unsigned	Reorders;			//Times the dense arrays were re-sorted by depth
+	double		UpdateMs;			//Time of the last UpdateTransforms()
+};
+
+class Scene
+{
+public:
+	Scene();
+
+	//Reserves room for capacity objects so creating them does not reallocate
+	void Reserve(unsigned capacity);
+	void Clear();
+
+	SceneHandle Create(const Vec3& position, SceneHandle parent = INVALID_SCENE_HANDLE);
+	//Children of a destroyed object become roots
+	void Destroy(SceneHandle handle);
+	bool IsValid(SceneHandle handle) const;
+
+	//Returns false if it would create a cycle. INVALID_SCENE_HANDLE makes child a root.
+	bool SetParent(SceneHandle child, SceneHandle parent);
+	SceneHandle GetParent(SceneHandle handle) const;
+
+	void SetPosition(SceneHandle handle, const Vec3& position);
+	void SetRotation(SceneHandle handle, const Vec4& rotation);
+	void SetScale(SceneHandle handle, const Vec3& scale);
+	void SetColor(SceneHandle handle, uint32_t color);
+
+	Vec3 GetPosition(SceneHandle handle) const;
+	Vec4 GetRotation(SceneHandle handle) const;
+	Vec3 GetScale(SceneHandle handle) const;
+	uint32_t GetColor(SceneHandle handle) const;
+	//World matrix as of the last UpdateTransforms()
+	const Mat4& GetWorld(SceneHandle handle) const;
+
+	//Recomputes world matrices of dirty objects and their descendants. With
+	//pJobs every hierarchy level is processed in parallel chunks.
+	void UpdateTransforms(JobSystem* pJobs = NULL);
+
+	//Packed arrays, index 0 .. GetCount() - 1
+	unsigned GetCount() const { return (unsigned)m_DenseToSlot.size(); }
+	unsigned GetDenseIndex(SceneHandle handle) const { return m_SlotToDense[handle.Index]; }
+	SceneHandle GetHandle(unsigned denseIndex) const;
+	SceneArrays GetArrays();
+	const Mat4* GetWorldMatrices() const { return m_World.empty() ? NULL : &m_World[0]; }
+	const uint32_t* GetColors() const { return m_Colors.empty() ? NULL : &m_Colors[0]; }
+	//1 for objects whose world matrix changed in the last update
+	const uint8_t* GetChanged() const { return m_Changed.empty() ? NULL : &m_Changed[0]; }
+
+	const SceneStats& GetStats() const { return m_Stats; }
+
+private:
+	enum { NO_PARENT = 0xFFFFFFFF };
+
+	struct LevelRange
+	{
+		unsigned First;
+		unsigned End;
+	};
+
+	//Destroy moves the last element over the removed one, then pops the last
+	void MoveDense(unsigned from, unsigned to);
+	void PopDense();
+	//Sorts the dense arrays by hierarchy depth and rebuilds the parent indices
+	void Reorder();
+	void UpdateRange(unsigned begin, unsigned end);
+
+	static void UpdateRangeJob(void* pData, unsigned begin, unsigned end);
+
+	//Packed per object data
+	std::vector<float>		m_PosX, m_PosY, m_PosZ;
+	std::vector<float>		m_RotX, m_RotY, m_RotZ, m_RotW;
+	std::vector<float>		m_ScaleX, m_ScaleY, m_ScaleZ;
+	std::vector<uint32_t>	m_Colors;
+	std::vector<Mat4>		m_World;
+	std::vector<uint8_t>	m_Dirty;		//Local transform changed
+	std::vector<uint8_t>	m_Changed;		//World matrix changed in the last update
+	std::vector<uint32_t>	m_ParentSlot;	//Slot of the parent or NO_PARENT
+	std::vector<uint32_t>	m_ParentDense;	//Dense index of the parent, valid after Reorder
+	std::vector<uint32_t>	m_ChildCount;
+	std::vector<uint32_t>	m_DenseToSlot;
+
+	//Slots (handle indices)
+	std::vector<uint32_t>	m_SlotToDense;
+	std::vector<uint32_t>	m_SlotGeneration;
+	std::vector<uint32_t>	m_FreeSlots;
+
+	//Dense ranges of each hierarchy level, valid unless m_OrderDirty
+	std::vector<LevelRange>	m_Levels;
+	bool					m_OrderDirty;
+
+	//Reorder scratch
+	std::vector<uint32_t>	m_Depth;
+	std::vector<uint32_t>	m_Order;
+
+	std::atomic<unsigned>	m_UpdatedCount;
+	SceneStats				m_Stats;
+};
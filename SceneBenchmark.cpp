@@ -0,0 +1,143 @@
+#include "SceneBenchmark.h"
+#include "Scene.h"
+#include "JobSystem.h"
+#include "Timer.h"
+
+#include <vector>
+#include <algorithm>
+
+namespace
+{
+	const unsigned OBJECT_COUNT = 1000000;
+	//Hierarchy: roots with CHILDREN children, each with GRANDCHILDREN children
+	const unsigned ROOTS = 10000;
+	const unsigned CHILDREN = 10;
+	const unsigned GRANDCHILDREN = 9;
+	const int FRAMES = 10;
+
+	//Turns every root a little around the y axis
+	void AnimateRoots(Scene& scene, unsigned roots, float angle)
+	{
+		SceneArrays arrays = scene.GetArrays();
+		Vec4 q = QuatRotationAxis(Vec3(0.0f, 1.0f, 0.0f), angle);
+		for(unsigned i = 0; i < roots; ++i)
+		{
+			arrays.RotX[i] = q.x;
+			arrays.RotY[i] = q.y;
+			arrays.RotZ[i] = q.z;
+			arrays.RotW[i] = q.w;
+			arrays.Dirty[i] = 1;
+		}
+	}
+
+	//Best of FRAMES animated updates, in milliseconds
+	double TimeUpdates(Scene& scene, unsigned animated, JobSystem* pJobs)
+	{
+		double best = 1e30;
+		for(int frame = 0; frame < FRAMES; ++frame)
+		{
+			AnimateRoots(scene, animated, 0.01f * (frame + 1));
+			scene.UpdateTransforms(pJobs);
+			best = std::min(best, scene.GetStats().UpdateMs);
+		}
+		return best;
+	}
+
+	//World matrix built from the handles with the plain SimdMath functions
+	Mat4 ReferenceWorld(const Scene& scene, SceneHandle handle)
+	{
+		Vec3 p = scene.GetPosition(handle), s = scene.GetScale(handle);
+		Mat4 local = Mat4Multiply(Mat4Multiply(Mat4Scaling(s.x, s.y, s.z), Mat4RotationQuat(scene.GetRotation(handle))),
+			Mat4Translation(p.x, p.y, p.z));
+		SceneHandle parent = scene.GetParent(handle);
+		return parent == INVALID_SCENE_HANDLE ? local : Mat4Multiply(local, ReferenceWorld(scene, parent));
+	}
+
+	float MaxError(const Scene& scene)
+	{
+		float maxError = 0.0f;
+		for(unsigned i = 0; i < scene.GetCount(); i += 997)
+		{
+			SceneHandle handle = scene.GetHandle(i);
+			Mat4 expected = ReferenceWorld(scene, handle);
+			const Mat4& world = scene.GetWorld(handle);
+			for(int e = 0; e < 16; ++e)
+				maxError = std::max(maxError, fabsf(((const float*)world)[e] - ((const float*)expected)[e]));
+		}
+		return maxError;
+	}
+}
+
+bool RunSceneBenchmarks(FILE* pOut)
+{
+	JobSystem jobs;
+	jobs.Init();
+	fprintf(pOut, "Scene transforms (%u threads)\n", jobs.GetThreadCount());
+
+	uint32_t seed = 777;
+	bool ok = true;
+
+	//Flat scene, every object animated every frame
+	{
+		Scene scene;
+		scene.Reserve(OBJECT_COUNT);
+		for(unsigned i = 0; i < OBJECT_COUNT; ++i)
+		{
+			SceneHandle h = scene.Create(Vec3(RandomFloat(seed) * 1000.0f, RandomFloat(seed) * 1000.0f, RandomFloat(seed) * 1000.0f));
+			scene.SetScale(h, Vec3(1.0f + RandomFloat(seed), 1.0f, 1.0f));
+		}
+		scene.UpdateTransforms();
+
+		double singleMs = TimeUpdates(scene, OBJECT_COUNT, NULL);
+		double jobsMs = TimeUpdates(scene, OBJECT_COUNT, &jobs);
+		float error = MaxError(scene);
+		ok = ok && error < 1e-3f && scene.GetStats().Updated == OBJECT_COUNT;
+		fprintf(pOut, "%u animated roots: 1 thread %.3f ms, %u threads %.3f ms (%.0f Mobj/s), max error %g\n",
+			OBJECT_COUNT, singleMs, jobs.GetThreadCount(), jobsMs, OBJECT_COUNT / (jobsMs * 1000.0), error);
+	}
+
+	//Three level hierarchy, roots animated so every descendant is rebuilt
+	{
+		Scene scene;
+		scene.Reserve(ROOTS * (1 + CHILDREN + CHILDREN * GRANDCHILDREN));
+		std::vector<SceneHandle> roots, children;
+		for(unsigned i = 0; i < ROOTS; ++i)
+			roots.push_back(scene.Create(Vec3(RandomFloat(seed) * 1000.0f, 0.0f, RandomFloat(seed) * 1000.0f)));
+		for(unsigned i = 0; i < ROOTS * CHILDREN; ++i)
+		{
+			SceneHandle h = scene.Create(Vec3(RandomFloat(seed) * 10.0f, 1.0f, 0.0f), roots[i / CHILDREN]);
+			scene.SetRotation(h, QuatRotationAxis(Vec3(1.0f, 0.0f, 0.0f), RandomFloat(seed)));
+			children.push_back(h);
+		}
+		for(unsigned i = 0; i < ROOTS * CHILDREN * GRANDCHILDREN; ++i)
+			scene.Create(Vec3(0.0f, RandomFloat(seed), 1.0f), children[i / GRANDCHILDREN]);
+		scene.UpdateTransforms();
+
+		unsigned count = scene.GetCount();
+		double singleMs = TimeUpdates(scene, ROOTS, NULL);
+		double jobsMs = TimeUpdates(scene, ROOTS, &jobs);
+		float error = MaxError(scene);
+		ok = ok && error < 1e-3f && scene.GetStats().Updated == count;
+		fprintf(pOut, "%u objects in %u levels, roots animated: 1 thread %.3f ms, %u threads %.3f ms (%.0f Mobj/s), max error %g\n",
+			count, scene.GetStats().Levels, singleMs, jobs.GetThreadCount(), jobsMs, count / (jobsMs * 1000.0), error);
+
+		//Nothing dirty, only the change checks run
+		scene.UpdateTransforms(&jobs);
+		scene.UpdateTransforms(&jobs);
+		fprintf(pOut, "Static frame: %.3f ms, %u updated\n", scene.GetStats().UpdateMs, scene.GetStats().Updated);
+		ok = ok && scene.GetStats().Updated == 0;
+
+		//Removing children reorders once, stale handles are rejected
+		for(unsigned i = 0; i < children.size(); i += 100)
+			scene.Destroy(children[i]);
+		scene.UpdateTransforms(&jobs);
+		bool handlesOk = !scene.IsValid(children[0]) && scene.IsValid(children[1]) && MaxError(scene) < 1e-3f;
+		ok = ok && handlesOk;
+		fprintf(pOut, "Destroyed %u children: update %.3f ms, %u reorders, %u objects, %s\n",
+			(unsigned)(children.size() + 99) / 100, scene.GetStats().UpdateMs, scene.GetStats().Reorders,
+			scene.GetStats().Objects, handlesOk ? "handles ok" : "HANDLES WRONG");
+	}
+
+	jobs.Shutdown();
+	return ok;
+}
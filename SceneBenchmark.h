@@ -0,0 +1,13 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Scene benchmark: world matrix updates of 1M animated roots and of
+				a 1M object hierarchy with animated roots, single threaded and on
+				all cores, checked against the SimdMath reference.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a world matrix is wrong
+bool RunSceneBenchmarks(FILE* pOut);
@@ -0,0 +1,360 @@
+#include "ShaderBenchmark.h"
+#include "ShaderCache.h"
+#include "NullRenderDevice.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const char* CACHE_PATH = "shader_benchmark.cache";
+	const unsigned FEATURE_COUNT = 6;
+	const unsigned PIPELINE_COUNT = 1 << FEATURE_COUNT;
+	const unsigned SHADER_COUNT = PIPELINE_COUNT * 2;
+	//Passes of the stand-in compiler over the source, a few ms per shader like D3DXCompileShader
+	const unsigned COMPILE_ROUNDS = 1500;
+
+	const char* FEATURES[FEATURE_COUNT] = { "SKINNING", "FOG", "NORMAL_MAP", "SHADOWS", "VERTEX_COLOR", "ALPHA_TEST" };
+
+	const char* VERTEX_SOURCE =
+		"float4x4 g_WorldViewProj : register(c0);\n"
+		"float4x3 g_Bones[24] : register(c8);\n"
+		"struct VS_INPUT { float3 Position : POSITION; float3 Normal : NORMAL; float4 Color : COLOR0;\n"
+		"	float2 Uv : TEXCOORD0; float4 Weights : BLENDWEIGHT; float4 Indices : BLENDINDICES; };\n"
+		"struct VS_OUTPUT { float4 Position : POSITION; float4 Color : COLOR0; float2 Uv : TEXCOORD0; float Fog : FOG; };\n"
+		"VS_OUTPUT main(VS_INPUT input)\n"
+		"{\n"
+		"	VS_OUTPUT output;\n"
+		"	float3 position = input.Position;\n"
+		"#if SKINNING\n"
+		"	position = mul(float4(position, 1.0f), g_Bones[input.Indices.x]) * input.Weights.x +\n"
+		"		mul(float4(position, 1.0f), g_Bones[input.Indices.y]) * input.Weights.y;\n"
+		"#endif\n"
+		"	output.Position = mul(float4(position, 1.0f), g_WorldViewProj);\n"
+		"#if VERTEX_COLOR\n"
+		"	output.Color = input.Color;\n"
+		"#else\n"
+		"	output.Color = float4(1.0f, 1.0f, 1.0f, 1.0f);\n"
+		"#endif\n"
+		"	output.Uv = input.Uv;\n"
+		"#if FOG\n"
+		"	output.Fog = saturate(output.Position.z * 0.01f);\n"
+		"#else\n"
+		"	output.Fog = 0.0f;\n"
+		"#endif\n"
+		"	return output;\n"
+		"}\n";
+
+	const char* PIXEL_SOURCE =
+		"sampler2D g_Diffuse : register(s0);\n"
+		"sampler2D g_Normals : register(s1);\n"
+		"sampler2D g_Shadow : register(s2);\n"
+		"float4 g_LightDirection : register(c0);\n"
+		"float4 main(float4 color : COLOR0, float2 uv : TEXCOORD0) : COLOR0\n"
+		"{\n"
+		"	float4 result = tex2D(g_Diffuse, uv) * color;\n"
+		"#if NORMAL_MAP\n"
+		"	float3 normal = tex2D(g_Normals, uv).xyz * 2.0f - 1.0f;\n"
+		"	result.rgb *= saturate(dot(normal, g_LightDirection.xyz));\n"
+		"#endif\n"
+		"#if SHADOWS\n"
+		"	result.rgb *= tex2D(g_Shadow, uv).r;\n"
+		"#endif\n"
+		"#if ALPHA_TEST\n"
+		"	clip(result.a - 0.5f);\n"
+		"#endif\n"
+		"	return result;\n"
+		"}\n";
+
+	const RDVertexElement SKINNED_ELEMENTS[] =
+	{
+		{ 0, 0, RD_DECLTYPE_FLOAT3, 0, RD_DECLUSAGE_POSITION, 0 },
+		{ 0, 12, RD_DECLTYPE_D3DCOLOR, 0, RD_DECLUSAGE_COLOR, 0 },
+		{ 0, 16, RD_DECLTYPE_FLOAT2, 0, RD_DECLUSAGE_TEXCOORD, 0 },
+		RD_DECL_END()
+	};
+
+	//Stands in for D3DXCompileShader: passes over the source for its cost, and
+	//bytecode made of a version token, tokens hashed from the source and an end token
+	struct StandInCompiler
+	{
+		unsigned				Rounds;
+		std::atomic<unsigned>	Calls;
+	};
+
+	bool StandInCompile(void* pContext, const ShaderSource& source, std::vector<uint8_t>* pBytecode, std::string* pErrors)
+	{
+		StandInCompiler* pCompiler = (StandInCompiler*)pContext;
+		pCompiler->Calls.fetch_add(1, std::memory_order_relaxed);
+		if(strstr(source.pCode, "#error"))
+		{
+			pErrors->append(source.pName);
+			pErrors->append(": error X1000: #error directive\n");
+			return false;
+		}
+
+		bool pixel = source.pProfile[0] == 'p';
+		uint64_t hash = ShaderKey(pixel ? RD_SHADER_PIXEL : RD_SHADER_VERTEX, source, 0);
+		size_t length = strlen(source.pCode);
+		for(unsigned round = 0; round < pCompiler->Rounds; ++round)
+			hash = ShaderHash(source.pCode, length, hash);
+
+		std::vector<uint32_t> tokens;
+		tokens.push_back(pixel ? 0xFFFF0200 : 0xFFFE0200);
+		for(size_t i = 0; i < length / 16; ++i)
+		{
+			hash = ShaderHash(&i, sizeof(i), hash);
+			tokens.push_back((uint32_t)hash & 0x7FFFFFFF);
+		}
+		tokens.push_back(0x0000FFFF);
+		const uint8_t* pTokens = (const uint8_t*)&tokens[0];
+		pBytecode->assign(pTokens, pTokens + tokens.size() * sizeof(uint32_t));
+		return true;
+	}
+
+	//Defines of one feature permutation, every feature 0 or 1
+	struct Permutation
+	{
+		ShaderDefine	Defines[FEATURE_COUNT + 1];
+
+		explicit Permutation(unsigned mask)
+		{
+			for(unsigned i = 0; i < FEATURE_COUNT; ++i)
+			{
+				Defines[i].pName = FEATURES[i];
+				Defines[i].pDefinition = (mask >> i) & 1 ? "1" : "0";
+			}
+			Defines[FEATURE_COUNT].pName = NULL;
+			Defines[FEATURE_COUNT].pDefinition = NULL;
+		}
+	};
+
+	ShaderPipelineDesc MakePipeline(const Permutation& permutation, unsigned mask)
+	{
+		static const RDWORD OPAQUE_STATES[] = { RD_RS_LIGHTING, 0, RD_RS_CULLMODE, RD_CULL_CCW };
+		static const RDWORD ALPHA_TEST_STATES[] = { RD_RS_LIGHTING, 0, RD_RS_CULLMODE, RD_CULL_NONE };
+
+		ShaderSource vertexShader = { "mesh.vs", VERTEX_SOURCE, permutation.Defines, "main", "vs_2_0" };
+		ShaderSource pixelShader = { "mesh.ps", PIXEL_SOURCE, permutation.Defines, "main", "ps_2_0" };
+		bool alphaTest = (mask & 32) != 0;
+		ShaderPipelineDesc desc;
+		desc.VertexShader = vertexShader;
+		desc.PixelShader = pixelShader;
+		//Skinned permutations use a declaration, the others an FVF
+		desc.pElements = (mask & 1) ? SKINNED_ELEMENTS : NULL;
+		desc.FVF = RD_FVF_XYZ | RD_FVF_DIFFUSE;
+		desc.pRenderStates = alphaTest ? ALPHA_TEST_STATES : OPAQUE_STATES;
+		desc.RenderStateCount = 2;
+		return desc;
+	}
+
+	//Requests every permutation, returns the milliseconds until all were ready
+	double RequestAll(ShaderCache& cache, std::vector<int>& pipelines, double* pRequestMs)
+	{
+		int64_t start = TimerTicks();
+		pipelines.resize(PIPELINE_COUNT);
+		for(unsigned mask = 0; mask < PIPELINE_COUNT; ++mask)
+		{
+			Permutation permutation(mask);
+			pipelines[mask] = cache.RequestPipeline(MakePipeline(permutation, mask));
+		}
+		if(pRequestMs)
+			*pRequestMs = TicksToMs(TimerTicks() - start);
+		cache.WaitAll();
+		return TicksToMs(TimerTicks() - start);
+	}
+
+	bool AllReady(ShaderCache& cache, const std::vector<int>& pipelines)
+	{
+		for(size_t i = 0; i < pipelines.size(); ++i)
+		{
+			if(pipelines[i] < 0 || cache.GetPipelineState(pipelines[i]) != SHADER_READY)
+				return false;
+		}
+		return true;
+	}
+
+	//Damages the bytecode of the first shader in the file
+	bool DamageEntry()
+	{
+		uint64_t offset = 0;
+		{
+			AssetArchive file;
+			if(!file.Open(CACHE_PATH))
+				return false;
+			for(unsigned i = 0; i < file.GetEntryCount() && offset == 0; ++i)
+			{
+				if(file.GetEntry(i).Type == ASSET_SHADER)
+					offset = file.GetEntry(i).Offset + sizeof(ShaderAssetHeader) + 8;
+			}
+		}
+		FILE* f = fopen(CACHE_PATH, "r+b");
+		if(!f || offset == 0)
+		{
+			if(f)
+				fclose(f);
+			return false;
+		}
+		unsigned char byte = 0;
+		bool ok = fseek(f, (long)offset, SEEK_SET) == 0 && fread(&byte, 1, 1, f) == 1;
+		byte ^= 0x5A;
+		ok = ok && fseek(f, (long)offset, SEEK_SET) == 0 && fwrite(&byte, 1, 1, f) == 1;
+		return fclose(f) == 0 && ok;
+	}
+
+	unsigned FileEntries()
+	{
+		AssetArchive file;
+		return file.Open(CACHE_PATH) ? file.GetEntryCount() : 0;
+	}
+
+	void PrintRun(FILE* pOut, const char* pName, double ms, const ShaderCacheStats& stats, unsigned compiles)
+	{
+		fprintf(pOut, "%-22s %8.2f ms until ready, %3u hits, %3u compiled (%3u compiler calls, %8.2f ms), %2u/%2u pipeline hits\n",
+			pName, ms, stats.Hits, stats.Compiled, compiles, stats.CompileMs, stats.PipelineHits, stats.Pipelines);
+	}
+}
+
+bool RunShaderBenchmarks(FILE* pOut)
+{
+	bool ok = true;
+	StandInCompiler compiler;
+	compiler.Rounds = COMPILE_ROUNDS;
+	compiler.Calls.store(0);
+	NullRenderDevice device(640, 360);
+	std::vector<int> pipelines;
+	double coldMs = 0.0;
+
+	fprintf(pOut, "Shader cache (%u pipelines, %u shader permutations)\n", PIPELINE_COUNT, SHADER_COUNT);
+
+	//Keys: everything that changes the bytecode changes the key
+	{
+		Permutation a(5), b(6);
+		ShaderSource source = { "mesh.vs", VERTEX_SOURCE, a.Defines, "main", "vs_2_0" };
+		ShaderSource other = source;
+		other.pDefines = b.Defines;
+		ShaderSource renamed = source;
+		renamed.pName = "renamed.vs";
+		ShaderSource profile = source;
+		profile.pProfile = "vs_3_0";
+		uint64_t key = ShaderKey(RD_SHADER_VERTEX, source, 1);
+		bool keys = key == ShaderKey(RD_SHADER_VERTEX, renamed, 1) && key != ShaderKey(RD_SHADER_VERTEX, other, 1) &&
+			key != ShaderKey(RD_SHADER_VERTEX, profile, 1) && key != ShaderKey(RD_SHADER_PIXEL, source, 1) &&
+			key != ShaderKey(RD_SHADER_VERTEX, source, 2);
+		fprintf(pOut, "Keys %s\n", keys ? "follow source, defines, profile, type and compiler version" : "WRONG");
+		ok = ok && keys;
+	}
+
+	remove(CACHE_PATH);
+	ShaderCache cache;
+
+	//Cold: every shader is compiled on the compile threads
+	{
+		unsigned calls = compiler.Calls.load();
+		cache.Init(&device, CACHE_PATH, StandInCompile, &compiler, 1);
+		double requestMs = 0.0;
+		coldMs = RequestAll(cache, pipelines, &requestMs);
+		ShaderCacheStats stats = cache.GetStats();
+		PrintRun(pOut, "Cold", coldMs, stats, compiler.Calls.load() - calls);
+		fprintf(pOut, "%22s %8.2f ms on the requesting thread\n", "", requestMs);
+		bool saved = cache.Save();
+		bool valid = saved && AllReady(cache, pipelines) && stats.Compiled == SHADER_COUNT && stats.Hits == 0 && !stats.IsWarm();
+		if(!valid)
+			fprintf(pOut, "Cold run INVALID\n");
+		ok = ok && valid;
+		cache.Shutdown();
+	}
+
+	//Warm: everything comes from the mapped file, ready as soon as it is requested
+	{
+		unsigned calls = compiler.Calls.load();
+		device.ResetCounters();
+		cache.Init(&device, CACHE_PATH, StandInCompile, &compiler, 1);
+		double ms = RequestAll(cache, pipelines, NULL);
+		ShaderCacheStats stats = cache.GetStats();
+		PrintRun(pOut, "Warm", ms, stats, compiler.Calls.load() - calls);
+		fprintf(pOut, "%22s %8.2f ms opening the file, %8.2f ms creating shaders, %.0fx faster than cold\n", "",
+			stats.OpenMs, stats.LoadMs, ms > 0.0 ? coldMs / ms : 0.0);
+
+		bool applied = true;
+		for(size_t i = 0; i < pipelines.size(); ++i)
+			applied = cache.ApplyPipeline(pipelines[i]) && applied;
+		bool valid = applied && AllReady(cache, pipelines) && stats.IsWarm() && stats.Hits == SHADER_COUNT &&
+			stats.PipelineHits == PIPELINE_COUNT && compiler.Calls.load() == calls &&
+			device.GetCounters().CreateShader == SHADER_COUNT && device.GetCounters().SetShader == PIPELINE_COUNT * 2;
+		if(!valid)
+			fprintf(pOut, "Warm run INVALID\n");
+		ok = ok && valid;
+		cache.Shutdown();
+	}
+
+	//Prewarmed: the file's pipelines are created before anything asks for them
+	{
+		device.ResetCounters();
+		cache.Init(&device, CACHE_PATH, StandInCompile, &compiler, 1);
+		int64_t start = TimerTicks();
+		unsigned prewarmed = cache.Prewarm();
+		double prewarmMs = TicksToMs(TimerTicks() - start);
+		unsigned created = device.GetCounters().CreateShader;
+		double ms = RequestAll(cache, pipelines, NULL);
+		fprintf(pOut, "%-22s %8.2f ms for %u pipelines, then %.3f ms until ready\n", "Prewarmed", prewarmMs, prewarmed, ms);
+		bool valid = prewarmed == PIPELINE_COUNT && created == SHADER_COUNT && device.GetCounters().CreateShader == created &&
+			AllReady(cache, pipelines) && cache.GetStats().Pipelines == PIPELINE_COUNT;
+		if(!valid)
+			fprintf(pOut, "Prewarmed run INVALID\n");
+		ok = ok && valid;
+		cache.Shutdown();
+	}
+
+	//Damaged: the entry fails its checksum, is compiled again and repaired by Save()
+	{
+		bool damaged = DamageEntry();
+		unsigned calls = compiler.Calls.load();
+		cache.Init(&device, CACHE_PATH, StandInCompile, &compiler, 1);
+		double ms = RequestAll(cache, pipelines, NULL);
+		ShaderCacheStats stats = cache.GetStats();
+		PrintRun(pOut, "One damaged entry", ms, stats, compiler.Calls.load() - calls);
+		bool saved = cache.Save();
+		cache.Shutdown();
+		cache.Init(&device, CACHE_PATH, StandInCompile, &compiler, 1);
+		RequestAll(cache, pipelines, NULL);
+		bool valid = damaged && saved && stats.Compiled == 1 && stats.Hits == SHADER_COUNT - 1 && cache.GetStats().IsWarm();
+		if(!valid)
+			fprintf(pOut, "Damaged run INVALID\n");
+		ok = ok && valid;
+		cache.Shutdown();
+	}
+
+	//New compiler: no old entry matches, Save(false) drops them from the file
+	{
+		unsigned calls = compiler.Calls.load();
+		cache.Init(&device, CACHE_PATH, StandInCompile, &compiler, 2);
+		double ms = RequestAll(cache, pipelines, NULL);
+		ShaderCacheStats stats = cache.GetStats();
+		PrintRun(pOut, "New compiler version", ms, stats, compiler.Calls.load() - calls);
+		unsigned before = FileEntries();
+		bool saved = cache.Save(false);
+		unsigned after = FileEntries();
+		fprintf(pOut, "%22s %u entries in the file, %u after dropping the unused ones\n", "", before, after);
+		bool valid = saved && stats.Hits == 0 && stats.Compiled == SHADER_COUNT && before == SHADER_COUNT + PIPELINE_COUNT &&
+			after == SHADER_COUNT + PIPELINE_COUNT;
+		if(!valid)
+			fprintf(pOut, "New compiler run INVALID\n");
+		ok = ok && valid;
+
+		//Compile errors reach the caller, the rest of the cache is not affected
+		ShaderSource broken = { "broken.ps", "#error not finished\n", NULL, "main", "ps_2_0" };
+		int shader = cache.RequestShader(RD_SHADER_PIXEL, broken);
+		cache.WaitAll();
+		bool failed = shader >= 0 && cache.GetShaderState(shader) == SHADER_FAILED && !cache.GetErrors(shader).empty() &&
+			cache.GetShader(shader) == NULL && cache.GetStats().Failed == 1;
+		fprintf(pOut, "Compile errors %s\n", failed ? "reported" : "LOST");
+		ok = ok && failed;
+		cache.Shutdown();
+	}
+
+	fprintf(pOut, "Shader cache %s\n", ok ? "works" : "FAILED");
+	remove(CACHE_PATH);
+	return ok;
+}
@@ -0,0 +1,15 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Shader cache benchmark and checks: requests 64 pipelines (128
+				shader permutations) with a cold cache, then warm, prewarmed, with
+				a damaged entry and with a new compiler version. A stand-in
+				compiler with about the cost of D3DXCompileShader takes the place
+				of D3DX, so the cache format and lookups run on any platform.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if the cache misbehaved
+bool RunShaderBenchmarks(FILE* pOut);
@@ -0,0 +1,714 @@
+#include "ShaderCache.h"
+#include "Timer.h"
+#include "Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include "d3dUtil.h"
+#endif
+
+static_assert(sizeof(ShaderAssetHeader) == 16 && sizeof(PipelineAssetHeader) == 32, "Cache structs must not have padding");
+static_assert(sizeof(RDVertexElement) == 8, "Vertex elements are stored as they are");
+
+namespace
+{
+	//Alignment of the entries in the file, bytecode is read in place
+	const uint32_t FILE_ALIGNMENT = 16;
+
+	uint64_t HashString(const char* pString, uint64_t hash)
+	{
+		//With the terminator, so neighbouring fields can not run into each other
+		if(!pString)
+			pString = "";
+		return ShaderHash(pString, strlen(pString) + 1, hash);
+	}
+
+	//Entries are named after their key
+	void KeyName(uint64_t key, char* pName)
+	{
+		sprintf(pName, "%016llx", (unsigned long long)key);
+	}
+
+#ifdef _WIN32
+	bool D3DXCompile(void* pContext, const ShaderSource& source, std::vector<uint8_t>* pBytecode, std::string* pErrors)
+	{
+		ID3DXBuffer* pCode = NULL;
+		ID3DXBuffer* pMessages = NULL;
+		//ShaderDefine has the same layout as D3DXMACRO
+		HRESULT result = D3DXCompileShader(source.pCode, (UINT)strlen(source.pCode), reinterpret_cast<const D3DXMACRO*>(source.pDefines),
+			NULL, source.pEntryPoint, source.pProfile, 0, &pCode, &pMessages, NULL);
+		if(pMessages)
+			pErrors->append((const char*)pMessages->GetBufferPointer());
+		if(SUCCEEDED(result) && pCode)
+		{
+			const uint8_t* pData = (const uint8_t*)pCode->GetBufferPointer();
+			pBytecode->assign(pData, pData + pCode->GetBufferSize());
+		}
+		SAFE_RELEASE(pCode);
+		SAFE_RELEASE(pMessages);
+		return SUCCEEDED(result);
+	}
+#endif
+}
+
+ShaderCompileFunction GetPlatformShaderCompiler()
+{
+#ifdef _WIN32
+	return D3DXCompile;
+#else
+	return NULL;
+#endif
+}
+
+uint64_t GetPlatformShaderCompilerVersion()
+{
+#ifdef _WIN32
+	return D3DX_SDK_VERSION;
+#else
+	return 0;
+#endif
+}
+
+uint64_t ShaderHash(const void* pData, size_t size, uint64_t hash)
+{
+	const uint8_t* pBytes = (const uint8_t*)pData;
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= pBytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+uint64_t ShaderKey(RDShaderType type, const ShaderSource& source, uint64_t compilerVersion)
+{
+	uint32_t header[2] = { (uint32_t)type, 0 };
+	for(const ShaderDefine* pDefine = source.pDefines; pDefine && pDefine->pName; ++pDefine)
+		++header[1];
+
+	uint64_t hash = ShaderHash(&compilerVersion, sizeof(compilerVersion));
+	hash = ShaderHash(header, sizeof(header), hash);
+	hash = HashString(source.pCode, hash);
+	for(const ShaderDefine* pDefine = source.pDefines; pDefine && pDefine->pName; ++pDefine)
+	{
+		hash = HashString(pDefine->pName, hash);
+		hash = HashString(pDefine->pDefinition, hash);
+	}
+	hash = HashString(source.pEntryPoint, hash);
+	return HashString(source.pProfile, hash);
+}
+
+ShaderCache::ShaderCache()
+{
+	m_pDevice = NULL;
+	m_Compiler = NULL;
+	m_pContext = NULL;
+	m_CompilerVersion = 0;
+	m_Dirty = false;
+	m_NewRequests = false;
+	m_Outstanding = 0;
+	m_Stop = false;
+	m_InitTicks = 0;
+	m_CompileTicks.store(0);
+	m_FileEntries = 0;
+	m_Hits = 0;
+	m_Compiled = 0;
+	m_Failed = 0;
+	m_PipelineHits = 0;
+	m_OpenMs = 0.0;
+	m_LoadMs = 0.0;
+	m_AllReadyMs = 0.0;
+}
+
+ShaderCache::~ShaderCache()
+{
+	Shutdown();
+}
+
+bool ShaderCache::Init(IRenderDevice* pDevice, const char* pPath, ShaderCompileFunction compiler, void* pContext,
+	uint64_t compilerVersion, unsigned compileThreads)
+{
+	Shutdown();
+	if(!pDevice)
+		return false;
+
+	m_pDevice = pDevice;
+	m_Path = pPath ? pPath : "";
+	m_Compiler = compiler;
+	m_pContext = pContext;
+	m_CompilerVersion = compilerVersion;
+	m_InitTicks = TimerTicks();
+
+	//A file that does not open is treated like an empty one and replaced by Save()
+	if(!m_Path.empty())
+	{
+		m_File.Open(m_Path.c_str());
+		m_FileEntries = m_File.GetEntryCount();
+		m_OpenMs = TicksToMs(TimerTicks() - m_InitTicks);
+	}
+
+	m_Stop = false;
+	if(m_Compiler)
+	{
+		for(unsigned i = 0; i < std::max(compileThreads, 1u); ++i)
+			m_Threads.push_back(std::thread(&ShaderCache::CompileThreadMain, this));
+	}
+	return true;
+}
+
+void ShaderCache::Shutdown()
+{
+	if(!m_Threads.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_Stop = true;
+		}
+		m_Wake.notify_all();
+		for(size_t i = 0; i < m_Threads.size(); ++i)
+			m_Threads[i].join();
+		m_Threads.clear();
+	}
+	m_Queue.clear();
+	m_Outstanding = 0;
+
+	for(size_t i = 0; i < m_Pipelines.size(); ++i)
+		SAFE_RELEASE(m_Pipelines[i].pDecl);
+	for(size_t i = 0; i < m_Shaders.size(); ++i)
+	{
+		SAFE_RELEASE(m_Shaders[i]->pShader);
+		delete m_Shaders[i];
+	}
+	m_Shaders.clear();
+	m_Pipelines.clear();
+	m_ShaderKeys.clear();
+	m_PipelineKeys.clear();
+	m_PendingShaders.clear();
+	m_PendingPipelines.clear();
+	m_File.Close();
+
+	m_pDevice = NULL;
+	m_Dirty = false;
+	m_NewRequests = false;
+	m_CompileTicks.store(0);
+	m_FileEntries = 0;
+	m_Hits = 0;
+	m_Compiled = 0;
+	m_Failed = 0;
+	m_PipelineHits = 0;
+	m_OpenMs = 0.0;
+	m_LoadMs = 0.0;
+	m_AllReadyMs = 0.0;
+}
+
+int ShaderCache::RequestShader(RDShaderType type, const ShaderSource& source)
+{
+	if(!IsRunning() || !source.pCode)
+		return -1;
+
+	uint64_t key = ShaderKey(type, source, m_CompilerVersion);
+	std::unordered_map<uint64_t, int>::const_iterator found = m_ShaderKeys.find(key);
+	if(found != m_ShaderKeys.end())
+		return found->second;
+	return AddShader(key, type, source);
+}
+
+ShaderCache::ShaderEntry* ShaderCache::NewShader(uint64_t key, RDShaderType type)
+{
+	ShaderEntry* pEntry = new ShaderEntry();
+	pEntry->Key = key;
+	pEntry->Type = type;
+	pEntry->State.store(SHADER_PENDING, std::memory_order_relaxed);
+	pEntry->Stored = false;
+	pEntry->pShader = NULL;
+	return pEntry;
+}
+
+int ShaderCache::Register(ShaderEntry* pEntry)
+{
+	int index = (int)m_Shaders.size();
+	m_Shaders.push_back(pEntry);
+	m_ShaderKeys[pEntry->Key] = index;
+	m_NewRequests = true;
+	return index;
+}
+
+int ShaderCache::AddShader(uint64_t key, RDShaderType type, const ShaderSource& source)
+{
+	ShaderEntry* pEntry = NewShader(key, type);
+	pEntry->Name = source.pName ? source.pName : "";
+	pEntry->Code = source.pCode;
+	pEntry->EntryPoint = source.pEntryPoint ? source.pEntryPoint : "";
+	pEntry->Profile = source.pProfile ? source.pProfile : "";
+	for(const ShaderDefine* pDefine = source.pDefines; pDefine && pDefine->pName; ++pDefine)
+	{
+		pEntry->Defines.push_back(pDefine->pName);
+		pEntry->Defines.push_back(pDefine->pDefinition ? pDefine->pDefinition : "");
+	}
+	int index = Register(pEntry);
+
+	if(Load(pEntry))
+		return index;
+
+	if(m_Threads.empty())
+	{
+		pEntry->Errors = "No shader compiler in this build\n";
+		pEntry->State.store(SHADER_FAILED, std::memory_order_relaxed);
+		++m_Failed;
+		return index;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Lock);
+		m_Queue.push_back(pEntry);
+		++m_Outstanding;
+	}
+	m_Wake.notify_one();
+	m_PendingShaders.push_back(index);
+	return index;
+}
+
+bool ShaderCache::Load(ShaderEntry* pEntry)
+{
+	int64_t start = TimerTicks();
+	if(!m_File.IsOpen() || !CreateFromFile(pEntry))
+		return false;
+
+	m_LoadMs += TicksToMs(TimerTicks() - start);
+	pEntry->Stored = true;
+	pEntry->State.store(SHADER_READY, std::memory_order_relaxed);
+	++m_Hits;
+	return true;
+}
+
+bool ShaderCache::CreateFromFile(ShaderEntry* pEntry)
+{
+	char name[17];
+	KeyName(pEntry->Key, name);
+	int index = m_File.Find(name);
+	if(index < 0)
+		return false;
+
+	//A damaged entry is compiled again and replaced by the next Save()
+	const AssetEntry& asset = m_File.GetEntry(index);
+	if(asset.Type != ASSET_SHADER || asset.Size < sizeof(ShaderAssetHeader))
+		return false;
+	const ShaderAssetHeader* pHeader = (const ShaderAssetHeader*)m_File.GetData(index);
+	const uint8_t* pBytecode = (const uint8_t*)(pHeader + 1);
+	if(pHeader->Type != (uint32_t)pEntry->Type || pHeader->BytecodeSize == 0 ||
+		sizeof(ShaderAssetHeader) + (uint64_t)pHeader->BytecodeSize > asset.Size ||
+		ShaderHash(pBytecode, pHeader->BytecodeSize) != pHeader->Checksum)
+		return false;
+
+	return m_pDevice->CreateShader(pEntry->Type, pBytecode, pHeader->BytecodeSize, &pEntry->pShader);
+}
+
+int ShaderCache::RequestPipeline(const ShaderPipelineDesc& desc)
+{
+	int vertexShader = RequestShader(RD_SHADER_VERTEX, desc.VertexShader);
+	int pixelShader = RequestShader(RD_SHADER_PIXEL, desc.PixelShader);
+	if(vertexShader < 0 || pixelShader < 0)
+		return -1;
+
+	PipelineEntry pipeline;
+	pipeline.VertexShader = vertexShader;
+	pipeline.PixelShader = pixelShader;
+	for(const RDVertexElement* pElement = desc.pElements; pElement && pElement->Stream != 0xFF; ++pElement)
+		pipeline.Elements.push_back(*pElement);
+	pipeline.FVF = pipeline.Elements.empty() ? desc.FVF : 0;
+	if(desc.RenderStateCount > 0)
+		pipeline.RenderStates.assign(desc.pRenderStates, desc.pRenderStates + desc.RenderStateCount * 2);
+	pipeline.pDecl = NULL;
+	pipeline.State = SHADER_PENDING;
+
+	//Same shaders, layout and states give the same key
+	uint64_t keys[2] = { m_Shaders[vertexShader]->Key, m_Shaders[pixelShader]->Key };
+	uint32_t counts[3] = { pipeline.FVF, (uint32_t)pipeline.Elements.size(), desc.RenderStateCount };
+	uint64_t key = ShaderHash(keys, sizeof(keys));
+	key = ShaderHash(counts, sizeof(counts), key);
+	if(!pipeline.Elements.empty())
+		key = ShaderHash(&pipeline.Elements[0], pipeline.Elements.size() * sizeof(RDVertexElement), key);
+	if(!pipeline.RenderStates.empty())
+		key = ShaderHash(&pipeline.RenderStates[0], pipeline.RenderStates.size() * sizeof(RDWORD), key);
+	pipeline.Key = key;
+
+	std::unordered_map<uint64_t, int>::const_iterator found = m_PipelineKeys.find(key);
+	if(found != m_PipelineKeys.end())
+		return found->second;
+
+	char name[17];
+	KeyName(key, name);
+	int stored = m_File.IsOpen() ? m_File.Find(name) : -1;
+	pipeline.Stored = stored >= 0 && m_File.GetEntry(stored).Type == ASSET_PIPELINE;
+	if(pipeline.Stored)
+		++m_PipelineHits;
+
+	int index = (int)m_Pipelines.size();
+	m_Pipelines.push_back(pipeline);
+	m_PipelineKeys[key] = index;
+	m_NewRequests = true;
+	ResolvePipeline(m_Pipelines.back());
+	if(m_Pipelines.back().State == SHADER_PENDING)
+		m_PendingPipelines.push_back(index);
+	return index;
+}
+
+unsigned ShaderCache::Prewarm()
+{
+	if(!IsRunning() || !m_File.IsOpen())
+		return 0;
+
+	unsigned created = 0;
+	for(unsigned i = 0; i < m_File.GetEntryCount(); ++i)
+	{
+		const AssetEntry& asset = m_File.GetEntry(i);
+		if(asset.Type != ASSET_PIPELINE || asset.Size < sizeof(PipelineAssetHeader))
+			continue;
+		const PipelineAssetHeader* pHeader = (const PipelineAssetHeader*)m_File.GetData(i);
+		uint64_t size = sizeof(PipelineAssetHeader) + (uint64_t)pHeader->ElementCount * sizeof(RDVertexElement) +
+			(uint64_t)pHeader->RenderStateCount * 2 * sizeof(RDWORD);
+		uint64_t key = strtoull(m_File.GetName(i), NULL, 16);
+		if(size > asset.Size || m_PipelineKeys.find(key) != m_PipelineKeys.end())
+			continue;
+
+		//The shaders come from the file too. Without sources to compile them from,
+		//pipelines with a shader missing or damaged are left to their requests.
+		PipelineEntry pipeline;
+		pipeline.Key = key;
+		uint64_t shaderKeys[2] = { pHeader->VertexShader, pHeader->PixelShader };
+		int shaders[2] = { -1, -1 };
+		for(int type = RD_SHADER_VERTEX; type <= RD_SHADER_PIXEL; ++type)
+		{
+			std::unordered_map<uint64_t, int>::const_iterator found = m_ShaderKeys.find(shaderKeys[type]);
+			if(found != m_ShaderKeys.end())
+			{
+				shaders[type] = found->second;
+				continue;
+			}
+			ShaderEntry* pEntry = NewShader(shaderKeys[type], (RDShaderType)type);
+			if(Load(pEntry))
+				shaders[type] = Register(pEntry);
+			else
+				delete pEntry;
+		}
+		if(shaders[RD_SHADER_VERTEX] < 0 || shaders[RD_SHADER_PIXEL] < 0 ||
+			GetShaderState(shaders[RD_SHADER_VERTEX]) == SHADER_FAILED || GetShaderState(shaders[RD_SHADER_PIXEL]) == SHADER_FAILED)
+			continue;
+		pipeline.VertexShader = shaders[RD_SHADER_VERTEX];
+		pipeline.PixelShader = shaders[RD_SHADER_PIXEL];
+		const RDVertexElement* pElements = (const RDVertexElement*)(pHeader + 1);
+		const RDWORD* pStates = (const RDWORD*)(pElements + pHeader->ElementCount);
+		pipeline.Elements.assign(pElements, pElements + pHeader->ElementCount);
+		pipeline.FVF = pHeader->FVF;
+		pipeline.RenderStates.assign(pStates, pStates + pHeader->RenderStateCount * 2);
+		pipeline.pDecl = NULL;
+		pipeline.State = SHADER_PENDING;
+		pipeline.Stored = true;
+		ResolvePipeline(pipeline);
+		if(pipeline.State == SHADER_FAILED)
+			continue;
+
+		int index = (int)m_Pipelines.size();
+		m_PipelineKeys[key] = index;
+		m_Pipelines.push_back(pipeline);
+		//Shaders still compiling for another request
+		if(pipeline.State == SHADER_PENDING)
+			m_PendingPipelines.push_back(index);
+		else
+			++created;
+	}
+	return created;
+}
+
+void ShaderCache::ResolvePipeline(PipelineEntry& pipeline)
+{
+	ShaderState vertexState = GetShaderState(pipeline.VertexShader);
+	ShaderState pixelState = GetShaderState(pipeline.PixelShader);
+	if(vertexState == SHADER_FAILED || pixelState == SHADER_FAILED)
+	{
+		pipeline.State = SHADER_FAILED;
+		return;
+	}
+	if(vertexState != SHADER_READY || pixelState != SHADER_READY)
+		return;
+
+	if(!pipeline.Elements.empty())
+	{
+		std::vector<RDVertexElement> elements(pipeline.Elements);
+		RDVertexElement end = RD_DECL_END();
+		elements.push_back(end);
+		if(!m_pDevice->CreateVertexDeclaration(&elements[0], &pipeline.pDecl))
+		{
+			pipeline.State = SHADER_FAILED;
+			return;
+		}
+	}
+	pipeline.State = SHADER_READY;
+	if(!pipeline.Stored)
+		m_Dirty = true;
+}
+
+void ShaderCache::CompileThreadMain()
+{
+	PROFILE_THREAD("Shader compile");
+	for(;;)
+	{
+		ShaderEntry* pEntry = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_Lock);
+			while(!m_Stop && m_Queue.empty())
+				m_Wake.wait(lock);
+			if(m_Stop)
+				return;
+			pEntry = m_Queue.front();
+			m_Queue.pop_front();
+		}
+
+		Compile(pEntry);
+
+		std::lock_guard<std::mutex> lock(m_Lock);
+		--m_Outstanding;
+		m_Done.notify_all();
+	}
+}
+
+void ShaderCache::Compile(ShaderEntry* pEntry)
+{
+	PROFILE_ZONE("Compile shader");
+
+	std::vector<ShaderDefine> defines;
+	for(size_t i = 0; i + 1 < pEntry->Defines.size(); i += 2)
+	{
+		ShaderDefine define = { pEntry->Defines[i].c_str(), pEntry->Defines[i + 1].c_str() };
+		defines.push_back(define);
+	}
+	ShaderDefine end = { NULL, NULL };
+	defines.push_back(end);
+	ShaderSource source = { pEntry->Name.c_str(), pEntry->Code.c_str(), &defines[0], pEntry->EntryPoint.c_str(), pEntry->Profile.c_str() };
+
+	int64_t start = TimerTicks();
+	bool compiled = m_Compiler(m_pContext, source, &pEntry->Bytecode, &pEntry->Errors) && !pEntry->Bytecode.empty();
+	m_CompileTicks.fetch_add(TimerTicks() - start, std::memory_order_relaxed);
+
+	//The render thread reads the bytecode once it sees the new state
+	pEntry->State.store(compiled ? (int)SHADER_COMPILED : (int)SHADER_FAILED, std::memory_order_release);
+}
+
+bool ShaderCache::Update()
+{
+	for(size_t i = 0; i < m_PendingShaders.size(); )
+	{
+		ShaderEntry* pEntry = m_Shaders[m_PendingShaders[i]];
+		int state = pEntry->State.load(std::memory_order_acquire);
+		if(state == SHADER_PENDING)
+		{
+			++i;
+			continue;
+		}
+
+		if(state == SHADER_COMPILED)
+		{
+			++m_Compiled;
+			if(m_pDevice->CreateShader(pEntry->Type, &pEntry->Bytecode[0], (unsigned)pEntry->Bytecode.size(), &pEntry->pShader))
+			{
+				pEntry->State.store(SHADER_READY, std::memory_order_relaxed);
+				m_Dirty = true;
+			}
+			else
+			{
+				pEntry->Errors += "The device refused the bytecode\n";
+				pEntry->State.store(SHADER_FAILED, std::memory_order_relaxed);
+				++m_Failed;
+			}
+		}
+		else
+			++m_Failed;
+
+		m_PendingShaders[i] = m_PendingShaders.back();
+		m_PendingShaders.pop_back();
+	}
+
+	for(size_t i = 0; i < m_PendingPipelines.size(); )
+	{
+		PipelineEntry& pipeline = m_Pipelines[m_PendingPipelines[i]];
+		ResolvePipeline(pipeline);
+		if(pipeline.State == SHADER_PENDING)
+		{
+			++i;
+			continue;
+		}
+		m_PendingPipelines[i] = m_PendingPipelines.back();
+		m_PendingPipelines.pop_back();
+	}
+
+	bool ready = m_PendingShaders.empty() && m_PendingPipelines.empty();
+	if(ready && m_NewRequests)
+	{
+		m_AllReadyMs = TicksToMs(TimerTicks() - m_InitTicks);
+		m_NewRequests = false;
+	}
+	return ready;
+}
+
+void ShaderCache::WaitAll()
+{
+	{
+		PROFILE_ZONE("Wait for shaders");
+		std::unique_lock<std::mutex> lock(m_Lock);
+		while(m_Outstanding > 0)
+			m_Done.wait(lock);
+	}
+	Update();
+}
+
+ShaderState ShaderCache::GetShaderState(int shader) const
+{
+	int state = m_Shaders[shader]->State.load(std::memory_order_acquire);
+	return state == SHADER_COMPILED ? SHADER_PENDING : (ShaderState)state;
+}
+
+IShader* ShaderCache::GetShader(int shader) const
+{
+	return GetShaderState(shader) == SHADER_READY ? m_Shaders[shader]->pShader : NULL;
+}
+
+bool ShaderCache::ApplyPipeline(int pipeline)
+{
+	const PipelineEntry& entry = m_Pipelines[pipeline];
+	if(entry.State != SHADER_READY)
+		return false;
+
+	m_pDevice->SetShader(RD_SHADER_VERTEX, m_Shaders[entry.VertexShader]->pShader);
+	m_pDevice->SetShader(RD_SHADER_PIXEL, m_Shaders[entry.PixelShader]->pShader);
+	if(entry.pDecl)
+		m_pDevice->SetVertexDeclaration(entry.pDecl);
+	else
+		m_pDevice->SetFVF(entry.FVF);
+	for(size_t i = 0; i < entry.RenderStates.size(); i += 2)
+		m_pDevice->SetRenderState((RDRenderState)entry.RenderStates[i], entry.RenderStates[i + 1]);
+	return true;
+}
+
+void ShaderCache::WriteShader(AssetArchiveWriter& writer, const ShaderEntry& entry) const
+{
+	char name[17];
+	KeyName(entry.Key, name);
+	if(entry.Stored)
+	{
+		//Unchanged, straight from the old file
+		int index = m_File.Find(name);
+		if(index >= 0)
+			writer.AddAsset(name, ASSET_SHADER, m_File.GetData(index), (size_t)m_File.GetEntry(index).Size);
+		return;
+	}
+
+	ShaderAssetHeader header;
+	header.Checksum = ShaderHash(&entry.Bytecode[0], entry.Bytecode.size());
+	header.Type = entry.Type;
+	header.BytecodeSize = (uint32_t)entry.Bytecode.size();
+	std::vector<uint8_t> data(sizeof(header) + entry.Bytecode.size());
+	memcpy(&data[0], &header, sizeof(header));
+	memcpy(&data[sizeof(header)], &entry.Bytecode[0], entry.Bytecode.size());
+	writer.AddAsset(name, ASSET_SHADER, &data[0], data.size());
+}
+
+void ShaderCache::WritePipeline(AssetArchiveWriter& writer, const PipelineEntry& pipeline) const
+{
+	PipelineAssetHeader header;
+	header.VertexShader = m_Shaders[pipeline.VertexShader]->Key;
+	header.PixelShader = m_Shaders[pipeline.PixelShader]->Key;
+	header.FVF = pipeline.FVF;
+	header.ElementCount = (uint32_t)pipeline.Elements.size();
+	header.RenderStateCount = (uint32_t)pipeline.RenderStates.size() / 2;
+	header.Reserved = 0;
+
+	size_t elementBytes = pipeline.Elements.size() * sizeof(RDVertexElement);
+	size_t stateBytes = pipeline.RenderStates.size() * sizeof(RDWORD);
+	std::vector<uint8_t> data(sizeof(header) + elementBytes + stateBytes);
+	memcpy(&data[0], &header, sizeof(header));
+	if(elementBytes)
+		memcpy(&data[sizeof(header)], &pipeline.Elements[0], elementBytes);
+	if(stateBytes)
+		memcpy(&data[sizeof(header) + elementBytes], &pipeline.RenderStates[0], stateBytes);
+
+	char name[17];
+	KeyName(pipeline.Key, name);
+	writer.AddAsset(name, ASSET_PIPELINE, &data[0], data.size());
+}
+
+bool ShaderCache::Save(bool keepUnused)
+{
+	if(!IsRunning() || m_Path.empty())
+		return false;
+	if(!m_Dirty && keepUnused)
+		return true;
+
+	//Everything ready this run, then (the writer skips names it already has) the rest of the old file
+	AssetArchiveWriter writer(FILE_ALIGNMENT);
+	for(size_t i = 0; i < m_Shaders.size(); ++i)
+	{
+		if(GetShaderState((int)i) == SHADER_READY)
+			WriteShader(writer, *m_Shaders[i]);
+	}
+	for(size_t i = 0; i < m_Pipelines.size(); ++i)
+	{
+		if(m_Pipelines[i].State == SHADER_READY)
+			WritePipeline(writer, m_Pipelines[i]);
+	}
+	for(unsigned i = 0; keepUnused && i < m_File.GetEntryCount(); ++i)
+		writer.AddAsset(m_File.GetName(i), (AssetType)m_File.GetEntry(i).Type, m_File.GetData(i), (size_t)m_File.GetEntry(i).Size);
+
+	//Written next to the old file and moved over it, so a crash never leaves half a cache.
+	//The mapping has to go first, Windows does not replace mapped files.
+	std::string temporary = m_Path + ".tmp";
+	if(!writer.Write(temporary.c_str()))
+	{
+		remove(temporary.c_str());
+		return false;
+	}
+	m_File.Close();
+	remove(m_Path.c_str());
+	bool saved = rename(temporary.c_str(), m_Path.c_str()) == 0;
+	m_File.Open(m_Path.c_str());
+	if(!saved)
+		return false;
+
+	//The bytecode lives in the file now
+	for(size_t i = 0; i < m_Shaders.size(); ++i)
+	{
+		if(GetShaderState((int)i) == SHADER_READY)
+		{
+			m_Shaders[i]->Stored = true;
+			std::vector<uint8_t>().swap(m_Shaders[i]->Bytecode);
+		}
+	}
+	for(size_t i = 0; i < m_Pipelines.size(); ++i)
+	{
+		if(m_Pipelines[i].State == SHADER_READY)
+			m_Pipelines[i].Stored = true;
+	}
+	m_Dirty = false;
+	return true;
+}
+
+ShaderCacheStats ShaderCache::GetStats() const
+{
+	ShaderCacheStats stats;
+	stats.FileEntries = m_FileEntries;
+	stats.Shaders = (unsigned)m_Shaders.size();
+	stats.Hits = m_Hits;
+	stats.Compiled = m_Compiled;
+	stats.Failed = m_Failed;
+	stats.Pending = (unsigned)m_PendingShaders.size();
+	stats.Pipelines = (unsigned)m_Pipelines.size();
+	stats.PipelineHits = m_PipelineHits;
+	stats.OpenMs = m_OpenMs;
+	stats.LoadMs = m_LoadMs;
+	stats.CompileMs = TicksToMs(m_CompileTicks.load(std::memory_order_relaxed));
+	stats.AllReadyMs = m_AllReadyMs;
+	return stats;
+}
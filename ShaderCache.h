@@ -0,0 +1,249 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Shader and pipeline cache for fast startup. Every shader is keyed
+				by a hash of its source, defines, entry point, profile and the
+				compiler version; pipelines (shader pair, vertex layout and render
+				states) by a hash of those. Compiled bytecode and pipeline records
+				are stored under their keys in an AssetArchive file, so a warm
+				start maps the file and creates device shaders without compiling.
+				Misses compile on background threads while the application keeps
+				rendering with what is ready (e.g. the fixed function pipeline).
+				Save() writes the new entries back for the next start.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "AssetArchive.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//Preprocessor definition (same layout as D3DXMACRO), arrays end with { NULL, NULL }
+struct ShaderDefine
+{
+	const char*	pName;
+	const char*	pDefinition;
+};
+
+//HLSL source of one shader, the cache copies everything it keeps
+struct ShaderSource
+{
+	const char*			pName;			//For error messages, not part of the key
+	const char*			pCode;
+	const ShaderDefine*	pDefines;		//NULL for none
+	const char*			pEntryPoint;	//e.g. "main"
+	const char*			pProfile;		//e.g. "vs_2_0"
+};
+
+//Everything ShaderCache::ApplyPipeline() binds
+struct ShaderPipelineDesc
+{
+	ShaderSource			VertexShader;
+	ShaderSource			PixelShader;
+	const RDVertexElement*	pElements;			//Ends with RD_DECL_END(), NULL to use FVF
+	RDWORD					FVF;
+	const RDWORD*			pRenderStates;		//RDRenderState, value pairs
+	unsigned				RenderStateCount;	//Pairs
+};
+
+//Compiles source into Direct3D 9 bytecode and appends the compiler messages to
+//pErrors. Called on the compile threads, so it must not touch the device.
+typedef bool (*ShaderCompileFunction)(void* pContext, const ShaderSource& source, std::vector<uint8_t>* pBytecode, std::string* pErrors);
+
+//D3DXCompileShader on Windows, NULL where there is no HLSL compiler
+ShaderCompileFunction GetPlatformShaderCompiler();
+//Part of every key, so bytecode of another compiler version is never used
+uint64_t GetPlatformShaderCompilerVersion();
+
+//64 bit FNV-1a of size bytes, continuing from hash
+uint64_t ShaderHash(const void* pData, size_t size, uint64_t hash = 14695981039346656037ULL);
+//Key of a shader: type, source, defines (in order), entry point, profile and compiler version
+uint64_t ShaderKey(RDShaderType type, const ShaderSource& source, uint64_t compilerVersion);
+
+//At the start of an ASSET_SHADER entry, the bytecode follows. Entries are named
+//after their key (16 hex digits).
+struct ShaderAssetHeader
+{
+	uint64_t	Checksum;			//ShaderHash() of the bytecode
+	uint32_t	Type;				//RDShaderType
+	uint32_t	BytecodeSize;
+};
+
+//At the start of an ASSET_PIPELINE entry, followed by ElementCount RDVertexElements
+//(without RD_DECL_END()) and RenderStateCount state, value pairs
+struct PipelineAssetHeader
+{
+	uint64_t	VertexShader;		//Shader keys
+	uint64_t	PixelShader;
+	uint32_t	FVF;
+	uint32_t	ElementCount;
+	uint32_t	RenderStateCount;
+	uint32_t	Reserved;
+};
+
+enum ShaderState
+{
+	SHADER_PENDING,		//Compiling (or waiting for Update() to create it)
+	SHADER_READY,
+	SHADER_FAILED		//Compile errors, no compiler, or the device refused it
+};
+
+struct ShaderCacheStats
+{
+	unsigned	FileEntries;		//Shaders and pipelines in the file when it was opened
+	unsigned	Shaders;			//Requested
+	unsigned	Hits;				//Loaded from the file
+	unsigned	Compiled;
+	unsigned	Failed;
+	unsigned	Pending;
+	unsigned	Pipelines;			//Requested
+	unsigned	PipelineHits;
+	double		OpenMs;				//Mapping and checking the file
+	double		LoadMs;				//Creating device shaders from cached bytecode
+	double		CompileMs;			//Sum over all compile threads
+	double		AllReadyMs;			//From Init() until nothing was pending (last time it happened)
+
+	//Nothing had to be compiled
+	bool IsWarm() const { return Shaders > 0 && Hits == Shaders; }
+};
+
+class ShaderCache
+{
+public:
+	ShaderCache();
+	~ShaderCache();
+
+	//Opens the cache file (a missing or invalid file starts an empty cache) and
+	//starts the compile threads. Without a compiler only cached shaders load.
+	//pPath may be NULL for a cache that only lives in memory. The device must
+	//outlive the cache.
+	bool Init(IRenderDevice* pDevice, const char* pPath, ShaderCompileFunction compiler, void* pContext,
+		uint64_t compilerVersion, unsigned compileThreads = 2);
+	//Stops the threads and releases every device object, without saving
+	void Shutdown();
+	bool IsRunning() const { return m_pDevice != NULL; }
+
+	//Render thread. Returns the shader index; a cached shader is ready right away,
+	//a miss is queued for compiling. Requesting the same shader again returns
+	//the same index.
+	int RequestShader(RDShaderType type, const ShaderSource& source);
+	int RequestPipeline(const ShaderPipelineDesc& desc);
+	//Creates every pipeline of the file whose shaders are in the file as well, so
+	//later requests find them ready (loading screens). Returns the pipelines created.
+	unsigned Prewarm();
+
+	//Render thread, once per frame: creates device shaders for finished compiles.
+	//Returns true when nothing is pending.
+	bool Update();
+	//Blocks until every queued compile finished (loading screens), then Update()
+	void WaitAll();
+
+	ShaderState GetShaderState(int shader) const;
+	//NULL until the shader is ready
+	IShader* GetShader(int shader) const;
+	//Compiler messages, empty if there were none
+	const std::string& GetErrors(int shader) const { return m_Shaders[shader]->Errors; }
+	ShaderState GetPipelineState(int pipeline) const { return m_Pipelines[pipeline].State; }
+	//Binds the shaders, the vertex layout and the render states. Binds nothing
+	//and returns false while the pipeline is not ready.
+	bool ApplyPipeline(int pipeline);
+
+	//Writes the file if anything was compiled since it was opened. keepUnused
+	//false drops the entries nothing requested this run (e.g. after editing shaders).
+	bool Save(bool keepUnused = true);
+
+	ShaderCacheStats GetStats() const;
+
+private:
+	//Disallow copying
+	ShaderCache(const ShaderCache&);
+	ShaderCache& operator=(const ShaderCache&);
+
+	enum { SHADER_COMPILED = SHADER_FAILED + 1 };	//Bytecode ready, device shader not created yet
+
+	struct ShaderEntry
+	{
+		uint64_t					Key;
+		RDShaderType				Type;
+		std::atomic<int>			State;			//ShaderState or SHADER_COMPILED
+		bool						Stored;			//In the file
+		//Copies of the source, read by the compile threads
+		std::string					Name;
+		std::string					Code;
+		std::string					EntryPoint;
+		std::string					Profile;
+		std::vector<std::string>	Defines;		//Name, definition pairs
+		std::vector<uint8_t>		Bytecode;		//Compiled this run, until saved
+		std::string					Errors;
+		IShader*					pShader;
+	};
+
+	struct PipelineEntry
+	{
+		uint64_t						Key;
+		int								VertexShader;
+		int								PixelShader;
+		std::vector<RDVertexElement>	Elements;		//Without the end marker, empty for FVF
+		RDWORD							FVF;
+		std::vector<RDWORD>				RenderStates;	//State, value pairs
+		IVertexDeclaration*				pDecl;
+		ShaderState						State;
+		bool							Stored;
+	};
+
+	ShaderEntry* NewShader(uint64_t key, RDShaderType type);
+	int Register(ShaderEntry* pEntry);
+	//Loads the shader from the file or queues it for compiling
+	int AddShader(uint64_t key, RDShaderType type, const ShaderSource& source);
+	//Creates the device shader from the file and counts the hit, false on a miss or a damaged entry
+	bool Load(ShaderEntry* pEntry);
+	bool CreateFromFile(ShaderEntry* pEntry);
+	//Device objects of a pipeline whose shaders are ready
+	void ResolvePipeline(PipelineEntry& pipeline);
+	void CompileThreadMain();
+	void Compile(ShaderEntry* pEntry);
+	void WriteShader(AssetArchiveWriter& writer, const ShaderEntry& entry) const;
+	void WritePipeline(AssetArchiveWriter& writer, const PipelineEntry& pipeline) const;
+
+	IRenderDevice*						m_pDevice;
+	std::string							m_Path;
+	AssetArchive						m_File;
+	ShaderCompileFunction				m_Compiler;
+	void*								m_pContext;
+	uint64_t							m_CompilerVersion;
+
+	std::vector<ShaderEntry*>			m_Shaders;		//Stable addresses for the compile threads
+	std::vector<PipelineEntry>			m_Pipelines;
+	std::unordered_map<uint64_t, int>	m_ShaderKeys;
+	std::unordered_map<uint64_t, int>	m_PipelineKeys;
+	std::vector<int>					m_PendingShaders;
+	std::vector<int>					m_PendingPipelines;
+	bool								m_Dirty;		//Entries the file does not have yet
+	bool								m_NewRequests;	//Since AllReadyMs was measured
+
+	std::vector<std::thread>			m_Threads;
+	std::mutex							m_Lock;
+	std::condition_variable				m_Wake;
+	std::condition_variable				m_Done;
+	std::deque<ShaderEntry*>			m_Queue;
+	unsigned							m_Outstanding;	//Queued or compiling
+	bool								m_Stop;
+
+	//Statistics
+	int64_t								m_InitTicks;
+	std::atomic<int64_t>				m_CompileTicks;
+	unsigned							m_FileEntries;
+	unsigned							m_Hits;
+	unsigned							m_Compiled;
+	unsigned							m_Failed;
+	unsigned							m_PipelineHits;
+	double								m_OpenMs;
+	double								m_LoadMs;
+	double								m_AllReadyMs;
+};
@@ -0,0 +1,570 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Header only vector math (replacement for the D3DX math functions).
+				Mat4 has the D3DMATRIX layout (row major, row vectors, v' = v * M)
+				so it can be passed straight to SetTransform. Uses SSE when the
+				target has SSE2, AVX for batch operations when compiled with AVX,
+				and plain C++ otherwise (define SIMDMATH_NO_SIMD to force it).
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+#if !defined(SIMDMATH_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIMDMATH_SSE 1
+#include <emmintrin.h>
+#if defined(__AVX__)
+#define SIMDMATH_AVX 1
+#include <immintrin.h>
+#endif
+#endif
+
+//-----------------------------------------------------------------------------
+//Types
+//-----------------------------------------------------------------------------
+
+const float MATH_PI = 3.14159265f;
+
+struct Vec3
+{
+	float x, y, z;
+
+	Vec3() {}
+	Vec3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+
+	Vec3 operator+(const Vec3& v) const { return Vec3(x + v.x, y + v.y, z + v.z); }
+	Vec3 operator-(const Vec3& v) const { return Vec3(x - v.x, y - v.y, z - v.z); }
+	Vec3 operator*(float s) const { return Vec3(x * s, y * s, z * s); }
+	Vec3 operator-() const { return Vec3(-x, -y, -z); }
+};
+
+struct Vec4
+{
+	float x, y, z, w;
+
+	Vec4() {}
+	Vec4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+	Vec4(const Vec3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
+};
+
+//Same memory layout as D3DMATRIX/D3DXMATRIX (m[row][column], translation in row 3)
+struct Mat4
+{
+	float m[4][4];
+
+	operator float*() { return &m[0][0]; }
+	operator const float*() const { return &m[0][0]; }
+};
+
+static_assert(sizeof(Vec3) == 12 && sizeof(Vec4) == 16 && sizeof(Mat4) == 64, "SimdMath types must match the D3D layouts");
+
+//Plane a*x + b*y + c*z + d = 0, points with a positive distance are in front
+struct Plane
+{
+	float a, b, c, d;
+};
+
+struct AABB
+{
+	Vec3 Min;
+	Vec3 Max;
+};
+
+//View frustum with inward facing planes, also stored as SoA padded to 8 planes
+//(the padding planes accept everything) for SIMD box tests
+struct Frustum
+{
+	enum { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, PLANE_COUNT };
+
+	Plane Planes[PLANE_COUNT];
+	float A[8], B[8], C[8], D[8];
+};
+
+//-----------------------------------------------------------------------------
+//Vectors
+//-----------------------------------------------------------------------------
+
+inline float Vec3Dot(const Vec3& a, const Vec3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 Vec3Cross(const Vec3& a, const Vec3& b)
+{
+	return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline float Vec3Length(const Vec3& v)
+{
+	return sqrtf(Vec3Dot(v, v));
+}
+
+inline Vec3 Vec3Normalize(const Vec3& v)
+{
+	float length = Vec3Length(v);
+	return length > 0.0f ? v * (1.0f / length) : Vec3(0.0f, 0.0f, 0.0f);
+}
+
+inline float Vec4Dot(const Vec4& a, const Vec4& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+//-----------------------------------------------------------------------------
+//Matrices
+//-----------------------------------------------------------------------------
+
+inline Mat4 Mat4Identity()
+{
+	Mat4 r = {{ { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } }};
+	return r;
+}
+
+//a * b (apply a first, then b)
+inline Mat4 Mat4Multiply(const Mat4& a, const Mat4& b)
+{
+	Mat4 r;
+#ifdef SIMDMATH_SSE
+	__m128 b0 = _mm_loadu_ps(b.m[0]);
+	__m128 b1 = _mm_loadu_ps(b.m[1]);
+	__m128 b2 = _mm_loadu_ps(b.m[2]);
+	__m128 b3 = _mm_loadu_ps(b.m[3]);
+	for(int i = 0; i < 4; ++i)
+	{
+		__m128 row = _mm_mul_ps(_mm_set1_ps(a.m[i][0]), b0);
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[i][1]), b1));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[i][2]), b2));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[i][3]), b3));
+		_mm_storeu_ps(r.m[i], row);
+	}
+#else
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+	}
+#endif
+	return r;
+}
+
+inline Mat4 Mat4Transpose(const Mat4& a)
+{
+	Mat4 r;
+	for(int i = 0; i < 4; ++i)
+	{
+		for(int j = 0; j < 4; ++j)
+			r.m[i][j] = a.m[j][i];
+	}
+	return r;
+}
+
+inline Mat4 Mat4Translation(float x, float y, float z)
+{
+	Mat4 r = Mat4Identity();
+	r.m[3][0] = x;
+	r.m[3][1] = y;
+	r.m[3][2] = z;
+	return r;
+}
+
+inline Mat4 Mat4Scaling(float x, float y, float z)
+{
+	Mat4 r = Mat4Identity();
+	r.m[0][0] = x;
+	r.m[1][1] = y;
+	r.m[2][2] = z;
+	return r;
+}
+
+inline Mat4 Mat4RotationX(float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	Mat4 r = Mat4Identity();
+	r.m[1][1] = c;  r.m[1][2] = s;
+	r.m[2][1] = -s; r.m[2][2] = c;
+	return r;
+}
+
+inline Mat4 Mat4RotationY(float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	Mat4 r = Mat4Identity();
+	r.m[0][0] = c; r.m[0][2] = -s;
+	r.m[2][0] = s; r.m[2][2] = c;
+	return r;
+}
+
+inline Mat4 Mat4RotationZ(float angle)
+{
+	float c = cosf(angle), s = sinf(angle);
+	Mat4 r = Mat4Identity();
+	r.m[0][0] = c;  r.m[0][1] = s;
+	r.m[1][0] = -s; r.m[1][1] = c;
+	return r;
+}
+
+//Left handed view matrix (same result as D3DXMatrixLookAtLH)
+inline Mat4 Mat4LookAtLH(const Vec3& eye, const Vec3& at, const Vec3& up)
+{
+	Vec3 zAxis = Vec3Normalize(at - eye);
+	Vec3 xAxis = Vec3Normalize(Vec3Cross(up, zAxis));
+	Vec3 yAxis = Vec3Cross(zAxis, xAxis);
+
+	Mat4 r = {{
+		{ xAxis.x, yAxis.x, zAxis.x, 0.0f },
+		{ xAxis.y, yAxis.y, zAxis.y, 0.0f },
+		{ xAxis.z, yAxis.z, zAxis.z, 0.0f },
+		{ -Vec3Dot(xAxis, eye), -Vec3Dot(yAxis, eye), -Vec3Dot(zAxis, eye), 1.0f }
+	}};
+	return r;
+}
+
+//Left handed perspective projection mapping z to [0, 1] (same result as D3DXMatrixPerspectiveFovLH)
+inline Mat4 Mat4PerspectiveFovLH(float fovY, float aspect, float zNear, float zFar)
+{
+	float yScale = 1.0f / tanf(fovY * 0.5f);
+	float xScale = yScale / aspect;
+	float zRange = zFar / (zFar - zNear);
+
+	Mat4 r = {{
+		{ xScale, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, yScale, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, zRange, 1.0f },
+		{ 0.0f, 0.0f, -zNear * zRange, 0.0f }
+	}};
+	return r;
+}
+
+//(x, y, z, 1) * m without the perspective divide
+inline Vec4 Vec3Transform(const Vec3& v, const Mat4& m)
+{
+	return Vec4(
+		v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + m.m[3][0],
+		v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + m.m[3][1],
+		v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + m.m[3][2],
+		v.x * m.m[0][3] + v.y * m.m[1][3] + v.z * m.m[2][3] + m.m[3][3]);
+}
+
+//(x, y, z, 1) * m projected back to w = 1 (D3DXVec3TransformCoord)
+inline Vec3 Vec3TransformCoord(const Vec3& v, const Mat4& m)
+{
+	Vec4 r = Vec3Transform(v, m);
+	float invW = 1.0f / r.w;
+	return Vec3(r.x * invW, r.y * invW, r.z * invW);
+}
+
+//(x, y, z, 0) * m, for directions
+inline Vec3 Vec3TransformNormal(const Vec3& v, const Mat4& m)
+{
+	return Vec3(
+		v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0],
+		v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1],
+		v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2]);
+}
+
+//-----------------------------------------------------------------------------
+//Quaternions (x, y, z, w in a Vec4)
+//-----------------------------------------------------------------------------
+
+inline Vec4 QuatIdentity()
+{
+	return Vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+//Rotation of angle radians around a normalized axis
+inline Vec4 QuatRotationAxis(const Vec3& axis, float angle)
+{
+	float s = sinf(angle * 0.5f);
+	return Vec4(axis.x * s, axis.y * s, axis.z * s, cosf(angle * 0.5f));
+}
+
+//Rotation matrix of a unit quaternion (same result as D3DXMatrixRotationQuaternion)
+inline Mat4 Mat4RotationQuat(const Vec4& q)
+{
+	float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+	float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+	float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+	Mat4 r = {{
+		{ 1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f },
+		{ 2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f },
+		{ 2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	}};
+	return r;
+}
+
+//-----------------------------------------------------------------------------
+//Batch transforms
+//-----------------------------------------------------------------------------
+
+//Reference implementation of TransformPositions
+inline void TransformPositionsScalar(const Mat4& m, const void* pIn, size_t inStride, void* pOut, size_t outStride, size_t count)
+{
+	const uint8_t* pSrc = (const uint8_t*)pIn;
+	uint8_t* pDst = (uint8_t*)pOut;
+	for(size_t i = 0; i < count; ++i, pSrc += inStride, pDst += outStride)
+	{
+		const float* v = (const float*)pSrc;
+		float x = v[0], y = v[1], z = v[2];
+		float* o = (float*)pDst;
+		o[0] = x * m.m[0][0] + y * m.m[1][0] + z * m.m[2][0] + m.m[3][0];
+		o[1] = x * m.m[0][1] + y * m.m[1][1] + z * m.m[2][1] + m.m[3][1];
+		o[2] = x * m.m[0][2] + y * m.m[1][2] + z * m.m[2][2] + m.m[3][2];
+	}
+}
+
+#ifdef SIMDMATH_SSE
+//Stores x, y, z of v without touching the fourth float (it may be a vertex color)
+inline void StoreFloat3(float* p, __m128 v)
+{
+	_mm_storel_pi((__m64*)p, v);
+	_mm_store_ss(p + 2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)));
+}
+#endif
+
+//Transforms the float3 position at the start of count strided elements as points
+//(w = 1, affine part only), e.g. the x, y, z of a vertex array. In place is allowed.
+inline void TransformPositions(const Mat4& m, const void* pIn, size_t inStride, void* pOut, size_t outStride, size_t count)
+{
+#ifdef SIMDMATH_SSE
+	const uint8_t* pSrc = (const uint8_t*)pIn;
+	uint8_t* pDst = (uint8_t*)pOut;
+	size_t i = 0;
+
+#ifdef SIMDMATH_AVX
+	//Two vertices per iteration, one in each 128 bit lane
+	__m256 r0 = _mm256_broadcast_ps((const __m128*)m.m[0]);
+	__m256 r1 = _mm256_broadcast_ps((const __m128*)m.m[1]);
+	__m256 r2 = _mm256_broadcast_ps((const __m128*)m.m[2]);
+	__m256 r3 = _mm256_broadcast_ps((const __m128*)m.m[3]);
+	for(; i + 2 <= count; i += 2, pSrc += 2 * inStride, pDst += 2 * outStride)
+	{
+		const float* v0 = (const float*)pSrc;
+		const float* v1 = (const float*)(pSrc + inStride);
+		__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v0[0])), _mm_set1_ps(v1[0]), 1);
+		__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v0[1])), _mm_set1_ps(v1[1]), 1);
+		__m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(v0[2])), _mm_set1_ps(v1[2]), 1);
+		__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, r0), _mm256_mul_ps(y, r1)),
+			_mm256_add_ps(_mm256_mul_ps(z, r2), r3));
+		StoreFloat3((float*)pDst, _mm256_castps256_ps128(r));
+		StoreFloat3((float*)(pDst + outStride), _mm256_extractf128_ps(r, 1));
+	}
+#endif
+
+	__m128 m0 = _mm_loadu_ps(m.m[0]);
+	__m128 m1 = _mm_loadu_ps(m.m[1]);
+	__m128 m2 = _mm_loadu_ps(m.m[2]);
+	__m128 m3 = _mm_loadu_ps(m.m[3]);
+	for(; i < count; ++i, pSrc += inStride, pDst += outStride)
+	{
+		const float* v = (const float*)pSrc;
+		__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v[0]), m0), _mm_mul_ps(_mm_set1_ps(v[1]), m1)),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v[2]), m2), m3));
+		StoreFloat3((float*)pDst, r);
+	}
+#else
+	TransformPositionsScalar(m, pIn, inStride, pOut, outStride, count);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//Frustum
+//-----------------------------------------------------------------------------
+
+inline Plane PlaneNormalize(const Plane& p)
+{
+	float length = sqrtf(p.a * p.a + p.b * p.b + p.c * p.c);
+	float inv = length > 0.0f ? 1.0f / length : 0.0f;
+	Plane r = { p.a * inv, p.b * inv, p.c * inv, p.d * inv };
+	return r;
+}
+
+//Extracts the frustum of a view * projection matrix (D3D clip space, 0 <= z <= w)
+inline Frustum FrustumFromMatrix(const Mat4& viewProj)
+{
+	const float (*m)[4] = viewProj.m;
+	Plane planes[Frustum::PLANE_COUNT] =
+	{
+		{ m[0][3] + m[0][0], m[1][3] + m[1][0], m[2][3] + m[2][0], m[3][3] + m[3][0] },	//Left
+		{ m[0][3] - m[0][0], m[1][3] - m[1][0], m[2][3] - m[2][0], m[3][3] - m[3][0] },	//Right
+		{ m[0][3] + m[0][1], m[1][3] + m[1][1], m[2][3] + m[2][1], m[3][3] + m[3][1] },	//Bottom
+		{ m[0][3] - m[0][1], m[1][3] - m[1][1], m[2][3] - m[2][1], m[3][3] - m[3][1] },	//Top
+		{ m[0][2], m[1][2], m[2][2], m[3][2] },											//Near
+		{ m[0][3] - m[0][2], m[1][3] - m[1][2], m[2][3] - m[2][2], m[3][3] - m[3][2] }	//Far
+	};
+
+	Frustum f;
+	for(int i = 0; i < 8; ++i)
+	{
+		if(i < Frustum::PLANE_COUNT)
+		{
+			f.Planes[i] = PlaneNormalize(planes[i]);
+			f.A[i] = f.Planes[i].a;
+			f.B[i] = f.Planes[i].b;
+			f.C[i] = f.Planes[i].c;
+			f.D[i] = f.Planes[i].d;
+		}
+		else
+		{
+			//Everything is in front of a zero normal plane with d = 1
+			f.A[i] = f.B[i] = f.C[i] = 0.0f;
+			f.D[i] = 1.0f;
+		}
+	}
+	return f;
+}
+
+inline bool FrustumTestSphere(const Frustum& f, const Vec3& center, float radius)
+{
+	for(int i = 0; i < Frustum::PLANE_COUNT; ++i)
+	{
+		const Plane& p = f.Planes[i];
+		if(p.a * center.x + p.b * center.y + p.c * center.z + p.d < -radius)
+			return false;
+	}
+	return true;
+}
+
+//False if the box is completely outside one plane (conservative: boxes near
+//frustum corners may pass). A box is outside a plane when its center distance
+//plus its extent projected on the normal is negative.
+inline bool FrustumTestAABB(const Frustum& f, const AABB& box)
+{
+	float cx = (box.Min.x + box.Max.x) * 0.5f, ex = (box.Max.x - box.Min.x) * 0.5f;
+	float cy = (box.Min.y + box.Max.y) * 0.5f, ey = (box.Max.y - box.Min.y) * 0.5f;
+	float cz = (box.Min.z + box.Max.z) * 0.5f, ez = (box.Max.z - box.Min.z) * 0.5f;
+
+#if defined(SIMDMATH_AVX)
+	__m256 a = _mm256_loadu_ps(f.A), b = _mm256_loadu_ps(f.B), c = _mm256_loadu_ps(f.C);
+	__m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+	__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, _mm256_set1_ps(cx)), _mm256_mul_ps(b, _mm256_set1_ps(cy))),
+		_mm256_add_ps(_mm256_mul_ps(c, _mm256_set1_ps(cz)), _mm256_loadu_ps(f.D)));
+	__m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_and_ps(a, absMask), _mm256_set1_ps(ex)),
+		_mm256_mul_ps(_mm256_and_ps(b, absMask), _mm256_set1_ps(ey))), _mm256_mul_ps(_mm256_and_ps(c, absMask), _mm256_set1_ps(ez)));
+	return _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(dist, radius), _mm256_setzero_ps(), _CMP_LT_OQ)) == 0;
+#elif defined(SIMDMATH_SSE)
+	__m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	int outside = 0;
+	for(int i = 0; i < 8; i += 4)
+	{
+		__m128 a = _mm_loadu_ps(f.A + i), b = _mm_loadu_ps(f.B + i), c = _mm_loadu_ps(f.C + i);
+		__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(cx)), _mm_mul_ps(b, _mm_set1_ps(cy))),
+			_mm_add_ps(_mm_mul_ps(c, _mm_set1_ps(cz)), _mm_loadu_ps(f.D + i)));
+		__m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_and_ps(a, absMask), _mm_set1_ps(ex)),
+			_mm_mul_ps(_mm_and_ps(b, absMask), _mm_set1_ps(ey))), _mm_mul_ps(_mm_and_ps(c, absMask), _mm_set1_ps(ez)));
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(dist, radius), _mm_setzero_ps()));
+	}
+	return outside == 0;
+#else
+	for(int i = 0; i < Frustum::PLANE_COUNT; ++i)
+	{
+		const Plane& p = f.Planes[i];
+		float dist = p.a * cx + p.b * cy + p.c * cz + p.d;
+		float radius = fabsf(p.a) * ex + fabsf(p.b) * ey + fabsf(p.c) * ez;
+		if(dist + radius < 0.0f)
+			return false;
+	}
+	return true;
+#endif
+}
+
+//Tests count boxes, pVisible[i] = 1 if box i may be visible
+inline void FrustumTestAABBs(const Frustum& f, const AABB* pBoxes, size_t count, uint8_t* pVisible)
+{
+	for(size_t i = 0; i < count; ++i)
+		pVisible[i] = FrustumTestAABB(f, pBoxes[i]) ? 1 : 0;
+}
+
+//Tests count spheres stored as SoA, pVisible[i] = 1 if sphere i may be visible
+inline void FrustumTestSpheres(const Frustum& f, const float* pX, const float* pY, const float* pZ, const float* pRadius,
+	size_t count, uint8_t* pVisible)
+{
+	size_t i = 0;
+#if defined(SIMDMATH_AVX)
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(pX + i), y = _mm256_loadu_ps(pY + i), z = _mm256_loadu_ps(pZ + i);
+		__m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(pRadius + i));
+		__m256 outside = _mm256_setzero_ps();
+		for(int p = 0; p < Frustum::PLANE_COUNT; ++p)
+		{
+			__m256 dist = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(f.A[p])), _mm256_mul_ps(y, _mm256_set1_ps(f.B[p]))),
+				_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(f.C[p])), _mm256_set1_ps(f.D[p])));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(dist, negRadius, _CMP_LT_OQ));
+		}
+		int mask = _mm256_movemask_ps(outside);
+		for(int lane = 0; lane < 8; ++lane)
+			pVisible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+	}
+#endif
+#if defined(SIMDMATH_SSE)
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(pX + i), y = _mm_loadu_ps(pY + i), z = _mm_loadu_ps(pZ + i);
+		__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(pRadius + i));
+		__m128 outside = _mm_setzero_ps();
+		for(int p = 0; p < Frustum::PLANE_COUNT; ++p)
+		{
+			__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(f.A[p])), _mm_mul_ps(y, _mm_set1_ps(f.B[p]))),
+				_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(f.C[p])), _mm_set1_ps(f.D[p])));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, negRadius));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for(int lane = 0; lane < 4; ++lane)
+			pVisible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+	}
+#endif
+	for(; i < count; ++i)
+		pVisible[i] = FrustumTestSphere(f, Vec3(pX[i], pY[i], pZ[i]), pRadius[i]) ? 1 : 0;
+}
+
+enum FrustumClass
+{
+	FRUSTUM_OUTSIDE,		//Completely outside a plane
+	FRUSTUM_INTERSECTS,		//May cross the frustum boundary
+	FRUSTUM_INSIDE			//Completely in front of every plane
+};
+
+//Classifies a box for hierarchical culling: boxes inside an inside box are
+//inside as well, so their tests can be skipped
+inline FrustumClass FrustumClassifyAABB(const Frustum& f, const AABB& box)
+{
+	float cx = (box.Min.x + box.Max.x) * 0.5f, ex = (box.Max.x - box.Min.x) * 0.5f;
+	float cy = (box.Min.y + box.Max.y) * 0.5f, ey = (box.Max.y - box.Min.y) * 0.5f;
+	float cz = (box.Min.z + box.Max.z) * 0.5f, ez = (box.Max.z - box.Min.z) * 0.5f;
+
+	FrustumClass result = FRUSTUM_INSIDE;
+	for(int i = 0; i < Frustum::PLANE_COUNT; ++i)
+	{
+		const Plane& p = f.Planes[i];
+		float dist = p.a * cx + p.b * cy + p.c * cz + p.d;
+		float radius = fabsf(p.a) * ex + fabsf(p.b) * ey + fabsf(p.c) * ez;
+		if(dist + radius < 0.0f)
+			return FRUSTUM_OUTSIDE;
+		if(dist - radius < 0.0f)
+			result = FRUSTUM_INTERSECTS;
+	}
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//Random numbers
+//-----------------------------------------------------------------------------
+
+//Linear congruential generator for reproducible test data and effects, returns
+//the next 24 random bits of seed
+inline uint32_t RandomBits(uint32_t& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return seed >> 8;
+}
+
+//0 .. 1 (exclusive)
+inline float RandomFloat(uint32_t& seed)
+{
+	return RandomBits(seed) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,1177 @@
+#include "SoftwareRenderDevice.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+//SSE2 is available on every x64 target and on x86 builds using /arch:SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RD_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	//Tiles are TILE_SIZE x TILE_SIZE pixels, a multiple of the 4 pixel SIMD width
+	const unsigned TILE_SIZE = 64;
+	const float DEPTH_SCALE = 16777215.0f; //2^24 - 1, D24 depth range
+
+	//Reserved up front so frames up to this size never grow the per frame
+	//storage (e.g. 16k particle quads in one draw)
+	const unsigned RESERVED_TRIANGLES = 32768;
+	const unsigned RESERVED_VERTICES = 65536;
+	const unsigned RESERVED_BIN_TRIANGLES = 2048;	//Per tile
+
+	//System memory vertex buffer
+	class SoftwareVertexBuffer : public IVertexBuffer
+	{
+	public:
+		SoftwareVertexBuffer(unsigned size, RDPool pool) : m_Data(size), m_Pool(pool) {}
+
+		bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD /*flags*/) override
+		{
+			//Vertices are transformed when drawn, so DISCARD and NOOVERWRITE never stall
+			if(offset + size > m_Data.size() || m_Data.empty())
+				return false;
+			*ppData = &m_Data[offset];
+			return true;
+		}
+		void Unlock() override {}
+		void Release() override { delete this; }
+		unsigned GetSize() const override { return (unsigned)m_Data.size(); }
+		RDPool GetPool() const override { return m_Pool; }
+
+		std::vector<uint8_t> m_Data;
+
+	private:
+		RDPool m_Pool;
+	};
+
+	//Copy of the back buffer
+	class SoftwareReadbackSurface : public IReadbackSurface
+	{
+	public:
+		SoftwareReadbackSurface(unsigned width, unsigned height)
+			: m_Pixels((size_t)width * height), m_Width(width), m_Height(height) {}
+
+		bool Lock(const RDCOLOR** ppPixels, unsigned* pPitch) override
+		{
+			*ppPixels = &m_Pixels[0];
+			*pPitch = m_Width;
+			return true;
+		}
+		void Unlock() override {}
+		void Release() override { delete this; }
+		unsigned GetWidth() const override { return m_Width; }
+		unsigned GetHeight() const override { return m_Height; }
+
+		std::vector<RDCOLOR> m_Pixels;
+
+	private:
+		unsigned m_Width;
+		unsigned m_Height;
+	};
+
+	//System memory index buffer
+	class SoftwareIndexBuffer : public IIndexBuffer
+	{
+	public:
+		SoftwareIndexBuffer(unsigned size, RDIndexFormat format, RDPool pool)
+			: m_Data(size), m_Format(format), m_Pool(pool) {}
+
+		bool Lock(unsigned offset, unsigned size, void** ppData, RDWORD /*flags*/) override
+		{
+			if(offset + size > m_Data.size() || m_Data.empty())
+				return false;
+			*ppData = &m_Data[offset];
+			return true;
+		}
+		void Unlock() override {}
+		void Release() override { delete this; }
+		unsigned GetSize() const override { return (unsigned)m_Data.size(); }
+		RDPool GetPool() const override { return m_Pool; }
+		RDIndexFormat GetFormat() const override { return m_Format; }
+
+		std::vector<uint8_t> m_Data;
+
+	private:
+		RDIndexFormat m_Format;
+		RDPool m_Pool;
+	};
+
+	//System memory texture
+	class SoftwareTexture : public ITexture
+	{
+	public:
+		SoftwareTexture(unsigned width, unsigned height)
+			: m_Pixels((size_t)width * height), m_Width(width), m_Height(height) {}
+
+		bool Update(unsigned x, unsigned y, unsigned width, unsigned height, const RDCOLOR* pPixels, unsigned pitch) override
+		{
+			if(!pPixels || x + width > m_Width || y + height > m_Height || pitch < width)
+				return false;
+			for(unsigned row = 0; row < height; ++row)
+				memcpy(&m_Pixels[(size_t)(y + row) * m_Width + x], pPixels + (size_t)row * pitch, width * sizeof(RDCOLOR));
+			return true;
+		}
+		void Release() override { delete this; }
+		unsigned GetWidth() const override { return m_Width; }
+		unsigned GetHeight() const override { return m_Height; }
+
+		std::vector<RDCOLOR> m_Pixels;
+
+	private:
+		unsigned m_Width;
+		unsigned m_Height;
+	};
+
+	//Attribute of a vertex declaration
+	struct DeclAttribute
+	{
+		int			Stream;		//-1 if the declaration does not have it
+		unsigned	Offset;
+	};
+
+	//Declaration reduced to the attributes the rasterizer reads
+	class SoftwareVertexDeclaration : public IVertexDeclaration
+	{
+	public:
+		void Release() override { delete this; }
+
+		DeclAttribute	m_Position;
+		bool			m_Pretransformed;
+		DeclAttribute	m_Color;
+		DeclAttribute	m_World[4];			//Instance matrix rows, all present or none
+		DeclAttribute	m_InstanceColor;
+	};
+
+	void MatrixIdentity(float* m)
+	{
+		memset(m, 0, 16 * sizeof(float));
+		m[0] = m[5] = m[10] = m[15] = 1.0f;
+	}
+
+	//out = a * b (row major, row vectors, same convention as D3DXMatrixMultiply)
+	void MatrixMultiply(float* out, const float* a, const float* b)
+	{
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				out[r * 4 + c] = a[r * 4 + 0] * b[0 * 4 + c] + a[r * 4 + 1] * b[1 * 4 + c] +
+					a[r * 4 + 2] * b[2 * 4 + c] + a[r * 4 + 3] * b[3 * 4 + c];
+			}
+		}
+	}
+
+	//Computes the plane a*x + b*y + c through three attribute values
+	void SetupPlane(float* plane, const float* sx, const float* sy, float v0, float v1, float v2, float invArea)
+	{
+		float dx1 = sx[1] - sx[0], dy1 = sy[1] - sy[0];
+		float dx2 = sx[2] - sx[0], dy2 = sy[2] - sy[0];
+		plane[0] = ((v1 - v0) * dy2 - (v2 - v0) * dy1) * invArea;
+		plane[1] = ((v2 - v0) * dx1 - (v1 - v0) * dx2) * invArea;
+		plane[2] = v0 - plane[0] * sx[0] - plane[1] * sy[0];
+	}
+
+	//Linear interpolation between two clip space vertices
+	SoftwareRenderDevice::ClipVertex Lerp(const SoftwareRenderDevice::ClipVertex& a,
+		const SoftwareRenderDevice::ClipVertex& b, float t)
+	{
+		SoftwareRenderDevice::ClipVertex v;
+		v.x = a.x + (b.x - a.x) * t;
+		v.y = a.y + (b.y - a.y) * t;
+		v.z = a.z + (b.z - a.z) * t;
+		v.w = a.w + (b.w - a.w) * t;
+		v.r = a.r + (b.r - a.r) * t;
+		v.g = a.g + (b.g - a.g) * t;
+		v.b = a.b + (b.b - a.b) * t;
+		v.a = a.a + (b.a - a.a) * t;
+		return v;
+	}
+
+	//Clips a polygon against the plane dist(v) >= 0, returns the new vertex count
+	template<typename DistFunc>
+	int ClipPolygon(const SoftwareRenderDevice::ClipVertex* in, int count, SoftwareRenderDevice::ClipVertex* out, DistFunc dist)
+	{
+		int outCount = 0;
+		for(int i = 0; i < count; ++i)
+		{
+			const SoftwareRenderDevice::ClipVertex& a = in[i];
+			const SoftwareRenderDevice::ClipVertex& b = in[(i + 1) % count];
+			float da = dist(a);
+			float db = dist(b);
+			if(da >= 0)
+				out[outCount++] = a;
+			if((da >= 0) != (db >= 0))
+				out[outCount++] = Lerp(a, b, da / (da - db));
+		}
+		return outCount;
+	}
+
+	float NearDistance(const SoftwareRenderDevice::ClipVertex& v) { return v.z; }
+	float FarDistance(const SoftwareRenderDevice::ClipVertex& v) { return v.w - v.z; }
+
+#ifndef RD_USE_SSE2
+	//Scalar depth comparison
+	bool DepthTest(RDWORD func, uint32_t z, uint32_t stored)
+	{
+		switch(func)
+		{
+		case RD_CMP_NEVER: return false;
+		case RD_CMP_LESS: return z < stored;
+		case RD_CMP_EQUAL: return z == stored;
+		case RD_CMP_LESSEQUAL: return z <= stored;
+		case RD_CMP_GREATER: return z > stored;
+		case RD_CMP_NOTEQUAL: return z != stored;
+		case RD_CMP_GREATEREQUAL: return z >= stored;
+		default: return true;
+		}
+	}
+#else
+	//4 wide depth comparison, returns a lane mask
+	__m128i DepthTest4(RDWORD func, __m128i z, __m128i stored)
+	{
+		const __m128i ones = _mm_set1_epi32(-1);
+		switch(func)
+		{
+		case RD_CMP_NEVER: return _mm_setzero_si128();
+		case RD_CMP_LESS: return _mm_cmplt_epi32(z, stored);
+		case RD_CMP_EQUAL: return _mm_cmpeq_epi32(z, stored);
+		case RD_CMP_LESSEQUAL: return _mm_andnot_si128(_mm_cmpgt_epi32(z, stored), ones);
+		case RD_CMP_GREATER: return _mm_cmpgt_epi32(z, stored);
+		case RD_CMP_NOTEQUAL: return _mm_andnot_si128(_mm_cmpeq_epi32(z, stored), ones);
+		case RD_CMP_GREATEREQUAL: return _mm_andnot_si128(_mm_cmplt_epi32(z, stored), ones);
+		default: return ones;
+		}
+	}
+
+	//Edge inside test with the top-left fill rule
+	__m128 EdgeMask(__m128 e, bool topLeft)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		return topLeft ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+	}
+#endif
+}
+
+SoftwareRenderDevice::SoftwareRenderDevice(unsigned width, unsigned height, unsigned numThreads)
+{
+	m_Width = 0;
+	m_Height = 0;
+	m_Pitch = 0;
+	m_TilesX = 0;
+	m_TilesY = 0;
+
+	MatrixIdentity(m_World);
+	MatrixIdentity(m_View);
+	MatrixIdentity(m_Proj);
+	MatrixIdentity(m_ViewProj);
+	MatrixIdentity(m_WorldViewProj);
+	m_WVPDirty = false;
+
+	//Direct3D 9 default render states
+	memset(m_RenderStates, 0, sizeof(m_RenderStates));
+	m_RenderStates[RD_RS_ZENABLE] = 1;
+	m_RenderStates[RD_RS_ZWRITEENABLE] = 1;
+	m_RenderStates[RD_RS_ZFUNC] = RD_CMP_LESSEQUAL;
+	m_RenderStates[RD_RS_SHADEMODE] = RD_SHADE_GOURAUD;
+	m_RenderStates[RD_RS_CULLMODE] = RD_CULL_CCW;
+	m_RenderStates[RD_RS_LIGHTING] = 1;
+
+	for(int i = 0; i < MAX_STREAMS; ++i)
+	{
+		m_Streams[i].pVB = NULL;
+		m_Streams[i].Offset = 0;
+		m_Streams[i].Stride = 0;
+		m_Streams[i].Freq = 1;
+	}
+	m_pIndices = NULL;
+	m_FVF = 0;
+	m_pDecl = NULL;
+
+	m_Triangles.reserve(RESERVED_TRIANGLES);
+	m_ClipVertices.reserve(RESERVED_VERTICES);
+	m_IndexScratch.reserve(RESERVED_TRIANGLES * 3);
+
+	m_ClearFlags = 0;
+	m_ClearColor = 0;
+	m_ClearDepth = 0;
+
+	m_PresentCallback = NULL;
+	m_pPresentContext = NULL;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+
+	Resize(width, height);
+
+	//The calling thread always takes part, so spawn one less worker
+	if(numThreads == 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	m_JobGeneration = 0;
+	m_WorkersBusy = 0;
+	m_Quit = false;
+	m_CurrentJob = TILEJOB_RASTERIZE;
+	m_NextTile = 0;
+	for(unsigned i = 1; i < numThreads; ++i)
+		m_Workers.push_back(std::thread(&SoftwareRenderDevice::WorkerMain, this));
+}
+
+SoftwareRenderDevice::~SoftwareRenderDevice()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_JobMutex);
+		m_Quit = true;
+	}
+	m_JobStart.notify_all();
+	for(size_t i = 0; i < m_Workers.size(); ++i)
+		m_Workers[i].join();
+}
+
+void SoftwareRenderDevice::Resize(unsigned width, unsigned height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Pitch = (width + 3) & ~3u;
+	m_ColorBuffer.assign(m_Pitch * height + 4, 0);
+	m_DepthBuffer.assign(m_Pitch * height + 4, 0xFFFFFF);
+
+	m_TilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	m_TilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	m_TileBins.clear();
+	m_TileBins.resize(m_TilesX * m_TilesY);
+	for(size_t i = 0; i < m_TileBins.size(); ++i)
+		m_TileBins[i].reserve(RESERVED_BIN_TRIANGLES);
+	m_Triangles.clear();
+
+	m_Viewport.X = 0;
+	m_Viewport.Y = 0;
+	m_Viewport.Width = width;
+	m_Viewport.Height = height;
+	m_Viewport.MinZ = 0.0f;
+	m_Viewport.MaxZ = 1.0f;
+}
+
+bool SoftwareRenderDevice::CreateVertexBuffer(unsigned length, RDWORD /*usage*/, RDWORD /*fvf*/, RDPool pool, IVertexBuffer** ppVB)
+{
+	if(length == 0 || !ppVB)
+		return false;
+	*ppVB = new SoftwareVertexBuffer(length, pool);
+	return true;
+}
+
+bool SoftwareRenderDevice::CreateIndexBuffer(unsigned length, RDWORD /*usage*/, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB)
+{
+	if(length == 0 || !ppIB)
+		return false;
+	*ppIB = new SoftwareIndexBuffer(length, format, pool);
+	return true;
+}
+
+bool SoftwareRenderDevice::CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl)
+{
+	if(!pElements || !ppDecl)
+		return false;
+
+	DeclAttribute missing = { -1, 0 };
+	SoftwareVertexDeclaration decl;
+	decl.m_Position = missing;
+	decl.m_Pretransformed = false;
+	decl.m_Color = missing;
+	for(int i = 0; i < 4; ++i)
+		decl.m_World[i] = missing;
+	decl.m_InstanceColor = missing;
+
+	//Other attributes (normals, texture coordinates) are skipped like the FVF ones
+	for(const RDVertexElement* pElement = pElements; pElement->Stream != 0xFF; ++pElement)
+	{
+		if(pElement->Stream >= MAX_STREAMS)
+			return false;
+		DeclAttribute attribute = { (int)pElement->Stream, pElement->Offset };
+		unsigned worldRow = pElement->UsageIndex - RD_INSTANCE_WORLD_INDEX;
+
+		if(pElement->Usage == RD_DECLUSAGE_POSITION || pElement->Usage == RD_DECLUSAGE_POSITIONT)
+		{
+			decl.m_Pretransformed = pElement->Usage == RD_DECLUSAGE_POSITIONT;
+			if(pElement->Type != (decl.m_Pretransformed ? RD_DECLTYPE_FLOAT4 : RD_DECLTYPE_FLOAT3))
+				return false;
+			decl.m_Position = attribute;
+		}
+		else if(pElement->Usage == RD_DECLUSAGE_COLOR && pElement->Type == RD_DECLTYPE_D3DCOLOR)
+		{
+			if(pElement->UsageIndex == 0)
+				decl.m_Color = attribute;
+			else if(pElement->UsageIndex == RD_INSTANCE_COLOR_INDEX)
+				decl.m_InstanceColor = attribute;
+		}
+		else if(pElement->Usage == RD_DECLUSAGE_TEXCOORD && worldRow < 4)
+		{
+			if(pElement->Type != RD_DECLTYPE_FLOAT3)
+				return false;
+			decl.m_World[worldRow] = attribute;
+		}
+	}
+
+	int worldRows = 0;
+	for(int i = 0; i < 4; ++i)
+		worldRows += decl.m_World[i].Stream >= 0;
+	if(decl.m_Position.Stream < 0 || (worldRows != 0 && worldRows != 4))
+		return false;
+
+	*ppDecl = new SoftwareVertexDeclaration(decl);
+	return true;
+}
+
+bool SoftwareRenderDevice::CreateTexture(unsigned width, unsigned height, ITexture** ppTexture)
+{
+	if(width == 0 || height == 0 || width > GetMaxTextureSize() || height > GetMaxTextureSize() || !ppTexture)
+		return false;
+	*ppTexture = new SoftwareTexture(width, height);
+	return true;
+}
+
+void SoftwareRenderDevice::SetViewport(const RDViewport& viewport)
+{
+	m_Viewport = viewport;
+}
+
+void SoftwareRenderDevice::SetTransform(RDTransformType type, const float* matrix)
+{
+	switch(type)
+	{
+	case RD_TS_WORLD: memcpy(m_World, matrix, sizeof(m_World)); break;
+	case RD_TS_VIEW: memcpy(m_View, matrix, sizeof(m_View)); break;
+	case RD_TS_PROJECTION: memcpy(m_Proj, matrix, sizeof(m_Proj)); break;
+	default: return;
+	}
+	m_WVPDirty = true;
+}
+
+void SoftwareRenderDevice::SetRenderState(RDRenderState state, RDWORD value)
+{
+	//NOTE: lighting and alpha blending are stored but not emulated, vertex colors are used as is
+	if(state < RD_RS_MAX)
+		m_RenderStates[state] = value;
+}
+
+void SoftwareRenderDevice::SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride)
+{
+	if(stream >= MAX_STREAMS)
+		return;
+	m_Streams[stream].pVB = pVB;
+	m_Streams[stream].Offset = offset;
+	m_Streams[stream].Stride = stride;
+}
+
+void SoftwareRenderDevice::SetStreamSourceFreq(unsigned stream, RDWORD setting)
+{
+	if(stream < MAX_STREAMS)
+		m_Streams[stream].Freq = setting;
+}
+
+void SoftwareRenderDevice::SetIndices(IIndexBuffer* pIB)
+{
+	m_pIndices = pIB;
+}
+
+void SoftwareRenderDevice::SetFVF(RDWORD fvf)
+{
+	m_FVF = fvf;
+	m_pDecl = NULL;
+}
+
+void SoftwareRenderDevice::SetVertexDeclaration(IVertexDeclaration* pDecl)
+{
+	m_pDecl = pDecl;
+}
+
+void SoftwareRenderDevice::Clear(RDWORD flags, RDCOLOR color, float z, RDWORD /*stencil*/)
+{
+	//Anything drawn before the clear must land first
+	Flush();
+
+	m_ClearFlags = flags;
+	m_ClearColor = color;
+	m_ClearDepth = (uint32_t)(std::min(std::max(z, 0.0f), 1.0f) * DEPTH_SCALE);
+	RunTileJob(TILEJOB_CLEAR);
+}
+
+void SoftwareRenderDevice::BeginScene()
+{
+}
+
+void SoftwareRenderDevice::EndScene()
+{
+	Flush();
+}
+
+void SoftwareRenderDevice::DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount)
+{
+	if(primCount == 0)
+		return;
+
+	unsigned numVertices = 0;
+	switch(type)
+	{
+	case RD_PT_TRIANGLELIST: numVertices = primCount * 3; break;
+	case RD_PT_TRIANGLESTRIP:
+	case RD_PT_TRIANGLEFAN: numVertices = primCount + 2; break;
+	default: return; //Points and lines are not rasterized
+	}
+
+	//Instancing needs indexed draws, per instance attributes come from the first instance
+	UpdateTransforms();
+	VertexInput input;
+	float worldViewProj[16];
+	if(!GetVertexInput(startVertex, numVertices, &input) || !GetInstance(0, worldViewProj, &input.InstanceColor))
+		return;
+
+	++m_Stats.DrawCalls;
+	ProcessVertices(input, numVertices, worldViewProj);
+	DrawTriangles(type, primCount, NULL);
+}
+
+void SoftwareRenderDevice::DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+	unsigned numVertices, unsigned startIndex, unsigned primCount)
+{
+	if(!m_pIndices || primCount == 0 || numVertices == 0)
+		return;
+
+	unsigned numIndices = 0;
+	switch(type)
+	{
+	case RD_PT_TRIANGLELIST: numIndices = primCount * 3; break;
+	case RD_PT_TRIANGLESTRIP:
+	case RD_PT_TRIANGLEFAN: numIndices = primCount + 2; break;
+	default: return;
+	}
+
+	//Transform only the referenced vertex range
+	UpdateTransforms();
+	long long first = (long long)baseVertexIndex + minIndex;
+	VertexInput input;
+	if(first < 0 || first > 0xFFFFFFFF || !GetVertexInput((unsigned)first, numVertices, &input))
+		return;
+
+	//Rebase indices into the processed range
+	SoftwareIndexBuffer* pIB = static_cast<SoftwareIndexBuffer*>(m_pIndices);
+	bool is32 = pIB->GetFormat() == RD_FMT_INDEX32;
+	size_t indexSize = is32 ? 4 : 2;
+	if(((size_t)startIndex + numIndices) * indexSize > pIB->m_Data.size())
+		return;
+
+	m_IndexScratch.resize(numIndices);
+	const uint8_t* pSrc = &pIB->m_Data[startIndex * indexSize];
+	for(unsigned i = 0; i < numIndices; ++i)
+	{
+		uint32_t index = is32 ? ((const uint32_t*)pSrc)[i] : ((const uint16_t*)pSrc)[i];
+		//Out of range indices become invalid and their triangles are dropped
+		m_IndexScratch[i] = index >= minIndex ? index - minIndex : 0xFFFFFFFF;
+	}
+
+	++m_Stats.DrawCalls;
+
+	//Every instance is a copy of the vertex range with its own world matrix
+	RDWORD freq = m_Streams[0].Freq;
+	unsigned instances = (freq & RD_STREAMSOURCE_INDEXEDDATA) ? std::max(freq & RD_STREAMSOURCE_COUNT_MASK, 1u) : 1;
+	for(unsigned instance = 0; instance < instances; ++instance)
+	{
+		float worldViewProj[16];
+		if(!GetInstance(instance, worldViewProj, &input.InstanceColor))
+			return;
+		ProcessVertices(input, numVertices, worldViewProj);
+		DrawTriangles(type, primCount, &m_IndexScratch[0]);
+	}
+}
+
+void SoftwareRenderDevice::Present()
+{
+	Flush();
+
+	if(m_PresentCallback)
+		m_PresentCallback(m_pPresentContext, &m_ColorBuffer[0], m_Width, m_Height, m_Pitch);
+
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+bool SoftwareRenderDevice::CreateReadbackSurface(IReadbackSurface** ppSurface)
+{
+	if(!ppSurface || m_Width == 0 || m_Height == 0)
+		return false;
+	*ppSurface = new SoftwareReadbackSurface(m_Width, m_Height);
+	return true;
+}
+
+bool SoftwareRenderDevice::CopyBackBuffer(IReadbackSurface* pSurface)
+{
+	if(!pSurface || pSurface->GetWidth() != m_Width || pSurface->GetHeight() != m_Height)
+		return false;
+	Flush();
+
+	//The back buffer rows are padded to whole tiles
+	SoftwareReadbackSurface* pCopy = static_cast<SoftwareReadbackSurface*>(pSurface);
+	for(unsigned y = 0; y < m_Height; ++y)
+		memcpy(&pCopy->m_Pixels[(size_t)y * m_Width], &m_ColorBuffer[(size_t)y * m_Pitch], m_Width * sizeof(RDCOLOR));
+	return true;
+}
+
+bool SoftwareRenderDevice::Reset(const RDPresentParams& params)
+{
+	Flush();
+	Resize(params.BackBufferWidth, params.BackBufferHeight);
+	return true;
+}
+
+void SoftwareRenderDevice::SetPresentCallback(RDPresentCallback callback, void* pContext)
+{
+	m_PresentCallback = callback;
+	m_pPresentContext = pContext;
+}
+
+void SoftwareRenderDevice::UpdateTransforms()
+{
+	if(!m_WVPDirty)
+		return;
+	MatrixMultiply(m_ViewProj, m_View, m_Proj);
+	MatrixMultiply(m_WorldViewProj, m_World, m_ViewProj);
+	m_WVPDirty = false;
+}
+
+const uint8_t* SoftwareRenderDevice::GetVertexData(int stream, unsigned offset, unsigned size, unsigned first, unsigned count) const
+{
+	const StreamSource& source = m_Streams[stream];
+	if(!source.pVB || source.Stride == 0 || count == 0)
+		return NULL;
+
+	const std::vector<uint8_t>& data = static_cast<const SoftwareVertexBuffer*>(source.pVB)->m_Data;
+	size_t start = source.Offset + (size_t)first * source.Stride + offset;
+	if(start + (size_t)(count - 1) * source.Stride + size > data.size())
+		return NULL;
+	return &data[start];
+}
+
+bool SoftwareRenderDevice::GetVertexInput(unsigned first, unsigned count, VertexInput* pInput) const
+{
+	pInput->pColor = NULL;
+	pInput->ColorStride = 0;
+	pInput->InstanceColor = 0xFFFFFFFF;
+
+	const SoftwareVertexDeclaration* pDecl = static_cast<const SoftwareVertexDeclaration*>(m_pDecl);
+	if(pDecl)
+	{
+		pInput->Pretransformed = pDecl->m_Pretransformed;
+		pInput->pPosition = GetVertexData(pDecl->m_Position.Stream, pDecl->m_Position.Offset,
+			pInput->Pretransformed ? 16 : 12, first, count);
+		pInput->PositionStride = m_Streams[pDecl->m_Position.Stream].Stride;
+		if(pDecl->m_Color.Stream >= 0)
+		{
+			pInput->pColor = GetVertexData(pDecl->m_Color.Stream, pDecl->m_Color.Offset, sizeof(RDCOLOR), first, count);
+			pInput->ColorStride = m_Streams[pDecl->m_Color.Stream].Stride;
+			if(!pInput->pColor)
+				return false;
+		}
+		return pInput->pPosition != NULL;
+	}
+
+	//Attribute offsets from the FVF, all in stream 0
+	pInput->Pretransformed = (m_FVF & RD_FVF_POSITION_MASK) == RD_FVF_XYZRHW;
+	unsigned colorOffset = pInput->Pretransformed ? 16 : 12;
+	if(m_FVF & RD_FVF_NORMAL)
+		colorOffset += 12;
+
+	pInput->pPosition = GetVertexData(0, 0, colorOffset, first, count);
+	pInput->PositionStride = m_Streams[0].Stride;
+	if(!pInput->pPosition)
+		return false;
+	if(m_FVF & RD_FVF_DIFFUSE)
+	{
+		pInput->pColor = GetVertexData(0, colorOffset, sizeof(RDCOLOR), first, count);
+		pInput->ColorStride = m_Streams[0].Stride;
+	}
+	return !(m_FVF & RD_FVF_DIFFUSE) || pInput->pColor;
+}
+
+bool SoftwareRenderDevice::GetInstance(unsigned instance, float* pWorldViewProj, RDCOLOR* pColor) const
+{
+	memcpy(pWorldViewProj, m_WorldViewProj, sizeof(m_WorldViewProj));
+	*pColor = 0xFFFFFFFF;
+
+	const SoftwareVertexDeclaration* pDecl = static_cast<const SoftwareVertexDeclaration*>(m_pDecl);
+	if(!pDecl)
+		return true;
+
+	if(pDecl->m_World[0].Stream >= 0)
+	{
+		//The instance matrix replaces RD_TS_WORLD
+		float world[16];
+		MatrixIdentity(world);
+		for(int row = 0; row < 4; ++row)
+		{
+			const uint8_t* pRow = GetVertexData(pDecl->m_World[row].Stream, pDecl->m_World[row].Offset, 3 * sizeof(float), instance, 1);
+			if(!pRow)
+				return false;
+			memcpy(&world[row * 4], pRow, 3 * sizeof(float));
+		}
+		MatrixMultiply(pWorldViewProj, world, m_ViewProj);
+	}
+	if(pDecl->m_InstanceColor.Stream >= 0)
+	{
+		const uint8_t* pInstanceColor = GetVertexData(pDecl->m_InstanceColor.Stream, pDecl->m_InstanceColor.Offset,
+			sizeof(RDCOLOR), instance, 1);
+		if(!pInstanceColor)
+			return false;
+		memcpy(pColor, pInstanceColor, sizeof(RDCOLOR));
+	}
+	return true;
+}
+
+void SoftwareRenderDevice::ProcessVertices(const VertexInput& input, unsigned count, const float* pMatrix)
+{
+	m_ClipVertices.resize(count);
+	const float* m = pMatrix;
+	const uint8_t* pPosition = input.pPosition;
+	const uint8_t* pColor = input.pColor;
+	bool modulate = input.InstanceColor != 0xFFFFFFFF;
+	for(unsigned i = 0; i < count; ++i, pPosition += input.PositionStride)
+	{
+		const float* p = (const float*)pPosition;
+		ClipVertex& v = m_ClipVertices[i];
+
+		if(input.Pretransformed)
+		{
+			//Map screen space back into clip space so both paths share the rasterizer
+			float w = p[3] != 0 ? 1.0f / p[3] : 1.0f;
+			v.x = ((p[0] - m_Viewport.X) / m_Viewport.Width * 2.0f - 1.0f) * w;
+			v.y = (1.0f - (p[1] - m_Viewport.Y) / m_Viewport.Height * 2.0f) * w;
+			v.z = p[2] * w;
+			v.w = w;
+		}
+		else
+		{
+			v.x = p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12];
+			v.y = p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13];
+			v.z = p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14];
+			v.w = p[0] * m[3] + p[1] * m[7] + p[2] * m[11] + m[15];
+		}
+
+		RDCOLOR c = 0xFFFFFFFF;
+		if(pColor)
+		{
+			memcpy(&c, pColor, sizeof(c));
+			pColor += input.ColorStride;
+		}
+		if(modulate)
+			c = RDModulateColor(c, input.InstanceColor);
+		v.a = (float)((c >> 24) & 0xff);
+		v.r = (float)((c >> 16) & 0xff);
+		v.g = (float)((c >> 8) & 0xff);
+		v.b = (float)(c & 0xff);
+	}
+}
+
+void SoftwareRenderDevice::DrawTriangles(RDPrimitiveType type, unsigned primCount, const uint32_t* pIndices)
+{
+	m_Stats.TrianglesSubmitted += primCount;
+
+	for(unsigned i = 0; i < primCount; ++i)
+	{
+		unsigned i0, i1, i2;
+		switch(type)
+		{
+		case RD_PT_TRIANGLESTRIP:
+			//Odd triangles of a strip have their winding swapped
+			i0 = (i & 1) ? i + 1 : i;
+			i1 = (i & 1) ? i : i + 1;
+			i2 = i + 2;
+			break;
+		case RD_PT_TRIANGLEFAN:
+			i0 = 0;
+			i1 = i + 1;
+			i2 = i + 2;
+			break;
+		default:
+			i0 = i * 3;
+			i1 = i * 3 + 1;
+			i2 = i * 3 + 2;
+			break;
+		}
+
+		if(pIndices)
+			AssembleTriangle(pIndices[i0], pIndices[i1], pIndices[i2]);
+		else
+			AssembleTriangle(i0, i1, i2);
+	}
+}
+
+void SoftwareRenderDevice::AssembleTriangle(unsigned i0, unsigned i1, unsigned i2)
+{
+	unsigned count = (unsigned)m_ClipVertices.size();
+	if(i0 >= count || i1 >= count || i2 >= count)
+	{
+		++m_Stats.TrianglesCulled;
+		return;
+	}
+	ClipTriangle(m_ClipVertices[i0], m_ClipVertices[i1], m_ClipVertices[i2]);
+}
+
+void SoftwareRenderDevice::ClipTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2)
+{
+	//Trivial accept/reject against the near (z >= 0) and far (z <= w) planes.
+	//Left/right/top/bottom are handled by the screen space bounding box (guard band).
+	int nearOut = (v0.z < 0) + (v1.z < 0) + (v2.z < 0);
+	int farOut = (v0.z > v0.w) + (v1.z > v1.w) + (v2.z > v2.w);
+	if(nearOut == 3 || farOut == 3)
+	{
+		++m_Stats.TrianglesCulled;
+		return;
+	}
+	if(nearOut == 0 && farOut == 0)
+	{
+		SetupTriangle(v0, v1, v2);
+		return;
+	}
+
+	ClipVertex polyA[9] = { v0, v1, v2 };
+	ClipVertex polyB[9];
+	int count = ClipPolygon(polyA, 3, polyB, NearDistance);
+	count = ClipPolygon(polyB, count, polyA, FarDistance);
+	if(count < 3)
+	{
+		++m_Stats.TrianglesCulled;
+		return;
+	}
+	for(int i = 1; i + 1 < count; ++i)
+		SetupTriangle(polyA[0], polyA[i], polyA[i + 1]);
+}
+
+void SoftwareRenderDevice::SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2)
+{
+	const ClipVertex* v[3] = { &v0, &v1, &v2 };
+	float sx[3], sy[3], sz[3], invW[3];
+
+	//Viewport transform (pixel centers are at integer coordinates, like Direct3D 9)
+	float halfW = m_Viewport.Width * 0.5f;
+	float halfH = m_Viewport.Height * 0.5f;
+	for(int i = 0; i < 3; ++i)
+	{
+		invW[i] = 1.0f / v[i]->w;
+		sx[i] = m_Viewport.X + (v[i]->x * invW[i] + 1.0f) * halfW;
+		sy[i] = m_Viewport.Y + (1.0f - v[i]->y * invW[i]) * halfH;
+		sz[i] = m_Viewport.MinZ + v[i]->z * invW[i] * (m_Viewport.MaxZ - m_Viewport.MinZ);
+	}
+
+	//Signed area, positive for triangles that are clockwise on screen
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+	RDWORD cull = m_RenderStates[RD_RS_CULLMODE];
+	if(area == 0 || (cull == RD_CULL_CCW && area < 0) || (cull == RD_CULL_CW && area > 0))
+	{
+		++m_Stats.TrianglesCulled;
+		return;
+	}
+
+	//Bounding box clipped to the viewport and render target
+	int vpMinX = (int)m_Viewport.X;
+	int vpMinY = (int)m_Viewport.Y;
+	int vpMaxX = (int)std::min(m_Viewport.X + m_Viewport.Width, m_Width) - 1;
+	int vpMaxY = (int)std::min(m_Viewport.Y + m_Viewport.Height, m_Height) - 1;
+	float fMinX = std::max((float)vpMinX, std::min(sx[0], std::min(sx[1], sx[2])));
+	float fMinY = std::max((float)vpMinY, std::min(sy[0], std::min(sy[1], sy[2])));
+	float fMaxX = std::min((float)vpMaxX, std::max(sx[0], std::max(sx[1], sx[2])));
+	float fMaxY = std::min((float)vpMaxY, std::max(sy[0], std::max(sy[1], sy[2])));
+	if(fMinX > fMaxX || fMinY > fMaxY)
+	{
+		++m_Stats.TrianglesCulled;
+		return;
+	}
+
+	Triangle tri;
+	tri.MinX = (int)ceilf(fMinX);
+	tri.MinY = (int)ceilf(fMinY);
+	tri.MaxX = (int)floorf(fMaxX);
+	tri.MaxY = (int)floorf(fMaxY);
+	if(tri.MinX > tri.MaxX || tri.MinY > tri.MaxY)
+	{
+		++m_Stats.TrianglesCulled;
+		return;
+	}
+
+	//Edge functions, oriented so the inside is positive
+	float sign = area > 0 ? 1.0f : -1.0f;
+	for(int e = 0; e < 3; ++e)
+	{
+		int i = e, j = (e + 1) % 3;
+		float a = -(sy[j] - sy[i]) * sign;
+		float b = (sx[j] - sx[i]) * sign;
+		tri.EdgeA[e] = a;
+		tri.EdgeB[e] = b;
+		tri.EdgeC[e] = -(a * sx[i] + b * sy[i]);
+		tri.TopLeft[e] = a > 0 || (a == 0 && b > 0);
+	}
+
+	//Attribute planes
+	float invArea = 1.0f / area;
+	SetupPlane(tri.Z, sx, sy, sz[0], sz[1], sz[2], invArea);
+	SetupPlane(tri.InvW, sx, sy, invW[0], invW[1], invW[2], invArea);
+	if(m_RenderStates[RD_RS_SHADEMODE] == RD_SHADE_FLAT)
+	{
+		//Flat shading uses the color of the first vertex
+		for(int k = 0; k < 3; ++k)
+		{
+			tri.R[k] = tri.InvW[k] * v0.r;
+			tri.G[k] = tri.InvW[k] * v0.g;
+			tri.B[k] = tri.InvW[k] * v0.b;
+			tri.A[k] = tri.InvW[k] * v0.a;
+		}
+	}
+	else
+	{
+		SetupPlane(tri.R, sx, sy, v0.r * invW[0], v1.r * invW[1], v2.r * invW[2], invArea);
+		SetupPlane(tri.G, sx, sy, v0.g * invW[0], v1.g * invW[1], v2.g * invW[2], invArea);
+		SetupPlane(tri.B, sx, sy, v0.b * invW[0], v1.b * invW[1], v2.b * invW[2], invArea);
+		SetupPlane(tri.A, sx, sy, v0.a * invW[0], v1.a * invW[1], v2.a * invW[2], invArea);
+	}
+
+	tri.ZEnable = m_RenderStates[RD_RS_ZENABLE] != 0;
+	tri.ZWrite = tri.ZEnable && m_RenderStates[RD_RS_ZWRITEENABLE] != 0;
+	tri.ZFunc = m_RenderStates[RD_RS_ZFUNC];
+
+	m_Triangles.push_back(tri);
+	BinTriangle((unsigned)m_Triangles.size() - 1);
+	++m_Stats.TrianglesBinned;
+}
+
+void SoftwareRenderDevice::BinTriangle(unsigned index)
+{
+	const Triangle& tri = m_Triangles[index];
+	unsigned tx0 = tri.MinX / TILE_SIZE, tx1 = tri.MaxX / TILE_SIZE;
+	unsigned ty0 = tri.MinY / TILE_SIZE, ty1 = tri.MaxY / TILE_SIZE;
+
+	for(unsigned ty = ty0; ty <= ty1; ++ty)
+	{
+		for(unsigned tx = tx0; tx <= tx1; ++tx)
+		{
+			//Reject tiles that lie completely outside one of the edges
+			float x0 = (float)(tx * TILE_SIZE), x1 = x0 + TILE_SIZE - 1;
+			float y0 = (float)(ty * TILE_SIZE), y1 = y0 + TILE_SIZE - 1;
+			bool outside = false;
+			for(int e = 0; e < 3 && !outside; ++e)
+			{
+				float x = tri.EdgeA[e] > 0 ? x1 : x0;
+				float y = tri.EdgeB[e] > 0 ? y1 : y0;
+				outside = tri.EdgeA[e] * x + tri.EdgeB[e] * y + tri.EdgeC[e] < 0;
+			}
+			if(!outside)
+				m_TileBins[ty * m_TilesX + tx].push_back(index);
+		}
+	}
+}
+
+void SoftwareRenderDevice::Flush()
+{
+	if(m_Triangles.empty())
+		return;
+
+	RunTileJob(TILEJOB_RASTERIZE);
+
+	for(size_t i = 0; i < m_TileBins.size(); ++i)
+		m_TileBins[i].clear();
+	m_Triangles.clear();
+}
+
+void SoftwareRenderDevice::RunTileJob(TileJob job)
+{
+	m_CurrentJob = job;
+	m_NextTile = 0;
+
+	if(m_Workers.empty())
+	{
+		ProcessTiles();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_JobMutex);
+		m_WorkersBusy = (unsigned)m_Workers.size();
+		++m_JobGeneration;
+	}
+	m_JobStart.notify_all();
+
+	//The calling thread works on tiles too
+	ProcessTiles();
+
+	std::unique_lock<std::mutex> lock(m_JobMutex);
+	while(m_WorkersBusy != 0)
+		m_JobDone.wait(lock);
+}
+
+void SoftwareRenderDevice::WorkerMain()
+{
+	unsigned seenGeneration = 0;
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_JobMutex);
+			while(!m_Quit && m_JobGeneration == seenGeneration)
+				m_JobStart.wait(lock);
+			if(m_Quit)
+				return;
+			seenGeneration = m_JobGeneration;
+		}
+
+		ProcessTiles();
+
+		std::lock_guard<std::mutex> lock(m_JobMutex);
+		if(--m_WorkersBusy == 0)
+			m_JobDone.notify_one();
+	}
+}
+
+void SoftwareRenderDevice::ProcessTiles()
+{
+	unsigned numTiles = m_TilesX * m_TilesY;
+	for(unsigned tile = m_NextTile++; tile < numTiles; tile = m_NextTile++)
+	{
+		if(m_CurrentJob == TILEJOB_CLEAR)
+			ClearTile(tile);
+		else
+			RasterizeTile(tile);
+	}
+}
+
+void SoftwareRenderDevice::ClearTile(unsigned tile)
+{
+	//Clears the part of the viewport covered by this tile
+	unsigned tx = tile % m_TilesX, ty = tile / m_TilesX;
+	unsigned x0 = std::max(tx * TILE_SIZE, (unsigned)m_Viewport.X);
+	unsigned y0 = std::max(ty * TILE_SIZE, (unsigned)m_Viewport.Y);
+	unsigned x1 = std::min(std::min((tx + 1) * TILE_SIZE, m_Width), m_Viewport.X + m_Viewport.Width);
+	unsigned y1 = std::min(std::min((ty + 1) * TILE_SIZE, m_Height), m_Viewport.Y + m_Viewport.Height);
+
+	for(unsigned y = y0; y < y1; ++y)
+	{
+		if(m_ClearFlags & RD_CLEAR_TARGET)
+			std::fill(&m_ColorBuffer[y * m_Pitch + x0], &m_ColorBuffer[y * m_Pitch] + x1, m_ClearColor);
+		if(m_ClearFlags & RD_CLEAR_ZBUFFER)
+			std::fill(&m_DepthBuffer[y * m_Pitch + x0], &m_DepthBuffer[y * m_Pitch] + x1, m_ClearDepth);
+	}
+}
+
+void SoftwareRenderDevice::RasterizeTile(unsigned tile)
+{
+	const std::vector<uint32_t>& bin = m_TileBins[tile];
+	int tileX0 = (int)((tile % m_TilesX) * TILE_SIZE);
+	int tileY0 = (int)((tile / m_TilesX) * TILE_SIZE);
+	int tileX1 = tileX0 + TILE_SIZE - 1;
+	int tileY1 = tileY0 + TILE_SIZE - 1;
+
+	for(size_t t = 0; t < bin.size(); ++t)
+	{
+		const Triangle& tri = m_Triangles[bin[t]];
+		int minX = std::max(tri.MinX, tileX0), maxX = std::min(tri.MaxX, tileX1);
+		int minY = std::max(tri.MinY, tileY0), maxY = std::min(tri.MaxY, tileY1);
+		if(minX > maxX || minY > maxY)
+			continue;
+
+#ifdef RD_USE_SSE2
+		//4 pixels at a time. Blocks start 4 aligned, lanes outside [minX, maxX] are masked off.
+		const __m128 laneOffset = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		const __m128 depthScale = _mm_set1_ps(DEPTH_SCALE);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 colorMax = _mm_set1_ps(255.0f);
+		const __m128 boundMin = _mm_set1_ps((float)minX);
+		const __m128 boundMax = _mm_set1_ps((float)maxX);
+		int startX = minX & ~3;
+
+		for(int y = minY; y <= maxY; ++y)
+		{
+			float fy = (float)y;
+			__m128 rowE0 = _mm_set1_ps(tri.EdgeB[0] * fy + tri.EdgeC[0]);
+			__m128 rowE1 = _mm_set1_ps(tri.EdgeB[1] * fy + tri.EdgeC[1]);
+			__m128 rowE2 = _mm_set1_ps(tri.EdgeB[2] * fy + tri.EdgeC[2]);
+			RDCOLOR* pColor = &m_ColorBuffer[y * m_Pitch];
+			uint32_t* pDepth = &m_DepthBuffer[y * m_Pitch];
+
+			for(int x = startX; x <= maxX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), laneOffset);
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.EdgeA[0]), px), rowE0);
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.EdgeA[1]), px), rowE1);
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.EdgeA[2]), px), rowE2);
+				__m128 inside = _mm_and_ps(_mm_and_ps(EdgeMask(e0, tri.TopLeft[0]), EdgeMask(e1, tri.TopLeft[1])),
+					_mm_and_ps(EdgeMask(e2, tri.TopLeft[2]), _mm_and_ps(_mm_cmpge_ps(px, boundMin), _mm_cmple_ps(px, boundMax))));
+				if(_mm_movemask_ps(inside) == 0)
+					continue;
+				__m128i mask = _mm_castps_si128(inside);
+
+				//Depth test
+				__m128 pz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.Z[0]), px), _mm_set1_ps(tri.Z[1] * fy + tri.Z[2]));
+				pz = _mm_min_ps(_mm_max_ps(pz, zero), one);
+				__m128i depth = _mm_cvttps_epi32(_mm_mul_ps(pz, depthScale));
+				__m128i stored = _mm_loadu_si128((const __m128i*)&pDepth[x]);
+				if(tri.ZEnable)
+				{
+					mask = _mm_and_si128(mask, DepthTest4(tri.ZFunc, depth, stored));
+					if(_mm_movemask_epi8(mask) == 0)
+						continue;
+				}
+				if(tri.ZWrite)
+				{
+					__m128i newDepth = _mm_or_si128(_mm_and_si128(mask, depth), _mm_andnot_si128(mask, stored));
+					_mm_storeu_si128((__m128i*)&pDepth[x], newDepth);
+				}
+
+				//Perspective correct Gouraud colors
+				__m128 invW = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.InvW[0]), px), _mm_set1_ps(tri.InvW[1] * fy + tri.InvW[2]));
+				__m128 w = _mm_div_ps(one, invW);
+				__m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.R[0]), px), _mm_set1_ps(tri.R[1] * fy + tri.R[2]));
+				__m128 g = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.G[0]), px), _mm_set1_ps(tri.G[1] * fy + tri.G[2]));
+				__m128 b = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.B[0]), px), _mm_set1_ps(tri.B[1] * fy + tri.B[2]));
+				__m128 a = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.A[0]), px), _mm_set1_ps(tri.A[1] * fy + tri.A[2]));
+				__m128i ir = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(r, w), zero), colorMax));
+				__m128i ig = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(g, w), zero), colorMax));
+				__m128i ib = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(b, w), zero), colorMax));
+				__m128i ia = _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(a, w), zero), colorMax));
+				__m128i color = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(ia, 24), _mm_slli_epi32(ir, 16)),
+					_mm_or_si128(_mm_slli_epi32(ig, 8), ib));
+
+				__m128i old = _mm_loadu_si128((const __m128i*)&pColor[x]);
+				_mm_storeu_si128((__m128i*)&pColor[x], _mm_or_si128(_mm_and_si128(mask, color), _mm_andnot_si128(mask, old)));
+			}
+		}
+#else
+		for(int y = minY; y <= maxY; ++y)
+		{
+			float fy = (float)y;
+			RDCOLOR* pColor = &m_ColorBuffer[y * m_Pitch];
+			uint32_t* pDepth = &m_DepthBuffer[y * m_Pitch];
+
+			for(int x = minX; x <= maxX; ++x)
+			{
+				float fx = (float)x;
+				bool inside = true;
+				for(int e = 0; e < 3 && inside; ++e)
+				{
+					float value = tri.EdgeA[e] * fx + (tri.EdgeB[e] * fy + tri.EdgeC[e]);
+					inside = tri.TopLeft[e] ? value >= 0 : value > 0;
+				}
+				if(!inside)
+					continue;
+
+				float z = std::min(std::max(tri.Z[0] * fx + (tri.Z[1] * fy + tri.Z[2]), 0.0f), 1.0f);
+				uint32_t depth = (uint32_t)(z * DEPTH_SCALE);
+				if(tri.ZEnable && !DepthTest(tri.ZFunc, depth, pDepth[x]))
+					continue;
+				if(tri.ZWrite)
+					pDepth[x] = depth;
+
+				float w = 1.0f / (tri.InvW[0] * fx + (tri.InvW[1] * fy + tri.InvW[2]));
+				float r = std::min(std::max((tri.R[0] * fx + (tri.R[1] * fy + tri.R[2])) * w, 0.0f), 255.0f);
+				float g = std::min(std::max((tri.G[0] * fx + (tri.G[1] * fy + tri.G[2])) * w, 0.0f), 255.0f);
+				float b = std::min(std::max((tri.B[0] * fx + (tri.B[1] * fy + tri.B[2])) * w, 0.0f), 255.0f);
+				float a = std::min(std::max((tri.A[0] * fx + (tri.A[1] * fy + tri.A[2])) * w, 0.0f), 255.0f);
+				pColor[x] = RD_COLOR_ARGB((int)(a + 0.5f), (int)(r + 0.5f), (int)(g + 0.5f), (int)(b + 0.5f));
+			}
+		}
+#endif
+	}
+}
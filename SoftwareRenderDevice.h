@@ -0,0 +1,216 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Multithreaded, tile based software rasterizer implementing IRenderDevice.
+				Used headless (CI, profiling) and as the CPU fallback on adapters
+				without hardware transform and lighting. Vertex declarations may
+				use positions, colors and the instance layout of RDInstanceLayout
+				from up to four streams; instances are transformed one after
+				another by the calling thread. Shaders are not supported and
+				textures are kept but not sampled, the fixed function transform
+				and vertex colors are all it draws.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//Called by Present() with the finished back buffer (e.g. to blit it to a window)
+typedef void (*RDPresentCallback)(void* pContext, const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch);
+
+//Per frame counters of the software device
+struct SoftwareDeviceStats
+{
+	unsigned DrawCalls;				//Draw calls since the last Present()
+	unsigned TrianglesSubmitted;	//Triangles handed to the device
+	unsigned TrianglesCulled;		//Back facing, degenerate or fully clipped triangles
+	unsigned TrianglesBinned;		//Triangles that reached the tile bins (after clipping)
+};
+
+class SoftwareRenderDevice : public IRenderDevice
+{
+public:
+	//numThreads = 0 uses one thread per hardware core
+	SoftwareRenderDevice(unsigned width, unsigned height, unsigned numThreads = 0);
+	~SoftwareRenderDevice();
+
+	RDDeviceType GetType() const override { return RD_DEVICE_SOFTWARE; }
+
+	bool CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB) override;
+	bool CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB) override;
+	bool CreateReadbackSurface(IReadbackSurface** ppSurface) override;
+	bool CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl) override;
+	bool CreateShader(RDShaderType /*type*/, const void* /*pBytecode*/, unsigned /*size*/, IShader** /*ppShader*/) override { return false; }
+	bool CreateTexture(unsigned width, unsigned height, ITexture** ppTexture) override;
+
+	void SetViewport(const RDViewport& viewport) override;
+	void SetTransform(RDTransformType type, const float* matrix) override;
+	void SetRenderState(RDRenderState state, RDWORD value) override;
+	void SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride) override;
+	void SetIndices(IIndexBuffer* pIB) override;
+	void SetFVF(RDWORD fvf) override;
+	void SetVertexDeclaration(IVertexDeclaration* pDecl) override;
+	void SetStreamSourceFreq(unsigned stream, RDWORD setting) override;
+	void SetShader(RDShaderType /*type*/, IShader* /*pShader*/) override {}
+	void SetShaderConstantF(RDShaderType /*type*/, unsigned /*start*/, const float* /*pData*/, unsigned /*count*/) override {}
+	void SetTexture(unsigned /*stage*/, ITexture* /*pTexture*/) override {}
+
+	void Clear(RDWORD flags, RDCOLOR color, float z, RDWORD stencil) override;
+	void BeginScene() override;
+	void EndScene() override;
+	void DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount) override;
+	void DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+		unsigned numVertices, unsigned startIndex, unsigned primCount) override;
+	void Present() override;
+	//Rasterizes what was binned, then copies the back buffer (done when it returns)
+	bool CopyBackBuffer(IReadbackSurface* pSurface) override;
+
+	bool SupportsInstancing() const override { return true; }
+	bool SupportsShaders() const override { return false; }
+	unsigned GetMaxTextureSize() const override { return 4096; }
+
+	RDDeviceState TestCooperativeLevel() override { return RD_DEVICE_OK; }
+	bool Reset(const RDPresentParams& params) override;
+
+	//Software specific
+	void SetPresentCallback(RDPresentCallback callback, void* pContext);
+	const RDCOLOR* GetBackBuffer() const { return &m_ColorBuffer[0]; }
+	const uint32_t* GetDepthBuffer() const { return &m_DepthBuffer[0]; } //24 bit depth in the low bits
+	unsigned GetWidth() const { return m_Width; }
+	unsigned GetHeight() const { return m_Height; }
+	unsigned GetPitch() const { return m_Pitch; } //In pixels
+	unsigned GetThreadCount() const { return (unsigned)m_Workers.size() + 1; }
+	const SoftwareDeviceStats& GetStats() const { return m_Stats; }
+
+	//Rasterizes everything that has been binned so far
+	void Flush();
+
+public:
+	//Post transform vertex in clip space
+	struct ClipVertex
+	{
+		float x, y, z, w;
+		float r, g, b, a;
+	};
+
+	//Triangle after setup, every attribute is a plane a*x + b*y + c in screen space
+	struct Triangle
+	{
+		float EdgeA[3], EdgeB[3], EdgeC[3];
+		bool TopLeft[3];
+		float Z[3];		//Depth plane (z/w is linear in screen space)
+		float InvW[3];	//1/w plane for perspective correction
+		float R[3], G[3], B[3], A[3]; //Color/w planes
+		int MinX, MinY, MaxX, MaxY;
+		RDWORD ZFunc;
+		bool ZEnable;
+		bool ZWrite;
+	};
+
+private:
+	//Disallow copying
+	SoftwareRenderDevice(const SoftwareRenderDevice&);
+	SoftwareRenderDevice& operator=(const SoftwareRenderDevice&);
+
+	enum { MAX_STREAMS = 4 };
+
+	struct StreamSource
+	{
+		IVertexBuffer*	pVB;
+		unsigned		Offset;
+		unsigned		Stride;
+		RDWORD			Freq;
+	};
+
+	//Attributes of the vertices of one draw (or one instance)
+	struct VertexInput
+	{
+		const uint8_t*	pPosition;
+		unsigned		PositionStride;
+		const uint8_t*	pColor;				//NULL for white vertices
+		unsigned		ColorStride;
+		bool			Pretransformed;		//XYZRHW / POSITIONT
+		RDCOLOR			InstanceColor;		//Multiplied with the vertex colors
+	};
+
+	void Resize(unsigned width, unsigned height);
+	void UpdateTransforms();
+	//Element at offset of count consecutive vertices of a stream, NULL if they are not all in the buffer
+	const uint8_t* GetVertexData(int stream, unsigned offset, unsigned size, unsigned first, unsigned count) const;
+	//Positions and colors from the FVF or the declaration
+	bool GetVertexInput(unsigned first, unsigned count, VertexInput* pInput) const;
+	//Transform and color of an instance (of the draw without instance data),
+	//false if it is not in the buffer
+	bool GetInstance(unsigned instance, float* pWorldViewProj, RDCOLOR* pColor) const;
+	void ProcessVertices(const VertexInput& input, unsigned count, const float* pMatrix);
+	void AssembleTriangle(unsigned i0, unsigned i1, unsigned i2);
+	void ClipTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+	void SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2);
+	void BinTriangle(unsigned index);
+	void DrawTriangles(RDPrimitiveType type, unsigned primCount, const uint32_t* pIndices);
+
+	//Tile jobs
+	enum TileJob { TILEJOB_RASTERIZE, TILEJOB_CLEAR };
+	void RunTileJob(TileJob job);
+	void WorkerMain();
+	void ProcessTiles();
+	void RasterizeTile(unsigned tile);
+	void ClearTile(unsigned tile);
+
+	//Render target
+	unsigned				m_Width;
+	unsigned				m_Height;
+	unsigned				m_Pitch;			//Width rounded up to a multiple of 4 pixels
+	std::vector<RDCOLOR>	m_ColorBuffer;
+	std::vector<uint32_t>	m_DepthBuffer;		//D24 style depth (0 .. 0xFFFFFF)
+
+	//Tiling
+	unsigned							m_TilesX;
+	unsigned							m_TilesY;
+	std::vector<std::vector<uint32_t> >	m_TileBins;		//Triangle indices per tile, in submission order
+	std::vector<Triangle>				m_Triangles;	//Triangles binned since the last flush
+
+	//Pipeline state
+	float			m_World[16];
+	float			m_View[16];
+	float			m_Proj[16];
+	float			m_ViewProj[16];
+	float			m_WorldViewProj[16];
+	bool			m_WVPDirty;
+	RDWORD			m_RenderStates[RD_RS_MAX];
+	RDViewport		m_Viewport;
+	StreamSource	m_Streams[MAX_STREAMS];
+	IIndexBuffer*	m_pIndices;
+	RDWORD			m_FVF;
+	IVertexDeclaration*	m_pDecl;		//Replaces the FVF while set
+
+	//Per draw scratch memory (kept to avoid per draw allocations)
+	std::vector<ClipVertex>	m_ClipVertices;
+	std::vector<uint32_t>	m_IndexScratch;
+
+	//Pending clear
+	RDWORD		m_ClearFlags;
+	RDCOLOR		m_ClearColor;
+	uint32_t	m_ClearDepth;
+
+	//Present
+	RDPresentCallback	m_PresentCallback;
+	void*				m_pPresentContext;
+	SoftwareDeviceStats	m_Stats;
+
+	//Worker threads
+	std::vector<std::thread>	m_Workers;
+	std::mutex					m_JobMutex;
+	std::condition_variable		m_JobStart;
+	std::condition_variable		m_JobDone;
+	unsigned					m_JobGeneration;	//Incremented for every job
+	unsigned					m_WorkersBusy;
+	bool						m_Quit;
+	TileJob						m_CurrentJob;
+	std::atomic<unsigned>		m_NextTile;
+};
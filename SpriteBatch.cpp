@@ -0,0 +1,247 @@
+#include "SpriteBatch.h"
+
+#include <string.h>
+#include <algorithm>
+
+const RDWORD SpriteVertex::FVF = SpriteLayout::FVF;
+
+namespace
+{
+	//16 bit indices address 65536 vertices, 4 per sprite
+	const unsigned SPRITES_PER_DRAW = 65536 / 4;
+	const unsigned QUAD_BYTES = 4 * sizeof(SpriteVertex);
+
+	const unsigned PAGE_BITS = 16;
+}
+
+SpriteBatch::SpriteBatch()
+{
+	m_pDevice = NULL;
+	m_pAtlas = NULL;
+	m_pVB = NULL;
+	m_pIB = NULL;
+	m_RingSprites = 0;
+	m_Cursor = 0;
+	m_Count = 0;
+	m_InOrder = true;
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+SpriteBatch::~SpriteBatch()
+{
+	Shutdown();
+}
+
+bool SpriteBatch::Init(IRenderDevice* pDevice, TextureAtlas* pAtlas, unsigned maxSprites, unsigned ringSprites)
+{
+	Shutdown();
+	if(!pDevice || !pAtlas || maxSprites == 0 || ringSprites == 0)
+		return false;
+
+	m_pDevice = pDevice;
+	m_pAtlas = pAtlas;
+	m_RingSprites = ringSprites;
+	m_Queue.resize(maxSprites);
+	m_Sorted.resize(maxSprites);
+	m_SortScratch.resize(maxSprites);
+
+	//Sprite s uses vertices 4s .. 4s + 3, triangles 0-1-2 and 2-1-3 like BatchRenderer quads
+	unsigned indexCount = std::min(ringSprites, SPRITES_PER_DRAW) * 6;
+	void* pIndices = NULL;
+	bool created = pDevice->CreateIndexBuffer(indexCount * sizeof(uint16_t), RD_USAGE_WRITEONLY, RD_FMT_INDEX16, RD_POOL_MANAGED, &m_pIB) &&
+		m_pIB->Lock(0, indexCount * sizeof(uint16_t), &pIndices, 0);
+	if(created)
+	{
+		uint16_t* pDst = (uint16_t*)pIndices;
+		for(unsigned i = 0; i < indexCount / 6; ++i, pDst += 6)
+		{
+			uint16_t base = (uint16_t)(i * 4);
+			pDst[0] = base;
+			pDst[1] = (uint16_t)(base + 1);
+			pDst[2] = (uint16_t)(base + 2);
+			pDst[3] = (uint16_t)(base + 2);
+			pDst[4] = (uint16_t)(base + 1);
+			pDst[5] = (uint16_t)(base + 3);
+		}
+		m_pIB->Unlock();
+		created = pDevice->CreateVertexBuffer(ringSprites * QUAD_BYTES, RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, SpriteVertex::FVF,
+			RD_POOL_DEFAULT, &m_pVB);
+	}
+	if(!created)
+	{
+		Shutdown();
+		return false;
+	}
+
+	m_Cursor = 0;
+	return true;
+}
+
+void SpriteBatch::Shutdown()
+{
+	SAFE_RELEASE(m_pVB);
+	SAFE_RELEASE(m_pIB);
+	m_Queue.clear();
+	m_Sorted.clear();
+	m_SortScratch.clear();
+	m_Count = 0;
+	m_pDevice = NULL;
+	m_pAtlas = NULL;
+}
+
+void SpriteBatch::Begin()
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_Count = 0;
+	m_InOrder = true;
+	//Pages with this frame's sprites must not be evicted until they are drawn
+	if(m_pAtlas)
+		m_pAtlas->BeginFrame();
+}
+
+bool SpriteBatch::Draw(AtlasHandle region, float x, float y, float width, float height, RDCOLOR color, unsigned layer)
+{
+	const AtlasRegion* pRegion = m_pAtlas ? m_pAtlas->Use(region) : NULL;
+	if(!pRegion || m_Count == m_Queue.size() || layer >= MAX_LAYERS)
+	{
+		++m_Stats.Dropped;
+		return false;
+	}
+
+	QueuedSprite& sprite = m_Queue[m_Count];
+	sprite.Key = (layer << PAGE_BITS) | pRegion->Page;
+	sprite.Color = color;
+	//Direct3D 9 pixel centers are on integer coordinates, texel edges on pixel edges
+	sprite.X0 = x - 0.5f;
+	sprite.Y0 = y - 0.5f;
+	sprite.X1 = sprite.X0 + width;
+	sprite.Y1 = sprite.Y0 + height;
+	sprite.U0 = pRegion->U0;
+	sprite.V0 = pRegion->V0;
+	sprite.U1 = pRegion->U1;
+	sprite.V1 = pRegion->V1;
+	if(m_Count > 0 && sprite.Key < m_Queue[m_Count - 1].Key)
+		m_InOrder = false;
+	++m_Count;
+	return true;
+}
+
+void SpriteBatch::End()
+{
+	if(!m_pDevice || m_Count == 0)
+		return;
+
+	if(m_InOrder)
+	{
+		for(unsigned i = 0; i < m_Count; ++i)
+			m_Sorted[i] = &m_Queue[i];
+	}
+	else
+		Sort();
+	m_Stats.Sorted = !m_InOrder;
+
+	m_pDevice->SetFVF(SpriteVertex::FVF);
+	m_pDevice->SetIndices(m_pIB);
+	m_pDevice->SetRenderState(RD_RS_ZENABLE, false);
+	m_pDevice->SetRenderState(RD_RS_CULLMODE, RD_CULL_NONE);
+	m_pDevice->SetRenderState(RD_RS_ALPHABLENDENABLE, true);
+	m_pDevice->SetRenderState(RD_RS_SRCBLEND, RD_BLEND_SRCALPHA);
+	m_pDevice->SetRenderState(RD_RS_DESTBLEND, RD_BLEND_INVSRCALPHA);
+
+	//One texture per run of equal keys
+	for(unsigned first = 0; first < m_Count; )
+	{
+		uint32_t key = m_Sorted[first]->Key;
+		unsigned last = first + 1;
+		while(last < m_Count && m_Sorted[last]->Key == key)
+			++last;
+		DrawRun(&m_Sorted[first], last - first, m_pAtlas->GetPageTexture(key & ((1 << PAGE_BITS) - 1)));
+		++m_Stats.PageRuns;
+		first = last;
+	}
+	m_Stats.Sprites += m_Count;
+	m_Count = 0;
+}
+
+void SpriteBatch::Sort()
+{
+	//LSD radix sort, 8 bits per pass; passes where every key has the same digit are skipped
+	const QueuedSprite** pSource = &m_Sorted[0];
+	const QueuedSprite** pDest = &m_SortScratch[0];
+	for(unsigned i = 0; i < m_Count; ++i)
+		pSource[i] = &m_Queue[i];
+
+	for(unsigned shift = 0; shift < PAGE_BITS + 8; shift += 8)
+	{
+		unsigned offsets[256];
+		memset(offsets, 0, sizeof(offsets));
+		for(unsigned i = 0; i < m_Count; ++i)
+			++offsets[(pSource[i]->Key >> shift) & 0xFF];
+		if(offsets[(pSource[0]->Key >> shift) & 0xFF] == m_Count)
+			continue;
+
+		unsigned sum = 0;
+		for(unsigned d = 0; d < 256; ++d)
+		{
+			unsigned count = offsets[d];
+			offsets[d] = sum;
+			sum += count;
+		}
+		for(unsigned i = 0; i < m_Count; ++i)
+			pDest[offsets[(pSource[i]->Key >> shift) & 0xFF]++] = pSource[i];
+		std::swap(pSource, pDest);
+	}
+
+	if(pSource != &m_Sorted[0])
+		memcpy(&m_Sorted[0], pSource, m_Count * sizeof(pSource[0]));
+}
+
+void SpriteBatch::DrawRun(const QueuedSprite* const* ppSprites, unsigned count, ITexture* pTexture)
+{
+	m_pDevice->SetTexture(0, pTexture);
+	unsigned maxChunk = std::min(m_RingSprites, SPRITES_PER_DRAW);
+	for(unsigned first = 0; first < count; )
+	{
+		unsigned chunk = std::min(count - first, maxChunk);
+
+		//Append with NOOVERWRITE, wrap around with DISCARD
+		RDWORD lock = RD_LOCK_NOOVERWRITE;
+		if(m_Cursor + chunk > m_RingSprites)
+		{
+			m_Cursor = 0;
+			lock = RD_LOCK_DISCARD;
+			++m_Stats.RingWraps;
+		}
+		void* pData = NULL;
+		if(!m_pVB->Lock(m_Cursor * QUAD_BYTES, chunk * QUAD_BYTES, &pData, lock))
+			return;
+
+		//Whole vertices in order, the buffer may be write combined memory
+		SpriteVertex* pVertex = (SpriteVertex*)pData;
+		for(unsigned i = 0; i < chunk; ++i, pVertex += 4)
+		{
+			const QueuedSprite& sprite = *ppSprites[first + i];
+			SpriteVertex corner = { sprite.X0, sprite.Y0, 0.0f, 1.0f, sprite.Color, sprite.U0, sprite.V0 };
+			pVertex[0] = corner;
+			corner.x = sprite.X1;
+			corner.u = sprite.U1;
+			pVertex[1] = corner;
+			corner.x = sprite.X0;
+			corner.y = sprite.Y1;
+			corner.u = sprite.U0;
+			corner.v = sprite.V1;
+			pVertex[2] = corner;
+			corner.x = sprite.X1;
+			corner.u = sprite.U1;
+			pVertex[3] = corner;
+		}
+		m_pVB->Unlock();
+
+		m_pDevice->SetStreamSource(0, m_pVB, 0, sizeof(SpriteVertex));
+		m_pDevice->DrawIndexedPrimitive(RD_PT_TRIANGLELIST, m_Cursor * 4, 0, chunk * 4, 0, chunk * 2);
+		m_Cursor += chunk;
+		m_Stats.BytesUploaded += chunk * QUAD_BYTES;
+		++m_Stats.DrawCalls;
+		first += chunk;
+	}
+}
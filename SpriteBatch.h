@@ -0,0 +1,106 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Screen space sprite batcher drawing from a TextureAtlas.
+				Sprites are queued between Begin() and End(), then sorted by
+				layer and atlas page (a stable radix sort, skipped when they
+				already arrive in order) and written as pretransformed quads
+				straight into a dynamic vertex ring buffer. One shared index
+				buffer serves every draw, so a draw covers a run of sprites on
+				the same page, up to what 16 bit indices address. Within a layer,
+				sprites of different pages may overlap out of submission order;
+				put sprites that must stack on separate layers.
+				Buffers are created through the device, so a ResourceRegistryDevice
+				keeps them across resets (the ring is refilled every End()).
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "TextureAtlas.h"
+#include "VertexLayout.h"
+
+#include <stddef.h>
+#include <vector>
+
+//D3DFVF_XYZRHW | D3DFVF_DIFFUSE | D3DFVF_TEX1
+typedef VertexLayout<VA_PositionT<>, VA_Color<0>, VA_TexCoord<0> > SpriteLayout;
+
+struct SpriteVertex
+{
+	float	x, y, z, rhw;
+	RDCOLOR	Color;
+	float	u, v;
+
+	static const RDWORD FVF;
+};
+
+static_assert(sizeof(SpriteVertex) == SpriteLayout::STRIDE && offsetof(SpriteVertex, u) == SpriteLayout::Offset<RD_DECLUSAGE_TEXCOORD>::Value,
+	"Sprite vertices must match their layout");
+
+//Per frame counters
+struct SpriteStats
+{
+	unsigned	Sprites;
+	unsigned	Dropped;			//Stale atlas handles or a full queue
+	unsigned	DrawCalls;
+	unsigned	PageRuns;			//Runs of sprites sharing a layer and page, after sorting
+	bool		Sorted;				//False if the queue was already in order
+	uint64_t	BytesUploaded;
+	unsigned	RingWraps;			//DISCARD locks
+};
+
+class SpriteBatch
+{
+public:
+	SpriteBatch();
+	~SpriteBatch();
+
+	//maxSprites is the queue size of a frame; the ring holds ringSprites quads
+	bool Init(IRenderDevice* pDevice, TextureAtlas* pAtlas, unsigned maxSprites = 131072, unsigned ringSprites = 65536);
+	void Shutdown();
+
+	//Starts a new frame and clears the statistics
+	void Begin();
+	//Queues a sprite with its top left corner at x, y (pixels), color multiplies
+	//the image. False if the region is gone (re-insert it) or the queue is full.
+	bool Draw(AtlasHandle region, float x, float y, float width, float height, RDCOLOR color = 0xFFFFFFFF, unsigned layer = 0);
+	//Sorts and draws the queue. Sets the FVF, stream 0, indices, texture stage 0,
+	//alpha blending on, z test and culling off; restore them before 3D drawing.
+	void End();
+
+	const SpriteStats& GetStats() const { return m_Stats; }
+
+private:
+	//Disallow copying
+	SpriteBatch(const SpriteBatch&);
+	SpriteBatch& operator=(const SpriteBatch&);
+
+	enum { MAX_LAYERS = 256 };
+
+	struct QueuedSprite
+	{
+		uint32_t	Key;			//Layer, page
+		RDCOLOR		Color;
+		float		X0, Y0, X1, Y1;
+		float		U0, V0, U1, V1;
+	};
+
+	//Stable sort of m_Queue by key into m_Sorted
+	void Sort();
+	//Writes count quads into the ring and draws them
+	void DrawRun(const QueuedSprite* const* ppSprites, unsigned count, ITexture* pTexture);
+
+	IRenderDevice*				m_pDevice;
+	TextureAtlas*				m_pAtlas;
+	IVertexBuffer*				m_pVB;
+	IIndexBuffer*				m_pIB;			//Quad indices, shared by every draw
+	unsigned					m_RingSprites;
+	unsigned					m_Cursor;		//Next free quad in the ring
+
+	std::vector<QueuedSprite>	m_Queue;
+	unsigned					m_Count;		//Queued this frame
+	bool						m_InOrder;		//Keys never decreased this frame
+	std::vector<const QueuedSprite*>	m_Sorted;
+	std::vector<const QueuedSprite*>	m_SortScratch;
+
+	SpriteStats					m_Stats;
+};
@@ -0,0 +1,248 @@
+#include "SpriteBenchmark.h"
+#include "SpriteBatch.h"
+#include "NullRenderDevice.h"
+#include "SimdMath.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const unsigned WIDTH = 1280;
+	const unsigned HEIGHT = 720;
+	const unsigned PAGE_SIZE = 1024;
+	const unsigned PACK_IMAGES = 6000;
+	const unsigned SPRITES = 100000;
+	const unsigned FRAMES = 20;
+
+	//Glyph cache: lookups per frame from a window of glyphs that drifts through the set
+	const unsigned GLYPHS = 4000;
+	const unsigned GLYPH_WINDOW = 300;
+	const unsigned GLYPHS_PER_FRAME = 200;
+	const unsigned GLYPH_DRIFT = 10;
+	const unsigned CACHE_FRAMES = 300;
+	const unsigned CACHE_PAGES = 6;
+
+	//Batching: regions on each of the pages
+	const unsigned BATCH_PAGES = 8;
+	const unsigned REGIONS_PER_PAGE = 196;
+
+	//Glyph sized most of the time, now and then an icon
+	void ImageSize(uint32_t& seed, unsigned* pWidth, unsigned* pHeight)
+	{
+		if(RandomBits(seed) % 8 != 0)
+		{
+			*pWidth = 6 + RandomBits(seed) % 20;
+			*pHeight = 12 + RandomBits(seed) % 22;
+		}
+		else
+		{
+			*pWidth = 16 + RandomBits(seed) % 80;
+			*pHeight = 16 + RandomBits(seed) % 80;
+		}
+	}
+
+	//Every padded region inside its page and on pixels of its own
+	bool CheckPacking(const TextureAtlas& atlas, const std::vector<AtlasHandle>& handles, unsigned padding)
+	{
+		unsigned size = atlas.GetPageSize();
+		std::vector<std::vector<uint8_t> > covered(atlas.GetPageCount(), std::vector<uint8_t>((size_t)size * size, 0));
+		for(size_t i = 0; i < handles.size(); ++i)
+		{
+			const AtlasRegion* pRegion = atlas.Find(handles[i]);
+			if(!pRegion)
+				continue;
+			if(pRegion->X < padding || pRegion->Y < padding || pRegion->X + pRegion->Width + padding > size ||
+				pRegion->Y + pRegion->Height + padding > size)
+				return false;
+			std::vector<uint8_t>& page = covered[pRegion->Page];
+			for(unsigned y = pRegion->Y - padding; y < pRegion->Y + pRegion->Height + padding; ++y)
+			{
+				for(unsigned x = pRegion->X - padding; x < pRegion->X + pRegion->Width + padding; ++x)
+				{
+					if(page[(size_t)y * size + x]++)
+						return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	struct SpriteRun
+	{
+		double	QueueMs;
+		double	EndMs;
+		SpriteStats	Stats;
+		unsigned	UnsortedRuns;	//Changes of page (or layer) in submission order
+		bool	Valid;
+	};
+
+	//Random sprites from the first pages of regions (region i is on page i % BATCH_PAGES),
+	//the frame split into layers by submission order
+	SpriteRun RunFrames(NullRenderDevice& device, SpriteBatch& batch, const std::vector<AtlasHandle>& regions,
+		unsigned pages, unsigned layers)
+	{
+		SpriteRun run;
+		memset(&run, 0, sizeof(run));
+		run.Valid = true;
+		int64_t queueTicks = 0, endTicks = 0;
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+		{
+			uint32_t seed = 1234;
+			device.ResetCounters();
+			int64_t start = TimerTicks();
+			batch.Begin();
+			run.UnsortedRuns = 0;
+			unsigned previousKey = ~0u;
+			for(unsigned i = 0; i < SPRITES; ++i)
+			{
+				unsigned page = RandomBits(seed) % pages;
+				unsigned r = RandomBits(seed) % REGIONS_PER_PAGE * BATCH_PAGES + page;
+				unsigned layer = i * layers / SPRITES;
+				float x = (float)(RandomBits(seed) % WIDTH);
+				float y = (float)(RandomBits(seed) % HEIGHT);
+				batch.Draw(regions[r], x, y, 16.0f, 16.0f, 0xFFFFFFFF, layer);
+				unsigned key = (layer << 16) | page;
+				run.UnsortedRuns += key != previousKey;
+				previousKey = key;
+			}
+			int64_t queued = TimerTicks();
+			batch.End();
+			int64_t end = TimerTicks();
+			queueTicks += queued - start;
+			endTicks += end - queued;
+
+			const NullDeviceCounters& counters = device.GetCounters();
+			const SpriteStats& stats = batch.GetStats();
+			run.Valid = run.Valid && stats.Sprites == SPRITES && stats.Dropped == 0 &&
+				counters.DrawIndexedPrimitive == stats.DrawCalls && counters.Primitives == 2 * SPRITES &&
+				stats.PageRuns == pages * layers && stats.DrawCalls <= stats.PageRuns + SPRITES / 16384;
+		}
+		run.QueueMs = TicksToMs(queueTicks) / FRAMES;
+		run.EndMs = TicksToMs(endTicks) / FRAMES;
+		run.Stats = batch.GetStats();
+		return run;
+	}
+
+	void PrintRun(FILE* pOut, const char* pName, const SpriteRun& run)
+	{
+		fprintf(pOut, "%-26s %7.3f ms queue %7.3f ms end (%s), %3u draws, %2u page runs, %6u unsorted runs, %5.1f MB%s\n",
+			pName, run.QueueMs, run.EndMs, run.Stats.Sorted ? "sorted" : "in order", run.Stats.DrawCalls, run.Stats.PageRuns,
+			run.UnsortedRuns, run.Stats.BytesUploaded / (1024.0 * 1024.0), run.Valid ? "" : "  INVALID");
+	}
+}
+
+bool RunSpriteBenchmarks(FILE* pOut)
+{
+	bool ok = true;
+	NullRenderDevice device(WIDTH, HEIGHT);
+	std::vector<RDCOLOR> pixels(96 * 96, 0xFFFFFFFF);
+
+	//Packing: incremental inserts until everything is in
+	{
+		TextureAtlas atlas;
+		atlas.Init(&device, PAGE_SIZE, 16, 1);
+		std::vector<AtlasHandle> handles(PACK_IMAGES);
+		uint32_t seed = 99;
+		int64_t start = TimerTicks();
+		for(unsigned i = 0; i < PACK_IMAGES; ++i)
+		{
+			unsigned width = 0, height = 0;
+			ImageSize(seed, &width, &height);
+			handles[i] = atlas.Insert(width, height, &pixels[0], 96);
+		}
+		double ms = TicksToMs(TimerTicks() - start);
+		AtlasStats stats = atlas.GetStats();
+		bool packed = stats.Inserts == PACK_IMAGES && stats.FailedInserts == 0 && stats.Evictions == 0 &&
+			CheckPacking(atlas, handles, 1);
+		fprintf(pOut, "Packing %u images: %.3f ms (%.2f us each), %u pages of %u, %.1f%% occupied, %.1f MB uploaded%s\n",
+			PACK_IMAGES, ms, ms * 1000.0 / PACK_IMAGES, stats.Pages, PAGE_SIZE, stats.Occupancy() * 100.0,
+			stats.UploadedBytes / (1024.0 * 1024.0), packed ? "" : "  INVALID");
+		ok = ok && packed;
+
+		//Removing everything empties the pages for reuse
+		for(unsigned i = 0; i < PACK_IMAGES; i += 2)
+			atlas.Remove(handles[i]);
+		bool stale = atlas.Find(handles[0]) == NULL && atlas.Find(handles[1]) != NULL;
+		for(unsigned i = 1; i < PACK_IMAGES; i += 2)
+			atlas.Remove(handles[i]);
+		stats = atlas.GetStats();
+		bool removed = stale && stats.Regions == 0 && stats.UsedPixels == 0;
+		fprintf(pOut, "Removing all: handles %s, pages %s\n", stale ? "go stale" : "STILL VALID",
+			removed ? "empty again" : "NOT EMPTY");
+		ok = ok && removed;
+	}
+
+	//Glyph cache: a working set that moves through more glyphs than the pages hold
+	{
+		TextureAtlas atlas;
+		atlas.Init(&device, 256, CACHE_PAGES, 1);
+		std::vector<AtlasHandle> cache(GLYPHS, 0);
+		std::vector<unsigned> used(GLYPHS_PER_FRAME);
+		uint32_t seed = 7;
+		unsigned lookups = 0, misses = 0, failed = 0;
+		bool valid = true;
+		int64_t start = TimerTicks();
+		for(unsigned frame = 0; frame < CACHE_FRAMES; ++frame)
+		{
+			atlas.BeginFrame();
+			//The working set drifts, like text scrolling by
+			unsigned base = frame * GLYPH_DRIFT;
+			for(unsigned i = 0; i < GLYPHS_PER_FRAME; ++i)
+			{
+				unsigned glyph = (base + RandomBits(seed) % GLYPH_WINDOW) % GLYPHS;
+				used[i] = glyph;
+				++lookups;
+				if(atlas.Use(cache[glyph]))
+					continue;
+				++misses;
+				uint32_t sizeSeed = glyph;
+				unsigned width = 6 + RandomBits(sizeSeed) % 14, height = 12 + RandomBits(sizeSeed) % 10;
+				cache[glyph] = atlas.Insert(width, height, &pixels[0], 96);
+				failed += cache[glyph] == 0;
+			}
+			//Nothing used this frame may have been evicted by a later insert
+			for(unsigned i = 0; i < GLYPHS_PER_FRAME; ++i)
+				valid = valid && (cache[used[i]] == 0 || atlas.Find(cache[used[i]]) != NULL);
+		}
+		double ms = TicksToMs(TimerTicks() - start);
+		AtlasStats stats = atlas.GetStats();
+		valid = valid && stats.Evictions > 0 && failed == 0;
+		fprintf(pOut, "Glyph cache: %u lookups, %.1f%% hits, %u evictions (%u regions), %u failed, %.1f%% occupied, %.3f ms%s\n",
+			lookups, 100.0 * (lookups - misses) / lookups, stats.Evictions, stats.EvictedRegions, failed, stats.Occupancy() * 100.0,
+			ms, valid ? "" : "  INVALID");
+		ok = ok && valid;
+	}
+
+	//Batching: 100k sprites per frame on small pages that hold 14 x 14 padded 7 x 7 regions each
+	{
+		TextureAtlas atlas;
+		atlas.Init(&device, 128, BATCH_PAGES, 1);
+		std::vector<AtlasHandle> filled;
+		for(unsigned i = 0; i < BATCH_PAGES * REGIONS_PER_PAGE; ++i)
+			filled.push_back(atlas.Insert(7, 7, &pixels[0], 96));
+		SpriteBatch batch;
+		batch.Init(&device, &atlas);
+
+		//Pages fill one after the other; interleave them so region i is on page i % BATCH_PAGES
+		std::vector<AtlasHandle> regions(filled.size());
+		for(unsigned i = 0; i < regions.size(); ++i)
+			regions[i] = filled[(i % BATCH_PAGES) * REGIONS_PER_PAGE + i / BATCH_PAGES];
+		bool pagesOk = atlas.GetPageCount() == BATCH_PAGES;
+		for(unsigned i = 0; i < regions.size() && pagesOk; ++i)
+			pagesOk = atlas.Find(regions[i]) && atlas.Find(regions[i])->Page == i % BATCH_PAGES;
+
+		fprintf(pOut, "%u sprites per frame, %u frames\n", SPRITES, FRAMES);
+		SpriteRun one = RunFrames(device, batch, regions, 1, 1);
+		PrintRun(pOut, "1 page", one);
+		SpriteRun many = RunFrames(device, batch, regions, BATCH_PAGES, 1);
+		PrintRun(pOut, "8 pages, random order", many);
+		SpriteRun layered = RunFrames(device, batch, regions, 4, 3);
+		PrintRun(pOut, "4 pages on 3 layers", layered);
+		ok = ok && pagesOk && one.Valid && many.Valid && layered.Valid && !one.Stats.Sorted && many.Stats.Sorted;
+	}
+
+	fprintf(pOut, "Sprites %s\n", ok ? "work" : "FAILED");
+	return ok;
+}
@@ -0,0 +1,17 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Texture atlas and sprite batching benchmark on the null device:
+				packs thousands of glyph and icon sized images (checking that no
+				two regions overlap), runs a drifting glyph cache through a small
+				atlas to exercise eviction, then draws 100k sprites per frame from one
+				page, from several pages in random order and on several layers,
+				counting draw calls against the page switches unsorted drawing
+				would need.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunSpriteBenchmarks(FILE* pOut);
@@ -0,0 +1,264 @@
+#include "StateCache.h"
+
+#include <string.h>
+
+StateCacheDevice::StateCacheDevice(IRenderDevice* pDevice)
+{
+	m_pDevice = pDevice;
+	Invalidate();
+	ResetCounters();
+}
+
+StateCacheDevice::~StateCacheDevice()
+{
+	SAFE_DELETE(m_pDevice);
+}
+
+void StateCacheDevice::Invalidate()
+{
+	memset(m_RenderStates, 0, sizeof(m_RenderStates));
+	memset(m_RenderStateValid, 0, sizeof(m_RenderStateValid));
+	memset(&m_World, 0, sizeof(m_World));
+	memset(&m_View, 0, sizeof(m_View));
+	memset(&m_Proj, 0, sizeof(m_Proj));
+	memset(m_Streams, 0, sizeof(m_Streams));
+	m_IndicesValid = false;
+	m_pIndices = NULL;
+	m_FVFValid = false;
+	m_FVF = 0;
+	m_DeclValid = false;
+	m_pDecl = NULL;
+	memset(m_ShaderValid, 0, sizeof(m_ShaderValid));
+	memset(m_pShaders, 0, sizeof(m_pShaders));
+	memset(m_TextureValid, 0, sizeof(m_TextureValid));
+	memset(m_pTextures, 0, sizeof(m_pTextures));
+}
+
+void StateCacheDevice::ResetCounters()
+{
+	memset(&m_Counters, 0, sizeof(m_Counters));
+}
+
+bool StateCacheDevice::CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB)
+{
+	if(!m_pDevice->CreateVertexBuffer(length, usage, fvf, pool, ppVB))
+		return false;
+
+	//A new buffer can reuse the address of a released one that is still shadowed as bound
+	for(int i = 0; i < MAX_STREAMS; ++i)
+	{
+		if(m_Streams[i].pVB == *ppVB)
+			m_Streams[i].Valid = false;
+	}
+	return true;
+}
+
+bool StateCacheDevice::CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB)
+{
+	if(!m_pDevice->CreateIndexBuffer(length, usage, format, pool, ppIB))
+		return false;
+
+	if(m_pIndices == *ppIB)
+		m_IndicesValid = false;
+	return true;
+}
+
+bool StateCacheDevice::CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl)
+{
+	if(!m_pDevice->CreateVertexDeclaration(pElements, ppDecl))
+		return false;
+
+	if(m_pDecl == *ppDecl)
+		m_DeclValid = false;
+	return true;
+}
+
+bool StateCacheDevice::CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader)
+{
+	if(!m_pDevice->CreateShader(type, pBytecode, size, ppShader))
+		return false;
+
+	if(m_pShaders[type] == *ppShader)
+		m_ShaderValid[type] = false;
+	return true;
+}
+
+bool StateCacheDevice::CreateTexture(unsigned width, unsigned height, ITexture** ppTexture)
+{
+	if(!m_pDevice->CreateTexture(width, height, ppTexture))
+		return false;
+
+	for(int i = 0; i < RD_MAX_TEXTURE_STAGES; ++i)
+	{
+		if(m_pTextures[i] == *ppTexture)
+			m_TextureValid[i] = false;
+	}
+	return true;
+}
+
+StateCacheDevice::TransformSlot* StateCacheDevice::GetTransformSlot(RDTransformType type)
+{
+	switch(type)
+	{
+	case RD_TS_WORLD: return &m_World;
+	case RD_TS_VIEW: return &m_View;
+	case RD_TS_PROJECTION: return &m_Proj;
+	default: return NULL;
+	}
+}
+
+void StateCacheDevice::SetTransform(RDTransformType type, const float* matrix)
+{
+	++m_Counters.TransformCalls;
+
+	TransformSlot* pSlot = GetTransformSlot(type);
+	if(pSlot && pSlot->Valid && memcmp(pSlot->Matrix, matrix, sizeof(pSlot->Matrix)) == 0)
+	{
+		++m_Counters.TransformFiltered;
+		return;
+	}
+	if(pSlot)
+	{
+		pSlot->Valid = true;
+		memcpy(pSlot->Matrix, matrix, sizeof(pSlot->Matrix));
+	}
+	m_pDevice->SetTransform(type, matrix);
+}
+
+void StateCacheDevice::SetRenderState(RDRenderState state, RDWORD value)
+{
+	++m_Counters.RenderStateCalls;
+
+	if(state < RD_RS_MAX)
+	{
+		if(m_RenderStateValid[state] && m_RenderStates[state] == value)
+		{
+			++m_Counters.RenderStateFiltered;
+			return;
+		}
+		m_RenderStateValid[state] = true;
+		m_RenderStates[state] = value;
+	}
+	m_pDevice->SetRenderState(state, value);
+}
+
+void StateCacheDevice::SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride)
+{
+	++m_Counters.StreamSourceCalls;
+
+	if(stream < MAX_STREAMS)
+	{
+		StreamSlot& slot = m_Streams[stream];
+		if(slot.Valid && slot.pVB == pVB && slot.Offset == offset && slot.Stride == stride)
+		{
+			++m_Counters.StreamSourceFiltered;
+			return;
+		}
+		slot.Valid = true;
+		slot.pVB = pVB;
+		slot.Offset = offset;
+		slot.Stride = stride;
+	}
+	m_pDevice->SetStreamSource(stream, pVB, offset, stride);
+}
+
+void StateCacheDevice::SetIndices(IIndexBuffer* pIB)
+{
+	++m_Counters.IndicesCalls;
+
+	if(m_IndicesValid && m_pIndices == pIB)
+	{
+		++m_Counters.IndicesFiltered;
+		return;
+	}
+	m_IndicesValid = true;
+	m_pIndices = pIB;
+	m_pDevice->SetIndices(pIB);
+}
+
+void StateCacheDevice::SetFVF(RDWORD fvf)
+{
+	++m_Counters.FVFCalls;
+
+	if(m_FVFValid && m_FVF == fvf)
+	{
+		++m_Counters.FVFFiltered;
+		return;
+	}
+	m_FVFValid = true;
+	m_FVF = fvf;
+	//The FVF replaces the declaration
+	m_DeclValid = false;
+	m_pDevice->SetFVF(fvf);
+}
+
+void StateCacheDevice::SetVertexDeclaration(IVertexDeclaration* pDecl)
+{
+	++m_Counters.DeclarationCalls;
+
+	if(m_DeclValid && m_pDecl == pDecl)
+	{
+		++m_Counters.DeclarationFiltered;
+		return;
+	}
+	m_DeclValid = true;
+	m_pDecl = pDecl;
+	m_FVFValid = false;
+	m_pDevice->SetVertexDeclaration(pDecl);
+}
+
+void StateCacheDevice::SetStreamSourceFreq(unsigned stream, RDWORD setting)
+{
+	++m_Counters.StreamFreqCalls;
+
+	if(stream < MAX_STREAMS)
+	{
+		StreamSlot& slot = m_Streams[stream];
+		if(slot.FreqValid && slot.Freq == setting)
+		{
+			++m_Counters.StreamFreqFiltered;
+			return;
+		}
+		slot.FreqValid = true;
+		slot.Freq = setting;
+	}
+	m_pDevice->SetStreamSourceFreq(stream, setting);
+}
+
+void StateCacheDevice::SetShader(RDShaderType type, IShader* pShader)
+{
+	++m_Counters.ShaderCalls;
+
+	if(m_ShaderValid[type] && m_pShaders[type] == pShader)
+	{
+		++m_Counters.ShaderFiltered;
+		return;
+	}
+	m_ShaderValid[type] = true;
+	m_pShaders[type] = pShader;
+	m_pDevice->SetShader(type, pShader);
+}
+
+void StateCacheDevice::SetTexture(unsigned stage, ITexture* pTexture)
+{
+	++m_Counters.TextureCalls;
+
+	if(stage < RD_MAX_TEXTURE_STAGES)
+	{
+		if(m_TextureValid[stage] && m_pTextures[stage] == pTexture)
+		{
+			++m_Counters.TextureFiltered;
+			return;
+		}
+		m_TextureValid[stage] = true;
+		m_pTextures[stage] = pTexture;
+	}
+	m_pDevice->SetTexture(stage, pTexture);
+}
+
+bool StateCacheDevice::Reset(const RDPresentParams& params)
+{
+	//A reset restores the default device state, so nothing we remember is valid anymore
+	Invalidate();
+	return m_pDevice->Reset(params);
+}
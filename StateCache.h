@@ -0,0 +1,143 @@
+/* Title: DirectX 9.0c Framework
+/* Description: IRenderDevice decorator that shadows device state and drops
+				redundant SetRenderState/SetTransform/SetStreamSource/SetIndices/SetFVF/
+				SetVertexDeclaration/SetStreamSourceFreq/SetShader/SetTexture calls before they reach
+				the driver. Shader constants are forwarded as they come.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+//Calls seen vs calls forwarded, per state category
+struct StateCacheCounters
+{
+	unsigned RenderStateCalls, RenderStateFiltered;
+	unsigned TransformCalls, TransformFiltered;
+	unsigned StreamSourceCalls, StreamSourceFiltered;
+	unsigned IndicesCalls, IndicesFiltered;
+	unsigned FVFCalls, FVFFiltered;
+	unsigned DeclarationCalls, DeclarationFiltered;
+	unsigned StreamFreqCalls, StreamFreqFiltered;
+	unsigned ShaderCalls, ShaderFiltered;
+	unsigned TextureCalls, TextureFiltered;
+
+	unsigned TotalCalls() const
+	{
+		return RenderStateCalls + TransformCalls + StreamSourceCalls + IndicesCalls + FVFCalls + DeclarationCalls +
+			StreamFreqCalls + ShaderCalls + TextureCalls;
+	}
+	unsigned TotalFiltered() const
+	{
+		return RenderStateFiltered + TransformFiltered + StreamSourceFiltered + IndicesFiltered + FVFFiltered +
+			DeclarationFiltered + StreamFreqFiltered + ShaderFiltered + TextureFiltered;
+	}
+};
+
+class StateCacheDevice : public IRenderDevice
+{
+public:
+	//Takes ownership of pDevice
+	explicit StateCacheDevice(IRenderDevice* pDevice);
+	~StateCacheDevice();
+
+	IRenderDevice* GetInnerDevice() const { return m_pDevice; }
+
+	//Forget all shadowed state (call after touching the inner device directly)
+	void Invalidate();
+
+	const StateCacheCounters& GetCounters() const { return m_Counters; }
+	void ResetCounters();
+
+	RDDeviceType GetType() const override { return m_pDevice->GetType(); }
+
+	bool CreateVertexBuffer(unsigned length, RDWORD usage, RDWORD fvf, RDPool pool, IVertexBuffer** ppVB) override;
+	bool CreateIndexBuffer(unsigned length, RDWORD usage, RDIndexFormat format, RDPool pool, IIndexBuffer** ppIB) override;
+	bool CreateReadbackSurface(IReadbackSurface** ppSurface) override { return m_pDevice->CreateReadbackSurface(ppSurface); }
+	bool CreateVertexDeclaration(const RDVertexElement* pElements, IVertexDeclaration** ppDecl) override;
+	bool CreateShader(RDShaderType type, const void* pBytecode, unsigned size, IShader** ppShader) override;
+	bool CreateTexture(unsigned width, unsigned height, ITexture** ppTexture) override;
+
+	void SetViewport(const RDViewport& viewport) override { m_pDevice->SetViewport(viewport); }
+	void SetTransform(RDTransformType type, const float* matrix) override;
+	void SetRenderState(RDRenderState state, RDWORD value) override;
+	void SetStreamSource(unsigned stream, IVertexBuffer* pVB, unsigned offset, unsigned stride) override;
+	void SetIndices(IIndexBuffer* pIB) override;
+	void SetFVF(RDWORD fvf) override;
+	void SetVertexDeclaration(IVertexDeclaration* pDecl) override;
+	void SetStreamSourceFreq(unsigned stream, RDWORD setting) override;
+	void SetShader(RDShaderType type, IShader* pShader) override;
+	void SetShaderConstantF(RDShaderType type, unsigned start, const float* pData, unsigned count) override
+	{
+		m_pDevice->SetShaderConstantF(type, start, pData, count);
+	}
+	void SetTexture(unsigned stage, ITexture* pTexture) override;
+
+	void Clear(RDWORD flags, RDCOLOR color, float z, RDWORD stencil) override { m_pDevice->Clear(flags, color, z, stencil); }
+	void BeginScene() override { m_pDevice->BeginScene(); }
+	void EndScene() override { m_pDevice->EndScene(); }
+	void DrawPrimitive(RDPrimitiveType type, unsigned startVertex, unsigned primCount) override
+	{
+		m_pDevice->DrawPrimitive(type, startVertex, primCount);
+	}
+	void DrawIndexedPrimitive(RDPrimitiveType type, int baseVertexIndex, unsigned minIndex,
+		unsigned numVertices, unsigned startIndex, unsigned primCount) override
+	{
+		m_pDevice->DrawIndexedPrimitive(type, baseVertexIndex, minIndex, numVertices, startIndex, primCount);
+	}
+	void Present() override { m_pDevice->Present(); }
+	bool CopyBackBuffer(IReadbackSurface* pSurface) override { return m_pDevice->CopyBackBuffer(pSurface); }
+
+	bool SupportsInstancing() const override { return m_pDevice->SupportsInstancing(); }
+	bool SupportsShaders() const override { return m_pDevice->SupportsShaders(); }
+	unsigned GetMaxTextureSize() const override { return m_pDevice->GetMaxTextureSize(); }
+
+	RDDeviceState TestCooperativeLevel() override { return m_pDevice->TestCooperativeLevel(); }
+	bool Reset(const RDPresentParams& params) override;
+
+private:
+	//Disallow copying
+	StateCacheDevice(const StateCacheDevice&);
+	StateCacheDevice& operator=(const StateCacheDevice&);
+
+	enum { MAX_STREAMS = 4 };
+
+	//Shadow of a single transform
+	struct TransformSlot
+	{
+		bool Valid;
+		float Matrix[16];
+	};
+
+	struct StreamSlot
+	{
+		bool Valid;
+		IVertexBuffer* pVB;
+		unsigned Offset;
+		unsigned Stride;
+		bool FreqValid;
+		RDWORD Freq;
+	};
+
+	TransformSlot* GetTransformSlot(RDTransformType type);
+
+	IRenderDevice*		m_pDevice;
+	RDWORD				m_RenderStates[RD_RS_MAX];
+	bool				m_RenderStateValid[RD_RS_MAX];
+	TransformSlot		m_World;
+	TransformSlot		m_View;
+	TransformSlot		m_Proj;
+	StreamSlot			m_Streams[MAX_STREAMS];
+	bool				m_IndicesValid;
+	IIndexBuffer*		m_pIndices;
+	bool				m_FVFValid;
+	RDWORD				m_FVF;
+	bool				m_DeclValid;
+	IVertexDeclaration*	m_pDecl;
+	bool				m_ShaderValid[2];	//Per RDShaderType
+	IShader*			m_pShaders[2];
+	bool				m_TextureValid[RD_MAX_TEXTURE_STAGES];
+	ITexture*			m_pTextures[RD_MAX_TEXTURE_STAGES];
+	StateCacheCounters	m_Counters;
+};
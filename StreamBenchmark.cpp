@@ -0,0 +1,209 @@
+#include "StreamBenchmark.h"
+#include "AssetStreamer.h"
+#include "NullRenderDevice.h"
+#include "MeshOptimizer.h"
+#include "VertexLayout.h"
+#include "Timer.h"
+
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char* ARCHIVE_PATH = "stream_benchmark.pak";
+	const char* MALFORMED_PATH = "stream_malformed.pak";
+	const unsigned MESH_COUNT = 48;
+	const unsigned MESH_VERTICES = 65536;
+	const unsigned UPLOAD_BUDGET = 4 * 1024 * 1024;
+
+	bool WriteArchive()
+	{
+		AssetArchiveWriter writer;
+		std::vector<PositionColorVertex> vertices(MESH_VERTICES);
+		std::vector<uint32_t> indices(MESH_VERTICES * 3);
+		for(unsigned mesh = 0; mesh < MESH_COUNT; ++mesh)
+		{
+			for(unsigned i = 0; i < MESH_VERTICES; ++i)
+			{
+				PositionColorVertex v = { (float)i, (float)mesh, 0.0f, mesh * 65536 + i };
+				vertices[i] = v;
+			}
+			for(unsigned i = 0; i < indices.size(); ++i)
+				indices[i] = (i * 7 + mesh) % MESH_VERTICES;
+
+			char name[32];
+			sprintf(name, "mesh%u", mesh);
+			//Every other mesh with compressed indices, decoded by the streamer at upload
+			writer.AddMesh(name, &vertices[0], MESH_VERTICES, sizeof(PositionColorVertex), PositionColorLayout::FVF,
+				&indices[0], (unsigned)indices.size(), RD_FMT_INDEX32, mesh % 2 == 1);
+		}
+		return writer.Write(ARCHIVE_PATH);
+	}
+
+	//Drops the archive from the page cache so the next read comes from the disk
+	void EvictArchive()
+	{
+#ifndef _WIN32
+		int fd = open(ARCHIVE_PATH, O_RDONLY);
+		if(fd >= 0)
+		{
+			fdatasync(fd);
+			posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+			close(fd);
+		}
+#endif
+	}
+
+	//Mesh assets whose headers point past their data must be rejected, not read
+	bool CheckMalformed(FILE* pOut)
+	{
+		PositionColorVertex vertices[3] = { { 0, 0, 0, 0 }, { 1, 0, 0, 0 }, { 0, 1, 0, 0 } };
+		uint16_t indices[3] = { 0, 1, 2 };
+
+		//Header, 3 vertices and 3 indices laid out like AddMesh() does
+		MeshAssetHeader header = { 3, 3, sizeof(PositionColorVertex), PositionColorLayout::FVF, RD_FMT_INDEX16,
+			sizeof(MeshAssetHeader), sizeof(MeshAssetHeader) + sizeof(vertices), 0 };
+		uint8_t asset[sizeof(MeshAssetHeader) + sizeof(vertices) + sizeof(indices)];
+		memcpy(asset + header.VertexOffset, vertices, sizeof(vertices));
+		memcpy(asset + header.IndexOffset, indices, sizeof(indices));
+
+		AssetArchiveWriter writer;
+		memcpy(asset, &header, sizeof(header));
+		bool ok = writer.AddAsset("valid", ASSET_MESH, asset, sizeof(asset));
+		ok = writer.AddAsset("truncated", ASSET_MESH, asset, sizeof(MeshAssetHeader) - 4) && ok;
+		MeshAssetHeader bad = header;
+		bad.VertexCount = 0x40000000;
+		memcpy(asset, &bad, sizeof(bad));
+		ok = writer.AddAsset("vertices", ASSET_MESH, asset, sizeof(asset)) && ok;
+		bad = header;
+		bad.IndexOffset = 0xFFFFFFF0;
+		memcpy(asset, &bad, sizeof(bad));
+		ok = writer.AddAsset("indices", ASSET_MESH, asset, sizeof(asset)) && ok;
+		ok = ok && writer.Write(MALFORMED_PATH);
+
+		AssetArchive archive;
+		AssetStreamer streamer;
+		ok = ok && archive.Open(MALFORMED_PATH) && streamer.Init(&archive, 1);
+		unsigned rejected = 0;
+		for(unsigned i = 0; i < archive.GetEntryCount() && ok; ++i)
+		{
+			rejected += archive.GetMesh(i) ? 0 : 1;
+			streamer.Request(i);
+		}
+		NullRenderDevice device(64, 64);
+		while(ok && streamer.GetStats().Pending > 0)
+			streamer.Pump(&device, 0xFFFFFFFF);
+		StreamStats stats = streamer.GetStats();
+		int valid = archive.Find("valid");
+		ok = ok && rejected == 3 && stats.Failed == 3 && stats.Resident == 1 && valid >= 0 && streamer.GetMesh((unsigned)valid);
+		fprintf(pOut, "Malformed meshes: %u of 3 rejected, %u failed to upload, %u resident%s\n",
+			rejected, stats.Failed, stats.Resident, ok ? "" : "  MISMATCH");
+		streamer.Shutdown();
+		archive.Close();
+		remove(MALFORMED_PATH);
+		return ok;
+	}
+
+	//Compares a device buffer with the archive data
+	bool BufferMatches(IRenderBuffer* pBuffer, const uint8_t* pExpected, unsigned size)
+	{
+		void* pData = NULL;
+		if(!pBuffer || pBuffer->GetSize() != size || !pBuffer->Lock(0, size, &pData, RD_LOCK_READONLY))
+			return false;
+		bool same = memcmp(pData, pExpected, size) == 0;
+		pBuffer->Unlock();
+		return same;
+	}
+}
+
+bool RunStreamBenchmarks(FILE* pOut)
+{
+	fprintf(pOut, "Asset streaming (%u meshes of %u vertices)\n", MESH_COUNT, MESH_VERTICES);
+	if(!WriteArchive())
+	{
+		fprintf(pOut, "Failed to write %s\n", ARCHIVE_PATH);
+		return false;
+	}
+
+	NullRenderDevice device(64, 64);
+	bool ok = true;
+
+	//Everything loaded and uploaded before the first frame
+	{
+		EvictArchive();
+		int64_t start = TimerTicks();
+		AssetArchive archive;
+		AssetStreamer streamer;
+		ok = archive.Open(ARCHIVE_PATH) && streamer.Init(&archive, 1);
+		for(unsigned i = 0; i < archive.GetEntryCount(); ++i)
+			streamer.Request(i);
+		while(streamer.GetStats().Pending > 0)
+			streamer.Pump(&device, 0xFFFFFFFF);
+		StreamStats stats = streamer.GetStats();
+		fprintf(pOut, "Synchronous: first frame after %.1f ms, %.1f MB at %.0f MB/s\n",
+			TicksToMs(TimerTicks() - start), stats.BytesRead / 1e6, stats.ReadMBps);
+	}
+
+	//Streamed: frames start right away and uploads are spread over them
+	{
+		EvictArchive();
+		int64_t start = TimerTicks();
+		AssetArchive archive;
+		AssetStreamer streamer;
+		ok = ok && archive.Open(ARCHIVE_PATH) && streamer.Init(&archive, 2);
+		double firstFrameMs = TicksToMs(TimerTicks() - start);
+		for(unsigned i = 0; i < archive.GetEntryCount(); ++i)
+			streamer.Request(i, -(int)i);
+
+		unsigned frames = 0;
+		std::vector<double> uploadMs;
+		while(streamer.GetStats().Pending > 0)
+		{
+			int64_t frameStart = TimerTicks();
+			streamer.Pump(&device, UPLOAD_BUDGET);
+			uploadMs.push_back(TicksToMs(TimerTicks() - frameStart));
+			++frames;
+			//Stand in for the rest of a 60 Hz frame
+			while(TicksToMs(TimerTicks() - frameStart) < 1000.0 / 60.0)
+				std::this_thread::yield();
+		}
+		StreamStats stats = streamer.GetStats();
+		std::sort(uploadMs.begin(), uploadMs.end());
+		fprintf(pOut, "Streamed: first frame after %.3f ms, all resident after %.1f ms (%u frames), %.1f MB at %.0f MB/s\n",
+			firstFrameMs, stats.AllResidentMs, frames, stats.BytesRead / 1e6, stats.ReadMBps);
+		fprintf(pOut, "Uploads: %.1f MB, %.3f ms median, %.3f ms max per frame, %u hitches over 2 ms (budget %u KB)\n",
+			stats.BytesUploaded / 1e6, uploadMs.empty() ? 0.0 : uploadMs[uploadMs.size() / 2], stats.MaxUploadMs,
+			stats.Hitches, UPLOAD_BUDGET / 1024);
+
+		//Every buffer must hold exactly the archive data
+		std::vector<uint32_t> decoded;
+		for(unsigned i = 0; i < archive.GetEntryCount() && ok; ++i)
+		{
+			const MeshAssetHeader* pHeader = archive.GetMesh(i);
+			const StreamedMesh* pMesh = streamer.GetMesh(i);
+			ok = pHeader && pMesh;
+			const uint8_t* pIndices = ok ? archive.GetData(i) + pHeader->IndexOffset : NULL;
+			if(ok && (pHeader->Flags & MESH_ASSET_COMPRESSED_INDICES))
+			{
+				decoded.resize(pHeader->IndexCount);
+				ok = MeshDecodeIndices(&decoded[0], pHeader->IndexCount, RD_FMT_INDEX32, pIndices,
+					(size_t)(archive.GetEntry(i).Size - pHeader->IndexOffset));
+				pIndices = (const uint8_t*)&decoded[0];
+			}
+			ok = ok &&
+				BufferMatches(pMesh->pVB, archive.GetData(i) + pHeader->VertexOffset, pHeader->VertexCount * pHeader->Stride) &&
+				BufferMatches(pMesh->pIB, pIndices, pHeader->IndexCount * 4);
+		}
+		fprintf(pOut, "Contents %s\n", ok ? "match" : "DIFFER");
+	}
+
+	remove(ARCHIVE_PATH);
+	ok = CheckMalformed(pOut) && ok;
+	return ok;
+}
@@ -0,0 +1,15 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Asset streaming benchmark: writes a test archive of large meshes,
+				then compares loading it synchronously before the first frame with
+				streaming it in the background under a per frame upload budget,
+				and checks that meshes pointing outside of their asset are rejected.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if streamed data does not match the archive
+//or a malformed mesh is uploaded
+bool RunStreamBenchmarks(FILE* pOut);
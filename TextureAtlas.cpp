@@ -0,0 +1,340 @@
+#include "TextureAtlas.h"
+
+#include <string.h>
+#include <algorithm>
+
+TextureAtlas::TextureAtlas()
+{
+	m_pDevice = NULL;
+	m_PageSize = 0;
+	m_MaxPages = 0;
+	m_Padding = 0;
+	m_Frame = 0;
+	m_Inserts = 0;
+	m_FailedInserts = 0;
+	m_Evictions = 0;
+	m_EvictedRegions = 0;
+	m_UploadedBytes = 0;
+}
+
+TextureAtlas::~TextureAtlas()
+{
+	Shutdown();
+}
+
+bool TextureAtlas::Init(IRenderDevice* pDevice, unsigned pageSize, unsigned maxPages, unsigned padding)
+{
+	Shutdown();
+	if(!pDevice || maxPages == 0)
+		return false;
+
+	m_PageSize = std::min(pageSize, pDevice->GetMaxTextureSize());
+	if(m_PageSize <= 2 * padding)
+		return false;
+	m_pDevice = pDevice;
+	m_MaxPages = maxPages;
+	m_Padding = padding;
+	m_Frame = 0;
+	m_Inserts = 0;
+	m_FailedInserts = 0;
+	m_Evictions = 0;
+	m_EvictedRegions = 0;
+	m_UploadedBytes = 0;
+	m_Pages.reserve(maxPages);
+	return true;
+}
+
+void TextureAtlas::Shutdown()
+{
+	for(size_t i = 0; i < m_Pages.size(); ++i)
+		SAFE_RELEASE(m_Pages[i].pTexture);
+	m_Pages.clear();
+	m_Slots.clear();
+	m_FreeSlots.clear();
+	m_pDevice = NULL;
+}
+
+AtlasHandle TextureAtlas::Insert(unsigned width, unsigned height, const RDCOLOR* pPixels, unsigned pitch)
+{
+	if(!m_pDevice || !pPixels || width == 0 || height == 0 || pitch < width)
+		return 0;
+	//Every handle slot in use, checked before any page space is taken
+	if(m_FreeSlots.empty() && m_Slots.size() > SLOT_MASK)
+	{
+		++m_FailedInserts;
+		return 0;
+	}
+
+	unsigned paddedWidth = width + 2 * m_Padding;
+	unsigned paddedHeight = height + 2 * m_Padding;
+	unsigned x = 0, y = 0, node = 0;
+	int page = paddedWidth <= m_PageSize && paddedHeight <= m_PageSize ? FindPage(paddedWidth, paddedHeight, &x, &y, &node) : -1;
+	if(page < 0)
+	{
+		++m_FailedInserts;
+		return 0;
+	}
+
+	AtlasRegion region;
+	region.Page = (unsigned)page;
+	region.X = x + m_Padding;
+	region.Y = y + m_Padding;
+	region.Width = width;
+	region.Height = height;
+	float scale = 1.0f / (float)m_PageSize;
+	region.U0 = region.X * scale;
+	region.V0 = region.Y * scale;
+	region.U1 = (region.X + width) * scale;
+	region.V1 = (region.Y + height) * scale;
+	if(!Upload(region, pPixels, pitch))
+	{
+		++m_FailedInserts;
+		return 0;
+	}
+
+	Page& target = m_Pages[page];
+	AddSkylineLevel(target, node, x, y, paddedWidth, paddedHeight);
+	++target.Regions;
+	target.UsedPixels += (uint64_t)width * height;
+	target.LastUsed = m_Frame;
+
+	unsigned slot = 0;
+	if(m_FreeSlots.empty())
+	{
+		slot = (unsigned)m_Slots.size();
+		Slot empty;
+		empty.Generation = 0;
+		m_Slots.push_back(empty);
+	}
+	else
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	m_Slots[slot].Region = region;
+	++m_Slots[slot].Generation;
+	++m_Inserts;
+	return slot | (m_Slots[slot].Generation << SLOT_BITS);
+}
+
+void TextureAtlas::Remove(AtlasHandle handle)
+{
+	if(!Find(handle))
+		return;
+
+	unsigned slot = handle & SLOT_MASK;
+	Page& page = m_Pages[m_Slots[slot].Region.Page];
+	FreeSlot(slot);
+
+	//Holes under the skyline can not be reused, an empty page can
+	if(page.Regions == 0)
+	{
+		page.Skyline.clear();
+		SkylineNode all = { 0, 0, m_PageSize };
+		page.Skyline.push_back(all);
+	}
+}
+
+const AtlasRegion* TextureAtlas::Find(AtlasHandle handle) const
+{
+	unsigned slot = handle & SLOT_MASK;
+	if(slot >= m_Slots.size())
+		return NULL;
+	const Slot& entry = m_Slots[slot];
+	if(!(entry.Generation & 1) || (entry.Generation << SLOT_BITS) != (handle & ~(uint32_t)SLOT_MASK))
+		return NULL;
+	return &entry.Region;
+}
+
+const AtlasRegion* TextureAtlas::Use(AtlasHandle handle)
+{
+	const AtlasRegion* pRegion = Find(handle);
+	if(pRegion)
+		m_Pages[pRegion->Page].LastUsed = m_Frame;
+	return pRegion;
+}
+
+AtlasStats TextureAtlas::GetStats() const
+{
+	AtlasStats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.Pages = (unsigned)m_Pages.size();
+	for(size_t i = 0; i < m_Pages.size(); ++i)
+	{
+		stats.Regions += m_Pages[i].Regions;
+		stats.UsedPixels += m_Pages[i].UsedPixels;
+	}
+	stats.PagePixels = (uint64_t)m_PageSize * m_PageSize * m_Pages.size();
+	stats.Inserts = m_Inserts;
+	stats.FailedInserts = m_FailedInserts;
+	stats.Evictions = m_Evictions;
+	stats.EvictedRegions = m_EvictedRegions;
+	stats.UploadedBytes = m_UploadedBytes;
+	return stats;
+}
+
+bool TextureAtlas::FindPosition(const Page& page, unsigned width, unsigned height, unsigned* pX, unsigned* pY, unsigned* pNode) const
+{
+	//Lowest top edge wins, then the narrowest node (leaves wide nodes for wide images)
+	unsigned bestTop = ~0u;
+	unsigned bestWidth = ~0u;
+	const std::vector<SkylineNode>& skyline = page.Skyline;
+	for(size_t i = 0; i < skyline.size(); ++i)
+	{
+		unsigned x = skyline[i].X;
+		if(x + width > m_PageSize)
+			break;
+
+		//Resting on the highest node under the rectangle
+		unsigned y = 0;
+		unsigned covered = 0;
+		for(size_t j = i; covered < width; ++j)
+		{
+			y = std::max(y, skyline[j].Y);
+			covered += skyline[j].Width;
+		}
+		if(y + height > m_PageSize)
+			continue;
+
+		if(y + height < bestTop || (y + height == bestTop && skyline[i].Width < bestWidth))
+		{
+			bestTop = y + height;
+			bestWidth = skyline[i].Width;
+			*pX = x;
+			*pY = y;
+			*pNode = (unsigned)i;
+		}
+	}
+	return bestTop != ~0u;
+}
+
+void TextureAtlas::AddSkylineLevel(Page& page, unsigned node, unsigned x, unsigned y, unsigned width, unsigned height)
+{
+	std::vector<SkylineNode>& skyline = page.Skyline;
+	SkylineNode level = { x, y + height, width };
+	skyline.insert(skyline.begin() + node, level);
+
+	//Nodes under the new level shrink or disappear
+	for(size_t i = node + 1; i < skyline.size(); )
+	{
+		unsigned end = skyline[i - 1].X + skyline[i - 1].Width;
+		if(skyline[i].X >= end)
+			break;
+		unsigned shrink = end - skyline[i].X;
+		if(skyline[i].Width <= shrink)
+		{
+			skyline.erase(skyline.begin() + i);
+			continue;
+		}
+		skyline[i].X += shrink;
+		skyline[i].Width -= shrink;
+		break;
+	}
+
+	//Neighbours at the same height become one node
+	for(size_t i = 0; i + 1 < skyline.size(); )
+	{
+		if(skyline[i].Y == skyline[i + 1].Y)
+		{
+			skyline[i].Width += skyline[i + 1].Width;
+			skyline.erase(skyline.begin() + i + 1);
+		}
+		else
+			++i;
+	}
+}
+
+void TextureAtlas::ClearPage(unsigned page)
+{
+	for(size_t i = 0; i < m_Slots.size(); ++i)
+	{
+		if((m_Slots[i].Generation & 1) && m_Slots[i].Region.Page == page)
+		{
+			FreeSlot((unsigned)i);
+			++m_EvictedRegions;
+		}
+	}
+	m_Pages[page].Skyline.clear();
+	SkylineNode all = { 0, 0, m_PageSize };
+	m_Pages[page].Skyline.push_back(all);
+	++m_Evictions;
+}
+
+int TextureAtlas::FindPage(unsigned width, unsigned height, unsigned* pX, unsigned* pY, unsigned* pNode)
+{
+	for(size_t i = 0; i < m_Pages.size(); ++i)
+	{
+		if(FindPosition(m_Pages[i], width, height, pX, pY, pNode))
+			return (int)i;
+	}
+
+	//A new page, as long as there may be more
+	if(m_Pages.size() < m_MaxPages)
+	{
+		Page page;
+		page.pTexture = NULL;
+		page.Regions = 0;
+		page.UsedPixels = 0;
+		page.LastUsed = m_Frame;
+		if(m_pDevice->CreateTexture(m_PageSize, m_PageSize, &page.pTexture))
+		{
+			SkylineNode all = { 0, 0, m_PageSize };
+			page.Skyline.push_back(all);
+			m_Pages.push_back(page);
+			FindPosition(m_Pages.back(), width, height, pX, pY, pNode);
+			return (int)m_Pages.size() - 1;
+		}
+	}
+
+	//Otherwise the least recently used page, unless this frame's sprites are on it
+	int oldest = -1;
+	for(size_t i = 0; i < m_Pages.size(); ++i)
+	{
+		if(m_Pages[i].LastUsed != m_Frame && (oldest < 0 || m_Pages[i].LastUsed < m_Pages[oldest].LastUsed))
+			oldest = (int)i;
+	}
+	if(oldest < 0)
+		return -1;
+	ClearPage(oldest);
+	FindPosition(m_Pages[oldest], width, height, pX, pY, pNode);
+	return oldest;
+}
+
+void TextureAtlas::FreeSlot(unsigned slot)
+{
+	Slot& entry = m_Slots[slot];
+	Page& page = m_Pages[entry.Region.Page];
+	--page.Regions;
+	page.UsedPixels -= (uint64_t)entry.Region.Width * entry.Region.Height;
+	++entry.Generation;
+	m_FreeSlots.push_back(slot);
+}
+
+bool TextureAtlas::Upload(const AtlasRegion& region, const RDCOLOR* pPixels, unsigned pitch)
+{
+	ITexture* pTexture = m_Pages[region.Page].pTexture;
+	if(m_Padding == 0)
+	{
+		m_UploadedBytes += (uint64_t)region.Width * region.Height * sizeof(RDCOLOR);
+		return pTexture->Update(region.X, region.Y, region.Width, region.Height, pPixels, pitch);
+	}
+
+	//Padding repeats the edge pixels, so filtering at the edges samples the image itself
+	unsigned width = region.Width + 2 * m_Padding;
+	unsigned height = region.Height + 2 * m_Padding;
+	m_Scratch.resize((size_t)width * height);
+	for(unsigned y = 0; y < height; ++y)
+	{
+		unsigned sourceY = (unsigned)std::min(std::max((int)y - (int)m_Padding, 0), (int)region.Height - 1);
+		const RDCOLOR* pSource = pPixels + (size_t)sourceY * pitch;
+		RDCOLOR* pDest = &m_Scratch[(size_t)y * width];
+		for(unsigned x = 0; x < m_Padding; ++x)
+		{
+			pDest[x] = pSource[0];
+			pDest[width - 1 - x] = pSource[region.Width - 1];
+		}
+		memcpy(pDest + m_Padding, pSource, region.Width * sizeof(RDCOLOR));
+	}
+	m_UploadedBytes += (uint64_t)width * height * sizeof(RDCOLOR);
+	return pTexture->Update(region.X - m_Padding, region.Y - m_Padding, width, height, &m_Scratch[0], width);
+}
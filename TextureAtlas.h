@@ -0,0 +1,130 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Runtime texture atlas for small images (UI icons, glyphs, 2D
+				overlays). Images are packed into fixed size pages with the
+				skyline bottom-left heuristic as they arrive and uploaded right
+				away, padded with copies of their edge pixels so filtering does
+				not bleed between neighbours. A skyline can not reuse holes:
+				removed regions only free their page once it is empty. When no
+				page has room and no new page may be created, the least recently
+				used page (not used this frame) is evicted as a whole and its
+				handles go stale, so caches re-insert what they still need.
+				Pages are managed textures and survive device resets.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+
+//Region of an atlas: slot in the low 20 bits, generation above, 0 for none
+typedef uint32_t AtlasHandle;
+
+//Placement of an image in its page, without the padding
+struct AtlasRegion
+{
+	unsigned	Page;
+	unsigned	X, Y;
+	unsigned	Width, Height;
+	float		U0, V0, U1, V1;		//Texture coordinates of the edges
+};
+
+struct AtlasStats
+{
+	unsigned	Pages;
+	unsigned	Regions;			//Live
+	uint64_t	UsedPixels;			//Area of the live regions
+	uint64_t	PagePixels;			//Area of all pages
+	unsigned	Inserts;			//Since Init()
+	unsigned	FailedInserts;		//Larger than a page, or no page could be freed
+	unsigned	Evictions;			//Pages cleared to make room
+	unsigned	EvictedRegions;
+	uint64_t	UploadedBytes;
+
+	//Share of the page area covered by live regions
+	double Occupancy() const { return PagePixels ? (double)UsedPixels / (double)PagePixels : 0.0; }
+};
+
+class TextureAtlas
+{
+public:
+	TextureAtlas();
+	~TextureAtlas();
+
+	//Pages are pageSize square (at most the device's texture size) and created
+	//when the existing ones are full. padding pixels surround every region.
+	bool Init(IRenderDevice* pDevice, unsigned pageSize = 1024, unsigned maxPages = 4, unsigned padding = 1);
+	void Shutdown();
+
+	//Starts a new frame: pages used from now on are safe from eviction
+	void BeginFrame() { ++m_Frame; }
+
+	//Packs and uploads a width x height image (pitch in pixels). Returns 0 if it
+	//does not fit into a page, or every page was used this frame.
+	AtlasHandle Insert(unsigned width, unsigned height, const RDCOLOR* pPixels, unsigned pitch);
+	void Remove(AtlasHandle handle);
+
+	//NULL once the region was removed or evicted. Use() marks its page as used this frame.
+	const AtlasRegion* Find(AtlasHandle handle) const;
+	const AtlasRegion* Use(AtlasHandle handle);
+
+	unsigned GetPageCount() const { return (unsigned)m_Pages.size(); }
+	ITexture* GetPageTexture(unsigned page) const { return m_Pages[page].pTexture; }
+	unsigned GetPageSize() const { return m_PageSize; }
+
+	AtlasStats GetStats() const;
+
+private:
+	//Disallow copying
+	TextureAtlas(const TextureAtlas&);
+	TextureAtlas& operator=(const TextureAtlas&);
+
+	enum { SLOT_BITS = 20, SLOT_MASK = (1 << SLOT_BITS) - 1 };
+
+	//Top of the packed area from X to X + Width
+	struct SkylineNode
+	{
+		unsigned	X, Y, Width;
+	};
+
+	struct Page
+	{
+		ITexture*					pTexture;
+		std::vector<SkylineNode>	Skyline;
+		unsigned					Regions;
+		uint64_t					UsedPixels;
+		unsigned					LastUsed;		//Frame
+	};
+
+	struct Slot
+	{
+		AtlasRegion		Region;
+		uint32_t		Generation;		//Odd while the slot holds a region
+	};
+
+	//Bottom-left placement of a padded rectangle, false if the page has no room
+	bool FindPosition(const Page& page, unsigned width, unsigned height, unsigned* pX, unsigned* pY, unsigned* pNode) const;
+	void AddSkylineLevel(Page& page, unsigned node, unsigned x, unsigned y, unsigned width, unsigned height);
+	void ClearPage(unsigned page);
+	//Page with room for the padded rectangle, creating or evicting one if needed, -1 if there is none
+	int FindPage(unsigned width, unsigned height, unsigned* pX, unsigned* pY, unsigned* pNode);
+	void FreeSlot(unsigned slot);
+	bool Upload(const AtlasRegion& region, const RDCOLOR* pPixels, unsigned pitch);
+
+	IRenderDevice*			m_pDevice;
+	unsigned				m_PageSize;
+	unsigned				m_MaxPages;
+	unsigned				m_Padding;
+	unsigned				m_Frame;
+	std::vector<Page>		m_Pages;
+	std::vector<Slot>		m_Slots;
+	std::vector<unsigned>	m_FreeSlots;
+	std::vector<RDCOLOR>	m_Scratch;		//Padded copy of the image being uploaded
+
+	unsigned				m_Inserts;
+	unsigned				m_FailedInserts;
+	unsigned				m_Evictions;
+	unsigned				m_EvictedRegions;
+	uint64_t				m_UploadedBytes;
+};
@@ -0,0 +1,50 @@
+/* Title: DirectX 9.0c Framework
+/* Description: High resolution monotonic timer
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//Current value of the high resolution counter (QueryPerformanceCounter on Windows)
+inline int64_t TimerTicks()
+{
+#ifdef _WIN32
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return count.QuadPart;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+//Counts per second of TimerTicks()
+inline int64_t TimerFrequency()
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	return freq.QuadPart;
+#else
+	return 1000000000;
+#endif
+}
+
+//Converts a tick count to milliseconds
+inline double TicksToMs(int64_t ticks)
+{
+	static const double msPerTick = 1000.0 / (double)TimerFrequency();
+	return ticks * msPerTick;
+}
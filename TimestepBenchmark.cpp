@@ -0,0 +1,90 @@
+#include "TimestepBenchmark.h"
+#include "FixedTimestep.h"
+#include "SimdMath.h"
+#include "Timer.h"
+
+namespace
+{
+	const unsigned RATE = 120;
+	const double STEP_COST_MS = 10.0;	//Update cost per step, more than a step simulates
+	const double RENDER_MS = 4.0;
+	const unsigned LOAD_FRAMES = 60;
+
+	struct LoadResult
+	{
+		double		MaxFrameMs;
+		double		LastFrameMs;
+		uint64_t	Dropped;
+	};
+
+	//Frames under load: each frame lasts the render time plus the cost of its steps,
+	//and the next frame has to simulate that much time
+	LoadResult RunUnderLoad(unsigned maxSteps)
+	{
+		FixedTimestep timestep;
+		timestep.SetRate(RATE, maxSteps);
+		int64_t frequency = TimerFrequency();
+		double frameMs = 1000.0 / 60.0;
+		LoadResult result = { 0.0, 0.0, 0 };
+		for(unsigned frame = 0; frame < LOAD_FRAMES; ++frame)
+		{
+			unsigned steps = timestep.AdvanceBy((int64_t)(frameMs * frequency / 1000.0));
+			frameMs = RENDER_MS + steps * STEP_COST_MS;
+			result.MaxFrameMs = frameMs > result.MaxFrameMs ? frameMs : result.MaxFrameMs;
+		}
+		result.LastFrameMs = frameMs;
+		result.Dropped = timestep.GetStats().DroppedSteps;
+		return result;
+	}
+}
+
+bool RunTimestepBenchmarks(FILE* pOut)
+{
+	fprintf(pOut, "Fixed timestep (%u Hz)\n", RATE);
+	int64_t frequency = TimerFrequency();
+
+	//An hour of frames between 4 and 20 ms, all steps within the catch-up limit
+	FixedTimestep timestep;
+	timestep.SetRate(RATE, 4);
+	uint32_t seed = 77;
+	int64_t elapsed = 0;
+	bool alphaOk = true;
+	unsigned frames = 0;
+	while(elapsed < 3600 * frequency)
+	{
+		int64_t frameTicks = frequency / 250 + (int64_t)(RandomBits(seed) % 4096) * (frequency / 256000);
+		elapsed += frameTicks;
+		timestep.AdvanceBy(frameTicks);
+		float alpha = timestep.GetAlpha();
+		alphaOk = alphaOk && alpha >= 0.0f && alpha < 1.0f;
+		++frames;
+	}
+	const TimestepStats& stats = timestep.GetStats();
+	uint64_t expected = (uint64_t)(elapsed / frequency) * RATE + (uint64_t)(elapsed % frequency * RATE / frequency);
+	bool exact = stats.Steps == expected && stats.DroppedSteps == 0;
+	fprintf(pOut, "1 hour of jittery frames: %u frames, %llu steps (expected %llu), %u frames without a step, alpha %s\n",
+		frames, (unsigned long long)stats.Steps, (unsigned long long)expected, stats.IdleFrames, alphaOk ? "in range" : "OUT OF RANGE");
+
+	//Time kept the old way: float seconds per count times float deltas, summed in a float
+	float secPerCount = 1.0f / (float)frequency;
+	float floatTime = 0.0f;
+	int64_t frameTicks = frequency / 144;
+	const unsigned DAY_FRAMES = 144 * 3600 * 24;
+	for(unsigned frame = 0; frame < DAY_FRAMES; ++frame)
+		floatTime += (float)frameTicks * secPerCount;
+	double exactTime = (double)frameTicks * DAY_FRAMES / frequency;
+	fprintf(pOut, "Float clock after a day at 144 fps: %.0f s instead of %.0f s, integer steps stay exact\n",
+		floatTime, exactTime);
+
+	//Steps costing more than they simulate: 4 steps at most vs no limit
+	LoadResult limited = RunUnderLoad(4);
+	LoadResult unlimited = RunUnderLoad(1000000);
+	fprintf(pOut, "Steps costing %.1f ms each: limit 4 -> frames up to %.1f ms, %llu steps dropped; "
+		"no limit -> frames up to %.0f ms (spiral of death)\n", STEP_COST_MS, limited.MaxFrameMs,
+		(unsigned long long)limited.Dropped, unlimited.MaxFrameMs);
+
+	bool ok = exact && alphaOk && limited.MaxFrameMs <= RENDER_MS + 4 * STEP_COST_MS + 0.001 &&
+		unlimited.LastFrameMs > limited.MaxFrameMs * 10.0;
+	fprintf(pOut, "Fixed timestep %s\n", ok ? "works" : "FAILED");
+	return ok;
+}
@@ -0,0 +1,16 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Fixed timestep benchmark, on simulated time so it is exact and
+				repeatable: checks that an hour of jittery frames gives exactly
+				the steps the elapsed time holds, that every alpha is within
+				0 .. 1, and that the catch-up limit keeps frames bounded when
+				steps cost more than they simulate, where unlimited catch-up
+				spirals. Also shows how far a float clock drifts in a day.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunTimestepBenchmarks(FILE* pOut);
@@ -0,0 +1,212 @@
+#include "VertexBenchmark.h"
+#include "VertexLayout.h"
+#include "SimdMath.h"
+#include "NullRenderDevice.h"
+#include "SoftwareRenderDevice.h"
+#include "Timer.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const unsigned VERTICES = 1000000;
+	const unsigned FRAMES = 10;
+	const float EXTENT = 50.0f;		//Positions within -EXTENT..EXTENT
+
+	typedef VertexLayout<VA_Position<>, VA_Normal<>, VA_Color<0>, VA_TexCoord<0> > MeshLayout;
+	typedef MeshLayout::Half MeshHalf;
+	typedef MeshLayout::Quantized MeshQuantized;
+
+	static_assert(MeshLayout::STRIDE == 36 && MeshHalf::STRIDE == 24 && MeshQuantized::STRIDE == 20, "Unexpected vertex sizes");
+	static_assert(MeshLayout::FVF == (RD_FVF_XYZ | RD_FVF_NORMAL | RD_FVF_DIFFUSE | RD_FVF_TEX1), "Float layout must match its FVF");
+	static_assert(MeshHalf::FVF == 0 && MeshQuantized::FVF == 0, "Packed layouts have no FVF");
+	static_assert(MeshLayout::Offset<RD_DECLUSAGE_TEXCOORD>::Value == 28 && MeshQuantized::Offset<RD_DECLUSAGE_COLOR>::Value == 12 &&
+		MeshLayout::Offset<RD_DECLUSAGE_COLOR, 1>::Value == -1, "Unexpected attribute offsets");
+	//Out of FVF order, and texture coordinates that skip an index
+	static_assert(VertexLayout<VA_Color<0>, VA_Position<> >::FVF == 0 && VertexLayout<VA_Position<>, VA_TexCoord<1> >::FVF == 0,
+		"Layouts without an FVF must say so");
+
+	//Components in layout order: position x y z, normal x y z, color r g b a, u v
+	enum { POSITION = 0, NORMAL = 3, COLOR = 6, TEXCOORD = 10, COMPONENTS = 12 };
+	static_assert((int)MeshLayout::COMPONENTS == COMPONENTS, "Mesh components must match the layout");
+
+	struct Mesh
+	{
+		std::vector<float>	Components[COMPONENTS];
+		const float*		Read[COMPONENTS];
+		float*				Write[COMPONENTS];
+	};
+
+	void InitMesh(Mesh* pMesh, bool fill)
+	{
+		for(unsigned c = 0; c < COMPONENTS; ++c)
+		{
+			pMesh->Components[c].assign(VERTICES, 0.0f);
+			pMesh->Read[c] = &pMesh->Components[c][0];
+			pMesh->Write[c] = &pMesh->Components[c][0];
+		}
+		if(!fill)
+			return;
+
+		//Points on a bumpy sphere with their normals, colors and spherical texture coordinates
+		uint32_t seed = 42;
+		for(unsigned i = 0; i < VERTICES; ++i)
+		{
+			float u = RandomFloat(seed), v = RandomFloat(seed);
+			float theta = u * 6.2831853f, phi = (v - 0.5f) * 3.1415926f;
+			float nx = cosf(phi) * cosf(theta), ny = sinf(phi), nz = cosf(phi) * sinf(theta);
+			float radius = EXTENT * (0.8f + 0.2f * RandomFloat(seed));
+			float values[COMPONENTS] = { nx * radius, ny * radius, nz * radius, nx, ny, nz,
+				RandomFloat(seed), RandomFloat(seed), RandomFloat(seed), 1.0f, u, v };
+			for(unsigned c = 0; c < COMPONENTS; ++c)
+				pMesh->Components[c][i] = values[c];
+		}
+	}
+
+	struct VariantResult
+	{
+		unsigned	Stride;
+		double		PackMs;
+		double		UnpackMs;
+		double		UploadMs;
+		float		MaxError[4];	//Position (relative to the extent), normal, color, texture coordinates
+		bool		NullDecl;
+		bool		SoftwareDecl;
+	};
+
+	template<typename Layout>
+	VariantResult RunVariant(NullRenderDevice& device, SoftwareRenderDevice& software, const Mesh& mesh, Mesh* pRoundTrip)
+	{
+		VariantResult result;
+		memset(&result, 0, sizeof(result));
+		result.Stride = Layout::STRIDE;
+		std::vector<uint8_t> vertices((size_t)VERTICES * Layout::STRIDE);
+
+		int64_t start = TimerTicks();
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+			Layout::FromSoA(mesh.Read, VERTICES, &vertices[0]);
+		result.PackMs = TicksToMs(TimerTicks() - start) / FRAMES;
+
+		start = TimerTicks();
+		for(unsigned frame = 0; frame < FRAMES; ++frame)
+			Layout::ToSoA(&vertices[0], VERTICES, pRoundTrip->Write);
+		result.UnpackMs = TicksToMs(TimerTicks() - start) / FRAMES;
+
+		//Converting straight into the locked buffer, as a dynamic mesh would every frame
+		IVertexBuffer* pVB = NULL;
+		if(device.CreateVertexBuffer(VERTICES * Layout::STRIDE, RD_USAGE_DYNAMIC | RD_USAGE_WRITEONLY, Layout::FVF, RD_POOL_DEFAULT, &pVB))
+		{
+			start = TimerTicks();
+			for(unsigned frame = 0; frame < FRAMES; ++frame)
+			{
+				void* pData = NULL;
+				if(!pVB->Lock(0, VERTICES * Layout::STRIDE, &pData, RD_LOCK_DISCARD))
+					break;
+				Layout::FromSoA(mesh.Read, VERTICES, pData);
+				pVB->Unlock();
+			}
+			result.UploadMs = TicksToMs(TimerTicks() - start) / FRAMES;
+			pVB->Release();
+		}
+
+		static const unsigned groups[5] = { POSITION, NORMAL, COLOR, TEXCOORD, COMPONENTS };
+		for(unsigned g = 0; g < 4; ++g)
+		{
+			float maxError = 0.0f;
+			for(unsigned c = groups[g]; c < groups[g + 1]; ++c)
+			{
+				for(unsigned i = 0; i < VERTICES; ++i)
+				{
+					float error = fabsf(pRoundTrip->Components[c][i] - mesh.Components[c][i]);
+					maxError = error > maxError ? error : maxError;
+				}
+			}
+			result.MaxError[g] = g == 0 ? maxError / EXTENT : maxError;
+		}
+
+		IVertexDeclaration* pDecl = NULL;
+		result.NullDecl = device.CreateVertexDeclaration(Layout::Elements, &pDecl);
+		if(pDecl)
+			pDecl->Release();
+		pDecl = NULL;
+		result.SoftwareDecl = software.CreateVertexDeclaration(Layout::Elements, &pDecl);
+		if(pDecl)
+			pDecl->Release();
+		return result;
+	}
+
+	//Largest errors the storage allows (plus float slack)
+	bool WithinError(const VariantResult& result, const float* pLimits)
+	{
+		for(unsigned g = 0; g < 4; ++g)
+		{
+			if(!(result.MaxError[g] <= pLimits[g] * 1.01f))
+				return false;
+		}
+		return true;
+	}
+
+	void PrintVariant(FILE* pOut, const char* pName, unsigned fvf, const VariantResult& result, bool valid)
+	{
+		double bytes = (double)VERTICES * result.Stride;
+		fprintf(pOut, "%-10s %2u bytes, FVF 0x%03x, %6.2f MB per frame (%6.1f MB/s at 60 fps)\n", pName, result.Stride, fvf,
+			bytes / (1024.0 * 1024.0), bytes * 60.0 / (1024.0 * 1024.0));
+		fprintf(pOut, "           SoA to AoS %7.3f ms (%6.1f M verts/s, %5.2f GB/s written), AoS to SoA %7.3f ms (%6.1f M verts/s), "
+			"into a locked buffer %7.3f ms\n", result.PackMs, VERTICES / result.PackMs / 1000.0, bytes / result.PackMs / 1e6,
+			result.UnpackMs, VERTICES / result.UnpackMs / 1000.0, result.UploadMs);
+		fprintf(pOut, "           max error: position %.2e of the extent, normal %.2e, color %.2e, uv %.2e; declaration on null %s, "
+			"software %s%s\n", result.MaxError[0], result.MaxError[1], result.MaxError[2], result.MaxError[3],
+			result.NullDecl ? "yes" : "no", result.SoftwareDecl ? "yes" : "no", valid ? "" : "  INVALID");
+	}
+}
+
+bool RunVertexBenchmarks(FILE* pOut)
+{
+	NullRenderDevice device(64, 64);
+	SoftwareRenderDevice software(64, 64, 1);
+	Mesh mesh, roundTrip;
+	InitMesh(&mesh, true);
+	InitMesh(&roundTrip, false);
+
+	fprintf(pOut, "%u vertices (position, normal, color, uv), %u frames\n", VERTICES, FRAMES);
+
+	//Floats are exact, colors are bytes everywhere. Halves keep 11 significant bits,
+	//biased byte normals are within a step of 2/255, normalized shorts within half a step of 1/32767.
+	const float colorError = 0.5f / 255.0f;
+	const float floatLimits[4] = { 0.0f, 0.0f, colorError, 0.0f };
+	const float halfLimits[4] = { 1.0f / 2048.0f, 1.0f / 2048.0f, colorError, 1.0f / 2048.0f };
+	const float quantizedLimits[4] = { 1.0f / 2048.0f, 1.0f / 255.0f, colorError, 0.5f / 32767.0f };
+
+	VariantResult full = RunVariant<MeshLayout>(device, software, mesh, &roundTrip);
+	bool fullOk = WithinError(full, floatLimits) && full.NullDecl && full.SoftwareDecl;
+	PrintVariant(pOut, "Float", MeshLayout::FVF, full, fullOk);
+
+	VariantResult half = RunVariant<MeshHalf>(device, software, mesh, &roundTrip);
+	bool halfOk = WithinError(half, halfLimits) && half.NullDecl && !half.SoftwareDecl;
+	PrintVariant(pOut, "Half", MeshHalf::FVF, half, halfOk);
+
+	VariantResult quantized = RunVariant<MeshQuantized>(device, software, mesh, &roundTrip);
+	bool quantizedOk = WithinError(quantized, quantizedLimits) && quantized.NullDecl && !quantized.SoftwareDecl;
+	PrintVariant(pOut, "Quantized", MeshQuantized::FVF, quantized, quantizedOk);
+
+	fprintf(pOut, "Upload per frame: half %.0f%%, quantized %.0f%% of float\n", 100.0 * half.Stride / full.Stride,
+		100.0 * quantized.Stride / full.Stride);
+
+	//Half conversions agree with the definition at the edges
+	bool halves = FloatToHalf(1.0f) == 0x3c00 && FloatToHalf(-2.0f) == 0xc000 && FloatToHalf(65504.0f) == 0x7bff &&
+		FloatToHalf(65520.0f) == 0x7c00 && FloatToHalf(5.96046448e-8f) == 0x0001 && FloatToHalf(1.0f + 1.0f / 4096.0f) == 0x3c00 &&
+		HalfToFloat(0x3555) == 0.333251953125f && HalfToFloat(0x0001) == 5.96046448e-8f && HalfToFloat(0xfc00) == -HUGE_VALF;
+	float edges[8] = { 0.0f, -0.0f, 1e-6f, -1e-5f, 65504.0f, 70000.0f, 0.1f, -3.14159f };
+	const float* pEdges = edges;
+	uint16_t packed[8];
+	VertexPackHalf(&pEdges, 1, 1, 8, (uint8_t*)packed, 2);
+	for(unsigned i = 0; i < 8; ++i)
+		halves = halves && packed[i] == FloatToHalf(edges[i]);
+	fprintf(pOut, "Half conversion %s\n", halves ? "matches the reference values" : "DIFFERS FROM THE REFERENCE VALUES");
+
+	bool ok = fullOk && halfOk && quantizedOk && halves;
+	fprintf(pOut, "Vertex layouts %s\n", ok ? "work" : "FAILED");
+	return ok;
+}
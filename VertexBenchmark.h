@@ -0,0 +1,17 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Vertex layout benchmark: a mesh of 1M vertices with position,
+				normal, color and texture coordinates, held as structure of
+				arrays, converted to the float, half and quantized variants of
+				its layout. Reports the bytes each variant uploads per frame,
+				the conversion throughput both ways, the cost of filling a locked
+				dynamic vertex buffer of the null device, the largest round trip
+				error per attribute, and which devices accept each declaration.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include <stdio.h>
+
+//Prints the results to pOut, returns false if a check failed
+bool RunVertexBenchmarks(FILE* pOut);
@@ -0,0 +1,328 @@
+#include "VertexLayout.h"
+#include "SimdMath.h"
+
+#include <string.h>
+
+namespace
+{
+	uint32_t FloatBits(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	float BitsFloat(uint32_t bits)
+	{
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//Value of stored component c when the source has fewer
+	float PadValue(unsigned c)
+	{
+		return c == 3 ? 1.0f : 0.0f;
+	}
+
+	float Clamp(float value, float low, float high)
+	{
+		return value < low ? low : value > high ? high : value;
+	}
+
+	int16_t FloatToShortN(float value)
+	{
+		float scaled = Clamp(value, -1.0f, 1.0f) * 32767.0f;
+		return (int16_t)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+	}
+
+	uint8_t FloatToUByteN(float value)
+	{
+		return (uint8_t)(Clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+#ifdef SIMDMATH_SSE
+	//Four floats to halves in the low 16 bits of each lane, round to nearest even
+	//(the integer version of FloatToHalf, specials included)
+	__m128i FloatToHalf4(__m128 value)
+	{
+		const __m128i signMask = _mm_set1_epi32((int)0x80000000u);
+		const __m128i halfMax = _mm_set1_epi32((127 + 16) << 23);		//Everything from here is infinity
+		const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);		//Smallest float that gives a normal half
+		const __m128i denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+		__m128 sign = _mm_and_ps(_mm_castsi128_ps(signMask), value);
+		__m128 absValue = _mm_xor_ps(value, sign);
+		__m128i absBits = _mm_castps_si128(absValue);
+		__m128i isNaN = _mm_castps_si128(_mm_cmpunord_ps(absValue, absValue));
+		__m128i isFinite = _mm_cmpgt_epi32(halfMax, absBits);
+		__m128i special = _mm_or_si128(_mm_and_si128(isNaN, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+
+		//Denormal halves: the float add rounds the mantissa into place
+		__m128i isDenormal = _mm_cmpgt_epi32(minNormal, absBits);
+		__m128i denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absValue, _mm_castsi128_ps(denormMagic))), denormMagic);
+
+		//Normal halves: rebias the exponent, round half to even through the lowest kept bit
+		__m128i odd = _mm_srai_epi32(_mm_slli_epi32(absBits, 31 - 13), 31);
+		__m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absBits, normalBias), odd), 13);
+
+		__m128i finite = _mm_or_si128(_mm_and_si128(isDenormal, denormal), _mm_andnot_si128(isDenormal, normal));
+		__m128i result = _mm_or_si128(_mm_and_si128(isFinite, finite), _mm_andnot_si128(isFinite, special));
+		return _mm_or_si128(result, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+	}
+
+	//Four floats to normalized shorts in the low 16 bits of each lane
+	__m128i FloatToShortN4(__m128 value)
+	{
+		__m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+		//cvtps rounds to nearest even where the scalar path rounds half away, both are within half a step
+		return _mm_cvtps_epi32(_mm_mul_ps(clamped, _mm_set1_ps(32767.0f)));
+	}
+
+	//Converts four vertices at a time from contiguous components, then scatters the 16 bit results
+	template<__m128i (*Convert)(__m128), uint16_t (*ConvertOne)(float)>
+	unsigned Pack16(const float* const* ppSrc, unsigned components, unsigned stored, unsigned count, uint8_t* pDst, unsigned stride)
+	{
+		uint16_t pad[4];
+		for(unsigned c = 0; c < 4; ++c)
+			pad[c] = ConvertOne(PadValue(c));
+
+		unsigned i = 0;
+		for(; i + 4 <= count; i += 4)
+		{
+			uint16_t lanes[4][4];
+			for(unsigned c = 0; c < components; ++c)
+			{
+				//Low halves of the four lanes, sign extended so the saturating pack keeps them
+				__m128i converted = Convert(_mm_loadu_ps(ppSrc[c] + i));
+				converted = _mm_srai_epi32(_mm_slli_epi32(converted, 16), 16);
+				_mm_storel_epi64((__m128i*)lanes[c], _mm_packs_epi32(converted, converted));
+			}
+			for(unsigned v = 0; v < 4; ++v)
+			{
+				uint16_t* pOut = (uint16_t*)(pDst + (size_t)(i + v) * stride);
+				for(unsigned c = 0; c < components; ++c)
+					pOut[c] = lanes[c][v];
+				for(unsigned c = components; c < stored; ++c)
+					pOut[c] = pad[c];
+			}
+		}
+		return i;
+	}
+
+	uint16_t ShortNBits(float value)
+	{
+		return (uint16_t)FloatToShortN(value);
+	}
+
+	//Four values times scale plus bias to bytes in the low 8 bits of each lane, rounded like FloatToUByteN
+	__m128i FloatToUByteN4(__m128 value, __m128 scale, __m128 bias)
+	{
+		__m128 mapped = _mm_add_ps(_mm_mul_ps(value, scale), bias);
+		__m128 clamped = _mm_min_ps(_mm_max_ps(mapped, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	}
+
+	//Stores the four dwords of packed to four vertices
+	void Scatter32(__m128i packed, uint8_t* pDst, unsigned stride)
+	{
+		uint32_t lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, packed);
+		for(unsigned v = 0; v < 4; ++v)
+			memcpy(pDst + (size_t)v * stride, &lanes[v], sizeof(uint32_t));
+	}
+#endif
+}
+
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits = FloatBits(value);
+	uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32_t half;
+	if(bits >= (127 + 16) << 23)
+	{
+		//Infinity, or a quiet NaN
+		half = bits > 255u << 23 ? 0x7e00 : 0x7c00;
+	}
+	else if(bits < (127 - 14) << 23)
+	{
+		//Denormal or zero, the float add rounds the mantissa into place
+		const uint32_t magic = ((127 - 15) + (23 - 10) + 1) << 23;
+		half = FloatBits(BitsFloat(bits) + BitsFloat(magic)) - magic;
+	}
+	else
+	{
+		//Rebias the exponent, round half to even through the lowest kept bit
+		uint32_t odd = (bits >> 13) & 1;
+		bits += ((uint32_t)(15 - 127) << 23) + 0xfff + odd;
+		half = bits >> 13;
+	}
+	return (uint16_t)(half | sign >> 16);
+}
+
+float HalfToFloat(uint16_t value)
+{
+	const uint32_t exponentMask = 0x7c00 << 13;
+	uint32_t bits = (uint32_t)(value & 0x7fff) << 13;
+	uint32_t exponent = bits & exponentMask;
+	bits += (127 - 15) << 23;
+	if(exponent == exponentMask)
+	{
+		//Infinity or NaN
+		bits += (128 - 16) << 23;
+	}
+	else if(exponent == 0)
+	{
+		//Denormal or zero, renormalize through a float subtract
+		bits += 1 << 23;
+		bits = FloatBits(BitsFloat(bits) - BitsFloat(113 << 23));
+	}
+	return BitsFloat(bits | (uint32_t)(value & 0x8000) << 16);
+}
+
+void VertexPackFloat(const float* const* ppSrc, unsigned components, unsigned count, uint8_t* pDst, unsigned stride)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		float* pOut = (float*)(pDst + (size_t)i * stride);
+		for(unsigned c = 0; c < components; ++c)
+			pOut[c] = ppSrc[c][i];
+	}
+}
+
+void VertexUnpackFloat(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, float* const* ppDst)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const float* pIn = (const float*)(pSrc + (size_t)i * stride);
+		for(unsigned c = 0; c < components; ++c)
+			ppDst[c][i] = pIn[c];
+	}
+}
+
+void VertexPackHalf(const float* const* ppSrc, unsigned components, unsigned stored, unsigned count, uint8_t* pDst, unsigned stride)
+{
+	unsigned i = 0;
+#ifdef SIMDMATH_SSE
+	i = Pack16<FloatToHalf4, FloatToHalf>(ppSrc, components, stored, count, pDst, stride);
+#endif
+	for(; i < count; ++i)
+	{
+		uint16_t* pOut = (uint16_t*)(pDst + (size_t)i * stride);
+		for(unsigned c = 0; c < stored; ++c)
+			pOut[c] = FloatToHalf(c < components ? ppSrc[c][i] : PadValue(c));
+	}
+}
+
+void VertexUnpackHalf(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, float* const* ppDst)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const uint16_t* pIn = (const uint16_t*)(pSrc + (size_t)i * stride);
+		for(unsigned c = 0; c < components; ++c)
+			ppDst[c][i] = HalfToFloat(pIn[c]);
+	}
+}
+
+void VertexPackShortN(const float* const* ppSrc, unsigned components, unsigned stored, unsigned count, uint8_t* pDst, unsigned stride)
+{
+	unsigned i = 0;
+#ifdef SIMDMATH_SSE
+	i = Pack16<FloatToShortN4, ShortNBits>(ppSrc, components, stored, count, pDst, stride);
+#endif
+	for(; i < count; ++i)
+	{
+		int16_t* pOut = (int16_t*)(pDst + (size_t)i * stride);
+		for(unsigned c = 0; c < stored; ++c)
+			pOut[c] = FloatToShortN(c < components ? ppSrc[c][i] : PadValue(c));
+	}
+}
+
+void VertexUnpackShortN(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, float* const* ppDst)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const int16_t* pIn = (const int16_t*)(pSrc + (size_t)i * stride);
+		//Both -32768 and -32767 are -1
+		for(unsigned c = 0; c < components; ++c)
+			ppDst[c][i] = pIn[c] <= -32767 ? -1.0f : pIn[c] / 32767.0f;
+	}
+}
+
+void VertexPackUByteN(const float* const* ppSrc, unsigned components, bool biased, unsigned count, uint8_t* pDst, unsigned stride)
+{
+	float scale = biased ? 0.5f : 1.0f;
+	float bias = biased ? 0.5f : 0.0f;
+	unsigned i = 0;
+#ifdef SIMDMATH_SSE
+	//x in the lowest byte, up to w in the highest
+	__m128 scale4 = _mm_set1_ps(scale), bias4 = _mm_set1_ps(bias);
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i packed = _mm_setzero_si128();
+		for(unsigned c = 0; c < 4; ++c)
+		{
+			__m128 value = c < components ? _mm_loadu_ps(ppSrc[c] + i) : _mm_set1_ps(PadValue(c));
+			packed = _mm_or_si128(packed, _mm_slli_epi32(FloatToUByteN4(value, scale4, bias4), c * 8));
+		}
+		Scatter32(packed, pDst + (size_t)i * stride, stride);
+	}
+#endif
+	for(; i < count; ++i)
+	{
+		uint8_t* pOut = pDst + (size_t)i * stride;
+		for(unsigned c = 0; c < 4; ++c)
+			pOut[c] = FloatToUByteN((c < components ? ppSrc[c][i] : PadValue(c)) * scale + bias);
+	}
+}
+
+void VertexUnpackUByteN(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, bool biased, float* const* ppDst)
+{
+	float scale = biased ? 2.0f / 255.0f : 1.0f / 255.0f;
+	float bias = biased ? -1.0f : 0.0f;
+	for(unsigned i = 0; i < count; ++i)
+	{
+		const uint8_t* pIn = pSrc + (size_t)i * stride;
+		for(unsigned c = 0; c < components; ++c)
+			ppDst[c][i] = pIn[c] * scale + bias;
+	}
+}
+
+void VertexPackColor(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride)
+{
+	unsigned i = 0;
+#ifdef SIMDMATH_SSE
+	__m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i a = FloatToUByteN4(_mm_loadu_ps(ppSrc[3] + i), one, zero);
+		__m128i r = FloatToUByteN4(_mm_loadu_ps(ppSrc[0] + i), one, zero);
+		__m128i g = FloatToUByteN4(_mm_loadu_ps(ppSrc[1] + i), one, zero);
+		__m128i b = FloatToUByteN4(_mm_loadu_ps(ppSrc[2] + i), one, zero);
+		__m128i argb = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(a, 24), _mm_slli_epi32(r, 16)), _mm_or_si128(_mm_slli_epi32(g, 8), b));
+		Scatter32(argb, pDst + (size_t)i * stride, stride);
+	}
+#endif
+	for(; i < count; ++i)
+	{
+		RDCOLOR color = (RDCOLOR)FloatToUByteN(ppSrc[3][i]) << 24 | (RDCOLOR)FloatToUByteN(ppSrc[0][i]) << 16 |
+			(RDCOLOR)FloatToUByteN(ppSrc[1][i]) << 8 | FloatToUByteN(ppSrc[2][i]);
+		memcpy(pDst + (size_t)i * stride, &color, sizeof(color));
+	}
+}
+
+void VertexUnpackColor(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst)
+{
+	for(unsigned i = 0; i < count; ++i)
+	{
+		RDCOLOR color;
+		memcpy(&color, pSrc + (size_t)i * stride, sizeof(color));
+		ppDst[0][i] = (color >> 16 & 0xFF) / 255.0f;
+		ppDst[1][i] = (color >> 8 & 0xFF) / 255.0f;
+		ppDst[2][i] = (color & 0xFF) / 255.0f;
+		ppDst[3][i] = (color >> 24) / 255.0f;
+	}
+}
@@ -0,0 +1,282 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Vertex layouts declared once as a list of attributes, e.g.
+				VertexLayout<VA_Position<>, VA_Normal<>, VA_Color<0>, VA_TexCoord<0> >.
+				The layout derives at compile time the stride, the offset of
+				each attribute, the FVF (0 when the layout has no FVF) and the
+				element array for CreateVertexDeclaration(), so the vertex size,
+				its FVF and its declaration can not drift apart. Every layout
+				also names two smaller variants of itself: Half stores float
+				attributes as half floats, Quantized stores normals as biased
+				bytes and texture coordinates as normalized shorts on top of
+				that. Packed types have no FVF and are optional on Direct3D 9
+				hardware, the declaration fails where they are missing.
+				FromSoA()/ToSoA() convert between the vertices and one float
+				array per component (structure of arrays), packing on the way.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+//Float <-> IEEE half, round to nearest even
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+//Column kernels: components float arrays of count values each, written to (read
+//from) the attribute at pDst (pSrc) of count vertices stride bytes apart. Stored
+//components beyond the source ones get 0, the fourth gets 1 (like Direct3D does).
+void VertexPackFloat(const float* const* ppSrc, unsigned components, unsigned count, uint8_t* pDst, unsigned stride);
+void VertexUnpackFloat(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, float* const* ppDst);
+void VertexPackHalf(const float* const* ppSrc, unsigned components, unsigned stored, unsigned count, uint8_t* pDst, unsigned stride);
+void VertexUnpackHalf(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, float* const* ppDst);
+//-1..1, values outside are clamped
+void VertexPackShortN(const float* const* ppSrc, unsigned components, unsigned stored, unsigned count, uint8_t* pDst, unsigned stride);
+void VertexUnpackShortN(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, float* const* ppDst);
+//0..1, or -1..1 mapped to 0..1 when biased (the shader undoes the bias)
+void VertexPackUByteN(const float* const* ppSrc, unsigned components, bool biased, unsigned count, uint8_t* pDst, unsigned stride);
+void VertexUnpackUByteN(const uint8_t* pSrc, unsigned stride, unsigned count, unsigned components, bool biased, float* const* ppDst);
+//r, g, b, a 0..1 to an ARGB RDCOLOR
+void VertexPackColor(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride);
+void VertexUnpackColor(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst);
+
+//Formats: how Components floats are stored (Type, Size bytes)
+template<unsigned N>
+struct VF_Float
+{
+	enum { Type = RD_DECLTYPE_FLOAT1 + N - 1, Size = 4 * N, Components = N, IsFloat = 1 };
+	static void Pack(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride) { VertexPackFloat(ppSrc, N, count, pDst, stride); }
+	static void Unpack(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst) { VertexUnpackFloat(pSrc, stride, count, N, ppDst); }
+};
+
+template<unsigned N>
+struct VF_Half
+{
+	enum { Stored = N <= 2 ? 2 : 4 };
+	enum { Type = Stored == 2 ? RD_DECLTYPE_FLOAT16_2 : RD_DECLTYPE_FLOAT16_4, Size = 2 * Stored, Components = N, IsFloat = 0 };
+	static void Pack(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride) { VertexPackHalf(ppSrc, N, Stored, count, pDst, stride); }
+	static void Unpack(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst) { VertexUnpackHalf(pSrc, stride, count, N, ppDst); }
+};
+
+template<unsigned N>
+struct VF_ShortN
+{
+	enum { Stored = N <= 2 ? 2 : 4 };
+	enum { Type = Stored == 2 ? RD_DECLTYPE_SHORT2N : RD_DECLTYPE_SHORT4N, Size = 2 * Stored, Components = N, IsFloat = 0 };
+	static void Pack(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride) { VertexPackShortN(ppSrc, N, Stored, count, pDst, stride); }
+	static void Unpack(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst) { VertexUnpackShortN(pSrc, stride, count, N, ppDst); }
+};
+
+template<unsigned N, bool Biased = false>
+struct VF_UByteN
+{
+	enum { Type = RD_DECLTYPE_UBYTE4N, Size = 4, Components = N, IsFloat = 0 };
+	static void Pack(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride) { VertexPackUByteN(ppSrc, N, Biased, count, pDst, stride); }
+	static void Unpack(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst) { VertexUnpackUByteN(pSrc, stride, count, N, Biased, ppDst); }
+};
+
+struct VF_Color
+{
+	enum { Type = RD_DECLTYPE_D3DCOLOR, Size = 4, Components = 4, IsFloat = 0 };
+	static void Pack(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride) { VertexPackColor(ppSrc, count, pDst, stride); }
+	static void Unpack(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst) { VertexUnpackColor(pSrc, stride, count, ppDst); }
+};
+
+//Attributes: a usage and a format. FVF_BITS is what the attribute adds to an FVF
+//when FVF_OK, FVF_RANK its place in FVF order, FVF_TEX 1 for texture coordinates.
+template<typename F = VF_Float<3> >
+struct VA_Position
+{
+	typedef F Format;
+	enum { Usage = RD_DECLUSAGE_POSITION, UsageIndex = 0 };
+	enum { FVF_OK = (int)Format::Type == RD_DECLTYPE_FLOAT3, FVF_BITS = RD_FVF_XYZ, FVF_RANK = 0, FVF_TEX = 0 };
+	//Positions need the range of halves, normalized shorts would need a scale in the world matrix
+	typedef VA_Position<VF_Half<F::Components> > Half;
+	typedef Half Quantized;
+};
+
+//Pretransformed screen position (x, y, z, rhw), stays float so pixels stay exact
+template<typename F = VF_Float<4> >
+struct VA_PositionT
+{
+	typedef F Format;
+	enum { Usage = RD_DECLUSAGE_POSITIONT, UsageIndex = 0 };
+	enum { FVF_OK = (int)Format::Type == RD_DECLTYPE_FLOAT4, FVF_BITS = RD_FVF_XYZRHW, FVF_RANK = 0, FVF_TEX = 0 };
+	typedef VA_PositionT Half;
+	typedef VA_PositionT Quantized;
+};
+
+template<typename F = VF_Float<3> >
+struct VA_Normal
+{
+	typedef F Format;
+	enum { Usage = RD_DECLUSAGE_NORMAL, UsageIndex = 0 };
+	enum { FVF_OK = (int)Format::Type == RD_DECLTYPE_FLOAT3, FVF_BITS = RD_FVF_NORMAL, FVF_RANK = 1, FVF_TEX = 0 };
+	typedef VA_Normal<VF_Half<F::Components> > Half;
+	typedef VA_Normal<VF_UByteN<F::Components, true> > Quantized;
+};
+
+//Index 0 is the diffuse, 1 the specular color
+template<unsigned Index = 0, typename F = VF_Color>
+struct VA_Color
+{
+	typedef F Format;
+	enum { Usage = RD_DECLUSAGE_COLOR, UsageIndex = Index };
+	enum { FVF_OK = (int)Format::Type == RD_DECLTYPE_D3DCOLOR && Index < 2, FVF_BITS = Index == 0 ? RD_FVF_DIFFUSE : RD_FVF_SPECULAR,
+		FVF_RANK = 2 + Index, FVF_TEX = 0 };
+	typedef VA_Color Half;
+	typedef VA_Color Quantized;
+};
+
+//Quantized texture coordinates must stay within -1..1 (no wrapping beyond one repeat)
+template<unsigned Index = 0, typename F = VF_Float<2> >
+struct VA_TexCoord
+{
+	typedef F Format;
+	enum { Usage = RD_DECLUSAGE_TEXCOORD, UsageIndex = Index };
+	//D3DFVF_TEXCOORDSIZEn(Index), 2 floats is 0
+	enum { FVF_OK = Format::IsFloat != 0 && Index < 8, FVF_BITS = (F::Components == 2 ? 0 : F::Components == 1 ? 3 : F::Components - 2) << (Index * 2 + 16),
+		FVF_RANK = 4 + Index, FVF_TEX = 1 };
+	typedef VA_TexCoord<Index, VF_Half<F::Components> > Half;
+	typedef VA_TexCoord<Index, VF_ShortN<F::Components> > Quantized;
+};
+
+//Compile time folds over the attribute list
+template<typename... A>
+struct VertexLayoutFold
+{
+	enum { STRIDE = 0, COMPONENTS = 0 };
+	static void Pack(const float* const*, unsigned, uint8_t*, unsigned) {}
+	static void Unpack(const uint8_t*, unsigned, unsigned, float* const*) {}
+};
+
+template<typename A, typename... Rest>
+struct VertexLayoutFold<A, Rest...>
+{
+	typedef VertexLayoutFold<Rest...> Next;
+	enum { STRIDE = A::Format::Size + Next::STRIDE, COMPONENTS = A::Format::Components + Next::COMPONENTS };
+
+	static void Pack(const float* const* ppSrc, unsigned count, uint8_t* pDst, unsigned stride)
+	{
+		A::Format::Pack(ppSrc, count, pDst, stride);
+		Next::Pack(ppSrc + A::Format::Components, count, pDst + A::Format::Size, stride);
+	}
+	static void Unpack(const uint8_t* pSrc, unsigned stride, unsigned count, float* const* ppDst)
+	{
+		A::Format::Unpack(pSrc, stride, count, ppDst);
+		Next::Unpack(pSrc + A::Format::Size, stride, count, ppDst + A::Format::Components);
+	}
+};
+
+//Offset of the attribute with Usage and Index, -1 if there is none
+template<unsigned Usage, unsigned Index, typename... A>
+struct VertexLayoutOffset
+{
+	enum { Value = -1 };
+};
+
+template<unsigned Usage, unsigned Index, typename A, typename... Rest>
+struct VertexLayoutOffset<Usage, Index, A, Rest...>
+{
+	enum { Next = VertexLayoutOffset<Usage, Index, Rest...>::Value };
+	enum { Value = A::Usage == Usage && A::UsageIndex == Index ? 0 : Next < 0 ? -1 : A::Format::Size + Next };
+};
+
+//FVF in FVF order (position, normal, diffuse, specular, texture coordinates from 0 up)
+template<int PrevRank, unsigned TexCount, typename... A>
+struct VertexLayoutFVF
+{
+	enum { OK = 1, Value = TexCount << RD_FVF_TEXCOUNT_SHIFT };
+};
+
+template<int PrevRank, unsigned TexCount, typename A, typename... Rest>
+struct VertexLayoutFVF<PrevRank, TexCount, A, Rest...>
+{
+	typedef VertexLayoutFVF<A::FVF_RANK, TexCount + A::FVF_TEX, Rest...> Next;
+	enum { OK = A::FVF_OK && A::FVF_RANK > PrevRank && (!A::FVF_TEX || A::FVF_RANK == 4 + (int)TexCount) && Next::OK };
+	enum { Value = OK ? A::FVF_BITS | Next::Value : 0 };
+};
+
+template<typename... A>
+class VertexLayout
+{
+public:
+	typedef VertexLayoutFold<A...> Fold;
+	enum
+	{
+		STRIDE = Fold::STRIDE,						//Bytes per vertex
+		COMPONENTS = Fold::COMPONENTS,				//Float arrays FromSoA()/ToSoA() take
+		ATTRIBUTES = sizeof...(A),
+		FVF = VertexLayoutFVF<-1, 0, A...>::Value	//0 when the layout has no FVF
+	};
+
+	//Offset<RD_DECLUSAGE_COLOR, 0>::Value, -1 if the layout has no such attribute
+	template<unsigned Usage, unsigned Index = 0>
+	struct Offset
+	{
+		enum { Value = VertexLayoutOffset<Usage, Index, A...>::Value };
+	};
+
+	typedef VertexLayout<typename A::Half...> Half;
+	typedef VertexLayout<typename A::Quantized...> Quantized;
+
+	//Stream 0, ends with RD_DECL_END()
+	static const RDVertexElement Elements[ATTRIBUTES + 1];
+
+	//ppComponents holds COMPONENTS arrays of count floats, the components of each
+	//attribute in turn (x, y, z of a position, r, g, b, a of a color, ...)
+	static void FromSoA(const float* const* ppComponents, unsigned count, void* pVertices)
+	{
+		//Blocks small enough for the first level cache, each attribute is a pass over them
+		const unsigned BLOCK = 256;
+		const float* blockComponents[COMPONENTS];
+		uint8_t* pDst = (uint8_t*)pVertices;
+		for(unsigned first = 0; first < count; first += BLOCK)
+		{
+			for(unsigned c = 0; c < COMPONENTS; ++c)
+				blockComponents[c] = ppComponents[c] + first;
+			Fold::Pack(blockComponents, count - first < BLOCK ? count - first : BLOCK, pDst + (size_t)first * STRIDE, STRIDE);
+		}
+	}
+
+	static void ToSoA(const void* pVertices, unsigned count, float* const* ppComponents)
+	{
+		const unsigned BLOCK = 256;
+		float* blockComponents[COMPONENTS];
+		const uint8_t* pSrc = (const uint8_t*)pVertices;
+		for(unsigned first = 0; first < count; first += BLOCK)
+		{
+			for(unsigned c = 0; c < COMPONENTS; ++c)
+				blockComponents[c] = ppComponents[c] + first;
+			Fold::Unpack(pSrc + (size_t)first * STRIDE, STRIDE, count - first < BLOCK ? count - first : BLOCK, blockComponents);
+		}
+	}
+
+private:
+	static_assert(sizeof...(A) > 0, "A vertex layout needs attributes");
+	static_assert(STRIDE <= 255 * 4, "Vertex too large for a declaration");
+};
+
+template<typename... A>
+const RDVertexElement VertexLayout<A...>::Elements[VertexLayout<A...>::ATTRIBUTES + 1] =
+{
+	{ 0, (uint16_t)VertexLayoutOffset<A::Usage, A::UsageIndex, A...>::Value, (uint8_t)A::Format::Type, 0, (uint8_t)A::Usage, (uint8_t)A::UsageIndex }...,
+	RD_DECL_END()
+};
+
+//Position and diffuse color (D3DFVF_XYZ | D3DFVF_DIFFUSE), the vertex of the
+//application's meshes and of everything the framework generates for them
+typedef VertexLayout<VA_Position<>, VA_Color<0> > PositionColorLayout;
+
+struct PositionColorVertex
+{
+	float	x, y, z;
+	RDCOLOR	Color;
+};
+
+static_assert(sizeof(PositionColorVertex) == PositionColorLayout::STRIDE &&
+	offsetof(PositionColorVertex, Color) == PositionColorLayout::Offset<RD_DECLUSAGE_COLOR>::Value,
+	"PositionColorVertex must match its layout");
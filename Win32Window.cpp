@@ -0,0 +1,285 @@
+#include "Win32Window.h"
+
+#ifdef _WIN32
+
+namespace
+{
+	const char* WINDOW_CLASS_NAME = "WIN32WINDOWCLASS";
+	//Standard non-resizeable window
+	const DWORD WINDOW_STYLE = WS_OVERLAPPED | WS_SYSMENU | WS_CAPTION | WS_MINIMIZEBOX;
+}
+
+Win32Window::Win32Window()
+{
+	m_hWnd = NULL;
+	m_pEvents = NULL;
+	m_Style = WINDOW_STYLE;
+	m_ClientWidth = 0;
+	m_ClientHeight = 0;
+}
+
+Win32Window::~Win32Window()
+{
+	if(m_hWnd)
+	{
+		//No more events, the queue may be gone before the window
+		SetWindowLongPtr(m_hWnd, GWLP_USERDATA, 0);
+		DestroyWindow(m_hWnd);
+	}
+}
+
+bool Win32Window::Create(const char* pTitle, unsigned clientWidth, unsigned clientHeight, EventQueue* pEvents, bool visible)
+{
+	m_pEvents = pEvents;
+	m_ClientWidth = clientWidth;
+	m_ClientHeight = clientHeight;
+	HINSTANCE hInstance = GetModuleHandle(NULL);
+
+	//First step:
+	//Create a window class structure to define our window (once per process)
+	WNDCLASSEX wcex;
+	ZeroMemory(&wcex, sizeof(WNDCLASSEX)); //ZERO it out
+	if(!GetClassInfoEx(hInstance, WINDOW_CLASS_NAME, &wcex))
+	{
+		wcex.cbClsExtra = 0; //no extra bytes
+		wcex.cbWndExtra = 0; //no extra bytes
+		wcex.cbSize = sizeof(WNDCLASSEX); //set size in bytes
+		wcex.style = CS_HREDRAW | CS_VREDRAW; //Basically states that window should be redraw both HORIZ. and VERT.
+		wcex.hInstance = hInstance; //Set handle to application instance;
+		wcex.lpfnWndProc = WndProc; //Set message procedure, it finds the window through GWLP_USERDATA
+		wcex.hIcon = LoadIcon(NULL, IDI_APPLICATION); //Set window icon (standard application icon)
+		wcex.hCursor = LoadCursor(NULL, IDC_ARROW); //Set window arrow (standard windows arrow)
+		wcex.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH); //Set clear background
+		wcex.lpszClassName = WINDOW_CLASS_NAME;
+		wcex.lpszMenuName = NULL; //We are not using a menu at this time.
+		wcex.hIconSm = LoadIcon(NULL, IDI_APPLICATION); //Set small window icon (standard application icon)
+
+		//Now we must register the window class
+		if(!RegisterClassEx(&wcex))
+		{
+			PlatformShowError("Failed to register window class");
+			return false;
+		}
+	}
+
+	//Second step:
+	//Cache the correct window dimensions
+	RECT r = { 0, 0, (LONG)clientWidth, (LONG)clientHeight };
+	AdjustWindowRect(&r, m_Style, false); //Use our window style
+	int width = r.right - r.left;  //correct width based on requested client size
+	int height = r.bottom - r.top;  //correct height based on requested client size
+	int x = GetSystemMetrics(SM_CXSCREEN)/2 - width/2; //Centers window on desktop
+	int y = GetSystemMetrics(SM_CYSCREEN)/2 - height/2; //Centers window on desktop
+
+	//Third step:
+	//Create our window. The last parameter reaches WM_NCCREATE, where the
+	//window procedure stores it to find this object.
+	m_hWnd = CreateWindow(WINDOW_CLASS_NAME, pTitle, m_Style, x, y,
+		width, height, NULL, NULL, hInstance, this);
+	//Check window creation
+	if(!m_hWnd)
+	{
+		PlatformShowError("Failed to create window");
+		return false;
+	}
+
+	//Fourth step:
+	//Show window (hidden windows only host an offscreen device). Visible windows
+	//also receive raw mouse motion (WM_INPUT) while they have the focus.
+	if(visible)
+	{
+		ShowWindow(m_hWnd, SW_SHOW);
+		RAWINPUTDEVICE mouse;
+		mouse.usUsagePage = 0x01; //Generic desktop controls
+		mouse.usUsage = 0x02; //Mouse
+		mouse.dwFlags = 0;
+		mouse.hwndTarget = m_hWnd;
+		RegisterRawInputDevices(&mouse, 1, sizeof(mouse));
+	}
+	return true;
+}
+
+void Win32Window::PumpEvents()
+{
+	//Peek at every message on the queue, store it in msg and remove it.
+	//Dispatching runs WndProc, which pushes the events.
+	MSG msg = {0};
+	while(PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+	{
+		//WM_QUIT is not sent to a window
+		if(msg.message == WM_QUIT)
+		{
+			PushPlatformEvent(m_pEvents, PE_QUIT);
+			continue;
+		}
+		TranslateMessage(&msg);
+		DispatchMessage(&msg);
+	}
+}
+
+void Win32Window::WaitForEvents(unsigned ms)
+{
+	//Unlike Sleep() this returns as soon as input or any other message arrives
+	MsgWaitForMultipleObjects(0, NULL, FALSE, ms, QS_ALLINPUT);
+}
+
+void Win32Window::SetTitle(const char* pTitle)
+{
+	SetWindowText(m_hWnd, pTitle);
+}
+
+void Win32Window::PresentPixels(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+{
+	BITMAPINFO bmi;
+	ZeroMemory(&bmi, sizeof(BITMAPINFO));
+	bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	bmi.bmiHeader.biWidth = pitch;
+	bmi.bmiHeader.biHeight = -(LONG)height; //Negative height means top-down rows
+	bmi.bmiHeader.biPlanes = 1;
+	bmi.bmiHeader.biBitCount = 32;
+	bmi.bmiHeader.biCompression = BI_RGB;
+
+	HDC hdc = GetDC(m_hWnd);
+	SetDIBitsToDevice(hdc, 0, 0, width, height, 0, 0, 0, height, pPixels, &bmi, DIB_RGB_COLORS);
+	ReleaseDC(m_hWnd, hdc);
+}
+
+bool Win32Window::SetFullscreen(bool enable, unsigned* pWidth, unsigned* pHeight)
+{
+	if(enable)
+	{
+		//Cache desktop width and height
+		int width = GetSystemMetrics(SM_CXSCREEN);
+		int height = GetSystemMetrics(SM_CYSCREEN);
+
+		//Set window style to fullscreen friendly
+		SetWindowLongPtr(m_hWnd, GWL_STYLE, WS_POPUP);
+
+		//Need to set new position for window
+		SetWindowPos(m_hWnd, HWND_TOP, 0, 0, width, height, SWP_NOZORDER | SWP_SHOWWINDOW);
+
+		*pWidth = width;
+		*pHeight = height;
+	}
+	else
+	{
+		//Set window back to windowed mode
+		RECT r = { 0, 0, (LONG)m_ClientWidth, (LONG)m_ClientHeight };
+		AdjustWindowRect(&r, m_Style, false);
+		int w = r.right - r.left;
+		int h = r.bottom - r.top;
+
+		//Change window style back to windowed friendly
+		SetWindowLongPtr(m_hWnd, GWL_STYLE, m_Style);
+
+		//Set window position
+		SetWindowPos(m_hWnd, HWND_TOP,
+			GetSystemMetrics(SM_CXSCREEN)/2 - w/2,
+			GetSystemMetrics(SM_CYSCREEN)/2 - h/2,
+			w, h, SWP_NOZORDER | SWP_SHOWWINDOW);
+
+		*pWidth = m_ClientWidth;
+		*pHeight = m_ClientHeight;
+	}
+	return true;
+}
+
+unsigned Win32Window::GetRefreshRate() const
+{
+	HDC hdc = GetDC(m_hWnd);
+	int rate = GetDeviceCaps(hdc, VREFRESH);
+	ReleaseDC(m_hWnd, hdc);
+	//0 and 1 stand for the hardware default
+	return rate > 1 ? (unsigned)rate : 0;
+}
+
+LRESULT CALLBACK Win32Window::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	//The first message carrying the creation parameter binds the window to its object
+	if(msg == WM_NCCREATE)
+	{
+		CREATESTRUCT* pCreate = (CREATESTRUCT*)lParam;
+		SetWindowLongPtr(hwnd, GWLP_USERDATA, (LONG_PTR)pCreate->lpCreateParams);
+	}
+
+	Win32Window* pWindow = (Win32Window*)GetWindowLongPtr(hwnd, GWLP_USERDATA);
+	if(pWindow && pWindow->m_pEvents)
+		return pWindow->HandleMessage(hwnd, msg, wParam, lParam);
+	else
+		return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+//Turns the messages the framework cares about into events, everything
+//else goes to the default window procedure
+LRESULT Win32Window::HandleMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	//Client coordinates are signed 16 bit values
+	int x = (short)LOWORD(lParam);
+	int y = (short)HIWORD(lParam);
+
+	switch(msg)
+	{
+		//CASE: WM_DESTROY, our application is told to destroy itself
+	case WM_DESTROY:
+		PushPlatformEvent(m_pEvents, PE_QUIT);
+		m_hWnd = NULL;
+		return 0;
+
+		//CASE: WM_ACTIVATE, CHECK IF LOW ORDER BIT = INACTIVE
+	case WM_ACTIVATE:
+		PushPlatformEvent(m_pEvents, LOWORD(wParam) == WA_INACTIVE ? PE_DEACTIVATE : PE_ACTIVATE);
+		return 0;
+
+	case WM_SIZE:
+		PushPlatformEvent(m_pEvents, PE_RESIZE, 0, x, y);
+		return 0;
+
+		//Virtual key codes are the PlatformKey values
+	case WM_KEYDOWN:
+		PushPlatformEvent(m_pEvents, PE_KEY_DOWN, (unsigned)wParam);
+		return 0;
+	case WM_KEYUP:
+		PushPlatformEvent(m_pEvents, PE_KEY_UP, (unsigned)wParam);
+		return 0;
+
+	case WM_MOUSEMOVE:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_MOVE, 0, x, y);
+		return 0;
+	case WM_LBUTTONDOWN:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_DOWN, MOUSE_LEFT, x, y);
+		return 0;
+	case WM_LBUTTONUP:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_UP, MOUSE_LEFT, x, y);
+		return 0;
+	case WM_RBUTTONDOWN:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_DOWN, MOUSE_RIGHT, x, y);
+		return 0;
+	case WM_RBUTTONUP:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_UP, MOUSE_RIGHT, x, y);
+		return 0;
+	case WM_MBUTTONDOWN:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_DOWN, MOUSE_MIDDLE, x, y);
+		return 0;
+	case WM_MBUTTONUP:
+		PushPlatformEvent(m_pEvents, PE_MOUSE_UP, MOUSE_MIDDLE, x, y);
+		return 0;
+
+		//Relative mouse motion straight from the device, without acceleration or clipping
+	case WM_INPUT:
+	{
+		RAWINPUT raw;
+		UINT size = sizeof(raw);
+		if(GetRawInputData((HRAWINPUT)lParam, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) != (UINT)-1 &&
+			raw.header.dwType == RIM_TYPEMOUSE && !(raw.data.mouse.usFlags & MOUSE_MOVE_ABSOLUTE) &&
+			(raw.data.mouse.lLastX != 0 || raw.data.mouse.lLastY != 0))
+			PushPlatformEvent(m_pEvents, PE_MOUSE_RAW, 0, raw.data.mouse.lLastX, raw.data.mouse.lLastY);
+		//The default procedure cleans up after WM_INPUT
+		break;
+	}
+	}
+
+	//Always return the default window procedure if we don't catch anything
+	return DefWindowProc(hwnd, msg, wParam, lParam);
+}
+
+#endif
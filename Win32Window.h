@@ -0,0 +1,54 @@
+/* Title: DirectX 9.0c Framework
+/* Description: Win32 implementation of IPlatformWindow. The window procedure
+				translates messages into events on the application's event ring,
+				including raw mouse motion (WM_INPUT) for visible windows.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#ifdef _WIN32
+
+#include "Platform.h"
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+class Win32Window : public IPlatformWindow
+{
+public:
+	Win32Window();
+	~Win32Window();
+
+	PlatformWindowType GetType() const override { return PLATFORM_WINDOW_WIN32; }
+
+	bool Create(const char* pTitle, unsigned clientWidth, unsigned clientHeight, EventQueue* pEvents, bool visible) override;
+	void PumpEvents() override;
+	void WaitForEvents(unsigned ms) override;
+
+	void SetTitle(const char* pTitle) override;
+	void PresentPixels(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) override;
+	bool SetFullscreen(bool enable, unsigned* pWidth, unsigned* pHeight) override;
+
+	unsigned GetRefreshRate() const override;
+	void* GetNativeHandle() const override { return m_hWnd; }
+
+private:
+	//Disallow copying
+	Win32Window(const Win32Window&);
+	Win32Window& operator=(const Win32Window&);
+
+	//Window procedure of the class, forwards to the Win32Window in GWLP_USERDATA
+	static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	LRESULT HandleMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+	HWND		m_hWnd;
+	EventQueue*	m_pEvents;
+	DWORD		m_Style;			//Window style when not fullscreen
+	unsigned	m_ClientWidth;		//Requested client size, restored when leaving fullscreen
+	unsigned	m_ClientHeight;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "X11Window.h"
+
+#ifdef PLATFORM_X11
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <poll.h>
+#include <string.h>
+
+namespace
+{
+	//Keysym to PlatformKey (Win32 virtual key) code, KEY_UNKNOWN if not mapped
+	unsigned TranslateKey(KeySym sym)
+	{
+		if(sym >= XK_a && sym <= XK_z)
+			return 'A' + (unsigned)(sym - XK_a);
+		if(sym >= XK_A && sym <= XK_Z)
+			return 'A' + (unsigned)(sym - XK_A);
+		if(sym >= XK_0 && sym <= XK_9)
+			return '0' + (unsigned)(sym - XK_0);
+		if(sym >= XK_F1 && sym <= XK_F12)
+			return KEY_F1 + (unsigned)(sym - XK_F1);
+
+		switch(sym)
+		{
+		case XK_BackSpace: return KEY_BACKSPACE;
+		case XK_Tab: return KEY_TAB;
+		case XK_Return: return KEY_RETURN;
+		case XK_Shift_L: case XK_Shift_R: return KEY_SHIFT;
+		case XK_Control_L: case XK_Control_R: return KEY_CONTROL;
+		case XK_Alt_L: case XK_Alt_R: return KEY_ALT;
+		case XK_Escape: return KEY_ESCAPE;
+		case XK_space: return KEY_SPACE;
+		case XK_Left: return KEY_LEFT;
+		case XK_Up: return KEY_UP;
+		case XK_Right: return KEY_RIGHT;
+		case XK_Down: return KEY_DOWN;
+		}
+		return KEY_UNKNOWN;
+	}
+
+	//X buttons 1 to 3, false for everything else (wheel)
+	bool TranslateButton(unsigned button, unsigned* pButton)
+	{
+		switch(button)
+		{
+		case Button1: *pButton = MOUSE_LEFT; return true;
+		case Button2: *pButton = MOUSE_MIDDLE; return true;
+		case Button3: *pButton = MOUSE_RIGHT; return true;
+		}
+		return false;
+	}
+}
+
+X11Window::X11Window()
+{
+	m_pDisplay = NULL;
+	m_Window = 0;
+	m_pGC = NULL;
+	m_DeleteAtom = 0;
+	m_Depth = 0;
+	m_pEvents = NULL;
+	m_ClientWidth = 0;
+	m_ClientHeight = 0;
+}
+
+X11Window::~X11Window()
+{
+	Display* pDisplay = (Display*)m_pDisplay;
+	if(!pDisplay)
+		return;
+	if(m_pGC)
+		XFreeGC(pDisplay, (GC)m_pGC);
+	if(m_Window)
+		XDestroyWindow(pDisplay, m_Window);
+	XCloseDisplay(pDisplay);
+}
+
+bool X11Window::Create(const char* pTitle, unsigned clientWidth, unsigned clientHeight, EventQueue* pEvents, bool visible)
+{
+	m_pEvents = pEvents;
+	m_ClientWidth = clientWidth;
+	m_ClientHeight = clientHeight;
+
+	Display* pDisplay = XOpenDisplay(NULL);
+	if(!pDisplay)
+	{
+		PlatformShowError("Failed to open the X display (run with -headless without one)");
+		return false;
+	}
+	m_pDisplay = pDisplay;
+
+	int screen = DefaultScreen(pDisplay);
+	m_Depth = DefaultDepth(pDisplay, screen);
+	m_Window = XCreateSimpleWindow(pDisplay, RootWindow(pDisplay, screen), 0, 0, clientWidth, clientHeight, 0,
+		BlackPixel(pDisplay, screen), BlackPixel(pDisplay, screen));
+	if(!m_Window)
+	{
+		PlatformShowError("Failed to create window");
+		return false;
+	}
+
+	XSelectInput(pDisplay, m_Window, KeyPressMask | KeyReleaseMask | ButtonPressMask | ButtonReleaseMask |
+		PointerMotionMask | FocusChangeMask | StructureNotifyMask);
+
+	//Ask the window manager for a close message instead of killing the connection
+	Atom deleteAtom = XInternAtom(pDisplay, "WM_DELETE_WINDOW", False);
+	XSetWMProtocols(pDisplay, m_Window, &deleteAtom, 1);
+	m_DeleteAtom = deleteAtom;
+
+	//Non-resizeable, like the Win32 window
+	XSizeHints* pHints = XAllocSizeHints();
+	pHints->flags = PMinSize | PMaxSize;
+	pHints->min_width = pHints->max_width = clientWidth;
+	pHints->min_height = pHints->max_height = clientHeight;
+	XSetWMNormalHints(pDisplay, m_Window, pHints);
+	XFree(pHints);
+
+	//Held keys repeat as presses only, as on Windows (no release in between)
+	XkbSetDetectableAutoRepeat(pDisplay, True, NULL);
+
+	m_pGC = XCreateGC(pDisplay, m_Window, 0, NULL);
+	XStoreName(pDisplay, m_Window, pTitle);
+	if(visible)
+		XMapWindow(pDisplay, m_Window);
+	XFlush(pDisplay);
+	return true;
+}
+
+void X11Window::PumpEvents()
+{
+	Display* pDisplay = (Display*)m_pDisplay;
+	while(XPending(pDisplay) > 0)
+	{
+		XEvent e;
+		XNextEvent(pDisplay, &e);
+		unsigned button = 0;
+
+		switch(e.type)
+		{
+		case ClientMessage:
+			if((unsigned long)e.xclient.data.l[0] == m_DeleteAtom)
+				PushPlatformEvent(m_pEvents, PE_QUIT);
+			break;
+		case FocusIn:
+			PushPlatformEvent(m_pEvents, PE_ACTIVATE);
+			break;
+		case FocusOut:
+			PushPlatformEvent(m_pEvents, PE_DEACTIVATE);
+			break;
+		case ConfigureNotify:
+			PushPlatformEvent(m_pEvents, PE_RESIZE, 0, e.xconfigure.width, e.xconfigure.height);
+			break;
+		case KeyPress:
+			PushPlatformEvent(m_pEvents, PE_KEY_DOWN, TranslateKey(XLookupKeysym(&e.xkey, 0)));
+			break;
+		case KeyRelease:
+			PushPlatformEvent(m_pEvents, PE_KEY_UP, TranslateKey(XLookupKeysym(&e.xkey, 0)));
+			break;
+		case MotionNotify:
+			PushPlatformEvent(m_pEvents, PE_MOUSE_MOVE, 0, e.xmotion.x, e.xmotion.y);
+			break;
+		case ButtonPress:
+			if(TranslateButton(e.xbutton.button, &button))
+				PushPlatformEvent(m_pEvents, PE_MOUSE_DOWN, button, e.xbutton.x, e.xbutton.y);
+			break;
+		case ButtonRelease:
+			if(TranslateButton(e.xbutton.button, &button))
+				PushPlatformEvent(m_pEvents, PE_MOUSE_UP, button, e.xbutton.x, e.xbutton.y);
+			break;
+		}
+	}
+}
+
+void X11Window::WaitForEvents(unsigned ms)
+{
+	Display* pDisplay = (Display*)m_pDisplay;
+	if(XPending(pDisplay) > 0)
+		return;
+
+	//Wait on the connection, input arrives as data on its socket
+	pollfd fd;
+	fd.fd = ConnectionNumber(pDisplay);
+	fd.events = POLLIN;
+	fd.revents = 0;
+	poll(&fd, 1, (int)ms);
+}
+
+void X11Window::SetTitle(const char* pTitle)
+{
+	XStoreName((Display*)m_pDisplay, m_Window, pTitle);
+}
+
+void X11Window::PresentPixels(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch)
+{
+	//ARGB pixels are the byte layout of 24 and 32 bit TrueColor visuals
+	if(m_Depth != 24 && m_Depth != 32)
+		return;
+
+	Display* pDisplay = (Display*)m_pDisplay;
+	XImage* pImage = XCreateImage(pDisplay, DefaultVisual(pDisplay, DefaultScreen(pDisplay)), m_Depth, ZPixmap, 0,
+		(char*)pPixels, width, height, 32, pitch * sizeof(RDCOLOR));
+	if(!pImage)
+		return;
+
+	XPutImage(pDisplay, m_Window, (GC)m_pGC, pImage, 0, 0, 0, 0, width, height);
+	//The pixels belong to the device, do not let XDestroyImage free them
+	pImage->data = NULL;
+	XDestroyImage(pImage);
+	XFlush(pDisplay);
+}
+
+bool X11Window::SetFullscreen(bool enable, unsigned* pWidth, unsigned* pHeight)
+{
+	Display* pDisplay = (Display*)m_pDisplay;
+	int screen = DefaultScreen(pDisplay);
+
+	//Allow any size while switching
+	XSizeHints* pHints = XAllocSizeHints();
+	pHints->flags = enable ? 0 : PMinSize | PMaxSize;
+	pHints->min_width = pHints->max_width = m_ClientWidth;
+	pHints->min_height = pHints->max_height = m_ClientHeight;
+	XSetWMNormalHints(pDisplay, m_Window, pHints);
+	XFree(pHints);
+
+	//Ask an EWMH window manager to toggle the fullscreen state
+	XEvent e;
+	memset(&e, 0, sizeof(XEvent));
+	e.xclient.type = ClientMessage;
+	e.xclient.window = m_Window;
+	e.xclient.message_type = XInternAtom(pDisplay, "_NET_WM_STATE", False);
+	e.xclient.format = 32;
+	e.xclient.data.l[0] = enable ? 1 : 0; //_NET_WM_STATE_ADD or _NET_WM_STATE_REMOVE
+	e.xclient.data.l[1] = XInternAtom(pDisplay, "_NET_WM_STATE_FULLSCREEN", False);
+	XSendEvent(pDisplay, RootWindow(pDisplay, screen), False,
+		SubstructureRedirectMask | SubstructureNotifyMask, &e);
+	XFlush(pDisplay);
+
+	*pWidth = enable ? (unsigned)DisplayWidth(pDisplay, screen) : m_ClientWidth;
+	*pHeight = enable ? (unsigned)DisplayHeight(pDisplay, screen) : m_ClientHeight;
+	return true;
+}
+
+#endif
@@ -0,0 +1,48 @@
+/* Title: DirectX 9.0c Framework
+/* Description: X11 implementation of IPlatformWindow, compiled with PLATFORM_X11
+				(link -lX11). Software rendered frames are shown with XPutImage.
+				Xlib types are kept out of the header.
+/* Terms of Use: Free to be used in any project
+/************************************************************************/
+
+#pragma once
+
+#ifdef PLATFORM_X11
+
+#include "Platform.h"
+
+class X11Window : public IPlatformWindow
+{
+public:
+	X11Window();
+	~X11Window();
+
+	PlatformWindowType GetType() const override { return PLATFORM_WINDOW_X11; }
+
+	bool Create(const char* pTitle, unsigned clientWidth, unsigned clientHeight, EventQueue* pEvents, bool visible) override;
+	void PumpEvents() override;
+	void WaitForEvents(unsigned ms) override;
+
+	void SetTitle(const char* pTitle) override;
+	void PresentPixels(const RDCOLOR* pPixels, unsigned width, unsigned height, unsigned pitch) override;
+	bool SetFullscreen(bool enable, unsigned* pWidth, unsigned* pHeight) override;
+
+	unsigned GetRefreshRate() const override { return 0; }
+	void* GetNativeHandle() const override { return (void*)m_Window; }
+
+private:
+	//Disallow copying
+	X11Window(const X11Window&);
+	X11Window& operator=(const X11Window&);
+
+	void*			m_pDisplay;			//Display*
+	unsigned long	m_Window;			//Window
+	void*			m_pGC;				//GC
+	unsigned long	m_DeleteAtom;		//WM_DELETE_WINDOW, sent when the window is closed
+	int				m_Depth;
+	EventQueue*		m_pEvents;
+	unsigned		m_ClientWidth;		//Requested client size, restored when leaving fullscreen
+	unsigned		m_ClientHeight;
+};
+
+#endif
@@ -7,12 +7,15 @@
 
 #pragma once
 
+#include <string>	//needed for std::string
+#include <stdio.h> //needed for sprintf_s (check CalculateFPS())
+
+#ifdef _WIN32
+
 #define WIN32_LEAN_AND_MEAN  //strips away any nonessentials (i.e. winsockets, encryption, etc.)
 //we only really care about the standard application stuff
 
 #include <windows.h> //Include the windows header file, This contains all you will need to create a basic window
-#include <string>	//needed for std::string
-#include <sstream> //needed for std::stringstream (check CalculateFPS())
 #include <d3d9.h> //needed for Direct3D
 #include <d3dx9.h>
 #include <dxerr.h>
@@ -22,6 +25,26 @@
 #pragma comment(lib, "d3dx9.lib")
 #pragma comment(lib, "dxerr.lib") //used for our HR macro. DxTraceW is located here
 
+#else
+
+//No Windows or Direct3D headers on other platforms. Stand-ins for the names
+//applications use next to IRenderDevice, mapped to the portable types.
+#include "RenderDevice.h"
+#include <string.h>
+
+typedef void* HINSTANCE;
+typedef void VOID;
+typedef unsigned int UINT;
+typedef RDWORD DWORD;
+typedef RDCOLOR D3DCOLOR;
+
+#define WINAPI
+#define D3DCOLOR_ARGB(a, r, g, b) RD_COLOR_ARGB(a, r, g, b)
+#define D3DFVF_XYZ RD_FVF_XYZ
+#define D3DFVF_DIFFUSE RD_FVF_DIFFUSE
+
+#endif
+
 //SAFE_RELEASE MACRO used to safely release a COM object
 #define SAFE_RELEASE(x) { if(x) x->Release(); x=NULL; }
 //SAFE_DELETE MACRO used to safely delete pointer objects from memory
@@ -37,7 +60,7 @@ namespace d3dColors
 
 //D3DERR check MACRO, used to display message box containing
 //line #, and error message from HRESULT returned by function call
-#ifdef _DEBUG
+#if defined(_DEBUG) && defined(_WIN32)
 #ifndef HR
 #define HR(x)	 \
 {			\
@@ -52,5 +75,10 @@ namespace d3dColors
 #ifndef HR
 #define HR(x) x;
 #endif
-#endif // _DEBUG
+#endif // _DEBUG && _WIN32
+
 
+//Scoped CPU timing MACRO, PROFILE_ZONE("Name") records how long the enclosing
+//block took on this thread, for Chrome trace export (see Profiler.h).
+//Compiled out when PROFILER_DISABLED is defined.
+#include "Profiler.h"
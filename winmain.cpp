@@ -11,8 +11,19 @@
 
 //Include our D3DApp wrapper class
 #include "DXApp.h"
-
-struct VertexPositionColor
+#include "SimdMath.h"
+#include "Culling.h"
+#include "LodSelector.h"
+#include "ParticleSystem.h"
+#include "CommandList.h"
+#include "Profiler.h"
+#include "VertexLayout.h"
+
+#include <string>
+#include <vector>
+
+//The application's vertex, with the stride, FVF and declaration of PositionColorLayout
+struct VertexPositionColor : PositionColorVertex
 {
 	VertexPositionColor() {}
 	VertexPositionColor(float _x, float _y, float _z, D3DCOLOR c)
@@ -20,15 +31,13 @@ struct VertexPositionColor
 		x = _x;
 		y = _y;
 		z = _z;
-		color = c;
+		Color = c;
 	}
 
-	float x, y, z;
-	D3DCOLOR color;
 	static const DWORD FVF; // flexible vretex format;
 };
 
-const DWORD VertexPositionColor::FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE; //diffuse means color
+const DWORD VertexPositionColor::FVF = PositionColorLayout::FVF; //D3DFVF_XYZ | D3DFVF_DIFFUSE, diffuse means color
 
 class TestApp : public DXApp
 {
@@ -41,24 +50,87 @@ public:
 	//Methods
 	bool Init() override;
 	void Update(float dt) override;
+	void Cull() override;
 	void Render() override;
 	void OnLostDevice() override;
 	void OnResetDevice() override;
+
+private:
+	//Registers the LOD chains baked into the archive (see MeshLod.h)
+	void InitLod(const Vec3& eye, const Mat4& proj);
+
+	float m_Angle;									//Rotation of the triangle, owned by Update
+	float m_PrevAngle;								//m_Angle before the last Update, Cull interpolates
+	float m_Spin;									//Radians per second, Left/Right change it, Space stops it
+	Mat4 m_World[FramePipeline::MAX_SLOTS];			//World matrix per frame snapshot
+	bool m_Visible[FramePipeline::MAX_SLOTS];		//Cull result per frame snapshot
+	Culler m_Culler;
+	Mat4 m_ViewProj;								//For the vertex shader
+	int m_ColorPipeline;							//Shader pipeline of the triangle, -1 without shaders
+
+	//Streamed meshes with a LOD chain in the archive, one LOD object each
+	LodSelector m_Lod;
+	std::vector<int> m_MeshLod;						//LOD object of every archive entry or -1
+	std::vector<Vec3> m_LodCenters;					//Bounding spheres in mesh space
+	std::vector<float> m_LodX, m_LodY, m_LodZ, m_LodRadius;
+	std::vector<uint32_t> m_LodModels;
+	std::vector<uint8_t> m_LodLevels[FramePipeline::MAX_SLOTS];	//Selected levels per frame snapshot
+	CommandList m_Commands;							//Draws of the streamed meshes, recorded by Render
+
+	//Fountain below the triangle. Cull expands it into frame arena memory, Render
+	//copies that into the renderer's vertex buffer.
+	ParticleSystem m_Particles;
+	ParticleRenderer m_ParticleRenderer;
+	Mat4 m_View;									//The particles face this camera
+	PositionColorVertex* m_pParticleQuads[FramePipeline::MAX_SLOTS];	//Per frame snapshot, in the frame arena
+	unsigned m_ParticleQuadCount[FramePipeline::MAX_SLOTS];
 };
 
-IDirect3DVertexBuffer9 * VB; //gpu reads vertices after binded here
-IDirect3DIndexBuffer9 * IB; //tells the order to read them^
+//Quads of the fountain, 1 MB of frame arena per frame
+const unsigned PARTICLE_CAPACITY = 16384;
+
+//Vertex colored triangle, the fixed function pipeline draws it until this is compiled
+const char* COLOR_SHADER =
+	"float4x4 g_WorldViewProj : register(c0);\n"
+	"struct VS_OUTPUT { float4 Position : POSITION; float4 Color : COLOR0; };\n"
+	"VS_OUTPUT VSMain(float3 position : POSITION, float4 color : COLOR0)\n"
+	"{\n"
+	"	VS_OUTPUT output;\n"
+	"	output.Position = mul(float4(position, 1.0f), g_WorldViewProj);\n"
+	"	output.Color = color;\n"
+	"	return output;\n"
+	"}\n"
+	"float4 PSMain(float4 color : COLOR0) : COLOR0\n"
+	"{\n"
+	"	return color;\n"
+	"}\n";
+
+IVertexBuffer * VB; //gpu reads vertices after binded here
+IIndexBuffer * IB; //tells the order to read them^
 
 //Calls the base class (DXApp) constructor
-TestApp::TestApp(HINSTANCE hInstance):DXApp(hInstance)
+TestApp::TestApp(HINSTANCE hInstance):DXApp(hInstance), m_Commands(256)
 {
-
+	m_Angle = 0.0f;
+	m_PrevAngle = 0.0f;
+	m_Spin = 1.0f;
+	m_ViewProj = Mat4Identity();
+	m_ColorPipeline = -1;
+	m_View = Mat4Identity();
+	for(int i = 0; i < FramePipeline::MAX_SLOTS; ++i)
+	{
+		m_World[i] = Mat4Identity();
+		m_Visible[i] = true;
+		m_pParticleQuads[i] = NULL;
+		m_ParticleQuadCount[i] = 0;
+	}
 }
 
 //Destructor
 TestApp::~TestApp()
 {
-
+	SAFE_RELEASE(VB);
+	SAFE_RELEASE(IB);
 }
 
 //Calls the based class (DXApp) Init()
@@ -77,8 +149,8 @@ bool TestApp::Init()
 
 	//now create vertex buffer
 
-	m_pDevice3D->CreateVertexBuffer(3 * sizeof(VertexPositionColor), 0, VertexPositionColor::FVF, D3DPOOL_MANAGED,
-		&VB, NULL);
+	m_pRenderDevice->CreateVertexBuffer(3 * PositionColorLayout::STRIDE, 0, VertexPositionColor::FVF, RD_POOL_MANAGED,
+		&VB);
 
 	//how do you manage the vb?  how to add stuff to it?
 
@@ -93,58 +165,278 @@ bool TestApp::Init()
 
 	//now set up the camera, since we cant just render without knowing where to view from
 
-	D3DXMATRIX view;
-	D3DXMATRIX proj;
-
 	//set view
-	D3DXVECTOR3 position = D3DXVECTOR3(0.0f, 0.0f, -5.0f);
-	D3DXVECTOR3 target = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
-	D3DXVECTOR3 up = D3DXVECTOR3(0.0f, 1.0f, 0.0f);
+	Vec3 position = Vec3(0.0f, 0.0f, -5.0f);
+	Vec3 target = Vec3(0.0f, 0.0f, 1.0f);
+	Vec3 up = Vec3(0.0f, 1.0f, 0.0f);
 
-	D3DXMatrixLookAtLH(&view, &position, &target, &up);
+	Mat4 view = Mat4LookAtLH(position, target, up);
 
-	m_pDevice3D->SetTransform(D3DTS_VIEW, &view);
+	m_pRenderDevice->SetTransform(RD_TS_VIEW, view);
 
 	//set projection
-	D3DXMatrixPerspectiveFovLH(&proj, D3DX_PI / 4, static_cast<float>(m_ClientWidth)/m_ClientHeight, 1.0f, 1000.0f);
-	m_pDevice3D->SetTransform(D3DTS_PROJECTION, &proj);
+	Mat4 proj = Mat4PerspectiveFovLH(MATH_PI / 4, static_cast<float>(m_ClientWidth)/m_ClientHeight, 1.0f, 1000.0f);
+	m_pRenderDevice->SetTransform(RD_TS_PROJECTION, proj);
+
+	//Same camera for visibility tests, no occluders in this scene
+	m_Culler.Init(1, 0, 0);
+	m_Culler.SetCamera(view, proj);
+	m_ViewProj = Mat4Multiply(view, proj);
+	m_View = view;
+
+	//About 1.5 s lifetime at 9000 particles per second fills 80% of the pool
+	ParticleEmitterDesc fountain;
+	fountain.Position = Vec3(0.0f, -1.8f, 0.0f);
+	fountain.PositionSpread = 0.05f;
+	fountain.Velocity = Vec3(0.0f, 3.2f, 0.0f);
+	fountain.VelocitySpread = 0.6f;
+	fountain.Rate = 9000.0f;
+	fountain.LifetimeMin = 1.0f;
+	fountain.LifetimeMax = 2.0f;
+	fountain.Gravity = Vec3(0.0f, -3.0f, 0.0f);
+	fountain.Drag = 0.4f;
+	fountain.StartColor = D3DCOLOR_ARGB(255, 255, 255, 255);
+	fountain.EndColor = D3DCOLOR_ARGB(0, 0, 64, 255);
+	fountain.StartSize = 0.01f;
+	fountain.EndSize = 0.03f;
+	m_Particles.AddEmitter(fountain, PARTICLE_CAPACITY);
+	m_ParticleRenderer.Init(m_pRenderDevice, PARTICLE_CAPACITY);
+
+	//Same states as the fixed function path below
+	if(m_pRenderDevice->SupportsShaders())
+	{
+		static const RDWORD states[] = { RD_RS_LIGHTING, false, RD_RS_SHADEMODE, RD_SHADE_GOURAUD };
+		ShaderPipelineDesc desc;
+		ShaderSource vertexShader = { "COLOR_SHADER", COLOR_SHADER, NULL, "VSMain", "vs_2_0" };
+		ShaderSource pixelShader = { "COLOR_SHADER", COLOR_SHADER, NULL, "PSMain", "ps_2_0" };
+		desc.VertexShader = vertexShader;
+		desc.PixelShader = pixelShader;
+		desc.pElements = NULL;
+		desc.FVF = VertexPositionColor::FVF;
+		desc.pRenderStates = states;
+		desc.RenderStateCount = 2;
+		m_ColorPipeline = m_Shaders.RequestPipeline(desc);
+	}
+
+	//Stream every mesh of the archive (see -archive), in archive order
+	if(m_Streamer.IsRunning())
+	{
+		for(unsigned i = 0; i < m_Archive.GetEntryCount(); ++i)
+		{
+			if(m_Archive.GetEntry(i).Type == ASSET_MESH)
+				m_Streamer.Request(i, -(int)i);
+		}
+		InitLod(position, proj);
+	}
 
 	//projecection matrix defines how camera view the world, fov 180 degrees etc
 
 	//view matrix is the orientation of that ^ view.  what change sbased on rotation etc.  where up is
 
-	m_pDevice3D->SetRenderState(D3DRS_LIGHTING, false);
-	m_pDevice3D->SetRenderState(D3DRS_SHADEMODE, D3DSHADE_GOURAUD);
+	m_pRenderDevice->SetRenderState(RD_RS_LIGHTING, false);
+	m_pRenderDevice->SetRenderState(RD_RS_SHADEMODE, RD_SHADE_GOURAUD);
 
 	return true;
 }
 
+void TestApp::InitLod(const Vec3& eye, const Mat4& proj)
+{
+	m_MeshLod.assign(m_Archive.GetEntryCount(), -1);
+	for(unsigned i = 0; i < m_Archive.GetEntryCount(); ++i)
+	{
+		const MeshAssetHeader* pMesh = m_Archive.GetMesh(i);
+		int table = pMesh ? m_Archive.Find((std::string(m_Archive.GetName(i)) + MESH_LOD_SUFFIX).c_str()) : -1;
+		if(table < 0 || pMesh->VertexCount == 0)
+			continue;
+
+		//Every level must lie inside the index buffer
+		const MeshLodLevel* pLevels = (const MeshLodLevel*)m_Archive.GetData(table);
+		unsigned levelCount = (unsigned)(m_Archive.GetEntry(table).Size / sizeof(MeshLodLevel));
+		bool valid = levelCount > 0;
+		for(unsigned level = 0; level < levelCount && valid; ++level)
+			valid = (uint64_t)pLevels[level].IndexOffset + pLevels[level].IndexCount <= pMesh->IndexCount;
+		if(!valid)
+			continue;
+
+		//Bounding sphere around the box of the positions, read from the mapping
+		const uint8_t* pVertices = m_Archive.GetData(i) + pMesh->VertexOffset;
+		Vec3 boxMin = *(const Vec3*)pVertices, boxMax = boxMin;
+		for(unsigned v = 1; v < pMesh->VertexCount; ++v)
+		{
+			const Vec3& p = *(const Vec3*)(pVertices + v * pMesh->Stride);
+			boxMin = Vec3(fminf(boxMin.x, p.x), fminf(boxMin.y, p.y), fminf(boxMin.z, p.z));
+			boxMax = Vec3(fmaxf(boxMax.x, p.x), fmaxf(boxMax.y, p.y), fmaxf(boxMax.z, p.z));
+		}
+		Vec3 center = (boxMin + boxMax) * 0.5f;
+		float radius = 0.0f;
+		for(unsigned v = 0; v < pMesh->VertexCount; ++v)
+			radius = fmaxf(radius, Vec3Length(*(const Vec3*)(pVertices + v * pMesh->Stride) - center));
+
+		m_MeshLod[i] = (int)m_LodModels.size();
+		m_LodModels.push_back(m_Lod.AddModel(pLevels, levelCount, radius));
+		m_LodCenters.push_back(center);
+		m_LodRadius.push_back(radius);
+	}
+
+	unsigned count = (unsigned)m_LodModels.size();
+	m_LodX.resize(count);
+	m_LodY.resize(count);
+	m_LodZ.resize(count);
+	for(int i = 0; i < FramePipeline::MAX_SLOTS; ++i)
+		m_LodLevels[i].assign(count, 0);
+	m_Lod.Init(count);
+	m_Lod.SetCamera(eye, proj, m_ClientHeight);
+}
+
 //Update test app
 void TestApp::Update(float dt)
 {
-
+	//Input of this frame, sampled right before Update
+	const InputState& input = GetInput();
+	if(input.WasPressed(KEY_SPACE))
+		m_Spin = m_Spin != 0.0f ? 0.0f : 1.0f;
+	if(input.IsDown(KEY_LEFT))
+		m_Spin -= 2.0f * dt;
+	if(input.IsDown(KEY_RIGHT))
+		m_Spin += 2.0f * dt;
+
+	m_PrevAngle = m_Angle;
+	m_Angle += m_Spin * dt;
+	m_Particles.Update(dt, &m_Jobs);
 }
 
 
+//Cull test app
+void TestApp::Cull()
+{
+	//Only write this frame's snapshot, Render may be reading another one. With a
+	//fixed timestep the frame falls between the last two updates.
+	m_World[GetUpdateSnapshot()] = Mat4RotationZ(m_PrevAngle + (m_Angle - m_PrevAngle) * GetInterpolation());
+
+	//Bounding sphere of the triangle, moved by this snapshot's world matrix
+	Vec3 center = Vec3TransformCoord(Vec3(0.0f, -0.5f, 0.0f), m_World[GetUpdateSnapshot()]);
+	float radius = 1.12f;
+	m_Visible[GetUpdateSnapshot()] = m_Culler.CullSpheres(&center.x, &center.y, &center.z, &radius, 1, &m_Jobs) > 0;
+
+	//Levels of detail of the streamed meshes, which share the triangle's world matrix
+	if(!m_LodModels.empty())
+	{
+		for(size_t i = 0; i < m_LodModels.size(); ++i)
+		{
+			Vec3 lodCenter = Vec3TransformCoord(m_LodCenters[i], m_World[GetUpdateSnapshot()]);
+			m_LodX[i] = lodCenter.x;
+			m_LodY[i] = lodCenter.y;
+			m_LodZ[i] = lodCenter.z;
+		}
+		m_Lod.Select(&m_LodX[0], &m_LodY[0], &m_LodZ[0], &m_LodRadius[0], &m_LodModels[0], NULL,
+			(unsigned)m_LodModels.size(), &m_Jobs);
+		memcpy(&m_LodLevels[GetUpdateSnapshot()][0], m_Lod.GetLevels(), m_LodModels.size());
+	}
+
+	//Particle quads of this snapshot, none if the arena is full
+	PositionColorVertex* pQuads = m_FrameArena.AllocArray<PositionColorVertex>(m_Particles.GetParticleCount() * 4);
+	m_pParticleQuads[GetUpdateSnapshot()] = pQuads;
+	m_ParticleQuadCount[GetUpdateSnapshot()] = pQuads ? m_Particles.WriteQuads(pQuads, m_Particles.GetParticleCount(), m_View, &m_Jobs) : 0;
+}
+
 //Render test app
 void TestApp::Render()
 {
 	//D3DCOLOR: Cornflower Blue = RGB(100, 149, 237)
 	//Clears the back buffer
-	m_pDevice3D->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, d3dColors::CORN_FLOWER_BLUE, 1.0f, 0);
+	m_pRenderDevice->Clear(RD_CLEAR_TARGET | RD_CLEAR_ZBUFFER, d3dColors::CORN_FLOWER_BLUE, 1.0f, 0);
 
 	//need to call begin scene and end scene before rendering
-	m_pDevice3D->BeginScene();
-	m_pDevice3D->SetStreamSource(0, VB, 0, sizeof(VertexPositionColor));
-	m_pDevice3D->SetFVF(VertexPositionColor::FVF);
-	m_pDevice3D->DrawPrimitive(D3DPT_TRIANGLELIST, 0, 1);
+	m_pRenderDevice->BeginScene();
+	if(m_Visible[GetRenderSnapshot()])
+	{
+		m_pRenderDevice->SetTransform(RD_TS_WORLD, m_World[GetRenderSnapshot()]);
+		m_pRenderDevice->SetStreamSource(0, VB, 0, PositionColorLayout::STRIDE);
+		if(m_ColorPipeline >= 0 && m_Shaders.ApplyPipeline(m_ColorPipeline))
+		{
+			//HLSL packs matrices by column
+			Mat4 wvp = Mat4Transpose(Mat4Multiply(m_World[GetRenderSnapshot()], m_ViewProj));
+			m_pRenderDevice->SetShaderConstantF(RD_SHADER_VERTEX, 0, wvp, 4);
+			m_pRenderDevice->DrawPrimitive(RD_PT_TRIANGLELIST, 0, 1);
+			m_pRenderDevice->SetShader(RD_SHADER_VERTEX, NULL);
+			m_pRenderDevice->SetShader(RD_SHADER_PIXEL, NULL);
+		}
+		else
+		{
+			m_pRenderDevice->SetFVF(VertexPositionColor::FVF);
+			m_pRenderDevice->DrawPrimitive(RD_PT_TRIANGLELIST, 0, 1);
+		}
+	}
+
+	//Streamed meshes show up as soon as they are resident. Sorted by vertex format
+	//(the position, normal and color bits of the FVF) so the state cache can drop
+	//the repeated stream and FVF changes.
+	m_Commands.Reset();
+	unsigned world = m_Commands.AddTransform(m_World[GetRenderSnapshot()]);
+	for(unsigned i = 0; m_Streamer.IsRunning() && i < m_Archive.GetEntryCount(); ++i)
+	{
+		const StreamedMesh* pMesh = m_Streamer.GetMesh(i);
+		if(!pMesh)
+			continue;
+		DrawCommand cmd;
+		cmd.Key = MakeDrawKey(0, 0, 0, pMesh->FVF & 0xFF, 0);
+		cmd.pVB = pMesh->pVB;
+		cmd.Stride = pMesh->Stride;
+		cmd.FVF = pMesh->FVF;
+		cmd.pIB = pMesh->pIB;
+		cmd.Type = RD_PT_TRIANGLELIST;
+		cmd.BaseVertex = 0;
+		cmd.MinIndex = 0;
+		cmd.NumVertices = pMesh->VertexCount;
+		cmd.StartIndex = 0;
+		cmd.PrimCount = pMesh->VertexCount / 3;
+		cmd.Transform = world;
+		cmd.States = CommandList::NONE;
+		cmd.pTexture = NULL;
+		if(pMesh->pIB)
+		{
+			//Meshes with a LOD chain hold every level in their index buffer
+			unsigned indexCount = pMesh->IndexCount;
+			if(i < m_MeshLod.size() && m_MeshLod[i] >= 0)
+			{
+				unsigned object = (unsigned)m_MeshLod[i];
+				const MeshLodLevel& level = m_Lod.GetModelLevel(m_LodModels[object], m_LodLevels[GetRenderSnapshot()][object]);
+				cmd.StartIndex = level.IndexOffset;
+				indexCount = level.IndexCount;
+			}
+			cmd.PrimCount = indexCount / 3;
+		}
+		m_Commands.AddDraw(cmd);
+	}
+	m_Commands.Sort();
+	m_Commands.Submit(m_pRenderDevice);
+
+	//Particles last, blended over everything without writing depth
+	if(m_ParticleQuadCount[GetRenderSnapshot()] > 0)
+	{
+		m_pRenderDevice->SetTransform(RD_TS_WORLD, Mat4Identity());
+		m_pRenderDevice->SetRenderState(RD_RS_ZWRITEENABLE, false);
+		m_pRenderDevice->SetRenderState(RD_RS_CULLMODE, RD_CULL_NONE);
+		m_pRenderDevice->SetRenderState(RD_RS_ALPHABLENDENABLE, true);
+		m_pRenderDevice->SetRenderState(RD_RS_SRCBLEND, RD_BLEND_SRCALPHA);
+		m_pRenderDevice->SetRenderState(RD_RS_DESTBLEND, RD_BLEND_ONE);
+		m_ParticleRenderer.Draw(m_pParticleQuads[GetRenderSnapshot()], m_ParticleQuadCount[GetRenderSnapshot()]);
+		m_pRenderDevice->SetRenderState(RD_RS_ALPHABLENDENABLE, false);
+		m_pRenderDevice->SetRenderState(RD_RS_CULLMODE, RD_CULL_CCW);
+		m_pRenderDevice->SetRenderState(RD_RS_ZWRITEENABLE, true);
+	}
 
-	m_pDevice3D->EndScene();
+	m_pRenderDevice->EndScene();
 
 	//Present the backbuffer to our window
-	m_pDevice3D->Present(0, 0, 0, 0);
+	{
+		PROFILE_ZONE("Present");
+		m_pRenderDevice->Present();
+	}
 }
 
+//Buffers, render states and transforms are restored by DXApp's resource
+//registry, only resources it does not know about would be handled here
 void TestApp::OnResetDevice()
 {
 
@@ -155,21 +447,194 @@ void TestApp::OnLostDevice()
 
 }
 
-//Application Entry point
+//Frame sink of a -sink switch: raw:<file>, ppm:<prefix>, png:<prefix> or pipe:<command>.
+//The pipe command is the rest of the command line. NULL if it can not be opened.
+static IFrameSink* CreateFrameSink(const char* pSpec)
+{
+	char arg[260] = "";
+	if(strncmp(pSpec, "raw:", 4) == 0 && sscanf(pSpec + 4, "%259s", arg) == 1)
+	{
+		RawFileSink* pSink = new RawFileSink();
+		if(pSink->Open(arg))
+			return pSink;
+		delete pSink;
+	}
+	else if(strncmp(pSpec, "pipe:", 5) == 0)
+	{
+		PipeSink* pSink = new PipeSink();
+		if(pSink->Open(pSpec + 5))
+			return pSink;
+		delete pSink;
+	}
+	else if((strncmp(pSpec, "ppm:", 4) == 0 || strncmp(pSpec, "png:", 4) == 0) && sscanf(pSpec + 4, "%259s", arg) == 1)
+	{
+		//Encoders on every core but the one rendering
+		unsigned threads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+		ImageFileSink* pSink = new ImageFileSink();
+		if(pSink->Init(arg, pSpec[1] == 'n' ? IMAGE_PNG : IMAGE_PPM, threads, threads + 2))
+			return pSink;
+		delete pSink;
+	}
+	return NULL;
+}
 
-//HINSTANCE hInstance: Basically the handle to the instance of your application.
-//HINSTANCE hPrevInstance: DEPRECATED, in other words not used anymore. Ignore it.
-//LPSTR lpCmdLine: Basically the input to the command line. (Java and C# equivalent =  string[] args)
-//int nCmdShow: Basically defines how the window is first shown, you will NOT be using it. 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+//Runs the test app with the switches in lpCmdLine, shared by both entry points
+static int RunTestApp(HINSTANCE hInstance, const char* lpCmdLine)
 {
 	//Create instance of test app object
 	TestApp* tApp = new TestApp(hInstance);
 
+	//-headless renders with the software device and no window (CI, profiling)
+	//-nulldevice runs headless without rendering anything
+	if(lpCmdLine && strstr(lpCmdLine, "-nulldevice"))
+		tApp->SetHeadless(true, RD_DEVICE_NULL);
+	else if(lpCmdLine && strstr(lpCmdLine, "-headless"))
+		tApp->SetHeadless(true);
+
+	//-pipelined [1|2] updates on a worker thread, 1 or 2 frames ahead of rendering
+	if(const char* pPipe = lpCmdLine ? strstr(lpCmdLine, "-pipelined") : NULL)
+	{
+		unsigned framesInFlight = 1;
+		sscanf(pPipe, "-pipelined %u", &framesInFlight);
+		tApp->SetPipelined(framesInFlight);
+	}
+
+	//-archive <path> streams the meshes of an asset archive (see AssetPack.cpp)
+	if(const char* pArchive = lpCmdLine ? strstr(lpCmdLine, "-archive ") : NULL)
+	{
+		char path[260] = "";
+		sscanf(pArchive, "-archive %259s", path);
+		if(!tApp->OpenArchive(path))
+		{
+			PlatformShowError("Failed to open the asset archive");
+			return 1;
+		}
+	}
+
+	//-fps <rate> paces frames (0 = unpaced, default = display refresh rate),
+	//-pacing power sleeps only instead of spinning the last part of the wait
+	if(const char* pFps = lpCmdLine ? strstr(lpCmdLine, "-fps ") : NULL)
+	{
+		double fps = -1.0;
+		sscanf(pFps, "-fps %lf", &fps);
+		tApp->SetFrameRate(fps, strstr(lpCmdLine, "-pacing power") ? PACING_POWER : PACING_LATENCY);
+	}
+	else if(lpCmdLine && strstr(lpCmdLine, "-pacing power"))
+		tApp->SetFrameRate(-1.0, PACING_POWER);
+
+	//-fixedstep <rate> updates at a fixed rate, interpolated in between, at most
+	//-maxsteps <n> updates per frame (default 4)
+	if(const char* pStep = lpCmdLine ? strstr(lpCmdLine, "-fixedstep ") : NULL)
+	{
+		unsigned rate = 0, maxSteps = 4;
+		sscanf(pStep, "-fixedstep %u", &rate);
+		if(const char* pMax = strstr(lpCmdLine, "-maxsteps "))
+			sscanf(pMax, "-maxsteps %u", &maxSteps);
+		tApp->SetFixedTimestep(rate, maxSteps);
+	}
+
+	//-trace <path> writes a Chrome trace of the profiler zones on F2 and after -benchmark,
+	//-tracespike <ms> writes it whenever a frame takes longer than <ms> instead
+	if(const char* pTrace = lpCmdLine ? strstr(lpCmdLine, "-trace ") : NULL)
+	{
+		char path[260] = "trace.json";
+		double spikeMs = 0.0;
+		sscanf(pTrace, "-trace %259s", path);
+		if(const char* pSpike = strstr(lpCmdLine, "-tracespike "))
+			sscanf(pSpike, "-tracespike %lf", &spikeMs);
+		tApp->SetTraceOutput(path, spikeMs);
+	}
+
+	//-offscreen <width>x<height> renders without a visible window at any size,
+	//-sink <type>:<target> exports every frame (see CreateFrameSink), read back
+	//through a ring of -readbackring <n> surfaces (default 3). With -benchmark
+	//this renders a fixed number of frames, e.g. for a video:
+	//-offscreen 1280x720 -benchmark 600 -sink pipe:ffmpeg -y -f rawvideo -pix_fmt bgra -s 1280x720 -r 60 -i - out.mp4
+	if(const char* pOffscreen = lpCmdLine ? strstr(lpCmdLine, "-offscreen ") : NULL)
+	{
+		unsigned width = 0, height = 0;
+		if(sscanf(pOffscreen, "-offscreen %ux%u", &width, &height) != 2 || width == 0 || height == 0)
+		{
+			PlatformShowError("Offscreen size must be <width>x<height>");
+			return 1;
+		}
+		tApp->SetOffscreen(width, height);
+	}
+	IFrameSink* pSink = NULL;
+	if(const char* pSinkSpec = lpCmdLine ? strstr(lpCmdLine, "-sink ") : NULL)
+	{
+		pSink = CreateFrameSink(pSinkSpec + 6);
+		if(!pSink)
+		{
+			PlatformShowError("Failed to open the frame sink");
+			return 1;
+		}
+		unsigned ringSize = 3;
+		if(const char* pRing = strstr(lpCmdLine, "-readbackring "))
+			sscanf(pRing, "-readbackring %u", &ringSize);
+		tApp->SetFrameSink(pSink, ringSize);
+	}
+
+	//-inputrate <hz> moves the mouse from a thread of its own, so runs without
+	//a user (e.g. -nulldevice -benchmark) report input latency
+	if(const char* pInput = lpCmdLine ? strstr(lpCmdLine, "-inputrate ") : NULL)
+	{
+		unsigned hz = 0;
+		sscanf(pInput, "-inputrate %u", &hz);
+		tApp->SetInputSimulation(hz);
+	}
+
 	//Initialize our test app
 	if(!tApp->Init())
 		return 1; //exit application
 
+	//-benchmark <frames> [-dt <seconds>] [-out <path>] runs a fixed number of frames
+	//and writes frame time percentiles to <path>.json/.csv instead of running forever
+	const char* pBench = lpCmdLine ? strstr(lpCmdLine, "-benchmark") : NULL;
+	if(pBench)
+	{
+		unsigned frames = 1000;
+		float dt = 1.0f / 60.0f;
+		char out[260] = "benchmark";
+		sscanf(pBench, "-benchmark %u", &frames);
+		if(const char* pDt = strstr(lpCmdLine, "-dt "))
+			sscanf(pDt, "-dt %f", &dt);
+		if(const char* pOut = strstr(lpCmdLine, "-out "))
+			sscanf(pOut, "-out %259s", out);
+		//-losedevice <frames> simulates a device loss every <frames> frames (-nulldevice only)
+		if(const char* pLose = strstr(lpCmdLine, "-losedevice "))
+		{
+			unsigned interval = 0;
+			sscanf(pLose, "-losedevice %u", &interval);
+			tApp->SetDeviceLossInterval(interval);
+		}
+		return tApp->RunBenchmark(frames, dt, out);
+	}
+
 	//Otherwise, call our application loop
 	return (tApp->Run());
-}
\ No newline at end of file
+}
+
+//Application Entry point
+#ifdef _WIN32
+//HINSTANCE hInstance: Basically the handle to the instance of your application.
+//HINSTANCE hPrevInstance: DEPRECATED, in other words not used anymore. Ignore it.
+//LPSTR lpCmdLine: Basically the input to the command line. (Java and C# equivalent =  string[] args)
+//int nCmdShow: Basically defines how the window is first shown, you will NOT be using it. 
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
+{
+	return RunTestApp(hInstance, lpCmdLine);
+}
+#else
+//Linux and other platforms: same switches, joined into one command line
+int main(int argc, char** argv)
+{
+	std::string cmdLine;
+	for(int i = 1; i < argc; ++i)
+	{
+		cmdLine += argv[i];
+		cmdLine += ' ';
+	}
+	return RunTestApp(NULL, cmdLine.c_str());
+}
+#endif